@@ -48,6 +48,7 @@
 #include "db/write_controller.h"
 #include "file/sst_file_manager_impl.h"
 #include "logging/logging.h"
+#include "memory/sep_concurrent_arena.h"
 #include "monitoring/instrumented_mutex.h"
 #include "monitoring/thread_status_util.h"
 #include "options/cf_options.h"
@@ -59,6 +60,7 @@
 #include "rocksdb/convenience.h"
 #include "rocksdb/env.h"
 #include "rocksdb/logger.hpp"
+#include "rocksdb/memtable_shard_partitioner.h"
 #include "rocksdb/options.h"
 #include "rocksdb/remote_flush_service.h"
 #include "rocksdb/remote_transfer_service.h"
@@ -69,7 +71,9 @@
 #include "trace_replay/trace_replay.h"
 #include "util/autovector.h"
 #include "util/cast_util.h"
+#include "util/coding.h"
 #include "util/compression.h"
+#include "util/hash.h"
 #include "util/thread_local.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -292,6 +296,11 @@ ColumnFamilyOptions SanitizeOptions(const ImmutableDBOptions& db_options,
   if (result.max_local_write_buffer_number < 2) {
     result.max_local_write_buffer_number = 2;
   }
+  result.memtable_shard_num =
+      std::max(1, std::min(result.memtable_shard_num, kMaxMemTableShards));
+  if (result.memtable_shard_partitioner == nullptr) {
+    result.memtable_shard_partitioner = NewFixedPrefixShardPartitioner();
+  }
   // fall back max_write_buffer_number_to_maintain if
   // max_write_buffer_size_to_maintain is not set
   if (result.max_write_buffer_size_to_maintain < 0) {
@@ -601,13 +610,12 @@ ColumnFamilyData::ColumnFamilyData(
       db_paths_registered_(false),
       mempurge_used_(false),
       next_epoch_number_(1),
-      meta_conn_(nullptr),
       trans_mem_accumulated_id(0),
+      shard_partitioner_(ioptions_.memtable_shard_partitioner),
       imm_que(new moodycamel::BlockingConcurrentQueue<std::pair<
                   std::pair<MemTable*, RDMANode::rdma_connection*>,
                   std::pair<bool,
-                            std::chrono::high_resolution_clock::time_point>>>),
-      memtable_ip_port(new std::pair<std::string, size_t>) {
+                            std::chrono::high_resolution_clock::time_point>>>) {
   LOG("CHECK : ", "initial_cf_options_:",
       initial_cf_options_.server_use_remote_flush == true ? "true" : "false");
   if (id_ != kDummyColumnFamilyDataId) {
@@ -630,6 +638,11 @@ ColumnFamilyData::ColumnFamilyData(
   // Convert user defined table properties collector factories to internal ones.
   GetIntTblPropCollectorFactory(ioptions_, &int_tbl_prop_collector_factories_);
 
+  if (ioptions_.delegated_read_cache) {
+    PutVarint64(&delegated_read_cache_id_,
+                ioptions_.delegated_read_cache->NewId());
+  }
+
   // if _dummy_versions is nullptr, then this is a dummy column family.
   if (_dummy_versions != nullptr) {
     internal_stats_.reset(
@@ -700,12 +713,12 @@ ColumnFamilyData::ColumnFamilyData(
     }
   }
 
-  std::string memnode_ip = "10.10.1.1";
   if (db_options.server_remote_flush ||
       initial_cf_options_.max_local_write_buffer_number <
           initial_cf_options_.max_write_buffer_number) {
-    if (!init_cf_level_rdma_client(memnode_ip, 9091).ok()) {
-      LOG_CERR("rdma client INIT Failed");
+    Status s = init_cf_level_rdma_client(ParseMemNodes(db_options.memnodes));
+    if (!s.ok()) {
+      DM_LOG_ERROR("rdma client INIT Failed: ", s.ToString());
     }
   }
 }
@@ -779,46 +792,48 @@ ColumnFamilyData::~ColumnFamilyData() {
       (ioptions_.server_remote_flush ||
        initial_cf_options_.max_local_write_buffer_number <
            initial_cf_options_.max_write_buffer_number)) {
-    for (size_t i = 0; i < 16; i++) {
-      RDMANode::rdma_connection* conn = nullptr;
-      delegated_read_conns_.wait_dequeue_timed(conn, std::chrono::seconds(2));
-      if (conn) {
-        cflevel_read_client_->disconnect_request(conn);
-        LOG_CERR("delegated read conn disconnect for cfd: ", GetID());
-      } else {
-        LOG_CERR("delegated read conn disconnect timeout");
-        i--;
-        continue;
+    for (auto& m : memnodes_) {
+      for (size_t i = 0; i < m->num_read_conns; i++) {
+        RDMANode::rdma_connection* conn = nullptr;
+        m->read_conns.wait_dequeue_timed(conn, std::chrono::seconds(2));
+        if (conn) {
+          cflevel_read_client_->disconnect_request(conn);
+          DM_LOG_INFO("delegated read conn disconnect for cfd: ", GetID());
+        } else {
+          DM_LOG_WARN("delegated read conn disconnect timeout");
+          i--;
+          continue;
+        }
       }
     }
   }
   if (cflevel_read_client_) delete cflevel_read_client_;
 
-  while (!memtable_conn_.empty()) {
-    memtable_conn_mtx_.lock();
-    auto conn = memtable_conn_.front();
-    memtable_conn_.pop();
-    cflevel_client_->disconnect_request(conn);
-    memtable_conn_mtx_.unlock();
-  }
-
   if (gc_thread_) {
     gc_thread_->join();
     delete gc_thread_;
     gc_thread_ = nullptr;
   }
-  if (gc_conn_) {
-    cflevel_client_->disconnect_request(gc_conn_);
-  }
-  if (meta_conn_) {
-    cflevel_client_->disconnect_request(meta_conn_);
+  for (auto& m : memnodes_) {
+    {
+      std::lock_guard<std::mutex> lck(memtable_conn_mtx_);
+      while (!m->memtable_conns.empty()) {
+        cflevel_client_->disconnect_request(m->memtable_conns.front());
+        m->memtable_conns.pop();
+      }
+    }
+    if (m->gc_conn) {
+      cflevel_client_->disconnect_request(m->gc_conn);
+    }
+    if (m->meta_conn) {
+      cflevel_client_->disconnect_request(m->meta_conn);
+    }
   }
   if (reginfo_) delete reginfo_;
   if (imm_que != nullptr) {
     delete imm_que;
     imm_que = nullptr;
   }
-  if (memtable_ip_port) delete memtable_ip_port;
   if (cflevel_client_) delete cflevel_client_;
 }
 
@@ -871,21 +886,23 @@ Status ColumnFamilyData::background_schedule_imm_trans() {
           continue;
         std::chrono::high_resolution_clock::time_point t1 =
             std::chrono::high_resolution_clock::now();
-        LOG_CERR("Pop ImmMemTable ", imm_to_trans.first.first->GetID(),
-                 " from imm_que, takes ",
-                 std::chrono::duration_cast<std::chrono::milliseconds>(
+        DM_LOG_DEBUG("Pop ImmMemTable ", imm_to_trans.first.first->GetID(),
+                     " from imm_que, takes ",
+                     std::chrono::duration_cast<std::chrono::milliseconds>(
                      t1 - imm_to_trans.second.second)
                      .count(),
-                 " ms");
-        auto reg_ = reginfo_;
+                     " ms");
+        size_t memnode = memnode_of_conn_.at(imm_to_trans.first.second);
+        MemNodeConns* m = memnodes_[memnode].get();
         Status s = imm_to_trans.first.first->SendToRemote(
             cflevel_client_, imm_to_trans.first.second,
             reginfo_->index_mp.at(imm_to_trans.first.second).first,
             reginfo_->index_mp.at(imm_to_trans.first.second).second,
-            *memtable_ip_port, id_, &gc_queue_, imm_to_trans.second.first);
+            m->ip_port, id_, MemNodeDbTag(), &m->gc_queue,
+            imm_to_trans.second.first);
         if (!s.ok()) {
-          LOG_CERR("immutable memtable ", imm_to_trans.first.first->GetID(),
-                   " sent remote failed, reschedule task");
+          DM_LOG_WARN("immutable memtable ", imm_to_trans.first.first->GetID(),
+                      " sent remote failed, reschedule task");
           // std::lock_guard<std::mutex> lck(*imm_que_mtx);
           imm_que->enqueue(imm_to_trans);
         } else {
@@ -896,13 +913,14 @@ Status ColumnFamilyData::background_schedule_imm_trans() {
                  !trans_mem_accumulated_id.compare_exchange_weak(old, new_id)) {
           }
           delete imm_to_trans.first.first->Unref();
+          memnode_placement_->TransferDone(memnode);
           {
             std::lock_guard<std::mutex> lck(memtable_conn_mtx_);
-            memtable_conn_.push(imm_to_trans.first.second);
+            m->memtable_conns.push(imm_to_trans.first.second);
           }
           std::chrono::high_resolution_clock::time_point t2 =
               std::chrono::high_resolution_clock::now();
-          LOG_CERR(
+          DM_LOG_DEBUG(
               "Sending ImmMemTable ", imm_to_trans.first.first->GetID(),
               " to remote finished, takes ",
               std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1)
@@ -939,11 +957,11 @@ void ColumnFamilyData::UnPackRemote(TransferService* node) {
 }
 
 void ColumnFamilyData::DoubleCheck(TransferService* node) const {
-  LOG_CERR("DoubleCheck ColumnFamilyData::current_ ptr=",
-           reinterpret_cast<void*>(current_));
+  DM_LOG_DEBUG("DoubleCheck ColumnFamilyData::current_ ptr=",
+               reinterpret_cast<void*>(current_));
   current_->DoubleCheck(node);
-  LOG_CERR("DoubleCheck ColumnFamilyData::internal_stats_ ptr=",
-           (internal_stats_ == nullptr ? "nullptr" : "non-nullptr"));
+  DM_LOG_DEBUG("DoubleCheck ColumnFamilyData::internal_stats_ ptr=",
+               (internal_stats_ == nullptr ? "nullptr" : "non-nullptr"));
   internal_stats_->DoubleCheck(node);
 }
 
@@ -1351,6 +1369,23 @@ WriteStallCondition ColumnFamilyData::RecalculateWriteStallConditions(
           "bytes %" PRIu64 " rate %" PRIu64,
           name_.c_str(), vstorage->estimated_compaction_needed_bytes(),
           write_controller->delayed_write_rate());
+    } else if (MemNodePressure() >= MemNodePlacement::Pressure::kDelay) {
+      // slow writes down before memtables have to be kept local, and harder
+      // once they are
+      write_stall_condition = WriteStallCondition::kDelayed;
+      bool full = MemNodePressure() == MemNodePlacement::Pressure::kFull;
+      write_controller_token_ =
+          SetupDelay(write_controller, compaction_needed_bytes,
+                     prev_compaction_needed_bytes_, was_stopped || full,
+                     mutable_cf_options.disable_auto_compactions);
+      internal_stats_->AddCFStats(InternalStats::MEMTABLE_LIMIT_DELAYS, 1);
+      ROCKS_LOG_WARN(
+          ioptions_.logger,
+          "[%s] Stalling writes because the memnodes have room for %" PRIu64
+          " more memtables, %" PRIu64 " bytes offloaded, rate %" PRIu64,
+          name_.c_str(), memnode_placement_->Headroom(),
+          static_cast<uint64_t>(write_buffer_manager_->remote_memory_usage()),
+          write_controller->delayed_write_rate());
     } else {
       assert(write_stall_condition == WriteStallCondition::kNormal);
       if (vstorage->l0_delay_trigger_count() >=
@@ -1427,22 +1462,196 @@ uint64_t ColumnFamilyData::GetLiveSstFilesSize() const {
   return current_->GetSstFilesSize();
 }
 
+size_t ColumnFamilyData::MemNodeOf(const MemTable& mem) const {
+  auto it = memnode_of_conn_.find(mem.get_conn().second);
+  return it == memnode_of_conn_.end() ? 0 : it->second;
+}
+
+uint64_t ColumnFamilyData::MemNodeDbTag() const {
+  const std::string& db_id = column_family_set_->db_id_;
+  return Hash64(db_id.data(), db_id.size());
+}
+
+Status ColumnFamilyData::ReattachRemoteMemTables(SequenceNumber* max_sealed) {
+  assert(imm()->NumNotFlushed() == 0 && mem_ != nullptr && mem_->IsEmpty());
+  const uint64_t db_tag = MemNodeDbTag();
+  const uint64_t now = Env::Default()->NowMicros();
+  // memnode of every memtable listed
+  std::vector<std::pair<size_t, memtable_recovery_entry>> found;
+  for (size_t i = 0; i < memnodes_.size(); i++) {
+    RDMANode::rdma_connection* conn = try_get_meta_conn(i);
+    if (conn == nullptr) {
+      // what it holds is a gap in the chain, the WALs cover it
+      ROCKS_LOG_WARN(ioptions_.logger,
+                     "[%s] Memnode %s:%zu not reachable for warm restart",
+                     name_.c_str(), memnodes_[i]->ip_port.first.c_str(),
+                     memnodes_[i]->ip_port.second);
+      continue;
+    }
+    for (auto& e : cflevel_client_->list_memtables_request(conn, db_tag, id_)) {
+      found.emplace_back(i, e);
+    }
+    putback_meta_conn(i, conn);
+  }
+  TEST_SYNC_POINT_CALLBACK("ColumnFamilyData::ReattachRemoteMemTables:Listed",
+                           &found);
+  // oldest first, a memtable switch without a new WAL keeps the log number
+  std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+    if (a.second.info.next_log_number != b.second.info.next_log_number) {
+      return a.second.info.next_log_number < b.second.info.next_log_number;
+    }
+    return a.second.mixed_id < b.second.mixed_id;
+  });
+
+  // a local flush only sees the local copy of a memtable, which the ones
+  // taken back do not have. Without a remote flush the WALs are replayed.
+  const bool reattach = initial_cf_options_.server_use_remote_flush;
+  uint64_t max_id = 0;
+  std::vector<std::pair<size_t, memtable_recovery_entry>> chain;
+  bool linked = true;
+  size_t dropped = 0;
+  for (auto& f : found) {
+    const memtable_recovery_info& info = f.second.info;
+    uint64_t id = f.second.mixed_id & 0xffffffff;
+    max_id = std::max(max_id, id);
+    // flushed already, left behind by a crash before the memnode freed it
+    bool keep = reattach && info.next_log_number > GetLogNumber();
+    if (keep && linked) {
+      // sealed_seqno is 0 for a memtable sealed while replaying, whose last
+      // WAL is replayed again. Range tombstones are only kept locally.
+      linked = info.sealed_seqno != 0 &&
+               (info.flags & kMemTableRecoveryRangeDeletes) == 0 &&
+               (chain.empty()
+                    ? info.creation_log_number <= GetLogNumber()
+                    : info.creation_log_number ==
+                              chain.back().second.info.next_log_number &&
+                          id > (chain.back().second.mixed_id & 0xffffffff));
+    }
+    if (keep && linked) {
+      chain.push_back(f);
+    } else {
+      memnodes_[f.first]->gc_queue.push({f.second.mixed_id, now});
+      dropped++;
+    }
+  }
+  // memtables created from here on must not reuse the id of anything the
+  // memnodes still hold
+  if (max_id > last_memtable_id_.load()) {
+    last_memtable_id_.store(max_id);
+    mem_->SetID(last_memtable_id_.fetch_add(1) + 1);
+  }
+
+  MutableCFOptions mutable_cf_options = *GetLatestMutableCFOptions();
+  // nothing is inserted, keep the local arena small and without a filter
+  mutable_cf_options.memtable_prefix_bloom_size_ratio = 0;
+  mutable_cf_options.write_buffer_size = 64 << 10;
+  autovector<MemTable*> to_delete;
+  for (auto& f : chain) {
+    const memtable_recovery_info& info = f.second.info;
+    RDMANode::rdma_connection* conn = nullptr;
+    for (auto& c : memnode_of_conn_) {
+      if (c.second == f.first) {
+        conn = c.first;
+        break;
+      }
+    }
+    auto* mem = new MemTable(internal_comparator_, ioptions_,
+                             mutable_cf_options, write_buffer_manager_,
+                             info.earliest_seqno, id_, cflevel_client_,
+                             nullptr, shard_partitioner_);
+    mem->SetID(f.second.mixed_id & 0xffffffff);
+    mem->Reattach(info, f.second.mixed_id, {cflevel_client_, conn},
+                  &memnodes_[f.first]->gc_queue);
+    mem->Ref();
+    imm()->Add(mem, &to_delete);
+    *max_sealed = std::max(*max_sealed, info.sealed_seqno);
+  }
+  for (MemTable* m : to_delete) {
+    delete m;
+  }
+  if (!chain.empty()) {
+    reattached_memtable_id_ = chain.back().second.mixed_id & 0xffffffff;
+    reattached_log_number_ = chain.back().second.info.next_log_number;
+    // drain them from the memnodes before anything newer
+    imm()->FlushRequested();
+  }
+  // the replay fills the memtable from the first WAL not covered on
+  mem_->SetCreationLogNumber(std::max(GetLogNumber(), reattached_log_number_));
+  ROCKS_LOG_INFO(ioptions_.logger,
+                 "[%s] Reattached %zu memtables up to log #%" PRIu64
+                 " from the memnodes, %zu left to the memnode gc",
+                 name_.c_str(), chain.size(), reattached_log_number_, dropped);
+  return Status::OK();
+}
+
+bool ColumnFamilyData::HasReattachedMemTables() const {
+  return reattached_memtable_id_ > 0 && imm_.NumNotFlushed() > 0 &&
+         imm_.GetEarliestMemTableID() <= reattached_memtable_id_;
+}
+
+void ColumnFamilyData::RefreshMemNodeCapacity() {
+  uint64_t now = Env::Default()->NowMicros();
+  if (!memnode_placement_->NeedsRefresh(now)) {
+    return;
+  }
+  for (size_t i = 0; i < memnodes_.size(); i++) {
+    // a memnode busy with a flush job keeps its last report
+    RDMANode::rdma_connection* conn = try_get_meta_conn(i);
+    if (conn == nullptr) {
+      continue;
+    }
+    memnode_capacity cap = cflevel_client_->capacity_request(conn);
+    putback_meta_conn(i, conn);
+    memnode_placement_->UpdateCapacity(i, cap, now);
+  }
+}
+
 MemTable* ColumnFamilyData::ConstructNewMemtable(
     const MutableCFOptions& mutable_cf_options, SequenceNumber earliest_seq) {
-  assert(!memtable_conn_.empty() ||
-         !initial_cf_options_.server_use_remote_flush);
   RDMANode::rdma_connection* conn_ = nullptr;
-  if (initial_cf_options_.server_use_remote_flush ||
-      initial_cf_options_.max_write_buffer_number >
-          initial_cf_options_.max_local_write_buffer_number) {
+  const bool offload = initial_cf_options_.server_use_remote_flush ||
+                       initial_cf_options_.max_write_buffer_number >
+                           initial_cf_options_.max_local_write_buffer_number;
+  size_t memnode = MemNodePlacement::kNoMemNode;
+  if (offload) {
+    RefreshMemNodeCapacity();
+    memnode = memnode_placement_->Place();
+  }
+  if (memnode != MemNodePlacement::kNoMemNode) {
     std::lock_guard<std::mutex> memconn_lock(memtable_conn_mtx_);
-    conn_ = memtable_conn_.front();
-    memtable_conn_.pop();
+    auto& conns = memnodes_[memnode]->memtable_conns;
+    assert(!conns.empty());
+    conn_ = conns.front();
+    conns.pop();
+  }
+  // split the next memtable the way the current one filled up
+  if (mem_ != nullptr && ioptions_.memtable_shard_num > 1) {
+    std::vector<std::string> sample;
+    mem_->SampleUserKeys(kShardSampleKeys * ioptions_.memtable_shard_num,
+                         &sample);
+    auto learned =
+        shard_partitioner_->Learn(sample, ioptions_.memtable_shard_num);
+    if (learned != nullptr) {
+      shard_partitioner_ = learned;
+    }
   }
   // fetch a non-nullptr connection from memtable_conn_ atomically
-  auto* memtable_ = new MemTable(internal_comparator_, ioptions_,
-                                 mutable_cf_options, write_buffer_manager_,
-                                 earliest_seq, id_, cflevel_client_, conn_);
+  auto* memtable_ = new MemTable(
+      internal_comparator_, ioptions_, mutable_cf_options,
+      write_buffer_manager_, earliest_seq, id_, cflevel_client_, conn_,
+      shard_partitioner_);
+  if (offload && memtable_->get_conn().second == nullptr) {
+    if (conn_ != nullptr) {
+      // refused by the memnode, whose last report was too optimistic
+      memnode_placement_->TransferDone(memnode);
+      std::lock_guard<std::mutex> memconn_lock(memtable_conn_mtx_);
+      memnodes_[memnode]->memtable_conns.push(conn_);
+    }
+    memtable_->MarkSpilled(&spilled_memtables_);
+    ROCKS_LOG_WARN(ioptions_.logger,
+                   "[%s] Memnodes are full, keeping memtable local",
+                   name_.c_str());
+  }
   LOG("ColumnFamilyData::ConstructNewMemtable Alloc memtable finish: "
       "ptr =",
       static_cast<void*>(memtable_), ' ', memtable_->GetID());
@@ -1451,10 +1660,11 @@ MemTable* ColumnFamilyData::ConstructNewMemtable(
 
 void ColumnFamilyData::CreateNewMemtable(
     const MutableCFOptions& mutable_cf_options, SequenceNumber earliest_seq) {
+  // the shard partitioner of the new one is learnt from the old one
+  MemTable* ptr = ConstructNewMemtable(mutable_cf_options, earliest_seq);
   if (mem_ != nullptr) {
     delete mem_->Unref();
   }
-  MemTable* ptr = ConstructNewMemtable(mutable_cf_options, earliest_seq);
   SetMemtable(ptr);
   mem_->Ref();
 }
@@ -1871,116 +2081,93 @@ void ColumnFamilyData::RecoverEpochNumbers() {
   vstorage->RecoverEpochNumbers(this);
 }
 
-Status ColumnFamilyData::init_cf_level_rdma_client(std::string& ip, int port) {
+Status ColumnFamilyData::init_cf_level_rdma_client(
+    const std::vector<std::pair<std::string, int>>& memnodes) {
   if (cflevel_client_ != nullptr ||
       ColumnFamilyData::kDummyColumnFamilyDataId == GetID()) {
-    LOG_CERR("already init cfd or dummy cfd: ", GetID());
+    DM_LOG_INFO("already init cfd or dummy cfd: ", GetID());
     return Status::OK();
   } else {
-    LOG_CERR("init cfd: ", GetID());
+    DM_LOG_INFO("init cfd: ", GetID(), " memnodes: ", memnodes.size());
   }
+  assert(!memnodes.empty());
   Status s = Status::OK();
   cflevel_client_ = new RDMAClient();
   reginfo_ = new struct built_memreg_info;
-  memtable_ip_port->first = ip;
-  memtable_ip_port->second = port;
 
   cflevel_read_client_ = new RDMAReadClient();
 
   size_t block_size_ =
       Arena::OptimizeBlockSize((mutable_cf_options_.write_buffer_size + 10240));
-  // memory for each column family
+  // memory for each column family, every further memnode adds its remote
+  // flush package and memtable index buffers
   size_t maintain_mr_size =
       (100 /*memtable index*/ + (block_size_ << 3) /*memtable meta and data*/ +
        1000 /*read request*/) *
-      initial_cf_options_.max_write_buffer_number;
+          initial_cf_options_.max_write_buffer_number +
+      (memnodes.size() - 1) *
+          (REMOTE_FLUSH_PACKAGE_SIZE +
+           MEMTABLE_INDEX_SIZE * initial_cf_options_.max_write_buffer_number);
   size_t maintain_rr_size = (cflevel_read_client_->config.max_recv_wr +
                              cflevel_read_client_->config.max_recv_wr + 100) *
-                            (sizeof(imm_read_req_v2) + sizeof(imm_read_ret));
+                            imm_read_batch::slot_size() * memnodes.size();
   cflevel_client_->resources_create(maintain_mr_size);
   cflevel_client_->rdma_mem_.init(maintain_mr_size);
   cflevel_read_client_->resources_create(maintain_rr_size);
   cflevel_read_client_->rdma_mem_.init(maintain_rr_size);
-
-  for (size_t i = 0; i < 16; i++) {
-    auto conn = cflevel_read_client_->sock_connect(ip, port);
-    if (conn == nullptr) {
-      fprintf(stderr, "delegated_read_conns_ connect failed\n");
-      s = Status::IOError("delegated_read_conns_ connect failed");
+  memnode_placement_.reset(new MemNodePlacement(
+      memnodes.size(),
+      SepConcurrentArena::RemoteBytes(mutable_cf_options_.write_buffer_size,
+                                      ioptions_.memtable_shard_num)));
+
+  for (auto& ip_port : memnodes) {
+    memnodes_.emplace_back(new MemNodeConns);
+    memnodes_.back()->ip_port = ip_port;
+    s = connect_memnode(memnodes_.size() - 1);
+    if (!s.ok()) {
       return s;
     }
-    ASSERT_RW(cflevel_read_client_->register_client_in_get_service_request(
-        conn, true));
-    delegated_read_conns_.enqueue(conn);
-    LOG_CERR("delegated_read_conns_ register_client_in_get_service_request: ",
-             i);
   }
 
-  meta_conn_ = cflevel_client_->sock_connect(ip, port);
-  if (meta_conn_ == nullptr) {
-    fprintf(stderr, "meta_conn_ connect failed\n");
-    s = Status::IOError("meta_conn_ connect failed");
-    return s;
-  }
-
-  gc_conn_ = cflevel_client_->sock_connect(ip, port);
-  if (gc_conn_ == nullptr) {
-    fprintf(stderr, "gc_conn_ connect failed\n");
-    s = Status::IOError("gc_conn_ connect failed");
-    return s;
-  }
   if (gc_thread_ == nullptr) {
     gc_thread_ = new std::thread([this]() {
-      while (!gc_queue_.empty()) {
-        gc_queue_.pop();
+      for (auto& m : memnodes_) {
+        while (!m->gc_queue.empty()) {
+          m->gc_queue.pop();
+        }
       }
 
       while (!should_drop.load()) {
-        while (!gc_queue_.empty()) {
-          auto req = gc_queue_.front();
-          gc_queue_.pop();
-          while (Env::Default()->NowMicros() - req.second <= 1000000) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+        for (auto& m : memnodes_) {
+          while (!m->gc_queue.empty()) {
+            auto req = m->gc_queue.front();
+            m->gc_queue.pop();
+            // a test leaves the memtable on the memnode as a crash would
+            bool keep = false;
+            TEST_SYNC_POINT_CALLBACK("ColumnFamilyData::MemNodeGc:Keep",
+                                     &keep);
+            if (keep) {
+              continue;
+            }
+            // no reader holds the memtable any more, which is what keeps
+            // one-sided reads of its memory safe, not this delay
+            while (Env::Default()->NowMicros() - req.second <= 1000000) {
+              std::this_thread::sleep_for(std::chrono::seconds(1));
+            }
+            char req_type = 7;
+            ASSERT_RW(writen(m->gc_conn->sock, &req_type, sizeof(char)) ==
+                      sizeof(char));
+            ASSERT_RW(writen(m->gc_conn->sock, &req.first,
+                             sizeof(uint64_t)) == sizeof(uint64_t));
+            char ret = 0;
+            ASSERT_RW(readn(m->gc_conn->sock, &ret, sizeof(char)) ==
+                      sizeof(char));
+            assert(ret == 1 || ret == 2);
           }
-          char req_type = 7;
-          ASSERT_RW(writen(gc_conn_->sock, &req_type, sizeof(char)) ==
-                    sizeof(char));
-          ASSERT_RW(writen(gc_conn_->sock, &req.first, sizeof(uint64_t)) ==
-                    sizeof(uint64_t));
-          char ret = 0;
-          ASSERT_RW(readn(gc_conn_->sock, &ret, sizeof(char)) == sizeof(char));
-          assert(ret == 1 || ret == 2);
         }
       }
     });
   }
-  // allocate mem for meta
-  char req_type = 9;
-  ASSERT_RW(writen(meta_conn_.load()->sock, reinterpret_cast<void*>(&req_type),
-                   sizeof(char)) == sizeof(char));
-  auto meta_offset = cflevel_client_->rdma_mem_.allocate(98304);
-  auto remote_meta_reg =
-      cflevel_client_->allocate_mem_request(meta_conn_, 98304);
-  reginfo_->rf_meta_local_offset = meta_offset;
-  reginfo_->rf_meta_remote_offset.first = remote_meta_reg.first;
-  reginfo_->rf_meta_remote_offset.second = remote_meta_reg.second;
-
-  for (int i = 0; i < initial_cf_options_.max_write_buffer_number; i++) {
-    auto conn_ = cflevel_client_->sock_connect(ip, port);
-    if (conn_ == nullptr) {
-      fprintf(stderr, "memtable_conn_ connect failed\n");
-      s = Status::IOError("memtable_conn_ connect failed");
-      return s;
-    }
-    auto local_index_offset = cflevel_client_->rdma_mem_.allocate(93);
-    char req_type = 1;
-    ASSERT_RW(writen(conn_->sock, reinterpret_cast<void*>(&req_type),
-                     sizeof(char)) == sizeof(char));
-    auto reg = cflevel_client_->allocate_mem_request(
-        conn_, 93);  // reusable index buffer
-    reginfo_->index_mp.insert({conn_, {local_index_offset, reg}});
-    memtable_conn_.push(conn_);
-  }
 
   // auto memtable_index_offset =
   //     cflevel_client_->rdma_mem_.allocate(93);  // imm index metadata
@@ -2024,6 +2211,90 @@ Status ColumnFamilyData::init_cf_level_rdma_client(std::string& ip, int port) {
   return s;
 }
 
+Status ColumnFamilyData::connect_memnode(size_t memnode) {
+  MemNodeConns* m = memnodes_[memnode].get();
+  const std::string& ip = m->ip_port.first;
+  int port = static_cast<int>(m->ip_port.second);
+  for (size_t i = 0; i < 16; i++) {
+    auto conn = cflevel_read_client_->sock_connect(ip, port);
+    if (conn == nullptr) {
+      DM_LOG_ERROR("delegated read conn to ", ip, ":", port, " failed");
+      return Status::IOError("delegated read conn connect failed");
+    }
+    Status s =
+        cflevel_read_client_->register_client_in_get_service_request(conn,
+                                                                     true);
+    if (!s.ok()) {
+      return s;
+    }
+    memnode_of_conn_[conn] = memnode;
+    m->read_conns.enqueue(conn);
+    m->num_read_conns++;
+    DM_LOG_DEBUG("delegated read conn register_client_in_get_service_request: ",
+                 memnode, " ", i);
+  }
+
+  m->meta_conn = cflevel_client_->sock_connect(ip, port);
+  if (m->meta_conn == nullptr) {
+    DM_LOG_ERROR("meta_conn connect to ", ip, ":", port, " failed");
+    return Status::IOError("meta_conn connect failed");
+  }
+
+  m->gc_conn = cflevel_client_->sock_connect(ip, port);
+  if (m->gc_conn == nullptr) {
+    DM_LOG_ERROR("gc_conn connect to ", ip, ":", port, " failed");
+    return Status::IOError("gc_conn connect failed");
+  }
+  // allocate mem for meta
+  auto meta_offset =
+      cflevel_client_->rdma_mem_.allocate(REMOTE_FLUSH_PACKAGE_SIZE);
+  if (meta_offset == -1) {
+    return Status::MemoryLimit("registered buffer exhausted");
+  }
+  char req_type = 9;
+  ASSERT_RW(writen(m->meta_conn.load()->sock,
+                   reinterpret_cast<void*>(&req_type),
+                   sizeof(char)) == sizeof(char));
+  auto remote_meta_reg = cflevel_client_->allocate_mem_request(
+      m->meta_conn, REMOTE_FLUSH_PACKAGE_SIZE);
+  if (remote_meta_reg.first == -1) {
+    return Status::MemoryLimit("memnode has no room for flush metadata");
+  }
+  m->rf_meta_local_offset = meta_offset;
+  m->rf_meta_remote_offset.first = remote_meta_reg.first;
+  m->rf_meta_remote_offset.second = remote_meta_reg.second;
+
+  // every memtable may go to any memnode
+  for (int i = 0; i < initial_cf_options_.max_write_buffer_number; i++) {
+    auto conn_ = cflevel_client_->sock_connect(ip, port);
+    if (conn_ == nullptr) {
+      DM_LOG_ERROR("memtable conn to ", ip, ":", port, " failed");
+      return Status::IOError("memtable conn connect failed");
+    }
+    auto local_index_offset =
+        cflevel_client_->rdma_mem_.allocate(MEMTABLE_INDEX_SIZE);
+    if (local_index_offset == -1) {
+      cflevel_client_->disconnect_request(conn_);
+      return Status::MemoryLimit("registered buffer exhausted");
+    }
+    char req_type = 1;
+    ASSERT_RW(writen(conn_->sock, reinterpret_cast<void*>(&req_type),
+                     sizeof(char)) == sizeof(char));
+    auto reg = cflevel_client_->allocate_mem_request(
+        conn_, MEMTABLE_INDEX_SIZE);  // reusable index buffer
+    if (reg.first == -1) {
+      cflevel_client_->rdma_mem_.free(local_index_offset);
+      cflevel_client_->disconnect_request(conn_);
+      return Status::MemoryLimit("memnode has no room for memtable index");
+    }
+    reginfo_->index_mp.insert({conn_, {local_index_offset, reg}});
+    memnode_of_conn_[conn_] = memnode;
+    std::lock_guard<std::mutex> lck(memtable_conn_mtx_);
+    m->memtable_conns.push(conn_);
+  }
+  return Status::OK();
+}
+
 ColumnFamilySet::ColumnFamilySet(const std::string& dbname,
                                  const ImmutableDBOptions* db_options,
                                  const FileOptions& file_options,
@@ -2169,7 +2440,10 @@ bool ColumnFamilyMemTablesImpl::Seek(uint32_t column_family_id) {
 
 uint64_t ColumnFamilyMemTablesImpl::GetLogNumber() const {
   assert(current_ != nullptr);
-  return current_->GetLogNumber();
+  // the WALs covered by the memtables reattached from the memnodes are
+  // skipped for this column family as if they were flushed
+  return std::max(current_->GetLogNumber(),
+                  current_->GetReattachedLogNumber());
 }
 
 MemTable* ColumnFamilyMemTablesImpl::GetMemTable() const {
@@ -13,7 +13,9 @@
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <queue>
 #include <string>
 #include <thread>
 #include <unordered_map>
@@ -25,9 +27,11 @@
 #include "db/table_properties_collector.h"
 #include "db/write_batch_internal.h"
 #include "db/write_controller.h"
+#include "memory/memnode_placement.h"
 #include "options/cf_options.h"
 #include "rocksdb/blockingconcurrentqueue.h"
 #include "rocksdb/compaction_job_stats.h"
+#include "rocksdb/core_pinned_queue.h"
 #include "rocksdb/db.h"
 #include "rocksdb/env.h"
 #include "rocksdb/file_system.h"
@@ -45,6 +49,7 @@ class VersionSet;
 class VersionStorageInfo;
 class MemTable;
 class MemTableListVersion;
+class MemTableShardPartitioner;
 class CompactionPicker;
 class Compaction;
 class InternalKey;
@@ -283,17 +288,41 @@ class ColumnFamilyData {
     std::map<RDMANode::rdma_connection*,
              std::pair<int64_t, std::pair<int64_t, int64_t>>>
         index_mp;
-    int64_t rf_meta_local_offset;
+  };
+  // connections of this column family to one of its memnodes
+  struct MemNodeConns {
+    std::pair<std::string, size_t> ip_port;
+    // remote flush jobs of the memtables offloaded here
+    std::atomic<RDMANode::rdma_connection*> meta_conn{nullptr};
+    int64_t rf_meta_local_offset = 0;
     std::pair<int64_t, int64_t> rf_meta_remote_offset;
+    // memtables dropped locally, deleted here once gc_conn gets to them
+    RDMANode::rdma_connection* gc_conn = nullptr;
+    std::queue<std::pair<uint64_t, uint64_t>> gc_queue;
+    // guarded by memtable_conn_mtx_
+    std::queue<RDMANode::rdma_connection*> memtable_conns;
+    // delegated reads, a connection is reused on the core that put it back
+    CorePinnedQueue<RDMANode::rdma_connection*> read_conns;
+    size_t num_read_conns = 0;
   };
   void register_imm_trans(MemTable* memtable, bool need_mark) {
+    if (memtable->get_conn().second == nullptr) {
+      // kept local, never offloaded
+      return;
+    }
     std::lock_guard<std::mutex> lck(imm_que_mtx);
     memtable->Ref();
     imm_que->enqueue({{memtable, memtable->get_conn().second},
                       {need_mark, std::chrono::high_resolution_clock::now()}});
   }
+  // newest memtable reads may look up on a memnode. A memtable kept local
+  // caps it, the offloaded memtables older than it stay a suffix of the
+  // memtable list and the newer ones are read from their local copy until
+  // it is deleted.
   uint64_t get_trans_mem_accumulated_id() {
-    return trans_mem_accumulated_id.load();
+    uint64_t acc = trans_mem_accumulated_id.load();
+    uint64_t spilled = spilled_memtables_.Oldest();
+    return spilled == UINT64_MAX ? acc : std::min(acc, spilled - 1);
   }
   Status background_schedule_imm_trans();
   Status flush_imm_trans();
@@ -303,7 +332,12 @@ class ColumnFamilyData {
   static void* UnPackLocal(TransferService* node);
   void PackRemote(TransferService* node) const;
   void UnPackRemote(TransferService* node);
-  Status init_cf_level_rdma_client(std::string& ip, int port);
+  Status init_cf_level_rdma_client(
+      const std::vector<std::pair<std::string, int>>& memnodes);
+  // asks every memnode for its free memory once the last answers are stale
+  void RefreshMemNodeCapacity();
+  // opens the connections of memnodes_[memnode]
+  Status connect_memnode(size_t memnode);
   inline built_memreg_info* get_built_memreg_info() { return reginfo_; }
 
  public:
@@ -578,27 +612,63 @@ class ColumnFamilyData {
   // Recover the next epoch number of this CF and epoch number
   // of its files (if missing)
   void RecoverEpochNumbers();
-  inline RDMANode::rdma_connection* try_get_meta_conn() {
-    return meta_conn_.exchange(nullptr);
+  inline size_t num_memnodes() const { return memnodes_.size(); }
+  inline MemNodeConns* memnode(size_t i) { return memnodes_[i].get(); }
+  // memnode the memtable was or will be offloaded to
+  size_t MemNodeOf(const MemTable& mem) const;
+  // how close the memnodes are to running out of memory for memtables
+  MemNodePlacement::Pressure MemNodePressure() const {
+    return memnode_placement_ != nullptr
+               ? memnode_placement_->GetPressure()
+               : MemNodePlacement::Pressure::kNone;
+  }
+  // some memtable was kept local because the memnodes were full, it has to
+  // be flushed from here
+  bool HasSpilledMemTables() const { return !spilled_memtables_.empty(); }
+  // tag the memtables of this db are shipped with, a restarted compute node
+  // of the same db lists its memtables on the memnodes by it
+  uint64_t MemNodeDbTag() const;
+  // Takes back the memtables an earlier run of this db left on the memnodes
+  // as the oldest immutable memtables, see DBOptions::memnode_warm_restart.
+  // Only a chain of them covering the WALs from the log number of this
+  // column family on without a gap is kept, the WALs it covers are not
+  // replayed for it. The others go to the memnode gc, all of them if the
+  // column family does not use a remote flush. max_sealed is raised
+  // to the last sequence number of the db when the newest kept one was
+  // sealed.
+  // REQUIRES: DB mutex held, before the WALs are replayed
+  Status ReattachRemoteMemTables(SequenceNumber* max_sealed);
+  // some memtable taken back by ReattachRemoteMemTables() is not flushed,
+  // only a remote flush can get to it
+  // REQUIRES: DB mutex held
+  bool HasReattachedMemTables() const;
+  // WALs older than this are covered by the reattached memtables, 0 if none
+  uint64_t GetReattachedLogNumber() const { return reattached_log_number_; }
+  uint64_t GetReattachedMemTableID() const { return reattached_memtable_id_; }
+  // prefix of the keys of this column family in
+  // DBOptions::delegated_read_cache, empty without one
+  const std::string& DelegatedReadCacheId() const {
+    return delegated_read_cache_id_;
+  }
+  inline RDMANode::rdma_connection* try_get_meta_conn(size_t memnode) {
+    return memnodes_[memnode]->meta_conn.exchange(nullptr);
   }
-  inline void putback_meta_conn(RDMANode::rdma_connection* conn) {
-    meta_conn_.store(conn);
+  inline void putback_meta_conn(size_t memnode,
+                                RDMANode::rdma_connection* conn) {
+    memnodes_[memnode]->meta_conn.store(conn);
   }
   inline RDMAClient* get_cflevel_client() { return cflevel_client_; }
   inline RDMAReadClient* get_cflevel_read_client() {
     return cflevel_read_client_;
   }
-  inline RDMANode::rdma_connection* get_cflevel_read_connection() {
+  inline RDMANode::rdma_connection* get_cflevel_read_connection(
+      size_t memnode) {
     RDMANode::rdma_connection* ptr = nullptr;
-    while (ptr == nullptr) {
-      LOG("waiting for cflevel read connection");
-      delegated_read_conns_.wait_dequeue_timed(ptr,
-                                               std::chrono::microseconds(1));
-    }
+    memnodes_[memnode]->read_conns.wait_dequeue(ptr);
     return ptr;
   }
   inline void put_cflevel_read_connection(RDMANode::rdma_connection* conn) {
-    delegated_read_conns_.enqueue(conn);
+    memnodes_[memnode_of_conn_.at(conn)]->read_conns.enqueue(conn);
   }
 
  private:
@@ -704,29 +774,35 @@ class ColumnFamilyData {
   bool mempurge_used_;
 
   std::atomic<uint64_t> next_epoch_number_;
-  std::atomic<RDMANode::rdma_connection*> meta_conn_;
 
-  std::queue<RDMANode::rdma_connection*>
-      memtable_conn_;  // available connection queue
+  std::vector<std::unique_ptr<MemNodeConns>> memnodes_;
+  // memnode of every memtable and read connection, fixed once connected
+  std::unordered_map<RDMANode::rdma_connection*, size_t> memnode_of_conn_;
+  std::unique_ptr<MemNodePlacement> memnode_placement_;
+  // memtables kept local because no memnode had room for them
+  SpilledMemTables spilled_memtables_;
+  // newest memtable ReattachRemoteMemTables() took back and the next log
+  // number it was sealed with
+  uint64_t reattached_memtable_id_ = 0;
+  uint64_t reattached_log_number_ = 0;
+  std::string delegated_read_cache_id_;
   std::mutex memtable_conn_mtx_;
   std::vector<std::thread*> memtable_thread;
   std::atomic<uint64_t> trans_mem_accumulated_id;
+  // partitioner of the next memtable, relearnt each time one is sealed
+  std::shared_ptr<MemTableShardPartitioner> shard_partitioner_;
+  // user keys sampled per shard when relearning the partitioner
+  static constexpr size_t kShardSampleKeys = 64;
   moodycamel::BlockingConcurrentQueue<std::pair<
       std::pair<MemTable*, RDMANode::rdma_connection*>,
       std::pair<bool, std::chrono::high_resolution_clock::time_point>>>*
       imm_que;
-  RDMANode::rdma_connection* gc_conn_{nullptr};
-  std::queue<std::pair<uint64_t, uint64_t>> gc_queue_;
   std::thread* gc_thread_{nullptr};
   RDMAReadClient* cflevel_read_client_{nullptr};
-  // std::vector<std::atomic<RDMANode::rdma_connection*>> delegated_read_conns_
-  moodycamel::BlockingConcurrentQueue<RDMANode::rdma_connection*>
-      delegated_read_conns_;
 
   RDMAClient* cflevel_client_{nullptr};
   built_memreg_info* reginfo_{nullptr};
   std::mutex imm_que_mtx;
-  std::pair<std::string, size_t>* memtable_ip_port{nullptr};
   std::atomic<bool> should_drop{false};
 };
 
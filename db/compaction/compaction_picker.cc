@@ -57,8 +57,17 @@ bool FindIntraL0Compaction(const std::vector<FileMetaData*>& level_files,
     }
     compact_bytes_per_del_file = new_compact_bytes_per_del_file;
   }
+  // The output takes the smallest epoch number of its inputs, so a sorted
+  // run of several L0 files with one epoch number is compacted whole or not
+  // at all.
+  while (limit > start && limit < level_files.size() &&
+         level_files[limit]->epoch_number != kUnknownEpochNumber &&
+         level_files[limit]->epoch_number ==
+             level_files[limit - 1]->epoch_number) {
+    --limit;
+  }
 
-  if ((limit - start) >= min_files_to_compact &&
+  if (limit > start && (limit - start) >= min_files_to_compact &&
       compact_bytes_per_del_file < max_compact_bytes_per_del_file) {
     assert(comp_inputs != nullptr);
     comp_inputs->level = 0;
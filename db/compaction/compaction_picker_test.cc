@@ -2870,6 +2870,44 @@ TEST_F(CompactionPickerTest, IntraL0MaxCompactionBytesHit) {
   ASSERT_EQ(0, compaction->output_level());
 }
 
+TEST_F(CompactionPickerTest, IntraL0KeepsEpochRunWhole) {
+  // L0 files sharing an epoch number are the range-disjoint outputs of one
+  // sharded flush. Intra L0 compaction must not take only some of them.
+  mutable_cf_options_.level0_file_num_compaction_trigger = 3;
+  mutable_cf_options_.max_compaction_bytes = 1199999u;
+  NewVersionStorage(6, kCompactionStyleLevel);
+
+  // max_compaction_bytes stops the pick after 5 files, between the two files
+  // of epoch 3, so only the 4 newer files are picked.
+  const Slice kNoTs;
+  Add(0, 1U, "100", "150", 200000U, 0, 112, 113, 0, false,
+      Temperature::kUnknown, kUnknownOldestAncesterTime, kNoTs, kNoTs, 7);
+  Add(0, 2U, "151", "200", 200000U, 0, 110, 111, 0, false,
+      Temperature::kUnknown, kUnknownOldestAncesterTime, kNoTs, kNoTs, 6);
+  Add(0, 3U, "201", "250", 200000U, 0, 108, 109, 0, false,
+      Temperature::kUnknown, kUnknownOldestAncesterTime, kNoTs, kNoTs, 5);
+  Add(0, 4U, "251", "300", 200000U, 0, 106, 107, 0, false,
+      Temperature::kUnknown, kUnknownOldestAncesterTime, kNoTs, kNoTs, 4);
+  Add(0, 5U, "100", "200", 200000U, 0, 104, 105, 0, false,
+      Temperature::kUnknown, kUnknownOldestAncesterTime, kNoTs, kNoTs, 3);
+  Add(0, 6U, "201", "300", 200000U, 0, 102, 103, 0, false,
+      Temperature::kUnknown, kUnknownOldestAncesterTime, kNoTs, kNoTs, 3);
+  Add(0, 7U, "100", "300", 200000U, 0, 100, 101, 0, false,
+      Temperature::kUnknown, kUnknownOldestAncesterTime, kNoTs, kNoTs, 2);
+  Add(1, 8U, "100", "350", 200000U, 0, 98, 99);
+  vstorage_->LevelFiles(1)[0]->being_compacted = true;
+  UpdateVersionStorageInfo();
+
+  std::unique_ptr<Compaction> compaction(level_compaction_picker.PickCompaction(
+      cf_name_, mutable_cf_options_, mutable_db_options_, vstorage_.get(),
+      &log_buffer_));
+  ASSERT_TRUE(compaction.get() != nullptr);
+  ASSERT_EQ(1U, compaction->num_input_levels());
+  ASSERT_EQ(4U, compaction->num_input_files(0));
+  ASSERT_EQ(4U, compaction->input(0, 3)->fd.GetNumber());
+  ASSERT_EQ(0, compaction->output_level());
+}
+
 TEST_F(CompactionPickerTest, UniversalMarkedCompactionFullOverlap) {
   const uint64_t kFileSize = 100000;
 
@@ -0,0 +1,287 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "db/column_family.h"
+#include "db/db_test_util.h"
+#include "db/read_callback.h"
+#include "port/stack_trace.h"
+#include "rocksdb/advanced_cache.h"
+#include "test_util/testutil.h"
+#include "utilities/merge_operators.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+// Counts what GetFromList() asks DBOptions::delegated_read_cache for. A
+// Get answered by the cache is a lookup without an insert after it.
+class CountingCache : public CacheWrapper {
+ public:
+  using CacheWrapper::CacheWrapper;
+
+  const char* Name() const override { return "CountingCache"; }
+
+  Status Insert(const Slice& key, ObjectPtr value,
+                const CacheItemHelper* helper, size_t charge,
+                Handle** handle = nullptr,
+                Priority priority = Priority::LOW) override {
+    inserts_++;
+    return target_->Insert(key, value, helper, charge, handle, priority);
+  }
+
+  Handle* Lookup(const Slice& key, const CacheItemHelper* helper,
+                 CreateContext* create_context,
+                 Priority priority = Priority::LOW,
+                 Statistics* stats = nullptr) override {
+    lookups_++;
+    return target_->Lookup(key, helper, create_context, priority, stats);
+  }
+
+  int lookups() const { return lookups_.load(); }
+  int inserts() const { return inserts_.load(); }
+
+ private:
+  std::atomic<int> lookups_{0};
+  std::atomic<int> inserts_{0};
+};
+
+// sees everything up to the snapshot of the read
+class AllVisibleReadCallback : public ReadCallback {
+ public:
+  AllVisibleReadCallback() : ReadCallback(kMaxSequenceNumber) {}
+  bool IsVisibleFullCheck(SequenceNumber /*seq*/) override { return true; }
+};
+}  // anonymous namespace
+
+// Gets of keys in the memtables on a memnode in the test process, with the
+// answers of the memnode cached.
+class DBDelegatedReadCacheTest : public DBTestBase {
+ public:
+  DBDelegatedReadCacheTest()
+      : DBTestBase("db_delegated_read_cache_test", /*env_do_fsync=*/false) {
+    // the memnode tells memtables apart by column family and id only, what
+    // one test leaves there must not reach the next
+    AddShmMemNode();
+  }
+
+  Options CacheOptions() {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.disable_auto_compactions = true;
+    options.max_write_buffer_number = 10;
+    options.max_local_write_buffer_number = 2;
+    // nothing is flushed while the test reads
+    options.min_write_buffer_number_to_merge = 8;
+    cache_ = std::make_shared<CountingCache>(NewLRUCache(1 << 20));
+    options.delegated_read_cache = cache_;
+    return options;
+  }
+
+  ColumnFamilyData* cfd() {
+    return static_cast_with_check<ColumnFamilyHandleImpl>(
+               db_->DefaultColumnFamily())
+        ->cfd();
+  }
+
+  // Seals the memtable written so far and two more after it, the oldest of
+  // them is then only read on the memnode.
+  void SealRemote() {
+    ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+    for (int m = 0; m < 2; m++) {
+      ASSERT_OK(Put("local" + std::to_string(m), "v"));
+      ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+    }
+    uint64_t newest = cfd()->imm()->GetLatestMemTableID();
+    for (int i = 0; i < 1000; i++) {
+      if (cfd()->get_trans_mem_accumulated_id() >= newest) {
+        break;
+      }
+      env_->SleepForMicroseconds(10000);
+    }
+    ASSERT_GE(cfd()->get_trans_mem_accumulated_id(), newest);
+  }
+
+  std::shared_ptr<CountingCache> cache_;
+};
+
+TEST_F(DBDelegatedReadCacheTest, HitAndMiss) {
+  DestroyAndReopen(CacheOptions());
+  ASSERT_OK(Put("a", "va"));
+  ASSERT_OK(Put("b", "vb"));
+  ASSERT_OK(Delete("b"));
+  SealRemote();
+
+  // a miss asks the memnode and keeps its answer
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ(1, cache_->lookups());
+  ASSERT_EQ(1, cache_->inserts());
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ(2, cache_->lookups());
+  ASSERT_EQ(1, cache_->inserts());
+
+  // deletions and keys the memnode does not have are kept too
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("NOT_FOUND", Get("c"));
+  }
+  ASSERT_EQ(6, cache_->lookups());
+  ASSERT_EQ(3, cache_->inserts());
+
+  // a key found locally never gets to the cache
+  ASSERT_EQ("v", Get("local0"));
+  ASSERT_OK(Put("a", "va2"));
+  ASSERT_EQ("va2", Get("a"));
+  ASSERT_EQ(6, cache_->lookups());
+
+  // a newer memtable on the memnode is a new key
+  ASSERT_OK(Delete("a"));
+  SealRemote();
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ(8, cache_->lookups());
+  ASSERT_EQ(4, cache_->inserts());
+}
+
+TEST_F(DBDelegatedReadCacheTest, SnapshotRanges) {
+  DestroyAndReopen(CacheOptions());
+  const Snapshot* before = db_->GetSnapshot();
+  ASSERT_OK(Put("a", "va"));
+  const Snapshot* mid = db_->GetSnapshot();
+  // the memtable goes on past the snapshot
+  ASSERT_OK(Put("z", "vz"));
+  SealRemote();
+
+  // an answer below the last sequence number of the memtable holds for
+  // that snapshot only
+  ASSERT_EQ("va", Get("a", mid));
+  ASSERT_EQ("va", Get("a", mid));
+  ASSERT_EQ(2, cache_->lookups());
+  ASSERT_EQ(1, cache_->inserts());
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ(3, cache_->lookups());
+  ASSERT_EQ(2, cache_->inserts());
+
+  // one at or past it holds for every later snapshot, and for the earlier
+  // ones down to the version found
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ("va", Get("a", mid));
+  ASSERT_EQ(5, cache_->lookups());
+  ASSERT_EQ(2, cache_->inserts());
+
+  // not for one older than the version
+  ASSERT_EQ("NOT_FOUND", Get("a", before));
+  ASSERT_EQ(6, cache_->lookups());
+  ASSERT_EQ(3, cache_->inserts());
+  // a key the memnode does not have at that snapshot
+  ASSERT_EQ("NOT_FOUND", Get("a", before));
+  ASSERT_EQ(3, cache_->inserts());
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ(4, cache_->inserts());
+
+  db_->ReleaseSnapshot(mid);
+  db_->ReleaseSnapshot(before);
+}
+
+TEST_F(DBDelegatedReadCacheTest, OlderSnapshotAfterOverwrite) {
+  DestroyAndReopen(CacheOptions());
+  ASSERT_OK(Put("a", "v1"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(Put("a", "v2"));
+  SealRemote();
+
+  ASSERT_EQ("v2", Get("a"));
+  ASSERT_EQ("v2", Get("a"));
+  ASSERT_EQ(1, cache_->inserts());
+  // the cached version is newer than the snapshot
+  ASSERT_EQ("v1", Get("a", snapshot));
+  ASSERT_EQ(3, cache_->lookups());
+  ASSERT_EQ(2, cache_->inserts());
+  ASSERT_EQ("v1", Get("a", snapshot));
+  ASSERT_EQ(2, cache_->inserts());
+  // and the one kept for it is older than the latest
+  ASSERT_EQ("v2", Get("a"));
+  ASSERT_EQ(3, cache_->inserts());
+
+  db_->ReleaseSnapshot(snapshot);
+}
+
+TEST_F(DBDelegatedReadCacheTest, MergeOperandsBypass) {
+  Options options = CacheOptions();
+  options.merge_operator = MergeOperators::CreateStringAppendOperator();
+  DestroyAndReopen(options);
+  ASSERT_OK(Put("a", "1"));
+  ASSERT_OK(Merge("a", "2"));
+  ASSERT_OK(Put("b", "1"));
+  SealRemote();
+
+  // operands found on the memnode are merged on every Get
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("1,2", Get("a"));
+  }
+  ASSERT_EQ(2, cache_->lookups());
+  ASSERT_EQ(0, cache_->inserts());
+
+  // operands found locally are not asked about
+  ASSERT_OK(Merge("b", "2"));
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("1,2", Get("b"));
+  }
+  ASSERT_EQ(2, cache_->lookups());
+  ASSERT_EQ(0, cache_->inserts());
+}
+
+TEST_F(DBDelegatedReadCacheTest, RangeTombstoneBypass) {
+  DestroyAndReopen(CacheOptions());
+  ASSERT_OK(Put("a", "va"));
+  ASSERT_OK(Put("b", "vb"));
+  SealRemote();
+
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), db_->DefaultColumnFamily(), "a",
+                             "b"));
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("NOT_FOUND", Get("a"));
+  }
+  ASSERT_EQ(0, cache_->lookups());
+  ASSERT_EQ(0, cache_->inserts());
+  // not covered
+  ASSERT_EQ("vb", Get("b"));
+  ASSERT_EQ(1, cache_->inserts());
+}
+
+TEST_F(DBDelegatedReadCacheTest, ReadCallbackBypass) {
+  DestroyAndReopen(CacheOptions());
+  ASSERT_OK(Put("a", "va"));
+  SealRemote();
+
+  // a transaction read decides visibility on its own, the answer is not
+  // one for the snapshot alone
+  for (int i = 0; i < 2; i++) {
+    PinnableSlice value;
+    AllVisibleReadCallback callback;
+    DBImpl::GetImplOptions get_impl_options;
+    get_impl_options.column_family = db_->DefaultColumnFamily();
+    get_impl_options.value = &value;
+    get_impl_options.callback = &callback;
+    ASSERT_OK(dbfull()->GetImpl(ReadOptions(), "a", get_impl_options));
+    ASSERT_EQ("va", value.ToString());
+  }
+  ASSERT_EQ(0, cache_->lookups());
+  ASSERT_EQ(0, cache_->inserts());
+}
+
+// A Get with a timestamp is not cached either, but a comparator with
+// timestamps is not one the memnode index supports, so such memtables are
+// never offloaded and the bypass cannot be reached from here.
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
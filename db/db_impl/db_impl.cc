@@ -21,7 +21,9 @@
 
 #include "db/remote_flush_job.h"
 #include "db/tcprw.h"
+#include "memory/memnode_placement.h"
 #include "memory/remote_memtable_service.h"
+#include "memory/remote_shard_fetcher.h"
 #include "rocksdb/configurable.h"
 #include "rocksdb/memtablerep.h"
 #include "rocksdb/remote_flush_service.h"
@@ -175,6 +177,19 @@ void DumpSupportInfo(Logger* logger) {
 
   ROCKS_LOG_HEADER(logger, "DMutex implementation: %s", DMutex::kName());
 }
+
+// what the offloading paths run with, some of it taken from the environment
+void DumpDMInfo(const ImmutableDBOptions& db_options) {
+  Logger* logger = db_options.info_log.get();
+  ROCKS_LOG_HEADER(logger, "DM transport: %s",
+                   DefaultDMTransportName().c_str());
+  ROCKS_LOG_HEADER(logger, "Memnode read mode: %s",
+                   MemnodeReadModeName(DefaultMemnodeReadMode()));
+  for (const auto& memnode : ParseMemNodes(db_options.memnodes)) {
+    ROCKS_LOG_HEADER(logger, "Memnode: %s:%d", memnode.first.c_str(),
+                     memnode.second);
+  }
+}
 }  // namespace
 
 DBImpl::DBImpl(const DBOptions& options, const std::string& dbname,
@@ -311,6 +326,7 @@ DBImpl::DBImpl(const DBOptions& options, const std::string& dbname,
   immutable_db_options_.Dump(immutable_db_options_.info_log.get());
   mutable_db_options_.Dump(immutable_db_options_.info_log.get());
   DumpSupportInfo(immutable_db_options_.info_log.get());
+  DumpDMInfo(immutable_db_options_);
 
   max_total_wal_size_.store(mutable_db_options_.max_total_wal_size,
                             std::memory_order_relaxed);
@@ -324,48 +340,77 @@ void DBImpl::BackgroundCallRemoteFlush(
     struct RDMANode::rdma_connection* rdma_conn,
     std::pair<int64_t, int64_t> remote_seg,
     std::atomic<RDMANode::rdma_connection*>* rdma_conn_ret,
-    Env::Priority thread_pri) {
+    int64_t package_offset, Env::Priority thread_pri) {
   TEST_SYNC_POINT("DBImpl::BackgroundCallRemoteFlush:Start");
   std::chrono::high_resolution_clock::time_point tt =
       std::chrono::high_resolution_clock::now();
-  int64_t local_offset =
-      rdma_client->rdma_mem_.allocate(remote_seg.second - remote_seg.first);
-  assert(remote_seg.second - remote_seg.first == 98304);
-  assert(local_offset != -1);
+  assert(remote_seg.second - remote_seg.first == REMOTE_FLUSH_PACKAGE_SIZE);
   rdma_client->rdma_read(rdma_conn, remote_seg.second - remote_seg.first,
-                         local_offset, remote_seg.first);
+                         package_offset, remote_seg.first);
   ASSERT_RW(rdma_client->poll_completion(rdma_conn) == 0);
   std::chrono::high_resolution_clock::time_point tta =
       std::chrono::high_resolution_clock::now();
-  LOG_CERR(
+  DM_LOG_DEBUG(
       "fetch flush metadata:: ",
       std::chrono::duration_cast<std::chrono::microseconds>(tta - tt).count());
   char req_type = 2;
   ASSERT_RW(writen(rdma_conn->sock, &req_type, sizeof(char)) == sizeof(char));
   rdma_client->free_mem_request(rdma_conn, remote_seg.first,
                                 remote_seg.second - remote_seg.first);
-  RDMATransferService transfer_service(rdma_client, local_offset);
+  PackageReadService transfer_service(rdma_client->get_buf() + package_offset,
+                                      remote_seg.second - remote_seg.first);
+  if (!transfer_service.Valid()) {
+    // built by a compute node of another package version
+    rdma_conn_ret->store(rdma_conn);
+    bg_flush_scheduled_--;
+    bg_cv_.SignalAll();
+    return;
+  }
+
+  int flush_job_generator_port = 0;
+  transfer_service.receive(&flush_job_generator_port, sizeof(int));
+  size_t ip_size = 0;
+  transfer_service.receive(&ip_size, sizeof(size_t));
+  std::string flush_job_generator_ip_str;
+  if (ip_size > 0) {
+    flush_job_generator_ip_str.resize(ip_size);
+    transfer_service.receive(flush_job_generator_ip_str.data(), ip_size);
+  }
 
+  Status s;
   size_t memtable_size = 0;
   std::vector<MemTable*> tmp_memtables_;
   std::vector<RemoteMemTable*> tmp_memreps_;
   transfer_service.receive(&memtable_size, sizeof(size_t));
   std::chrono::high_resolution_clock::time_point tp =
       std::chrono::high_resolution_clock::now();
+  // the kv shards are read while the SSTs of the ones that arrived are
+  // built, conn and the package buffer it owns go back to the pool once the
+  // last shard is in and the package is decoded
+  auto conn_users = std::make_shared<std::atomic<int>>(2);
+  auto put_back_conn = [rdma_conn, rdma_conn_ret, conn_users]() {
+    if (conn_users->fetch_sub(1) == 1) rdma_conn_ret->store(rdma_conn);
+  };
+  std::unique_ptr<RemoteShardFetcher> shard_fetcher(
+      new RemoteShardFetcher(rdma_client, rdma_conn, put_back_conn));
   for (int i = 0; i < memtable_size; i++) {
     uint64_t mixed_id = 0;
     transfer_service.receive(&mixed_id, sizeof(uint64_t));
     void *index = nullptr, *meta = nullptr;
     uint64_t index_size = 0, meta_size = 0;
-    std::pair<void*, uint64_t> mem_data[4] = {
-        {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, {nullptr, 0}};
-    LOG_CERR("worker need to fetch memtable ", mixed_id);
+    std::pair<void*, uint64_t> mem_data[kMaxMemTableShards];
+    std::pair<int64_t, uint64_t> remote_data[kMaxMemTableShards];
+    DM_LOG_DEBUG("worker need to fetch memtable ", mixed_id);
     std::chrono::high_resolution_clock::time_point t0 =
         std::chrono::high_resolution_clock::now();
     char req_type = 10;
     ASSERT_RW(writen(rdma_conn->sock, &req_type, sizeof(char)) == sizeof(char));
-    rdma_client->fetch_memtable_request(rdma_conn, mixed_id, index, index_size,
-                                        meta, meta_size, mem_data);
+    s = rdma_client->locate_memtable_request(rdma_conn, mixed_id, index,
+                                             index_size, meta, meta_size,
+                                             remote_data);
+    if (!s.ok()) {
+      break;
+    }
     std::chrono::high_resolution_clock::time_point t1 =
         std::chrono::high_resolution_clock::now();
 
@@ -379,61 +424,65 @@ void DBImpl::BackgroundCallRemoteFlush(
     std::chrono::high_resolution_clock::time_point t2 =
         std::chrono::high_resolution_clock::now();
     tmp_memreps_.emplace_back(rep);
-    LOG_CERR(
+    shard_fetcher->Add(rep, remote_data);
+    DM_LOG_DEBUG(
         "fetch_memtable:: ", mixed_id, ' ',
         std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count(),
         ' ',
         std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count());
   }
+  if (s.ok()) {
+    shard_fetcher->Start();
+  } else {
+    // nothing to read, the fetcher never uses conn
+    put_back_conn();
+  }
+  rdma_conn = nullptr;
   std::chrono::high_resolution_clock::time_point tpa =
       std::chrono::high_resolution_clock::now();
-  LOG_CERR(
-      "fetch ", memtable_size, " memtables:: ",
+  DM_LOG_DEBUG(
+      "locate ", memtable_size, " memtables:: ",
       std::chrono::duration_cast<std::chrono::microseconds>(tpa - tp).count());
 
   // double pack
-  for (int i = 0; i < memtable_size; i++) {
-    auto* memtable = reinterpret_cast<MemTable*>(
-        MemTable::UnPackLocal(&transfer_service, tmp_memreps_[i]->memtable));
-    tmp_memtables_.emplace_back(memtable);
-  }
+  RemoteFlushJob* local_handler = nullptr;
+  if (s.ok()) {
+    for (int i = 0; i < memtable_size; i++) {
+      auto* memtable = reinterpret_cast<MemTable*>(
+          MemTable::UnPackLocal(&transfer_service, tmp_memreps_[i]->memtable));
+      tmp_memtables_.emplace_back(memtable);
+    }
 
-  auto* local_handler =
-      reinterpret_cast<RemoteFlushJob*>(RemoteFlushJob::UnPackLocal(
-          rdma_client, &transfer_service, this, tmp_memtables_));
+    local_handler =
+        reinterpret_cast<RemoteFlushJob*>(RemoteFlushJob::UnPackLocal(
+            rdma_client, &transfer_service, this, tmp_memtables_));
+    // nothing decoded keeps a view into the package
+    assert(transfer_service.Valid());
+  }
+  put_back_conn();
 
-  LOG_CERR("Start PreCheck");
-  LOG_CERR("Finish PreCheck");
+  DM_LOG_DEBUG("Start PreCheck");
+  DM_LOG_DEBUG("Finish PreCheck");
 
   // double pack finish
 
-  int flush_job_generator_port = 0;
-  transfer_service.receive(&flush_job_generator_port, sizeof(int));
-  size_t ip_size = 0;
-  transfer_service.receive(&ip_size, sizeof(size_t));
-  std::string flush_job_generator_ip_str;
-  if (ip_size > 0) {
-    flush_job_generator_ip_str.resize(ip_size);
-    transfer_service.receive(flush_job_generator_ip_str.data(), ip_size);
-  }
-
-  rdma_conn_ret->store(rdma_conn);
-  rdma_conn = nullptr;
-  rdma_client->rdma_mem_.free(local_offset);
-
   std::chrono::high_resolution_clock::time_point tpb =
       std::chrono::high_resolution_clock::now();
-  LOG_CERR(
+  DM_LOG_DEBUG(
       "unpackLocal:: ",
       std::chrono::duration_cast<std::chrono::microseconds>(tpb - tpa).count());
-  local_handler->RunLocal();
+  if (s.ok()) {
+    local_handler->SetShardFetcher(shard_fetcher.get());
+    s = local_handler->RunLocal();
+  }
+  shard_fetcher.reset();
   std::chrono::high_resolution_clock::time_point tpc =
       std::chrono::high_resolution_clock::now();
 
   TCPNode unpack_tcp_node({}, 0);
   if ((unpack_tcp_node.connection_info_.client_sockfd =
            socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-    LOG_CERR("socket creation error");
+    DM_LOG_ERROR("socket creation error");
     assert(false);
   }
   memset(reinterpret_cast<void*>(&unpack_tcp_node.connection_info_.sin_addr), 0,
@@ -443,30 +492,38 @@ void DBImpl::BackgroundCallRemoteFlush(
       htons(static_cast<uint16_t>(flush_job_generator_port));
   if (inet_pton(AF_INET, flush_job_generator_ip_str.c_str(),
                 &unpack_tcp_node.connection_info_.sin_addr.sin_addr) <= 0) {
-    LOG_CERR("Invalid address/ Address not supported");
+    DM_LOG_WARN("Invalid address/ Address not supported");
     assert(false);
   }
   if (connect(unpack_tcp_node.connection_info_.client_sockfd,
               reinterpret_cast<struct sockaddr*>(
                   &unpack_tcp_node.connection_info_.sin_addr),
               sizeof(unpack_tcp_node.connection_info_.sin_addr)) < 0) {
-    LOG_CERR("Connection Failed");
+    DM_LOG_ERROR("Connection Failed");
     assert(false);
   }
-  LOG_CERR("worker send update information to generator: ",
-           flush_job_generator_ip_str, ':', flush_job_generator_port);
+  DM_LOG_INFO("worker send update information to generator: ",
+              flush_job_generator_ip_str, ':', flush_job_generator_port);
 
   // double check
-  LOG_CERR("Start PostCheck");
-  LOG_CERR("Finish PostCheck");
+  DM_LOG_DEBUG("Start PostCheck");
+  DM_LOG_DEBUG("Finish PostCheck");
   // double check finish
 
   TCPTransferService local_transfer_service(&unpack_tcp_node);
-  local_handler->PackRemote(&local_transfer_service);
+  // the generator rolls the flush back unless the results follow
+  char worker_ok = s.ok() ? 1 : 0;
+  local_transfer_service.send(&worker_ok, sizeof(char));
+  if (s.ok()) {
+    local_handler->PackRemote(&local_transfer_service);
+  } else {
+    DM_LOG_WARN("remote flush given up: ", s.ToString());
+    if (local_handler != nullptr) local_handler->FreeUnpacked();
+  }
   close(unpack_tcp_node.connection_info_.client_sockfd);
   std::chrono::high_resolution_clock::time_point tpd =
       std::chrono::high_resolution_clock::now();
-  LOG_CERR(
+  DM_LOG_INFO(
       "finish meta feedback trans, start to do gc. send install info time:: ",
       std::chrono::duration_cast<std::chrono::microseconds>(tpd - tpc).count());
   for (size_t i = 0; i < tmp_memtables_.size(); i++)
@@ -479,9 +536,6 @@ void DBImpl::BackgroundCallRemoteFlush(
     delete it->prefix_extractor;
     rdma_client->rdma_mem_.free(it->index);
     rdma_client->rdma_mem_.free(it->meta);
-    for (auto& data : it->data) {
-      rdma_client->rdma_mem_.free(data.first);
-    }
     delete it;
   }
   tmp_memreps_.clear();
@@ -508,6 +562,7 @@ void DBImpl::BGWorkRemoteFlush(void* arg) {
       fta.sockfd_,
 #ifdef ROCKSDB_RDMA
       fta.rdma_client_, fta.rdma_conn_, fta.remote_seg_, fta.rdma_conn_ret_,
+      fta.package_offset_,
 #endif  // ROCKSDB_RDMA
       fta.thread_pri_);
   LOG("Remote flush job finished: ", fta.sockfd_);
@@ -530,11 +585,23 @@ Status DBImpl::ListenAndScheduleFlushJob(int port) {
   worker_node->rdma_mem_.init(worker_node->buf_size);
   listen_node->resources_create(1ull << 20);
   listen_node->rdma_mem_.init(listen_node->buf_size);
+  // every worker connection owns the buffer a package is read into, a job
+  // learns whom to report a failure to before it needs any memory
+  constexpr int kWorkerConns = 32;
+  std::vector<int64_t> packages(memnodes_ip_port_.size() * kWorkerConns);
+  for (auto& offset : packages) {
+    Status s = worker_node->rdma_mem_.allocate_wait(REMOTE_FLUSH_PACKAGE_SIZE,
+                                                    &offset);
+    if (!s.ok()) {
+      return s;
+    }
+  }
   std::vector<std::thread*> threads;
   for (auto& i : memnodes_ip_port_) {
-    auto wait_for_jobs = [this, worker_node, listen_node, &i] {
+    const int64_t* package = &packages[threads.size() * kWorkerConns];
+    auto wait_for_jobs = [this, worker_node, listen_node, &i, package] {
       int poll_ = 0;
-      std::atomic<RDMANode::rdma_connection*> worker_conn[32];
+      std::atomic<RDMANode::rdma_connection*> worker_conn[kWorkerConns];
       for (auto& j : worker_conn) {
         j = worker_node->sock_connect(i.first, i.second);
       }
@@ -554,8 +621,9 @@ Status DBImpl::ListenAndScheduleFlushJob(int port) {
             fta->remote_seg_ = remote_seg;
             fta->rdma_conn_ = chose;
             fta->rdma_client_ = worker_node;
+            fta->package_offset_ = package[poll_];
           }
-          poll_ = (poll_ + 1) % 32;
+          poll_ = (poll_ + 1) % kWorkerConns;
         }
 
         mutex_.Lock();
@@ -2164,7 +2232,8 @@ InternalIterator* DBImpl::NewInternalIterator(
   // Collect all needed child iterators for immutable memtables
   if (s.ok()) {
     super_version->imm->AddIterators(read_options, &merge_iter_builder,
-                                     !read_options.ignore_range_deletions);
+                                     !read_options.ignore_range_deletions,
+                                     cfd->get_cflevel_read_client(), cfd);
   }
   TEST_SYNC_POINT_CALLBACK("DBImpl::NewInternalIterator:StatusCallback", &s);
   if (s.ok()) {
@@ -3276,7 +3345,10 @@ Status DBImpl::MultiGetImpl(
       super_version->mem->MultiGet(read_options, &range, callback,
                                    false /* immutable_memtable */);
       if (!range.empty()) {
-        super_version->imm->MultiGet(read_options, &range, callback);
+        ColumnFamilyData* cfd = super_version->cfd;
+        super_version->imm->MultiGet(read_options, &range, callback,
+                                     cfd->get_cflevel_read_client(),
+                                     cfd->GetID(), cfd);
       }
       if (!range.empty()) {
         lookup_current = true;
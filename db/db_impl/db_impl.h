@@ -1724,6 +1724,8 @@ class DBImpl : public DB {
     struct RDMANode::rdma_connection* rdma_conn_;
     std::atomic<RDMANode::rdma_connection*>* rdma_conn_ret_;
     std::pair<int64_t, int64_t> remote_seg_;
+    // registered buffer offset the package is read into, owned by conn
+    int64_t package_offset_;
 #endif
   };
 
@@ -2109,6 +2111,7 @@ class DBImpl : public DB {
       RDMAClient* rdma_client, struct RDMANode::rdma_connection* conn,
       std::pair<int64_t, int64_t> remote_seg,
       std::atomic<RDMANode::rdma_connection*>* rdma_conn_ret,
+      int64_t package_offset,
 #endif  // ROCKSDB_RDMA
       Env::Priority thread_pri);
   void BGListenRemoteFlush(RflushThreadArg* arg);
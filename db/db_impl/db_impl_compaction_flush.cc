@@ -222,7 +222,15 @@ Status DBImpl::FlushMemTableToOutputFile(
   // picking so that no new snapshot can be taken between the two functions.
   LOG("Construct flush job");
 
-  bool admit = true;
+  // memtables kept local are not on any memnode, flush them from here
+  bool admit = !cfd->HasSpilledMemTables();
+  if (!admit && cfd->HasReattachedMemTables()) {
+    // the memtables reattached after a restart are older than the spilled
+    // ones and only on the memnodes, flush them from there first
+    admit = true;
+    max_memtable_id =
+        std::min(max_memtable_id, cfd->GetReattachedMemTableID());
+  }
   // if (cfd->GetLatestCFOptions().server_use_remote_flush) {
   //   assert(pd_connection_client_ != nullptr);
   //   std::lock_guard<std::mutex> lck(pd_connection_client_->get_mutex());
@@ -233,7 +241,7 @@ Status DBImpl::FlushMemTableToOutputFile(
   // }
 
   if (cfd->GetLatestCFOptions().server_use_remote_flush && admit) {
-    LOG_CERR("Construct remote flush job");
+    DM_LOG_INFO("Construct remote flush job");
     std::shared_ptr<RemoteFlushJob> flush_job =
         RemoteFlushJob::CreateRemoteFlushJob(
             dbname_, cfd, immutable_db_options_, mutable_cf_options,
@@ -247,7 +255,7 @@ Status DBImpl::FlushMemTableToOutputFile(
             true /* sync_output_directory */, true /* write_manifest */,
             io_tracer_, seqno_time_mapping_, cfd->get_cflevel_client(), db_id_,
             db_session_id_, cfd->GetFullHistoryTsLow(), &blob_callback_);
-    FileMetaData file_meta[4];
+    FileMetaData file_meta[kMaxMemTableShards];
     LOG("RemoteFlushJob::CreateRemoteFlushJob thread_id:",
         std::this_thread::get_id(),
         "Create RemoteFlushJob: handle:", flush_job.get());
@@ -384,7 +392,7 @@ Status DBImpl::FlushMemTableToOutputFile(
           immutable_db_options_.sst_file_manager.get());
       if (sfm) {
         // Notify sst_file_manager that a new file was added
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < cfd->ioptions()->memtable_shard_num; i++) {
           std::string file_path = MakeTableFileName(
               cfd->ioptions()->cf_paths[0].path, file_meta[i].fd.GetNumber());
           // TODO (PR7798).  We should only add the file to the FileManager if
@@ -406,7 +414,7 @@ Status DBImpl::FlushMemTableToOutputFile(
     TEST_SYNC_POINT("DBImpl::FlushMemTableToOutputFile:Finish");
     return s;
   } else {
-    LOG_CERR("Construct traditional flush job");
+    DM_LOG_INFO("Construct traditional flush job");
     FlushJob flush_job(
         dbname_, cfd, immutable_db_options_, mutable_cf_options,
         max_memtable_id, file_options_for_compaction_, versions_.get(), &mutex_,
@@ -564,10 +572,11 @@ Status DBImpl::FlushMemTableToOutputFile(
     TEST_SYNC_POINT("DBImpl::FlushMemTableToOutputFile:Finish");
     a3 = std::chrono::system_clock::now();
     end = std::chrono::system_clock::now();
-    LOG_CERR("local flush::", std::chrono::duration<double>(a1 - start).count(),
-             std::chrono::duration<double>(a2 - a1).count(),
-             std::chrono::duration<double>(a3 - a2).count(),
-             std::chrono::duration<double>(end - a3).count());
+    DM_LOG_DEBUG("local flush::",
+                 std::chrono::duration<double>(a1 - start).count(),
+                 std::chrono::duration<double>(a2 - a1).count(),
+                 std::chrono::duration<double>(a3 - a2).count(),
+                 std::chrono::duration<double>(end - a3).count());
     return s;
   }
 }
@@ -2836,7 +2845,7 @@ void DBImpl::MaybeScheduleFlushOrCompaction() {
       FlushThreadArg* fta = new FlushThreadArg;
       fta->db_ = this;
       fta->thread_pri_ = Env::Priority::LOW;
-      LOG_CERR("schedule mixed flush");
+      DM_LOG_DEBUG("schedule mixed flush");
       env_->Schedule(&DBImpl::BGWorkFlush, fta, Env::Priority::LOW, this,
                      &DBImpl::UnscheduleFlushCallback);
       --unscheduled_flushes_;
@@ -2864,7 +2873,7 @@ void DBImpl::MaybeScheduleFlushOrCompaction() {
   while (bg_compaction_scheduled_ + bg_bottom_compaction_scheduled_ <
              bg_job_limits.max_compactions &&
          unscheduled_compactions_ > 0) {
-    LOG_CERR("schedule compaction");
+    DM_LOG_DEBUG("schedule compaction");
     CompactionArg* ca = new CompactionArg;
     ca->db = this;
     ca->compaction_pri_ = Env::Priority::LOW;
@@ -3237,14 +3246,14 @@ void DBImpl::BGWorkFlush(void* arg) {
   TEST_SYNC_POINT("DBImpl::BGWorkFlush:done");
   end = std::chrono::system_clock::now();
   std::chrono::duration<double> elapsed_seconds = end - start;
-  LOG_CERR("mixed flush time: ", elapsed_seconds.count());
+  DM_LOG_DEBUG("mixed flush time: ", elapsed_seconds.count());
 }
 
 void DBImpl::BGListenWorkFlush(void* arg) {
   RflushThreadArg fta = *(reinterpret_cast<RflushThreadArg*>(arg));
   std::chrono::system_clock::time_point start =
       std::chrono::system_clock::now();
-  LOG_CERR(
+  DM_LOG_DEBUG(
       "remote flush schedule time::",
       std::chrono::duration<double>(start - fta.trigger_rflush_time_).count());
   delete reinterpret_cast<RflushThreadArg*>(arg);
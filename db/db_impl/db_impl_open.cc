@@ -160,6 +160,16 @@ DBOptions SanitizeOptions(const std::string& dbname, const DBOptions& src,
     result.avoid_flush_during_recovery = false;
   }
 
+  // memtables taken back from the memnodes stay unflushed after the open,
+  // so the WALs they came from have to stay as well
+  if (result.memnode_warm_restart &&
+      (result.allow_2pc || !result.avoid_flush_during_recovery)) {
+    ROCKS_LOG_WARN(result.info_log,
+                   "memnode_warm_restart needs avoid_flush_during_recovery "
+                   "and no allow_2pc, replaying the WAL instead");
+    result.memnode_warm_restart = false;
+  }
+
   ImmutableDBOptions immutable_db_options(result);
   if (!immutable_db_options.IsWalDirSameAsDBPath()) {
     // Either the WAL dir and db_paths[0]/db_name are not the same, or we
@@ -1115,6 +1125,22 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& wal_numbers,
     min_wal_number =
         std::max(min_wal_number, versions_->MinLogNumberWithUnflushedData());
   }
+  // the memtables an earlier run left on the memnodes stand in for the WALs
+  // they cover, see DBOptions::memnode_warm_restart
+  const bool warm_restart =
+      immutable_db_options_.memnode_warm_restart && !read_only;
+  SequenceNumber max_reattached_seq = 0;
+  if (warm_restart) {
+    for (auto cfd : *versions_->GetColumnFamilySet()) {
+      if (cfd->num_memnodes() == 0) {
+        continue;
+      }
+      status = cfd->ReattachRemoteMemTables(&max_reattached_seq);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+  }
   for (auto wal_number : wal_numbers) {
     if (wal_number < min_wal_number) {
       ROCKS_LOG_INFO(immutable_db_options_.info_log,
@@ -1278,6 +1304,30 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& wal_numbers,
           // If this asserts, it means that InsertInto failed in
           // filtering updates to already-flushed column families
           assert(cfd->GetLogNumber() <= wal_number);
+          if (warm_restart) {
+            // sealed like a full memtable at runtime and offloaded, its WALs
+            // stay until it is flushed. Without a sealed sequence number it
+            // is not reattached again, the WAL it ends in is replayed whole.
+            MemTable* mem = cfd->mem();
+            mem->ConstructFragmentedRangeTombstones();
+            mem->SetNextLogNumber(wal_number);
+            autovector<MemTable*> to_delete;
+            cfd->imm()->Add(mem, &to_delete);
+            if (cfd->initial_cf_options().server_use_remote_flush ||
+                cfd->initial_cf_options().max_write_buffer_number >
+                    cfd->initial_cf_options().max_local_write_buffer_number) {
+              cfd->register_imm_trans(mem, true);
+            }
+            MemTable* new_mem = cfd->ConstructNewMemtable(
+                *cfd->GetLatestMutableCFOptions(), *next_sequence);
+            new_mem->SetCreationLogNumber(wal_number);
+            new_mem->Ref();
+            cfd->SetMemtable(new_mem);
+            for (MemTable* m : to_delete) {
+              delete m;
+            }
+            continue;
+          }
           auto iter = version_edits.find(cfd->GetID());
           assert(iter != version_edits.end());
           VersionEdit* edit = &iter->second;
@@ -1348,6 +1398,14 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& wal_numbers,
       versions_->SetLastSequence(last_sequence);
     }
   }
+  if (max_reattached_seq > versions_->LastSequence()) {
+    // new writes would reuse the sequence numbers of what the WALs lost
+    ROCKS_LOG_ERROR(immutable_db_options_.info_log,
+                    "Memtables reattached up to seq #%" PRIu64
+                    " but the WALs end at seq #%" PRIu64,
+                    max_reattached_seq, versions_->LastSequence());
+    return Status::Corruption("memnode memtables are ahead of the WALs");
+  }
   // Compare the corrupted log number to all columnfamily's current log number.
   // Abort Open() if any column family's log number is greater than
   // the corrupted log number, which means CF contains data beyond the point of
@@ -1432,6 +1490,10 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& wal_numbers,
         }
         data_seen = true;
       }
+      if (cfd->imm()->NumNotFlushed() > 0) {
+        // reattached or sealed while replaying, their WALs stay alive
+        data_seen = true;
+      }
 
       // Update the log number info in the version edit corresponding to this
       // column family. Note that the version edits will be written to MANIFEST
@@ -1441,7 +1503,8 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& wal_numbers,
       // recovered and should be ignored on next reincarnation.
       // Since we already recovered max_wal_number, we want all wals
       // with numbers `<= max_wal_number` (includes this one) to be ignored
-      if (flushed || cfd->mem()->GetFirstSequenceNumber() == 0) {
+      if ((flushed || cfd->mem()->GetFirstSequenceNumber() == 0) &&
+          cfd->imm()->NumNotFlushed() == 0) {
         edit->SetLogNumber(max_wal_number + 1);
       }
     }
@@ -2080,6 +2143,14 @@ Status DBImpl::Open(const DBOptions& db_options, const std::string& dbname,
     impl->opened_successfully_ = true;
     impl->DeleteObsoleteFiles();
     TEST_SYNC_POINT("DBImpl::Open:AfterDeleteFiles");
+    // the memtables reattached from the memnodes are flushed there first
+    for (auto cfd : *impl->versions_->GetColumnFamilySet()) {
+      if (cfd->HasReattachedMemTables()) {
+        FlushRequest flush_req;
+        impl->GenerateFlushRequest({cfd}, FlushReason::kOthers, &flush_req);
+        impl->SchedulePendingFlush(flush_req);
+      }
+    }
     impl->MaybeScheduleFlushOrCompaction();
   } else {
     persist_options_status.PermitUncheckedError();
@@ -2274,7 +2274,10 @@ Status DBImpl::SwitchMemtable(ColumnFamilyData* cfd, WriteContext* context) {
   }
 
   cfd->mem()->SetNextLogNumber(logfile_number_);
+  // shipped to the memnode with the memtable for a warm restart
+  cfd->mem()->SetSealedSequenceNumber(versions_->LastSequence());
   assert(new_mem != nullptr);
+  new_mem->SetCreationLogNumber(logfile_number_);
   cfd->imm()->Add(cfd->mem(), &context->memtables_to_free_);
   if (cfd->initial_cf_options().max_write_buffer_number >
       cfd->initial_cf_options().max_local_write_buffer_number) {
@@ -2282,6 +2285,11 @@ Status DBImpl::SwitchMemtable(ColumnFamilyData* cfd, WriteContext* context) {
   } else if (cfd->initial_cf_options().server_use_remote_flush) {
     cfd->register_imm_trans(cfd->mem(), true);
   }
+  if (cfd->MemNodePressure() >= MemNodePlacement::Pressure::kFlush) {
+    // flush the offloaded memtables, oldest first, while the memnodes still
+    // have room for the next ones
+    cfd->imm()->FlushRequested();
+  }
 
   new_mem->Ref();
   cfd->SetMemtable(new_mem);
@@ -0,0 +1,319 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "db/column_family.h"
+#include "db/db_test_util.h"
+#include "file/filename.h"
+#include "port/stack_trace.h"
+#include "rocksdb/convenience.h"
+#include "rocksdb/remote_flush_service.h"
+#include "test_util/sync_point.h"
+#include "test_util/testutil.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Warm restarts against a memnode in the test process. The memtables of a
+// run are left on the memnode as a crash would, the next open takes back
+// the ones it can and replays the WALs for the rest.
+class DBMemNodeWarmRestartTest : public DBTestBase {
+ public:
+  DBMemNodeWarmRestartTest()
+      : DBTestBase("db_memnode_warm_restart_test", /*env_do_fsync=*/false) {
+    // the memnode tells memtables apart by column family and id only, what
+    // one test leaves there must not reach the next
+    AddShmMemNode();
+  }
+
+  static constexpr int kKeysPerMemTable = 200;
+
+  Options WarmRestartOptions() {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.disable_auto_compactions = true;
+    options.write_buffer_size = 1 << 20;
+    options.max_write_buffer_number = 10;
+    options.max_local_write_buffer_number = 2;
+    // nothing is flushed while the test writes
+    options.min_write_buffer_number_to_merge = 8;
+    options.server_use_remote_flush = true;
+    options.avoid_flush_during_recovery = true;
+    options.memnode_warm_restart = true;
+    // the WALs a test deletes are not reported missing
+    options.track_and_verify_wals_in_manifest = false;
+    return options;
+  }
+
+  static std::string MemKey(int m, int i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "m%02d_key%06d", m, i);
+    return buf;
+  }
+  static std::string MemValue(int m, int i) {
+    return "value" + std::to_string(m) + "_" + std::to_string(i);
+  }
+
+  ColumnFamilyData* cfd() {
+    return static_cast_with_check<ColumnFamilyHandleImpl>(
+               db_->DefaultColumnFamily())
+        ->cfd();
+  }
+
+  void WriteMemTable(int m) {
+    for (int i = 0; i < kKeysPerMemTable; i++) {
+      ASSERT_OK(Put(MemKey(m, i), MemValue(m, i)));
+    }
+  }
+
+  // memtables first to first + count - 1, each in a WAL of its own, sealed
+  // and on the memnode
+  void WriteSealedMemTables(int first, int count) {
+    for (int m = first; m < first + count; m++) {
+      WriteMemTable(m);
+      ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+    }
+    uint64_t newest = cfd()->imm()->GetLatestMemTableID();
+    for (int i = 0; i < 1000; i++) {
+      if (cfd()->get_trans_mem_accumulated_id() >= newest) {
+        break;
+      }
+      env_->SleepForMicroseconds(10000);
+    }
+    ASSERT_GE(cfd()->get_trans_mem_accumulated_id(), newest);
+  }
+
+  void VerifyMemTable(int m) {
+    for (int i = 0; i < kKeysPerMemTable; i++) {
+      ASSERT_EQ(MemValue(m, i), Get(MemKey(m, i)));
+    }
+  }
+
+  // closes the db, the memnode keeps all its memtables
+  void Crash() {
+    SyncPoint::GetInstance()->SetCallBack(
+        "ColumnFamilyData::MemNodeGc:Keep",
+        [](void* arg) { *static_cast<bool*>(arg) = true; });
+    SyncPoint::GetInstance()->EnableProcessing();
+    Close();
+  }
+
+  // The reattached memtables are only flushed by a remote flush worker,
+  // which is not part of the test. The flush requested by the open is held
+  // back until background work is cancelled, the db only serves reads then.
+  Status WarmReopen(const Options& options) {
+    int threads = env_->GetBackgroundThreads(Env::HIGH);
+    std::vector<test::SleepingBackgroundTask> sleepers(threads);
+    for (auto& sleeper : sleepers) {
+      env_->Schedule(&test::SleepingBackgroundTask::DoSleepTask, &sleeper,
+                     Env::Priority::HIGH);
+      sleeper.WaitUntilSleeping();
+    }
+    Status s = TryReopen(options);
+    if (s.ok()) {
+      CancelAllBackgroundWork(db_, /*wait=*/false);
+    }
+    for (auto& sleeper : sleepers) {
+      sleeper.WakeUp();
+      sleeper.WaitUntilDone();
+    }
+    return s;
+  }
+
+  std::vector<uint64_t> WalNumbers() {
+    std::vector<std::string> files;
+    EXPECT_OK(env_->GetChildren(dbname_, &files));
+    std::vector<uint64_t> wals;
+    for (const auto& f : files) {
+      uint64_t number = 0;
+      FileType type;
+      if (ParseFileName(f, &number, &type) && type == kWalFile) {
+        wals.push_back(number);
+      }
+    }
+    std::sort(wals.begin(), wals.end());
+    return wals;
+  }
+};
+
+TEST_F(DBMemNodeWarmRestartTest, ReattachLinkedChain) {
+  Options options = WarmRestartOptions();
+  DestroyAndReopen(options);
+  WriteSealedMemTables(0, 4);
+  // only in the WAL
+  WriteMemTable(4);
+  Crash();
+
+  ASSERT_OK(WarmReopen(options));
+  ASSERT_EQ(4, cfd()->imm()->NumNotFlushed());
+  ASSERT_TRUE(cfd()->HasReattachedMemTables());
+  ASSERT_GT(cfd()->GetReattachedLogNumber(), 0U);
+  ASSERT_FALSE(cfd()->mem()->IsEmpty());
+  for (int m = 0; m <= 4; m++) {
+    VerifyMemTable(m);
+  }
+  // the reattached memtables are read through the memnode
+  std::unique_ptr<Iterator> iter(db_->NewIterator(ReadOptions()));
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(MemValue(count / kKeysPerMemTable, count % kKeysPerMemTable),
+              iter->value().ToString());
+    count++;
+  }
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(5 * kKeysPerMemTable, count);
+}
+
+TEST_F(DBMemNodeWarmRestartTest, WalsKeptForReattachedMemTables) {
+  Options options = WarmRestartOptions();
+  DestroyAndReopen(options);
+  WriteSealedMemTables(0, 3);
+  WriteMemTable(3);
+  std::vector<uint64_t> wals = WalNumbers();
+  ASSERT_GE(wals.size(), 4U);
+  Crash();
+
+  ASSERT_OK(WarmReopen(options));
+  ASSERT_EQ(3, cfd()->imm()->NumNotFlushed());
+  // not flushed, the WALs they cover are still live
+  ASSERT_LE(cfd()->GetLogNumber(), wals.front());
+  Close();
+  std::vector<uint64_t> after = WalNumbers();
+  for (uint64_t wal : wals) {
+    ASSERT_TRUE(std::find(after.begin(), after.end(), wal) != after.end())
+        << "WAL " << wal << " deleted";
+  }
+
+  // the WALs alone still hold everything
+  options.memnode_warm_restart = false;
+  Reopen(options);
+  ASSERT_EQ(0, cfd()->imm()->NumNotFlushed());
+  for (int m = 0; m <= 3; m++) {
+    VerifyMemTable(m);
+  }
+}
+
+TEST_F(DBMemNodeWarmRestartTest, GapFallsBackToWalReplay) {
+  Options options = WarmRestartOptions();
+  DestroyAndReopen(options);
+  WriteSealedMemTables(0, 4);
+  Crash();
+
+  // the second oldest memtable is lost, as on a memnode that is down
+  SyncPoint::GetInstance()->SetCallBack(
+      "ColumnFamilyData::ReattachRemoteMemTables:Listed", [](void* arg) {
+        auto* found = static_cast<
+            std::vector<std::pair<size_t, memtable_recovery_entry>>*>(arg);
+        ASSERT_EQ(4U, found->size());
+        std::vector<uint64_t> ids;
+        for (const auto& f : *found) {
+          ids.push_back(f.second.mixed_id & 0xffffffff);
+        }
+        std::sort(ids.begin(), ids.end());
+        found->erase(std::find_if(found->begin(), found->end(),
+                                  [&](const auto& f) {
+                                    return (f.second.mixed_id & 0xffffffff) ==
+                                           ids[1];
+                                  }));
+      });
+  ASSERT_OK(WarmReopen(options));
+  // the chain ends at the gap, the WALs after it are replayed
+  ASSERT_EQ(1, cfd()->imm()->NumNotFlushed());
+  for (int m = 0; m < 4; m++) {
+    VerifyMemTable(m);
+  }
+}
+
+TEST_F(DBMemNodeWarmRestartTest, StaleChainFallsBackToWalReplay) {
+  Options options = WarmRestartOptions();
+  DestroyAndReopen(options);
+  WriteSealedMemTables(0, 3);
+  Crash();
+
+  // a cold open flushes what the WALs hold, the memnode copies are stale
+  Options cold = options;
+  cold.memnode_warm_restart = false;
+  cold.avoid_flush_during_recovery = false;
+  Reopen(cold);
+  ASSERT_EQ(0, cfd()->imm()->NumNotFlushed());
+  ASSERT_GE(NumTableFilesAtLevel(0), 1);
+  Close();
+
+  ASSERT_OK(WarmReopen(options));
+  ASSERT_EQ(0, cfd()->imm()->NumNotFlushed());
+  ASSERT_FALSE(cfd()->HasReattachedMemTables());
+  ASSERT_EQ(0U, cfd()->GetReattachedLogNumber());
+  for (int m = 0; m < 3; m++) {
+    VerifyMemTable(m);
+  }
+}
+
+TEST_F(DBMemNodeWarmRestartTest, RangeDeletesEndTheChain) {
+  Options options = WarmRestartOptions();
+  DestroyAndReopen(options);
+  WriteSealedMemTables(0, 1);
+  // the fragmented tombstones are not on the memnode
+  WriteMemTable(1);
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), db_->DefaultColumnFamily(),
+                             MemKey(0, 50), MemKey(0, 100)));
+  ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+  WriteSealedMemTables(2, 1);
+  Crash();
+
+  ASSERT_OK(WarmReopen(options));
+  ASSERT_EQ(1, cfd()->imm()->NumNotFlushed());
+  for (int i = 0; i < kKeysPerMemTable; i++) {
+    if (i >= 50 && i < 100) {
+      ASSERT_EQ("NOT_FOUND", Get(MemKey(0, i)));
+    } else {
+      ASSERT_EQ(MemValue(0, i), Get(MemKey(0, i)));
+    }
+  }
+  VerifyMemTable(1);
+  VerifyMemTable(2);
+}
+
+TEST_F(DBMemNodeWarmRestartTest, ReattachedAheadOfWalsIsCorruption) {
+  Options options = WarmRestartOptions();
+  DestroyAndReopen(options);
+  WriteSealedMemTables(0, 3);
+  Crash();
+
+  // all but the oldest WAL are lost, the memnode copies are newer than
+  // anything left
+  std::vector<uint64_t> wals = WalNumbers();
+  ASSERT_GE(wals.size(), 3U);
+  for (size_t i = 1; i < wals.size(); i++) {
+    ASSERT_OK(env_->DeleteFile(LogFileName(dbname_, wals[i])));
+  }
+  Status s = WarmReopen(options);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+}
+
+TEST_F(DBMemNodeWarmRestartTest, LocalFlushReplaysWals) {
+  Options options = WarmRestartOptions();
+  options.server_use_remote_flush = false;
+  DestroyAndReopen(options);
+  WriteSealedMemTables(0, 3);
+  Crash();
+
+  // a local flush could not write out memtables without a local copy
+  Reopen(options);
+  ASSERT_FALSE(cfd()->HasReattachedMemTables());
+  ASSERT_EQ(0U, cfd()->GetReattachedLogNumber());
+  for (int m = 0; m < 3; m++) {
+    VerifyMemTable(m);
+  }
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
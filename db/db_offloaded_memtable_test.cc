@@ -0,0 +1,480 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "db/column_family.h"
+#include "db/db_test_util.h"
+#include "memory/remote_memtable_service.h"
+#include "port/stack_trace.h"
+#include "table/multiget_context.h"
+#include "test_util/testutil.h"
+#include "utilities/merge_operators.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Reads of memtables offloaded to memnodes in the test process.
+class DBOffloadedMemTableTest : public DBTestBase {
+ public:
+  DBOffloadedMemTableTest()
+      : DBTestBase("db_offloaded_memtable_test", /*env_do_fsync=*/false) {}
+
+  // the memnode tells memtables apart by column family and id only, every
+  // test starts its own
+  Options OffloadOptions(int memnodes = 1, size_t memnode_size = 1ull << 30) {
+    for (int i = 0; i < memnodes; i++) {
+      AddShmMemNode(memnode_size);
+    }
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.disable_auto_compactions = true;
+    options.max_write_buffer_number = 10;
+    options.max_local_write_buffer_number = 2;
+    // nothing is flushed while the test reads
+    options.min_write_buffer_number_to_merge = 8;
+    return options;
+  }
+
+  ColumnFamilyData* cfd() {
+    return static_cast_with_check<ColumnFamilyHandleImpl>(
+               db_->DefaultColumnFamily())
+        ->cfd();
+  }
+
+  // Seals the memtable written so far and two more after it, the oldest of
+  // them is then only read on the memnode.
+  void SealRemote() {
+    ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+    for (int m = 0; m < 2; m++) {
+      ASSERT_OK(Put("local" + std::to_string(m), "v"));
+      ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+    }
+    WaitOffloaded();
+  }
+
+  void WaitOffloaded() {
+    uint64_t newest = cfd()->imm()->GetLatestMemTableID();
+    for (int i = 0; i < 1000; i++) {
+      if (cfd()->get_trans_mem_accumulated_id() >= newest) {
+        break;
+      }
+      env_->SleepForMicroseconds(10000);
+    }
+    ASSERT_GE(cfd()->get_trans_mem_accumulated_id(), newest);
+  }
+
+  // what the db holds, forward and backward, as key=value pairs
+  std::vector<std::string> Scan(bool backward) {
+    std::vector<std::string> entries;
+    std::unique_ptr<Iterator> it(db_->NewIterator(ReadOptions()));
+    for (backward ? it->SeekToLast() : it->SeekToFirst(); it->Valid();
+         backward ? it->Prev() : it->Next()) {
+      entries.push_back(it->key().ToString() + "=" + it->value().ToString());
+    }
+    EXPECT_OK(it->status());
+    return entries;
+  }
+
+  static std::string RemoteKey(int i) { return "r" + Key(i); }
+  static std::string LocalKey(int i) { return "l" + Key(i); }
+};
+
+TEST_F(DBOffloadedMemTableTest, MultiGetSplitsLocalAndOffloaded) {
+  DestroyAndReopen(OffloadOptions());
+  for (int i = 0; i < 40; i++) {
+    ASSERT_OK(Put(RemoteKey(i), "remote" + std::to_string(i)));
+  }
+  SealRemote();
+  // newer versions of some offloaded keys in the local memtables
+  ASSERT_OK(Put(RemoteKey(0), "local_overwrite"));
+  ASSERT_OK(Delete(RemoteKey(1)));
+  for (int i = 0; i < 20; i++) {
+    ASSERT_OK(Put(LocalKey(i), "local" + std::to_string(i)));
+  }
+
+  std::vector<std::string> keys;
+  std::vector<std::string> expected;
+  for (int i = 0; i < 40; i++) {
+    keys.push_back(RemoteKey(i));
+    expected.push_back(i == 0   ? "local_overwrite"
+                       : i == 1 ? "NOT_FOUND"
+                                : "remote" + std::to_string(i));
+  }
+  for (int i = 0; i < 20; i++) {
+    keys.push_back(LocalKey(i));
+    expected.push_back("local" + std::to_string(i));
+  }
+  keys.push_back("missing");
+  expected.push_back("NOT_FOUND");
+
+  // only the keys the local memtables do not answer go to the memnode, in
+  // one request per MultiGet batch
+  std::atomic<int> delegated{0};
+  std::atomic<int> batches{0};
+  SyncPoint::GetInstance()->SetCallBack(
+      "MemTableListVersion::MultiGet:Delegated", [&](void* arg) {
+        delegated += static_cast<int>(
+            static_cast<std::vector<MultiGetRange::Iterator>*>(arg)->size());
+        batches++;
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+  ASSERT_EQ(expected, MultiGet(keys));
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+  ASSERT_EQ(38 + 1, delegated.load());
+  ASSERT_EQ(static_cast<int>((keys.size() + MultiGetContext::MAX_BATCH_SIZE -
+                              1) /
+                             MultiGetContext::MAX_BATCH_SIZE),
+            batches.load());
+
+  // the same answers one key at a time
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_EQ(expected[i], Get(keys[i]));
+  }
+}
+
+TEST_F(DBOffloadedMemTableTest, LargeKeysAndValues) {
+  DestroyAndReopen(OffloadOptions());
+  Random rnd(301);
+  // inline, just past the inline limit, and larger than the reply area
+  std::vector<size_t> sizes = {0, 10, imm_read_batch::kInlineValueLimit,
+                               imm_read_batch::kInlineValueLimit + 1, 4000,
+                               imm_read_batch::kRetAreaSize + 100, 60000};
+  std::map<std::string, std::string> expected;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    expected[RemoteKey(static_cast<int>(i))] =
+        rnd.RandomString(static_cast<int>(sizes[i]));
+  }
+  // keys of 1KB, a MultiGet of all of them does not fit one request area
+  for (int i = 0; i < 30; i++) {
+    expected[std::string(1000, 'k') + Key(i)] = rnd.RandomString(300);
+  }
+  for (const auto& kv : expected) {
+    ASSERT_OK(Put(kv.first, kv.second));
+  }
+  const std::string huge_key(imm_read_batch::kReqAreaSize + 1, 'h');
+  ASSERT_OK(Put(huge_key, "v"));
+  SealRemote();
+
+  for (const auto& kv : expected) {
+    ASSERT_EQ(kv.second, Get(kv.first));
+  }
+  std::vector<std::string> keys;
+  std::vector<std::string> values;
+  for (const auto& kv : expected) {
+    keys.push_back(kv.first);
+    values.push_back(kv.second);
+  }
+  ASSERT_EQ(values, MultiGet(keys));
+
+  // a key alone larger than the request area cannot be delegated
+  std::string value;
+  Status s = db_->Get(ReadOptions(), huge_key, &value);
+  ASSERT_TRUE(s.IsNotSupported()) << s.ToString();
+  std::vector<Slice> key_slices = {keys[0], huge_key};
+  std::vector<PinnableSlice> pinned(2);
+  std::vector<Status> statuses(2);
+  db_->MultiGet(ReadOptions(), db_->DefaultColumnFamily(), 2,
+                key_slices.data(), pinned.data(), statuses.data());
+  ASSERT_OK(statuses[0]);
+  ASSERT_EQ(values[0], pinned[0].ToString());
+  ASSERT_TRUE(statuses[1].IsNotSupported()) << statuses[1].ToString();
+}
+
+TEST_F(DBOffloadedMemTableTest, IterateForwardAndBackward) {
+  DestroyAndReopen(OffloadOptions());
+  Random rnd(301);
+  std::map<std::string, std::string> expected;
+  // enough entries for several batches, a few too large for the reply area
+  for (int i = 0; i < 600; i++) {
+    int len = i % 100 == 7 ? 40000 : i % 3 == 0 ? 500 : 20;
+    expected[RemoteKey(i)] = rnd.RandomString(len);
+    ASSERT_OK(Put(RemoteKey(i), expected[RemoteKey(i)]));
+  }
+  for (int i = 0; i < 600; i += 10) {
+    ASSERT_OK(Delete(RemoteKey(i)));
+    expected.erase(RemoteKey(i));
+  }
+  // range tombstones are read from the local fragmented list
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), db_->DefaultColumnFamily(),
+                             RemoteKey(300), RemoteKey(320)));
+  for (int i = 300; i < 320; i++) {
+    expected.erase(RemoteKey(i));
+  }
+  SealRemote();
+  expected["local0"] = "v";
+  expected["local1"] = "v";
+  // local versions shadow and interleave with the offloaded ones
+  for (int i = 1; i < 600; i += 50) {
+    expected[RemoteKey(i)] = "local" + std::to_string(i);
+    ASSERT_OK(Put(RemoteKey(i), expected[RemoteKey(i)]));
+    expected[LocalKey(i)] = "l";
+    ASSERT_OK(Put(LocalKey(i), "l"));
+  }
+  ASSERT_OK(Delete(RemoteKey(2)));
+  expected.erase(RemoteKey(2));
+
+  std::vector<std::string> forward;
+  for (const auto& kv : expected) {
+    forward.push_back(kv.first + "=" + kv.second);
+  }
+  std::vector<std::string> backward(forward.rbegin(), forward.rend());
+  ASSERT_EQ(forward, Scan(false));
+  ASSERT_EQ(backward, Scan(true));
+
+  std::unique_ptr<Iterator> it(db_->NewIterator(ReadOptions()));
+  it->Seek(RemoteKey(305));
+  ASSERT_TRUE(it->Valid());
+  ASSERT_EQ(RemoteKey(321), it->key().ToString());
+  // the local version of 301 is newer than the range tombstone
+  it->Prev();
+  ASSERT_TRUE(it->Valid());
+  ASSERT_EQ(RemoteKey(301), it->key().ToString());
+  it->Prev();
+  ASSERT_TRUE(it->Valid());
+  ASSERT_EQ(RemoteKey(299), it->key().ToString());
+  it->SeekForPrev(RemoteKey(100));
+  ASSERT_TRUE(it->Valid());
+  ASSERT_EQ(RemoteKey(99), it->key().ToString());
+  it->Next();
+  ASSERT_TRUE(it->Valid());
+  ASSERT_EQ(RemoteKey(101), it->key().ToString());
+  ASSERT_EQ(expected[RemoteKey(101)], it->value().ToString());
+  it->Seek(RemoteKey(107));
+  ASSERT_TRUE(it->Valid());
+  ASSERT_EQ(expected[RemoteKey(107)], it->value().ToString());
+  it->Seek("s");
+  ASSERT_FALSE(it->Valid());
+  ASSERT_OK(it->status());
+  it.reset();
+
+  // more scans than may prefetch at once, interleaved
+  std::vector<std::unique_ptr<Iterator>> its;
+  for (int i = 0; i < RDMAReadClient::kMaxPrefetchingScans + 4; i++) {
+    its.emplace_back(db_->NewIterator(ReadOptions()));
+    its.back()->SeekToFirst();
+  }
+  for (const auto& entry : forward) {
+    for (auto& iter : its) {
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(entry, iter->key().ToString() + "=" + iter->value().ToString());
+      iter->Next();
+    }
+  }
+  for (auto& iter : its) {
+    ASSERT_FALSE(iter->Valid());
+    ASSERT_OK(iter->status());
+  }
+}
+
+TEST_F(DBOffloadedMemTableTest, StreamMutableMemTable) {
+  Options options = OffloadOptions();
+  options.write_buffer_size = 8 << 20;
+  options.memtable_stream_to_remote = true;
+  DestroyAndReopen(options);
+
+  std::atomic<int> streamed{0};
+  SyncPoint::GetInstance()->SetCallBack(
+      "SepConcurrentArena::StreamCommittedRegions:Write",
+      [&](void*) { streamed++; });
+  SyncPoint::GetInstance()->EnableProcessing();
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 4000; i++) {
+    values.push_back(rnd.RandomString(1000));
+    ASSERT_OK(Put(RemoteKey(i), values.back()));
+  }
+  // whole regions go out while the memtable is still mutable
+  for (int i = 0; i < 1000 && streamed.load() == 0; i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_GT(streamed.load(), 0);
+  ASSERT_EQ(0, cfd()->imm()->NumNotFlushed());
+  SealRemote();
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+
+  // the memnode answers from the streamed regions and the shipped tail
+  for (int i = 0; i < 4000; i++) {
+    ASSERT_EQ(values[i], Get(RemoteKey(i)));
+  }
+  std::vector<std::string> scanned = Scan(false);
+  ASSERT_EQ(4000 + 2, scanned.size());
+  ASSERT_EQ(RemoteKey(3999) + "=" + values[3999], scanned.back());
+}
+
+TEST_F(DBOffloadedMemTableTest, FullMemNodeKeepsMemTablesLocal) {
+  // room for a couple of 1MB memtables next to the read slots
+  Options options = OffloadOptions(1, 64 << 20);
+  options.write_buffer_size = 1 << 20;
+  options.max_write_buffer_number = 20;
+  options.min_write_buffer_number_to_merge = 16;
+  DestroyAndReopen(options);
+
+  bool spilled = false;
+  bool pressure = false;
+  std::map<std::string, std::string> expected;
+  for (int m = 0; m < 12; m++) {
+    for (int i = 0; i < 20; i++) {
+      std::string key = Key(m * 100 + i);
+      expected[key] = "m" + std::to_string(m) + "v" + std::to_string(i);
+      ASSERT_OK(Put(key, expected[key]));
+    }
+    ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+    spilled |= cfd()->HasSpilledMemTables();
+    pressure |=
+        cfd()->MemNodePressure() != MemNodePlacement::Pressure::kNone;
+  }
+  // writers never waited for the memnode, the memtables it refused stayed
+  // here
+  ASSERT_TRUE(pressure);
+  ASSERT_TRUE(spilled);
+  for (const auto& kv : expected) {
+    ASSERT_EQ(kv.second, Get(kv.first));
+  }
+
+  // flushes free the memnode, memtables are offloaded again once it
+  // reclaimed their memory
+  ASSERT_OK(Flush());
+  for (int i = 0; i < 100 && cfd()->mem()->get_conn().second == nullptr;
+       i++) {
+    env_->SleepForMicroseconds(100000);
+    ASSERT_OK(Put("again", std::to_string(i)));
+    ASSERT_OK(Flush());
+  }
+  ASSERT_NE(nullptr, cfd()->mem()->get_conn().second);
+  ASSERT_OK(Put("offloaded", "v"));
+  ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+  ASSERT_EQ("v", Get("offloaded"));
+  for (const auto& kv : expected) {
+    ASSERT_EQ(kv.second, Get(kv.first));
+  }
+  // nothing stays local once the memnode has room for every memtable
+  for (int i = 0; i < 100 && cfd()->HasSpilledMemTables(); i++) {
+    ASSERT_OK(Flush());
+    env_->SleepForMicroseconds(100000);
+  }
+  ASSERT_FALSE(cfd()->HasSpilledMemTables());
+  ASSERT_EQ("v", Get("offloaded"));
+}
+
+TEST_F(DBOffloadedMemTableTest, MergeOperandsAcrossMemNodes) {
+  Options options = OffloadOptions(2);
+  options.merge_operator = MergeOperators::CreateStringAppendOperator();
+  DestroyAndReopen(options);
+  // the base of k2 is in an SST
+  ASSERT_OK(Put("k2", "sst"));
+  ASSERT_OK(Flush());
+
+  const std::string large(imm_read_batch::kInlineValueLimit * 2, 'x');
+  std::set<size_t> memnodes;
+  auto next_memtable = [&]() {
+    memnodes.insert(cfd()->MemNodeOf(*cfd()->mem()));
+    ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+  };
+  ASSERT_OK(Put("k1", "base"));
+  ASSERT_OK(Merge("k3", "old"));
+  next_memtable();
+  ASSERT_OK(Merge("k1", "a"));
+  ASSERT_OK(Merge("k2", "x"));
+  ASSERT_OK(Delete("k3"));
+  next_memtable();
+  ASSERT_OK(Merge("k1", large));
+  ASSERT_OK(Merge("k2", "y"));
+  ASSERT_OK(Merge("k3", "new"));
+  ASSERT_OK(Merge("k4", "only"));
+  SealRemote();
+  memnodes.insert(cfd()->MemNodeOf(*cfd()->mem()));
+  // the memtables of every key are spread over both memnodes
+  ASSERT_EQ(2, memnodes.size());
+
+  ASSERT_EQ("base,a," + large, Get("k1"));
+  ASSERT_EQ("sst,x,y", Get("k2"));
+  ASSERT_EQ("new", Get("k3"));
+  ASSERT_EQ("only", Get("k4"));
+  // operands found locally are applied on top of the offloaded ones
+  ASSERT_OK(Merge("k1", "local"));
+  ASSERT_OK(Merge("k4", "local"));
+  ASSERT_EQ("base,a," + large + ",local", Get("k1"));
+  ASSERT_EQ(std::vector<std::string>(
+                {"base,a," + large + ",local", "sst,x,y", "new", "only,local"}),
+            MultiGet({"k1", "k2", "k3", "k4"}));
+}
+
+TEST_F(DBOffloadedMemTableTest, ReadMergedRunOfMemTables) {
+  Options options = OffloadOptions();
+  options.merge_operator = MergeOperators::CreateStringAppendOperator();
+  DestroyAndReopen(options);
+
+  std::atomic<int> merged{0};
+  std::atomic<int> hits{0};
+  SyncPoint::GetInstance()->SetCallBack(
+      "RemoteMemTablePool::merge_column_family:Merged", [&](void* arg) {
+        merged += static_cast<int>(
+            static_cast<std::vector<uint64_t>*>(arg)->size());
+      });
+  SyncPoint::GetInstance()->SetCallBack("RemoteMemTablePool::get_merged:Hit",
+                                        [&](void*) { hits++; });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  const Snapshot* old_snapshot = nullptr;
+  std::map<std::string, std::string> expected;
+  for (int m = 0; m < 6; m++) {
+    for (int i = 0; i < 10; i++) {
+      // every memtable overwrites the keys of the one before it
+      std::string key = Key(i);
+      if (i % 3 == 0) {
+        ASSERT_OK(Merge(key, "m" + std::to_string(m)));
+        expected[key] += (expected[key].empty() ? "m" : ",m") +
+                         std::to_string(m);
+      } else {
+        ASSERT_OK(Put(key, "p" + std::to_string(m)));
+        expected[key] = "p" + std::to_string(m);
+      }
+    }
+    if (m == 2) {
+      old_snapshot = db_->GetSnapshot();
+      ASSERT_OK(Delete(Key(5)));
+      expected.erase(Key(5));
+    }
+    ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+  }
+  // merged before the memtables SealRemote() keeps local join the run,
+  // reads do not name those
+  WaitOffloaded();
+  for (int i = 0; i < 1000 && merged.load() == 0; i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_GE(merged.load(),
+            static_cast<int>(RemoteMemTablePool::kMergeMinMemTables));
+  SealRemote();
+
+  for (int i = 0; i < 10; i++) {
+    auto it = expected.find(Key(i));
+    ASSERT_EQ(it == expected.end() ? "NOT_FOUND" : it->second, Get(Key(i)));
+  }
+  ASSERT_GT(hits.load(), 0);
+
+  // a snapshot older than the run reads the memtables it was merged from
+  int hits_before = hits.load();
+  ASSERT_EQ("p2", Get(Key(5), old_snapshot));
+  ASSERT_EQ("m0,m1,m2", Get(Key(0), old_snapshot));
+  ASSERT_EQ(hits_before, hits.load());
+  db_->ReleaseSnapshot(old_snapshot);
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
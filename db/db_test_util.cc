@@ -9,7 +9,14 @@
 
 #include "db/db_test_util.h"
 
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 
 #include "cache/cache_reservation_manager.h"
 #include "db/forward_iterator.h"
@@ -18,6 +25,7 @@
 #include "rocksdb/cache.h"
 #include "rocksdb/convenience.h"
 #include "rocksdb/env_encryption.h"
+#include "rocksdb/remote_flush_service.h"
 #include "rocksdb/unique_id.h"
 #include "rocksdb/utilities/object_registry.h"
 #include "table/format.h"
@@ -350,6 +358,9 @@ Options DBTestBase::GetDefaultOptions() const {
   if (!env_->skip_fsync_) {
     options.track_and_verify_wals_in_manifest = true;
   }
+  for (int port : shm_memnodes_) {
+    options.memnodes.push_back("127.0.0.1:" + std::to_string(port));
+  }
   return options;
 }
 
@@ -371,6 +382,46 @@ Options DBTestBase::GetRemoteEnabledOptions() const {
   return options;
 }
 
+int DBTestBase::StartShmMemNode(size_t size) {
+  // a port nothing holds, the memnode binds it without SO_REUSEADDR
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  socklen_t len = sizeof(addr);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  EXPECT_GE(fd, 0);
+  EXPECT_EQ(0, bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+  EXPECT_EQ(0, getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len));
+  close(fd);
+  int port = ntohs(addr.sin_port);
+
+  setenv("ROCKSDB_DM_TRANSPORT", "shm", 1);
+  // never freed, it accepts connections until the process exits
+  auto* memnode = new RDMAServer();
+  EXPECT_EQ(0, memnode->resources_create(size));
+  std::thread([memnode, port]() { memnode->sock_connect("", port); }).detach();
+  // wait for the memnode to listen, the DBs connect on open. Probing the
+  // port with a socket could make its bind fail.
+  char listening[32];
+  snprintf(listening, sizeof(listening), ":%04X 00000000:0000 0A", port);
+  for (int i = 0; i < 500; i++) {
+    std::ifstream tcp("/proc/net/tcp");
+    std::string line;
+    bool found = false;
+    while (!found && std::getline(tcp, line)) {
+      found = line.find(listening) != std::string::npos;
+    }
+    if (found) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return port;
+}
+
+void DBTestBase::AddShmMemNode(size_t size) {
+  shm_memnodes_.push_back(StartShmMemNode(size));
+}
+
 Options DBTestBase::GetOptions(
     int option_config, const Options& default_options,
     const anon::OptionsOverride& options_override) const {
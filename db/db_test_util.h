@@ -1015,6 +1015,8 @@ class DBTestBase : public testing::Test {
 
   int option_config_;
   Options last_options_;
+  // ports of the memnodes of AddShmMemNode()
+  std::vector<int> shm_memnodes_;
 
   // Skip some options, as they may not be applicable to a specific test.
   // To add more skip constants, use values 4, 8, 16, etc.
@@ -1087,6 +1089,17 @@ class DBTestBase : public testing::Test {
   Options GetDefaultOptions() const;
   Options GetRemoteEnabledOptions() const;
 
+  // Starts a memnode with `size` bytes of registered memory in this
+  // process, which runs until the process exits. Nodes created from then on
+  // reach it over the shm transport. Returns the port it listens on.
+  static int StartShmMemNode(size_t size = 1ull << 30);
+
+  // Starts a memnode as above and has the DBs this test opens from then on
+  // offload their memtables to it and to the ones added before, through
+  // DBOptions::memnodes. A memnode tells memtables apart by column family
+  // and id only, so every test that offloads adds its own.
+  void AddShmMemNode(size_t size = 1ull << 30);
+
   Options GetOptions(int option_config) const {
     return GetOptions(option_config, GetDefaultOptions());
   }
@@ -0,0 +1,284 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+#include "db/delegated_memtable_iterator.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "db/column_family.h"
+#include "db/memtable.h"
+#include "db/pinned_iterators_manager.h"
+#include "memory/arena.h"
+#include "monitoring/perf_context_imp.h"
+#include "util/coding.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+class DelegatedMemTableIterator : public InternalIterator {
+ public:
+  DelegatedMemTableIterator(uint64_t mem_id, size_t memnode,
+                            RDMAReadClient* read_client, ColumnFamilyData* cfd)
+      : mem_id_(mem_id),
+        memnode_(memnode),
+        read_client_(read_client),
+        cfd_(cfd) {}
+  // No copying allowed
+  DelegatedMemTableIterator(const DelegatedMemTableIterator&) = delete;
+  void operator=(const DelegatedMemTableIterator&) = delete;
+
+  ~DelegatedMemTableIterator() override { CancelPrefetch(); }
+
+  bool Valid() const override { return pos_ < entries_.size() && status_.ok(); }
+  void Seek(const Slice& k) override { Request(kScanSeek, k, false); }
+  void SeekForPrev(const Slice& k) override {
+    Request(kScanSeekForPrev, k, true);
+  }
+  void SeekToFirst() override { Request(kScanFirst, Slice(), false); }
+  void SeekToLast() override { Request(kScanLast, Slice(), true); }
+  void Next() override {
+    PERF_COUNTER_ADD(next_on_memtable_count, 1);
+    assert(Valid());
+    if (backward_) {
+      std::string k = key().ToString();
+      Request(kScanAfter, k, false);
+      return;
+    }
+    Step();
+  }
+  void Prev() override {
+    PERF_COUNTER_ADD(prev_on_memtable_count, 1);
+    assert(Valid());
+    if (!backward_) {
+      std::string k = key().ToString();
+      Request(kScanBefore, k, true);
+      return;
+    }
+    Step();
+  }
+  Slice key() const override {
+    assert(Valid());
+    return entries_[pos_].first;
+  }
+  Slice value() const override {
+    assert(Valid());
+    return entries_[pos_].second;
+  }
+  Status status() const override { return status_; }
+  void SetPinnedItersMgr(PinnedIteratorsManager* pinned_iters_mgr) override {
+    pinned_iters_mgr_ = pinned_iters_mgr;
+  }
+  // a batch replaced while pinning is enabled is handed to the manager
+  bool IsKeyPinned() const override {
+    return pinned_iters_mgr_ != nullptr && pinned_iters_mgr_->PinningEnabled();
+  }
+  bool IsValuePinned() const override { return IsKeyPinned(); }
+
+ private:
+  static constexpr uint32_t kScanBatchEntries = 512;
+
+  // what the entries of a batch point into
+  struct BatchData {
+    std::string buf;
+    std::deque<std::string> fetched;
+  };
+  static void ReleaseBatchData(void* data) {
+    delete static_cast<BatchData*>(data);
+  }
+
+  // one entry further in the current direction, refills from the memnode
+  // when the batch is used up
+  void Step() {
+    pos_++;
+    if (pos_ < entries_.size() || exhausted_) {
+      return;
+    }
+    if (prefetching_) {
+      bool ok = read_client_->client_wait_batch_request(conn_, batch_);
+      prefetching_ = false;
+      read_client_->prefetching_scans_.fetch_sub(1);
+      Load(ok);
+    } else {
+      std::string k = entries_.back().first.ToString();
+      Request(backward_ ? kScanBefore : kScanAfter, k, backward_);
+    }
+  }
+
+  void Request(imm_scan_mode mode, const Slice& k, bool backward) {
+    PERF_TIMER_GUARD(seek_on_memtable_time);
+    PERF_COUNTER_ADD(seek_on_memtable_count, 1);
+    CancelPrefetch();
+    backward_ = backward;
+    Acquire();
+    Pack(mode, k);
+    Load(read_client_->client_send_batch_request_for_memtable_read(conn_,
+                                                                   batch_));
+  }
+
+  void Pack(imm_scan_mode mode, const Slice& k) {
+    batch_->op = kDelegatedScan;
+    batch_->num_keys = 1;
+    auto* req = reinterpret_cast<imm_scan_req*>(batch_->first_req());
+    req->mem_id = mem_id_;
+    req->mode = mode;
+    req->max_entries = kScanBatchEntries;
+    req->key_len = static_cast<uint32_t>(k.size());
+    assert(reinterpret_cast<char*>(req) +
+               imm_scan_req::record_size(k.size()) <=
+           batch_->req_end());
+    memcpy(req->key(), k.data(), k.size());
+    batch_->req_len = static_cast<uint32_t>(
+        reinterpret_cast<char*>(req) - reinterpret_cast<char*>(batch_) +
+        imm_scan_req::record_size(k.size()));
+  }
+
+  // decode the reply left in the slot, then either post the request for
+  // the following batch or give the slot back
+  void Load(bool ok) {
+    entries_.clear();
+    if (data_ != nullptr && pinned_iters_mgr_ != nullptr &&
+        pinned_iters_mgr_->PinningEnabled()) {
+      pinned_iters_mgr_->PinPtr(data_.release(), &ReleaseBatchData);
+    }
+    if (data_ == nullptr) {
+      data_.reset(new BatchData());
+    } else {
+      data_->buf.clear();
+      data_->fetched.clear();
+    }
+    pos_ = 0;
+    exhausted_ = true;
+    auto* ret = reinterpret_cast<imm_scan_ret*>(batch_->first_ret());
+    if (!ok) {
+      status_ = Status::IOError("delegated scan failed");
+    } else if (ret->status_code == Status::Code::kOk) {
+      status_ = Status::OK();
+    } else if (ret->status_code == Status::Code::kNotFound) {
+      status_ = Status::Corruption("offloaded memtable missing on memnode");
+    } else if (ret->status_code == Status::Code::kIncomplete) {
+      status_ = Status::Incomplete("delegated scan reply area exhausted");
+    } else {
+      status_ = Status::IOError("delegated scan rejected");
+    }
+    if (!status_.ok()) {
+      Release();
+      return;
+    }
+
+    exhausted_ = ret->exhausted;
+    data_->buf.assign(ret->entries(), ret->len);
+    const char* p = data_->buf.data();
+    const char* limit = p + data_->buf.size();
+    for (uint32_t i = 0; i < ret->num_entries; i++) {
+      uint32_t key_len = 0, value_len = 0;
+      p = GetVarint32Ptr(p, limit, &key_len);
+      if (p == nullptr || p + key_len > limit) break;
+      Slice k(p, key_len);
+      p += key_len;
+      p = GetVarint32Ptr(p, limit, &value_len);
+      if (p == nullptr || p + 1 > limit) break;
+      bool remote = *p++ != 0;
+      if (!remote) {
+        if (p + value_len > limit) break;
+        entries_.emplace_back(k, Slice(p, value_len));
+        p += value_len;
+        continue;
+      }
+      if (p + sizeof(imm_read_frag) > limit) break;
+      data_->fetched.emplace_back();
+      if (!read_client_->client_fetch_scattered_value(
+              conn_, batch_, reinterpret_cast<const imm_read_frag*>(p), 1,
+              value_len, &data_->fetched.back())) {
+        status_ = Status::IOError("delegated scan fetch failed");
+        break;
+      }
+      entries_.emplace_back(k, data_->fetched.back());
+      p += sizeof(imm_read_frag);
+    }
+    if (status_.ok() && entries_.size() != ret->num_entries) {
+      status_ = Status::Corruption("malformed delegated scan reply");
+    }
+    if (!status_.ok() || exhausted_ || entries_.empty()) {
+      exhausted_ = exhausted_ || entries_.empty();
+      Release();
+      return;
+    }
+
+    // read ahead on the slot and connection already held
+    if (read_client_->prefetching_scans_.fetch_add(1) >=
+        RDMAReadClient::kMaxPrefetchingScans) {
+      read_client_->prefetching_scans_.fetch_sub(1);
+      Release();
+      return;
+    }
+    Pack(backward_ ? kScanBefore : kScanAfter, entries_.back().first);
+    read_client_->client_post_batch_request(conn_, batch_);
+    prefetching_ = true;
+  }
+
+  void CancelPrefetch() {
+    if (!prefetching_) return;
+    read_client_->client_wait_batch_request(conn_, batch_);
+    prefetching_ = false;
+    read_client_->prefetching_scans_.fetch_sub(1);
+    Release();
+  }
+
+  void Acquire() {
+    assert(batch_ == nullptr && conn_ == nullptr);
+    size_t rr_offset = 0;
+    read_client_->available_read_reqs_.wait_dequeue(rr_offset);
+    batch_ =
+        reinterpret_cast<imm_read_batch*>(read_client_->get_buf() + rr_offset);
+    conn_ = cfd_->get_cflevel_read_connection(memnode_);
+  }
+
+  void Release() {
+    if (batch_ == nullptr) return;
+    read_client_->available_read_reqs_.enqueue(
+        reinterpret_cast<char*>(batch_) - read_client_->get_buf());
+    cfd_->put_cflevel_read_connection(conn_);
+    batch_ = nullptr;
+    conn_ = nullptr;
+  }
+
+  const uint64_t mem_id_;
+  // memnode the memtable was offloaded to
+  const size_t memnode_;
+  RDMAReadClient* read_client_;
+  ColumnFamilyData* cfd_;
+  Status status_;
+  PinnedIteratorsManager* pinned_iters_mgr_ = nullptr;
+  // current batch, in iteration order
+  std::unique_ptr<BatchData> data_;
+  std::vector<std::pair<Slice, Slice>> entries_;
+  size_t pos_ = 0;
+  bool backward_ = false;
+  bool exhausted_ = true;
+  // slot and connection, held only while a request is in flight
+  imm_read_batch* batch_ = nullptr;
+  RDMANode::rdma_connection* conn_ = nullptr;
+  bool prefetching_ = false;
+};
+}  // namespace
+
+InternalIterator* NewDelegatedMemTableIterator(const MemTable& mem,
+                                               RDMAReadClient* read_client,
+                                               ColumnFamilyData* cfd,
+                                               Arena* arena) {
+  assert(read_client != nullptr && cfd != nullptr);
+  void* mem_ptr =
+      arena != nullptr
+          ? arena->AllocateAligned(sizeof(DelegatedMemTableIterator))
+          : operator new(sizeof(DelegatedMemTableIterator));
+  return new (mem_ptr) DelegatedMemTableIterator(
+      mem.GetID(), cfd->MemNodeOf(mem), read_client, cfd);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
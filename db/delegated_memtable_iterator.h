@@ -0,0 +1,30 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+#pragma once
+
+#include <cstdint>
+
+#include "rocksdb/remote_flush_service.h"
+#include "table/internal_iterator.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+class Arena;
+class ColumnFamilyData;
+class MemTable;
+
+// Iterator over an offloaded memtable. Positioning and stepping run on the
+// memnode over the rebuilt MemTableRep, entries come back in batches of a
+// delegated read slot and the following batch is requested as soon as one
+// arrives. Keys and values are only valid until the iterator moves. Large
+// values are read one-sided from the memnode, mem has to stay referenced
+// for as long as the iterator lives, as it does under a SuperVersion.
+InternalIterator* NewDelegatedMemTableIterator(const MemTable& mem,
+                                               RDMAReadClient* read_client,
+                                               ColumnFamilyData* cfd,
+                                               Arena* arena);
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -139,17 +139,17 @@ void FlushJob::RecordFlushIOStats() {
 }
 
 void FlushJob::DoubleCheck(TransferService* node) {
-  LOG_CERR("RemoteFlushJob::DoubleCheck::versions_");
+  DM_LOG_DEBUG("RemoteFlushJob::DoubleCheck::versions_");
   for (auto mem : mems_) mem->DoubleCheck(node, nullptr);
   versions_->DoubleCheck(node);
-  LOG_CERR("RemoteFlushJob::DoubleCheck::edit_: ptr=",
-           reinterpret_cast<void*>(edit_));
+  DM_LOG_DEBUG("RemoteFlushJob::DoubleCheck::edit_: ptr=",
+               reinterpret_cast<void*>(edit_));
   if (edit_ != nullptr) edit_->DoubleCheck(node);
   cfd_->DoubleCheck(node);
-  LOG_CERR("RemoteFlushJob::DoubleCheck::base_: ptr=",
-           reinterpret_cast<void*>(base_));
+  DM_LOG_DEBUG("RemoteFlushJob::DoubleCheck::base_: ptr=",
+               reinterpret_cast<void*>(base_));
   if (base_ != nullptr) base_->DoubleCheck(node);
-  LOG_CERR("RemoteFlushJob::DoubleCheck::meta_");
+  DM_LOG_DEBUG("RemoteFlushJob::DoubleCheck::meta_");
   meta_.DoubleCheck(node);
 }
 
@@ -981,7 +981,7 @@ Status FlushJob::WriteLevel0Table(int sep) {
     TEST_SYNC_POINT_CALLBACK("FlushJob::WriteLevel0Table", &mems_);
     db_mutex_->Lock();
   }
-  // base_->Unref();
+  base_->Unref();
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
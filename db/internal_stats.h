@@ -180,7 +180,7 @@ class InternalStats {
     parse.append("\n");
     parse.append(std::to_string(per_key_placement_comp_stats_.count) + " ");
     parse.append("\n");
-    LOG_CERR("DoubleCheck:Internal:: ", parse);
+    DM_LOG_DEBUG("DoubleCheck:Internal:: ", parse);
   }
   void PackRemote(TransferService* node) const {
     node->send(db_stats_, sizeof(uint64_t) * kIntStatsNumMax);
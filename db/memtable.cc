@@ -56,6 +56,7 @@
 #include "rocksdb/logger.hpp"
 #include "rocksdb/memtablerep.h"
 #include "rocksdb/memtablerep_pack_factory.h"
+#include "rocksdb/memtable_shard_partitioner.h"
 #include "rocksdb/merge_operator.h"
 #include "rocksdb/remote_flush_service.h"
 #include "rocksdb/remote_transfer_service.h"
@@ -100,19 +101,40 @@ ImmutableMemTableOptions::ImmutableMemTableOptions(
       protection_bytes_per_key(
           mutable_cf_options.memtable_protection_bytes_per_key) {}
 
+namespace {
+// shard i only holds keys below shard i + 1 when the partitioner splits by
+// byte order and the memtable sorts the same way
+bool ShardsOrdered(const MemTableShardPartitioner* partitioner,
+                   const InternalKeyComparator& cmp) {
+  return partitioner != nullptr && partitioner->IsOrdered() &&
+         strcmp(cmp.user_comparator()->Name(),
+                BytewiseComparator()->Name()) == 0;
+}
+}  // namespace
+
 MemTable::MemTable(const InternalKeyComparator& cmp,
                    const ImmutableOptions& ioptions,
                    const MutableCFOptions& mutable_cf_options,
                    WriteBufferManager* write_buffer_manager,
                    SequenceNumber latest_seq, uint32_t column_family_id,
-                   RDMAClient* client, RDMANode::rdma_connection* conn)
+                   RDMAClient* client, RDMANode::rdma_connection* conn,
+                   std::shared_ptr<MemTableShardPartitioner> shard_partitioner)
     : comparator_(cmp),
       moptions_(ioptions, mutable_cf_options),
       refs_(0),
       kArenaBlockSize(Arena::OptimizeBlockSize(moptions_.arena_block_size)),
       mem_tracker_(write_buffer_manager),
       arena_(static_cast<BasicArena*>(new SepConcurrentArena(
-          mutable_cf_options.write_buffer_size, 4, client, conn))),
+          mutable_cf_options.write_buffer_size, ioptions.memtable_shard_num,
+          shard_partitioner ? shard_partitioner
+                            : ioptions.memtable_shard_partitioner,
+          ShardsOrdered(shard_partitioner ? shard_partitioner.get()
+                                          : ioptions.memtable_shard_partitioner
+                                                .get(),
+                        cmp),
+          client, conn,
+          ioptions.memtable_stream_to_remote &&
+              !ioptions.inplace_update_support))),
       table_(ioptions.memtable_factory->CreateMemTableRep(
           comparator_, arena_, mutable_cf_options.prefix_extractor.get(),
           ioptions.logger, column_family_id)),
@@ -171,7 +193,15 @@ MemTable::MemTable(const InternalKeyComparator& cmp,
                                                            new_cache.get()),
         std::memory_order_relaxed);
   }
-  conn_ = {client, conn};
+  auto* arena = static_cast<SepConcurrentArena*>(arena_);
+  // a memnode without room leaves the memtable on the compute node
+  conn_ = {client, arena->offloaded() ? conn : nullptr};
+  if (conn_.second != nullptr && write_buffer_manager != nullptr) {
+    write_buffer_manager_ = write_buffer_manager;
+    remote_charge_ = SepConcurrentArena::RemoteBytes(
+        mutable_cf_options.write_buffer_size, arena->shard_num());
+    write_buffer_manager_->ReserveRemoteMem(remote_charge_);
+  }
 }
 
 Status MemTable::SendToRemote(
@@ -179,11 +209,19 @@ Status MemTable::SendToRemote(
     const size_t local_index_offset,
     const std::pair<size_t, size_t>& remote_index_reg,
     const std::pair<std::string, size_t> memnode_ip_port, uint64_t cfd_id,
-    std::queue<std::pair<uint64_t, uint64_t>>* gc_queue, bool need_mark) {
+    uint64_t db_tag, std::queue<std::pair<uint64_t, uint64_t>>* gc_queue,
+    bool need_mark) {
   if (IsTransferCompleted()) {
     return Status::OK();
   }
-  LOG_CERR("Immutable memtable start SendToRemote: ", GetID());
+  DM_LOG_DEBUG("Immutable memtable start SendToRemote: ", GetID());
+  // written next to the skiplist index, which goes out with it
+  memtable_bloom_info bloom_info = RemoteBloomInfo();
+  memcpy(client->get_buf() + local_index_offset + MEMTABLE_INDEX_BLOOM,
+         &bloom_info, sizeof(bloom_info));
+  memtable_recovery_info recovery_info = RemoteRecoveryInfo(db_tag);
+  memcpy(client->get_buf() + local_index_offset + MEMTABLE_INDEX_RECOVERY,
+         &recovery_info, sizeof(recovery_info));
   Status s =
       table_->SendToRemote(client, memtable_conn, remote_index_reg,
                            local_index_offset, (cfd_id << 32) | GetID(), 0);
@@ -204,6 +242,147 @@ Status MemTable::SendToRemote(
   return s;
 }
 
+memtable_bloom_info MemTable::RemoteBloomInfo() const {
+  memtable_bloom_info info{0, 0, 0, kMemTableBloomNone, 0};
+  if (!bloom_filter_) {
+    return info;
+  }
+  auto* arena = static_cast<SepConcurrentArena*>(arena_);
+  const char* meta = reinterpret_cast<const char*>(arena->meta_begin());
+  const char* bits = bloom_filter_->data();
+  size_t bytes = size_t{bloom_filter_->len()} * sizeof(uint64_t);
+  if (bits < meta || bits + bytes > meta + arena->RawBlockSize()) {
+    return info;
+  }
+  info.offset = static_cast<uint64_t>(bits - meta);
+  info.len = bloom_filter_->len();
+  info.num_double_probes =
+      static_cast<uint8_t>(bloom_filter_->num_double_probes());
+  // Get() only checks whole keys when both filters are built
+  info.mode = moptions_.memtable_whole_key_filtering ? kMemTableBloomWholeKey
+                                                     : kMemTableBloomPrefix;
+  info.ts_sz = static_cast<uint16_t>(
+      GetInternalKeyComparator().user_comparator()->timestamp_size());
+  return info;
+}
+
+memtable_recovery_info MemTable::RemoteRecoveryInfo(uint64_t db_tag) const {
+  memtable_recovery_info info{};
+  info.db_tag = db_tag;
+  info.creation_log_number = creation_log_number_;
+  info.next_log_number = mem_next_logfile_number_;
+  info.first_seqno = first_seqno_.load(std::memory_order_relaxed);
+  info.earliest_seqno = earliest_seqno_.load(std::memory_order_relaxed);
+  info.sealed_seqno = sealed_seqno_;
+  info.num_entries = num_entries();
+  info.num_deletes = num_deletes();
+  info.data_size = get_data_size();
+  // the memnode does not keep the fragmented tombstones
+  if (!is_range_del_table_empty_.load(std::memory_order_relaxed)) {
+    info.flags |= kMemTableRecoveryRangeDeletes;
+  }
+  return info;
+}
+
+void MemTable::Reattach(
+    const memtable_recovery_info& info, uint64_t mixed_id,
+    std::pair<RDMAClient*, RDMANode::rdma_connection*> conn,
+    std::queue<std::pair<uint64_t, uint64_t>>* gc_queue) {
+  assert(IsEmpty() && !bloom_filter_);
+  first_seqno_.store(info.first_seqno, std::memory_order_relaxed);
+  earliest_seqno_.store(info.earliest_seqno, std::memory_order_relaxed);
+  creation_seq_ = info.earliest_seqno;
+  num_entries_.store(info.num_entries, std::memory_order_relaxed);
+  num_deletes_.store(info.num_deletes, std::memory_order_relaxed);
+  data_size_.store(info.data_size, std::memory_order_relaxed);
+  creation_log_number_ = info.creation_log_number;
+  mem_next_logfile_number_ = info.next_log_number;
+  sealed_seqno_ = info.sealed_seqno;
+  mixed_id_ = mixed_id;
+  gc_queue_ = gc_queue;
+  conn_ = conn;
+  reattached_ = true;
+  // the destructor hands mixed_id back to the memnode gc
+  table_->MarkReattached();
+  ConstructFragmentedRangeTombstones();
+}
+
+Status MemTable::OneSidedGet(const RemoteSkipListReader::Fetch& fetch,
+                             const LookupKey& key,
+                             SequenceNumber max_covering_tombstone_seq,
+                             imm_read_result* res, std::string* value) {
+  res->status_code = -1;
+  res->found_final_value = false;
+  res->seq = kMaxSequenceNumber;
+  value->clear();
+  const Comparator* user_comparator =
+      GetInternalKeyComparator().user_comparator();
+  if (user_comparator->timestamp_size() > 0) {
+    return Status::NotSupported("one-sided reads skip timestamped keys");
+  }
+  std::call_once(one_sided_once_, [this]() {
+    RemoteSkipListLayout layout;
+    if (table_->GetRemoteLayout(&layout)) {
+      one_sided_reader_.reset(new RemoteSkipListReader(layout, comparator_));
+    }
+  });
+  if (one_sided_reader_ == nullptr) {
+    return Status::NotSupported("memtable was not shipped as a skiplist");
+  }
+  std::string entry;
+  Status s = one_sided_reader_->Seek(fetch, key.memtable_key().data(),
+                                     moptions_.protection_bytes_per_key,
+                                     &entry);
+  if (!s.ok() || entry.empty()) {
+    return s;
+  }
+  // the rest mirrors RemoteSaveValue() on the memnode
+  s = VerifyEntryChecksum(entry.data(), moptions_.protection_bytes_per_key,
+                          moptions_.allow_data_in_errors);
+  if (!s.ok()) {
+    return s;
+  }
+  uint32_t key_length = 0;
+  const char* key_ptr =
+      GetVarint32Ptr(entry.data(), entry.data() + entry.size(), &key_length);
+  if (key_ptr == nullptr || key_length < 8) {
+    return Status::Corruption("bad remote memtable entry");
+  }
+  if (!user_comparator->Equal(Slice(key_ptr, key_length - 8),
+                              key.user_key())) {
+    return Status::OK();
+  }
+  ValueType type;
+  SequenceNumber seq;
+  UnPackSequenceAndType(DecodeFixed64(key_ptr + key_length - 8), &seq, &type);
+  res->seq = std::max(seq, max_covering_tombstone_seq);
+  if ((type == kTypeValue || type == kTypeDeletion ||
+       type == kTypeSingleDeletion) &&
+      max_covering_tombstone_seq > seq) {
+    type = kTypeRangeDeletion;
+  }
+  switch (type) {
+    case kTypeValue: {
+      Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+      value->assign(v.data(), v.size());
+      res->status_code = Status::Code::kOk;
+      res->found_final_value = true;
+      res->base_seq = res->seq;
+      return Status::OK();
+    }
+    case kTypeDeletion:
+    case kTypeSingleDeletion:
+    case kTypeRangeDeletion:
+      res->status_code = Status::Code::kNotFound;
+      res->found_final_value = true;
+      res->base_seq = res->seq;
+      return Status::OK();
+    default:
+      // merge operands, blob indexes and wide columns stay delegated
+      return Status::NotSupported("entry needs the memnode");
+  }
+}
+
 void MemTable::DoubleCheck(TransferService* node, MemTableRep* rep) {
   // LOG_CERR("DoubleCheck:: MemTable::data_size_");
   node->send(&data_size_, sizeof(uint64_t));
@@ -217,10 +396,10 @@ void MemTable::DoubleCheck(TransferService* node, MemTableRep* rep) {
   node->send(&flush_in_progress_, sizeof(bool));
   // LOG_CERR("DoubleCheck:: MemTable::flush_completed_");
   node->send(&flush_completed_, sizeof(bool));
-  LOG_CERR("DoubleCheck:: MemTable::file_number_", file_number_);
+  DM_LOG_DEBUG("DoubleCheck:: MemTable::file_number_", file_number_);
   node->send(&file_number_, sizeof(uint64_t));
-  LOG_CERR("DoubleCheck:: MemTable::edit_:: ptr = ",
-           reinterpret_cast<void*>(&edit_));
+  DM_LOG_DEBUG("DoubleCheck:: MemTable::edit_:: ptr = ",
+               reinterpret_cast<void*>(&edit_));
   edit_.DoubleCheck(node);
   // LOG_CERR("DoubleCheck:: MemTable::first_seqno_");
   node->send(&first_seqno_, sizeof(SequenceNumber));
@@ -234,7 +413,7 @@ void MemTable::DoubleCheck(TransferService* node, MemTableRep* rep) {
   node->send(&min_prep_log_referenced_, sizeof(uint64_t));
   // LOG_CERR("DoubleCheck:: MemTable::approximate_memory_usage_");
   node->send(&approximate_memory_usage_, sizeof(uint64_t));
-  LOG_CERR("DoubleCheck:: MemTable::flush_job_info_");
+  DM_LOG_DEBUG("DoubleCheck:: MemTable::flush_job_info_");
   // if (flush_job_info_ != nullptr) {
   //   node->send(&flush_job_info_->cf_id, sizeof(uint32_t));
   //   size_t cf_name_len = flush_job_info_->cf_name.size();
@@ -269,8 +448,8 @@ void MemTable::DoubleCheck(TransferService* node, MemTableRep* rep) {
 }
 
 void* MemTable::UnPackLocal(TransferService* node, MemTableRep* rep) {
-  LOG_CERR("start MemTable::UnPackLocal");
-  LOG_CERR("MemTable::VersionEdit UnpackLocal");
+  DM_LOG_DEBUG("start MemTable::UnPackLocal");
+  DM_LOG_DEBUG("MemTable::VersionEdit UnpackLocal");
   void* local_arena = rep->get_allocator();
   void* local_prefix_extractor = rep->get_prefix_extractor();
   void* local_comparator = rep->get_comparator();
@@ -359,7 +538,8 @@ void MemTable::PackRemote(TransferService* node) const {
 
 void MemTable::UnPackRemote(TransferService* node) {
   if (flush_job_info_ != nullptr) {
-    LOG_CERR("UnPackRemote:: flush_job_info_ is not nullptr, overwriting...");
+    DM_LOG_WARN(
+        "UnPackRemote:: flush_job_info_ is not nullptr, overwriting...");
   }
   flush_job_info_ = std::make_unique<FlushJobInfo>();
   LOG("MemTable::UnPackRemote start waiting read");
@@ -404,6 +584,12 @@ MemTable::~MemTable() {
       gc_queue_->push({mixed_id_, now_time});
     }
   }
+  if (remote_charge_ > 0) {
+    write_buffer_manager_->FreeRemoteMem(remote_charge_);
+  }
+  if (spilled_ != nullptr && id_ != 0) {
+    spilled_->Remove(id_);
+  }
   mem_tracker_.FreeMem();
   delete arena_;
   delete table_;
@@ -615,8 +801,8 @@ Slice MemTableRep::UserKey(const char* key) const {
 }
 
 KeyHandle MemTableRep::Allocate(const size_t len, char** buf, char** ptr_buf,
-                                const char* prefix) {
-  LOG_CERR("MemTableRep::Allocate should not be called");
+                                int shard) {
+  DM_LOG_WARN("MemTableRep::Allocate should not be called");
   *buf = allocator_->Allocate(len);
   return static_cast<KeyHandle>(*buf);
 }
@@ -650,7 +836,7 @@ class MemTableIterator : public InternalIterator {
     } else if (prefix_extractor_ != nullptr && !read_options.total_order_seek &&
                !read_options.auto_prefix_mode) {
       // Auto prefix mode is not implemented in memtable yet.
-      LOG_CERR("Auto prefix mode is not implemented in memtable yet.");
+      DM_LOG_WARN("Auto prefix mode is not implemented in memtable yet.");
       bloom_ = mem.bloom_filter_.get();
       iter_ = mem.table_->GetDynamicPrefixIterator(arena);
     } else {
@@ -1009,8 +1195,9 @@ Status MemTable::Add(SequenceNumber s, ValueType type,
   char* kv_buf = nullptr;
   MemTableRep*& table = type == kTypeRangeDeletion ? range_del_table_ : table_;
 
-  KeyHandle handle =
-      table->Allocate(encoded_len, &ptr_buf, &kv_buf, key.data());
+  auto* sep_arena = reinterpret_cast<SepConcurrentArena*>(arena_);
+  const int shard = sep_arena->Shard(key);
+  KeyHandle handle = table->Allocate(encoded_len, &ptr_buf, &kv_buf, shard);
   // LOG_CERR("DEBUG:", ' ', reinterpret_cast<int64_t>(kv_buf), ' ',
   //          reinterpret_cast<int64_t>(ptr_buf), ' ', internal_key_size, ' ',
   //          val_size);
@@ -1030,6 +1217,7 @@ Status MemTable::Add(SequenceNumber s, ValueType type,
   UpdateEntryChecksum(
       kv_prot_info, key, value, type, s,
       kv_buf + encoded_len - moptions_.protection_bytes_per_key);
+  sep_arena->CommitKV(shard, kv_buf, encoded_len);
   Slice encoded(kv_buf, encoded_len - moptions_.protection_bytes_per_key);
   if (kv_prot_info != nullptr) {
     TEST_SYNC_POINT_CALLBACK("MemTable::Add:Encoded", &encoded);
@@ -1175,6 +1363,7 @@ struct RemoteSaver {
   bool* found_final_value;  // Is value set correctly? Used by
                             // KeyMayExist
   std::string* value;
+  Slice* value_ref;  // v2 keeps a reference into the arena instead of a copy
   PinnableWideColumns* columns;
   SequenceNumber seq;
   std::string* timestamp;
@@ -1185,6 +1374,10 @@ struct RemoteSaver {
   bool inplace_update_support;
   bool allow_data_in_errors;
   size_t protection_bytes_per_key;
+  // v2 collects merge operands here and records where the walk ended,
+  // nullptr keeps merges unsupported
+  std::vector<imm_read_operand_ref>* operands;
+  SequenceNumber base_seq;
 };
 
 static void EncodeLocalSaver(void* saver_, void* req_data) {
@@ -1228,6 +1421,9 @@ static void* DecodeRemoteSaver(void* req_data) {
   saver->memrep = nullptr;
   saver->user_comparator = nullptr;
   saver->value = new std::string;
+  saver->value_ref = nullptr;
+  saver->operands = nullptr;
+  saver->base_seq = kMaxSequenceNumber;
   if (read_req->timestamp_size_ == -1) {
     saver->timestamp = nullptr;
   } else if (read_req->timestamp_size_ == 0) {
@@ -1245,7 +1441,7 @@ static void* DecodeRemoteSaverV2(void* req_data_v2) {
   auto* saver = reinterpret_cast<RemoteSaver*>(remote_saver_);
   auto* read_req = reinterpret_cast<imm_read_req_v2*>(req_data_v2);
   saver->status = nullptr;
-  saver->key = new LookupKey(read_req->key, read_req->memtable_key_len);
+  saver->key = new LookupKey(read_req->key(), read_req->memtable_key_len);
   saver->found_final_value = &read_req->found_final_value;
   saver->max_covering_tombstone_seq = read_req->max_covering_tombstone_seq;
   saver->allow_data_in_errors = read_req->allow_data_in_errors;
@@ -1253,19 +1449,46 @@ static void* DecodeRemoteSaverV2(void* req_data_v2) {
   saver->mix_id = 0;  // DEBUG
   saver->memrep = nullptr;
   saver->user_comparator = nullptr;
-  saver->value = new std::string;
+  saver->value = nullptr;
+  saver->value_ref = new Slice;
+  saver->operands = nullptr;
+  saver->base_seq = kMaxSequenceNumber;
   if (read_req->timestamp_size_ == -1) {
     saver->timestamp = nullptr;
   } else if (read_req->timestamp_size_ == 0) {
     saver->timestamp = new std::string;
   } else {
     saver->timestamp = new std::string;
-    saver->timestamp->assign(read_req->timestamp, read_req->timestamp_size_);
+    saver->timestamp->assign(read_req->timestamp(), read_req->timestamp_size_);
   }
   saver->seq = kMaxSequenceNumber;
   return remote_saver_;
 }
 
+static void EncodeRemoteSaverV2(void* saver_, void* ret_data) {
+  auto* saver = reinterpret_cast<RemoteSaver*>(saver_);
+  auto* res = reinterpret_cast<imm_read_result*>(ret_data);
+  res->status_code = saver->status == nullptr ? -1 : saver->status->code();
+  if (saver->status != nullptr) delete saver->status;
+  res->value = saver->value_ref->data();
+  res->value_size = saver->value_ref->size();
+  delete saver->value_ref;
+
+  if (saver->timestamp == nullptr) {
+    res->timestamp_size = -1;
+  } else {
+    res->timestamp_size = static_cast<int32_t>(saver->timestamp->size());
+    res->timestamp.swap(*saver->timestamp);
+    delete saver->timestamp;
+  }
+  res->found_final_value = *(saver->found_final_value);
+  res->seq = saver->seq;
+  if (saver->base_seq != kMaxSequenceNumber) {
+    res->base_seq = saver->base_seq;
+  }
+  delete saver->key;
+}
+
 static void EncodeRemoteSaver(void* saver_, void* ret_data) {
   auto* saver = reinterpret_cast<RemoteSaver*>(saver_);
   void* read_ret = ret_data;
@@ -1426,9 +1649,12 @@ static bool RemoteSaveValue(void* arg, const char* entry) {
         Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
         if (s->status == nullptr) s->status = new Status();
         *(s->status) = Status::OK();
-        if (s->value) {
+        if (s->value_ref) {
+          *(s->value_ref) = v;
+        } else if (s->value) {
           s->value->assign(v.data(), v.size());
         }
+        s->base_seq = seq;
         *(s->found_final_value) = true;
         return false;
       }
@@ -1443,13 +1669,23 @@ static bool RemoteSaveValue(void* arg, const char* entry) {
       case kTypeRangeDeletion: {
         if (s->status == nullptr) s->status = new Status();
         *(s->status) = Status::NotFound();
+        s->base_seq =
+            type == kTypeRangeDeletion ? max_covering_tombstone_seq : seq;
         *(s->found_final_value) = true;
         return false;
       }
       case kTypeMerge: {
         if (s->status == nullptr) s->status = new Status();
-        *s->status = Status::NotSupported("Merge not supported");
-        return false;
+        if (s->operands == nullptr) {
+          *s->status = Status::NotSupported("Merge not supported");
+          return false;
+        }
+        // the merge operator lives on the compute node, the operands go
+        // back with the value or deletion the walk ends at
+        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        s->operands->push_back({seq, v.data(), v.size()});
+        *s->status = Status::MergeInProgress();
+        return true;
       }
       default: {
         std::string msg("Corrupted value not expected.");
@@ -2342,11 +2578,11 @@ void MemTableRep::RGet(const InternalKeyComparator* cmp, void* req_data,
   }
   std::chrono::system_clock::time_point end_time =
       std::chrono::system_clock::now();
-  LOG_CERR("MemTableRep::RGet: Perform SkipListRep::Get",
-           std::chrono::duration_cast<std::chrono::microseconds>(end_time -
+  DM_LOG_DEBUG("MemTableRep::RGet: Perform SkipListRep::Get",
+               std::chrono::duration_cast<std::chrono::microseconds>(end_time -
                                                                  start_time)
                .count(),
-           " us, ");
+               " us, ");
   EncodeRemoteSaver(saver_, ret_data);
 }
 
@@ -2356,14 +2592,43 @@ void MemTableRep::RGet_v2(const InternalKeyComparator* cmp, void* req_data_v2,
   auto* saver = reinterpret_cast<RemoteSaver*>(saver_);
   saver->memrep = this;
   saver->user_comparator = const_cast<Comparator*>(cmp->user_comparator());
-  auto iter = GetDynamicPrefixIterator();
+  saver->operands = &reinterpret_cast<imm_read_result*>(ret_data)->operands;
+  std::unique_ptr<MemTableRep::Iterator> iter(GetDynamicPrefixIterator());
   for (iter->Seek(saver->key->internal_key(),
                   saver->key->memtable_key().data());
        iter->Valid() &&
        RemoteSaveValue(reinterpret_cast<void*>(saver), iter->key());
        iter->Next()) {
   }
-  EncodeRemoteSaver(saver_, ret_data);
+  EncodeRemoteSaverV2(saver_, ret_data);
+  free(saver_);
+}
+
+bool MemTableRep::RGetEntry_v2(const InternalKeyComparator* cmp,
+                               void* req_data_v2, void* ret_data,
+                               const char* entry) {
+  auto* req = reinterpret_cast<imm_read_req_v2*>(req_data_v2);
+  Slice target = GetLengthPrefixedSlice(req->key());
+  Slice ikey = GetLengthPrefixedSlice(entry);
+  if (!cmp->user_comparator()->EqualWithoutTimestamp(ExtractUserKey(ikey),
+                                                     ExtractUserKey(target)) ||
+      cmp->Compare(ikey, target) < 0) {
+    return false;
+  }
+  ValueType type = ExtractValueType(ikey);
+  if (type != kTypeValue && type != kTypeDeletion &&
+      type != kTypeSingleDeletion && type != kTypeDeletionWithTimestamp) {
+    return false;
+  }
+  void* saver_ = DecodeRemoteSaverV2(req_data_v2);
+  auto* saver = reinterpret_cast<RemoteSaver*>(saver_);
+  saver->memrep = this;
+  saver->user_comparator = const_cast<Comparator*>(cmp->user_comparator());
+  saver->operands = &reinterpret_cast<imm_read_result*>(ret_data)->operands;
+  RemoteSaveValue(saver_, entry);
+  EncodeRemoteSaverV2(saver_, ret_data);
+  free(saver_);
+  return true;
 }
 
 void MemTableRep::Get(const LookupKey& k, void* callback_args,
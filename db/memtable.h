@@ -27,6 +27,8 @@
 #include "db/version_edit.h"
 #include "memory/allocator.h"
 #include "memory/concurrent_arena.h"
+#include "memory/memnode_placement.h"
+#include "memtable/remote_skiplist_reader.h"
 #include "monitoring/instrumented_mutex.h"
 #include "options/cf_options.h"
 #include "rocksdb/compression_type.h"
@@ -47,6 +49,7 @@ namespace ROCKSDB_NAMESPACE {
 struct FlushJobInfo;
 class Mutex;
 class MemTableIterator;
+class MemTableShardPartitioner;
 class MergeContext;
 class SystemClock;
 
@@ -111,6 +114,14 @@ class MemTable {
   inline std::pair<RDMAClient*, RDMANode::rdma_connection*> get_conn() const {
     return conn_;
   }
+  // Lists this memtable in *spilled by its id until it is deleted. For
+  // memtables kept on the compute node because no memnode had room for them.
+  void MarkSpilled(SpilledMemTables* spilled) {
+    spilled_ = spilled;
+    if (id_ != 0) {
+      spilled_->Add(id_);
+    }
+  }
   inline void set_remote_begin(void* remote) {
     table_->set_remote_begin(remote);
   }
@@ -142,9 +153,31 @@ class MemTable {
                       const std::pair<size_t, size_t>& remote_index_reg,
                       const std::pair<std::string, size_t> memnode_ip_port,
                       uint64_t cfd_id,
+                      uint64_t db_tag,
                       std::queue<std::pair<uint64_t, uint64_t>>* gc_queue,
                       bool need_mark);
+  // where the memnode finds the bloom filter shipped in the meta arena,
+  // kMemTableBloomNone if there is none or it lives outside the arena
+  memtable_bloom_info RemoteBloomInfo() const;
+  // what a restarted compute node of the DB tagged db_tag needs to take the
+  // memnode copy back, see Reattach()
+  memtable_recovery_info RemoteRecoveryInfo(uint64_t db_tag) const;
+  // Turns this new, empty memtable into the immutable memtable described by
+  // info, whose copy the memnode behind conn still holds as mixed_id from an
+  // earlier run of the compute node. Its entries are only reached through
+  // delegated reads and remote flushes.
+  void Reattach(const memtable_recovery_info& info, uint64_t mixed_id,
+                std::pair<RDMAClient*, RDMANode::rdma_connection*> conn,
+                std::queue<std::pair<uint64_t, uint64_t>>* gc_queue);
+  bool IsReattached() const { return reattached_; }
   Status RemoteRead();
+  // lookup in the memnode copy of an offloaded memtable with one-sided
+  // reads, *res gets what the delegated lookup of this memtable returns.
+  // NotSupported if the entry needs the memnode, e.g. a merge operand.
+  Status OneSidedGet(const RemoteSkipListReader::Fetch& fetch,
+                     const LookupKey& key,
+                     SequenceNumber max_covering_tombstone_seq,
+                     imm_read_result* res, std::string* value);
   void free_remote() {
     flush_job_info_.reset();
     delete arena_;
@@ -199,7 +232,9 @@ class MemTable {
                     WriteBufferManager* write_buffer_manager,
                     SequenceNumber earliest_seq, uint32_t column_family_id,
                     RDMAClient* = nullptr,
-                    RDMANode::rdma_connection* = nullptr);
+                    RDMANode::rdma_connection* = nullptr,
+                    std::shared_ptr<MemTableShardPartitioner>
+                        shard_partitioner = nullptr);
 
   // No copying allowed
   MemTable(const MemTable&) = delete;
@@ -546,6 +581,21 @@ class MemTable {
   // operations on the same MemTable.
   void SetNextLogNumber(uint64_t num) { mem_next_logfile_number_ = num; }
 
+  // Oldest logfile number the entries of this memtable can be in. 0 unless
+  // it was created by a memtable switch, e.g. the first memtable after an
+  // open also holds what was replayed from every WAL not yet flushed.
+  // REQUIRES: external synchronization to prevent simultaneous
+  // operations on the same MemTable.
+  uint64_t GetCreationLogNumber() const { return creation_log_number_; }
+  void SetCreationLogNumber(uint64_t num) { creation_log_number_ = num; }
+
+  // Last sequence number of the db when this memtable became immutable, no
+  // entry of it is newer. 0 while it is still mutable.
+  // REQUIRES: external synchronization to prevent simultaneous
+  // operations on the same MemTable.
+  SequenceNumber GetSealedSequenceNumber() const { return sealed_seqno_; }
+  void SetSealedSequenceNumber(SequenceNumber seq) { sealed_seqno_ = seq; }
+
   // if this memtable contains data from a committed
   // two phase transaction we must take note of the
   // log which contains that data so we can know
@@ -604,10 +654,24 @@ class MemTable {
   }
 
   // REQUIRES: db_mutex held.
-  void SetID(uint64_t id) { id_ = id; }
+  void SetID(uint64_t id) {
+    if (spilled_ != nullptr) {
+      if (id_ != 0) {
+        spilled_->Remove(id_);
+      }
+      spilled_->Add(id);
+    }
+    id_ = id;
+  }
 
   uint64_t GetID() const { return id_; }
 
+  // About n user keys of the point table in key order, read before the
+  // memtable is shipped to the memnode.
+  void SampleUserKeys(size_t n, std::vector<std::string>* keys) const {
+    table_->SampleUserKeys(n, keys);
+  }
+
   bool IsTransferCompleted() const { return table_->IsRemote(); }
   bool IsTransferCalled() const { return table_->IsRemoteCalled(); }
 
@@ -655,7 +719,7 @@ class MemTable {
                                     bool allow_data_in_errors = false);
 
   inline void TESTContinuous() {
-    LOG_CERR("MemTable TESTContinuous");
+    DM_LOG_DEBUG("MemTable TESTContinuous");
     // void* head = reinterpret_cast<void*>(this);
     // LOG_CERR(table_->ApproximateMemoryUsage(), ' ',
     //          range_del_table_->ApproximateMemoryUsage(), ' ',
@@ -664,7 +728,7 @@ class MemTable {
     // table_->TESTContinuous();
     // range_del_table_->TESTContinuous();
     // arena_->TESTContinuous();
-    LOG_CERR("Memtable TESTContinuous finish");
+    DM_LOG_DEBUG("Memtable TESTContinuous finish");
   }
 
  private:
@@ -713,6 +777,9 @@ class MemTable {
   // The log files earlier than this number can be deleted.
   uint64_t mem_next_logfile_number_;
 
+  uint64_t creation_log_number_ = 0;
+  SequenceNumber sealed_seqno_ = 0;
+
   // the earliest log containing a prepared section
   // which has been inserted into this memtable.
   std::atomic<uint64_t> min_prep_log_referenced_;
@@ -741,6 +808,15 @@ class MemTable {
   uint64_t mixed_id_ = 0;
   std::queue<std::pair<uint64_t, uint64_t>>* gc_queue_ = nullptr;
   std::pair<RDMAClient*, RDMANode::rdma_connection*> conn_ = {nullptr, nullptr};
+  // memnode memory charged to write_buffer_manager_, 0 if kept local
+  WriteBufferManager* write_buffer_manager_ = nullptr;
+  size_t remote_charge_ = 0;
+  SpilledMemTables* spilled_ = nullptr;
+  // taken back from the memnode after a restart, nothing of it is local
+  bool reattached_ = false;
+  // walks the memnode copy of table_, set up by the first OneSidedGet()
+  std::once_flag one_sided_once_;
+  std::unique_ptr<RemoteSkipListReader> one_sided_reader_;
 
   // Sequence number of the atomic flush that is responsible for this memtable.
   // The sequence number of atomic flush is a seq, such that no writes with
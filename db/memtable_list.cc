@@ -15,9 +15,13 @@
 #include <limits>
 #include <queue>
 #include <string>
+#include <unordered_map>
 
+#include "cache/typed_cache.h"
 #include "db/db_impl/db_impl.h"
+#include "db/delegated_memtable_iterator.h"
 #include "db/memtable.h"
+#include "db/merge_helper.h"
 #include "db/range_tombstone_fragmenter.h"
 #include "db/version_set.h"
 #include "logging/log_buffer.h"
@@ -27,6 +31,7 @@
 #include "rocksdb/env.h"
 #include "rocksdb/iterator.h"
 #include "rocksdb/status.h"
+#include "rocksdb/system_clock.h"
 #include "table/merging_iterator.h"
 #include "test_util/sync_point.h"
 #include "trace_replay/trace_replay.h"
@@ -127,16 +132,541 @@ bool MemTableListVersion::Get(
                      callback, is_blob_index, read_client, cfd_id, cfd_);
 }
 
+namespace {
+// appends the request record of one key to the batch, returns false if the
+// request area has no room left for it
+bool PackDelegatedRead(imm_read_batch* batch, const LookupKey& key,
+                       const Status* s,
+                       SequenceNumber max_covering_tombstone_seq,
+                       const ImmutableMemTableOptions* ioptions,
+                       const std::string* timestamp, SequenceNumber seq,
+                       const std::vector<uint64_t>& mixed_ids) {
+  assert(s != nullptr);
+  assert(batch->num_keys < MAX_DELEGATED_READ_BATCH);
+  Slice mkey = key.memtable_key();
+  size_t ts_len = timestamp == nullptr ? 0 : timestamp->size();
+  size_t rec_size =
+      imm_read_req_v2::record_size(mkey.size(), ts_len, mixed_ids.size());
+  if (batch->req_len + rec_size > imm_read_batch::kReqAreaSize) {
+    return false;
+  }
+  auto* req = reinterpret_cast<imm_read_req_v2*>(
+      reinterpret_cast<char*>(batch) + batch->req_len);
+  req->status_code = s->code();
+  req->memtable_key_len = static_cast<uint32_t>(mkey.size());
+  req->found_final_value = false;
+  req->max_covering_tombstone_seq = max_covering_tombstone_seq;
+  req->allow_data_in_errors = ioptions->allow_data_in_errors;
+  req->protection_bytes_per_key =
+      static_cast<uint32_t>(ioptions->protection_bytes_per_key);
+  req->timestamp_size_ =
+      timestamp == nullptr ? -1 : static_cast<int32_t>(ts_len);
+  req->seq = seq;
+  req->mixed_ids_size = static_cast<uint32_t>(mixed_ids.size());
+  std::memcpy(req->key(), mkey.data(), mkey.size());
+  if (ts_len) {
+    std::memcpy(req->timestamp(), timestamp->data(), ts_len);
+  }
+  std::memcpy(req->mixed_ids(), mixed_ids.data(),
+              mixed_ids.size() * sizeof(uint64_t));
+  assert(req->record_size() == rec_size);
+  batch->req_len += static_cast<uint32_t>(rec_size);
+  batch->num_keys++;
+  return true;
+}
+
+// outcome of a lookup on one memnode, starts from the state the local
+// memtables left
+struct DelegatedReadResult {
+  Status s;
+  std::string value;
+  std::string timestamp;
+  SequenceNumber seq = kMaxSequenceNumber;
+  // entry the value or deletion came from if found
+  SequenceNumber base_seq = kMaxSequenceNumber;
+  // merge operands newer than that, newest first
+  std::vector<std::pair<SequenceNumber, std::string>> operands;
+  bool found = false;
+};
+
+// folds the answer of one more memnode into *best. The memtables of a key
+// may be spread over several memnodes, the newest version any of them found
+// wins, an error only when none found the key. The merge operands of both
+// that are newer than it are kept.
+void MergeDelegatedRead(DelegatedReadResult* r, DelegatedReadResult* best) {
+  auto failed = [](const Status& st) {
+    return !st.ok() && !st.IsNotFound() && !st.IsMergeInProgress();
+  };
+  SequenceNumber newest = best->seq == kMaxSequenceNumber ? r->seq
+                          : r->seq == kMaxSequenceNumber
+                              ? best->seq
+                              : std::max(r->seq, best->seq);
+  if (r->found ? !best->found || r->base_seq > best->base_seq
+               : !best->found && failed(r->s) && !failed(best->s)) {
+    std::swap(*r, *best);
+  }
+  best->seq = newest;
+  if (r->operands.empty()) {
+    return;
+  }
+  for (auto& op : r->operands) {
+    if (!best->found || op.first > best->base_seq) {
+      best->operands.push_back(std::move(op));
+    }
+  }
+  std::sort(best->operands.begin(), best->operands.end(),
+            [](const auto& a, const auto& b) { return a.first > b.first; });
+  if (!best->found && !failed(best->s)) {
+    best->s = Status::MergeInProgress();
+  }
+}
+
+// The memnodes return merge operands instead of merging, the operator lives
+// here. Queues them behind the ones the local memtables collected and
+// merges them into the value or deletion the lookup ended at, if any.
+void ResolveDelegatedMerge(DelegatedReadResult* r, const LookupKey& key,
+                           const ImmutableMemTableOptions* ioptions,
+                           MergeContext* merge_context) {
+  for (auto& op : r->operands) {
+    merge_context->PushOperand(op.second);
+  }
+  if (merge_context->GetNumOperands() == 0) {
+    return;
+  }
+  if (!r->found) {
+    if (r->s.ok() || r->s.IsNotFound() || r->s.IsMergeInProgress()) {
+      r->s = Status::MergeInProgress();
+    }
+    return;
+  }
+  if (!r->s.ok() && !r->s.IsNotFound()) {
+    return;
+  }
+  if (ioptions->merge_operator == nullptr) {
+    r->s = Status::InvalidArgument(
+        "merge_operator is not properly initialized.");
+    return;
+  }
+  Slice base(r->value);
+  std::string result;
+  // `op_failure_scope` (an output parameter) is not provided (set to
+  // nullptr) since a failure must be propagated regardless of its value.
+  r->s = MergeHelper::TimedFullMerge(
+      ioptions->merge_operator, key.user_key(), r->s.ok() ? &base : nullptr,
+      merge_context->GetOperands(), &result, ioptions->info_log,
+      ioptions->statistics, SystemClock::Default().get(),
+      /* result_operand */ nullptr, /* update_num_ops_stats */ true,
+      /* op_failure_scope */ nullptr);
+  r->value.swap(result);
+}
+
+// the lookup over mems of one memnode done with one-sided reads, false if
+// one of them needs the memnode and it has to be delegated instead
+bool OneSidedGetFromList(RDMAReadClient* read_client,
+                         RDMANode::rdma_connection* conn,
+                         imm_read_batch* batch,
+                         const std::vector<MemTable*>& mems,
+                         const LookupKey& key,
+                         SequenceNumber max_covering_tombstone_seq,
+                         DelegatedReadResult* r) {
+  auto fetch = [&](uint64_t offset, size_t len, char* dst) {
+    return read_client->client_read_remote(conn, batch, offset, len, dst);
+  };
+  imm_read_result res;
+  std::string res_value;
+  SequenceNumber req_seq = r->seq;
+  bool done = false;
+  for (MemTable* m : mems) {
+    if (!m->OneSidedGet(fetch, key, max_covering_tombstone_seq, &res,
+                        &res_value)
+             .ok()) {
+      return false;
+    }
+    done = res.found_final_value;
+    if (req_seq == kMaxSequenceNumber) {
+      req_seq = res.seq;
+    }
+    if (done) {
+      break;
+    }
+  }
+  // what UnpackDelegatedRead() makes of the reply
+  if (res.status_code == Status::Code::kOk) {
+    r->s = Status::OK();
+  } else if (res.status_code == Status::Code::kNotFound) {
+    r->s = Status::NotFound();
+  }
+  if (!res_value.empty()) {
+    r->value.swap(res_value);
+  }
+  r->seq = req_seq;
+  r->found = done;
+  if (done) {
+    r->base_seq = res.base_seq;
+  }
+  return true;
+}
+
+void ResetDelegatedReadBatch(imm_read_batch* batch) {
+  batch->op = kDelegatedGet;
+  batch->num_keys = 0;
+  batch->req_len =
+      static_cast<uint32_t>(dm_align8(sizeof(imm_read_batch)));
+}
+
+// returns found_final_value of the memnode side lookup, values that were
+// not inlined are fetched from the memnode here
+bool UnpackDelegatedRead(
+    RDMAReadClient* read_client, RDMANode::rdma_connection* conn,
+    imm_read_batch* batch, imm_read_ret_v2* ret, std::string* value,
+    std::string* timestamp, Status* s, SequenceNumber* seq,
+    SequenceNumber* base_seq,
+    std::vector<std::pair<SequenceNumber, std::string>>* operands) {
+  if (ret->status_code == Status::Code::kOk) {
+    *s = Status::OK();
+  } else if (ret->status_code == Status::Code::kCorruption) {
+    *s = Status::Corruption();
+  } else if (ret->status_code == Status::Code::kNotSupported) {
+    *s = Status::NotSupported();
+  } else if (ret->status_code == Status::Code::kNotFound) {
+    *s = Status::NotFound();
+  } else if (ret->status_code == Status::Code::kIncomplete) {
+    *s = Status::Incomplete("delegated read reply area exhausted");
+  } else if (ret->status_code == Status::Code::kMergeInProgress) {
+    *s = Status::MergeInProgress();
+  } else if (ret->status_code == -1) {
+  } else {
+    assert(false);
+  }
+  if (ret->value_size > 0 && value != nullptr) {
+    if (ret->num_frags == 0) {
+      value->assign(ret->value(), ret->value_size);
+    } else if (!read_client->client_fetch_scattered_value(
+                   conn, batch, ret->frags(), ret->num_frags, ret->value_size,
+                   value)) {
+      *s = Status::IOError("delegated read fetch failed");
+      return false;
+    }
+  }
+  if (ret->timestamp_size > 0 && timestamp != nullptr) {
+    timestamp->assign(ret->timestamp(), ret->timestamp_size);
+  }
+  *seq = ret->seq;
+  *base_seq = ret->base_seq;
+  auto* op = ret->operands();
+  for (uint32_t i = 0; i < ret->num_operands; i++) {
+    operands->emplace_back(op->seq, std::string());
+    if (!op->remote) {
+      operands->back().second.assign(op->data(), op->size);
+    } else if (!read_client->client_fetch_scattered_value(
+                   conn, batch, op->frag(), 1, op->size,
+                   &operands->back().second)) {
+      *s = Status::IOError("delegated read fetch failed");
+      return false;
+    }
+    op = reinterpret_cast<imm_read_operand*>(reinterpret_cast<char*>(op) +
+                                             op->record_size());
+  }
+  return ret->found_final_value;
+}
+
+// An entry of DBOptions::delegated_read_cache is the kind of answer, the
+// sequence number of the version found and the last snapshot it holds
+// for, followed by the value.
+using DelegatedReadCacheInterface =
+    BasicTypedCacheInterface<std::string, CacheEntryRole::kMisc>;
+enum : char {
+  kCachedAbsent = 0,
+  kCachedValue = 1,
+  kCachedDeletion = 2,
+};
+
+// newest_id: the newest memtable looked up on the memnodes, the older ones
+// a lookup covers follow from it
+std::string DelegatedReadCacheKey(const ColumnFamilyData* cfd,
+                                  uint64_t newest_id, const Slice& user_key) {
+  std::string cache_key = cfd->DelegatedReadCacheId();
+  PutVarint64(&cache_key, newest_id);
+  cache_key.append(user_key.data(), user_key.size());
+  return cache_key;
+}
+
+// true on a hit valid at read_seq, with *found what GetFromList() returns
+bool LookupDelegatedReadCache(Cache* cache, const std::string& cache_key,
+                              SequenceNumber read_seq, std::string* value,
+                              Status* s, SequenceNumber* seq, bool* found) {
+  DelegatedReadCacheInterface typed_cache{cache};
+  auto* handle = typed_cache.Lookup(cache_key);
+  if (handle == nullptr) {
+    return false;
+  }
+  Slice entry(*typed_cache.Value(handle));
+  char kind = entry.empty() ? kCachedAbsent : entry[0];
+  entry.remove_prefix(1);
+  uint64_t entry_seq = 0;
+  uint64_t last_seq = 0;
+  bool hit = GetVarint64(&entry, &entry_seq) &&
+             GetVarint64(&entry, &last_seq) &&
+             (kind == kCachedAbsent || entry_seq <= read_seq) &&
+             read_seq <= last_seq;
+  if (hit) {
+    *found = kind != kCachedAbsent;
+    if (kind == kCachedValue) {
+      *s = Status::OK();
+      value->assign(entry.data(), entry.size());
+    } else if (kind == kCachedDeletion) {
+      *s = Status::NotFound();
+    }
+    if (*found) {
+      *seq = entry_seq;
+    }
+  }
+  typed_cache.Release(handle);
+  return hit;
+}
+
+// r is the answer of the memnodes at read_seq, sealed_seq the last
+// sequence number of the newest memtable asked about or 0 if unknown
+void InsertDelegatedReadCache(Cache* cache, const std::string& cache_key,
+                              const DelegatedReadResult& r,
+                              Status::Code incoming, SequenceNumber read_seq,
+                              SequenceNumber sealed_seq) {
+  if (!r.operands.empty()) {
+    return;
+  }
+  char kind;
+  if (!r.found) {
+    // the local lookup status is passed on untouched
+    if (r.s.code() != incoming) return;
+    kind = kCachedAbsent;
+  } else if (r.s.ok()) {
+    kind = kCachedValue;
+  } else if (r.s.IsNotFound()) {
+    kind = kCachedDeletion;
+  } else {
+    return;
+  }
+  // a later snapshot sees nothing newer once every entry is visible
+  SequenceNumber last_seq = sealed_seq != 0 && read_seq >= sealed_seq
+                                ? kMaxSequenceNumber
+                                : read_seq;
+  auto* entry = new std::string(1, kind);
+  PutVarint64(entry, r.found ? r.seq : 0);
+  PutVarint64(entry, last_seq);
+  if (kind == kCachedValue) {
+    entry->append(r.value);
+  }
+  size_t charge = cache_key.size() + entry->capacity() + sizeof(std::string);
+  DelegatedReadCacheInterface typed_cache{cache};
+  // a full cache only costs the next Get a round trip
+  typed_cache.Insert(cache_key, entry, charge).PermitUncheckedError();
+}
+}  // namespace
+
 void MemTableListVersion::MultiGet(const ReadOptions& read_options,
-                                   MultiGetRange* range,
-                                   ReadCallback* callback) {
-  for (auto memtable : memlist_) {
+                                   MultiGetRange* range, ReadCallback* callback,
+                                   RDMAReadClient* read_client,
+                                   uint64_t column_family_id,
+                                   ColumnFamilyData* cfd_) {
+  static_assert(MultiGetContext::MAX_BATCH_SIZE <= MAX_DELEGATED_READ_BATCH,
+                "a MultiGet range must fit in one delegated read batch");
+  bool delegated = read_client != nullptr && cfd_ != nullptr;
+  uint64_t acc_id = delegated ? cfd_->get_trans_mem_accumulated_id() : 0;
+  int cnt = 0;
+  auto remote_begin = memlist_.begin();
+  for (; remote_begin != memlist_.end(); ++remote_begin) {
+    MemTable* memtable = *remote_begin;
+    cnt++;
+    // same split as GetFromList(), everything from here on is offloaded
+    if (delegated && ((cnt > max_local_write_buffer_number_to_maintain_ &&
+                       memtable->GetID() <= acc_id) ||
+                      memtable->IsReattached())) {
+      break;
+    }
     memtable->MultiGet(read_options, range, callback,
                        true /* immutable_memtable */);
     if (range->empty()) {
       return;
     }
   }
+  if (remote_begin == memlist_.end()) {
+    return;
+  }
+
+  // filter every pending key against the local blooms of the offloaded
+  // memtables, keys without a candidate memtable stay in the range
+  std::vector<MultiGetRange::Iterator> pending;
+  pending.reserve(MultiGetContext::MAX_BATCH_SIZE);
+  std::vector<std::vector<uint64_t>> mixed_ids;
+  mixed_ids.reserve(MultiGetContext::MAX_BATCH_SIZE);
+  for (auto iter = range->begin(); iter != range->end(); ++iter) {
+    std::vector<uint64_t> ids;
+    for (auto it = remote_begin; it != memlist_.end(); ++it) {
+      MemTable* memtable = *it;
+      assert(memtable->IsTransferCompleted());
+      SequenceNumber current_seq = kMaxSequenceNumber;
+      bool prev = memtable->PrevGet(
+          *iter->lkey, iter->value ? iter->value->GetSelf() : nullptr,
+          iter->columns, iter->timestamp, iter->s, &iter->merge_context,
+          &iter->max_covering_tombstone_seq, &current_seq, read_options, true,
+          callback, &iter->is_blob_index, true, read_client, nullptr,
+          column_family_id);
+      if (prev) ids.emplace_back(memtable->GetID());
+    }
+    if (!ids.empty()) {
+      pending.emplace_back(iter);
+      mixed_ids.emplace_back(std::move(ids));
+    }
+  }
+  TEST_SYNC_POINT_CALLBACK("MemTableListVersion::MultiGet:Delegated",
+                           &pending);
+  if (pending.empty()) {
+    return;
+  }
+
+  // the keys go to every memnode holding one of their memtables
+  std::vector<size_t> memnodes;
+  std::unordered_map<uint64_t, size_t> memnode_of_id;
+  for (auto it = remote_begin; it != memlist_.end(); ++it) {
+    size_t memnode = cfd_->MemNodeOf(**it);
+    memnode_of_id[(*it)->GetID()] = memnode;
+    if (std::find(memnodes.begin(), memnodes.end(), memnode) ==
+        memnodes.end()) {
+      memnodes.push_back(memnode);
+    }
+  }
+  std::vector<DelegatedReadResult> results(pending.size());
+  // answered by a memnode yet, or given up on
+  std::vector<char> answered(pending.size(), 0);
+  std::vector<char> failed(pending.size(), 0);
+
+  size_t rr_offset = 0;
+  read_client->available_read_reqs_.wait_dequeue(rr_offset);
+  auto* batch =
+      reinterpret_cast<imm_read_batch*>(read_client->get_buf() + rr_offset);
+  assert(memlist_.size());
+  const ImmutableMemTableOptions* ioptions =
+      memlist_.back()->GetImmutableMemTableOptions();
+  auto answer = [&](size_t k, DelegatedReadResult* r) {
+    if (!answered[k]) {
+      results[k] = std::move(*r);
+      answered[k] = 1;
+    } else {
+      MergeDelegatedRead(r, &results[k]);
+    }
+  };
+  for (size_t memnode : memnodes) {
+    // pending keys with memtables on this memnode and their ids there
+    std::vector<size_t> keys;
+    std::vector<std::vector<uint64_t>> ids;
+    for (size_t k = 0; k < pending.size(); k++) {
+      if (failed[k]) {
+        continue;
+      }
+      std::vector<uint64_t> here;
+      for (uint64_t id : mixed_ids[k]) {
+        if (memnodes.size() == 1 || memnode_of_id[id] == memnode) {
+          here.push_back(id);
+        }
+      }
+      if (!here.empty()) {
+        keys.push_back(k);
+        ids.push_back(std::move(here));
+      }
+    }
+    if (keys.empty()) {
+      continue;
+    }
+    auto conn = cfd_->get_cflevel_read_connection(memnode);
+    // keys that do not fit the request area go out in a following round trip
+    size_t next = 0;
+    while (next < keys.size()) {
+      size_t first = next;
+      ResetDelegatedReadBatch(batch);
+      while (next < keys.size()) {
+        auto& iter = pending[keys[next]];
+        if (!PackDelegatedRead(batch, *iter->lkey, iter->s,
+                               iter->max_covering_tombstone_seq, ioptions,
+                               iter->timestamp, kMaxSequenceNumber,
+                               ids[next])) {
+          break;
+        }
+        next++;
+      }
+      if (next == first) {
+        // a single key larger than the whole request area
+        *(pending[keys[next]]->s) =
+            Status::NotSupported("key too large for delegated read");
+        failed[keys[next]] = 1;
+        next++;
+        continue;
+      }
+
+      bool ok =
+          read_client->client_send_batch_request_for_memtable_read(conn, batch);
+      auto* ret = batch->first_ret();
+      for (size_t j = first; j < next; j++) {
+        auto& iter = pending[keys[j]];
+        DelegatedReadResult r;
+        r.s = *(iter->s);
+        if (!ok) {
+          *(iter->s) = Status::IOError("delegated read failed");
+          failed[keys[j]] = 1;
+          continue;
+        }
+        r.found = UnpackDelegatedRead(
+            read_client, conn, batch, ret, &r.value,
+            iter->timestamp != nullptr ? &r.timestamp : nullptr, &r.s,
+            &r.seq, &r.base_seq, &r.operands);
+        ret = reinterpret_cast<imm_read_ret_v2*>(reinterpret_cast<char*>(ret) +
+                                                 ret->record_size());
+        answer(keys[j], &r);
+      }
+    }
+    cfd_->put_cflevel_read_connection(conn);
+  }
+  read_client->available_read_reqs_.enqueue(rr_offset);
+
+  bool aborted = false;
+  for (size_t k = 0; k < pending.size(); k++) {
+    auto& iter = pending[k];
+    if (failed[k]) {
+      range->MarkKeyDone(iter);
+      continue;
+    }
+    if (!answered[k] || aborted) {
+      continue;
+    }
+    DelegatedReadResult& r = results[k];
+    ResolveDelegatedMerge(&r, *iter->lkey, ioptions, &iter->merge_context);
+    *(iter->s) = r.s;
+    if (!r.timestamp.empty()) {
+      iter->timestamp->swap(r.timestamp);
+    }
+    if (!r.found) {
+      continue;
+    }
+    if (iter->value) {
+      if (!r.value.empty()) {
+        iter->value->GetSelf()->swap(r.value);
+      }
+      iter->value->PinSelf();
+      range->AddValueSize(iter->value->size());
+    } else {
+      assert(iter->columns);
+      iter->columns->SetPlainValue(std::move(r.value));
+      range->AddValueSize(iter->columns->serialized_size());
+    }
+    range->MarkKeyDone(iter);
+    if (range->GetValueSize() > read_options.value_size_soft_limit) {
+      for (auto range_iter = range->begin(); range_iter != range->end();
+           ++range_iter) {
+        range->MarkKeyDone(range_iter);
+        *(range_iter->s) = Status::Aborted();
+      }
+      aborted = true;
+    }
+  }
 }
 
 bool MemTableListVersion::GetMergeOperands(
@@ -173,6 +703,10 @@ bool MemTableListVersion::GetFromList(
     ColumnFamilyData* cfd_) {
   bool need_remote_read = false;
   std::vector<uint64_t> mixed_ids;
+  std::vector<MemTable*> remote_mems;
+  // the first memtable of the list that is looked up remotely, all older
+  // ones are too
+  MemTable* remote_newest = nullptr;
   *seq = kMaxSequenceNumber;
   // if (list->size() > 0) {
   //   std::string now1;
@@ -200,7 +734,9 @@ bool MemTableListVersion::GetFromList(
     assert(memtable->IsFragmentedRangeTombstonesConstructed());
     SequenceNumber current_seq = kMaxSequenceNumber;
     bool done = false;
-    if (!need_remote_read &&
+    // a memtable taken back from the memnode after a restart has no local
+    // copy, being the oldest all the ones after it are reattached too
+    if (!need_remote_read && !memtable->IsReattached() &&
         (cnt <= max_local_write_buffer_number_to_maintain_ ||
          memtable->GetID() > acc_id)) {
       done =
@@ -233,6 +769,9 @@ bool MemTableListVersion::GetFromList(
       }
     } else {
       need_remote_read = true;
+      if (remote_newest == nullptr) {
+        remote_newest = memtable;
+      }
       assert(memtable->IsTransferCompleted());
       // std::chrono::high_resolution_clock::time_point bloom1 =
       //     std::chrono::high_resolution_clock::now();
@@ -241,7 +780,10 @@ bool MemTableListVersion::GetFromList(
           key, value, columns, timestamp, s, merge_context,
           max_covering_tombstone_seq, &current_seq, read_opts, true, callback,
           is_blob_index, true, read_client, nullptr, cfd_id);
-      if (prev) mixed_ids.emplace_back(memtable->GetID());
+      if (prev) {
+        mixed_ids.emplace_back(memtable->GetID());
+        remote_mems.push_back(memtable);
+      }
       // std::chrono::high_resolution_clock::time_point bloom2 =
       //     std::chrono::high_resolution_clock::now();
       // bloom_dura += bloom2 - bloom1;
@@ -268,61 +810,101 @@ bool MemTableListVersion::GetFromList(
     // LOG_CERR("remote read mixed_ids::", now);
     // std::chrono::high_resolution_clock::time_point read1 =
     //     std::chrono::high_resolution_clock::now();
+    // the answer of the offloaded memtables is only cached when nothing
+    // found so far has to be combined with it
+    Cache* cache = cfd_->ioptions()->delegated_read_cache.get();
+    bool cacheable = cache != nullptr && value != nullptr &&
+                     timestamp == nullptr && callback == nullptr &&
+                     *max_covering_tombstone_seq == 0 &&
+                     merge_context->GetNumOperands() == 0 &&
+                     !s->IsMergeInProgress();
+    const SequenceNumber read_seq = GetInternalKeySeqno(key.internal_key());
+    const Status::Code incoming = s->code();
+    std::string cache_key;
+    if (cacheable) {
+      cache_key = DelegatedReadCacheKey(cfd_, remote_newest->GetID(),
+                                        key.user_key());
+      bool found = false;
+      if (LookupDelegatedReadCache(cache, cache_key, read_seq, value, s, seq,
+                                   &found)) {
+        return found;
+      }
+    }
     size_t rr_offset = 0;
     read_client->available_read_reqs_.wait_dequeue(rr_offset);
-    auto* req_packet =
-        reinterpret_cast<imm_read_req_v2*>(read_client->get_buf() + rr_offset);
-    // pack into req_v2
-    assert(s != nullptr);
-    req_packet->status_code = s->code();
-    assert(key.memtable_key().size() < 25);
-    std::memcpy(req_packet->key, key.memtable_key().data(),
-                key.memtable_key().size());
-    req_packet->memtable_key_len = key.memtable_key().size();
-    req_packet->found_final_value = false;
-    req_packet->max_covering_tombstone_seq = *max_covering_tombstone_seq;
-    assert(memlist_.size());
-    req_packet->allow_data_in_errors = memlist_.back()
-                                           ->GetImmutableMemTableOptions()
-                                           ->allow_data_in_errors;  //
-    req_packet->protection_bytes_per_key = memlist_.back()
-                                               ->GetImmutableMemTableOptions()
-                                               ->protection_bytes_per_key;  //
-    if (timestamp == nullptr) {
-      req_packet->timestamp_size_ = -1;
-    } else if (timestamp->empty()) {
-      req_packet->timestamp_size_ = 0;
-    } else {
-      req_packet->timestamp_size_ = timestamp->size();
-      assert(req_packet->timestamp_size_ < 25);
-      memcpy(req_packet->timestamp, timestamp->data(), timestamp->size());
-    }
-    req_packet->seq = *seq;
-    req_packet->mixed_ids_size = mixed_ids.size();
-    assert(mixed_ids.size() < 25);
-    for (int i = 0; i < mixed_ids.size(); i++) {
-      req_packet->mixed_ids[i] = mixed_ids[i];
+    auto* batch =
+        reinterpret_cast<imm_read_batch*>(read_client->get_buf() + rr_offset);
+    // one request per memnode holding some of the memtables, the slot is
+    // reused for each so a Get never waits for a second one
+    std::vector<size_t> memnodes;
+    for (MemTable* m : remote_mems) {
+      size_t memnode = cfd_->MemNodeOf(*m);
+      if (std::find(memnodes.begin(), memnodes.end(), memnode) ==
+          memnodes.end()) {
+        memnodes.push_back(memnode);
+      }
     }
-
-    auto conn = cfd_->get_cflevel_read_connection();
-    bool ret = read_client->client_send_request_for_memtable_read_v2(
-        conn, req_packet, value, timestamp);
-    if (req_packet->status_code == Status::Code::kOk) {
-      *s = Status::OK();
-    } else if (req_packet->status_code == Status::Code::kCorruption) {
-      *s = Status::Corruption();
-    } else if (req_packet->status_code == Status::Code::kNotSupported) {
-      *s = Status::NotSupported();
-    } else if (req_packet->status_code == Status::Code::kNotFound) {
-      *s = Status::NotFound();
-    } else if (req_packet->status_code == -1) {
-    } else {
-      assert(false);
+    bool one_sided = read_client->prefer_one_sided();
+    DelegatedReadResult best;
+    for (size_t n = 0; n < memnodes.size(); n++) {
+      std::vector<uint64_t> ids;
+      std::vector<MemTable*> mems;
+      for (size_t i = 0; i < remote_mems.size(); i++) {
+        if (memnodes.size() == 1 ||
+            cfd_->MemNodeOf(*remote_mems[i]) == memnodes[n]) {
+          ids.push_back(mixed_ids[i]);
+          mems.push_back(remote_mems[i]);
+        }
+      }
+      DelegatedReadResult r;
+      r.s = *s;
+      r.seq = *seq;
+      auto conn = cfd_->get_cflevel_read_connection(memnodes[n]);
+      if (!one_sided ||
+          !OneSidedGetFromList(read_client, conn, batch, mems, key,
+                               *max_covering_tombstone_seq, &r)) {
+        // a Get is a delegated read batch of one key
+        assert(memlist_.size());
+        ResetDelegatedReadBatch(batch);
+        if (!PackDelegatedRead(batch, key, s, *max_covering_tombstone_seq,
+                               memlist_.back()->GetImmutableMemTableOptions(),
+                               timestamp, *seq, ids)) {
+          r.s = Status::NotSupported("key too large for delegated read");
+        } else if (read_client->client_send_batch_request_for_memtable_read(
+                       conn, batch)) {
+          r.found = UnpackDelegatedRead(
+              read_client, conn, batch, batch->first_ret(),
+              value != nullptr ? &r.value : nullptr,
+              timestamp != nullptr ? &r.timestamp : nullptr, &r.s, &r.seq,
+              &r.base_seq, &r.operands);
+        } else {
+          r.s = Status::IOError("delegated read failed");
+        }
+      }
+      cfd_->put_cflevel_read_connection(conn);
+      if (n == 0) {
+        best = std::move(r);
+      } else {
+        MergeDelegatedRead(&r, &best);
+      }
     }
-    *seq = req_packet->seq;
-    // delete req_packet;
     read_client->available_read_reqs_.enqueue(rr_offset);
-    cfd_->put_cflevel_read_connection(conn);
+    if (cacheable) {
+      InsertDelegatedReadCache(cache, cache_key, best, incoming, read_seq,
+                               remote_newest->GetSealedSequenceNumber());
+    }
+    ResolveDelegatedMerge(&best, key,
+                          memlist_.back()->GetImmutableMemTableOptions(),
+                          merge_context);
+    *s = best.s;
+    if (!best.value.empty() && value != nullptr) {
+      value->swap(best.value);
+    }
+    if (!best.timestamp.empty()) {
+      timestamp->swap(best.timestamp);
+    }
+    *seq = best.seq;
+    bool ret = best.found;
     // std::chrono::high_resolution_clock::time_point read2 =
     //     std::chrono::high_resolution_clock::now();
     // LOG_CERR(
@@ -366,19 +948,44 @@ Status MemTableListVersion::AddRangeTombstoneIterators(
   return Status::OK();
 }
 
+InternalIterator* MemTableListVersion::NewMemTableIterator(
+    MemTable* m, int cnt, const ReadOptions& options, Arena* arena,
+    RDMAReadClient* read_client, ColumnFamilyData* cfd_, uint64_t acc_id) {
+  // same split as GetFromList()
+  if (read_client != nullptr && cfd_ != nullptr &&
+      ((cnt > max_local_write_buffer_number_to_maintain_ &&
+        m->GetID() <= acc_id) ||
+       m->IsReattached())) {
+    assert(m->IsTransferCompleted());
+    return NewDelegatedMemTableIterator(*m, read_client, cfd_, arena);
+  }
+  return m->NewIterator(options, arena);
+}
+
 void MemTableListVersion::AddIterators(
     const ReadOptions& options, std::vector<InternalIterator*>* iterator_list,
-    Arena* arena) {
+    Arena* arena, RDMAReadClient* read_client, ColumnFamilyData* cfd_) {
+  uint64_t acc_id =
+      cfd_ != nullptr ? cfd_->get_trans_mem_accumulated_id() : 0;
+  int cnt = 0;
   for (auto& m : memlist_) {
-    iterator_list->push_back(m->NewIterator(options, arena));
+    iterator_list->push_back(NewMemTableIterator(m, ++cnt, options, arena,
+                                                 read_client, cfd_, acc_id));
   }
 }
 
 void MemTableListVersion::AddIterators(const ReadOptions& options,
                                        MergeIteratorBuilder* merge_iter_builder,
-                                       bool add_range_tombstone_iter) {
+                                       bool add_range_tombstone_iter,
+                                       RDMAReadClient* read_client,
+                                       ColumnFamilyData* cfd_) {
+  uint64_t acc_id =
+      cfd_ != nullptr ? cfd_->get_trans_mem_accumulated_id() : 0;
+  int cnt = 0;
   for (auto& m : memlist_) {
-    auto mem_iter = m->NewIterator(options, merge_iter_builder->GetArena());
+    auto mem_iter =
+        NewMemTableIterator(m, ++cnt, options, merge_iter_builder->GetArena(),
+                            read_client, cfd_, acc_id);
     if (!add_range_tombstone_iter || options.ignore_range_deletions) {
       merge_iter_builder->AddIterator(mem_iter);
     } else {
@@ -556,7 +1163,7 @@ void MemTableList::PickMemtablesToFlush(uint64_t max_memtable_id,
   // ret is filled with memtables already sorted in increasing MemTable ID.
   // However, when the mempurge feature is activated, new memtables with older
   // IDs will be added to the memlist.
-  LOG_CERR("memlist::imm_size::", memlist.size());
+  DM_LOG_DEBUG("memlist::imm_size::", memlist.size());
   for (auto it = memlist.rbegin(); it != memlist.rend(); ++it) {
     MemTable* m = *it;
     if (!atomic_flush && m->atomic_flush_seqno_ != kMaxSequenceNumber) {
@@ -632,7 +1239,9 @@ Status MemTableList::TryInstallMemtableFlushResults(
     assert(i == 0 || mems[i]->GetEdits()->NumEntries() == 0);
 
     mems[i]->flush_completed_ = true;
-    mems[i]->file_number_ = file_number[i];  // debug
+    // one entry per output shard, not per memtable; the first tells the
+    // memtables of this job apart from those of other jobs
+    mems[i]->file_number_ = file_number[0];  // debug
   }
 
   // if some other thread is already committing, then return
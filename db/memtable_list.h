@@ -46,9 +46,9 @@ class MemTableListVersion {
  public:
   size_t imm_size() const { return memlist_.size() + memlist_history_.size(); }
   void check_remote() {
-    LOG_CERR("memlist_::size::", memlist_.size());
+    DM_LOG_DEBUG("memlist_::size::", memlist_.size());
     for (auto& ptr : memlist_) {
-      LOG_CERR(ptr->IsTransferCompleted() ? "true" : "false");
+      DM_LOG_DEBUG(ptr->IsTransferCompleted() ? "true" : "false");
     }
   }
   explicit MemTableListVersion(size_t* parent_memtable_list_memory_usage,
@@ -88,8 +88,12 @@ class MemTableListVersion {
                is_blob_index, read_client, column_family_id, cfd_);
   }
 
+  // Offloaded memtables are searched by the memnode, with all keys of the
+  // range still pending sent in a single delegated read batch.
   void MultiGet(const ReadOptions& read_options, MultiGetRange* range,
-                ReadCallback* callback);
+                ReadCallback* callback, RDMAReadClient* read_client = nullptr,
+                uint64_t column_family_id = 0,
+                ColumnFamilyData* cfd_ = nullptr);
 
   // Returns all the merge operands corresponding to the key by searching all
   // memtables starting from the most recent one.
@@ -123,13 +127,18 @@ class MemTableListVersion {
   Status AddRangeTombstoneIterators(const ReadOptions& read_opts, Arena* arena,
                                     RangeDelAggregator* range_del_agg);
 
+  // With a read client, offloaded memtables are scanned on the memnode
+  // through delegated iterators instead of their local copies.
   void AddIterators(const ReadOptions& options,
                     std::vector<InternalIterator*>* iterator_list,
-                    Arena* arena);
+                    Arena* arena, RDMAReadClient* read_client = nullptr,
+                    ColumnFamilyData* cfd_ = nullptr);
 
   void AddIterators(const ReadOptions& options,
                     MergeIteratorBuilder* merge_iter_builder,
-                    bool add_range_tombstone_iter);
+                    bool add_range_tombstone_iter,
+                    RDMAReadClient* read_client = nullptr,
+                    ColumnFamilyData* cfd_ = nullptr);
 
   uint64_t GetTotalNumEntries() const;
 
@@ -183,6 +192,14 @@ class MemTableListVersion {
                    RDMAReadClient* read_client = nullptr, uint64_t cfd_id = 0,
                    ColumnFamilyData* cfd_ = nullptr);
 
+  // the cnt-th memtable of memlist_ is scanned locally unless offloaded
+  InternalIterator* NewMemTableIterator(MemTable* m, int cnt,
+                                        const ReadOptions& options,
+                                        Arena* arena,
+                                        RDMAReadClient* read_client,
+                                        ColumnFamilyData* cfd_,
+                                        uint64_t acc_id);
+
   void AddMemTable(MemTable* m);
 
   void UnrefMemTable(autovector<MemTable*>* to_delete, MemTable* m);
@@ -293,6 +310,7 @@ class MemTableList {
 
   // Try commit a successful flush in the manifest file. It might just return
   // Status::OK letting a concurrent flush to do the actual the recording.
+  // file_number holds the file number of each output shard of the flush.
   Status TryInstallMemtableFlushResults(
       ColumnFamilyData* cfd, const MutableCFOptions& mutable_cf_options,
       const autovector<MemTable*>& m, LogsWithPrepTracker* prep_tracker,
@@ -73,6 +73,7 @@
 #include "logging/event_logger.h"
 #include "logging/log_buffer.h"
 #include "logging/logging.h"
+#include "memory/remote_shard_fetcher.h"
 #include "monitoring/iostats_context_imp.h"
 #include "monitoring/perf_context_imp.h"
 #include "monitoring/thread_status_util.h"
@@ -135,6 +136,7 @@ RemoteFlushJob::RemoteFlushJob(
       db_directory_(db_directory),
       output_file_directory_(output_file_directory),
       output_compression_(output_compression),
+      shard_num_(cfd->ioptions()->memtable_shard_num),
       sync_output_directory_(sync_output_directory),
       write_manifest_(write_manifest),
       edit_(nullptr),
@@ -179,7 +181,8 @@ void RemoteFlushJob::PackLocal(TransferService* node) const {
     node->send(&msg, sizeof(size_t));
   }
   db_mutex_->Unlock();
-  for (int i = 0; i < 4; i++) meta_[i].PackLocal(node);
+  node->send(&shard_num_, sizeof(int));
+  for (int i = 0; i < shard_num_; i++) meta_[i].PackLocal(node);
   file_options_.PackLocal(node);
   // db_mutex_->Lock();
   // db_mutex_->Unlock();
@@ -222,17 +225,17 @@ void RemoteFlushJob::PackLocal(TransferService* node) const {
 }
 
 void RemoteFlushJob::DoubleCheck(TransferService* node) const {
-  LOG_CERR("RemoteFlushJob::DoubleCheck::versions_");
+  DM_LOG_DEBUG("RemoteFlushJob::DoubleCheck::versions_");
   versions_->DoubleCheck(node);
-  LOG_CERR("RemoteFlushJob::DoubleCheck::edit_: ptr=",
-           reinterpret_cast<void*>(edit_));
+  DM_LOG_DEBUG("RemoteFlushJob::DoubleCheck::edit_: ptr=",
+               reinterpret_cast<void*>(edit_));
   if (edit_ != nullptr) edit_->DoubleCheck(node);
   cfd_->DoubleCheck(node);
-  LOG_CERR("RemoteFlushJob::DoubleCheck::base_: ptr=",
-           reinterpret_cast<void*>(base_));
+  DM_LOG_DEBUG("RemoteFlushJob::DoubleCheck::base_: ptr=",
+               reinterpret_cast<void*>(base_));
   if (base_ != nullptr) base_->DoubleCheck(node);
-  LOG_CERR("RemoteFlushJob::DoubleCheck::meta_");
-  for (int i = 0; i < 4; i++) meta_[i].DoubleCheck(node);
+  DM_LOG_DEBUG("RemoteFlushJob::DoubleCheck::meta_");
+  for (int i = 0; i < shard_num_; i++) meta_[i].DoubleCheck(node);
 }
 
 void* RemoteFlushJob::UnPackLocal(RDMAClient* client, TransferService* node,
@@ -252,30 +255,33 @@ void* RemoteFlushJob::UnPackLocal(RDMAClient* client, TransferService* node,
   size_t memtable_size = temp_mems.size();
 
   void* versions_ret = VersionSet::UnPackLocal(node);
-  LOG_CERR("RemoteFlushJob::UnPackLocal::versions_");
+  DM_LOG_DEBUG("RemoteFlushJob::UnPackLocal::versions_");
   void* edit_ret = VersionEdit::UnPackLocal(node);
-  LOG_CERR("RemoteFlushJob::UnPackLocal::edit_")
+  DM_LOG_DEBUG("RemoteFlushJob::UnPackLocal::edit_");
   void* job_context_ret = JobContext::UnPackLocal(node);
-  LOG_CERR("RemoteFlushJob::UnPackLocal::job_context_");
+  DM_LOG_DEBUG("RemoteFlushJob::UnPackLocal::job_context_");
   void* db_impl_seqno_time_mapping_ret = SeqnoToTimeMapping::UnPackLocal(node);
   void* seqno_to_time_mapping_ret = SeqnoToTimeMapping::UnPackLocal(node);
-  LOG_CERR("RemoteFlushJob::UnPackLocal::seqno_to_time_mapping_")
+  DM_LOG_DEBUG("RemoteFlushJob::UnPackLocal::seqno_to_time_mapping_");
   void* cfd_ret = ColumnFamilyData::UnPackLocal(node);
-  LOG_CERR("RemoteFlushJob::UnPackLocal::cfd_");
+  DM_LOG_DEBUG("RemoteFlushJob::UnPackLocal::cfd_");
   size_t base_version_flag = 0;
   node->receive(&base_version_flag, sizeof(size_t));
   void* base_version_ret = nullptr;
   if (base_version_flag == 0) {
-    LOG_CERR("RemoteFlushJob::UnPackLocal::base_");
+    DM_LOG_DEBUG("RemoteFlushJob::UnPackLocal::base_");
     base_version_ret = Version::UnPackLocal(node, cfd_ret);
   }
-  LOG_CERR("RemoteFlushJob::UnPackLocal::base_::1");
-  void* meta_ret[4] = {nullptr, nullptr, nullptr, nullptr};
-  for (int i = 0; i < 4; i++) {
-    LOG_CERR("RemoteFlushJob::UnPackLocal::meta_", i);
+  DM_LOG_DEBUG("RemoteFlushJob::UnPackLocal::base_::1");
+  int shard_num = 0;
+  node->receive(&shard_num, sizeof(int));
+  assert(shard_num > 0 && shard_num <= kMaxMemTableShards);
+  void* meta_ret[kMaxMemTableShards] = {nullptr};
+  for (int i = 0; i < shard_num; i++) {
+    DM_LOG_DEBUG("RemoteFlushJob::UnPackLocal::meta_", i);
     meta_ret[i] = FileMetaData::UnPackLocal(node);
   }
-  LOG_CERR("RemoteFlushJob::UnPackLocal::meta_::p");
+  DM_LOG_DEBUG("RemoteFlushJob::UnPackLocal::meta_::p");
   void* file_options_ret = FileOptions::UnPackLocal(node);
   // void* mutable_cf_options_ret =
   //     MutableCFOptions::UnPackLocal(worker_socket_fd);
@@ -324,6 +330,7 @@ void* RemoteFlushJob::UnPackLocal(RDMAClient* client, TransferService* node,
 
   // fill local_handler
   local_handler->remote_db_ = remote_db;
+  local_handler->shard_fetcher_ = nullptr;
   local_handler->clock_ = reinterpret_cast<SystemClock*>(clock_ret_addr);
   local_handler->db_mutex_ = new InstrumentedMutex();
   // local_handler->db_mutex_->Unlock();
@@ -339,7 +346,11 @@ void* RemoteFlushJob::UnPackLocal(RDMAClient* client, TransferService* node,
 
   local_handler->db_directory_ = nullptr;
   LOG("local_handler copy FileMetaData");
-  for (int i = 0; i < 4; i++) {
+  for (int i = 0; i < kMaxMemTableShards; i++) {
+    if (i >= shard_num) {
+      new (&(local_handler->meta_[i])) FileMetaData();
+      continue;
+    }
     new (&(local_handler->meta_[i]))
         FileMetaData(*reinterpret_cast<FileMetaData*>(meta_ret[i]));
     free(meta_ret[i]);
@@ -381,7 +392,7 @@ void* RemoteFlushJob::UnPackLocal(RDMAClient* client, TransferService* node,
     local_handler->existing_snapshots_.emplace_back(snapshot);
   }
   // table_properties_ construct local empty version
-  for (int i = 0; i < 4; i++)
+  for (int i = 0; i < kMaxMemTableShards; i++)
     new (&local_handler->table_properties_[i]) TableProperties();
   char* hack_dboption_ptr = reinterpret_cast<char*>(&local_handler->cfd_);
   hack_dboption_ptr += sizeof(ColumnFamilyData*);
@@ -409,12 +420,19 @@ void RemoteFlushJob::PackRemote(TransferService* node) const {
   assert(mems_.size() > 0);
   mems_[0]->PackRemote(node);
   versions_->PackRemote(node);
-  for (int i = 0; i < 4; i++) table_properties_[i].PackRemote(node);
+  for (int i = 0; i < shard_num_; i++) table_properties_[i].PackRemote(node);
   edit_->PackRemote(node);
-  for (int i = 0; i < 4; i++) meta_[i].PackRemote(node);
+  for (int i = 0; i < shard_num_; i++) meta_[i].PackRemote(node);
+  FreeUnpacked();
+  LOG("RemoteFlushJob::PackRemote done");
+}
+
+void RemoteFlushJob::FreeUnpacked() const {
   edit_->free_remote();
   cfd_->free_remote();
-  for (int i = 0; i < 4; i++) table_properties_[i].~TableProperties();
+  for (int i = 0; i < kMaxMemTableShards; i++) {
+    table_properties_[i].~TableProperties();
+  }
   versions_->free_remote();
   // delete db_mutex_;
   const_cast<std::string*>(&db_id_)->~basic_string();
@@ -431,14 +449,13 @@ void RemoteFlushJob::PackRemote(TransferService* node) const {
       const_cast<SeqnoToTimeMapping*>(&seqno_to_time_mapping_));
   ptr -= sizeof(SeqnoToTimeMapping*);
   free(*reinterpret_cast<void**>(ptr));
-  LOG("RemoteFlushJob::PackRemote done");
 }
 void RemoteFlushJob::UnPackRemote(TransferService* node) {
   assert(mems_.size() > 0);
   mems_[0]->UnPackRemote(node);
   db_mutex_->Lock();
   VersionSet::UnPackRemote(node, versions_);
-  for (int i = 0; i < 4; i++) {
+  for (int i = 0; i < shard_num_; i++) {
     auto new_table_properties =
         reinterpret_cast<TableProperties*>(TableProperties::UnPackRemote(node));
     table_properties_[i] = *new_table_properties;
@@ -446,7 +463,7 @@ void RemoteFlushJob::UnPackRemote(TransferService* node) {
   }
   db_mutex_->Unlock();
   edit_->UnPackRemote(node);
-  for (int i = 0; i < 4; i++) {
+  for (int i = 0; i < shard_num_; i++) {
     auto remote_metadata =
         reinterpret_cast<FileMetaData*>(FileMetaData::UnPackRemote(node));
 
@@ -571,6 +588,29 @@ void RemoteFlushJob::PickMemTable() {
   if (mems_.empty()) {
     return;
   }
+  // a job is flushed by the memnode holding its memtables, the newer ones
+  // offloaded elsewhere go back for a following job
+  if (cfd_->num_memnodes() > 1) {
+    memnode_ = cfd_->MemNodeOf(*mems_[0]);
+    size_t keep = 1;
+    while (keep < mems_.size() && cfd_->MemNodeOf(*mems_[keep]) == memnode_) {
+      keep++;
+    }
+    if (keep < mems_.size()) {
+      autovector<MemTable*> rest;
+      max_next_log_number = 0;
+      for (size_t i = 0; i < mems_.size(); i++) {
+        if (i < keep) {
+          max_next_log_number =
+              std::max(mems_[i]->GetNextLogNumber(), max_next_log_number);
+        } else {
+          rest.push_back(mems_[i]);
+        }
+      }
+      mems_.resize(keep);
+      cfd_->imm()->RollbackMemtableFlush(rest, 0);
+    }
+  }
 
   ReportFlushInputSize(mems_);
 
@@ -586,10 +626,12 @@ void RemoteFlushJob::PickMemTable() {
   edit_->SetColumnFamily(cfd_->GetID());
 
   // path 0 for level 0 file.
-  for (int i = 0; i < 4; i++)
+  for (int i = 0; i < shard_num_; i++)
     meta_[i].fd = FileDescriptor(versions_->NewFileNumber(), 0, 0);
   // uint64_t new_epoch = cfd_->NewEpochNumber();
-  for (int i = 0; i < 4; i++) meta_[i].epoch_number = cfd_->NewEpochNumber();
+  for (int i = 0; i < shard_num_; i++) {
+    meta_[i].epoch_number = cfd_->NewEpochNumber();
+  }
 
   base_ = cfd_->current();
   base_->Ref();  // it is likely that we do not need this reference
@@ -659,12 +701,19 @@ Status RemoteFlushJob::RunRemote(
     // We create connection with one memnode and send package to it
     std::chrono::high_resolution_clock::time_point f1 =
         std::chrono::high_resolution_clock::now();
-    void* tmp_data = local_generator_rdma_client->get_buf() +
-                     cfd_->get_built_memreg_info()->rf_meta_local_offset;
-    size_t buf_size =
-        cfd_->get_built_memreg_info()->rf_meta_remote_offset.second -
-        cfd_->get_built_memreg_info()->rf_meta_remote_offset.first;
-    BufTransferService transfer_service(tmp_data, buf_size);
+    auto* memnode = cfd_->memnode(memnode_);
+    void* tmp_data =
+        local_generator_rdma_client->get_buf() + memnode->rf_meta_local_offset;
+    size_t buf_size = memnode->rf_meta_remote_offset.second -
+                      memnode->rf_meta_remote_offset.first;
+    PackageWriteService transfer_service(tmp_data, buf_size);
+
+    // first, so that a worker that gives up early still knows whom to tell
+    int port = (*get_available_port)();
+    transfer_service.send(&port, sizeof(int));
+    size_t ip_size = local_ip.size();
+    transfer_service.send(&ip_size, sizeof(size_t));
+    if (ip_size > 0) transfer_service.send(local_ip.c_str(), local_ip.size());
 
     size_t mem_size = mems_.size();
     transfer_service.send(&mem_size, sizeof(size_t));
@@ -680,62 +729,73 @@ Status RemoteFlushJob::RunRemote(
                           ((uint64_t)cfd_->GetID() << 32) | memtable->GetID());
     PackLocal(&transfer_service);
 
-    int port = (*get_available_port)();
-    transfer_service.send(&port, sizeof(int));
-    size_t ip_size = local_ip.size();
-    transfer_service.send(&ip_size, sizeof(size_t));
-    if (ip_size > 0) transfer_service.send(local_ip.c_str(), local_ip.size());
-
-    // note: exceed buf size might cause free(): invalid pointer or double free
-    // error assert(transfer_service.get_size() < buf_size);  // 39775/46065 for
-    // now
-    ASSERT_RW(MatchMemNode(memnodes_) == Status::OK());
-    std::chrono::high_resolution_clock::time_point f2 =
-        std::chrono::high_resolution_clock::now();
-
-    local_generator_rdma_client->rdma_write(
-        rdma_conn, buf_size,
-        cfd_->get_built_memreg_info()->rf_meta_local_offset,
-        cfd_->get_built_memreg_info()->rf_meta_remote_offset.first);
-    ASSERT_RW(local_generator_rdma_client->poll_completion(rdma_conn) == 0);
-    {
-      char req_type = 8;
-      ASSERT_RW(writen(rdma_conn->sock, &req_type, sizeof(char)) ==
+    size_t package_size = transfer_service.Finish();
+    if (package_size == 0) {
+      // larger than the REMOTE_FLUSH_PACKAGE_SIZE bytes the memnode keeps
+      s = Status::Aborted("remote flush package overflow");
+      db_mutex_->Lock();
+      base_->Unref();
+    } else {
+      ASSERT_RW(MatchMemNode(memnodes_) == Status::OK());
+      std::chrono::high_resolution_clock::time_point f2 =
+          std::chrono::high_resolution_clock::now();
+
+      local_generator_rdma_client->rdma_write(
+          rdma_conn, package_size, memnode->rf_meta_local_offset,
+          memnode->rf_meta_remote_offset.first);
+      ASSERT_RW(local_generator_rdma_client->poll_completion(rdma_conn) == 0);
+      char admitted = 8;
+      ASSERT_RW(writen(rdma_conn->sock, &admitted, sizeof(char)) ==
                 sizeof(char));
-      ASSERT_RW(readn(rdma_conn->sock, &req_type, sizeof(char)) ==
+      ASSERT_RW(readn(rdma_conn->sock, &admitted, sizeof(char)) ==
                 sizeof(char));
+      cfd_->putback_meta_conn(memnode_, rdma_conn);
+
+      // close connection with memnode
+      ASSERT_RW(QuitMemNode().ok());
+      if (admitted != 1) {
+        // no worker was picked, the memtables are flushed again later
+        DM_LOG_WARN("memnode refused the remote flush of ", mems_.size(),
+                    " memtables");
+        s = Status::MemoryLimit("memnode has no room for the flush package");
+        db_mutex_->Lock();
+        base_->Unref();
+      } else {
+        // s = WriteLevel0Table();
+        // assert(s == Status::OK());
+        std::chrono::high_resolution_clock::time_point f3 =
+            std::chrono::high_resolution_clock::now();
+
+        // We receive some metadata directly from remote worker
+        // Or maybe we could receive from memnode
+        ASSERT_RW(MatchRemoteWorker(port) == Status::OK());
+        TCPTransferService transfer_service2(&local_generator_node);
+        char worker_ok = 0;
+        transfer_service2.receive(&worker_ok, sizeof(char));
+        if (worker_ok == 1) {
+          UnPackRemote(&transfer_service2);
+        } else {
+          // the memtables stay on the memnode and are picked again
+          s = Status::Aborted("remote flush worker gave up");
+          db_mutex_->Lock();
+          base_->Unref();
+        }
+        std::chrono::high_resolution_clock::time_point f4 =
+            std::chrono::high_resolution_clock::now();
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        DM_LOG_DEBUG(":::::::: ", duration_cast<microseconds>(f2 - f1).count(),
+                     " ", duration_cast<microseconds>(f3 - f2).count(), " ",
+                     duration_cast<microseconds>(f4 - f3).count(), " ",
+                     duration_cast<microseconds>(f4 - f1).count());
+        // s = Status::OK();
+        ASSERT_RW(QuitRemoteWorker() == Status::OK());
+        LOG(edit_->DebugString());
+        LOG(meta_.DebugString());
+        LOG(table_properties_.ToString());
+        assert(stats_ == cfd_->ioptions()->stats);
+      }
     }
-    cfd_->putback_meta_conn(rdma_conn);
-
-    // close connection with memnode
-    ASSERT_RW(QuitMemNode().ok());
-    // s = WriteLevel0Table();
-    // assert(s == Status::OK());
-    std::chrono::high_resolution_clock::time_point f3 =
-        std::chrono::high_resolution_clock::now();
-
-    // We receive some metadata directly from remote worker
-    // Or maybe we could receive from memnode
-    ASSERT_RW(MatchRemoteWorker(port) == Status::OK());
-    TCPTransferService transfer_service2(&local_generator_node);
-    UnPackRemote(&transfer_service2);
-    std::chrono::high_resolution_clock::time_point f4 =
-        std::chrono::high_resolution_clock::now();
-    LOG_CERR(
-        ":::::::: ",
-        std::chrono::duration_cast<std::chrono::microseconds>(f2 - f1).count(),
-        " ",
-        std::chrono::duration_cast<std::chrono::microseconds>(f3 - f2).count(),
-        " ",
-        std::chrono::duration_cast<std::chrono::microseconds>(f4 - f3).count(),
-        " ",
-        std::chrono::duration_cast<std::chrono::microseconds>(f4 - f1).count());
-    // s = Status::OK();
-    ASSERT_RW(QuitRemoteWorker() == Status::OK());
-    LOG(edit_->DebugString());
-    LOG(meta_.DebugString());
-    LOG(table_properties_.ToString());
-    assert(stats_ == cfd_->ioptions()->stats);
   }
   db_mutex_->AssertHeld();
   if (s.ok() && cfd_->IsDropped()) {
@@ -748,14 +808,15 @@ Status RemoteFlushJob::RunRemote(
 
   if (!s.ok()) {
     LOG("Run job: write l0table failed, rollback");
-    for (int i = 0; i < 4; i++)
+    for (int i = 0; i < shard_num_; i++)
       cfd_->imm()->RollbackMemtableFlush(mems_, meta_[i].fd.GetNumber());
   } else if (write_manifest_) {
     LOG("Run job: write l0table success, install results");
+    MergeShardRuns();
     TEST_SYNC_POINT("RemoteFlushJob::InstallResults");
     // Replace immutable memtable with the generated Table
-    uint64_t fdnum[4] = {0, 0, 0, 0};
-    for (int i = 0; i < 4; i++) fdnum[i] = meta_[i].fd.GetNumber();
+    uint64_t fdnum[kMaxMemTableShards] = {0};
+    for (int i = 0; i < shard_num_; i++) fdnum[i] = meta_[i].fd.GetNumber();
     s = cfd_->imm()->TryInstallMemtableFlushResults(
         cfd_, mutable_cf_options_, mems_, prep_tracker, versions_, db_mutex_,
          &job_context_->memtables_to_free, db_directory_,
@@ -767,7 +828,7 @@ Status RemoteFlushJob::RunRemote(
   }
 
   if (s.ok() && file_meta != nullptr) {
-    for (int i = 0; i < 4; i++) file_meta[i] = meta_[i];
+    for (int i = 0; i < shard_num_; i++) file_meta[i] = meta_[i];
   }
   RecordFlushIOStats();
   uint64_t end = Env::Default()->NowMicros();
@@ -821,7 +882,7 @@ Status RemoteFlushJob::QuitMemNode() { return Status::OK(); }
 Status RemoteFlushJob::MatchMemNode(
     std::vector<std::pair<std::string, size_t>>* ip_port_list) {
   while (true) {
-    rdma_conn = cfd_->try_get_meta_conn();
+    rdma_conn = cfd_->try_get_meta_conn(memnode_);
     if (rdma_conn) break;
   }
   return Status::OK();
@@ -845,13 +906,20 @@ Status RemoteFlushJob::RunLocal(LogsWithPrepTracker* prep_tracker,
   db_mutex_->Lock();
   std::mutex thr_mu;
   std::vector<std::thread> thrs;
-  thrs.reserve(4);
-  for (int i = 0; i < 4; i++) {
-    thrs.emplace_back([this, i, &thr_mu]() {
-      Status ret = WriteLevel0Table(i, &thr_mu);
+  // the first shard that failed decides for the whole flush
+  Status s;
+  thrs.reserve(shard_num_);
+  for (int i = 0; i < shard_num_; i++) {
+    thrs.emplace_back([this, i, &thr_mu, &s]() {
+      Status ret;
+      if (shard_fetcher_ != nullptr) ret = shard_fetcher_->WaitShard(i);
+      if (ret.ok()) ret = WriteLevel0Table(i, &thr_mu);
       if (!ret.ok()) {
-        LOG_CERR("WriteLevel0Table failed: ", ret.ToString());
+        DM_LOG_ERROR("WriteLevel0Table failed: ", ret.ToString());
+        std::lock_guard<std::mutex> lck(thr_mu);
+        if (s.ok()) s = ret;
       }
+      if (shard_fetcher_ != nullptr) shard_fetcher_->ReleaseShard(i);
     });
   }
   for (auto& thr : thrs) {
@@ -859,13 +927,13 @@ Status RemoteFlushJob::RunLocal(LogsWithPrepTracker* prep_tracker,
   }
   std::chrono::high_resolution_clock::time_point local_flush_end =
       std::chrono::high_resolution_clock::now();
-  LOG_CERR("RemoteFlushJob::RunLocal local_flush_all_time: ",
-           std::chrono::duration_cast<std::chrono::milliseconds>(
+  DM_LOG_DEBUG("RemoteFlushJob::RunLocal local_flush_all_time: ",
+               std::chrono::duration_cast<std::chrono::milliseconds>(
                local_flush_end - local_flush_begin)
                .count(),
-           "ms");
+               "ms");
   LOG("worker calculation finished");
-  return Status::OK();
+  return s;
 }
 
 void RemoteFlushJob::Cancel() {
@@ -1112,7 +1180,7 @@ Status RemoteFlushJob::MemPurge() {
         new_mem->Ref();
         // Piggyback RemoteFlushJobInfo on the first flushed memtable.
         db_mutex_->AssertHeld();
-        for (int i = 0; i < 4; i++) meta_[i].fd.file_size = 0;
+        for (int i = 0; i < shard_num_; i++) meta_[i].fd.file_size = 0;
         mems_[0]->SetFlushJobInfo(GetFlushJobInfo(0));
         db_mutex_->Unlock();
       } else {
@@ -1424,7 +1492,7 @@ Status RemoteFlushJob::WriteLevel0Table(int sep, std::mutex* thr_mtx) {
         std::string msg = "Expected " + std::to_string(total_num_entries) +
                           " entries in memtables, but read " +
                           std::to_string(num_input_entries);
-        LOG_CERR("sep:: ", sep, ":: ", msg);
+        DM_LOG_DEBUG("sep:: ", sep, ":: ", msg);
       }
       if (tboptions.reason == TableFileCreationReason::kFlush) {
         TEST_SYNC_POINT("DBImpl::RemoteFlushJob:Flush");
@@ -1449,7 +1517,7 @@ Status RemoteFlushJob::WriteLevel0Table(int sep, std::mutex* thr_mtx) {
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
   const bool has_output = meta_[sep].fd.GetFileSize() > 0;
-  LOG_CERR("sep:: new file size: ", sep, ' ', meta_[sep].fd.GetFileSize());
+  DM_LOG_DEBUG("sep:: new file size: ", sep, ' ', meta_[sep].fd.GetFileSize());
 
   if (s.ok() && has_output) {
     TEST_SYNC_POINT("DBImpl::RemoteFlushJob:SSTFileCreated");
@@ -1530,6 +1598,37 @@ Env::IOPriority RemoteFlushJob::GetRateLimiterPriorityForWrite() {
   return Env::IO_HIGH;
 }
 
+void RemoteFlushJob::MergeShardRuns() {
+  // The picker of universal compaction counts every L0 file as a run.
+  if (cfd_->ioptions()->compaction_style != kCompactionStyleLevel) return;
+  std::vector<FileMetaData*> outputs;
+  for (int i = 0; i < shard_num_; i++) {
+    if (meta_[i].fd.GetFileSize() > 0) outputs.push_back(meta_ + i);
+  }
+  if (outputs.size() < 2) return;
+  // Shards of one memtable are range-disjoint, but learned partitions can
+  // differ between the memtables of a flush and range tombstones widen the
+  // output they land in, so check the files that were written.
+  const Comparator* ucmp = cfd_->user_comparator();
+  std::sort(outputs.begin(), outputs.end(),
+            [ucmp](const FileMetaData* a, const FileMetaData* b) {
+              return ucmp->Compare(a->smallest.user_key(),
+                                   b->smallest.user_key()) < 0;
+            });
+  uint64_t epoch_number = outputs[0]->epoch_number;
+  for (size_t i = 1; i < outputs.size(); i++) {
+    if (ucmp->Compare(outputs[i - 1]->largest.user_key(),
+                      outputs[i]->smallest.user_key()) >= 0) {
+      DM_LOG_DEBUG("flush outputs overlap, keeping ", outputs.size(),
+                   " L0 runs");
+      return;
+    }
+    epoch_number = std::min(epoch_number, outputs[i]->epoch_number);
+  }
+  for (FileMetaData* f : outputs) f->epoch_number = epoch_number;
+  edit_->SetNewFilesEpochNumber(epoch_number);
+}
+
 std::unique_ptr<FlushJobInfo> RemoteFlushJob::GetFlushJobInfo(int sep) const {
   db_mutex_->AssertHeld();
   std::unique_ptr<FlushJobInfo> info(new FlushJobInfo{});
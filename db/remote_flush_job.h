@@ -56,6 +56,7 @@ namespace ROCKSDB_NAMESPACE {
 
 class DBImpl;
 class MemTable;
+class RemoteShardFetcher;
 class SnapshotChecker;
 class TableCache;
 class Version;
@@ -72,6 +73,8 @@ class RemoteFlushJob {
  private:
   RDMANode::rdma_connection* rdma_conn;
 #endif
+  // memnode holding mems_, the one the job package goes to
+  size_t memnode_ = 0;
 
  public:
   static std::shared_ptr<RemoteFlushJob> CreateRemoteFlushJob(
@@ -100,7 +103,11 @@ class RemoteFlushJob {
   void DoubleCheck(TransferService* node) const;
   static void* UnPackLocal(RDMAClient* client, TransferService* node,
                            DBImpl* remote_db, std::vector<MemTable*>& mems);
+  // sends the flush results back and frees what UnPackLocal() built
   void PackRemote(TransferService* node) const;
+  // frees what UnPackLocal() built on the worker without sending anything,
+  // for a flush the worker gave up
+  void FreeUnpacked() const;
   void UnPackRemote(TransferService* node);
 
  private:
@@ -152,6 +159,10 @@ class RemoteFlushJob {
 
   void Cancel();
   const autovector<MemTable*>& GetMemTables() const { return mems_; }
+  // RunLocal() builds the SST of a shard once fetcher has it resident
+  void SetShardFetcher(RemoteShardFetcher* fetcher) {
+    shard_fetcher_ = fetcher;
+  }
 
   std::list<std::unique_ptr<FlushJobInfo>>* GetCommittedFlushJobsInfo() {
     return &committed_flush_jobs_info_;
@@ -164,6 +175,9 @@ class RemoteFlushJob {
   void ReportFlushInputSize(const autovector<MemTable*>& mems);
   void RecordFlushIOStats();
   Status WriteLevel0Table(int sep, std::mutex* thr_mtx);
+  // Installs the shard outputs as one L0 sorted run if their key ranges
+  // are disjoint.
+  void MergeShardRuns();
 
   // Memtable Garbage Collection algorithm: a MemPurge takes the list
   // of immutable memtables and filters out (or "purge") the outdated bytes
@@ -214,7 +228,9 @@ class RemoteFlushJob {
   FSDirectory* db_directory_;
   FSDirectory* output_file_directory_;
   CompressionType output_compression_;
-  TableProperties table_properties_[4];
+  // kv shards of every picked memtable, one output file each
+  int shard_num_;
+  TableProperties table_properties_[kMaxMemTableShards];
   // True if this flush job should call fsync on the output directory. False
   // otherwise.
   // Usually sync_output_directory_ is true. A flush job needs to call sync on
@@ -238,7 +254,7 @@ class RemoteFlushJob {
   std::list<std::unique_ptr<FlushJobInfo>> committed_flush_jobs_info_;
 
   // Variables below are set by PickMemTable():
-  FileMetaData meta_[4];
+  FileMetaData meta_[kMaxMemTableShards];
   autovector<MemTable*> mems_;
   VersionEdit* edit_;
   Version* base_;
@@ -255,6 +271,7 @@ class RemoteFlushJob {
   const SeqnoToTimeMapping& db_impl_seqno_time_mapping_;
   SeqnoToTimeMapping seqno_to_time_mapping_;
   DBImpl* remote_db_ = nullptr;
+  RemoteShardFetcher* shard_fetcher_ = nullptr;
 };
 
 }  // namespace ROCKSDB_NAMESPACE
@@ -44,8 +44,8 @@ inline void* SliceTransformFactory::UnPackLocal(TransferService* node) {
   } else if (type == 4) {
     return nullptr;
   } else {
-    LOG_CERR("SliceTransformFactory::UnPackLocal: error: ", uint8_t(type), ' ',
-             info);
+    DM_LOG_ERROR("SliceTransformFactory::UnPackLocal: error: ", uint8_t(type),
+                 ' ', info);
     assert(false);
     return nullptr;
   }
@@ -213,51 +213,53 @@ void* FileMetaData::UnPackRemote(TransferService* node) {
 }
 
 void FileMetaData::DoubleCheck(TransferService* node) const {
-  LOG_CERR("CheckDouble:: FileMetaData::fd:", fd.file_size, ' ',
-           fd.smallest_seqno, ' ', fd.largest_seqno, ' ',
-           fd.packed_number_and_path_id);
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::fd:", fd.file_size, ' ',
+               fd.smallest_seqno, ' ', fd.largest_seqno, ' ',
+               fd.packed_number_and_path_id);
   node->send(&(fd.file_size), sizeof(uint64_t));
   node->send(&(fd.smallest_seqno), sizeof(SequenceNumber));
   node->send(&(fd.largest_seqno), sizeof(SequenceNumber));
   node->send(&(fd.packed_number_and_path_id), sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::smallest", smallest.DebugString(true));
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::smallest",
+               smallest.DebugString(true));
   size_t ret_val = smallest.size();
   node->send(&ret_val, sizeof(size_t));
   node->send(smallest.get_rep()->data(), smallest.size());
-  LOG_CERR("CheckDouble:: FileMetaData::largest", largest.DebugString(true));
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::largest",
+               largest.DebugString(true));
   ret_val = largest.size();
   node->send(&ret_val, sizeof(size_t));
   node->send(largest.get_rep()->data(), largest.size());
-  LOG_CERR("CheckDouble:: FileMetaData::compensated_file_size",
-           compensated_file_size, ' ', num_entries, ' ', num_deletions, ' ',
-           raw_key_size, ' ', raw_value_size, ' ', num_range_deletions, ' ',
-           compensated_range_deletion_size, ' ', refs, ' ', file_creation_time,
-           ' ', epoch_number, ' ', file_checksum, ' ', unique_id.at(0), ' ',
-           unique_id.at(1));
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::compensated_file_size",
+               compensated_file_size, ' ', num_entries, ' ', num_deletions, ' ',
+               raw_key_size, ' ', raw_value_size, ' ', num_range_deletions, ' ',
+               compensated_range_deletion_size, ' ', refs, ' ',
+               file_creation_time, ' ', epoch_number, ' ', file_checksum, ' ',
+               unique_id.at(0), ' ', unique_id.at(1));
   node->send(&compensated_file_size, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::num_entries");
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::num_entries");
   node->send(&num_entries, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::num_deletions");
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::num_deletions");
   node->send(&num_deletions, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::raw_key_size:", raw_key_size);
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::raw_key_size:", raw_key_size);
   node->send(&raw_key_size, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::raw_value_size:", raw_value_size);
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::raw_value_size:", raw_value_size);
   node->send(&raw_value_size, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::num_range_deletions");
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::num_range_deletions");
   node->send(&num_range_deletions, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::compensated_range_deletion_size");
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::compensated_range_deletion_size");
   node->send(&compensated_range_deletion_size, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::refs");
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::refs");
   node->send(&refs, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::file_creation_time");
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::file_creation_time");
   node->send(&file_creation_time, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::epoch_number");
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::epoch_number");
   node->send(&epoch_number, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: FileMetaData::file_checksum");
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::file_checksum");
   size_t file_checksum_len = file_checksum.size();
   node->send(&file_checksum_len, sizeof(size_t));
   node->send(file_checksum.c_str(), file_checksum_len);
-  LOG_CERR("CheckDouble:: FileMetaData::unique_id");
+  DM_LOG_DEBUG("CheckDouble:: FileMetaData::unique_id");
   uint64_t uid[2] = {unique_id.at(0), unique_id.at(1)};
   node->send(uid, sizeof(uint64_t) * 2);
 }
@@ -416,22 +418,22 @@ void* VersionEdit::UnPackLocal(TransferService* node,
     delete[] str_;
   }
 
-  LOG_CERR("UnpackLocal:: DeletedFiles")
+  DM_LOG_DEBUG("UnpackLocal:: DeletedFiles");
   new (&ret_version_edit_->deleted_files_) DeletedFiles();
   ret_version_edit_->deleted_files_.clear();
   size_t deleted_files_size_ = 0;
   node->receive(&deleted_files_size_, sizeof(size_t));
-  LOG_CERR("UnpackLocal:: DeletedFiles:: ", deleted_files_size_);
+  DM_LOG_DEBUG("UnpackLocal:: DeletedFiles:: ", deleted_files_size_);
   for (size_t i = 0; i < deleted_files_size_; i++) {
     int level = 0;
     node->receive(&level, sizeof(int));
     uint64_t file_number = 0;
     node->receive(&file_number, sizeof(uint64_t));
-    LOG_CERR("UnpackLocal:: DeletedFiles:: ", level, ' ', file_number);
+    DM_LOG_DEBUG("UnpackLocal:: DeletedFiles:: ", level, ' ', file_number);
     ret_version_edit_->deleted_files_.insert(
         std::make_pair(level, file_number));
   }
-  LOG_CERR("UnpackLocal:: DeletedFiles::End ", deleted_files_size_);
+  DM_LOG_DEBUG("UnpackLocal:: DeletedFiles::End ", deleted_files_size_);
 
   new (&ret_version_edit_->new_files_)
       std::vector<std::pair<int, FileMetaData>>();
@@ -480,33 +482,33 @@ void* VersionEdit::UnPackLocal(TransferService* node,
 }
 
 void VersionEdit::DoubleCheck(TransferService* node) const {
-  LOG_CERR("CheckDouble:: VersionEdit::max_level_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::max_level_");
   node->send(&max_level_, sizeof(int));
-  LOG_CERR("CheckDouble:: VersionEdit::log_number_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::log_number_");
   node->send(&log_number_, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: VersionEdit::prev_log_number_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::prev_log_number_");
   node->send(&prev_log_number_, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: VersionEdit::next_file_number_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::next_file_number_");
   node->send(&next_file_number_, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: VersionEdit::max_column_family_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::max_column_family_");
   node->send(&max_column_family_, sizeof(int));
-  LOG_CERR("CheckDouble:: VersionEdit::min_log_number_to_keep_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::min_log_number_to_keep_");
   node->send(&min_log_number_to_keep_, sizeof(uint64_t));
-  LOG_CERR("CheckDouble:: VersionEdit::last_sequence_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::last_sequence_");
   node->send(&last_sequence_, sizeof(SequenceNumber));
-  LOG_CERR("CheckDouble:: VersionEdit::has_log_number_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::has_log_number_");
   node->send(&has_log_number_, sizeof(bool));
-  LOG_CERR("CheckDouble:: VersionEdit::has_prev_log_number_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::has_prev_log_number_");
   node->send(&has_prev_log_number_, sizeof(bool));
-  LOG_CERR("CheckDouble:: VersionEdit::has_next_file_number_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::has_next_file_number_");
   node->send(&has_next_file_number_, sizeof(bool));
-  LOG_CERR("CheckDouble:: VersionEdit::has_max_column_family_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::has_max_column_family_");
   node->send(&has_max_column_family_, sizeof(bool));
-  LOG_CERR("CheckDouble:: VersionEdit::has_min_log_number_to_keep_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::has_min_log_number_to_keep_");
   node->send(&has_min_log_number_to_keep_, sizeof(bool));
-  LOG_CERR("CheckDouble:: VersionEdit::has_last_sequence_");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::has_last_sequence_");
   node->send(&has_last_sequence_, sizeof(bool));
-  LOG_CERR("CheckDouble:: VersionEdit::CompactCursors");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::CompactCursors");
   size_t compact_cursors_size_ = compact_cursors_.size();
   node->send(&compact_cursors_size_, sizeof(size_t));
   for (auto pr : compact_cursors_) {
@@ -523,7 +525,7 @@ void VersionEdit::DoubleCheck(TransferService* node) const {
     node->send(&(it->first), sizeof(int));
     node->send(&(it->second), sizeof(uint64_t));
   }
-  LOG_CERR("CheckDouble:: VersionEdit::NewFiles");
+  DM_LOG_DEBUG("CheckDouble:: VersionEdit::NewFiles");
   size_t new_files_size_ = new_files_.size();
   node->send(&new_files_size_, sizeof(size_t));
   // for (auto pr : new_files_) {
@@ -510,6 +510,14 @@ class VersionEdit {
   using NewFiles = std::vector<std::pair<int, FileMetaData>>;
   const NewFiles& GetNewFiles() const { return new_files_; }
 
+  // Gives every file added so far the same epoch number. The files must not
+  // overlap, L0 files of one epoch form a single sorted run.
+  void SetNewFilesEpochNumber(uint64_t epoch_number) {
+    for (auto& new_file : new_files_) {
+      new_file.second.epoch_number = epoch_number;
+    }
+  }
+
   // Retrieve all the compact cursors
   using CompactCursors = std::vector<std::pair<int, InternalKey>>;
   const CompactCursors& GetCompactCursors() const { return compact_cursors_; }
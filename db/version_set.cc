@@ -1547,7 +1547,7 @@ void LevelIterator::InitFileIterator(size_t new_file_index) {
 }  // anonymous namespace
 
 void Version::DoubleCheck(TransferService* node) const {
-  LOG_CERR("Version::DoubleCheck::storage_info_");
+  DM_LOG_DEBUG("Version::DoubleCheck::storage_info_");
   storage_info_.DoubleCheck(node);
 }
 
@@ -3327,6 +3327,16 @@ uint32_t GetExpiredTtlFilesCount(const ImmutableOptions& ioptions,
   }
   return ttl_expired_files_count;
 }
+
+// With level compaction, L0 files sharing an epoch number are the
+// range-disjoint outputs of one sharded flush and count as one sorted run.
+// Files sorted by epoch number keep them next to each other.
+bool StartsL0SortedRun(CompactionStyle compaction_style,
+                       const FileMetaData* prev, const FileMetaData* f) {
+  return compaction_style != kCompactionStyleLevel || prev == nullptr ||
+         f->epoch_number == kUnknownEpochNumber ||
+         f->epoch_number != prev->epoch_number;
+}
 }  // anonymous namespace
 
 void VersionStorageInfo::ComputeCompactionScore(
@@ -3358,11 +3368,15 @@ void VersionStorageInfo::ComputeCompactionScore(
       // overwrites/deletions).
       int num_sorted_runs = 0;
       uint64_t total_size = 0;
+      const FileMetaData* prev = nullptr;
       for (auto* f : files_[level]) {
         total_downcompact_bytes += static_cast<double>(f->fd.GetFileSize());
         if (!f->being_compacted) {
           total_size += f->compensated_file_size;
-          num_sorted_runs++;
+          if (StartsL0SortedRun(compaction_style_, prev, f)) {
+            num_sorted_runs++;
+          }
+          prev = f;
         }
       }
       if (compaction_style_ == kCompactionStyleUniversal) {
@@ -4518,7 +4532,14 @@ void VersionStorageInfo::CalculateBaseBytes(const ImmutableOptions& ioptions,
                                             const MutableCFOptions& options) {
   // Special logic to set number of sorted runs.
   // It is to match the previous behavior when all files are in L0.
-  int num_l0_count = static_cast<int>(files_[0].size());
+  int num_l0_count = 0;
+  const FileMetaData* prev = nullptr;
+  for (auto* f : files_[0]) {
+    if (StartsL0SortedRun(compaction_style_, prev, f)) {
+      num_l0_count++;
+    }
+    prev = f;
+  }
   if (compaction_style_ == kCompactionStyleUniversal) {
     // For universal compaction, we use level0 score to indicate
     // compaction score for the whole DB. Adding other levels as if
@@ -4830,21 +4851,21 @@ void VersionSet::PackLocal(TransferService* node) const {
 }
 
 void VersionSet::DoubleCheck(TransferService* node) const {
-  LOG_CERR("VersionSet::DoubleCheck::next_file_number_");
+  DM_LOG_DEBUG("VersionSet::DoubleCheck::next_file_number_");
   node->send(&next_file_number_, sizeof(uint64_t));
-  LOG_CERR("VersionSet::DoubleCheck::manifest_file_number_");
+  DM_LOG_DEBUG("VersionSet::DoubleCheck::manifest_file_number_");
   node->send(&manifest_file_number_, sizeof(uint64_t));
-  LOG_CERR("VersionSet::DoubleCheck::options_file_number_");
+  DM_LOG_DEBUG("VersionSet::DoubleCheck::options_file_number_");
   node->send(&options_file_number_, sizeof(uint64_t));
-  LOG_CERR("VersionSet::DoubleCheck::last_sequence_");
+  DM_LOG_DEBUG("VersionSet::DoubleCheck::last_sequence_");
   node->send(&last_sequence_, sizeof(uint64_t));
-  LOG_CERR("VersionSet::DoubleCheck::descriptor_last_sequence_");
+  DM_LOG_DEBUG("VersionSet::DoubleCheck::descriptor_last_sequence_");
   node->send(&descriptor_last_sequence_, sizeof(SequenceNumber));
-  LOG_CERR("VersionSet::DoubleCheck::last_allocated_sequence_");
+  DM_LOG_DEBUG("VersionSet::DoubleCheck::last_allocated_sequence_");
   node->send(&last_allocated_sequence_, sizeof(uint64_t));
-  LOG_CERR("VersionSet::DoubleCheck::last_published_sequence_");
+  DM_LOG_DEBUG("VersionSet::DoubleCheck::last_published_sequence_");
   node->send(&last_published_sequence_, sizeof(uint64_t));
-  LOG_CERR("VersionSet::DoubleCheck::current_version_number_");
+  DM_LOG_DEBUG("VersionSet::DoubleCheck::current_version_number_");
   node->send(&current_version_number_, sizeof(uint64_t));
   // LOG_CERR("VersionSet::DoubleCheck::manifest_writers_");
   // size_t size = manifest_writers_.size();
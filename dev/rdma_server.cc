@@ -24,8 +24,10 @@ int main(int argc, char** argv) {
   }
   uint64_t mem_size = argc >= 2 ? std::atoll(argv[1]) : (1ull << 35);  // 32G
   rocksdb::RDMAServer server;
-  server.resources_create(mem_size);
-  fprintf(stderr, "create mempool: %lu\n", mem_size);
+  // ROCKSDB_DM_TRANSPORT=shm runs memnode, workers and db_bench on one host
+  if (server.resources_create(mem_size)) return -1;
+  fprintf(stderr, "create mempool: %lu over %s\n", mem_size,
+          server.transport()->Name());
   // if(argc >= 3) server.config.tcp_port = std::atoi(argv[2]);
   server.connect_clients(10086);
   server.sock_connect();
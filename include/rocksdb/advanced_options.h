@@ -17,6 +17,7 @@
 
 namespace ROCKSDB_NAMESPACE {
 
+class MemTableShardPartitioner;
 class Slice;
 class SliceTransform;
 class TablePropertiesCollectorFactory;
@@ -1111,6 +1112,28 @@ struct AdvancedColumnFamilyOptions {
   // Supported values: 0, 1, 2, 4, 8.
   uint32_t memtable_protection_bytes_per_key = 0;
   bool server_use_remote_flush = false;
+
+  // Number of kv shards a memtable is split into. Every shard is shipped to
+  // the memnode as its own arena and written to its own L0 file by the remote
+  // flush. Each shard reserves write_buffer_size bytes on the memnode.
+  //
+  // Default: 4, sanitized to [1, kMaxMemTableShards]
+  int memtable_shard_num = 4;
+
+  // Picks the shard of every key, see rocksdb/memtable_shard_partitioner.h.
+  //
+  // Default: nullptr, which uses NewFixedPrefixShardPartitioner()
+  std::shared_ptr<MemTableShardPartitioner> memtable_shard_partitioner =
+      nullptr;
+
+  // Ship the kv shards of the mutable memtable to the memnode while it is
+  // still being written, one fully written region at a time, instead of all
+  // at once after it has been sealed. Sealing then only ships the unfinished
+  // tail of every shard and the skiplist nodes. Ignored when
+  // inplace_update_support is set, since entries are rewritten in place.
+  //
+  // Default: false
+  bool memtable_stream_to_remote = false;
   // Create ColumnFamilyOptions with default values for all fields
   AdvancedColumnFamilyOptions();
   // Create ColumnFamilyOptions from Options
@@ -0,0 +1,136 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+
+#pragma once
+
+#include <sched.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "rocksdb/blockingconcurrentqueue.h"
+#include "rocksdb/rocksdb_namespace.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Pool of interchangeable resources, the delegated read connections of a
+// memnode or the request slots of a read client, that a thread takes for
+// one request and puts back right after.
+//
+// An item put back is parked in a slot of the core the thread runs on, the
+// next request from that core takes it again without touching shared
+// state. Only when the slot is taken the item goes to a shared queue, which
+// is also where a thread waits, blocked rather than spinning, once neither
+// its own slot nor those of the other cores have an item. kEmpty marks a
+// free slot and is never put.
+//
+// The method names follow moodycamel::BlockingConcurrentQueue.
+template <typename T, T kEmpty = T{}>
+class CorePinnedQueue {
+ public:
+  CorePinnedQueue() {
+    size_t cpus = std::thread::hardware_concurrency();
+    while (num_slots_ < cpus) {
+      num_slots_ <<= 1;
+    }
+    slots_.reset(new Slot[num_slots_]);
+  }
+  CorePinnedQueue(const CorePinnedQueue&) = delete;
+  void operator=(const CorePinnedQueue&) = delete;
+
+  void enqueue(T item) {
+    assert(item != kEmpty);
+    Slot& slot = slots_[CoreIndex()];
+    T empty = kEmpty;
+    if (slot.item.compare_exchange_strong(empty, item)) {
+      if (waiting_.load() == 0) {
+        return;
+      }
+      // a waiter may have looked at this slot before the item got there,
+      // hand whatever is parked in it to the waiters instead
+      item = slot.item.exchange(kEmpty);
+      if (item == kEmpty) {
+        return;
+      }
+    }
+    shared_.enqueue(item);
+  }
+
+  bool try_dequeue(T& item) {
+    T got = slots_[CoreIndex()].item.exchange(kEmpty);
+    if (got == kEmpty && !shared_.try_dequeue(got)) {
+      return false;
+    }
+    item = got;
+    return true;
+  }
+
+  void wait_dequeue(T& item) {
+    if (try_dequeue(item)) {
+      return;
+    }
+    waiting_.fetch_add(1);
+    if (!Steal(item)) {
+      shared_.wait_dequeue(item);
+    }
+    waiting_.fetch_sub(1);
+  }
+
+  template <typename Rep, typename Period>
+  bool wait_dequeue_timed(T& item,
+                          const std::chrono::duration<Rep, Period>& timeout) {
+    if (try_dequeue(item)) {
+      return true;
+    }
+    waiting_.fetch_add(1);
+    bool got = Steal(item) || shared_.wait_dequeue_timed(item, timeout);
+    waiting_.fetch_sub(1);
+    return got;
+  }
+
+ private:
+  struct alignas(64) Slot {
+    std::atomic<T> item{kEmpty};
+  };
+
+  size_t CoreIndex() const {
+    int cpu = sched_getcpu();
+    size_t idx = cpu >= 0 ? static_cast<size_t>(cpu)
+                          : std::hash<std::thread::id>()(
+                                std::this_thread::get_id());
+    return idx & (num_slots_ - 1);
+  }
+
+  // takes an item parked on any core, the caller has already announced
+  // itself in waiting_ so no item is parked after this unseen
+  bool Steal(T& item) {
+    size_t start = CoreIndex();
+    for (size_t i = 0; i < num_slots_; i++) {
+      Slot& slot = slots_[(start + i) & (num_slots_ - 1)];
+      if (slot.item.load() == kEmpty) {
+        continue;
+      }
+      T got = slot.item.exchange(kEmpty);
+      if (got != kEmpty) {
+        item = got;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t num_slots_ = 8;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<size_t> waiting_{0};
+  moodycamel::BlockingConcurrentQueue<T> shared_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,87 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "rocksdb/rocksdb_namespace.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// parameters of a transport, RDMANode::config_t is an alias of this struct
+struct dm_transport_config {
+  std::string dev_name;  // IB device name
+  int ib_port;           // local IB port to work with
+  int gid_idx;           // gid index to use
+  int max_cqe, max_send_wr, max_recv_wr;
+};
+
+enum class dm_opcode : uint8_t {
+  kSend = 0,   // two-sided, consumes one receive posted by the peer
+  kRead = 1,   // one-sided, peer buffer -> local buffer
+  kWrite = 2,  // one-sided, local buffer -> peer buffer
+  kRecv = 3,   // completion of a posted receive
+};
+
+// transport neutral work completion, status 0 means success
+struct dm_completion {
+  uint64_t wr_id;
+  int32_t status;
+  uint32_t vendor_err;
+  uint32_t byte_len;
+  dm_opcode opcode;
+};
+
+// data path of one connection (QP/CQ pair, shared memory mailbox, ...)
+struct dm_endpoint {
+  virtual ~dm_endpoint() = default;
+};
+
+// Moves bytes between the registered buffer of this node and the registered
+// buffer of the peer behind an endpoint. Offsets are always relative to the
+// start of the registered buffers. The tcp socket of the connection stays
+// owned by RDMANode, a transport only borrows it to exchange its metadata.
+class DMTransport {
+ public:
+  virtual ~DMTransport() = default;
+  virtual const char *Name() const = 0;
+
+  // allocate and register `size` bytes, nullptr on failure
+  virtual char *RegisterMemory(size_t size) = 0;
+  virtual int DeregisterMemory() = 0;
+
+  // both sides call Connect() on their end of a connected tcp socket
+  virtual dm_endpoint *Connect(int sock) = 0;
+  virtual int Disconnect(dm_endpoint *ep) = 0;
+
+  // kSend ignores remote_offset, every posted request completes signaled.
+  // A kSend consumes a receive the peer posted, the protocol posts it before
+  // the peer can send. When there is none the send completes with an error
+  // status, the transports differ in how long they wait first: verbs queue
+  // pairs run with rnr_retry 0 and fail on the first RNR NAK, shm waits up
+  // to 2 seconds for the peer to post one.
+  virtual int PostSend(dm_endpoint *ep, dm_opcode opcode, size_t msg_size,
+                       long long local_offset, long long remote_offset,
+                       uint64_t wr_id) = 0;
+  virtual int PostRecv(dm_endpoint *ep, size_t msg_size, long long local_offset,
+                       uint64_t wr_id) = 0;
+  // non-blocking, same contract as ibv_poll_cq with one entry:
+  // 1 if *wc is filled, 0 if nothing completed yet, < 0 on error
+  virtual int PollCompletion(dm_endpoint *ep, dm_completion *wc) = 0;
+};
+
+// ibverbs RC queue pairs, needs an HCA
+DMTransport *NewVerbsTransport(const dm_transport_config *config);
+// memfd backed loopback for processes on the same host, no HCA required
+DMTransport *NewShmTransport(const dm_transport_config *config);
+// ROCKSDB_DM_TRANSPORT if set, "verbs" otherwise
+std::string DefaultDMTransportName();
+// name is "verbs" or "shm", empty name uses DefaultDMTransportName()
+DMTransport *NewDMTransport(const dm_transport_config *config,
+                            const std::string &name = "");
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -1,16 +1,20 @@
 #pragma once
 #include <unistd.h>
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "macro.hpp"
 
@@ -26,6 +30,34 @@
 #define LOG_PRINT_HEADER(stream, line, filename, function)
 #endif
 
+// Sites below this level are compiled out, their arguments are still type
+// checked but never evaluated. 0 debug, 1 info, 2 warn, 3 error.
+#ifndef ROCKSDB_DM_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define ROCKSDB_DM_LOG_MIN_LEVEL 1
+#else
+#define ROCKSDB_DM_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+#define DM_LOG_AT(level, ...)                                            \
+  do {                                                                   \
+    if ((level) >= static_cast<::LocalLogger::Level>(                    \
+                       ROCKSDB_DM_LOG_MIN_LEVEL) &&                      \
+        ::LocalLogger::AsyncLogger::Enabled(level)) {                    \
+      ::LocalLogger::AsyncLogger::Instance().Log(level, __FILE__,        \
+                                                 __LINE__, __VA_ARGS__); \
+    }                                                                    \
+  } while (0)
+
+// per-operation paths: transfers, arena blocks, service dispatch
+#define DM_LOG_DEBUG(...) DM_LOG_AT(::LocalLogger::Level::kDebug, __VA_ARGS__)
+// lifecycle of memtables, flush jobs and connections
+#define DM_LOG_INFO(...) DM_LOG_AT(::LocalLogger::Level::kInfo, __VA_ARGS__)
+#define DM_LOG_WARN(...) DM_LOG_AT(::LocalLogger::Level::kWarn, __VA_ARGS__)
+// written before the call returns, usually right before an assert
+#define DM_LOG_ERROR(...) DM_LOG_AT(::LocalLogger::Level::kError, __VA_ARGS__)
+
 namespace LocalLogger {
 
 template <typename OUT, typename T>
@@ -49,9 +81,6 @@ class LocalLogger {
   template <typename... Args>
   void output(const std::thread::id &thread_id, const char *filename,
               const int &line, const char *function_name, Args &&...args);
-  template <typename... Args>
-  void output2cerr(const std::thread::id &thread_id, const char *filename,
-                   const int &line, const char *function_name, Args &&...args);
 };
 
 template <typename... Args>
@@ -83,23 +112,170 @@ void LocalLogger::output(const std::thread::id &thread_id, const char *filename,
   }
 }
 
-template <typename... Args>
-void LocalLogger::output2cerr(const std::thread::id &thread_id,
-                              const char *filename, const int &line,
-                              const char *function_name, Args &&...args) {
-  std::stringstream id_stream;
-  id_stream << thread_id;
-  int64_t id;
-  id_stream >> id;
-  std::stringstream stream;
-  LOG_INFO(stream, std::forward<Args>(args)...);
-  char buffer[10001]{0};
-  stream.read(buffer, stream.str().size());
-  {
-    std::lock_guard<std::mutex> lock(mtx);
-    std::cerr << id << ":::" << buffer;
-    std::cerr.flush();
+enum class Level : uint8_t { kDebug = 0, kInfo = 1, kWarn = 2, kError = 3 };
+
+// One log call. The arguments are encoded as tagged values and formatted
+// by the drain thread, what does not fit in the payload is cut off.
+struct LogRecord {
+  static constexpr size_t kSize = 512;
+  enum Tag : char { kInt, kUint, kDouble, kChar, kBool, kPtr, kStr };
+
+  uint64_t time;
+  const char *file;
+  uint32_t line;
+  Level level;
+  bool truncated;
+  uint16_t len;
+  char payload[kSize - 24];
+};
+static_assert(sizeof(LogRecord) == LogRecord::kSize, "LogRecord layout");
+
+class LogRecordWriter {
+ public:
+  explicit LogRecordWriter(LogRecord *rec)
+      : rec_(rec),
+        p_(rec->payload),
+        end_(rec->payload + sizeof(rec->payload)) {}
+  ~LogRecordWriter() { rec_->len = static_cast<uint16_t>(p_ - rec_->payload); }
+
+  template <typename T>
+  void Put(const T &arg) {
+    using D = std::decay_t<T>;
+    if constexpr (std::is_same_v<D, bool>) {
+      PutFixed(LogRecord::kBool, static_cast<char>(arg));
+    } else if constexpr (std::is_same_v<D, char> ||
+                         std::is_same_v<D, signed char> ||
+                         std::is_same_v<D, unsigned char>) {
+      PutFixed(LogRecord::kChar, static_cast<char>(arg));
+    } else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>) {
+      PutFixed(LogRecord::kInt, static_cast<int64_t>(arg));
+    } else if constexpr (std::is_integral_v<D>) {
+      PutFixed(LogRecord::kUint, static_cast<uint64_t>(arg));
+    } else if constexpr (std::is_enum_v<D>) {
+      PutFixed(LogRecord::kInt, static_cast<int64_t>(arg));
+    } else if constexpr (std::is_floating_point_v<D>) {
+      PutFixed(LogRecord::kDouble, static_cast<double>(arg));
+    } else if constexpr (std::is_same_v<D, const char *> ||
+                         std::is_same_v<D, char *>) {
+      const char *s = arg;
+      if (s == nullptr) s = "(null)";
+      PutStr(s, strlen(s));
+    } else if constexpr (std::is_same_v<D, std::string>) {
+      PutStr(arg.data(), arg.size());
+    } else if constexpr (std::is_pointer_v<D>) {
+      PutFixed(LogRecord::kPtr, reinterpret_cast<uintptr_t>(arg));
+    } else {
+      // anything else only knows operator<<, format it here
+      std::ostringstream os;
+      os << arg;
+      const std::string s = os.str();
+      PutStr(s.data(), s.size());
+    }
   }
-}
 
-}  // namespace LocalLogger
\ No newline at end of file
+ private:
+  template <typename V>
+  void PutFixed(LogRecord::Tag tag, V v) {
+    if (end_ - p_ < static_cast<ptrdiff_t>(1 + sizeof(V))) {
+      rec_->truncated = true;
+      return;
+    }
+    *p_++ = tag;
+    memcpy(p_, &v, sizeof(V));
+    p_ += sizeof(V);
+  }
+  void PutStr(const char *s, size_t n) {
+    const size_t head = 1 + sizeof(uint16_t);
+    if (end_ - p_ <= static_cast<ptrdiff_t>(head)) {
+      rec_->truncated = true;
+      return;
+    }
+    if (n > static_cast<size_t>(end_ - p_) - head) {
+      n = static_cast<size_t>(end_ - p_) - head;
+      rec_->truncated = true;
+    }
+    uint16_t len = static_cast<uint16_t>(n);
+    *p_++ = LogRecord::kStr;
+    memcpy(p_, &len, sizeof(len));
+    p_ += sizeof(len);
+    memcpy(p_, s, n);
+    p_ += n;
+  }
+
+  LogRecord *rec_;
+  char *p_;
+  char *end_;
+};
+
+// Logger of the DM paths. Every thread appends its records to its own
+// ring, a background thread drains the rings, formats the records and
+// writes them to stderr in batches. A full ring drops records rather than
+// stall the caller and the drops are reported with the next batch. Lines
+// of different threads are ordered by their timestamps, not in the output.
+//
+// Runtime level from ROCKSDB_DM_LOG_LEVEL (debug, info, warn, error),
+// info if unset.
+class AsyncLogger {
+ public:
+  static AsyncLogger &Instance();
+  static bool Enabled(Level level) {
+    return static_cast<int>(level) >=
+           Instance().level_.load(std::memory_order_relaxed);
+  }
+
+  void SetLevel(Level level) {
+    level_.store(static_cast<int>(level), std::memory_order_relaxed);
+  }
+  // returns once every record logged before the call has been written
+  void Flush();
+
+  template <typename... Args>
+  void Log(Level level, const char *file, int line, const Args &...args) {
+    if (level == Level::kError) {
+      LogRecord rec;
+      Fill(&rec, level, file, line, args...);
+      WriteNow(rec);
+      return;
+    }
+    LogRecord *rec = Reserve();
+    if (rec == nullptr) return;
+    Fill(rec, level, file, line, args...);
+    Commit();
+  }
+
+  AsyncLogger(const AsyncLogger &) = delete;
+  void operator=(const AsyncLogger &) = delete;
+
+ private:
+  struct Ring;
+
+  AsyncLogger();
+
+  template <typename... Args>
+  static void Fill(LogRecord *rec, Level level, const char *file, int line,
+                   const Args &...args) {
+    rec->time = static_cast<uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+    rec->file = file;
+    rec->line = static_cast<uint32_t>(line);
+    rec->level = level;
+    rec->truncated = false;
+    LogRecordWriter w(rec);
+    (w.Put(args), ...);
+  }
+  // slot for the next record of this thread, nullptr if its ring is full
+  LogRecord *Reserve();
+  void Commit();
+  void WriteNow(const LogRecord &rec);
+  void DrainLoop();
+  // formats the records of every ring into out, returns how many
+  size_t Drain(std::string *out);
+
+  std::atomic<int> level_{static_cast<int>(Level::kInfo)};
+  std::mutex rings_mu_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+  std::mutex drain_mu_;
+  std::thread drainer_;
+};
+
+}  // namespace LocalLogger
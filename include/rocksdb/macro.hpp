@@ -40,9 +40,6 @@ class SingletonV2 : public Noncopyable::Noncopyable {
       std::this_thread::get_id(), __FILE__, __LINE__, __FUNCTION__,  \
       __VA_ARGS__);
 */
-#define LOG_CERR(...)                                                         \
-                                                                              \
-  SingletonV2::SingletonV2<LocalLogger::LocalLogger>::Instance().output2cerr( \
-                                                                              \
-      std::this_thread::get_id(), __FILE__, __LINE__, __FUNCTION__,           \
-      __VA_ARGS__);
\ No newline at end of file
+// info level on the async DM logger of rocksdb/logger.hpp, the DM paths
+// pick a level with DM_LOG_DEBUG/INFO/WARN/ERROR instead
+#define LOG_CERR(...) DM_LOG_INFO(__VA_ARGS__);
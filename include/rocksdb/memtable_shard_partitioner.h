@@ -0,0 +1,70 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rocksdb/rocksdb_namespace.h"
+#include "rocksdb/slice.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Upper bound of ColumnFamilyOptions::memtable_shard_num. The shard of a
+// skiplist node is stored in one byte, kMaxMemTableShards marks the head.
+constexpr int kMaxMemTableShards = 16;
+
+// Picks the kv shard of every key written to a memtable. Each shard lives in
+// its own arena, is shipped to the memnode on its own and becomes one L0 file
+// of the shard-level remote flush, so an even split is what gives the flush
+// its parallelism.
+//
+// A partitioner is shared by every memtable of a column family and must be
+// thread safe. It is never consulted after a memtable is sealed, the shard of
+// each entry travels with the entry.
+class MemTableShardPartitioner {
+ public:
+  virtual ~MemTableShardPartitioner() = default;
+
+  virtual const char* Name() const = 0;
+
+  // Shard of user_key, in [0, num_shards).
+  virtual int Shard(const Slice& user_key, int num_shards) const = 0;
+
+  // True if every key of shard i sorts before every key of shard i + 1 under
+  // the bytewise comparator. Shard iterators of an ordered layout seek
+  // straight to their first entry, otherwise they filter a full scan.
+  virtual bool IsOrdered() const = 0;
+
+  // Called with user keys sampled in order from a memtable that was just
+  // sealed. Returns the partitioner for the next memtable, nullptr keeps
+  // using this one.
+  virtual std::shared_ptr<MemTableShardPartitioner> Learn(
+      const std::vector<std::string>& /*sorted_sample*/,
+      int /*num_shards*/) const {
+    return nullptr;
+  }
+};
+
+// Equal ranges of the first key byte, ordered. With 4 shards this is the
+// `uint8_t(key[0]) >> 6` split used before the shard count was configurable.
+std::shared_ptr<MemTableShardPartitioner> NewFixedPrefixShardPartitioner();
+
+// Hash of the first prefix_len bytes of the key, not ordered. Spreads hashed
+// and ASCII keys evenly at the cost of a filtered scan per flushed shard.
+std::shared_ptr<MemTableShardPartitioner> NewPrefixHashShardPartitioner(
+    size_t prefix_len = 8);
+
+// Split points at the quantiles of keys sampled from the previous memtable,
+// ordered. Falls back to fixed prefix ranges until the first memtable is
+// sealed.
+std::shared_ptr<MemTableShardPartitioner> NewSampledShardPartitioner();
+
+}  // namespace ROCKSDB_NAMESPACE
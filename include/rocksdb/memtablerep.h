@@ -44,6 +44,7 @@
 #include <memory>
 #include <stdexcept>
 #include <unordered_set>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "rocksdb/customizable.h"
@@ -66,6 +67,29 @@ using KeyHandle = void*;
 
 extern Slice GetLengthPrefixedSlice(const char* data);
 extern int VarintLength(uint64_t v);
+
+// Where the copy of an offloaded skiplist lives in the memnode buffer, for
+// a compute node walking it with one-sided reads. Links and key pointers
+// in the copy still hold addresses of the compute node arenas. The link of
+// level i sits i links below a node, the key pointer and the shard byte
+// follow the level 0 link.
+struct RemoteSkipListLayout {
+  static constexpr size_t kLinkSize = sizeof(void*);
+  static constexpr size_t kKeyOffset = kLinkSize;
+  static constexpr size_t kShardOffset = kKeyOffset + sizeof(char*);
+  static constexpr size_t kNodeSize = kShardOffset + sizeof(uint8_t);
+
+  uintptr_t meta_local{0};
+  uint64_t meta_remote{0};
+  uint64_t meta_size{0};
+  int shard_num{0};
+  uintptr_t kv_local[kMaxMemTableShards]{};
+  uint64_t kv_remote[kMaxMemTableShards]{};
+  uint64_t kv_size[kMaxMemTableShards]{};
+  uintptr_t head{0};
+  int max_height{0};
+};
+
 class MemTableRep {
  public:
   virtual bool IsRemote() const { assert(false); }
@@ -97,6 +121,18 @@ class MemTableRep {
   virtual std::pair<void*, size_t> get_shard_local_begin(int) { assert(false); }
   virtual void set_max_height(int height) { assert(false); }
   virtual void get_max_height(int& height) const { assert(false); }
+  virtual void set_shard_layout(int shard_num, bool ordered) { assert(false); }
+  virtual void get_shard_layout(int& shard_num, bool& ordered) const {
+    assert(false);
+  }
+  // about n user keys spread over the whole table, in key order; used to
+  // learn shard split points, representations that cannot sample add none
+  virtual void SampleUserKeys(size_t /*n*/,
+                              std::vector<std::string>* /*keys*/) const {}
+  // false unless the table is a skiplist already shipped to a memnode
+  virtual bool GetRemoteLayout(RemoteSkipListLayout* /*layout*/) const {
+    return false;
+  }
   virtual std::pair<const char*, size_t> local_begin() const {
     LOG("MemTableRep::get_remote_begin: error: not implemented");
     assert(false);
@@ -178,9 +214,10 @@ class MemTableRep {
   // better. By allowing it to allocate memory, it can possibly put
   // correlated stuff in consecutive memory area to make processor
   // prefetching more efficient.
+  // shard: kv shard of the key for representations that split keys from
+  // nodes, see SepConcurrentArena::Shard()
   virtual KeyHandle Allocate(const size_t len, char** buf,
-                             char** kv_buf = nullptr,
-                             const char* prefix = nullptr);
+                             char** kv_buf = nullptr, int shard = -1);
 
   // Insert key into the collection. (The caller will pack key and value into a
   // single buffer and pass that in as the parameter to Insert).
@@ -259,8 +296,11 @@ class MemTableRep {
   // does nothing.  After MarkReadOnly() is called, this table rep will
   // not be written to (ie No more calls to Allocate(), Insert(),
   // or any writes done directly to entries accessed through the iterator.)
-  virtual void MarkReadOnly() { LOG_CERR("MemTableRep MarkReadOnly"); }
+  virtual void MarkReadOnly() { DM_LOG_DEBUG("MemTableRep MarkReadOnly"); }
   virtual void MarkTransAsFinished() { assert(false); }
+  // The memnode already holds the shipped copy of this empty rep, taken
+  // back after a restart of the compute node.
+  virtual void MarkReattached() { assert(false); }
 
   // Notify this table rep that it has been flushed to stable storage.
   // By default, does nothing.
@@ -286,6 +326,12 @@ class MemTableRep {
                     void* ret_data);
   virtual void RGet_v2(const InternalKeyComparator* cmp, void* req_data,
                        void* ret_data);
+  // Answers req_data from entry alone, the newest version of the key in
+  // this rep as found by an index. Returns false, leaving ret_data alone,
+  // if entry is not where RGet_v2() would stop: another key, a version
+  // newer than the snapshot or a merge operand.
+  virtual bool RGetEntry_v2(const InternalKeyComparator* cmp, void* req_data,
+                            void* ret_data, const char* entry);
   virtual void Get(const LookupKey& k, void* callback_args,
                    bool (*callback_func)(void* arg, const char* entry));
 
@@ -464,10 +510,33 @@ class SkipListFactory : public MemTableRepFactory {
 
   bool CanHandleDuplicatedKey() const override { return true; }
 
- private:
+ protected:
   size_t lookahead_;
 };
 
+// A skip list whose links and key references are 32-bit offsets into the
+// arenas of the memtable instead of addresses. An offloaded copy is read
+// in place on the memnode or a flush worker without relocating anything,
+// and nodes take about half the link bytes. One-sided reads of the compute
+// node do not follow offset links, such memtables are read by delegation.
+// Falls back to SkipListFactory for arenas other than SepConcurrentArena
+// and blocks of 4 GiB or more.
+class OffsetSkipListFactory : public SkipListFactory {
+ public:
+  explicit OffsetSkipListFactory(size_t lookahead = 0)
+      : SkipListFactory(lookahead) {}
+
+  static const char* kClassName() { return "OffsetSkipListFactory"; }
+  static const char* kNickName() { return "offset_skip_list"; }
+  const char* Name() const override { return kClassName(); }
+  const char* NickName() const override { return kNickName(); }
+
+  using MemTableRepFactory::CreateMemTableRep;
+  MemTableRep* CreateMemTableRep(const MemTableRep::KeyComparator&, Allocator*,
+                                 const SliceTransform*,
+                                 Logger* logger) override;
+};
+
 // This creates MemTableReps that are backed by an std::vector. On iteration,
 // the vector is sorted. This is useful for workloads where iteration is very
 // rare and writes are generally not issued after reads begin.
@@ -52,7 +52,11 @@ inline void* MemTableRepPackFactory::UnPackLocal(
         reinterpret_cast<const void*>(rep->local_begin().first)));
     local_skiplistrep->set_remote_begin(rep->remote_begin().first);
     local_skiplistrep->set_head_offset(head_offset_);
-    for (int i = 0; i < 4 /*sep*/; i++) {
+    int shard_num = 0;
+    bool shards_ordered = true;
+    rep->get_shard_layout(shard_num, shards_ordered);
+    local_skiplistrep->set_shard_layout(shard_num, shards_ordered);
+    for (int i = 0; i < shard_num; i++) {
       local_skiplistrep->set_shard_local_begin(
           i, rep->get_shard_local_begin(i).first);
       local_skiplistrep->set_shard_remote_begin(
@@ -80,7 +84,7 @@ inline void* MemTableRepPackFactory::UnPackLocal(
     assert(false);
 #endif  // ROCKSDB_ALL_TESTS_ENABLED
   } else {
-    LOG_CERR("MemTableRepPackFactory::UnPackLocal error", type, ' ', info);
+    DM_LOG_ERROR("MemTableRepPackFactory::UnPackLocal error", type, ' ', info);
     assert(false);
   }
   return nullptr;
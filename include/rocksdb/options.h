@@ -1402,6 +1402,33 @@ struct DBOptions {
   size_t worker_use_remote_flush = 0;
   size_t server_remote_flush = 0;
 
+  // On open, take back the immutable memtables the memnodes still hold for
+  // this DB instead of replaying their entries from the WAL. Only the WAL
+  // entries newer than the last memtable taken back are replayed. Needs
+  // avoid_flush_during_recovery and is ignored with allow_2pc or read-only
+  // opens, and for column families without server_use_remote_flush, whose
+  // WALs are replayed as usual.
+  //
+  // Default: false
+  bool memnode_warm_restart = false;
+
+  // If set, a Get that has to ask the memnodes about the offloaded
+  // immutable memtables keeps the answer here: the value or deletion found
+  // with its sequence number, or that none of them holds the key. As those
+  // memtables never change, an answer stays valid until a newer memtable
+  // is offloaded, which keys new entries. Gets that meet merge operands,
+  // range tombstones or user timestamps bypass the cache.
+  //
+  // Default: nullptr (disabled)
+  std::shared_ptr<Cache> delegated_read_cache = nullptr;
+
+  // Memnodes ("ip:port") the column families offload their immutable
+  // memtables to, placed across all of them. Malformed entries are skipped.
+  //
+  // Default: empty, the memnode the transport reaches at port 9091, on
+  // 127.0.0.1 for shm and on 10.10.1.1 otherwise
+  std::vector<std::string> memnodes;
+
   std::string rdma_tcp_addr_ = "127.0.0.1";
   int rdma_tcp_port_ = 9000;
 };
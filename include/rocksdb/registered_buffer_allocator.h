@@ -0,0 +1,155 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rocksdb/rocksdb_namespace.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Allocator of the offsets [0, capacity) of a registered buffer.
+//
+// Blocks below kChunkSize are powers of two of at least kMinBlockSize bytes
+// handed out by a buddy allocator, allocate and free touch a bounded number
+// of size classes and never scan the allocated blocks. Blocks up to
+// kMaxCachedBlockSize freed by a thread go to a per-core cache first and are
+// handed out again without the buddy lock. The buddy lists are refilled one
+// aligned chunk at a time from a best-fit list of free extents, which also
+// serves larger blocks rounded to kMinBlockSize, so that a memtable block of
+// write_buffer_size bytes does not take the next power of two.
+//
+// Allocate() returns -1 when no block fits instead of waiting, callers that
+// can wait for other users to free memory pass a timeout.
+class RegisteredBufferAllocator {
+ public:
+  static constexpr int kMinOrder = 6;  // 64 bytes
+  static constexpr uint64_t kMinBlockSize = uint64_t{1} << kMinOrder;
+  static constexpr int kMaxCachedOrder = 16;  // 64 KiB
+  static constexpr uint64_t kMaxCachedBlockSize = uint64_t{1}
+                                                  << kMaxCachedOrder;
+  static constexpr int kChunkOrder = 20;  // 1 MiB
+  static constexpr uint64_t kChunkSize = uint64_t{1} << kChunkOrder;
+
+  struct Stats {
+    uint64_t capacity = 0;
+    // bytes of the blocks handed out, including the round up of their size,
+    // and the bytes actually requested for them
+    uint64_t allocated = 0;
+    uint64_t requested = 0;
+    // freed blocks kept by the per-core caches
+    uint64_t cached = 0;
+    uint64_t free = 0;
+    uint64_t largest_free = 0;
+    uint64_t blocks = 0;
+    uint64_t failed = 0;
+
+    // share of the free bytes that cannot serve a request of largest_free
+    // bytes, 0 when all free memory is one block
+    double fragmentation() const {
+      return free == 0 ? 0.0
+                       : 1.0 - static_cast<double>(largest_free) /
+                                   static_cast<double>(free);
+    }
+    std::string ToString() const;
+  };
+
+  RegisteredBufferAllocator();
+  ~RegisteredBufferAllocator();
+  RegisteredBufferAllocator(const RegisteredBufferAllocator &) = delete;
+  void operator=(const RegisteredBufferAllocator &) = delete;
+
+  // Hands out [0, capacity). Only the first call has an effect.
+  void Init(uint64_t capacity);
+  bool initialized() const { return capacity_ > 0; }
+
+  // offset of a block of at least size bytes, -1 if none is free
+  int64_t Allocate(uint64_t size);
+  // as above, waiting up to wait for blocks to be freed
+  int64_t Allocate(uint64_t size, std::chrono::milliseconds wait);
+  // false if offset is not the start of an allocated block
+  bool Free(uint64_t offset);
+  // bytes of the block allocated at offset, 0 if there is none
+  uint64_t BlockSize(uint64_t offset) const;
+
+  Stats GetStats() const;
+
+ private:
+  static constexpr size_t kStripes = 16;
+  static constexpr size_t kCachedBlocksPerOrder = 32;
+
+  struct Stripe {
+    mutable std::mutex mu;
+    // start of every allocated block -> requested bytes
+    std::unordered_map<uint64_t, uint64_t> blocks;
+  };
+  struct CoreCache {
+    std::mutex mu;
+    std::vector<uint64_t> blocks[kMaxCachedOrder - kMinOrder + 1];
+  };
+
+  // buddy order of a block of size bytes, kChunkOrder and above are extents
+  static int OrderOf(uint64_t size);
+  // bytes taken by a block of size requested bytes
+  static uint64_t LengthOf(uint64_t size);
+  Stripe &StripeOf(uint64_t offset) const;
+  CoreCache &LocalCache() const;
+
+  // REQUIRES: mu_ held
+  int64_t TakeBlock(uint64_t size);
+  int64_t TakeFree(int order);
+  void PutFree(uint64_t offset, int order);
+  void RemoveFree(uint64_t offset, int order);
+  void ReleaseToBuddy(uint64_t offset, int order);
+  // first extent that holds length bytes starting at a multiple of align
+  int64_t TakeExtent(uint64_t length, uint64_t align);
+  void PutExtent(uint64_t offset, uint64_t length);
+
+  // moves every cached block back so that they can be merged
+  void DrainCaches();
+  void Record(uint64_t offset, uint64_t size);
+
+  // set last by Init(), nothing is handed out before
+  std::atomic<uint64_t> capacity_{0};
+  std::once_flag init_once_;
+
+  mutable std::mutex mu_;
+  std::condition_variable freed_cv_;
+  // blocks freed so far, guarded by mu_, and threads in a timed Allocate()
+  uint64_t frees_ = 0;
+  std::atomic<uint64_t> waiters_{0};
+  // free buddy blocks per order, order and list position of each of them
+  std::vector<uint64_t> free_[kChunkOrder];
+  std::unordered_map<uint64_t, std::pair<int, size_t>> free_pos_;
+  uint64_t free_bytes_ = 0;
+  // free extents by offset and by {length, offset}
+  std::map<uint64_t, uint64_t> extents_;
+  std::set<std::pair<uint64_t, uint64_t>> extents_by_length_;
+  uint64_t extent_bytes_ = 0;
+
+  std::unique_ptr<Stripe[]> stripes_;
+  size_t num_caches_ = 1;
+  std::unique_ptr<CoreCache[]> caches_;
+
+  std::atomic<uint64_t> allocated_bytes_{0};
+  std::atomic<uint64_t> requested_bytes_{0};
+  std::atomic<uint64_t> cached_bytes_{0};
+  std::atomic<uint64_t> num_blocks_{0};
+  std::atomic<uint64_t> failed_{0};
+};
+
+}  // namespace ROCKSDB_NAMESPACE
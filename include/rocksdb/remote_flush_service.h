@@ -9,7 +9,6 @@
 #pragma once
 
 #include <arpa/inet.h>
-#include <infiniband/verbs.h>
 #include <linux/types.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
@@ -17,6 +16,7 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -36,6 +36,11 @@
 
 #include "rocksdb/blockingconcurrentqueue.h"
 #include "rocksdb/concurrentqueue.h"
+#include "rocksdb/core_pinned_queue.h"
+#include "rocksdb/dm_transport.h"
+#include "rocksdb/logger.hpp"
+#include "rocksdb/memtable_shard_partitioner.h"
+#include "rocksdb/registered_buffer_allocator.h"
 #include "rocksdb/status.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -51,23 +56,74 @@ namespace ROCKSDB_NAMESPACE {
     (buf) += (len);                    \
   }
 
-struct imm_read_req_v2 {
-  // derived from imm_read_req
-  int32_t status_code;
-  char key[25];  // lookup key
-  size_t memtable_key_len;
-  bool found_final_value;
-  uint64_t max_covering_tombstone_seq;
-  bool allow_data_in_errors;
-  size_t protection_bytes_per_key;
-  int32_t timestamp_size_;  // usercomparator timestamp size
-  char timestamp[25];
-  uint64_t seq;
-  // global info
-  size_t mixed_ids_size;
-  uint64_t mixed_ids[25];
+// bloom filter of an offloaded memtable, its bits are already part of the
+// shipped meta arena
+enum memtable_bloom_mode : uint8_t {
+  kMemTableBloomNone = 0,
+  kMemTableBloomWholeKey = 1,
+  kMemTableBloomPrefix = 2,
+};
+struct memtable_bloom_info {
+  uint64_t offset;  // of the filter bits from the start of the meta arena
+  uint32_t len;     // 64-bit words
+  uint8_t num_double_probes;
+  uint8_t mode;    // memtable_bloom_mode
+  uint16_t ts_sz;  // stripped from user keys before they are hashed
+};
+static_assert(sizeof(memtable_bloom_info) == 16, "wire layout");
+
+enum memtable_recovery_flags : uint32_t {
+  // the memtable holds range tombstones, which stay on the compute node
+  kMemTableRecoveryRangeDeletes = 1,
+};
+// what a restarted compute node needs to take an offloaded memtable back
+// instead of replaying its entries from the WAL
+struct memtable_recovery_info {
+  uint64_t db_tag;  // of the DB the memtable belongs to, 0 if unknown
+  // entries are in WALs from creation_log_number (0 for the first memtable
+  // of a DB instance) up to but excluding next_log_number
+  uint64_t creation_log_number;
+  uint64_t next_log_number;
+  uint64_t first_seqno;
+  uint64_t earliest_seqno;
+  uint64_t sealed_seqno;  // last sequence number when it became immutable
+  uint64_t num_entries;
+  uint64_t num_deletes;
+  uint64_t data_size;
+  uint32_t flags;  // memtable_recovery_flags
+  uint32_t reserved;
+};
+static_assert(sizeof(memtable_recovery_info) == 80, "wire layout");
+// an offloaded memtable listed by the memnode
+struct memtable_recovery_entry {
+  uint64_t mixed_id;
+  memtable_recovery_info info;
 };
 
+// Skiplist index block of an offloaded memtable, sized for the largest shard
+// count: id, head offset, max height, shard count (at MEMTABLE_INDEX_SHARDS),
+// comparator, a byte of memtable_index_flags, up to two slice transform
+// words, lookahead, skiplist, meta arena and one kv arena pointer per shard,
+// then the memtable_bloom_info at MEMTABLE_INDEX_BLOOM and the
+// memtable_recovery_info at MEMTABLE_INDEX_RECOVERY.
+#define MEMTABLE_INDEX_BLOOM (66 + 8 * kMaxMemTableShards)
+#define MEMTABLE_INDEX_RECOVERY \
+  (MEMTABLE_INDEX_BLOOM + sizeof(memtable_bloom_info))
+#define MEMTABLE_INDEX_SIZE \
+  (MEMTABLE_INDEX_RECOVERY + sizeof(memtable_recovery_info))
+#define MEMTABLE_INDEX_SHARDS 20
+enum memtable_index_flags : uint8_t {
+  kMemTableIndexShardsOrdered = 1,
+  // links are OffsetSkipList offsets, not compute node addresses
+  kMemTableIndexOffsetLinks = 2,
+};
+// uint64 words locating an offloaded memtable on the memnode: index offset
+// and size, meta arena offset and size, then offset and size of each shard.
+#define RMEM_INFO_WORDS (4 + 2 * kMaxMemTableShards)
+// buffer a memnode keeps per column family for the flush package, see
+// PackageWriteService
+#define REMOTE_FLUSH_PACKAGE_SIZE 98304
+
 struct imm_read_req {
   int32_t status_code;
   char key[25];  // lookup key
@@ -91,6 +147,224 @@ struct imm_read_ret {
   uint64_t seq;
 };
 
+// Delegated read protocol v2. Every record is length prefixed by its fixed
+// header and padded to 8 bytes, so keys, timestamps and mixed_ids are only
+// bounded by the size of the slot areas.
+//
+// slot: [request area][reply area][fetch area (compute side only)]
+// request area: imm_read_batch, then num_keys records of
+//   imm_read_req_v2 | memtable key | timestamp | mixed_ids
+// reply area: imm_read_load, then num_keys records of
+//   imm_read_ret_v2 | inline value or num_frags imm_read_frag | timestamp |
+//   num_operands imm_read_operand
+// Values larger than kInlineValueLimit are not copied into the reply, the
+// memnode returns where they live in its registered buffer and the client
+// fetches them with one-sided reads through the fetch area.
+//
+// The epoch guard of the memnode only covers its own walk, a fragment is
+// read after the reply. It stays valid because the memnode frees a memtable
+// only when the compute node asks, and ~MemTable() queues that request, so
+// no fragment goes away while its memtable is referenced. Everything that
+// reads memnode memory one-sided (fragments of Gets and scans, skiplist
+// walks) keeps the memtables it reads referenced until it is done, as
+// Get, MultiGet and iterators do through their SuperVersion. The delay of
+// the gc thread is not relied on.
+#define MAX_DELEGATED_READ_BATCH 32
+
+inline size_t dm_align8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+
+struct imm_read_req_v2 {
+  int32_t status_code;
+  int32_t timestamp_size_;  // -1 means no timestamp is requested
+  uint32_t memtable_key_len;
+  uint32_t mixed_ids_size;
+  uint64_t max_covering_tombstone_seq;
+  uint64_t seq;
+  uint32_t protection_bytes_per_key;
+  bool found_final_value;
+  bool allow_data_in_errors;
+
+  char *key() { return reinterpret_cast<char *>(this + 1); }
+  char *timestamp() { return key() + memtable_key_len; }
+  uint64_t *mixed_ids() {
+    return reinterpret_cast<uint64_t *>(
+        reinterpret_cast<char *>(this) +
+        dm_align8(sizeof(imm_read_req_v2) + memtable_key_len +
+                  (timestamp_size_ > 0 ? timestamp_size_ : 0)));
+  }
+  static size_t record_size(size_t key_len, size_t ts_len, size_t ids) {
+    return dm_align8(sizeof(imm_read_req_v2) + key_len + ts_len) +
+           ids * sizeof(uint64_t);
+  }
+  size_t record_size() const {
+    return record_size(memtable_key_len,
+                       timestamp_size_ > 0 ? timestamp_size_ : 0,
+                       mixed_ids_size);
+  }
+};
+
+// a range of the memnode registered buffer
+struct imm_read_frag {
+  uint64_t offset;
+  uint64_t len;
+};
+
+// merge operand the memnode met before the lookup ended, followed by its
+// bytes, or by one imm_read_frag if it is remote, and padded to 8 bytes.
+// The compute node applies the merge operator.
+struct imm_read_operand {
+  uint64_t seq;
+  uint32_t size;
+  uint32_t remote;
+
+  char *data() { return reinterpret_cast<char *>(this + 1); }
+  imm_read_frag *frag() { return reinterpret_cast<imm_read_frag *>(this + 1); }
+  static size_t record_size(size_t size, bool remote) {
+    return dm_align8(sizeof(imm_read_operand) +
+                     (remote ? sizeof(imm_read_frag) : size));
+  }
+  size_t record_size() const { return record_size(size, remote != 0); }
+};
+
+struct imm_read_ret_v2 {
+  int32_t status_code;
+  int32_t timestamp_size;
+  uint64_t value_size;
+  uint64_t seq;
+  uint64_t base_seq;  // of the value or deletion the lookup ended at
+  uint32_t num_frags;  // 0 if the value is inline
+  uint32_t num_operands;   // newest first, all newer than base_seq
+  uint32_t operands_size;  // bytes of the imm_read_operand records
+  bool found_final_value;
+
+  char *value() { return reinterpret_cast<char *>(this + 1); }
+  imm_read_frag *frags() { return reinterpret_cast<imm_read_frag *>(this + 1); }
+  size_t payload_size() const {
+    return num_frags ? num_frags * sizeof(imm_read_frag) : value_size;
+  }
+  char *timestamp() { return value() + payload_size(); }
+  imm_read_operand *operands() {
+    return reinterpret_cast<imm_read_operand *>(
+        reinterpret_cast<char *>(this) +
+        dm_align8(sizeof(imm_read_ret_v2) + payload_size() +
+                  (timestamp_size > 0 ? timestamp_size : 0)));
+  }
+  size_t record_size() const {
+    return dm_align8(sizeof(imm_read_ret_v2) + payload_size() +
+                     (timestamp_size > 0 ? timestamp_size : 0)) +
+           operands_size;
+  }
+};
+
+// a merge operand in a memtable arena of the memnode
+struct imm_read_operand_ref {
+  uint64_t seq;
+  const char *data;
+  size_t size;
+};
+
+// memnode side outcome of one lookup, value points into the memtable arena
+// which is part of the memnode registered buffer
+struct imm_read_result {
+  int32_t status_code;
+  bool found_final_value;
+  uint64_t seq;
+  uint64_t base_seq;
+  // merge operands met on the way, newest first, across the memtables
+  std::vector<imm_read_operand_ref> operands;
+  const char *value;
+  size_t value_size;
+  int32_t timestamp_size;
+  std::string timestamp;
+};
+
+// registered buffer of a memnode, answer to a capacity request
+struct memnode_capacity {
+  uint64_t capacity;
+  uint64_t free;
+  uint64_t largest_free;  // largest block that can still be pinned
+};
+
+// load of the memnode read pool when it built a reply, leads the reply
+// area of every delegated get and scan
+struct imm_read_load {
+  uint32_t queued;   // requests waiting for a worker
+  uint32_t busy;     // workers running a request, this one included
+  uint32_t workers;
+  uint32_t reserved;
+};
+
+// what the request area of a slot holds
+enum imm_read_op : uint32_t {
+  kDelegatedGet = 0,   // num_keys imm_read_req_v2 records
+  kDelegatedScan = 1,  // one imm_scan_req record
+};
+
+struct imm_read_batch {
+  uint32_t num_keys;
+  uint32_t req_len;  // bytes used in the request area, header included
+  uint32_t op;       // imm_read_op
+  uint32_t reserved;
+
+  static constexpr size_t kReqAreaSize = 16 << 10;
+  static constexpr size_t kRetAreaSize = 16 << 10;
+  static constexpr size_t kFetchAreaSize = 64 << 10;
+  static constexpr size_t kInlineValueLimit = 256;
+
+  imm_read_req_v2 *first_req() {
+    return reinterpret_cast<imm_read_req_v2 *>(
+        reinterpret_cast<char *>(this) + dm_align8(sizeof(imm_read_batch)));
+  }
+  char *req_end() { return reinterpret_cast<char *>(this) + kReqAreaSize; }
+  imm_read_load *load() { return reinterpret_cast<imm_read_load *>(req_end()); }
+  imm_read_ret_v2 *first_ret() {
+    return reinterpret_cast<imm_read_ret_v2 *>(
+        req_end() + dm_align8(sizeof(imm_read_load)));
+  }
+  char *ret_end() { return req_end() + kRetAreaSize; }
+  char *fetch_area() { return ret_end(); }
+  static size_t server_slot_size() { return kReqAreaSize + kRetAreaSize; }
+  static size_t slot_size() { return server_slot_size() + kFetchAreaSize; }
+};
+
+// Delegated scan over one offloaded memtable. The memnode positions an
+// iterator of the rebuilt MemTableRep according to mode and returns up to
+// max_entries consecutive entries, in descending order for the backward
+// modes. Every entry in the reply is
+//   varint32 key len | internal key | varint32 value len | remote flag |
+//   value, or one imm_read_frag if the flag is set
+// A value goes remote only if it is the first entry and does not fit the
+// reply area on its own.
+enum imm_scan_mode : uint32_t {
+  kScanFirst = 0,
+  kScanLast = 1,
+  kScanSeek = 2,         // first entry >= key
+  kScanSeekForPrev = 3,  // last entry <= key
+  kScanAfter = 4,        // first entry > key
+  kScanBefore = 5,       // last entry < key
+};
+
+struct imm_scan_req {
+  uint64_t mem_id;
+  uint32_t mode;  // imm_scan_mode
+  uint32_t max_entries;
+  uint32_t key_len;  // internal key, unused by kScanFirst and kScanLast
+
+  char *key() { return reinterpret_cast<char *>(this + 1); }
+  static size_t record_size(size_t key_len) {
+    return dm_align8(sizeof(imm_scan_req) + key_len);
+  }
+};
+
+struct imm_scan_ret {
+  int32_t status_code;
+  uint32_t num_entries;
+  uint64_t len;    // bytes of entries following the header
+  bool exhausted;  // the memnode iterator ran off the memtable
+
+  char *entries() { return reinterpret_cast<char *>(this + 1); }
+};
+
 // a mempool, using malloc/free to allocate/free memorys
 class RegularMemNode {
   std::vector<std::pair<void *, size_t>> mempool_;
@@ -122,54 +396,47 @@ class RegularMemNode {
   }
 };
 // a mempool, using registered buffer
+// allocator of the registered buffer of an RDMAClient
 class RDMAMemNode {
-  std::set<std::pair<uint64_t, uint64_t>> mempool_;
-  std::mutex mtx_;
-  uint64_t buf_size_;
+  RegisteredBufferAllocator alloc_;
 
  public:
+  // how long allocate() waits for other users to free memory
+  static constexpr std::chrono::milliseconds kAllocateWait{5000};
+  // allocate() calls of allocate_wait() before it gives up
+  static constexpr int kAllocateWaitRounds = 12;
+
   RDMAMemNode() = default;
-  ~RDMAMemNode() { mempool_.clear(); }
-  void init(uint64_t buf_size) { buf_size_ = buf_size; }
+  void init(uint64_t buf_size) { alloc_.Init(buf_size); }
+  // offset of size bytes of the registered buffer, -1 once kAllocateWait
+  // passed without enough memory being freed
   int64_t allocate(uint64_t size) {
-    while (true) {
-      std::lock_guard<std::mutex> lock(mtx_);
-      bool flag = false;
-      uint64_t offset = 0;
-      if (mempool_.empty()) {
-        if (size <= buf_size_)
-          offset = 0, flag = true;
-        else {
-          fprintf(stderr, "Memory node does not have enough capacity\n");
-          return -1;
-        }
-      } else {
-        if (size <= mempool_.begin()->first)
-          offset = 0, flag = true;
-        else
-          for (auto i = mempool_.begin(); i != mempool_.end(); i++) {
-            auto j = i;
-            j++;
-            if (i->first + i->second + size <=
-                (j != mempool_.end() ? j->first : buf_size_)) {
-              offset = i->first + i->second, flag = true;
-              break;
-            }
-          }
-      }
-      if (flag) {
-        mempool_.insert(std::make_pair(offset, size));
-        return offset;
+    int64_t offset = alloc_.Allocate(size, kAllocateWait);
+    if (offset == -1) {
+      DM_LOG_WARN("registered buffer exhausted, ", size,
+                  " bytes requested: ", alloc_.GetStats().ToString());
+    }
+    return offset;
+  }
+  // offset of size bytes of the registered buffer, -1 right away if none is
+  // free
+  int64_t try_allocate(uint64_t size) { return alloc_.Allocate(size); }
+  // for callers that can only give up the whole job, waits up to
+  // kAllocateWaitRounds * kAllocateWait for memory to be freed
+  Status allocate_wait(uint64_t size, int64_t *offset) {
+    for (int i = 0; i < kAllocateWaitRounds; i++) {
+      if ((*offset = allocate(size)) != -1) {
+        return Status::OK();
       }
     }
+    return Status::MemoryLimit("registered buffer exhausted");
   }
   void free(uint64_t offset) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    auto it = mempool_.lower_bound(std::make_pair(offset, 0));
-    assert(it != mempool_.end());
-    assert(it->first == offset);
-    mempool_.erase(it);
+    bool found = alloc_.Free(offset);
+    assert(found);
+    (void)found;
   }
+  RegisteredBufferAllocator::Stats stats() const { return alloc_.GetStats(); }
 };
 
 // tcp node, use in flush_job_server & worker & memnode.
@@ -223,54 +490,32 @@ class RDMANode {
 
  public:
   // structure of test parameters
-  struct config_t {
-    std::string dev_name;  // IB device name
-    int ib_port;           // local IB port to work with
-    int gid_idx;           // gid index to use
-    int max_cqe, max_send_wr, max_recv_wr;
-  };
-  // structure to exchange data which is needed to connect the QPs
-  struct cm_con_data_t {
-    uint64_t addr;    // Buffer address
-    uint32_t rkey;    // Remote key
-    uint32_t qp_num;  // QP number
-    uint16_t lid;     // LID of the IB port
-    uint8_t gid[16];  // gid
-  } __attribute__((packed));
+  using config_t = dm_transport_config;
   struct rdma_connection {
-    struct ibv_cq *cq;  // CQ handle
-    struct ibv_qp *qp;  // QP handle
-    int sock;           // TCP socket file descriptor
-    sockaddr_in addr;   // tcp connection address for name resolution
+    dm_endpoint *ep;   // transport endpoint (QP/CQ pair, shm mailbox)
+    int sock;          // TCP socket file descriptor
+    sockaddr_in addr;  // tcp connection address for name resolution
   };
   // structure of system resources
   struct resources {
-    struct ibv_device_attr device_attr;  // Device attributes
-    struct ibv_port_attr port_attr;      // IB port attributes
-    struct cm_con_data_t remote_props;   // values to connect to remote side
-    struct ibv_context *ib_ctx;          // device handle
-    struct ibv_pd *pd;                   // PD handle
     std::vector<struct rdma_connection *> conns;
-    struct ibv_mr *mr;  // MR handle for buf
-    char *buf;          // memory buffer pointer, used for RDMA and send ops
+    char *buf;  // memory buffer pointer, used for RDMA and send ops
   };
 
  private:
   struct rdma_connection *connect_qp(int sock);
-  int sock_sync_data(int sock, int xfer_size, const char *local_data,
-                     char *remote_data);
   int post_send(struct rdma_connection *idx, size_t msg_size,
-                ibv_wr_opcode opcode, long long local_offset,
+                dm_opcode opcode, long long local_offset,
                 long long remote_offset, uint64_t wr_id = 0);
   int post_receive(struct rdma_connection *idx, size_t msg_size,
                    long long local_offset, uint64_t wr_id = 0);
-  int modify_qp_to_init(struct ibv_qp *qp);
-  int modify_qp_to_rtr(struct ibv_qp *qp, uint32_t remote_qpn, uint16_t dlid,
-                       uint8_t *dgid);
-  int modify_qp_to_rts(struct ibv_qp *qp);
   int resources_destroy();
+  // release the data path and the socket of a connection which is already
+  // removed from res->conns
+  void destroy_connection(struct rdma_connection *idx);
   virtual void after_connect_qp(struct rdma_connection *idx) = 0;
   std::unique_ptr<std::mutex> conns_mtx;
+  std::unique_ptr<DMTransport> transport_;
 
  public:
   RDMANode();
@@ -280,7 +525,7 @@ class RDMANode {
                                        u_int32_t tcp_port = 9091);
   int send(struct rdma_connection *idx, size_t msg_size, long long local_offset,
            uint64_t wr_id = 0) {
-    return post_send(idx, msg_size, IBV_WR_SEND, local_offset, 0, wr_id);
+    return post_send(idx, msg_size, dm_opcode::kSend, local_offset, 0, wr_id);
   }
   int receive(struct rdma_connection *idx, size_t msg_size,
               long long local_offset, uint64_t wr_id = 0) {
@@ -288,27 +533,39 @@ class RDMANode {
   }
   int rdma_read(struct rdma_connection *idx, size_t msg_size,
                 long long local_offset, long long remote_offset) {
-    return post_send(idx, msg_size, IBV_WR_RDMA_READ, local_offset,
+    return post_send(idx, msg_size, dm_opcode::kRead, local_offset,
                      remote_offset);
   }
   int rdma_write(struct rdma_connection *idx, size_t msg_size,
                  long long local_offset, long long remote_offset) {
-    return post_send(idx, msg_size, IBV_WR_RDMA_WRITE, local_offset,
+    return post_send(idx, msg_size, dm_opcode::kWrite, local_offset,
                      remote_offset);
   }
   int poll_completion(struct rdma_connection *idx);
   char *get_buf() { return res->buf; }
+  DMTransport *transport() { return transport_.get(); }
   struct resources *res;
   size_t buf_size;
-  struct config_t config;
+  config_t config;
 };
+// How a Get reads the memtables offloaded to a memnode. kAdaptive delegates
+// while the memnode keeps up and walks the skiplists with one-sided reads
+// while its read pool is saturated.
+enum class MemnodeReadMode { kDelegate, kOneSided, kAdaptive };
+
+// from env ROCKSDB_DM_READ_MODE: delegate, one_sided or adaptive (default)
+MemnodeReadMode DefaultMemnodeReadMode();
+const char *MemnodeReadModeName(MemnodeReadMode mode);
+
 class RDMAReadClient : public RDMANode {
   // note: one read client should only use one rdma_connection, data structure
   // below is actually for rdma_connection
  public:
-  std::vector<ibv_wc *> rr_wc_buf;
+  std::vector<dm_completion *> rr_wc_buf;
   std::atomic_int32_t pending_rr_num{0};
-  moodycamel::BlockingConcurrentQueue<size_t> available_read_reqs_;  // 16
+  // request slots, offsets of get_buf()
+  CorePinnedQueue<size_t, std::numeric_limits<size_t>::max()>
+      available_read_reqs_;
 
  private:
   void after_connect_qp(struct rdma_connection *idx) override {}
@@ -319,13 +576,54 @@ class RDMAReadClient : public RDMANode {
   ~RDMAReadClient() override;
   int rr_block_poll_completion(struct rdma_connection *conn,
                                uint64_t wr_id = 0);
-  bool register_client_in_get_service_request(struct rdma_connection *conn,
-                                              bool v2 = false);
-  bool client_send_request_for_memtable_read_v2(
-      struct rdma_connection *conn,
-      imm_read_req_v2 *req_packet /* to be updated*/, std::string *value,
-      std::string *timestamp);
+  // takes the request slot of conn from the registered buffer before the
+  // memnode is asked to serve it
+  Status register_client_in_get_service_request(struct rdma_connection *conn,
+                                                bool v2 = false);
+  // send batch->num_keys requests at once, the responses are left in the
+  // reply area of the same slot
+  bool client_send_batch_request_for_memtable_read(struct rdma_connection *conn,
+                                                   imm_read_batch *batch);
+  // the two halves of client_send_batch_request_for_memtable_read(), one
+  // request per connection may be outstanding between them. The memnode
+  // serves up to max_send_wr requests of a connection at once, but a reply
+  // lands in the receive posted first rather than in the return area of
+  // its slot, and completions are told apart by wr_id parity only, so a
+  // second request would take the reply of the first.
+  void client_post_batch_request(struct rdma_connection *conn,
+                                 imm_read_batch *batch);
+  bool client_wait_batch_request(struct rdma_connection *conn,
+                                 imm_read_batch *batch);
+  // one-sided reads of the memnode ranges in frags into *value
+  bool client_fetch_scattered_value(struct rdma_connection *conn,
+                                    imm_read_batch *batch,
+                                    const imm_read_frag *frags,
+                                    uint32_t num_frags, uint64_t value_size,
+                                    std::string *value);
+  // one-sided read of len bytes at offset of the memnode buffer into dst,
+  // staged through the fetch area of batch
+  bool client_read_remote(struct rdma_connection *conn, imm_read_batch *batch,
+                          uint64_t offset, size_t len, char *dst);
+
+  // a reply without load sample older than this makes the next Get
+  // delegate again to learn whether the memnode recovered
+  static constexpr int64_t kLoadProbeIntervalUs = 2000;
+  MemnodeReadMode read_mode_ = DefaultMemnodeReadMode();
+  void note_memnode_load(const imm_read_load &load);
+  // true if the next Get should walk the skiplists itself
+  bool prefer_one_sided() const;
+
+  // delegated scans holding a slot and a connection for read-ahead, kept
+  // below the number of connections so point reads never starve
+  static constexpr int32_t kMaxPrefetchingScans = 8;
+  std::atomic_int32_t prefetching_scans_{0};
   bool disconnect_request(struct rdma_connection *conn);
+
+ private:
+  // last load reported by the memnode and when it arrived
+  std::atomic<uint32_t> memnode_queued_{0};
+  std::atomic<uint32_t> memnode_workers_{1};
+  std::atomic<int64_t> load_time_us_{0};
 };
 
 struct PlacementDriver {
@@ -335,20 +633,24 @@ struct PlacementDriver {
   std::vector<TCPNode *> workers_;
   std::vector<TCPNode *> generators_;
   std::unordered_map<TCPNode *, placement_info> peers_;
+  // guards available_workers_, popped by the flush job threads
+  std::mutex mu_;
+  TCPNode *pop_available_worker() {
+    std::lock_guard<std::mutex> lck(mu_);
+    if (available_workers_.empty()) return nullptr;
+    TCPNode *worker = available_workers_.front();
+    available_workers_.pop();
+    return worker;
+  }
   TCPNode *choose_worker(const placement_info &);
   struct RDMANode::rdma_connection *choose_worker_rdma(const placement_info &);
   void step(bool, size_t, placement_info);
   void poll_events(int port);
 };
 class RemoteMemTablePool;
+class DelegatedReadPool;
+class RemoteFlushScheduler;
 class RDMAServer : public RDMANode {
-  struct executor_info {
-    int status;
-    moodycamel::BlockingConcurrentQueue<std::pair<int64_t, int64_t>>
-        flush_job_queue;
-    std::pair<int64_t, int64_t> current_job;
-  };
-
  public:
   RDMAServer();
   ~RDMAServer() override;
@@ -359,66 +661,65 @@ class RDMAServer : public RDMANode {
   }
 
  private:
-  int rr_block_poll_completion(struct rdma_connection *conn,
-                               std::vector<ibv_wc *> *rr_wc_buf,
-                               uint64_t wr_id = 0,
-                               bool *should_close = nullptr);
   void create_rmem_service(struct rdma_connection *idx);
   void receive_rmem_service(struct rdma_connection *idx);
   void receive_remote_flush_service(struct rdma_connection *idx,
                                     int64_t &meta_offset, int64_t &meta_size);
   void allocate_mem_service(struct rdma_connection *idx, int64_t &ret_offset,
                             int64_t &size);
+  // answers an allocate request with the pinned bytes at offset
+  void hand_out_mem_service(struct rdma_connection *idx, int64_t offset,
+                            int64_t pinned);
   void free_mem_service(struct rdma_connection *conn);
+  void capacity_service(struct rdma_connection *conn);
+  void list_memtables_service(struct rdma_connection *conn);
   void disconnect_service(struct rdma_connection *idx);
   void register_executor_service(struct rdma_connection *idx);
   void wait_for_job_service(struct rdma_connection *idx);
   void register_memtable_read_service(struct rdma_connection *idx,
                                       std::thread *t, bool *should_close);
   void fetch_memtable_service(struct rdma_connection *conn);
+  // pins the max_send_wr delegated read slots of a connection into slots,
+  // none if the memnode has no room for all of them
+  bool pin_read_slots(std::vector<size_t> *slots, size_t slot_size);
   void register_client_in_get_service_service(
-      struct rdma_connection *conn, std::vector<size_t> *delegated_read_buffer_,
-      std::vector<std::thread> *delegated_read_threads_,
-      moodycamel::BlockingConcurrentQueue<uint64_t> *wr_info_,
-      std::vector<ibv_wc *> *rr_wc_buf, bool *should_close);
+      struct rdma_connection *conn,
+      std::vector<size_t> *delegated_read_buffer_);
   void register_client_in_get_service_service_v2(
-      struct rdma_connection *conn, std::vector<size_t> *delegated_read_buffer_,
-      std::vector<std::thread> *delegated_read_threads_,
-      moodycamel::BlockingConcurrentQueue<uint64_t> *wr_info_,
-      std::vector<ibv_wc *> *rr_wc_buf, bool *should_close);
+      struct rdma_connection *conn,
+      std::vector<size_t> *delegated_read_buffer_);
+  // answer the request held by batch, returns the length of the reply left
+  // in its reply area
+  size_t delegated_read_service(imm_read_batch *batch);
+  // run the delegated scan held by batch, the reply is left in ret
+  void scan_service(imm_read_batch *batch, imm_scan_ret *ret);
+  // write the reply record of one key at cursor without passing end,
+  // returns the cursor of the next record
+  char *encode_delegated_read_ret(const imm_read_result &res, char *cursor,
+                                  char *end);
   RemoteMemTablePool *remote_memtable_pool_;
-  std::unique_ptr<std::mutex> mempool_mtx;
-  std::set<std::pair<int64_t /*offset*/, int64_t /*len*/>> pinned_mem;
-  inline int64_t pin_mem(int64_t size) {
-    std::lock_guard<std::mutex> lck(*mempool_mtx);
-    int64_t last_end = 0;
-    for (auto iter : pinned_mem) {
-      int64_t front_len = iter.first - last_end;
-      if (front_len >= size) {
-        pinned_mem.insert(std::make_pair(last_end, size));
-        return last_end;
-      } else {
-        last_end = iter.first + iter.second;
-      }
-    }
-    if (buf_size - last_end >= size) {
-      pinned_mem.insert(std::make_pair(last_end, size));
-      return last_end;
-    }
-    return -1;
+  // threads serving the delegated reads of every connection
+  std::unique_ptr<DelegatedReadPool> read_pool_;
+  // memory of the registered buffer handed to clients
+  std::unique_ptr<RegisteredBufferAllocator> pinned_mem_;
+  // how long a request waits for memory before the client is told the
+  // memnode is full
+  static constexpr std::chrono::milliseconds kAdmitWait{100};
+  // offset of size pinned bytes, -1 if none were unpinned within wait
+  inline int64_t try_pin_mem(int64_t size, std::chrono::milliseconds wait) {
+    pinned_mem_->Init(buf_size);
+    return pinned_mem_->Allocate(static_cast<uint64_t>(size), wait);
   }
   inline bool unpin_mem(int64_t offset, int64_t size) {
-    std::lock_guard<std::mutex> lck(*mempool_mtx);
-    auto iter = pinned_mem.find(std::make_pair(offset, size));
-    if (iter != pinned_mem.end()) {
-      pinned_mem.erase(iter);
-      return true;
+    if (pinned_mem_->BlockSize(offset) < static_cast<uint64_t>(size)) {
+      return false;
     }
-    return false;
+    return pinned_mem_->Free(static_cast<uint64_t>(offset));
   }
 
   std::vector<std::thread *> threads;
-  std::unordered_map<struct rdma_connection *, executor_info> executors_;
+  // places remote flush jobs on the executors registered with this memnode
+  std::unique_ptr<RemoteFlushScheduler> flush_scheduler_;
   void after_connect_qp(struct rdma_connection *idx) override {
     auto ser = [this, idx] { service(idx); };
     threads.push_back(new std::thread(ser));  // each connection
@@ -433,6 +734,7 @@ class RDMAClient : public RDMANode {
  public:
   RDMAClient();
   ~RDMAClient() override = default;
+  // {-1, -1} when the memnode has no room for size bytes
   std::pair<int64_t, int64_t> allocate_mem_request(struct rdma_connection *idx,
                                                    int64_t size);
   // qry_type:
@@ -449,8 +751,21 @@ class RDMAClient : public RDMANode {
   bool disconnect_request(struct rdma_connection *idx);
   void free_mem_request(struct rdma_connection *idx, int64_t offset,
                         int64_t size);  // req_type=2
+  memnode_capacity capacity_request(struct rdma_connection *conn);  // 13
+  // memtables of column family cf_id of the DB tagged db_tag the memnode
+  // still holds
+  std::vector<memtable_recovery_entry> list_memtables_request(
+      struct rdma_connection *conn, uint64_t db_tag,
+      uint32_t cf_id);  // req_type=14
   bool register_executor_request(struct rdma_connection *idx);
-  void fetch_memtable_request(
+  // reads index and meta of a memtable, remote_data gets the memnode offset
+  // and size of each kv shard for the caller to read. Nothing is left
+  // allocated if the registered buffer has no room for index and meta.
+  Status locate_memtable_request(
+      struct rdma_connection *conn, uint64_t mixed_id, void *&index,
+      uint64_t &index_size, void *&meta, uint64_t &meta_size,
+      std::pair<int64_t, uint64_t> *remote_data);  // req_type=10
+  Status fetch_memtable_request(
       struct rdma_connection *conn, uint64_t mixed_id, void *&index,
       uint64_t &index_size, void *&meta, uint64_t &mem_size,
       std::pair<void *, uint64_t> *mem_data);  // req_type=10
@@ -589,8 +904,8 @@ class PDClient {
       char client_ip[INET_ADDRSTRLEN];
       inet_ntop(AF_INET, &client_address.sin_addr, client_ip, INET_ADDRSTRLEN);
       int client_port = ntohs(client_address.sin_port);
-      LOG_CERR("Rocksdb Instance create connection with memnode: ", client_ip,
-               ':', client_port);
+      DM_LOG_INFO("Rocksdb Instance create connection with memnode: ",
+                  client_ip, ':', client_port);
     }
     auto *node = new TCPNode(client_address, sock);
     pd_connection_ = node;
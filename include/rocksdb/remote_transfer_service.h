@@ -1,8 +1,15 @@
 #pragma once
 
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "port/port.h"
 #include "rocksdb/logger.hpp"
 #include "rocksdb/remote_flush_service.h"
 #include "rocksdb/status.h"
+#include "util/coding.h"
 
 namespace ROCKSDB_NAMESPACE {
 
@@ -11,6 +18,9 @@ class TransferService {
   virtual ~TransferService() = default;
   virtual bool send(const void *buf, size_t size) = 0;
   virtual bool receive(void *buf, size_t size) = 0;
+  // the next field of size bytes in place instead of copied, nullptr if the
+  // service only copies; valid as long as the buffer it reads from
+  virtual const char *view(size_t /*size*/) { return nullptr; }
 };
 
 class TCPTransferService : public TransferService {
@@ -88,14 +98,14 @@ class PostTransferService : public TransferService {
   bool send(const void *buf, size_t size) override {
     size_t now = *reinterpret_cast<size_t *>(current_ptr_);
     if (now != size) {
-      LOG_CERR("Length Diff: ", now, ' ', size, " offset:: ", get_size());
+      DM_LOG_ERROR("Length Diff: ", now, ' ', size, " offset:: ", get_size());
       return false;
     } else {
       current_ptr_ += sizeof(size_t);
     }
     if (now == size && size > 0) {
       bool match = std::memcmp(current_ptr_, buf, size) == 0;
-      if (!match) LOG_CERR("Content Diff: size:: ", now, ' ', get_size());
+      if (!match) DM_LOG_ERROR("Content Diff: size:: ", now, ' ', get_size());
     }
     current_ptr_ += now;
     return true;
@@ -109,6 +119,176 @@ class PostTransferService : public TransferService {
   char *current_ptr_;
 };
 
+// Remote flush package. The header carries a magic, the schema version and
+// the body size. A field is encoded by the size both sides pass for it,
+// without a length header:
+//  - up to 8 bytes: the little-endian value as a varint
+//  - up to kSharedMin - 1 bytes: the bytes
+//  - longer: varint 0 and the bytes, or varint i + 1 for the same bytes as
+//    the i-th long field of the package, so option blobs repeated by every
+//    memtable and the job are carried once
+// A change of the field order of any PackLocal() bumps kVersion.
+struct remote_package_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t body_size;
+};
+
+class PackageWriteService : public TransferService {
+ public:
+  static constexpr uint32_t kMagic = 0x52465047;  // "RFPG"
+  static constexpr uint32_t kVersion = 2;
+  static constexpr size_t kSharedMin = 64;
+
+  PackageWriteService(void *buf, size_t size)
+      : begin_(static_cast<char *>(buf)),
+        end_(begin_ + size),
+        current_ptr_(begin_ + sizeof(remote_package_header)) {
+    static_assert(port::kLittleEndian, "fields are encoded little-endian");
+    assert(size >= sizeof(remote_package_header));
+  }
+  bool send(const void *buf, size_t size) override {
+    if (!ok_ || size == 0) return ok_;
+    if (size <= sizeof(uint64_t)) {
+      uint64_t value = 0;
+      memcpy(&value, buf, size);
+      return PutVarint(value);
+    }
+    if (size < kSharedMin) return Put(buf, size);
+    auto it = shared_.find(
+        std::string_view(static_cast<const char *>(buf), size));
+    if (it != shared_.end()) return PutVarint(it->second + 1);
+    if (!Reserve(1 + size)) return false;
+    PutVarint(0);
+    Put(buf, size);
+    // keyed by the copy in the package, the caller's buffer may go away
+    size_t index = shared_.size();
+    shared_.emplace(std::string_view(current_ptr_ - size, size), index);
+    return true;
+  }
+  bool receive(void * /*buf*/, size_t /*size*/) override { return false; }
+  // writes the header, returns the package size or 0 if it overflowed
+  size_t Finish() {
+    if (!ok_) return 0;
+    remote_package_header header{kMagic, kVersion,
+                                 get_size() - sizeof(remote_package_header)};
+    memcpy(begin_, &header, sizeof(header));
+    return get_size();
+  }
+  size_t get_size() const { return current_ptr_ - begin_; }
+
+ private:
+  bool Reserve(size_t size) {
+    if (ok_ && static_cast<size_t>(end_ - current_ptr_) < size) {
+      DM_LOG_ERROR("flush package overflow at ", get_size(), " + ", size);
+      ok_ = false;
+    }
+    return ok_;
+  }
+  bool Put(const void *buf, size_t size) {
+    if (!Reserve(size)) return false;
+    memcpy(current_ptr_, buf, size);
+    current_ptr_ += size;
+    return true;
+  }
+  bool PutVarint(uint64_t value) {
+    if (!Reserve(VarintLength(value))) return false;
+    current_ptr_ = EncodeVarint64(current_ptr_, value);
+    return true;
+  }
+
+  char *begin_;
+  char *end_;
+  char *current_ptr_;
+  bool ok_ = true;
+  std::unordered_map<std::string_view, uint64_t> shared_;
+};
+
+// Decodes a PackageWriteService package in place, long fields are handed
+// out by view() without a copy.
+class PackageReadService : public TransferService {
+ public:
+  PackageReadService(const void *buf, size_t size)
+      : current_ptr_(static_cast<const char *>(buf)),
+        end_(current_ptr_ + size) {
+    remote_package_header header;
+    if (size < sizeof(header)) {
+      Fail("short package");
+      return;
+    }
+    memcpy(&header, current_ptr_, sizeof(header));
+    if (header.magic != PackageWriteService::kMagic ||
+        header.version != PackageWriteService::kVersion) {
+      DM_LOG_ERROR("flush package version ", header.version, " magic ",
+                   header.magic, " not supported");
+      ok_ = false;
+      return;
+    }
+    if (header.body_size > size - sizeof(header)) {
+      Fail("truncated package");
+      return;
+    }
+    current_ptr_ += sizeof(header);
+    end_ = current_ptr_ + header.body_size;
+  }
+  bool Valid() const { return ok_; }
+  bool send(const void * /*buf*/, size_t /*size*/) override { return false; }
+  bool receive(void *buf, size_t size) override {
+    if (!ok_ || size == 0) return ok_;
+    if (size <= sizeof(uint64_t)) {
+      uint64_t value = 0;
+      const char *next = GetVarint64Ptr(current_ptr_, end_, &value);
+      if (next == nullptr) return Fail("bad varint");
+      if (size < sizeof(uint64_t) && (value >> (8 * size)) != 0) {
+        return Fail("field wider than its size");
+      }
+      current_ptr_ = next;
+      memcpy(buf, &value, size);
+      return true;
+    }
+    const char *field = view(size);
+    if (field == nullptr) return false;
+    memcpy(buf, field, size);
+    return true;
+  }
+  const char *view(size_t size) override {
+    if (!ok_ || size <= sizeof(uint64_t)) return nullptr;
+    if (size >= PackageWriteService::kSharedMin) {
+      uint64_t ref = 0;
+      const char *next = GetVarint64Ptr(current_ptr_, end_, &ref);
+      if (next == nullptr || ref > shared_.size() ||
+          (ref > 0 && shared_[ref - 1].second != size)) {
+        Fail("bad shared field");
+        return nullptr;
+      }
+      current_ptr_ = next;
+      if (ref > 0) return shared_[ref - 1].first;
+    }
+    if (static_cast<size_t>(end_ - current_ptr_) < size) {
+      Fail("field past the package");
+      return nullptr;
+    }
+    const char *field = current_ptr_;
+    current_ptr_ += size;
+    if (size >= PackageWriteService::kSharedMin) {
+      shared_.emplace_back(field, size);
+    }
+    return field;
+  }
+
+ private:
+  bool Fail(const char *msg) {
+    if (ok_) DM_LOG_ERROR("flush package: ", msg);
+    ok_ = false;
+    return false;
+  }
+
+  const char *current_ptr_;
+  const char *end_;
+  bool ok_ = true;
+  std::vector<std::pair<const char *, size_t>> shared_;
+};
+
 class RDMATransferService : public TransferService {
  public:
   explicit RDMATransferService(RDMAClient *service_provider)
@@ -623,7 +623,7 @@ class Statistics : public Customizable {
     return;
     size_t remote_record_tick_len = remote_record_tick_.size();
     node->send(&remote_record_tick_len, sizeof(size_t));
-    LOG_CERR("remote_record_tick_len: ", remote_record_tick_len);
+    DM_LOG_DEBUG("remote_record_tick_len: ", remote_record_tick_len);
     if (remote_record_tick_len > 0)
       node->send(
           remote_record_tick_.data(),
@@ -632,8 +632,8 @@ class Statistics : public Customizable {
     size_t remote_report_time_to_histogram_len =
         remote_report_time_to_histogram_.size();
     node->send(&remote_report_time_to_histogram_len, sizeof(size_t));
-    LOG_CERR("remote_report_time_to_histogram_len: ",
-             remote_report_time_to_histogram_len);
+    DM_LOG_DEBUG("remote_report_time_to_histogram_len: ",
+                 remote_report_time_to_histogram_len);
     if (remote_report_time_to_histogram_len > 0)
       node->send(remote_report_time_to_histogram_.data(),
                  remote_report_time_to_histogram_.size() *
@@ -641,7 +641,7 @@ class Statistics : public Customizable {
 
     size_t remote_set_ticker_count_len = remote_set_ticker_count_.size();
     node->send(&remote_set_ticker_count_len, sizeof(size_t));
-    LOG_CERR("remote_set_ticker_count_len: ", remote_set_ticker_count_len);
+    DM_LOG_DEBUG("remote_set_ticker_count_len: ", remote_set_ticker_count_len);
     if (remote_set_ticker_count_len > 0)
       node->send(remote_set_ticker_count_.data(),
                  remote_set_ticker_count_.size() *
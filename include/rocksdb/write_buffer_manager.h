@@ -74,6 +74,12 @@ class WriteBufferManager final {
     return memory_active_.load(std::memory_order_relaxed);
   }
 
+  // Returns the memory memtables offloaded to memnodes pin there. Not part
+  // of memory_usage(), the memnodes enforce their own capacity.
+  size_t remote_memory_usage() const {
+    return remote_memory_used_.load(std::memory_order_relaxed);
+  }
+
   size_t dummy_entries_in_cache_usage() const;
 
   // Returns the buffer_size.
@@ -149,6 +155,14 @@ class WriteBufferManager final {
 
   void FreeMem(size_t mem);
 
+  // Charges and releases the memnode memory of an offloaded memtable.
+  void ReserveRemoteMem(size_t mem) {
+    remote_memory_used_.fetch_add(mem, std::memory_order_relaxed);
+  }
+  void FreeRemoteMem(size_t mem) {
+    remote_memory_used_.fetch_sub(mem, std::memory_order_relaxed);
+  }
+
   // Add the DB instance to the queue and block the DB.
   // Should only be called by RocksDB internally.
   void BeginWriteStall(StallInterface* wbm_stall);
@@ -165,6 +179,7 @@ class WriteBufferManager final {
   std::atomic<size_t> memory_used_;
   // Memory that hasn't been scheduled to free.
   std::atomic<size_t> memory_active_;
+  std::atomic<size_t> remote_memory_used_{0};
   std::shared_ptr<CacheReservationManager> cache_res_mgr_;
   // Protects cache_res_mgr_
   std::mutex cache_res_mgr_mu_;
@@ -0,0 +1,226 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#include <sys/syscall.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+#include "rocksdb/logger.hpp"
+
+namespace LocalLogger {
+
+struct AsyncLogger::Ring {
+  static constexpr uint64_t kSlots = 256;
+
+  std::unique_ptr<LogRecord[]> slots{new LogRecord[kSlots]};
+  // head is written by the owner thread only, tail by the drainer only
+  std::atomic<uint64_t> head{0};
+  std::atomic<uint64_t> tail{0};
+  std::atomic<uint64_t> dropped{0};
+  // the owner thread exited, the ring goes once drained
+  std::atomic<bool> closed{false};
+  int64_t tid = 0;
+};
+
+namespace {
+
+struct RingHolder {
+  std::shared_ptr<void> ring;
+  std::atomic<bool> *closed = nullptr;
+  ~RingHolder() {
+    if (closed != nullptr) closed->store(true);
+  }
+};
+thread_local RingHolder tls_ring;
+
+int LevelFromEnv() {
+  const char *env = getenv("ROCKSDB_DM_LOG_LEVEL");
+  if (env == nullptr) return static_cast<int>(Level::kInfo);
+  std::string name = env;
+  if (name == "debug") return static_cast<int>(Level::kDebug);
+  if (name == "warn") return static_cast<int>(Level::kWarn);
+  if (name == "error") return static_cast<int>(Level::kError);
+  return static_cast<int>(Level::kInfo);
+}
+
+const char kLevelChar[] = {'D', 'I', 'W', 'E'};
+
+void Format(const LogRecord &rec, int64_t tid, std::string *out) {
+  const char *file = strrchr(rec.file, '/');
+  file = file == nullptr ? rec.file : file + 1;
+  char buf[128];
+  snprintf(buf, sizeof(buf), "%c %" PRIu64 " %" PRId64 " %s:%u]",
+           kLevelChar[static_cast<int>(rec.level)], rec.time / 1000, tid, file,
+           rec.line);
+  out->append(buf);
+  const char *p = rec.payload;
+  const char *end = rec.payload + rec.len;
+  while (p < end) {
+    char tag = *p++;
+    out->push_back(' ');
+    switch (tag) {
+      case LogRecord::kInt: {
+        int64_t v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        snprintf(buf, sizeof(buf), "%" PRId64, v);
+        out->append(buf);
+        break;
+      }
+      case LogRecord::kUint: {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        snprintf(buf, sizeof(buf), "%" PRIu64, v);
+        out->append(buf);
+        break;
+      }
+      case LogRecord::kDouble: {
+        double v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        snprintf(buf, sizeof(buf), "%g", v);
+        out->append(buf);
+        break;
+      }
+      case LogRecord::kChar:
+        out->push_back(*p++);
+        break;
+      case LogRecord::kBool:
+        out->push_back(*p++ ? '1' : '0');
+        break;
+      case LogRecord::kPtr: {
+        uintptr_t v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        snprintf(buf, sizeof(buf), "%p", reinterpret_cast<void *>(v));
+        out->append(buf);
+        break;
+      }
+      case LogRecord::kStr: {
+        uint16_t n;
+        memcpy(&n, p, sizeof(n));
+        p += sizeof(n);
+        out->append(p, n);
+        p += n;
+        break;
+      }
+      default:
+        p = end;
+    }
+  }
+  if (rec.truncated) out->append(" ...");
+  out->push_back('\n');
+}
+
+}  // namespace
+
+AsyncLogger &AsyncLogger::Instance() {
+  // never destroyed, threads may log during static destruction
+  static AsyncLogger *logger = []() {
+    auto *l = new AsyncLogger();
+    std::atexit([]() { Instance().Flush(); });
+    return l;
+  }();
+  return *logger;
+}
+
+AsyncLogger::AsyncLogger() : level_(LevelFromEnv()) {
+  drainer_ = std::thread([this]() { DrainLoop(); });
+  drainer_.detach();
+}
+
+LogRecord *AsyncLogger::Reserve() {
+  Ring *ring = static_cast<Ring *>(tls_ring.ring.get());
+  if (ring == nullptr) {
+    auto created = std::make_shared<Ring>();
+    created->tid = static_cast<int64_t>(syscall(SYS_gettid));
+    tls_ring.closed = &created->closed;
+    tls_ring.ring = created;
+    ring = created.get();
+    std::lock_guard<std::mutex> lck(rings_mu_);
+    rings_.push_back(std::move(created));
+  }
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= Ring::kSlots) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  return &ring->slots[head % Ring::kSlots];
+}
+
+void AsyncLogger::Commit() {
+  Ring *ring = static_cast<Ring *>(tls_ring.ring.get());
+  ring->head.store(ring->head.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+}
+
+size_t AsyncLogger::Drain(std::string *out) {
+  std::vector<std::shared_ptr<Ring>> rings;
+  {
+    std::lock_guard<std::mutex> lck(rings_mu_);
+    rings = rings_;
+  }
+  size_t n = 0;
+  for (auto &ring : rings) {
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail < head; tail++, n++) {
+      Format(ring->slots[tail % Ring::kSlots], ring->tid, out);
+    }
+    ring->tail.store(tail, std::memory_order_release);
+    uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+      char buf[96];
+      snprintf(buf, sizeof(buf), "W %" PRId64 " dropped %" PRIu64 " records\n",
+               ring->tid, dropped);
+      out->append(buf);
+    }
+  }
+  std::lock_guard<std::mutex> lck(rings_mu_);
+  for (auto it = rings_.begin(); it != rings_.end();) {
+    Ring *ring = it->get();
+    if (ring->closed.load() && ring->tail.load() == ring->head.load()) {
+      it = rings_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return n;
+}
+
+void AsyncLogger::DrainLoop() {
+  std::string out;
+  while (true) {
+    size_t n = 0;
+    {
+      std::lock_guard<std::mutex> lck(drain_mu_);
+      n = Drain(&out);
+      if (!out.empty()) fwrite(out.data(), 1, out.size(), stderr);
+    }
+    out.clear();
+    if (n == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void AsyncLogger::Flush() {
+  std::string out;
+  std::lock_guard<std::mutex> lck(drain_mu_);
+  Drain(&out);
+  if (!out.empty()) fwrite(out.data(), 1, out.size(), stderr);
+  fflush(stderr);
+}
+
+void AsyncLogger::WriteNow(const LogRecord &rec) {
+  // what this thread logged before comes first
+  Flush();
+  std::string out;
+  Format(rec, static_cast<int64_t>(syscall(SYS_gettid)), &out);
+  fwrite(out.data(), 1, out.size(), stderr);
+  fflush(stderr);
+}
+
+}  // namespace LocalLogger
@@ -0,0 +1,166 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include <cstdlib>
+#include <string>
+
+#include "port/port.h"
+#include "rocksdb/logger.hpp"
+#include "test_util/testharness.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+using LocalLogger::AsyncLogger;
+using LocalLogger::Level;
+using LocalLogger::LogRecord;
+using LocalLogger::LogRecordWriter;
+
+class AsyncLoggerTest : public testing::Test {
+ protected:
+  AsyncLoggerTest() { AsyncLogger::Instance().SetLevel(Level::kInfo); }
+  ~AsyncLoggerTest() override {
+    AsyncLogger::Instance().SetLevel(Level::kInfo);
+  }
+
+  // what the logger writes until Flush() returns
+  static void StartCapture() {
+    AsyncLogger::Instance().Flush();
+    testing::internal::CaptureStderr();
+  }
+  static std::string StopCapture() {
+    AsyncLogger::Instance().Flush();
+    return testing::internal::GetCapturedStderr();
+  }
+
+  static LogRecord EmptyRecord() {
+    LogRecord rec;
+    rec.truncated = false;
+    rec.len = 0;
+    return rec;
+  }
+};
+
+TEST_F(AsyncLoggerTest, WriterEncodesTaggedValues) {
+  LogRecord rec = EmptyRecord();
+  {
+    LogRecordWriter w(&rec);
+    w.Put(-7);
+    w.Put('c');
+    w.Put("abc");
+  }
+  ASSERT_FALSE(rec.truncated);
+  ASSERT_EQ(1 + sizeof(int64_t) + 1 + 1 + 1 + sizeof(uint16_t) + 3, rec.len);
+  ASSERT_EQ(LogRecord::kInt, rec.payload[0]);
+  int64_t v;
+  memcpy(&v, rec.payload + 1, sizeof(v));
+  ASSERT_EQ(-7, v);
+  ASSERT_EQ(LogRecord::kChar, rec.payload[9]);
+  ASSERT_EQ('c', rec.payload[10]);
+  ASSERT_EQ(LogRecord::kStr, rec.payload[11]);
+  ASSERT_EQ("abc", std::string(rec.payload + 14, 3));
+}
+
+TEST_F(AsyncLoggerTest, WriterTruncates) {
+  LogRecord rec = EmptyRecord();
+  {
+    LogRecordWriter w(&rec);
+    w.Put(std::string(LogRecord::kSize, 'x'));
+    // no room left for anything else
+    w.Put(1);
+  }
+  ASSERT_TRUE(rec.truncated);
+  ASSERT_EQ(sizeof(rec.payload), rec.len);
+  uint16_t n;
+  memcpy(&n, rec.payload + 1, sizeof(n));
+  ASSERT_EQ(sizeof(rec.payload) - 1 - sizeof(uint16_t), n);
+}
+
+TEST_F(AsyncLoggerTest, FormatsValues) {
+  StartCapture();
+  DM_LOG_INFO("int", -7, "uint", 7U, "bool", true, "char", 'c', "str",
+              std::string("s"), "null", static_cast<const char *>(nullptr));
+  std::string out = StopCapture();
+  ASSERT_NE(std::string::npos, out.find("I "));
+  ASSERT_NE(std::string::npos,
+            out.find("] int -7 uint 7 bool 1 char c str s null (null)\n"));
+}
+
+TEST_F(AsyncLoggerTest, LevelFilter) {
+  ASSERT_TRUE(AsyncLogger::Enabled(Level::kInfo));
+  ASSERT_FALSE(AsyncLogger::Enabled(Level::kDebug));
+  AsyncLogger::Instance().SetLevel(Level::kWarn);
+  ASSERT_FALSE(AsyncLogger::Enabled(Level::kInfo));
+  ASSERT_TRUE(AsyncLogger::Enabled(Level::kWarn));
+  ASSERT_TRUE(AsyncLogger::Enabled(Level::kError));
+
+  int evaluated = 0;
+  StartCapture();
+  DM_LOG_INFO("filtered-info", ++evaluated);
+  DM_LOG_WARN("kept-warn");
+  DM_LOG_ERROR("kept-error");
+  std::string out = StopCapture();
+  // arguments of a filtered site are not evaluated
+  ASSERT_EQ(0, evaluated);
+  ASSERT_EQ(std::string::npos, out.find("filtered-info"));
+  ASSERT_NE(std::string::npos, out.find("W "));
+  ASSERT_NE(std::string::npos, out.find("kept-warn"));
+  ASSERT_NE(std::string::npos, out.find("E "));
+  ASSERT_NE(std::string::npos, out.find("kept-error"));
+
+  AsyncLogger::Instance().SetLevel(Level::kInfo);
+  StartCapture();
+  DM_LOG_INFO("info-again");
+  out = StopCapture();
+  ASSERT_NE(std::string::npos, out.find("info-again"));
+}
+
+TEST_F(AsyncLoggerTest, ErrorAfterEarlierRecords) {
+  testing::internal::CaptureStderr();
+  for (int i = 0; i < 10; i++) {
+    DM_LOG_INFO("before-error", i);
+  }
+  // written before the call returns, behind what this thread logged
+  DM_LOG_ERROR("the-error");
+  std::string out = testing::internal::GetCapturedStderr();
+  size_t error = out.find("the-error");
+  ASSERT_NE(std::string::npos, error);
+  ASSERT_LT(out.find("before-error 9"), error);
+}
+
+TEST_F(AsyncLoggerTest, FlushOnShutdown) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  // records still in the ring at exit are written by the atexit flush
+  ASSERT_EXIT(
+      {
+        for (int i = 0; i < 100; i++) {
+          DM_LOG_INFO("before-exit", i);
+        }
+        std::exit(0);
+      },
+      ::testing::ExitedWithCode(0), "before-exit 99");
+}
+
+TEST_F(AsyncLoggerTest, ThreadRecordsOutliveThread) {
+  StartCapture();
+  port::Thread t([]() {
+    for (int i = 0; i < 100; i++) {
+      DM_LOG_INFO("exited-thread", i);
+    }
+  });
+  t.join();
+  std::string out = StopCapture();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_NE(std::string::npos,
+              out.find("exited-thread " + std::to_string(i) + "\n"));
+  }
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
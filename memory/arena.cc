@@ -50,11 +50,13 @@ size_t Arena::OptimizeBlockSize(size_t block_size) {
 }
 
 Arena::Arena(size_t block_size, AllocTracker* tracker, size_t huge_page_size,
-             RDMAClient* client, RDMANode::rdma_connection* conn)
+             RDMAClient* client, RDMANode::rdma_connection* conn,
+             int64_t local_block)
     : kBlockSize(OptimizeBlockSize(block_size)),
       tracker_(tracker),
       client_(client),
-      conn_(conn) {
+      conn_(conn),
+      local_block_(local_block) {
   assert(kBlockSize >= kMinBlockSize && kBlockSize <= kMaxBlockSize &&
          kBlockSize % kAlignUnit == 0);
   TEST_SYNC_POINT_CALLBACK("Arena::Arena:0", const_cast<size_t*>(&kBlockSize));
@@ -180,20 +182,21 @@ char* Arena::AllocateNewBlock(size_t block_bytes) {
   // here
   char* block = nullptr;
   if (client_ != nullptr && conn_ != nullptr && blocks_.empty()) {
-    auto offset = client_->rdma_mem_.allocate(block_bytes);
-    if (offset == -1)
-      LOG_CERR("Failed to allocate memory from RDMA client mempool");
+    assert(local_block_ != -1);
     auto remote_reg = client_->allocate_mem_request(conn_, block_bytes);
+    if (remote_reg.first == -1) {
+      DM_LOG_ERROR("memnode has no block of ", block_bytes, " bytes");
+    }
     remote_reg_mem = {remote_reg.first, remote_reg.second - remote_reg.first};
-    block = client_->get_buf() + offset;
+    block = client_->get_buf() + local_block_;
     // block = new char[block_bytes];
   } else {
     block = new char[block_bytes];
     if (conn_ != nullptr && client_ != nullptr) {
-      LOG_CERR("Arena Allocate New Builtin Block!!!:: ", conn_->sock,
-               "AllocateNewBlock: ", block_bytes,
-               " CHECK::", alloc_bytes_remaining_, ' ', kBlockSize, ' ',
-               blocks_.size());
+      DM_LOG_DEBUG("Arena Allocate New Builtin Block!!!:: ", conn_->sock,
+                   "AllocateNewBlock: ", block_bytes,
+                   " CHECK::", alloc_bytes_remaining_, ' ', kBlockSize, ' ',
+                   blocks_.size());
     }
   }
   blocks_.push_back(std::unique_ptr<char[]>(block));
@@ -209,19 +212,38 @@ char* Arena::AllocateNewBlock(size_t block_bytes) {
 
 Status Arena::SendToRemote() const {
   Status s;
+  if (client_ != nullptr && conn_ != nullptr && remote_reg_mem.first == -1) {
+    return Status::MemoryLimit("memnode has no block for the arena");
+  }
   if (client_ != nullptr && conn_ != nullptr) {
     std::chrono::high_resolution_clock::time_point start_time =
         std::chrono::high_resolution_clock::now();
-    client_->rdma_write(conn_, BlockSize(), mem_begin_ - client_->get_buf(),
-                        remote_reg_mem.first);
-    ASSERT_RW(client_->poll_completion(conn_) == 0);
+    size_t local = mem_begin_ - client_->get_buf();
+    if (blocks_.size() == 1) {
+      // aligned allocations grow from the front of the block and unaligned
+      // ones from the back, the gap between them was never handed out
+      size_t front = aligned_alloc_ptr_ - mem_begin_;
+      size_t back = unaligned_alloc_ptr_ - mem_begin_;
+      if (front > 0) {
+        client_->rdma_write(conn_, front, local, remote_reg_mem.first);
+        ASSERT_RW(client_->poll_completion(conn_) == 0);
+      }
+      if (back < BlockSize()) {
+        client_->rdma_write(conn_, BlockSize() - back, local + back,
+                            remote_reg_mem.first + back);
+        ASSERT_RW(client_->poll_completion(conn_) == 0);
+      }
+    } else {
+      client_->rdma_write(conn_, BlockSize(), local, remote_reg_mem.first);
+      ASSERT_RW(client_->poll_completion(conn_) == 0);
+    }
     std::chrono::high_resolution_clock::time_point end_time =
         std::chrono::high_resolution_clock::now();
-    LOG_CERR("Arena SendToRemote: ",
-             std::chrono::duration_cast<std::chrono::microseconds>(end_time -
-                                                                   start_time)
-                 .count(),
-             " us, size = ", BlockSize());
+    DM_LOG_DEBUG("Arena SendToRemote: ",
+                 std::chrono::duration_cast<std::chrono::microseconds>(
+                     end_time - start_time)
+                     .count(),
+                 " us, size = ", BlockSize());
   }
   return s;
 }
@@ -52,7 +52,8 @@ class Arena : public BasicArena {
   explicit Arena(size_t block_size = kMinBlockSize,
                  AllocTracker* tracker = nullptr, size_t huge_page_size = 0,
                  RDMAClient* client = nullptr,
-                 RDMANode::rdma_connection* conn = nullptr);
+                 RDMANode::rdma_connection* conn = nullptr,
+                 int64_t local_block = -1);
   ~Arena() override;
 
   char* Allocate(size_t bytes) override;
@@ -141,6 +142,9 @@ class Arena : public BasicArena {
   AllocTracker* tracker_;
   RDMAClient* client_ = nullptr;
   RDMANode::rdma_connection* conn_ = nullptr;
+  // offset of the first block in the registered buffer of client_, reserved
+  // by the owner of conn_ before the memnode was asked for its copy
+  int64_t local_block_ = -1;
   std::pair<int64_t, int64_t> remote_reg_mem = {0, 0};
 };
 
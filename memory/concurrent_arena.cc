@@ -31,10 +31,11 @@ const size_t kMaxShardBlockSize = size_t{128 * 1024};
 
 ConcurrentArena::ConcurrentArena(size_t block_size, AllocTracker* tracker,
                                  size_t huge_page_size, RDMAClient* client,
-                                 RDMANode::rdma_connection* conn)
+                                 RDMANode::rdma_connection* conn,
+                                 int64_t local_block)
     : shard_block_size_(std::min(kMaxShardBlockSize, block_size / 8)),
       shards_(),
-      arena_(block_size, tracker, huge_page_size, client, conn) {
+      arena_(block_size, tracker, huge_page_size, client, conn, local_block) {
   Fixup();
 }
 
@@ -60,7 +60,8 @@ class ConcurrentArena : public BasicArena {
                            AllocTracker* tracker = nullptr,
                            size_t huge_page_size = 0,
                            RDMAClient* client = nullptr,
-                           RDMANode::rdma_connection* conn = nullptr);
+                           RDMANode::rdma_connection* conn = nullptr,
+                           int64_t local_block = -1);
   ~ConcurrentArena() override = default;
   char* Allocate(size_t bytes) override {
     return AllocateImpl(bytes, false /*force_arena*/,
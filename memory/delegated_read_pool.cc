@@ -0,0 +1,159 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#include "memory/delegated_read_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+#include "rocksdb/logger.hpp"
+
+namespace ROCKSDB_NAMESPACE {
+
+DelegatedReadPool::DelegatedReadPool(RDMANode *node, size_t num_pollers,
+                                     size_t num_workers)
+    : node_(node) {
+  num_pollers = std::max<size_t>(1, num_pollers);
+  num_workers = std::max<size_t>(1, num_workers);
+  for (size_t i = 0; i < num_pollers; i++) {
+    pollers_.emplace_back(new Poller());
+    Poller *poller = pollers_.back().get();
+    poller->thread = std::thread([this, poller]() { PollLoop(poller); });
+  }
+  for (size_t i = 0; i < num_workers; i++) {
+    workers_.emplace_back([this]() { WorkLoop(); });
+  }
+  DM_LOG_INFO("delegated read pool: ", num_pollers, " pollers ", num_workers,
+              " workers");
+}
+
+DelegatedReadPool::~DelegatedReadPool() {
+  stop_.store(true);
+  for (auto &poller : pollers_) poller->thread.join();
+  for (auto &t : workers_) t.join();
+}
+
+size_t DelegatedReadPool::DefaultPollers() {
+  // one poller keeps up with the completions of about 16 busy workers
+  return std::max(1u, std::thread::hardware_concurrency() / 16);
+}
+
+size_t DelegatedReadPool::DefaultWorkers() {
+  return std::max(2u, std::thread::hardware_concurrency() / 2);
+}
+
+void DelegatedReadPool::AddConnection(RDMANode::rdma_connection *conn,
+                                      const std::vector<size_t> &slots,
+                                      Service service) {
+  auto source = std::make_shared<Source>();
+  source->conn = conn;
+  source->slots = slots;
+  source->service = std::move(service);
+  for (size_t i = 0; i < slots.size(); i++) PostRecv(source.get(), i);
+  Poller *poller =
+      pollers_[next_poller_.fetch_add(1) % pollers_.size()].get();
+  std::lock_guard<std::mutex> lck(poller->mu);
+  poller->sources.push_back(std::move(source));
+}
+
+void DelegatedReadPool::RemoveConnection(RDMANode::rdma_connection *conn) {
+  std::shared_ptr<Source> source;
+  for (auto &poller : pollers_) {
+    std::lock_guard<std::mutex> lck(poller->mu);
+    auto &sources = poller->sources;
+    auto it = std::find_if(sources.begin(), sources.end(),
+                           [conn](const std::shared_ptr<Source> &s) {
+                             return s->conn == conn;
+                           });
+    if (it != sources.end()) {
+      source = std::move(*it);
+      sources.erase(it);
+      break;
+    }
+  }
+  if (source == nullptr) return;
+  // no poller hands out new requests of conn past this point
+  while (source->inflight.load() > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+}
+
+void DelegatedReadPool::PostRecv(Source *source, size_t slot) {
+  node_->receive(source->conn, source->service.req_size, source->slots[slot],
+                 RecvId(slot));
+}
+
+void DelegatedReadPool::PollLoop(Poller *poller) {
+  int idle_rounds = 0;
+  int sleep_us = 1;
+  while (!stop_.load(std::memory_order_relaxed)) {
+    int found = 0;
+    {
+      std::lock_guard<std::mutex> lck(poller->mu);
+      for (auto &source : poller->sources) found += Poll(source);
+    }
+    if (found > 0) {
+      idle_rounds = 0;
+      sleep_us = 1;
+    } else if (++idle_rounds > kSpinRounds) {
+      std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+      sleep_us = std::min(sleep_us * 2, kMaxIdleSleepUs);
+    }
+  }
+}
+
+int DelegatedReadPool::Poll(const std::shared_ptr<Source> &source) {
+  dm_completion wc;
+  int found = 0;
+  while (found < kPollBatch) {
+    int ret = node_->transport()->PollCompletion(source->conn->ep, &wc);
+    if (ret == 0) break;
+    if (ret < 0) {
+      DM_LOG_ERROR("poll CQ failed");
+      break;
+    }
+    found++;
+    if (wc.status != 0) {
+      DM_LOG_WARN("got bad completion with status: ", wc.status,
+                  " vendor syndrome: ", wc.vendor_err);
+      continue;
+    }
+    // nothing waits for a send, a client sends the next request of its
+    // connection only once the reply has landed
+    if (wc.wr_id < 2 || (wc.wr_id & 1) != 0) continue;
+    size_t slot = (wc.wr_id - 2) >> 1;
+    assert(slot < source->slots.size());
+    source->inflight.fetch_add(1);
+    queued_.fetch_add(1, std::memory_order_relaxed);
+    work_.enqueue(Work{source, slot});
+  }
+  return found;
+}
+
+void DelegatedReadPool::WorkLoop() {
+  Work work;
+  while (!stop_.load(std::memory_order_relaxed)) {
+    if (!work_.wait_dequeue_timed(work, std::chrono::milliseconds(10))) {
+      continue;
+    }
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    busy_.fetch_add(1, std::memory_order_relaxed);
+    Source *source = work.source.get();
+    size_t offset = source->slots[work.slot];
+    size_t len = source->service.handle(node_->get_buf() + offset);
+    busy_.fetch_sub(1, std::memory_order_relaxed);
+    // the client may send its next request as soon as the reply lands, so
+    // the receive goes back first
+    PostRecv(source, work.slot);
+    node_->send(source->conn, len, offset + source->service.ret_offset,
+                SendId(work.slot));
+    source->inflight.fetch_sub(1);
+    work.source.reset();
+  }
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,108 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rocksdb/blockingconcurrentqueue.h"
+#include "rocksdb/remote_flush_service.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Serves the delegated reads of every client connection of a memnode with a
+// fixed number of threads. Pollers own a share of the connections each and
+// turn their receive completions into work items, workers run the lookups
+// and post the replies. Thread count follows the cores of the memnode, not
+// the number of clients times their queue depth.
+//
+// A poller spins while its connections are busy and backs off to short
+// sleeps once they have been idle for a while, workers block on the work
+// queue.
+class DelegatedReadPool {
+ public:
+  // how one connection lays out its slots and answers a request: handle
+  // gets the slot holding a request of at most req_size bytes and returns
+  // the length of the reply it left at slot + ret_offset
+  struct Service {
+    size_t req_size;
+    size_t ret_offset;
+    std::function<size_t(char *slot)> handle;
+  };
+
+  DelegatedReadPool(RDMANode *node, size_t num_pollers, size_t num_workers);
+  ~DelegatedReadPool();
+  DelegatedReadPool(const DelegatedReadPool &) = delete;
+  void operator=(const DelegatedReadPool &) = delete;
+
+  // posts a receive on every slot, then serves conn until it is removed
+  void AddConnection(RDMANode::rdma_connection *conn,
+                     const std::vector<size_t> &slots, Service service);
+  // stops serving conn, returns after its last request was answered
+  void RemoveConnection(RDMANode::rdma_connection *conn);
+
+  // sampled without a lock, reported to the clients with every reply
+  imm_read_load Load() const {
+    imm_read_load load;
+    load.queued = queued_.load(std::memory_order_relaxed);
+    load.busy = busy_.load(std::memory_order_relaxed);
+    load.workers = static_cast<uint32_t>(workers_.size());
+    load.reserved = 0;
+    return load;
+  }
+
+  static size_t DefaultPollers();
+  static size_t DefaultWorkers();
+
+ private:
+  // empty rounds before a poller starts to sleep, and its longest sleep
+  static constexpr int kSpinRounds = 1 << 12;
+  static constexpr int kMaxIdleSleepUs = 200;
+  static constexpr int kPollBatch = 16;
+
+  struct Source {
+    RDMANode::rdma_connection *conn;
+    std::vector<size_t> slots;
+    Service service;
+    // requests handed to workers and not answered yet
+    std::atomic<int> inflight{0};
+  };
+  struct Poller {
+    std::mutex mu;
+    std::vector<std::shared_ptr<Source>> sources;
+    std::thread thread;
+  };
+  struct Work {
+    std::shared_ptr<Source> source;
+    size_t slot;
+  };
+
+  // wr_id of the receive and the send of a slot, never 0
+  static uint64_t RecvId(size_t slot) { return (slot << 1) + 2; }
+  static uint64_t SendId(size_t slot) { return (slot << 1) + 3; }
+
+  void PollLoop(Poller *poller);
+  // polls the completions of one connection, returns how many it found
+  int Poll(const std::shared_ptr<Source> &source);
+  void WorkLoop();
+  void PostRecv(Source *source, size_t slot);
+
+  RDMANode *node_;
+  std::atomic<bool> stop_{false};
+  std::vector<std::unique_ptr<Poller>> pollers_;
+  std::atomic<size_t> next_poller_{0};
+  std::vector<std::thread> workers_;
+  moodycamel::BlockingConcurrentQueue<Work> work_;
+  std::atomic<uint32_t> queued_{0};
+  std::atomic<uint32_t> busy_{0};
+};
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,228 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memory/delegated_read_pool.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "port/port.h"
+#include "test_util/testharness.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+// either end of a shm connection, keeps the connections it accepted
+class PoolTestNode : public RDMANode {
+ public:
+  RDMANode::rdma_connection *WaitConnection() {
+    std::unique_lock<std::mutex> lck(mu_);
+    cv_.wait(lck, [this]() { return !accepted_.empty(); });
+    auto *conn = accepted_.back();
+    accepted_.pop_back();
+    return conn;
+  }
+
+ private:
+  void after_connect_qp(RDMANode::rdma_connection *conn) override {
+    std::lock_guard<std::mutex> lck(mu_);
+    accepted_.push_back(conn);
+    cv_.notify_all();
+  }
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::vector<RDMANode::rdma_connection *> accepted_;
+};
+}  // namespace
+
+class DelegatedReadPoolTest : public testing::Test {
+ protected:
+  static constexpr size_t kBufSize = 1 << 20;
+  static constexpr size_t kSlotSize = 4096;
+  static constexpr size_t kRetOffset = 1024;
+  static constexpr size_t kNumSlots = 8;
+
+  // request and reply of the service under test
+  struct Request {
+    uint32_t id;
+    uint32_t value;
+  };
+
+  void SetUp() override {
+    setenv("ROCKSDB_DM_TRANSPORT", "shm", 1);
+    // a port nothing holds, the server binds it without SO_REUSEADDR
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(0, bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len));
+    close(fd);
+    int port = ntohs(addr.sin_port);
+
+    // never freed, it accepts connections until the process exits
+    server_ = new PoolTestNode();
+    ASSERT_EQ(0, server_->resources_create(kBufSize));
+    std::thread([server = server_, port]() { server->sock_connect("", port); })
+        .detach();
+    client_.reset(new PoolTestNode());
+    ASSERT_EQ(0, client_->resources_create(kBufSize));
+    for (int i = 0; i < 500 && client_conn_ == nullptr; i++) {
+      client_conn_ = client_->sock_connect("127.0.0.1", port);
+      if (client_conn_ == nullptr) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    ASSERT_NE(nullptr, client_conn_);
+    server_conn_ = server_->WaitConnection();
+    for (size_t i = 0; i < kNumSlots; i++) {
+      slots_.push_back(i * kSlotSize);
+    }
+  }
+
+  void TearDown() override {
+    pool_.reset();
+    client_.reset();
+  }
+
+  // doubles the value of a request
+  DelegatedReadPool::Service Doubler(std::atomic<int> *served) {
+    return DelegatedReadPool::Service{
+        sizeof(Request), kRetOffset, [served](char *slot) {
+          Request req;
+          memcpy(&req, slot, sizeof(req));
+          req.value *= 2;
+          memcpy(slot + kRetOffset, &req, sizeof(req));
+          served->fetch_add(1);
+          return sizeof(req);
+        }};
+  }
+
+  // sends one request per entry of values from the slots of the client,
+  // returns the replies by request id
+  std::vector<uint32_t> Roundtrip(const std::vector<uint32_t> &values) {
+    char *buf = client_->get_buf();
+    for (size_t i = 0; i < values.size(); i++) {
+      EXPECT_EQ(0, client_->receive(client_conn_, sizeof(Request),
+                                    i * kSlotSize + kRetOffset, 2 * i + 2));
+    }
+    for (size_t i = 0; i < values.size(); i++) {
+      Request req{static_cast<uint32_t>(i), values[i]};
+      memcpy(buf + i * kSlotSize, &req, sizeof(req));
+      EXPECT_EQ(0, client_->send(client_conn_, sizeof(req), i * kSlotSize,
+                                 2 * i + 3));
+    }
+    std::vector<uint32_t> replies(values.size(), 0);
+    size_t received = 0;
+    while (received < values.size()) {
+      dm_completion wc;
+      int ret = client_->transport()->PollCompletion(client_conn_->ep, &wc);
+      EXPECT_GE(ret, 0);
+      if (ret <= 0) {
+        std::this_thread::yield();
+        continue;
+      }
+      EXPECT_EQ(0, wc.status);
+      if (wc.opcode != dm_opcode::kRecv) {
+        continue;
+      }
+      // replies land in the order the workers send them
+      size_t i = (wc.wr_id - 2) / 2;
+      Request reply;
+      memcpy(&reply, buf + i * kSlotSize + kRetOffset, sizeof(reply));
+      EXPECT_LT(reply.id, values.size());
+      if (reply.id < values.size()) {
+        replies[reply.id] = reply.value;
+      }
+      received++;
+    }
+    return replies;
+  }
+
+  PoolTestNode *server_ = nullptr;
+  std::unique_ptr<PoolTestNode> client_;
+  RDMANode::rdma_connection *server_conn_ = nullptr;
+  RDMANode::rdma_connection *client_conn_ = nullptr;
+  std::vector<size_t> slots_;
+  std::unique_ptr<DelegatedReadPool> pool_;
+};
+
+TEST_F(DelegatedReadPoolTest, ServesEverySlot) {
+  pool_.reset(new DelegatedReadPool(server_, 1, 3));
+  ASSERT_EQ(3u, pool_->Load().workers);
+  std::atomic<int> served{0};
+  pool_->AddConnection(server_conn_, slots_, Doubler(&served));
+
+  // every round needs the receives the workers posted back
+  for (uint32_t round = 0; round < 4; round++) {
+    std::vector<uint32_t> values;
+    for (uint32_t i = 0; i < kNumSlots; i++) {
+      values.push_back(round * 100 + i);
+    }
+    std::vector<uint32_t> replies = Roundtrip(values);
+    for (size_t i = 0; i < values.size(); i++) {
+      ASSERT_EQ(values[i] * 2, replies[i]);
+    }
+  }
+  ASSERT_EQ(static_cast<int>(4 * kNumSlots), served.load());
+  pool_->RemoveConnection(server_conn_);
+  // the load is reported with every reply, nothing is left after the last
+  imm_read_load load = pool_->Load();
+  ASSERT_EQ(0u, load.queued);
+  ASSERT_EQ(0u, load.busy);
+}
+
+TEST_F(DelegatedReadPoolTest, RemoveConnectionWaitsForRequests) {
+  pool_.reset(new DelegatedReadPool(server_, 1, 1));
+  std::atomic<bool> started{false};
+  std::atomic<bool> answered{false};
+  pool_->AddConnection(
+      server_conn_, slots_,
+      DelegatedReadPool::Service{sizeof(Request), kRetOffset,
+                                 [&](char *slot) {
+                                   started.store(true);
+                                   std::this_thread::sleep_for(
+                                       std::chrono::milliseconds(100));
+                                   memcpy(slot + kRetOffset, slot,
+                                          sizeof(Request));
+                                   answered.store(true);
+                                   return sizeof(Request);
+                                 }});
+  std::thread client([this]() { Roundtrip({42}); });
+  while (!started.load()) {
+    std::this_thread::yield();
+  }
+  pool_->RemoveConnection(server_conn_);
+  ASSERT_TRUE(answered.load());
+  client.join();
+  // removing it again is a no-op
+  pool_->RemoveConnection(server_conn_);
+}
+
+TEST_F(DelegatedReadPoolTest, Defaults) {
+  ASSERT_GE(DelegatedReadPool::DefaultPollers(), 1u);
+  ASSERT_GE(DelegatedReadPool::DefaultWorkers(), 2u);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,340 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+// Shared memory loopback for the DM protocol. Every registered buffer lives in
+// a memfd, peers on the same host map each other's memfd through
+// /proc/<pid>/fd/<fd> while connecting. One-sided read/write become memcpy on
+// the peer mapping. Two-sided send/recv go through a mailbox memfd per
+// endpoint: the owner publishes its posted receives there, the sender copies
+// the payload straight into the posted receive buffer and publishes the recv
+// completion back. Send side completions never leave the process.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "memory/dm_transport_util.h"
+#include "rocksdb/dm_transport.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+
+constexpr uint64_t kShmRingDepth = 1024;
+// same budget as MAX_POLL_CQ_TIMEOUT, a send without a posted receive on the
+// peer fails after that. Verbs fails such a send at once (rnr_retry 0), the
+// wait only covers a peer that posts its receive late.
+constexpr auto kShmRnrTimeout = std::chrono::milliseconds(2000);
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "mailbox lock is shared between processes");
+
+struct shm_wr {
+  uint64_t wr_id;
+  uint64_t offset;
+  uint64_t len;
+  int32_t status;
+};
+
+struct shm_ring {
+  uint64_t head;  // next entry to pop
+  uint64_t tail;  // next entry to push
+  shm_wr entries[kShmRingDepth];
+  bool push(const shm_wr &wr) {
+    if (tail - head == kShmRingDepth) return false;
+    entries[tail++ % kShmRingDepth] = wr;
+    return true;
+  }
+  uint64_t size() const { return tail - head; }
+  bool pop(shm_wr *wr) {
+    if (head == tail) return false;
+    *wr = entries[head++ % kShmRingDepth];
+    return true;
+  }
+};
+
+// lives in a memfd mapped by both sides of one connection
+struct shm_mailbox {
+  std::atomic<uint32_t> lock;
+  shm_ring posted_recv;  // pushed by the owner, popped by the peer's send
+  shm_ring recv_done;    // pushed by the peer's send, popped by owner's poll
+  void acquire() {
+    while (lock.exchange(1, std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  void release() { lock.store(0, std::memory_order_release); }
+};
+
+struct shm_con_data_t {
+  int32_t pid;
+  int32_t buf_fd;
+  int32_t box_fd;
+  uint64_t buf_size;
+} __attribute__((packed));
+
+struct shm_endpoint : public dm_endpoint {
+  int box_fd = -1;
+  shm_mailbox *local_box = nullptr;
+  shm_mailbox *peer_box = nullptr;
+  char *peer_buf = nullptr;
+  uint64_t peer_buf_size = 0;
+  std::mutex cq_mtx;
+  std::deque<dm_completion> send_cq;
+};
+
+void *map_peer_fd(int32_t pid, int32_t fd, size_t size) {
+  std::string path =
+      "/proc/" + std::to_string(pid) + "/fd/" + std::to_string(fd);
+  int local_fd = open(path.c_str(), O_RDWR);
+  if (local_fd < 0) {
+    fprintf(stderr, "failed to open %s\n", path.c_str());
+    return nullptr;
+  }
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_NORESERVE, local_fd, 0);
+  close(local_fd);
+  return addr == MAP_FAILED ? nullptr : addr;
+}
+
+class ShmTransport : public DMTransport {
+ public:
+  ShmTransport() = default;
+  ~ShmTransport() override { DeregisterMemory(); }
+  const char *Name() const override { return "shm"; }
+  char *RegisterMemory(size_t size) override;
+  int DeregisterMemory() override;
+  dm_endpoint *Connect(int sock) override;
+  int Disconnect(dm_endpoint *ep) override;
+  int PostSend(dm_endpoint *ep, dm_opcode opcode, size_t msg_size,
+               long long local_offset, long long remote_offset,
+               uint64_t wr_id) override;
+  int PostRecv(dm_endpoint *ep, size_t msg_size, long long local_offset,
+               uint64_t wr_id) override;
+  int PollCompletion(dm_endpoint *ep, dm_completion *wc) override;
+
+ private:
+  void complete(shm_endpoint *ep, uint64_t wr_id, dm_opcode opcode,
+                size_t len, int32_t status) {
+    std::lock_guard<std::mutex> lck(ep->cq_mtx);
+    ep->send_cq.push_back(dm_completion{wr_id, status, 0,
+                                        static_cast<uint32_t>(len), opcode});
+  }
+
+  int buf_fd_ = -1;
+  char *buf_ = nullptr;
+  size_t buf_size_ = 0;
+};
+
+char *ShmTransport::RegisterMemory(size_t size) {
+  buf_fd_ = static_cast<int>(syscall(SYS_memfd_create, "rocksdb-dm-buf", 0));
+  if (buf_fd_ < 0) {
+    fprintf(stderr, "memfd_create failed\n");
+    return nullptr;
+  }
+  if (ftruncate(buf_fd_, size)) {
+    fprintf(stderr, "failed to size dm buffer to %lu\n", size);
+    DeregisterMemory();
+    return nullptr;
+  }
+  // pages are populated on first touch, a 32GB memnode pool costs nothing
+  // until it is used
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_NORESERVE, buf_fd_, 0);
+  if (addr == MAP_FAILED) {
+    fprintf(stderr, "failed to map dm buffer\n");
+    DeregisterMemory();
+    return nullptr;
+  }
+  buf_ = reinterpret_cast<char *>(addr);
+  buf_size_ = size;
+  return buf_;
+}
+
+int ShmTransport::DeregisterMemory() {
+  if (buf_ != nullptr) munmap(buf_, buf_size_);
+  buf_ = nullptr;
+  buf_size_ = 0;
+  if (buf_fd_ >= 0) close(buf_fd_);
+  buf_fd_ = -1;
+  return 0;
+}
+
+dm_endpoint *ShmTransport::Connect(int sock) {
+  auto *ep = new shm_endpoint();
+  shm_con_data_t local_con_data;
+  shm_con_data_t remote_con_data;
+  char temp_char;
+  void *addr = nullptr;
+  ep->box_fd =
+      static_cast<int>(syscall(SYS_memfd_create, "rocksdb-dm-box", 0));
+  if (ep->box_fd < 0 || ftruncate(ep->box_fd, sizeof(shm_mailbox))) {
+    fprintf(stderr, "failed to create dm mailbox\n");
+    goto connect_exit;
+  }
+  addr = mmap(nullptr, sizeof(shm_mailbox), PROT_READ | PROT_WRITE, MAP_SHARED,
+              ep->box_fd, 0);
+  if (addr == MAP_FAILED) {
+    fprintf(stderr, "failed to map dm mailbox\n");
+    goto connect_exit;
+  }
+  // memfd is zero filled, which is a valid empty unlocked mailbox
+  ep->local_box = reinterpret_cast<shm_mailbox *>(addr);
+  local_con_data.pid = getpid();
+  local_con_data.buf_fd = buf_fd_;
+  local_con_data.box_fd = ep->box_fd;
+  local_con_data.buf_size = buf_size_;
+  if (dm_sock_sync_data(sock, sizeof(shm_con_data_t),
+                        reinterpret_cast<char *>(&local_con_data),
+                        reinterpret_cast<char *>(&remote_con_data)) < 0) {
+    fprintf(stderr, "failed to exchange connection data between sides\n");
+    goto connect_exit;
+  }
+  ep->peer_buf = reinterpret_cast<char *>(map_peer_fd(
+      remote_con_data.pid, remote_con_data.buf_fd, remote_con_data.buf_size));
+  ep->peer_buf_size = remote_con_data.buf_size;
+  ep->peer_box = reinterpret_cast<shm_mailbox *>(map_peer_fd(
+      remote_con_data.pid, remote_con_data.box_fd, sizeof(shm_mailbox)));
+  if (ep->peer_buf == nullptr || ep->peer_box == nullptr) goto connect_exit;
+  // both sides must hold their mappings before any fd may go away
+  if (dm_sock_sync_data(sock, 1, "Q", &temp_char)) {
+    fprintf(stderr, "sync error after mailboxes were mapped\n");
+    goto connect_exit;
+  }
+  return ep;
+connect_exit:
+  Disconnect(ep);
+  return nullptr;
+}
+
+int ShmTransport::Disconnect(dm_endpoint *ep) {
+  if (ep == nullptr) return 0;
+  auto *sep = static_cast<shm_endpoint *>(ep);
+  if (sep->peer_buf) munmap(sep->peer_buf, sep->peer_buf_size);
+  if (sep->peer_box) munmap(sep->peer_box, sizeof(shm_mailbox));
+  if (sep->local_box) munmap(sep->local_box, sizeof(shm_mailbox));
+  if (sep->box_fd >= 0) close(sep->box_fd);
+  delete sep;
+  return 0;
+}
+
+int ShmTransport::PostSend(dm_endpoint *ep, dm_opcode opcode, size_t msg_size,
+                           long long local_offset, long long remote_offset,
+                           uint64_t wr_id) {
+  auto *sep = static_cast<shm_endpoint *>(ep);
+  if (local_offset < 0 || local_offset + msg_size > buf_size_) {
+    fprintf(stderr, "local access out of the registered buffer\n");
+    return 1;
+  }
+  if (opcode == dm_opcode::kRead || opcode == dm_opcode::kWrite) {
+    if (remote_offset < 0 || remote_offset + msg_size > sep->peer_buf_size) {
+      fprintf(stderr, "remote access out of the registered buffer\n");
+      return 1;
+    }
+    if (opcode == dm_opcode::kRead)
+      memcpy(buf_ + local_offset, sep->peer_buf + remote_offset, msg_size);
+    else
+      memcpy(sep->peer_buf + remote_offset, buf_ + local_offset, msg_size);
+    // publish the payload before the peer can observe a later send
+    std::atomic_thread_fence(std::memory_order_release);
+    complete(sep, wr_id, opcode, msg_size, 0);
+    return 0;
+  }
+  if (opcode != dm_opcode::kSend) {
+    fprintf(stderr, "unsupported opcode for PostSend\n");
+    return 1;
+  }
+  auto start = std::chrono::steady_clock::now();
+  shm_mailbox *box = sep->peer_box;
+  shm_wr recv_wr;
+  while (true) {
+    box->acquire();
+    if (box->posted_recv.pop(&recv_wr)) break;
+    box->release();
+    if (std::chrono::steady_clock::now() - start > kShmRnrTimeout) {
+      fprintf(stderr, "no receive posted by peer, send dropped\n");
+      complete(sep, wr_id, opcode, 0, 1);
+      return 0;
+    }
+    std::this_thread::yield();
+  }
+  int32_t status = 0;
+  if (msg_size > recv_wr.len ||
+      recv_wr.offset + msg_size > sep->peer_buf_size) {
+    status = 1;
+  } else {
+    memcpy(sep->peer_buf + recv_wr.offset, buf_ + local_offset, msg_size);
+  }
+  // PostRecv() keeps posted and completed receives within one ring
+  bool pushed = box->recv_done.push(
+      shm_wr{recv_wr.wr_id, recv_wr.offset, msg_size, status});
+  box->release();
+  assert(pushed);
+  if (!pushed) {
+    fprintf(stderr, "receive completion ring of the peer is full\n");
+    status = 1;
+  }
+  complete(sep, wr_id, opcode, msg_size, status);
+  return 0;
+}
+
+int ShmTransport::PostRecv(dm_endpoint *ep, size_t msg_size,
+                           long long local_offset, uint64_t wr_id) {
+  auto *sep = static_cast<shm_endpoint *>(ep);
+  if (local_offset < 0 || local_offset + msg_size > buf_size_) {
+    fprintf(stderr, "failed to post RR\n");
+    return 1;
+  }
+  shm_mailbox *box = sep->local_box;
+  box->acquire();
+  // a posted receive moves to recv_done, which only polling drains, so both
+  // count against the depth of that ring
+  bool ok = box->posted_recv.size() + box->recv_done.size() < kShmRingDepth &&
+            box->posted_recv.push(shm_wr{
+                wr_id, static_cast<uint64_t>(local_offset), msg_size, 0});
+  box->release();
+  if (!ok) fprintf(stderr, "failed to post RR\n");
+  return ok ? 0 : 1;
+}
+
+int ShmTransport::PollCompletion(dm_endpoint *ep, dm_completion *wc) {
+  auto *sep = static_cast<shm_endpoint *>(ep);
+  {
+    std::lock_guard<std::mutex> lck(sep->cq_mtx);
+    if (!sep->send_cq.empty()) {
+      *wc = sep->send_cq.front();
+      sep->send_cq.pop_front();
+      return 1;
+    }
+  }
+  shm_wr done;
+  sep->local_box->acquire();
+  bool found = sep->local_box->recv_done.pop(&done);
+  sep->local_box->release();
+  if (!found) return 0;
+  *wc = dm_completion{done.wr_id, done.status, 0,
+                      static_cast<uint32_t>(done.len), dm_opcode::kRecv};
+  return 1;
+}
+
+}  // namespace
+
+DMTransport *NewShmTransport(const dm_transport_config * /*config*/) {
+  return new ShmTransport();
+}
+
+}  // namespace ROCKSDB_NAMESPACE
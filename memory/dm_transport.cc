@@ -0,0 +1,492 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "rocksdb/dm_transport.h"
+
+#include <arpa/inet.h>
+#include <byteswap.h>
+#include <endian.h>
+#include <infiniband/verbs.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "memory/dm_transport_util.h"
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+static inline uint64_t htonll(uint64_t x) { return bswap_64(x); }
+static inline uint64_t ntohll(uint64_t x) { return bswap_64(x); }
+#elif __BYTE_ORDER == __BIG_ENDIAN
+static inline uint64_t htonll(uint64_t x) { return x; }
+static inline uint64_t ntohll(uint64_t x) { return x; }
+#else
+#error __BYTE_ORDER is neither __LITTLE_ENDIAN nor __BIG_ENDIAN
+#endif
+
+namespace ROCKSDB_NAMESPACE {
+
+int dm_sock_sync_data(int sock, int xfer_size, const char *local_data,
+                      char *remote_data) {
+  int rc = 0;
+  int read_bytes = 0;
+  int total_read_bytes = 0;
+  rc = write(sock, local_data, xfer_size);
+  if (rc < xfer_size)
+    fprintf(stderr, "Failed writing data during sock_sync_data\n");
+  else
+    rc = 0;
+  while (!rc && total_read_bytes < xfer_size) {
+    read_bytes = read(sock, remote_data + total_read_bytes,
+                      xfer_size - total_read_bytes);
+
+    if (read_bytes > 0)
+      total_read_bytes += read_bytes;
+    else
+      rc = read_bytes;
+  }
+  return rc;
+}
+
+namespace {
+
+// structure to exchange data which is needed to connect the QPs
+struct cm_con_data_t {
+  uint64_t addr;    // Buffer address
+  uint32_t rkey;    // Remote key
+  uint32_t qp_num;  // QP number
+  uint16_t lid;     // LID of the IB port
+  uint8_t gid[16];  // gid
+} __attribute__((packed));
+
+struct verbs_endpoint : public dm_endpoint {
+  struct ibv_cq *cq = nullptr;  // CQ handle
+  struct ibv_qp *qp = nullptr;  // QP handle
+  cm_con_data_t remote_props;   // values to connect to remote side
+};
+
+class VerbsTransport : public DMTransport {
+ public:
+  explicit VerbsTransport(const dm_transport_config *config)
+      : config_(config) {}
+  ~VerbsTransport() override { DeregisterMemory(); }
+  const char *Name() const override { return "verbs"; }
+  char *RegisterMemory(size_t size) override;
+  int DeregisterMemory() override;
+  dm_endpoint *Connect(int sock) override;
+  int Disconnect(dm_endpoint *ep) override;
+  int PostSend(dm_endpoint *ep, dm_opcode opcode, size_t msg_size,
+               long long local_offset, long long remote_offset,
+               uint64_t wr_id) override;
+  int PostRecv(dm_endpoint *ep, size_t msg_size, long long local_offset,
+               uint64_t wr_id) override;
+  int PollCompletion(dm_endpoint *ep, dm_completion *wc) override;
+
+ private:
+  int modify_qp_to_init(struct ibv_qp *qp);
+  int modify_qp_to_rtr(struct ibv_qp *qp, uint32_t remote_qpn, uint16_t dlid,
+                       uint8_t *dgid);
+  int modify_qp_to_rts(struct ibv_qp *qp);
+
+  const dm_transport_config *config_;
+  struct ibv_port_attr port_attr_;      // IB port attributes
+  struct ibv_context *ib_ctx_ = nullptr;  // device handle
+  struct ibv_pd *pd_ = nullptr;           // PD handle
+  struct ibv_mr *mr_ = nullptr;           // MR handle for buf
+  char *buf_ = nullptr;
+};
+
+char *VerbsTransport::RegisterMemory(size_t size) {
+  struct ibv_device **dev_list = nullptr;
+  struct ibv_device *ib_dev = nullptr;
+  int i;
+  int mr_flags = 0;
+  int num_devices;
+  int rc = 0;
+  std::string dev_name = config_->dev_name;
+  // get device names in the system
+  dev_list = ibv_get_device_list(&num_devices);
+  if (!dev_list) {
+    fprintf(stderr, "failed to get IB devices list\n");
+    rc = 1;
+    goto register_memory_exit;
+  }
+  // if there isn't any IB device in host
+  if (!num_devices) {
+    fprintf(stderr, "found %d device(s)\n", num_devices);
+    rc = 1;
+    goto register_memory_exit;
+  }
+  // search for the specific device we want to work with
+  for (i = 0; i < num_devices; i++) {
+    if (dev_name == "") dev_name = ibv_get_device_name(dev_list[i]);
+    if (dev_name == ibv_get_device_name(dev_list[i])) {
+      ib_dev = dev_list[i];
+      break;
+    }
+  }
+  // if the device wasn't found in host
+  if (!ib_dev) {
+    fprintf(stderr, "IB device %s wasn't found\n", dev_name.c_str());
+    rc = 1;
+    goto register_memory_exit;
+  }
+  // get device handle
+  ib_ctx_ = ibv_open_device(ib_dev);
+  if (!ib_ctx_) {
+    fprintf(stderr, "failed to open device %s\n", dev_name.c_str());
+    rc = 1;
+    goto register_memory_exit;
+  }
+  // We are now done with device list, free it
+  ibv_free_device_list(dev_list);
+  dev_list = nullptr;
+  ib_dev = nullptr;
+  // query port properties
+  if (ibv_query_port(ib_ctx_, config_->ib_port, &port_attr_)) {
+    fprintf(stderr, "ibv_query_port on port %u failed\n", config_->ib_port);
+    rc = 1;
+    goto register_memory_exit;
+  }
+  // allocate Protection Domain
+  pd_ = ibv_alloc_pd(ib_ctx_);
+  if (!pd_) {
+    fprintf(stderr, "ibv_alloc_pd failed\n");
+    rc = 1;
+    goto register_memory_exit;
+  }
+  // allocate the memory buffer that will hold the data
+  buf_ = new char[size]();
+  // register the memory buffer
+  mr_flags =
+      IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+  mr_ = ibv_reg_mr(pd_, buf_, size, mr_flags);
+  if (!mr_) {
+    fprintf(stderr, "ibv_reg_mr failed with mr_flags=0x%x\n", mr_flags);
+    rc = 1;
+    goto register_memory_exit;
+  }
+register_memory_exit:
+  if (dev_list) ibv_free_device_list(dev_list);
+  if (rc) {
+    // Error encountered, cleanup
+    DeregisterMemory();
+    return nullptr;
+  }
+  return buf_;
+}
+
+int VerbsTransport::DeregisterMemory() {
+  int rc = 0;
+  if (mr_ && ibv_dereg_mr(mr_)) {
+    fprintf(stderr, "failed to deregister MR\n");
+    rc = 1;
+  }
+  mr_ = nullptr;
+  delete[] buf_;
+  buf_ = nullptr;
+  if (pd_ && ibv_dealloc_pd(pd_)) {
+    fprintf(stderr, "failed to deallocate PD\n");
+    rc = 1;
+  }
+  pd_ = nullptr;
+  if (ib_ctx_ && ibv_close_device(ib_ctx_)) {
+    fprintf(stderr, "failed to close device context\n");
+    rc = 1;
+  }
+  ib_ctx_ = nullptr;
+  return rc;
+}
+
+dm_endpoint *VerbsTransport::Connect(int sock) {
+  int rc = 0;
+  auto *ep = new verbs_endpoint();
+  struct ibv_qp_init_attr qp_init_attr;
+  struct cm_con_data_t local_con_data;
+  struct cm_con_data_t remote_con_data;
+  struct cm_con_data_t tmp_con_data;
+  char temp_char;
+  union ibv_gid my_gid;
+  ep->cq = ibv_create_cq(ib_ctx_, config_->max_cqe, nullptr, nullptr, 0);
+  if (!ep->cq) {
+    fprintf(stderr, "failed to create CQ with %u entries\n", config_->max_cqe);
+    rc = 1;
+    goto connect_exit;
+  }
+  // create the Queue Pair
+  memset(&qp_init_attr, 0, sizeof(qp_init_attr));
+  qp_init_attr.qp_type = IBV_QPT_RC;
+  qp_init_attr.sq_sig_all = 1;
+  qp_init_attr.send_cq = ep->cq;
+  qp_init_attr.recv_cq = ep->cq;
+  qp_init_attr.cap.max_send_wr = config_->max_send_wr;
+  qp_init_attr.cap.max_recv_wr = config_->max_recv_wr;
+  qp_init_attr.cap.max_send_sge = 1;
+  qp_init_attr.cap.max_recv_sge = 1;
+  ep->qp = ibv_create_qp(pd_, &qp_init_attr);
+  if (!ep->qp) {
+    fprintf(stderr, "failed to create QP\n");
+    rc = 1;
+    goto connect_exit;
+  }
+  if (config_->gid_idx >= 0) {
+    rc = ibv_query_gid(ib_ctx_, config_->ib_port, config_->gid_idx, &my_gid);
+    if (rc) {
+      fprintf(stderr, "could not get gid for port %d, index %d\n",
+              config_->ib_port, config_->gid_idx);
+      goto connect_exit;
+    }
+  } else
+    memset(&my_gid, 0, sizeof my_gid);
+  // exchange using TCP sockets info required to connect QPs
+  local_con_data.addr = htonll((uintptr_t)buf_);
+  local_con_data.rkey = htonl(mr_->rkey);
+  local_con_data.qp_num = htonl(ep->qp->qp_num);
+  local_con_data.lid = htons(port_attr_.lid);
+  memcpy(local_con_data.gid, &my_gid, 16);
+  if (dm_sock_sync_data(sock, sizeof(struct cm_con_data_t),
+                        (char *)&local_con_data, (char *)&tmp_con_data) < 0) {
+    fprintf(stderr, "failed to exchange connection data between sides\n");
+    rc = 1;
+    goto connect_exit;
+  }
+  remote_con_data.addr = ntohll(tmp_con_data.addr);
+  remote_con_data.rkey = ntohl(tmp_con_data.rkey);
+  remote_con_data.qp_num = ntohl(tmp_con_data.qp_num);
+  remote_con_data.lid = ntohs(tmp_con_data.lid);
+  memcpy(remote_con_data.gid, tmp_con_data.gid, 16);
+  // save the remote side attributes, we will need it for the post SR
+  ep->remote_props = remote_con_data;
+  // modify the QP to init
+  rc = modify_qp_to_init(ep->qp);
+  if (rc) {
+    fprintf(stderr, "change QP state to INIT failed\n");
+    goto connect_exit;
+  }
+  // modify the QP to RTR
+  rc = modify_qp_to_rtr(ep->qp, remote_con_data.qp_num, remote_con_data.lid,
+                        remote_con_data.gid);
+  if (rc) {
+    fprintf(stderr, "failed to modify QP state to RTR\n");
+    goto connect_exit;
+  }
+  rc = modify_qp_to_rts(ep->qp);
+  if (rc) {
+    fprintf(stderr, "failed to modify QP state to RTR\n");
+    goto connect_exit;
+  }
+  // sync to make sure that both sides are in states that they can connect to
+  // prevent packet loose
+  if (dm_sock_sync_data(sock, 1, "Q",
+                        &temp_char)) {  // just send a dummy char back and forth
+    fprintf(stderr, "sync error after QPs are were moved to RTS\n");
+    rc = 1;
+  }
+connect_exit:
+  if (rc) {
+    Disconnect(ep);
+    return nullptr;
+  }
+  return ep;
+}
+
+int VerbsTransport::Disconnect(dm_endpoint *ep) {
+  if (ep == nullptr) return 0;
+  auto *vep = static_cast<verbs_endpoint *>(ep);
+  int rc = 0;
+  if (vep->qp && ibv_destroy_qp(vep->qp)) {
+    fprintf(stderr, "failed to destroy QP\n");
+    rc = 1;
+  }
+  if (vep->cq && ibv_destroy_cq(vep->cq)) {
+    fprintf(stderr, "failed to destroy CQ\n");
+    rc = 1;
+  }
+  delete vep;
+  return rc;
+}
+
+int VerbsTransport::PostSend(dm_endpoint *ep, dm_opcode opcode,
+                             size_t msg_size, long long local_offset,
+                             long long remote_offset, uint64_t wr_id) {
+  auto *vep = static_cast<verbs_endpoint *>(ep);
+  struct ibv_send_wr sr;
+  struct ibv_sge sge;
+  struct ibv_send_wr *bad_wr = nullptr;
+  int rc = 0;
+  // prepare the scatter/gather entry
+  memset(&sge, 0, sizeof(sge));
+  sge.addr = (uintptr_t)buf_ + local_offset;
+  sge.length = msg_size;
+  sge.lkey = mr_->lkey;
+  // prepare the send work request
+  memset(&sr, 0, sizeof(sr));
+  sr.next = nullptr;
+  sr.wr_id = wr_id;
+  sr.sg_list = &sge;
+  sr.num_sge = 1;
+  sr.send_flags = IBV_SEND_SIGNALED;
+  switch (opcode) {
+    case dm_opcode::kSend:
+      sr.opcode = IBV_WR_SEND;
+      break;
+    case dm_opcode::kRead:
+      sr.opcode = IBV_WR_RDMA_READ;
+      break;
+    case dm_opcode::kWrite:
+      sr.opcode = IBV_WR_RDMA_WRITE;
+      break;
+    default:
+      fprintf(stderr, "unsupported opcode for PostSend\n");
+      return 1;
+  }
+  if (opcode != dm_opcode::kSend) {
+    sr.wr.rdma.remote_addr = vep->remote_props.addr + remote_offset;
+    sr.wr.rdma.rkey = vep->remote_props.rkey;
+  }
+  // there is a Receive Request in the responder side, so we won't get any into
+  // RNR flow
+  rc = ibv_post_send(vep->qp, &sr, &bad_wr);
+  if (rc) fprintf(stderr, "failed to post SR\n");
+  return rc;
+}
+
+int VerbsTransport::PostRecv(dm_endpoint *ep, size_t msg_size,
+                             long long local_offset, uint64_t wr_id) {
+  auto *vep = static_cast<verbs_endpoint *>(ep);
+  struct ibv_recv_wr rr;
+  struct ibv_sge sge;
+  struct ibv_recv_wr *bad_wr;
+  int rc = 0;
+  // prepare the scatter/gather entry
+  memset(&sge, 0, sizeof(sge));
+  sge.addr = (uintptr_t)buf_ + local_offset;
+  sge.length = msg_size;
+  sge.lkey = mr_->lkey;
+  // prepare the receive work request
+  memset(&rr, 0, sizeof(rr));
+  rr.next = nullptr;
+  rr.wr_id = wr_id;
+  rr.sg_list = &sge;
+  rr.num_sge = 1;
+  // post the Receive Request to the RQ
+  rc = ibv_post_recv(vep->qp, &rr, &bad_wr);
+  if (rc) fprintf(stderr, "failed to post RR\n");
+  return rc;
+}
+
+int VerbsTransport::PollCompletion(dm_endpoint *ep, dm_completion *wc) {
+  auto *vep = static_cast<verbs_endpoint *>(ep);
+  struct ibv_wc ibwc;
+  int poll_result = ibv_poll_cq(vep->cq, 1, &ibwc);
+  if (poll_result <= 0) return poll_result;
+  wc->wr_id = ibwc.wr_id;
+  wc->status = ibwc.status == IBV_WC_SUCCESS ? 0 : ibwc.status;
+  wc->vendor_err = ibwc.vendor_err;
+  wc->byte_len = ibwc.byte_len;
+  switch (ibwc.opcode) {
+    case IBV_WC_RDMA_READ:
+      wc->opcode = dm_opcode::kRead;
+      break;
+    case IBV_WC_RDMA_WRITE:
+      wc->opcode = dm_opcode::kWrite;
+      break;
+    case IBV_WC_RECV:
+      wc->opcode = dm_opcode::kRecv;
+      break;
+    default:
+      wc->opcode = dm_opcode::kSend;
+      break;
+  }
+  return 1;
+}
+
+int VerbsTransport::modify_qp_to_init(struct ibv_qp *qp) {
+  struct ibv_qp_attr attr;
+  int flags;
+  int rc = 0;
+  memset(&attr, 0, sizeof(attr));
+  attr.qp_state = IBV_QPS_INIT;
+  attr.port_num = config_->ib_port;
+  attr.pkey_index = 0;
+  attr.qp_access_flags =
+      IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+  flags = IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS;
+  rc = ibv_modify_qp(qp, &attr, flags);
+  if (rc) fprintf(stderr, "failed to modify QP state to INIT\n");
+  return rc;
+}
+int VerbsTransport::modify_qp_to_rtr(struct ibv_qp *qp, uint32_t remote_qpn,
+                                     uint16_t dlid, uint8_t *dgid) {
+  struct ibv_qp_attr attr;
+  int flags;
+  int rc = 0;
+  memset(&attr, 0, sizeof(attr));
+  attr.qp_state = IBV_QPS_RTR;
+  attr.path_mtu = IBV_MTU_256;
+  attr.dest_qp_num = remote_qpn;
+  attr.rq_psn = 0;
+  attr.max_dest_rd_atomic = 1;
+  attr.min_rnr_timer = 0x12;
+  attr.ah_attr.is_global = 0;
+  attr.ah_attr.dlid = dlid;
+  attr.ah_attr.sl = 0;
+  attr.ah_attr.src_path_bits = 0;
+  attr.ah_attr.port_num = config_->ib_port;
+  if (config_->gid_idx >= 0) {
+    attr.ah_attr.is_global = 1;
+    attr.ah_attr.port_num = 1;
+    memcpy(&attr.ah_attr.grh.dgid, dgid, 16);
+    attr.ah_attr.grh.flow_label = 0;
+    attr.ah_attr.grh.hop_limit = 1;
+    attr.ah_attr.grh.sgid_index = config_->gid_idx;
+    attr.ah_attr.grh.traffic_class = 0;
+  }
+  flags = IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN |
+          IBV_QP_RQ_PSN | IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER;
+  rc = ibv_modify_qp(qp, &attr, flags);
+  if (rc) fprintf(stderr, "failed to modify QP state to RTR\n");
+  return rc;
+}
+int VerbsTransport::modify_qp_to_rts(struct ibv_qp *qp) {
+  struct ibv_qp_attr attr;
+  int flags;
+  int rc = 0;
+  memset(&attr, 0, sizeof(attr));
+  attr.qp_state = IBV_QPS_RTS;
+  attr.timeout = 0x12;
+  attr.retry_cnt = 6;
+  attr.rnr_retry = 0;
+  attr.sq_psn = 0;
+  attr.max_rd_atomic = 1;
+  flags = IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY |
+          IBV_QP_SQ_PSN | IBV_QP_MAX_QP_RD_ATOMIC;
+  rc = ibv_modify_qp(qp, &attr, flags);
+  if (rc) fprintf(stderr, "failed to modify QP state to RTS\n");
+  return rc;
+}
+
+}  // namespace
+
+DMTransport *NewVerbsTransport(const dm_transport_config *config) {
+  return new VerbsTransport(config);
+}
+
+std::string DefaultDMTransportName() {
+  const char *env = getenv("ROCKSDB_DM_TRANSPORT");
+  return env != nullptr ? env : "verbs";
+}
+
+DMTransport *NewDMTransport(const dm_transport_config *config,
+                            const std::string &name) {
+  std::string type = name.empty() ? DefaultDMTransportName() : name;
+  if (type == "shm") return NewShmTransport(config);
+  if (type != "verbs")
+    fprintf(stderr, "unknown dm transport %s, use verbs\n", type.c_str());
+  return NewVerbsTransport(config);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,161 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "rocksdb/dm_transport.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "port/port.h"
+#include "test_util/testharness.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Both ends of a shm connection live in this process, /proc/<pid>/fd works
+// the same for a peer that is ourselves.
+class DMShmTransportTest : public testing::Test {
+ protected:
+  static constexpr size_t kBufSize = 1 << 20;
+
+  void SetUp() override {
+    a_.reset(NewShmTransport(nullptr));
+    b_.reset(NewShmTransport(nullptr));
+    buf_a_ = a_->RegisterMemory(kBufSize);
+    buf_b_ = b_->RegisterMemory(kBufSize);
+    ASSERT_NE(nullptr, buf_a_);
+    ASSERT_NE(nullptr, buf_b_);
+    int socks[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, socks));
+    std::thread peer([&]() { ep_b_ = b_->Connect(socks[1]); });
+    ep_a_ = a_->Connect(socks[0]);
+    peer.join();
+    close(socks[0]);
+    close(socks[1]);
+    ASSERT_NE(nullptr, ep_a_);
+    ASSERT_NE(nullptr, ep_b_);
+  }
+
+  void TearDown() override {
+    a_->Disconnect(ep_a_);
+    b_->Disconnect(ep_b_);
+  }
+
+  // polls until one completion arrives, the shm transport never loses one
+  static dm_completion Poll(DMTransport *t, dm_endpoint *ep) {
+    dm_completion wc;
+    int ret;
+    while ((ret = t->PollCompletion(ep, &wc)) == 0) std::this_thread::yield();
+    EXPECT_EQ(1, ret);
+    return wc;
+  }
+
+  std::unique_ptr<DMTransport> a_;
+  std::unique_ptr<DMTransport> b_;
+  char *buf_a_ = nullptr;
+  char *buf_b_ = nullptr;
+  dm_endpoint *ep_a_ = nullptr;
+  dm_endpoint *ep_b_ = nullptr;
+};
+
+TEST_F(DMShmTransportTest, SendRecv) {
+  ASSERT_STREQ("shm", a_->Name());
+  ASSERT_EQ(0, b_->PostRecv(ep_b_, 64, 4096, 7));
+  memcpy(buf_a_ + 128, "hello memnode", 14);
+  ASSERT_EQ(0, a_->PostSend(ep_a_, dm_opcode::kSend, 14, 128, 0, 3));
+
+  dm_completion send_wc = Poll(a_.get(), ep_a_);
+  ASSERT_EQ(3u, send_wc.wr_id);
+  ASSERT_EQ(0, send_wc.status);
+  ASSERT_EQ(dm_opcode::kSend, send_wc.opcode);
+
+  dm_completion recv_wc = Poll(b_.get(), ep_b_);
+  ASSERT_EQ(7u, recv_wc.wr_id);
+  ASSERT_EQ(0, recv_wc.status);
+  ASSERT_EQ(14u, recv_wc.byte_len);
+  ASSERT_EQ(dm_opcode::kRecv, recv_wc.opcode);
+  ASSERT_STREQ("hello memnode", buf_b_ + 4096);
+
+  dm_completion wc;
+  ASSERT_EQ(0, a_->PollCompletion(ep_a_, &wc));
+  ASSERT_EQ(0, b_->PollCompletion(ep_b_, &wc));
+}
+
+TEST_F(DMShmTransportTest, SendLargerThanPostedRecv) {
+  ASSERT_EQ(0, b_->PostRecv(ep_b_, 8, 0, 1));
+  ASSERT_EQ(0, a_->PostSend(ep_a_, dm_opcode::kSend, 16, 0, 0, 2));
+  ASSERT_NE(0, Poll(a_.get(), ep_a_).status);
+  ASSERT_NE(0, Poll(b_.get(), ep_b_).status);
+}
+
+TEST_F(DMShmTransportTest, ReadWrite) {
+  memcpy(buf_a_ + 64, "written by a", 13);
+  ASSERT_EQ(0, a_->PostSend(ep_a_, dm_opcode::kWrite, 13, 64, 8192, 11));
+  dm_completion wc = Poll(a_.get(), ep_a_);
+  ASSERT_EQ(11u, wc.wr_id);
+  ASSERT_EQ(0, wc.status);
+  ASSERT_EQ(dm_opcode::kWrite, wc.opcode);
+  ASSERT_STREQ("written by a", buf_b_ + 8192);
+
+  memcpy(buf_b_ + kBufSize - 16, "read by a", 10);
+  ASSERT_EQ(0, a_->PostSend(ep_a_, dm_opcode::kRead, 10, 0, kBufSize - 16, 12));
+  wc = Poll(a_.get(), ep_a_);
+  ASSERT_EQ(12u, wc.wr_id);
+  ASSERT_EQ(0, wc.status);
+  ASSERT_EQ(dm_opcode::kRead, wc.opcode);
+  ASSERT_STREQ("read by a", buf_a_);
+
+  // one-sided operations never show up on the passive side
+  ASSERT_EQ(0, b_->PollCompletion(ep_b_, &wc));
+}
+
+TEST_F(DMShmTransportTest, OutOfBounds) {
+  ASSERT_EQ(1, a_->PostSend(ep_a_, dm_opcode::kWrite, 16, kBufSize - 8, 0, 1));
+  ASSERT_EQ(1, a_->PostSend(ep_a_, dm_opcode::kRead, 16, 0, kBufSize - 8, 1));
+  ASSERT_EQ(1, a_->PostSend(ep_a_, dm_opcode::kRead, 16, 0, -1, 1));
+  ASSERT_EQ(1, a_->PostSend(ep_a_, dm_opcode::kSend, 16, -1, 0, 1));
+  ASSERT_EQ(1, a_->PostSend(ep_a_, dm_opcode::kRecv, 16, 0, 0, 1));
+  ASSERT_EQ(1, b_->PostRecv(ep_b_, 16, kBufSize - 8, 1));
+  dm_completion wc;
+  ASSERT_EQ(0, a_->PollCompletion(ep_a_, &wc));
+}
+
+TEST_F(DMShmTransportTest, SendWithoutPostedRecv) {
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(0, a_->PostSend(ep_a_, dm_opcode::kSend, 8, 0, 0, 5));
+  dm_completion wc = Poll(a_.get(), ep_a_);
+  ASSERT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(2000));
+  ASSERT_EQ(5u, wc.wr_id);
+  ASSERT_NE(0, wc.status);
+  ASSERT_EQ(0, b_->PollCompletion(ep_b_, &wc));
+}
+
+TEST_F(DMShmTransportTest, LateRecvIsStillMatched) {
+  std::thread peer([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    b_->PostRecv(ep_b_, 8, 0, 9);
+  });
+  memcpy(buf_a_, "late", 5);
+  ASSERT_EQ(0, a_->PostSend(ep_a_, dm_opcode::kSend, 5, 0, 0, 4));
+  peer.join();
+  ASSERT_EQ(0, Poll(a_.get(), ep_a_).status);
+  dm_completion wc = Poll(b_.get(), ep_b_);
+  ASSERT_EQ(9u, wc.wr_id);
+  ASSERT_EQ(0, wc.status);
+  ASSERT_STREQ("late", buf_b_);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
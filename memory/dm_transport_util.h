@@ -0,0 +1,16 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include "rocksdb/rocksdb_namespace.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// exchange xfer_size bytes with the peer over a connected tcp socket,
+// returns 0 on success
+int dm_sock_sync_data(int sock, int xfer_size, const char *local_data,
+                      char *remote_data);
+
+}  // namespace ROCKSDB_NAMESPACE
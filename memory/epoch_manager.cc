@@ -0,0 +1,82 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#include "memory/epoch_manager.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace ROCKSDB_NAMESPACE {
+
+EpochManager::EpochManager() : slots_(new Slot[kSlots]) {}
+
+EpochManager::~EpochManager() {
+  std::lock_guard<std::mutex> lck(retired_mu_);
+  for (auto &r : retired_) r.second();
+  retired_.clear();
+}
+
+EpochManager::Guard EpochManager::Enter() {
+  // spread the threads over the slots, a taken slot costs a failed CAS
+  size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+  for (size_t i = 0;; i++) {
+    size_t slot = (start + i) % kSlots;
+    bool expected = false;
+    if (!slots_[slot].used.load(std::memory_order_relaxed) &&
+        slots_[slot].used.compare_exchange_strong(expected, true)) {
+      // seq_cst: a writer that misses this store has already unlinked
+      // what it retires before the reader loads anything
+      slots_[slot].epoch.store(epoch_.load());
+      return Guard(this, slot);
+    }
+    if (i > 0 && i % kSlots == 0) std::this_thread::yield();
+  }
+}
+
+void EpochManager::Leave(size_t slot) {
+  slots_[slot].epoch.store(kIdle, std::memory_order_release);
+  slots_[slot].used.store(false, std::memory_order_release);
+}
+
+uint64_t EpochManager::MinEpoch() const {
+  uint64_t min_epoch = kIdle;
+  for (size_t i = 0; i < kSlots; i++) {
+    min_epoch = std::min(min_epoch, slots_[i].epoch.load());
+  }
+  return min_epoch;
+}
+
+void EpochManager::Retire(std::function<void()> fn) {
+  {
+    std::lock_guard<std::mutex> lck(retired_mu_);
+    // readers entering from now on cannot reach what fn frees
+    retired_.emplace_back(epoch_.fetch_add(1), std::move(fn));
+  }
+  Reclaim();
+}
+
+size_t EpochManager::Reclaim() {
+  std::vector<std::function<void()>> ready;
+  size_t left = 0;
+  {
+    std::lock_guard<std::mutex> lck(retired_mu_);
+    if (retired_.empty()) return 0;
+    // a reader that entered at the retire epoch or before may still hold
+    // a pointer loaded before the object was unlinked
+    uint64_t min_epoch = MinEpoch();
+    auto it = std::partition(retired_.begin(), retired_.end(),
+                             [min_epoch](const auto &r) {
+                               return r.first >= min_epoch;
+                             });
+    for (auto r = it; r != retired_.end(); ++r) {
+      ready.push_back(std::move(r->second));
+    }
+    retired_.erase(it, retired_.end());
+    left = retired_.size();
+  }
+  for (auto &fn : ready) fn();
+  return left;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,83 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "rocksdb/rocksdb_namespace.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Epoch based reclamation for read-mostly structures.
+//
+// A reader enters before it loads a shared pointer and leaves once it no
+// longer uses what it reached through it. A writer unlinks an object so
+// that new readers cannot reach it and retires it with a function that
+// frees it. The function runs once every reader that was inside when the
+// object was retired has left, readers never wait for writers.
+class EpochManager {
+ public:
+  // readers inside at the same time, more wait for one to leave
+  static constexpr size_t kSlots = 512;
+
+  class Guard {
+   public:
+    Guard(Guard &&other) noexcept : mgr_(other.mgr_), slot_(other.slot_) {
+      other.mgr_ = nullptr;
+    }
+    Guard(const Guard &) = delete;
+    void operator=(const Guard &) = delete;
+    ~Guard() {
+      if (mgr_ != nullptr) mgr_->Leave(slot_);
+    }
+
+   private:
+    friend class EpochManager;
+    Guard(EpochManager *mgr, size_t slot) : mgr_(mgr), slot_(slot) {}
+    EpochManager *mgr_;
+    size_t slot_;
+  };
+
+  EpochManager();
+  // runs every function still retired, no reader may be inside
+  ~EpochManager();
+  EpochManager(const EpochManager &) = delete;
+  void operator=(const EpochManager &) = delete;
+
+  Guard Enter();
+  // fn runs after every reader inside now has left, at the latest on a
+  // later Retire() or Reclaim() call
+  void Retire(std::function<void()> fn);
+  // runs the retired functions no reader can still depend on, returns how
+  // many are left waiting
+  size_t Reclaim();
+
+ private:
+  static constexpr uint64_t kIdle = UINT64_MAX;
+
+  struct alignas(64) Slot {
+    std::atomic<bool> used{false};
+    // epoch the reader entered at, kIdle while the slot is free
+    std::atomic<uint64_t> epoch{kIdle};
+  };
+
+  void Leave(size_t slot);
+  uint64_t MinEpoch() const;
+
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<uint64_t> epoch_{1};
+  std::mutex retired_mu_;
+  // functions with the epoch they were retired at
+  std::vector<std::pair<uint64_t, std::function<void()>>> retired_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
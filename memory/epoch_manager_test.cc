@@ -0,0 +1,173 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memory/epoch_manager.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "port/port.h"
+#include "test_util/testharness.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+class EpochManagerTest : public testing::Test {};
+
+TEST_F(EpochManagerTest, RetireWithoutReaders) {
+  EpochManager em;
+  int runs = 0;
+  em.Retire([&]() { runs++; });
+  em.Retire([&]() { runs++; });
+  ASSERT_EQ(0U, em.Reclaim());
+  ASSERT_EQ(2, runs);
+}
+
+TEST_F(EpochManagerTest, ReaderHoldsRetired) {
+  EpochManager em;
+  bool freed = false;
+  {
+    auto guard = em.Enter();
+    em.Retire([&]() { freed = true; });
+    // the reader entered before the retire and may still use the object
+    ASSERT_EQ(1U, em.Reclaim());
+    ASSERT_FALSE(freed);
+    ASSERT_EQ(1U, em.Reclaim());
+    ASSERT_FALSE(freed);
+  }
+  ASSERT_EQ(0U, em.Reclaim());
+  ASSERT_TRUE(freed);
+}
+
+TEST_F(EpochManagerTest, LaterReaderDoesNotHold) {
+  EpochManager em;
+  bool first = false;
+  bool second = false;
+  auto old_reader = std::make_unique<EpochManager::Guard>(em.Enter());
+  em.Retire([&]() { first = true; });
+  {
+    // entered after the retire, the object was unlinked already
+    auto guard = em.Enter();
+    old_reader.reset();
+    ASSERT_EQ(0U, em.Reclaim());
+    ASSERT_TRUE(first);
+    em.Retire([&]() { second = true; });
+    ASSERT_EQ(1U, em.Reclaim());
+    ASSERT_FALSE(second);
+  }
+  ASSERT_EQ(0U, em.Reclaim());
+  ASSERT_TRUE(second);
+}
+
+TEST_F(EpochManagerTest, MovedGuardLeavesOnce) {
+  EpochManager em;
+  bool freed = false;
+  {
+    auto guard = em.Enter();
+    EpochManager::Guard moved(std::move(guard));
+    em.Retire([&]() { freed = true; });
+    ASSERT_EQ(1U, em.Reclaim());
+  }
+  ASSERT_EQ(0U, em.Reclaim());
+  ASSERT_TRUE(freed);
+}
+
+TEST_F(EpochManagerTest, DestructorRunsRetired) {
+  bool freed = false;
+  {
+    EpochManager em;
+    {
+      auto guard = em.Enter();
+      em.Retire([&]() { freed = true; });
+    }
+  }
+  ASSERT_TRUE(freed);
+}
+
+TEST_F(EpochManagerTest, ManyReaders) {
+  EpochManager em;
+  // every slot taken, a retire waits for the last reader to leave
+  std::vector<EpochManager::Guard> guards;
+  for (size_t i = 0; i < EpochManager::kSlots; i++) {
+    guards.push_back(em.Enter());
+  }
+  bool freed = false;
+  em.Retire([&]() { freed = true; });
+  while (guards.size() > 1) {
+    guards.pop_back();
+    ASSERT_EQ(1U, em.Reclaim());
+  }
+  ASSERT_FALSE(freed);
+  guards.clear();
+  ASSERT_EQ(0U, em.Reclaim());
+  ASSERT_TRUE(freed);
+}
+
+TEST_F(EpochManagerTest, ConcurrentReadersAndWriter) {
+  struct Obj {
+    std::atomic<bool> alive{true};
+  };
+  using Table = std::unordered_map<int, Obj*>;
+  std::atomic<size_t> freed{0};
+  std::atomic<bool> use_after_free{false};
+  const int kWrites = 20000;
+  {
+    EpochManager em;
+    std::atomic<Table*> table{new Table()};
+    std::atomic<bool> stop{false};
+    std::vector<port::Thread> readers;
+    for (int r = 0; r < 4; r++) {
+      readers.emplace_back([&]() {
+        while (!stop.load()) {
+          auto guard = em.Enter();
+          for (auto& entry : *table.load()) {
+            if (!entry.second->alive.load()) use_after_free = true;
+          }
+        }
+      });
+    }
+    // copy on write, every write drops the oldest entry
+    for (int i = 0; i < kWrites; i++) {
+      Table* cur = table.load();
+      Table* next = new Table(*cur);
+      (*next)[i] = new Obj();
+      Obj* victim = nullptr;
+      if (i >= 8) {
+        victim = (*next)[i - 8];
+        next->erase(i - 8);
+      }
+      table.store(next);
+      em.Retire([cur]() { delete cur; });
+      if (victim != nullptr) {
+        em.Retire([victim, &freed]() {
+          victim->alive = false;
+          delete victim;
+          freed++;
+        });
+      }
+    }
+    stop = true;
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    ASSERT_EQ(0U, em.Reclaim());
+    for (auto& entry : *table.load()) {
+      delete entry.second;
+    }
+    delete table.load();
+  }
+  ASSERT_FALSE(use_after_free.load());
+  ASSERT_EQ(static_cast<size_t>(kWrites - 8), freed.load());
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
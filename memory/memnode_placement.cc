@@ -0,0 +1,145 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#include "memory/memnode_placement.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+#include "rocksdb/dm_transport.h"
+#include "rocksdb/logger.hpp"
+
+namespace ROCKSDB_NAMESPACE {
+
+std::vector<std::pair<std::string, int>> ParseMemNodes(
+    const std::vector<std::string> &list) {
+  std::vector<std::pair<std::string, int>> memnodes;
+  for (const std::string &item : list) {
+    size_t colon = item.rfind(':');
+    int port =
+        colon == std::string::npos ? 0 : atoi(item.c_str() + colon + 1);
+    if (colon == 0 || port <= 0) {
+      DM_LOG_WARN("bad memnode ", item, " in DBOptions::memnodes, skipped");
+      continue;
+    }
+    memnodes.emplace_back(item.substr(0, colon), port);
+  }
+  if (memnodes.empty()) {
+    // shm transport can only reach a memnode on this host
+    memnodes.emplace_back(
+        DefaultDMTransportName() == "shm" ? "127.0.0.1" : "10.10.1.1", 9091);
+  }
+  return memnodes;
+}
+
+MemNodePlacement::MemNodePlacement(size_t num_memnodes,
+                                   uint64_t memtable_bytes)
+    : memtable_bytes_(std::max<uint64_t>(memtable_bytes, 1)),
+      nodes_(num_memnodes) {
+  assert(num_memnodes > 0);
+}
+
+bool MemNodePlacement::NeedsRefresh(uint64_t now_micros) const {
+  std::lock_guard<std::mutex> lck(mu_);
+  return now_micros - refreshed_micros_ >= kRefreshMicros;
+}
+
+void MemNodePlacement::UpdateCapacity(size_t memnode,
+                                      const memnode_capacity &cap,
+                                      uint64_t now_micros) {
+  std::lock_guard<std::mutex> lck(mu_);
+  assert(memnode < nodes_.size());
+  Node &n = nodes_[memnode];
+  n.capacity = cap.capacity;
+  n.free = cap.free;
+  // transfers still in flight may not have pinned their memory yet
+  n.placed = n.inflight;
+  refreshed_micros_ = now_micros;
+}
+
+size_t MemNodePlacement::Place() {
+  std::lock_guard<std::mutex> lck(mu_);
+  auto free_of = [](const Node &n) {
+    return n.free > n.placed ? n.free - n.placed : 0;
+  };
+  // memtables already heading to a memnode
+  auto queued_of = [this](const Node &n) {
+    return n.inflight / memtable_bytes_;
+  };
+  // a memnode that never reported is assumed to have room
+  auto fits = [&](const Node &n) {
+    return n.capacity == 0 || free_of(n) >= memtable_bytes_;
+  };
+  auto better = [&](const Node &a, const Node &b) {
+    if (fits(a) != fits(b)) return fits(a);
+    if (fits(a) && queued_of(a) != queued_of(b)) {
+      return queued_of(a) < queued_of(b);
+    }
+    return free_of(a) > free_of(b);
+  };
+  size_t best = 0;
+  for (size_t i = 1; i < nodes_.size(); i++) {
+    if (better(nodes_[i], nodes_[best])) best = i;
+  }
+  if (!fits(nodes_[best])) {
+    return kNoMemNode;
+  }
+  nodes_[best].placed += memtable_bytes_;
+  nodes_[best].inflight += memtable_bytes_;
+  return best;
+}
+
+void MemNodePlacement::TransferDone(size_t memnode) {
+  std::lock_guard<std::mutex> lck(mu_);
+  assert(memnode < nodes_.size());
+  Node &n = nodes_[memnode];
+  n.inflight -= std::min(n.inflight, memtable_bytes_);
+}
+
+uint64_t MemNodePlacement::HeadroomLocked() const {
+  uint64_t headroom = 0;
+  for (const Node &n : nodes_) {
+    if (n.capacity == 0) {
+      return UINT64_MAX;
+    }
+    if (n.free > n.placed) {
+      headroom += (n.free - n.placed) / memtable_bytes_;
+    }
+  }
+  return headroom;
+}
+
+uint64_t MemNodePlacement::Headroom() const {
+  std::lock_guard<std::mutex> lck(mu_);
+  return HeadroomLocked();
+}
+
+void SpilledMemTables::Add(uint64_t id) {
+  std::lock_guard<std::mutex> lck(mu_);
+  ids_.insert(id);
+  oldest_.store(*ids_.begin(), std::memory_order_release);
+}
+
+void SpilledMemTables::Remove(uint64_t id) {
+  std::lock_guard<std::mutex> lck(mu_);
+  ids_.erase(id);
+  oldest_.store(ids_.empty() ? UINT64_MAX : *ids_.begin(),
+                std::memory_order_release);
+}
+
+MemNodePlacement::Pressure MemNodePlacement::GetPressure() const {
+  std::lock_guard<std::mutex> lck(mu_);
+  uint64_t headroom = HeadroomLocked();
+  if (headroom == 0) {
+    return Pressure::kFull;
+  } else if (headroom < kDelayHeadroom) {
+    return Pressure::kDelay;
+  } else if (headroom < kFlushHeadroom) {
+    return Pressure::kFlush;
+  }
+  return Pressure::kNone;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,104 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rocksdb/remote_flush_service.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// memnodes a compute node offloads memtables to, from DBOptions::memnodes
+// ("ip:port" each), the memnode of the configured transport if it is empty
+std::vector<std::pair<std::string, int>> ParseMemNodes(
+    const std::vector<std::string> &memnodes);
+
+// Picks the memnode a new memtable of a column family is offloaded to.
+//
+// A memnode is charged for a memtable from placement until the transfer is
+// done, the bytes still to be written count as load on its NIC and come
+// off the free capacity it last reported. A memtable goes to the memnode
+// with the fewest such transfers that still has room for it, the one with
+// the most free memory among those, so writes spread over every NIC. When
+// none has room the memtable is refused and stays on the compute node.
+//
+// The room left on all memnodes, counted in memtables, sets the pressure
+// the column family reacts to: flushes of its offloaded memtables are
+// requested first, then writes are delayed, and refused memtables are kept
+// local until the memnodes drained.
+class MemNodePlacement {
+ public:
+  enum class Pressure { kNone, kFlush, kDelay, kFull };
+
+  // capacity reports older than this are refreshed before placing
+  static constexpr uint64_t kRefreshMicros = 100 * 1000;
+  // memtables the memnodes have room for below which offloaded memtables
+  // are flushed early, and below which writes are delayed
+  static constexpr uint64_t kFlushHeadroom = 4;
+  static constexpr uint64_t kDelayHeadroom = 2;
+  // Place() result when no memnode has room
+  static constexpr size_t kNoMemNode = SIZE_MAX;
+
+  // memtable_bytes: what an offloaded memtable takes on a memnode
+  MemNodePlacement(size_t num_memnodes, uint64_t memtable_bytes);
+  MemNodePlacement(const MemNodePlacement &) = delete;
+  void operator=(const MemNodePlacement &) = delete;
+
+  size_t size() const { return nodes_.size(); }
+  bool NeedsRefresh(uint64_t now_micros) const;
+  // what memnode reported, transfers still in flight are charged on top
+  void UpdateCapacity(size_t memnode, const memnode_capacity &cap,
+                      uint64_t now_micros);
+  // memnode a new memtable goes to, charged until TransferDone(), or
+  // kNoMemNode
+  size_t Place();
+  void TransferDone(size_t memnode);
+  Pressure GetPressure() const;
+  // memtables that still fit on the memnodes as last reported, SIZE_MAX
+  // while one has never reported
+  uint64_t Headroom() const;
+
+ private:
+  uint64_t HeadroomLocked() const;
+
+  struct Node {
+    uint64_t capacity = 0;
+    uint64_t free = 0;
+    // bytes placed on the memnode since its last capacity report
+    uint64_t placed = 0;
+    // bytes placed and not transferred yet
+    uint64_t inflight = 0;
+  };
+
+  const uint64_t memtable_bytes_;
+  mutable std::mutex mu_;
+  std::vector<Node> nodes_;
+  uint64_t refreshed_micros_ = 0;
+};
+
+// Ids of the memtables of a column family kept on the compute node because
+// no memnode had room for them, from construction until deleted.
+class SpilledMemTables {
+ public:
+  void Add(uint64_t id);
+  void Remove(uint64_t id);
+  bool empty() const { return Oldest() == UINT64_MAX; }
+  // UINT64_MAX if none is left, read without a lock
+  uint64_t Oldest() const { return oldest_.load(std::memory_order_acquire); }
+
+ private:
+  std::mutex mu_;
+  std::set<uint64_t> ids_;
+  std::atomic<uint64_t> oldest_{UINT64_MAX};
+};
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,123 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memory/memnode_placement.h"
+
+#include <string>
+#include <vector>
+
+#include "port/port.h"
+#include "test_util/testharness.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+class MemNodePlacementTest : public testing::Test {
+ protected:
+  static constexpr uint64_t kMemTable = 64 << 20;
+
+  static memnode_capacity Cap(uint64_t capacity, uint64_t free) {
+    return memnode_capacity{capacity, free, free};
+  }
+};
+
+TEST_F(MemNodePlacementTest, ParseMemNodes) {
+  auto memnodes = ParseMemNodes({"10.0.0.1:9091", "host-b:9092"});
+  ASSERT_EQ(2u, memnodes.size());
+  ASSERT_EQ("10.0.0.1", memnodes[0].first);
+  ASSERT_EQ(9091, memnodes[0].second);
+  ASSERT_EQ("host-b", memnodes[1].first);
+  ASSERT_EQ(9092, memnodes[1].second);
+
+  // malformed entries are skipped, the rest is kept in order
+  memnodes = ParseMemNodes({"nohost", ":9091", "a:0", "a:x", "b:9093"});
+  ASSERT_EQ(1u, memnodes.size());
+  ASSERT_EQ("b", memnodes[0].first);
+  ASSERT_EQ(9093, memnodes[0].second);
+
+  // nothing usable falls back to the memnode of the transport
+  memnodes = ParseMemNodes({});
+  ASSERT_EQ(1u, memnodes.size());
+  ASSERT_EQ(9091, memnodes[0].second);
+  ASSERT_EQ(memnodes, ParseMemNodes({"bad"}));
+}
+
+TEST_F(MemNodePlacementTest, UnreportedMemNodesTakeTurns) {
+  MemNodePlacement placement(3, kMemTable);
+  ASSERT_EQ(3u, placement.size());
+  ASSERT_EQ(UINT64_MAX, placement.Headroom());
+  ASSERT_EQ(MemNodePlacement::Pressure::kNone, placement.GetPressure());
+  // the fewest transfers in flight wins
+  ASSERT_EQ(0u, placement.Place());
+  ASSERT_EQ(1u, placement.Place());
+  ASSERT_EQ(2u, placement.Place());
+  placement.TransferDone(1);
+  ASSERT_EQ(1u, placement.Place());
+}
+
+TEST_F(MemNodePlacementTest, MostFreeMemory) {
+  MemNodePlacement placement(2, kMemTable);
+  placement.UpdateCapacity(0, Cap(16 * kMemTable, 4 * kMemTable), 1);
+  placement.UpdateCapacity(1, Cap(16 * kMemTable, 8 * kMemTable), 1);
+  ASSERT_EQ(12u, placement.Headroom());
+
+  ASSERT_EQ(1u, placement.Place());
+  placement.TransferDone(1);
+  // the transfer is charged until the next report
+  ASSERT_EQ(11u, placement.Headroom());
+  ASSERT_EQ(1u, placement.Place());
+  placement.TransferDone(1);
+  placement.UpdateCapacity(1, Cap(16 * kMemTable, 2 * kMemTable), 2);
+  ASSERT_EQ(0u, placement.Place());
+}
+
+TEST_F(MemNodePlacementTest, FullMemNodesRefuse) {
+  MemNodePlacement placement(2, kMemTable);
+  placement.UpdateCapacity(0, Cap(8 * kMemTable, kMemTable), 1);
+  placement.UpdateCapacity(1, Cap(8 * kMemTable, kMemTable / 2), 1);
+  ASSERT_EQ(1u, placement.Headroom());
+  ASSERT_EQ(MemNodePlacement::Pressure::kDelay, placement.GetPressure());
+
+  ASSERT_EQ(0u, placement.Place());
+  ASSERT_EQ(MemNodePlacement::Pressure::kFull, placement.GetPressure());
+  ASSERT_EQ(MemNodePlacement::kNoMemNode, placement.Place());
+
+  // a report after the transfers finished frees the memnodes up again
+  placement.TransferDone(0);
+  placement.UpdateCapacity(0, Cap(8 * kMemTable, 5 * kMemTable), 2);
+  ASSERT_EQ(MemNodePlacement::Pressure::kNone, placement.GetPressure());
+  ASSERT_EQ(0u, placement.Place());
+}
+
+TEST_F(MemNodePlacementTest, Pressure) {
+  MemNodePlacement placement(1, kMemTable);
+  placement.UpdateCapacity(
+      0, Cap(16 * kMemTable, MemNodePlacement::kFlushHeadroom * kMemTable), 1);
+  ASSERT_EQ(MemNodePlacement::Pressure::kNone, placement.GetPressure());
+  placement.UpdateCapacity(
+      0, Cap(16 * kMemTable, MemNodePlacement::kDelayHeadroom * kMemTable), 2);
+  ASSERT_EQ(MemNodePlacement::Pressure::kFlush, placement.GetPressure());
+  placement.UpdateCapacity(0, Cap(16 * kMemTable, kMemTable), 3);
+  ASSERT_EQ(MemNodePlacement::Pressure::kDelay, placement.GetPressure());
+  placement.UpdateCapacity(0, Cap(16 * kMemTable, 0), 4);
+  ASSERT_EQ(MemNodePlacement::Pressure::kFull, placement.GetPressure());
+}
+
+TEST_F(MemNodePlacementTest, NeedsRefresh) {
+  MemNodePlacement placement(1, kMemTable);
+  ASSERT_TRUE(placement.NeedsRefresh(MemNodePlacement::kRefreshMicros));
+  placement.UpdateCapacity(0, Cap(kMemTable, kMemTable), 1000);
+  ASSERT_FALSE(placement.NeedsRefresh(1000));
+  ASSERT_FALSE(
+      placement.NeedsRefresh(1000 + MemNodePlacement::kRefreshMicros - 1));
+  ASSERT_TRUE(placement.NeedsRefresh(1000 + MemNodePlacement::kRefreshMicros));
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,83 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#include "memory/memtable_point_index.h"
+
+#include <memory>
+#include <mutex>
+
+#include "db/dbformat.h"
+#include "memory/remote_memtable_service.h"
+#include "rocksdb/memtablerep.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+MemTablePointIndex::Key MemTablePointIndex::MakeKey(uint32_t cf_id,
+                                                    const Slice &user_key) {
+  return Key{cf_id, Hash64(user_key.data(), user_key.size(), cf_id)};
+}
+
+void MemTablePointIndex::Add(const RemoteMemTable *rmem, bool newest) {
+  const uint32_t cf_id = static_cast<uint32_t>(rmem->id >> 32);
+  std::unique_ptr<MemTableRep::Iterator> iter(rmem->memtable->GetIterator());
+  Slice prev;
+  bool has_prev = false;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    const char *entry = iter->key();
+    Slice ikey = GetLengthPrefixedSlice(entry);
+    Slice user_key = ExtractUserKey(ikey);
+    // versions of a key are adjacent, the first is the newest
+    if (has_prev && user_key == prev) continue;
+    prev = user_key;
+    has_prev = true;
+    ValueType type = ExtractValueType(ikey);
+    bool final = type == kTypeValue || type == kTypeDeletion ||
+                 type == kTypeSingleDeletion ||
+                 type == kTypeDeletionWithTimestamp;
+
+    Key key = MakeKey(cf_id, user_key);
+    Shard &shard = shard_of(key);
+    std::lock_guard<SpinMutex> lock(shard.mutex);
+    auto it = shard.slots.find(key);
+    if (it == shard.slots.end()) {
+      // an older memtable cannot tell whether a newer one holds the key
+      if (newest) shard.slots.emplace(key, Slot{rmem->id, entry, final});
+    } else if (it->second.mixed_id < rmem->id) {
+      it->second = Slot{rmem->id, entry, final};
+    }
+  }
+}
+
+void MemTablePointIndex::Remove(const RemoteMemTable *rmem) {
+  const uint32_t cf_id = static_cast<uint32_t>(rmem->id >> 32);
+  std::unique_ptr<MemTableRep::Iterator> iter(rmem->memtable->GetIterator());
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    Slice user_key = ExtractUserKey(GetLengthPrefixedSlice(iter->key()));
+    Key key = MakeKey(cf_id, user_key);
+    Shard &shard = shard_of(key);
+    std::lock_guard<SpinMutex> lock(shard.mutex);
+    auto it = shard.slots.find(key);
+    if (it != shard.slots.end() && it->second.mixed_id == rmem->id) {
+      shard.slots.erase(it);
+    }
+  }
+}
+
+bool MemTablePointIndex::Lookup(uint32_t cf_id, const Slice &user_key,
+                                uint64_t *mixed_id, const char **entry,
+                                bool *final) const {
+  Key key = MakeKey(cf_id, user_key);
+  const Shard &shard = shard_of(key);
+  std::lock_guard<SpinMutex> lock(shard.mutex);
+  auto it = shard.slots.find(key);
+  if (it == shard.slots.end()) return false;
+  *mixed_id = it->second.mixed_id;
+  *entry = it->second.entry;
+  *final = it->second.final;
+  return true;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
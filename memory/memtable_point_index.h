@@ -0,0 +1,83 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "rocksdb/slice.h"
+#include "util/mutexlock.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+struct RemoteMemTable;
+
+// Newest entry of each user key over the memtables rebuilt on a memnode,
+// so a delegated Get is answered with one probe instead of a skiplist
+// search in every memtable it names.
+//
+// A slot stands for the user keys of a column family that hash alike. It
+// holds the entry of one of them from memtable id, and no registered
+// memtable of that column family with a larger id holds any of them. A
+// memtable that is not the newest of its column family only takes over
+// slots of smaller ids, a slot is dropped with its memtable and then
+// stays absent until a newer memtable sets it again.
+class MemTablePointIndex {
+ public:
+  static constexpr size_t kShards = 64;
+
+  MemTablePointIndex() = default;
+  MemTablePointIndex(const MemTablePointIndex &) = delete;
+  void operator=(const MemTablePointIndex &) = delete;
+
+  // newest: no registered memtable of the column family of rmem has a
+  // larger id, the caller serializes Add() and Remove()
+  void Add(const RemoteMemTable *rmem, bool newest);
+  // drops the slots that still refer to rmem
+  void Remove(const RemoteMemTable *rmem);
+
+  // false if no slot covers user_key, otherwise the memtable and the entry
+  // of the slot, which may be of another key with the same hash. final is
+  // false if that entry is a merge operand
+  bool Lookup(uint32_t cf_id, const Slice &user_key, uint64_t *mixed_id,
+              const char **entry, bool *final) const;
+
+ private:
+  struct Key {
+    uint32_t cf_id;
+    uint64_t hash;
+    bool operator==(const Key &other) const {
+      return cf_id == other.cf_id && hash == other.hash;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      return static_cast<size_t>(key.hash);
+    }
+  };
+  struct Slot {
+    uint64_t mixed_id;
+    const char *entry;
+    bool final;
+  };
+  struct Shard {
+    mutable SpinMutex mutex;
+    std::unordered_map<Key, Slot, KeyHash> slots;
+  };
+
+  static Key MakeKey(uint32_t cf_id, const Slice &user_key);
+  // the low bits pick the bucket inside the shard
+  Shard &shard_of(const Key &key) {
+    return shards_[(key.hash >> 32) % kShards];
+  }
+  const Shard &shard_of(const Key &key) const {
+    return shards_[(key.hash >> 32) % kShards];
+  }
+
+  Shard shards_[kShards];
+};
+
+}  // namespace ROCKSDB_NAMESPACE
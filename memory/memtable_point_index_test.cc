@@ -0,0 +1,367 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memory/memtable_point_index.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "memory/remote_memtable_service.h"
+#include "rocksdb/comparator.h"
+#include "rocksdb/memtablerep.h"
+#include "test_util/testharness.h"
+#include "util/coding.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+
+// Sorted entries in the MemTable::Add() format, enough of a rep for the
+// index to iterate and for the skiplist walk of a delegated get.
+class SortedRep : public MemTableRep {
+ public:
+  explicit SortedRep(const InternalKeyComparator& icmp)
+      : MemTableRep(nullptr), icmp_(icmp) {}
+
+  void Add(const Slice& user_key, SequenceNumber seq, ValueType type,
+           const Slice& value) {
+    std::string ikey = user_key.ToString();
+    PutFixed64(&ikey, PackSequenceAndType(seq, type));
+    std::string entry;
+    PutLengthPrefixedSlice(&entry, ikey);
+    PutLengthPrefixedSlice(&entry, value);
+    entries_.emplace_back(new std::string(std::move(entry)));
+    std::sort(entries_.begin(), entries_.end(),
+              [this](const std::unique_ptr<std::string>& a,
+                     const std::unique_ptr<std::string>& b) {
+                return Compare(a->data(), GetLengthPrefixedSlice(b->data())) <
+                       0;
+              });
+  }
+
+  void Insert(KeyHandle /*handle*/) override { assert(false); }
+  bool Contains(const char* /*key*/) const override { return false; }
+  size_t ApproximateMemoryUsage() override { return 0; }
+
+  class Iter : public MemTableRep::Iterator {
+   public:
+    explicit Iter(const SortedRep* rep) : rep_(rep) {}
+    bool Valid() const override { return pos_ < rep_->entries_.size(); }
+    const char* key() const override {
+      return rep_->entries_[pos_]->data();
+    }
+    void Next() override { pos_++; }
+    void Prev() override {
+      pos_ = pos_ == 0 ? rep_->entries_.size() : pos_ - 1;
+    }
+    void Seek(const Slice& internal_key, const char* /*mkey*/) override {
+      pos_ = 0;
+      while (Valid() && rep_->Compare(key(), internal_key) < 0) pos_++;
+    }
+    void SeekForPrev(const Slice& internal_key, const char* mkey) override {
+      Seek(internal_key, mkey);
+      if (!Valid() || rep_->Compare(key(), internal_key) > 0) Prev();
+    }
+    void SeekToFirst() override { pos_ = 0; }
+    void SeekToLast() override {
+      pos_ = rep_->entries_.empty() ? 0 : rep_->entries_.size() - 1;
+    }
+
+   private:
+    const SortedRep* rep_;
+    size_t pos_ = 0;
+  };
+  MemTableRep::Iterator* GetIterator(Arena* /*arena*/) override {
+    return new Iter(this);
+  }
+
+ private:
+  int Compare(const char* entry, const Slice& internal_key) const {
+    return icmp_.Compare(GetLengthPrefixedSlice(entry), internal_key);
+  }
+
+  const InternalKeyComparator& icmp_;
+  std::vector<std::unique_ptr<std::string>> entries_;
+};
+
+}  // namespace
+
+class MemTablePointIndexTest : public testing::Test {
+ protected:
+  MemTablePointIndexTest() : icmp_(BytewiseComparator()) {}
+
+  static uint64_t MixedId(uint32_t cf_id, uint32_t id) {
+    return (static_cast<uint64_t>(cf_id) << 32) | id;
+  }
+
+  // rebuilt memtable id of column family cf_id
+  SortedRep* NewMemTable(uint32_t cf_id, uint32_t id) {
+    reps_.emplace_back(new SortedRep(icmp_));
+    rmems_.emplace_back(new RemoteMemTable());
+    rmems_.back()->id = MixedId(cf_id, id);
+    rmems_.back()->memtable = reps_.back().get();
+    return reps_.back().get();
+  }
+  const RemoteMemTable* rmem(size_t i) const { return rmems_[i].get(); }
+
+  // the internal key of the slot for user_key, empty if there is none
+  std::string Lookup(uint32_t cf_id, const Slice& user_key,
+                     uint64_t* mixed_id = nullptr, bool* final = nullptr,
+                     const char** entry = nullptr) {
+    uint64_t id = 0;
+    const char* e = nullptr;
+    bool f = false;
+    if (!index_.Lookup(cf_id, user_key, &id, &e, &f)) return "";
+    if (mixed_id != nullptr) *mixed_id = id;
+    if (final != nullptr) *final = f;
+    if (entry != nullptr) *entry = e;
+    return GetLengthPrefixedSlice(e).ToString();
+  }
+  static std::string IKey(const Slice& user_key, SequenceNumber seq,
+                          ValueType type) {
+    std::string ikey = user_key.ToString();
+    PutFixed64(&ikey, PackSequenceAndType(seq, type));
+    return ikey;
+  }
+
+  // a delegated get of user_key at snapshot seq
+  struct DelegatedGet {
+    explicit DelegatedGet(const Slice& user_key, SequenceNumber seq) {
+      LookupKey lkey(user_key, seq);
+      Slice mkey = lkey.memtable_key();
+      buf.assign(imm_read_req_v2::record_size(mkey.size(), 0, 0) + 8, '\0');
+      req = reinterpret_cast<imm_read_req_v2*>(&buf[0]);
+      req->timestamp_size_ = -1;
+      req->memtable_key_len = static_cast<uint32_t>(mkey.size());
+      memcpy(req->key(), mkey.data(), mkey.size());
+      res.status_code = -1;
+      res.found_final_value = false;
+      res.seq = kMaxSequenceNumber;
+      res.base_seq = kMaxSequenceNumber;
+      res.value = nullptr;
+      res.value_size = 0;
+    }
+    std::string value() const { return std::string(res.value, res.value_size); }
+
+    std::string buf;
+    imm_read_req_v2* req;
+    imm_read_result res;
+  };
+
+  InternalKeyComparator icmp_;
+  std::vector<std::unique_ptr<SortedRep>> reps_;
+  std::vector<std::unique_ptr<RemoteMemTable>> rmems_;
+  MemTablePointIndex index_;
+};
+
+TEST_F(MemTablePointIndexTest, NewestVersionOfEachKey) {
+  SortedRep* m = NewMemTable(1, 10);
+  m->Add("k1", 5, kTypeValue, "v1");
+  m->Add("k1", 9, kTypeValue, "v2");
+  m->Add("k2", 3, kTypeValue, "v3");
+  m->Add("k3", 4, kTypeMerge, "op");
+  index_.Add(rmem(0), true);
+
+  uint64_t id = 0;
+  bool final = false;
+  ASSERT_EQ(IKey("k1", 9, kTypeValue), Lookup(1, "k1", &id, &final));
+  ASSERT_EQ(MixedId(1, 10), id);
+  ASSERT_TRUE(final);
+  ASSERT_EQ(IKey("k2", 3, kTypeValue), Lookup(1, "k2"));
+  // a merge operand is indexed but does not end a lookup
+  ASSERT_EQ(IKey("k3", 4, kTypeMerge), Lookup(1, "k3", &id, &final));
+  ASSERT_FALSE(final);
+  ASSERT_EQ("", Lookup(1, "k4"));
+  // column families do not share slots
+  ASSERT_EQ("", Lookup(2, "k1"));
+}
+
+TEST_F(MemTablePointIndexTest, Overwrites) {
+  SortedRep* older = NewMemTable(1, 10);
+  older->Add("k1", 5, kTypeValue, "v1");
+  older->Add("k2", 6, kTypeValue, "v2");
+  index_.Add(rmem(0), true);
+  SortedRep* newer = NewMemTable(1, 20);
+  newer->Add("k1", 15, kTypeValue, "v3");
+  newer->Add("k3", 16, kTypeDeletion, "");
+  index_.Add(rmem(1), true);
+
+  uint64_t id = 0;
+  bool final = false;
+  ASSERT_EQ(IKey("k1", 15, kTypeValue), Lookup(1, "k1", &id));
+  ASSERT_EQ(MixedId(1, 20), id);
+  ASSERT_EQ(IKey("k2", 6, kTypeValue), Lookup(1, "k2", &id));
+  ASSERT_EQ(MixedId(1, 10), id);
+  // a tombstone ends a lookup like a value
+  ASSERT_EQ(IKey("k3", 16, kTypeDeletion), Lookup(1, "k3", &id, &final));
+  ASSERT_TRUE(final);
+
+  // rebuilt late, an older memtable neither takes over a slot nor adds one,
+  // it cannot tell whether a newer memtable holds the key
+  SortedRep* late = NewMemTable(1, 5);
+  late->Add("k1", 2, kTypeValue, "v4");
+  late->Add("k4", 3, kTypeValue, "v5");
+  index_.Add(rmem(2), false);
+  ASSERT_EQ(IKey("k1", 15, kTypeValue), Lookup(1, "k1"));
+  ASSERT_EQ("", Lookup(1, "k4"));
+
+  // not the newest, but newer than the memtable of a slot
+  SortedRep* middle = NewMemTable(1, 15);
+  middle->Add("k2", 10, kTypeSingleDeletion, "");
+  middle->Add("k1", 11, kTypeValue, "v6");
+  middle->Add("k5", 12, kTypeValue, "v7");
+  index_.Add(rmem(3), false);
+  ASSERT_EQ(IKey("k2", 10, kTypeSingleDeletion), Lookup(1, "k2", &id));
+  ASSERT_EQ(MixedId(1, 15), id);
+  ASSERT_EQ(IKey("k1", 15, kTypeValue), Lookup(1, "k1"));
+  ASSERT_EQ("", Lookup(1, "k5"));
+}
+
+TEST_F(MemTablePointIndexTest, RemoveDropsOwnSlots) {
+  SortedRep* older = NewMemTable(1, 10);
+  older->Add("k1", 5, kTypeValue, "v1");
+  older->Add("k2", 6, kTypeValue, "v2");
+  index_.Add(rmem(0), true);
+  SortedRep* newer = NewMemTable(1, 20);
+  newer->Add("k1", 15, kTypeValue, "v3");
+  index_.Add(rmem(1), true);
+  SortedRep* other_cf = NewMemTable(2, 10);
+  other_cf->Add("k1", 7, kTypeValue, "v4");
+  index_.Add(rmem(2), true);
+
+  index_.Remove(rmem(1));
+  // the older version is still in the pool, but the slot stays absent
+  // until a newer memtable sets it again
+  ASSERT_EQ("", Lookup(1, "k1"));
+  ASSERT_EQ(IKey("k2", 6, kTypeValue), Lookup(1, "k2"));
+  ASSERT_EQ(IKey("k1", 7, kTypeValue), Lookup(2, "k1"));
+
+  // dropping a memtable whose slots were taken over keeps them
+  SortedRep* newest = NewMemTable(1, 30);
+  newest->Add("k2", 25, kTypeValue, "v5");
+  index_.Add(rmem(3), true);
+  index_.Remove(rmem(0));
+  ASSERT_EQ(IKey("k2", 25, kTypeValue), Lookup(1, "k2"));
+  index_.Remove(rmem(3));
+  ASSERT_EQ("", Lookup(1, "k2"));
+  ASSERT_EQ(IKey("k1", 7, kTypeValue), Lookup(2, "k1"));
+}
+
+TEST_F(MemTablePointIndexTest, SnapshotBelowIndexedEntry) {
+  SortedRep* m = NewMemTable(1, 10);
+  m->Add("k1", 5, kTypeValue, "v1");
+  m->Add("k1", 9, kTypeValue, "v2");
+  m->Add("k2", 3, kTypeValue, "v3");
+  m->Add("k2", 8, kTypeDeletion, "");
+  m->Add("k3", 4, kTypeValue, "v4");
+  m->Add("k3", 6, kTypeMerge, "op");
+  index_.Add(rmem(0), true);
+
+  const char* entry = nullptr;
+  ASSERT_EQ(IKey("k1", 9, kTypeValue),
+            Lookup(1, "k1", nullptr, nullptr, &entry));
+  {
+    DelegatedGet get("k1", 20);
+    ASSERT_TRUE(m->RGetEntry_v2(&icmp_, get.req, &get.res, entry));
+    ASSERT_TRUE(get.res.found_final_value);
+    ASSERT_EQ(Status::Code::kOk, get.res.status_code);
+    ASSERT_EQ("v2", get.value());
+    ASSERT_EQ(9U, get.res.seq);
+  }
+  {
+    DelegatedGet get("k1", 9);
+    ASSERT_TRUE(m->RGetEntry_v2(&icmp_, get.req, &get.res, entry));
+    ASSERT_EQ("v2", get.value());
+  }
+  {
+    // the indexed version is newer than the snapshot, the walk finds the
+    // one the snapshot reads
+    DelegatedGet get("k1", 7);
+    ASSERT_FALSE(m->RGetEntry_v2(&icmp_, get.req, &get.res, entry));
+    ASSERT_EQ(-1, get.res.status_code);
+    m->RGet_v2(&icmp_, get.req, &get.res);
+    ASSERT_TRUE(get.res.found_final_value);
+    ASSERT_EQ(Status::Code::kOk, get.res.status_code);
+    ASSERT_EQ("v1", get.value());
+    ASSERT_EQ(5U, get.res.seq);
+  }
+  {
+    // older than every version
+    DelegatedGet get("k1", 4);
+    ASSERT_FALSE(m->RGetEntry_v2(&icmp_, get.req, &get.res, entry));
+    m->RGet_v2(&icmp_, get.req, &get.res);
+    ASSERT_FALSE(get.res.found_final_value);
+  }
+
+  ASSERT_EQ(IKey("k2", 8, kTypeDeletion),
+            Lookup(1, "k2", nullptr, nullptr, &entry));
+  {
+    DelegatedGet get("k2", 10);
+    ASSERT_TRUE(m->RGetEntry_v2(&icmp_, get.req, &get.res, entry));
+    ASSERT_TRUE(get.res.found_final_value);
+    ASSERT_EQ(Status::Code::kNotFound, get.res.status_code);
+  }
+  {
+    DelegatedGet get("k2", 5);
+    ASSERT_FALSE(m->RGetEntry_v2(&icmp_, get.req, &get.res, entry));
+    m->RGet_v2(&icmp_, get.req, &get.res);
+    ASSERT_EQ(Status::Code::kOk, get.res.status_code);
+    ASSERT_EQ("v3", get.value());
+  }
+
+  // a merge operand is never answered from the entry alone
+  bool final = true;
+  ASSERT_EQ(IKey("k3", 6, kTypeMerge), Lookup(1, "k3", nullptr, &final,
+                                               &entry));
+  ASSERT_FALSE(final);
+  {
+    DelegatedGet get("k3", 10);
+    ASSERT_FALSE(m->RGetEntry_v2(&icmp_, get.req, &get.res, entry));
+  }
+
+  // the entry of another key, what a slot shared by keys with the same
+  // hash may hold, is not an answer
+  ASSERT_EQ(IKey("k1", 9, kTypeValue),
+            Lookup(1, "k1", nullptr, nullptr, &entry));
+  {
+    DelegatedGet get("k0", 20);
+    ASSERT_FALSE(m->RGetEntry_v2(&icmp_, get.req, &get.res, entry));
+  }
+}
+
+TEST_F(MemTablePointIndexTest, ManyKeys) {
+  Random rnd(301);
+  std::vector<std::string> keys;
+  for (int m = 0; m < 4; m++) {
+    SortedRep* rep = NewMemTable(1, 10 * (m + 1));
+    for (int i = 0; i < 1000; i++) {
+      std::string key = rnd.RandomString(12);
+      rep->Add(key, 1000 * m + i, kTypeValue, "v");
+      keys.push_back(key);
+    }
+    index_.Add(rmem(m), true);
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    uint64_t id = 0;
+    ASSERT_EQ(IKey(keys[i], i, kTypeValue), Lookup(1, keys[i], &id));
+    ASSERT_EQ(MixedId(1, static_cast<uint32_t>(10 * (i / 1000 + 1))), id);
+  }
+  for (int m = 0; m < 4; m++) index_.Remove(rmem(m));
+  for (const auto& key : keys) {
+    ASSERT_EQ("", Lookup(1, key));
+  }
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,338 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#include "rocksdb/registered_buffer_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+#include "port/port.h"
+#include "test_util/sync_point.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+std::string RegisteredBufferAllocator::Stats::ToString() const {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "capacity %" PRIu64 " allocated %" PRIu64 " requested %" PRIu64
+           " cached %" PRIu64 " free %" PRIu64 " largest_free %" PRIu64
+           " blocks %" PRIu64 " failed %" PRIu64 " fragmentation %.3f",
+           capacity, allocated, requested, cached, free, largest_free, blocks,
+           failed, fragmentation());
+  return buf;
+}
+
+RegisteredBufferAllocator::RegisteredBufferAllocator()
+    : stripes_(new Stripe[kStripes]) {
+  unsigned cores = std::thread::hardware_concurrency();
+  num_caches_ = std::max(1u, cores);
+  caches_.reset(new CoreCache[num_caches_]);
+}
+
+RegisteredBufferAllocator::~RegisteredBufferAllocator() = default;
+
+void RegisteredBufferAllocator::Init(uint64_t capacity) {
+  std::call_once(init_once_, [this, capacity]() {
+    std::lock_guard<std::mutex> lck(mu_);
+    uint64_t end = capacity & ~(kMinBlockSize - 1);
+    if (end > 0) PutExtent(0, end);
+    capacity_.store(end);
+  });
+}
+
+int RegisteredBufferAllocator::OrderOf(uint64_t size) {
+  int order = kMinOrder;
+  while (order < kChunkOrder && (uint64_t{1} << order) < size) order++;
+  return order;
+}
+
+uint64_t RegisteredBufferAllocator::LengthOf(uint64_t size) {
+  int order = OrderOf(size);
+  if (order < kChunkOrder) return uint64_t{1} << order;
+  return (size + kMinBlockSize - 1) & ~(kMinBlockSize - 1);
+}
+
+RegisteredBufferAllocator::Stripe& RegisteredBufferAllocator::StripeOf(
+    uint64_t offset) const {
+  return stripes_[(offset >> kMinOrder) % kStripes];
+}
+
+RegisteredBufferAllocator::CoreCache& RegisteredBufferAllocator::LocalCache()
+    const {
+  int core = port::PhysicalCoreID();
+  size_t idx = core >= 0
+                   ? static_cast<size_t>(core)
+                   : std::hash<std::thread::id>()(std::this_thread::get_id());
+  return caches_[idx % num_caches_];
+}
+
+int64_t RegisteredBufferAllocator::TakeBlock(uint64_t size) {
+  const int order = OrderOf(size);
+  if (order >= kChunkOrder) return TakeExtent(LengthOf(size), kMinBlockSize);
+  return TakeFree(order);
+}
+
+int64_t RegisteredBufferAllocator::TakeFree(int order) {
+  int o = order;
+  while (o < kChunkOrder && free_[o].empty()) o++;
+  uint64_t offset = 0;
+  if (o < kChunkOrder) {
+    offset = free_[o].back();
+    RemoveFree(offset, o);
+  } else {
+    // buddies never cross a chunk, so chunks are aligned to their size
+    int64_t chunk = TakeExtent(kChunkSize, kChunkSize);
+    if (chunk < 0) return -1;
+    offset = static_cast<uint64_t>(chunk);
+  }
+  // keep the lower half, give back the upper halves
+  while (o > order) {
+    o--;
+    PutFree(offset + (uint64_t{1} << o), o);
+  }
+  return static_cast<int64_t>(offset);
+}
+
+void RegisteredBufferAllocator::PutFree(uint64_t offset, int order) {
+  free_pos_[offset] = {order, free_[order].size()};
+  free_[order].push_back(offset);
+  free_bytes_ += uint64_t{1} << order;
+}
+
+void RegisteredBufferAllocator::RemoveFree(uint64_t offset, int order) {
+  auto it = free_pos_.find(offset);
+  assert(it != free_pos_.end() && it->second.first == order);
+  size_t pos = it->second.second;
+  uint64_t last = free_[order].back();
+  free_[order][pos] = last;
+  free_pos_[last].second = pos;
+  free_[order].pop_back();
+  free_pos_.erase(offset);
+  free_bytes_ -= uint64_t{1} << order;
+}
+
+void RegisteredBufferAllocator::ReleaseToBuddy(uint64_t offset, int order) {
+  while (order < kChunkOrder) {
+    uint64_t buddy = offset ^ (uint64_t{1} << order);
+    auto it = free_pos_.find(buddy);
+    if (it == free_pos_.end() || it->second.first != order) break;
+    RemoveFree(buddy, order);
+    offset = std::min(offset, buddy);
+    order++;
+  }
+  if (order == kChunkOrder) {
+    PutExtent(offset, kChunkSize);
+  } else {
+    PutFree(offset, order);
+  }
+}
+
+int64_t RegisteredBufferAllocator::TakeExtent(uint64_t length,
+                                              uint64_t align) {
+  for (auto it = extents_by_length_.lower_bound({length, 0});
+       it != extents_by_length_.end(); ++it) {
+    uint64_t begin = it->second;
+    uint64_t end = begin + it->first;
+    uint64_t aligned = (begin + align - 1) & ~(align - 1);
+    if (aligned + length > end) continue;
+    extents_by_length_.erase(it);
+    extents_.erase(begin);
+    extent_bytes_ -= end - begin;
+    if (aligned > begin) PutExtent(begin, aligned - begin);
+    if (aligned + length < end) {
+      PutExtent(aligned + length, end - aligned - length);
+    }
+    return static_cast<int64_t>(aligned);
+  }
+  return -1;
+}
+
+void RegisteredBufferAllocator::PutExtent(uint64_t offset, uint64_t length) {
+  // merge with the free extents on both sides
+  auto next = extents_.lower_bound(offset);
+  if (next != extents_.end() && offset + length == next->first) {
+    length += next->second;
+    extents_by_length_.erase({next->second, next->first});
+    extent_bytes_ -= next->second;
+    next = extents_.erase(next);
+  }
+  if (next != extents_.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      length += prev->second;
+      extents_by_length_.erase({prev->second, prev->first});
+      extent_bytes_ -= prev->second;
+      extents_.erase(prev);
+    }
+  }
+  extents_[offset] = length;
+  extents_by_length_.insert({length, offset});
+  extent_bytes_ += length;
+}
+
+void RegisteredBufferAllocator::DrainCaches() {
+  std::vector<std::pair<uint64_t, int>> drained;
+  for (size_t i = 0; i < num_caches_; i++) {
+    std::lock_guard<std::mutex> lck(caches_[i].mu);
+    for (int o = kMinOrder; o <= kMaxCachedOrder; o++) {
+      auto& blocks = caches_[i].blocks[o - kMinOrder];
+      for (uint64_t offset : blocks) drained.emplace_back(offset, o);
+      cached_bytes_.fetch_sub(blocks.size() << o);
+      blocks.clear();
+    }
+  }
+  if (drained.empty()) return;
+  std::lock_guard<std::mutex> lck(mu_);
+  for (auto& block : drained) ReleaseToBuddy(block.first, block.second);
+}
+
+void RegisteredBufferAllocator::Record(uint64_t offset, uint64_t size) {
+  Stripe& stripe = StripeOf(offset);
+  {
+    std::lock_guard<std::mutex> lck(stripe.mu);
+    stripe.blocks[offset] = size;
+  }
+  allocated_bytes_.fetch_add(LengthOf(size));
+  requested_bytes_.fetch_add(size);
+  num_blocks_.fetch_add(1);
+}
+
+int64_t RegisteredBufferAllocator::Allocate(uint64_t size) {
+  if (!initialized()) return -1;
+  const int order = OrderOf(size);
+  int64_t offset = -1;
+  if (order <= kMaxCachedOrder) {
+    CoreCache& cache = LocalCache();
+    std::lock_guard<std::mutex> lck(cache.mu);
+    auto& blocks = cache.blocks[order - kMinOrder];
+    if (!blocks.empty()) {
+      offset = static_cast<int64_t>(blocks.back());
+      blocks.pop_back();
+      cached_bytes_.fetch_sub(uint64_t{1} << order);
+    }
+  }
+  if (offset < 0) {
+    std::lock_guard<std::mutex> lck(mu_);
+    offset = TakeBlock(size);
+  }
+  if (offset < 0) {
+    failed_.fetch_add(1);
+    return -1;
+  }
+  Record(static_cast<uint64_t>(offset), size);
+  return offset;
+}
+
+int64_t RegisteredBufferAllocator::Allocate(uint64_t size,
+                                            std::chrono::milliseconds wait) {
+  int64_t offset = Allocate(size);
+  if (offset >= 0 || !initialized()) return offset;
+  const auto deadline = std::chrono::steady_clock::now() + wait;
+  // a free to a cache only wakes waiters it sees, see Free()
+  waiters_.fetch_add(1);
+  bool timeout = false;
+  while (offset < 0) {
+    uint64_t frees = 0;
+    {
+      std::lock_guard<std::mutex> lck(mu_);
+      frees = frees_;
+    }
+    // blocks parked in other cores' caches may merge into a fitting one, a
+    // block cached after this is counted in frees_
+    DrainCaches();
+    TEST_SYNC_POINT("RegisteredBufferAllocator::Allocate:Drained");
+    std::unique_lock<std::mutex> lck(mu_);
+    offset = TakeBlock(size);
+    if (offset >= 0 || timeout) break;
+    timeout = !freed_cv_.wait_until(lck, deadline,
+                                    [&]() { return frees_ != frees; });
+    // one more pass after the timeout, the caches may hold what is needed
+  }
+  waiters_.fetch_sub(1);
+  if (offset < 0) return -1;
+  Record(static_cast<uint64_t>(offset), size);
+  return offset;
+}
+
+bool RegisteredBufferAllocator::Free(uint64_t offset) {
+  uint64_t size = 0;
+  {
+    Stripe& stripe = StripeOf(offset);
+    std::lock_guard<std::mutex> lck(stripe.mu);
+    auto it = stripe.blocks.find(offset);
+    if (it == stripe.blocks.end()) return false;
+    size = it->second;
+    stripe.blocks.erase(it);
+  }
+  const int order = OrderOf(size);
+  allocated_bytes_.fetch_sub(LengthOf(size));
+  requested_bytes_.fetch_sub(size);
+  num_blocks_.fetch_sub(1);
+
+  bool cached = false;
+  if (order <= kMaxCachedOrder) {
+    CoreCache& cache = LocalCache();
+    std::lock_guard<std::mutex> lck(cache.mu);
+    auto& blocks = cache.blocks[order - kMinOrder];
+    if (blocks.size() < kCachedBlocksPerOrder) {
+      blocks.push_back(offset);
+      cached_bytes_.fetch_add(uint64_t{1} << order);
+      cached = true;
+    }
+  }
+  if (cached) {
+    // the cached block is seen by a waiter that drains the caches after
+    // this, one that drained them before has registered in waiters_
+    if (waiters_.load() == 0) return true;
+    std::lock_guard<std::mutex> lck(mu_);
+    frees_++;
+    freed_cv_.notify_all();
+    return true;
+  }
+  std::lock_guard<std::mutex> lck(mu_);
+  if (order >= kChunkOrder) {
+    PutExtent(offset, LengthOf(size));
+  } else {
+    ReleaseToBuddy(offset, order);
+  }
+  frees_++;
+  freed_cv_.notify_all();
+  return true;
+}
+
+uint64_t RegisteredBufferAllocator::BlockSize(uint64_t offset) const {
+  Stripe& stripe = StripeOf(offset);
+  std::lock_guard<std::mutex> lck(stripe.mu);
+  auto it = stripe.blocks.find(offset);
+  return it == stripe.blocks.end() ? 0 : LengthOf(it->second);
+}
+
+RegisteredBufferAllocator::Stats RegisteredBufferAllocator::GetStats() const {
+  Stats stats;
+  stats.capacity = capacity_.load();
+  stats.allocated = allocated_bytes_.load();
+  stats.requested = requested_bytes_.load();
+  stats.cached = cached_bytes_.load();
+  stats.blocks = num_blocks_.load();
+  stats.failed = failed_.load();
+  std::lock_guard<std::mutex> lck(mu_);
+  stats.free = free_bytes_ + extent_bytes_;
+  if (!extents_by_length_.empty()) {
+    stats.largest_free = extents_by_length_.rbegin()->first;
+  }
+  for (int o = kChunkOrder - 1; o >= kMinOrder; o--) {
+    if (!free_[o].empty()) {
+      stats.largest_free = std::max(stats.largest_free, uint64_t{1} << o);
+      break;
+    }
+  }
+  return stats;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,305 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "rocksdb/registered_buffer_allocator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "port/port.h"
+#include "test_util/sync_point.h"
+#include "test_util/testharness.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+class RegisteredBufferAllocatorTest : public testing::Test {
+ protected:
+  using Alloc = RegisteredBufferAllocator;
+
+  void TearDown() override {
+    SyncPoint::GetInstance()->DisableProcessing();
+    SyncPoint::GetInstance()->ClearAllCallBacks();
+  }
+};
+
+TEST_F(RegisteredBufferAllocatorTest, Uninitialized) {
+  Alloc alloc;
+  ASSERT_FALSE(alloc.initialized());
+  ASSERT_EQ(-1, alloc.Allocate(64));
+  ASSERT_EQ(-1, alloc.Allocate(64, std::chrono::milliseconds(10)));
+}
+
+TEST_F(RegisteredBufferAllocatorTest, BlockSizes) {
+  Alloc alloc;
+  alloc.Init(4 * Alloc::kChunkSize);
+  // up to half a chunk the block is the next power of two of at least 64
+  // bytes
+  int64_t a = alloc.Allocate(1);
+  int64_t b = alloc.Allocate(100);
+  int64_t c = alloc.Allocate(Alloc::kChunkSize / 2);
+  // above it is an extent rounded to 64 bytes only
+  int64_t d = alloc.Allocate(Alloc::kChunkSize / 2 + 1);
+  ASSERT_GE(a, 0);
+  ASSERT_GE(b, 0);
+  ASSERT_GE(c, 0);
+  ASSERT_GE(d, 0);
+  ASSERT_EQ(Alloc::kMinBlockSize, alloc.BlockSize(a));
+  ASSERT_EQ(128U, alloc.BlockSize(b));
+  ASSERT_EQ(Alloc::kChunkSize / 2, alloc.BlockSize(c));
+  ASSERT_EQ(Alloc::kChunkSize / 2 + 64, alloc.BlockSize(d));
+  // buddies are aligned to their size
+  ASSERT_EQ(0, b % 128);
+  ASSERT_EQ(0, c % (Alloc::kChunkSize / 2));
+  ASSERT_EQ(0, d % Alloc::kMinBlockSize);
+
+  Alloc::Stats stats = alloc.GetStats();
+  ASSERT_EQ(4 * Alloc::kChunkSize, stats.capacity);
+  ASSERT_EQ(4U, stats.blocks);
+  ASSERT_EQ(1 + 100 + Alloc::kChunkSize / 2 + Alloc::kChunkSize / 2 + 1,
+            stats.requested);
+  ASSERT_EQ(64 + 128 + Alloc::kChunkSize / 2 + Alloc::kChunkSize / 2 + 64,
+            stats.allocated);
+
+  for (int64_t offset : {a, b, c, d}) {
+    ASSERT_TRUE(alloc.Free(offset));
+    ASSERT_EQ(0U, alloc.BlockSize(offset));
+  }
+  ASSERT_EQ(0U, alloc.GetStats().blocks);
+  ASSERT_EQ(0U, alloc.GetStats().allocated);
+}
+
+TEST_F(RegisteredBufferAllocatorTest, FreeUnknownOffset) {
+  Alloc alloc;
+  alloc.Init(Alloc::kChunkSize);
+  int64_t a = alloc.Allocate(4096);
+  ASSERT_GE(a, 0);
+  ASSERT_FALSE(alloc.Free(a + 64));
+  ASSERT_TRUE(alloc.Free(a));
+  ASSERT_FALSE(alloc.Free(a));
+}
+
+TEST_F(RegisteredBufferAllocatorTest, SplitAndCoalesce) {
+  Alloc alloc;
+  alloc.Init(Alloc::kChunkSize);
+  // one chunk split down to 64 bytes, every block a distinct offset
+  const uint64_t kBlocks = Alloc::kChunkSize / Alloc::kMinBlockSize;
+  std::set<int64_t> offsets;
+  for (uint64_t i = 0; i < kBlocks; i++) {
+    int64_t offset = alloc.Allocate(Alloc::kMinBlockSize);
+    ASSERT_GE(offset, 0);
+    ASSERT_EQ(0, offset % Alloc::kMinBlockSize);
+    ASSERT_TRUE(offsets.insert(offset).second);
+  }
+  ASSERT_EQ(-1, alloc.Allocate(Alloc::kMinBlockSize));
+  ASSERT_EQ(0U, alloc.GetStats().free);
+
+  for (int64_t offset : offsets) {
+    ASSERT_TRUE(alloc.Free(offset));
+  }
+  Alloc::Stats stats = alloc.GetStats();
+  ASSERT_EQ(0U, stats.blocks);
+  ASSERT_EQ(Alloc::kChunkSize, stats.free + stats.cached);
+  // the blocks in the caches are merged back when the chunk is asked for
+  int64_t chunk = alloc.Allocate(Alloc::kChunkSize, std::chrono::seconds(0));
+  ASSERT_EQ(0, chunk);
+  ASSERT_TRUE(alloc.Free(chunk));
+  stats = alloc.GetStats();
+  ASSERT_EQ(Alloc::kChunkSize, stats.free);
+  ASSERT_EQ(Alloc::kChunkSize, stats.largest_free);
+  ASSERT_EQ(0.0, stats.fragmentation());
+}
+
+TEST_F(RegisteredBufferAllocatorTest, ExtentsMerge) {
+  Alloc alloc;
+  alloc.Init(3 * Alloc::kChunkSize);
+  std::vector<int64_t> extents;
+  for (int i = 0; i < 3; i++) {
+    extents.push_back(alloc.Allocate(Alloc::kChunkSize));
+    ASSERT_GE(extents.back(), 0);
+  }
+  ASSERT_EQ(-1, alloc.Allocate(Alloc::kMinBlockSize));
+  // freeing the middle one last joins all three again
+  ASSERT_TRUE(alloc.Free(extents[0]));
+  ASSERT_TRUE(alloc.Free(extents[2]));
+  ASSERT_EQ(Alloc::kChunkSize, alloc.GetStats().largest_free);
+  ASSERT_EQ(-1, alloc.Allocate(2 * Alloc::kChunkSize));
+  ASSERT_TRUE(alloc.Free(extents[1]));
+  ASSERT_EQ(3 * Alloc::kChunkSize, alloc.GetStats().largest_free);
+  ASSERT_EQ(0, alloc.Allocate(3 * Alloc::kChunkSize));
+}
+
+TEST_F(RegisteredBufferAllocatorTest, Exhaustion) {
+  Alloc alloc;
+  alloc.Init(2 * Alloc::kChunkSize);
+  int64_t a = alloc.Allocate(Alloc::kChunkSize);
+  int64_t b = alloc.Allocate(Alloc::kChunkSize);
+  ASSERT_GE(a, 0);
+  ASSERT_GE(b, 0);
+  uint64_t failed = alloc.GetStats().failed;
+  ASSERT_EQ(-1, alloc.Allocate(Alloc::kMinBlockSize));
+  ASSERT_EQ(failed + 1, alloc.GetStats().failed);
+
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(-1, alloc.Allocate(Alloc::kMinBlockSize,
+                               std::chrono::milliseconds(50)));
+  ASSERT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(50));
+
+  ASSERT_TRUE(alloc.Free(b));
+  ASSERT_GE(alloc.Allocate(Alloc::kMinBlockSize), 0);
+}
+
+TEST_F(RegisteredBufferAllocatorTest, CrossThreadFree) {
+  Alloc alloc;
+  alloc.Init(Alloc::kChunkSize);
+  const uint64_t kBlockSize = 4096;
+  const uint64_t kBlocks = Alloc::kChunkSize / kBlockSize;
+  std::vector<int64_t> offsets;
+  for (uint64_t i = 0; i < kBlocks; i++) {
+    offsets.push_back(alloc.Allocate(kBlockSize));
+    ASSERT_GE(offsets.back(), 0);
+  }
+  ASSERT_EQ(-1, alloc.Allocate(kBlockSize));
+
+  // other threads free the blocks, partly into the caches of their cores
+  const int kThreads = 4;
+  std::vector<port::Thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = t; i < offsets.size(); i += kThreads) {
+        ASSERT_TRUE(alloc.Free(offsets[i]));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  Alloc::Stats stats = alloc.GetStats();
+  ASSERT_EQ(0U, stats.blocks);
+  ASSERT_EQ(Alloc::kChunkSize, stats.free + stats.cached);
+  ASSERT_EQ(0, alloc.Allocate(Alloc::kChunkSize, std::chrono::seconds(0)));
+}
+
+TEST_F(RegisteredBufferAllocatorTest, ConcurrentAllocateAndFree) {
+  Alloc alloc;
+  alloc.Init(4 * Alloc::kChunkSize);
+  const int kThreads = 8;
+  std::atomic<bool> overlap{false};
+  std::vector<port::Thread> threads;
+  // every thread fills the blocks it holds with its id and checks them
+  std::unique_ptr<char[]> buf(new char[4 * Alloc::kChunkSize]);
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      Random rnd(301 + t);
+      std::vector<std::pair<int64_t, uint64_t>> held;
+      for (int i = 0; i < 20000; i++) {
+        if (held.size() < 16 && rnd.OneIn(2)) {
+          uint64_t size = 1 + rnd.Uniform(16 << 10);
+          int64_t offset = alloc.Allocate(size, std::chrono::seconds(5));
+          ASSERT_GE(offset, 0);
+          memset(buf.get() + offset, t, size);
+          held.emplace_back(offset, size);
+        } else if (!held.empty()) {
+          size_t k = rnd.Uniform(static_cast<int>(held.size()));
+          auto block = held[k];
+          for (uint64_t j = 0; j < block.second; j++) {
+            if (buf[block.first + j] != static_cast<char>(t)) {
+              overlap = true;
+              break;
+            }
+          }
+          ASSERT_TRUE(alloc.Free(block.first));
+          held[k] = held.back();
+          held.pop_back();
+        }
+      }
+      for (auto& block : held) {
+        ASSERT_TRUE(alloc.Free(block.first));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_FALSE(overlap.load());
+  Alloc::Stats stats = alloc.GetStats();
+  ASSERT_EQ(0U, stats.blocks);
+  ASSERT_EQ(0U, stats.allocated);
+  ASSERT_EQ(4 * Alloc::kChunkSize, stats.free + stats.cached);
+}
+
+TEST_F(RegisteredBufferAllocatorTest, TimedAllocateWaitsForFree) {
+  Alloc alloc;
+  alloc.Init(Alloc::kChunkSize);
+  const uint64_t kBlockSize = 4096;
+  std::vector<int64_t> offsets;
+  for (uint64_t i = 0; i < Alloc::kChunkSize / kBlockSize; i++) {
+    offsets.push_back(alloc.Allocate(kBlockSize));
+    ASSERT_GE(offsets.back(), 0);
+  }
+  std::atomic<int64_t> got{-2};
+  port::Thread waiter([&]() {
+    got = alloc.Allocate(kBlockSize, std::chrono::seconds(30));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_EQ(-2, got.load());
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(alloc.Free(offsets.back()));
+  waiter.join();
+  ASSERT_EQ(offsets.back(), got.load());
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+}
+
+TEST_F(RegisteredBufferAllocatorTest, FreeIntoCacheAfterDrain) {
+  Alloc alloc;
+  alloc.Init(Alloc::kChunkSize);
+  const uint64_t kBlockSize = 4096;
+  std::vector<int64_t> offsets;
+  for (uint64_t i = 0; i < Alloc::kChunkSize / kBlockSize; i++) {
+    offsets.push_back(alloc.Allocate(kBlockSize));
+    ASSERT_GE(offsets.back(), 0);
+  }
+  // the block is freed into a cache right after the waiter drained them,
+  // before it goes to sleep
+  const int64_t victim = offsets.back();
+  bool freed = false;
+  SyncPoint::GetInstance()->SetCallBack(
+      "RegisteredBufferAllocator::Allocate:Drained", [&](void*) {
+        if (!freed) {
+          freed = true;
+          ASSERT_TRUE(alloc.Free(victim));
+        }
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(victim, alloc.Allocate(kBlockSize, std::chrono::seconds(30)));
+  ASSERT_TRUE(freed);
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+  // a zero wait still takes a block freed into a cache while it looked
+  freed = false;
+  const int64_t second = offsets.front();
+  SyncPoint::GetInstance()->SetCallBack(
+      "RegisteredBufferAllocator::Allocate:Drained", [&](void*) {
+        if (!freed) {
+          freed = true;
+          ASSERT_TRUE(alloc.Free(second));
+        }
+      });
+  ASSERT_EQ(second, alloc.Allocate(kBlockSize, std::chrono::seconds(0)));
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
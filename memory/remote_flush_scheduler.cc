@@ -0,0 +1,224 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#include "memory/remote_flush_scheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+#include "rocksdb/logger.hpp"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+FlushPlacementPolicy FlushPlacementPolicyFromString(const std::string &name) {
+  if (name == "power_of_two") return FlushPlacementPolicy::kPowerOfTwoChoices;
+  if (name == "locality") return FlushPlacementPolicy::kMemnodeLocality;
+  if (name != "least_loaded") {
+    DM_LOG_WARN("unknown flush placement ", name, ", use least_loaded");
+  }
+  return FlushPlacementPolicy::kLeastLoaded;
+}
+
+const char *FlushPlacementPolicyName(FlushPlacementPolicy policy) {
+  switch (policy) {
+    case FlushPlacementPolicy::kLeastLoaded:
+      return "least_loaded";
+    case FlushPlacementPolicy::kPowerOfTwoChoices:
+      return "power_of_two";
+    case FlushPlacementPolicy::kMemnodeLocality:
+      return "locality";
+  }
+  return "least_loaded";
+}
+
+FlushPlacementPolicy DefaultFlushPlacementPolicy() {
+  const char *env = getenv("ROCKSDB_FLUSH_PLACEMENT");
+  return env != nullptr ? FlushPlacementPolicyFromString(env)
+                        : FlushPlacementPolicy::kLeastLoaded;
+}
+
+RemoteFlushScheduler::RemoteFlushScheduler(FlushPlacementPolicy policy,
+                                           int max_running)
+    : policy_(policy), max_running_(std::max(1, max_running)) {}
+
+void RemoteFlushScheduler::AddExecutor(Executor *e, bool colocated) {
+  std::lock_guard<std::mutex> lck(mu_);
+  if (executors_.count(e) == 0) order_.push_back(e);
+  executors_[e].colocated = colocated;
+  cv_.notify_all();
+}
+
+void RemoteFlushScheduler::RemoveExecutor(Executor *e) {
+  std::lock_guard<std::mutex> lck(mu_);
+  auto it = executors_.find(e);
+  if (it == executors_.end()) return;
+  std::deque<Job> queued = std::move(it->second.queued);
+  for (auto &r : it->second.running) {
+    for (uint64_t id : r.memtables) running_memtables_.erase(id);
+  }
+  executors_.erase(it);
+  order_.erase(std::find(order_.begin(), order_.end(), e));
+  for (auto &job : queued) {
+    Executor *to = order_.empty() ? nullptr : Choose(job);
+    if (to == nullptr) {
+      unplaced_.push_back(std::move(job));
+    } else {
+      Enqueue(to, std::move(job));
+    }
+  }
+  cv_.notify_all();
+}
+
+RemoteFlushScheduler::Executor *RemoteFlushScheduler::Submit(Job job) {
+  std::lock_guard<std::mutex> lck(mu_);
+  Executor *e = order_.empty() ? nullptr : Choose(job);
+  DM_LOG_DEBUG("place flush job ", job.begin, ' ', job.end, " bytes ",
+               job.bytes, " on ", e == nullptr ? -1 : e->sock);
+  if (e == nullptr) {
+    unplaced_.push_back(std::move(job));
+  } else {
+    Enqueue(e, std::move(job));
+  }
+  cv_.notify_all();
+  return e;
+}
+
+RemoteFlushScheduler::Job RemoteFlushScheduler::Next(Executor *e) {
+  Job job;
+  std::unique_lock<std::mutex> lck(mu_);
+  // wake up now and then to let running jobs of e expire
+  while (!Take(e, &job)) cv_.wait_for(lck, std::chrono::seconds(1));
+  return job;
+}
+
+void RemoteFlushScheduler::Complete(uint64_t mixed_id) {
+  std::lock_guard<std::mutex> lck(mu_);
+  auto it = running_memtables_.find(mixed_id);
+  if (it == running_memtables_.end()) return;
+  State &s = executors_.at(it->second);
+  auto r = std::find_if(s.running.begin(), s.running.end(),
+                        [mixed_id](const Running &run) {
+                          return std::find(run.memtables.begin(),
+                                           run.memtables.end(),
+                                           mixed_id) != run.memtables.end();
+                        });
+  assert(r != s.running.end());
+  // the memtables of a job are dropped together, the first one ends it
+  for (uint64_t id : r->memtables) running_memtables_.erase(id);
+  s.running_bytes -= r->bytes;
+  s.running.erase(r);
+  cv_.notify_all();
+}
+
+RemoteFlushScheduler::Executor *RemoteFlushScheduler::Choose(const Job &job) {
+  assert(!order_.empty());
+  switch (policy_) {
+    case FlushPlacementPolicy::kPowerOfTwoChoices: {
+      if (order_.size() < 3) return LeastLoaded(false);
+      Random *rnd = Random::GetTLSInstance();
+      size_t a = rnd->Uniform(static_cast<int>(order_.size()));
+      size_t b = rnd->Uniform(static_cast<int>(order_.size()) - 1);
+      if (b >= a) b++;
+      return Load(executors_.at(order_[a])) <= Load(executors_.at(order_[b]))
+                 ? order_[a]
+                 : order_[b];
+    }
+    case FlushPlacementPolicy::kMemnodeLocality: {
+      Executor *local = LeastLoaded(true);
+      Executor *any = LeastLoaded(false);
+      if (local != nullptr && Load(executors_.at(local)) <=
+                                  Load(executors_.at(any)) + job.bytes) {
+        return local;
+      }
+      return any;
+    }
+    case FlushPlacementPolicy::kLeastLoaded:
+    default:
+      return LeastLoaded(false);
+  }
+}
+
+RemoteFlushScheduler::Executor *RemoteFlushScheduler::LeastLoaded(
+    bool colocated_only) const {
+  Executor *best = nullptr;
+  uint64_t best_load = 0;
+  for (Executor *e : order_) {
+    const State &s = executors_.at(e);
+    if (colocated_only && !s.colocated) continue;
+    if (best == nullptr || Load(s) < best_load) {
+      best = e;
+      best_load = Load(s);
+    }
+  }
+  return best;
+}
+
+void RemoteFlushScheduler::Enqueue(Executor *e, Job job) {
+  State &s = executors_.at(e);
+  s.queued_bytes += job.bytes;
+  s.queued.push_back(std::move(job));
+}
+
+bool RemoteFlushScheduler::Take(Executor *e, Job *job) {
+  auto it = executors_.find(e);
+  if (it == executors_.end()) return false;
+  State &s = it->second;
+  Expire(&s, std::chrono::steady_clock::now());
+  if (s.running.size() >= max_running_) return false;
+  if (!s.queued.empty()) {
+    *job = std::move(s.queued.front());
+    s.queued.pop_front();
+    s.queued_bytes -= job->bytes;
+  } else if (!unplaced_.empty()) {
+    *job = std::move(unplaced_.front());
+    unplaced_.pop_front();
+  } else {
+    State *victim = nullptr;
+    for (auto &other : executors_) {
+      if (other.first == e || other.second.queued.empty()) continue;
+      if (victim == nullptr || Load(other.second) > Load(*victim)) {
+        victim = &other.second;
+      }
+    }
+    if (victim == nullptr) return false;
+    // the newest job of the victim waits longest behind its own queue
+    *job = std::move(victim->queued.back());
+    victim->queued.pop_back();
+    victim->queued_bytes -= job->bytes;
+    DM_LOG_DEBUG("steal flush job ", job->begin, ' ', job->end, " bytes ",
+                 job->bytes, " for ", e->sock);
+  }
+  Start(e, *job);
+  return true;
+}
+
+void RemoteFlushScheduler::Start(Executor *e, const Job &job) {
+  State &s = executors_.at(e);
+  Running r;
+  r.bytes = job.bytes;
+  r.start = std::chrono::steady_clock::now();
+  for (auto &m : job.memtables) {
+    r.memtables.push_back(m.first);
+    running_memtables_[m.first] = e;
+  }
+  s.running_bytes += r.bytes;
+  s.running.push_back(std::move(r));
+}
+
+void RemoteFlushScheduler::Expire(State *s,
+                                  std::chrono::steady_clock::time_point now) {
+  for (auto r = s->running.begin(); r != s->running.end();) {
+    if (now - r->start < kMaxRunningAge) {
+      ++r;
+      continue;
+    }
+    for (uint64_t id : r->memtables) running_memtables_.erase(id);
+    s->running_bytes -= r->bytes;
+    r = s->running.erase(r);
+  }
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,123 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rocksdb/remote_flush_service.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+enum class FlushPlacementPolicy : char {
+  // the executor with the fewest queued and running bytes
+  kLeastLoaded,
+  // the less loaded of two executors picked at random, keeps the load
+  // spread without every memnode thread agreeing on a single minimum
+  kPowerOfTwoChoices,
+  // executors on the host of the memnode unless that puts the job behind
+  // more than its own size of work, least loaded otherwise
+  kMemnodeLocality,
+};
+
+// "least_loaded", "power_of_two" or "locality", kLeastLoaded if unknown
+FlushPlacementPolicy FlushPlacementPolicyFromString(const std::string &name);
+const char *FlushPlacementPolicyName(FlushPlacementPolicy policy);
+// from ROCKSDB_FLUSH_PLACEMENT, kLeastLoaded if unset
+FlushPlacementPolicy DefaultFlushPlacementPolicy();
+
+// Places the remote flush jobs a memnode receives on the flush workers
+// registered with it.
+//
+// A job costs the bytes of the memtable shards it flushes and counts
+// against its executor from placement until the generator drops the
+// flushed memtables. An executor runs at most max_running jobs at a time,
+// further jobs wait in its queue, and an executor that asks for work with
+// an empty queue takes the last job queued on the most loaded one, so a
+// run of large flushes does not pile up on one worker while others idle.
+class RemoteFlushScheduler {
+ public:
+  using Executor = RDMANode::rdma_connection;
+  // flushes a worker runs at once before its jobs queue up for stealing
+  static constexpr int kDefaultMaxRunning = 2;
+
+  struct Job {
+    // job package on the memnode, [begin, end) of its buffer
+    int64_t begin = 0;
+    int64_t end = 0;
+    // memtables flushed by the job and the bytes of their shards
+    std::vector<std::pair<uint64_t, uint64_t>> memtables;
+    uint64_t bytes = 0;
+  };
+
+  RemoteFlushScheduler(FlushPlacementPolicy policy, int max_running);
+  RemoteFlushScheduler(const RemoteFlushScheduler &) = delete;
+  void operator=(const RemoteFlushScheduler &) = delete;
+
+  // colocated: the executor runs on the host of the memnode
+  void AddExecutor(Executor *e, bool colocated);
+  // queued jobs of e go back to placement, running ones stop counting
+  void RemoveExecutor(Executor *e);
+  // queues job on an executor chosen by the policy and returns it, nullptr
+  // if none is registered yet, the job then goes to the first to ask
+  Executor *Submit(Job job);
+  // blocks until a job for e is available
+  Job Next(Executor *e);
+  // the memtable mixed_id was dropped, the job flushing it is done
+  void Complete(uint64_t mixed_id);
+
+  FlushPlacementPolicy policy() const { return policy_; }
+
+ private:
+  // running jobs past this age stop counting, their memtables are likely
+  // flushed locally or leaked by the generator
+  static constexpr std::chrono::seconds kMaxRunningAge{120};
+
+  struct Running {
+    uint64_t bytes;
+    std::vector<uint64_t> memtables;
+    std::chrono::steady_clock::time_point start;
+  };
+  struct State {
+    bool colocated = false;
+    std::deque<Job> queued;
+    uint64_t queued_bytes = 0;
+    uint64_t running_bytes = 0;
+    std::vector<Running> running;
+  };
+
+  // REQUIRES: mu_ held
+  static uint64_t Load(const State &s) {
+    return s.queued_bytes + s.running_bytes;
+  }
+  Executor *Choose(const Job &job);
+  Executor *LeastLoaded(bool colocated_only) const;
+  void Enqueue(Executor *e, Job job);
+  // takes a job for e from its queue, the unplaced jobs or the most loaded
+  // executor, false if there is none
+  bool Take(Executor *e, Job *job);
+  void Start(Executor *e, const Job &job);
+  void Expire(State *s, std::chrono::steady_clock::time_point now);
+
+  const FlushPlacementPolicy policy_;
+  const size_t max_running_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::vector<Executor *> order_;
+  std::unordered_map<Executor *, State> executors_;
+  // submitted while no executor was registered
+  std::deque<Job> unplaced_;
+  // memtable of a running job -> its executor
+  std::unordered_map<uint64_t, Executor *> running_memtables_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,223 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memory/remote_flush_scheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "port/port.h"
+#include "test_util/testharness.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+class RemoteFlushSchedulerTest : public testing::Test {
+ protected:
+  using Executor = RemoteFlushScheduler::Executor;
+  using Job = RemoteFlushScheduler::Job;
+
+  RemoteFlushSchedulerTest() : executors_(4) {
+    for (size_t i = 0; i < executors_.size(); i++) {
+      executors_[i].ep = nullptr;
+      executors_[i].sock = static_cast<int>(i);
+    }
+  }
+
+  Executor *E(int i) { return &executors_[i]; }
+
+  // job flushing the single memtable id, begin tells jobs apart
+  static Job MakeJob(int64_t begin, uint64_t bytes, uint64_t id) {
+    Job job;
+    job.begin = begin;
+    job.end = begin + 1;
+    job.memtables.emplace_back(id, bytes);
+    job.bytes = bytes;
+    return job;
+  }
+
+  std::vector<Executor> executors_;
+};
+
+TEST_F(RemoteFlushSchedulerTest, PolicyFromString) {
+  ASSERT_EQ(FlushPlacementPolicy::kLeastLoaded,
+            FlushPlacementPolicyFromString("least_loaded"));
+  ASSERT_EQ(FlushPlacementPolicy::kPowerOfTwoChoices,
+            FlushPlacementPolicyFromString("power_of_two"));
+  ASSERT_EQ(FlushPlacementPolicy::kMemnodeLocality,
+            FlushPlacementPolicyFromString("locality"));
+  ASSERT_EQ(FlushPlacementPolicy::kLeastLoaded,
+            FlushPlacementPolicyFromString("round_robin"));
+}
+
+TEST_F(RemoteFlushSchedulerTest, LeastLoadedCountsBytes) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kLeastLoaded, 2);
+  for (int i = 0; i < 3; i++) sched.AddExecutor(E(i), false);
+  // one large job outweighs several small ones
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(0, 1000, 1)));
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(1, 100, 2)));
+  ASSERT_EQ(E(2), sched.Submit(MakeJob(2, 100, 3)));
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(3, 300, 4)));
+  ASSERT_EQ(E(2), sched.Submit(MakeJob(4, 300, 5)));
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(5, 500, 6)));
+  ASSERT_EQ(E(2), sched.Submit(MakeJob(6, 500, 7)));
+  // 1000 : 900 : 900
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(7, 50, 8)));
+  ASSERT_EQ(E(2), sched.Submit(MakeJob(8, 200, 9)));
+  // 1000 : 950 : 1100
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(9, 10, 10)));
+}
+
+TEST_F(RemoteFlushSchedulerTest, RunningBytesCountUntilComplete) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kLeastLoaded, 2);
+  sched.AddExecutor(E(0), false);
+  sched.AddExecutor(E(1), false);
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(0, 1000, 1)));
+  Job job = sched.Next(E(0));
+  ASSERT_EQ(0, job.begin);
+  // taken from the queue, still running on E(0)
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(1, 10, 2)));
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(2, 10, 3)));
+  sched.Complete(1);
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(3, 10, 4)));
+  // an unknown or already completed memtable changes nothing
+  sched.Complete(1);
+  sched.Complete(12345);
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(4, 5, 5)));
+}
+
+TEST_F(RemoteFlushSchedulerTest, JobEndsOnAnyOfItsMemtables) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kLeastLoaded, 1);
+  sched.AddExecutor(E(0), false);
+  sched.AddExecutor(E(1), false);
+  Job job = MakeJob(0, 600, 1);
+  job.memtables.emplace_back(2, 400);
+  job.bytes = 1000;
+  ASSERT_EQ(E(0), sched.Submit(job));
+  sched.Next(E(0));
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(1, 10, 3)));
+  sched.Complete(2);
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(2, 5, 4)));
+  // the job is gone, its other memtable does not end anything
+  sched.Complete(1);
+  ASSERT_EQ(2, sched.Next(E(0)).begin);
+}
+
+TEST_F(RemoteFlushSchedulerTest, PowerOfTwoChoices) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kPowerOfTwoChoices, 2);
+  sched.AddExecutor(E(0), false);
+  sched.AddExecutor(E(1), false);
+  // two executors compare both
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(0, 1000, 1)));
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(1, 10, 2)));
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(2, 10, 3)));
+  sched.AddExecutor(E(2), false);
+  sched.AddExecutor(E(3), false);
+  // the most loaded of two random executors never wins
+  for (int i = 0; i < 100; i++) {
+    ASSERT_NE(E(0), sched.Submit(MakeJob(3 + i, 1, 4 + i)));
+  }
+}
+
+TEST_F(RemoteFlushSchedulerTest, MemnodeLocality) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kMemnodeLocality, 2);
+  sched.AddExecutor(E(0), false);
+  sched.AddExecutor(E(1), true);
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(0, 100, 1)));
+  // 100 behind on the local executor is no more than the job itself
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(1, 100, 2)));
+  // 200 behind is more than 150 for the job
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(2, 150, 3)));
+  // 200 local against 150 remote plus 50
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(3, 50, 4)));
+  // without a colocated executor the policy is least loaded
+  RemoteFlushScheduler remote(FlushPlacementPolicy::kMemnodeLocality, 2);
+  remote.AddExecutor(E(2), false);
+  remote.AddExecutor(E(3), false);
+  ASSERT_EQ(E(2), remote.Submit(MakeJob(0, 100, 1)));
+  ASSERT_EQ(E(3), remote.Submit(MakeJob(1, 100, 2)));
+}
+
+TEST_F(RemoteFlushSchedulerTest, UnplacedGoesToFirstExecutor) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kLeastLoaded, 2);
+  ASSERT_EQ(nullptr, sched.Submit(MakeJob(0, 100, 1)));
+  ASSERT_EQ(nullptr, sched.Submit(MakeJob(1, 100, 2)));
+  sched.AddExecutor(E(0), false);
+  ASSERT_EQ(0, sched.Next(E(0)).begin);
+  ASSERT_EQ(1, sched.Next(E(0)).begin);
+}
+
+TEST_F(RemoteFlushSchedulerTest, IdleExecutorStealsNewestJob) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kLeastLoaded, 1);
+  sched.AddExecutor(E(0), false);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(E(0), sched.Submit(MakeJob(i, 100, i + 1)));
+  }
+  sched.AddExecutor(E(1), false);
+  sched.AddExecutor(E(2), false);
+  ASSERT_EQ(0, sched.Next(E(0)).begin);
+  // E(1) has nothing queued, the job last queued on E(0) waits longest
+  ASSERT_EQ(3, sched.Next(E(1)).begin);
+  ASSERT_EQ(2, sched.Next(E(2)).begin);
+  // a stolen job counts against its new executor
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(4, 1, 5)));
+  sched.Complete(3);
+  ASSERT_EQ(E(2), sched.Submit(MakeJob(5, 1, 6)));
+}
+
+TEST_F(RemoteFlushSchedulerTest, StealsFromMostLoaded) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kLeastLoaded, 1);
+  sched.AddExecutor(E(0), false);
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(0, 10, 1)));
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(1, 10, 2)));
+  sched.AddExecutor(E(1), false);
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(2, 10, 3)));
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(3, 500, 4)));
+  sched.AddExecutor(E(2), false);
+  ASSERT_EQ(3, sched.Next(E(2)).begin);
+}
+
+TEST_F(RemoteFlushSchedulerTest, NextWaitsForRunningSlot) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kLeastLoaded, 1);
+  sched.AddExecutor(E(0), false);
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(0, 100, 1)));
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(1, 100, 2)));
+  ASSERT_EQ(0, sched.Next(E(0)).begin);
+  std::atomic<int64_t> got{-1};
+  port::Thread t([&]() { got = sched.Next(E(0)).begin; });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // E(0) already runs max_running jobs
+  ASSERT_EQ(-1, got.load());
+  sched.Complete(1);
+  t.join();
+  ASSERT_EQ(1, got.load());
+}
+
+TEST_F(RemoteFlushSchedulerTest, RemoveExecutorReplacesQueued) {
+  RemoteFlushScheduler sched(FlushPlacementPolicy::kLeastLoaded, 1);
+  sched.AddExecutor(E(0), false);
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(0, 100, 1)));
+  ASSERT_EQ(E(0), sched.Submit(MakeJob(1, 100, 2)));
+  ASSERT_EQ(0, sched.Next(E(0)).begin);
+  sched.AddExecutor(E(1), false);
+  sched.RemoveExecutor(E(0));
+  // the running job left with its executor
+  sched.Complete(1);
+  ASSERT_EQ(1, sched.Next(E(1)).begin);
+  // with nobody left queued jobs wait for the next executor
+  ASSERT_EQ(E(1), sched.Submit(MakeJob(2, 100, 3)));
+  sched.RemoveExecutor(E(1));
+  sched.AddExecutor(E(2), false);
+  ASSERT_EQ(2, sched.Next(E(2)).begin);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
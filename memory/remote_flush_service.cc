@@ -2,10 +2,7 @@
 
 #include <alloca.h>
 #include <arpa/inet.h>
-#include <byteswap.h>
-#include <endian.h>
 #include <getopt.h>
-#include <infiniband/verbs.h>
 #include <inttypes.h>
 #include <netdb.h>
 #include <netinet/in.h>
@@ -18,6 +15,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cassert>
@@ -35,21 +33,15 @@
 #include "db/dbformat.h"
 #include "db/memtable.h"
 #include "db/tcprw.h"
+#include "memory/delegated_read_pool.h"
+#include "memory/remote_flush_scheduler.h"
 #include "memory/remote_memtable_service.h"
 #include "rocksdb/blockingconcurrentqueue.h"
 #include "rocksdb/logger.hpp"
 #include "rocksdb/macro.hpp"
+#include "rocksdb/remote_transfer_service.h"
 
 #define MAX_POLL_CQ_TIMEOUT 2000
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-static inline uint64_t htonll(uint64_t x) { return bswap_64(x); }
-static inline uint64_t ntohll(uint64_t x) { return bswap_64(x); }
-#elif __BYTE_ORDER == __BIG_ENDIAN
-static inline uint64_t htonll(uint64_t x) { return x; }
-static inline uint64_t ntohll(uint64_t x) { return x; }
-#else
-#error __BYTE_ORDER is neither __LITTLE_ENDIAN nor __BIG_ENDIAN
-#endif
 
 namespace ROCKSDB_NAMESPACE {
 
@@ -125,7 +117,8 @@ bool RemoteFlushJobPD::opentcp(int port, int heartbeat_port) {
       char client_ip[INET_ADDRSTRLEN];
       inet_ntop(AF_INET, &client_address.sin_addr, client_ip, INET_ADDRSTRLEN);
       int client_port = ntohs(client_address.sin_port);
-      LOG_CERR("MemNode receive package from: ", client_ip, ':', client_port);
+      DM_LOG_DEBUG("MemNode receive package from: ", client_ip, ':',
+                   client_port);
     }
     auto *node = new TCPNode(client_address, client_sockfd);
     register_flush_job_generator(client_sockfd, node);
@@ -193,10 +186,8 @@ void RemoteFlushJobPD::setfree_flush_job_executor(TCPNode *worker_node) {
 }
 TCPNode *RemoteFlushJobPD::choose_flush_job_executor() {
   std::lock_guard<std::mutex> lock(mtx_);
-  if (!pd_.available_workers_.empty()) {
-    TCPNode *choose_by_policy = nullptr;
-    choose_by_policy = pd_.available_workers_.front();
-    pd_.available_workers_.pop();
+  TCPNode *choose_by_policy = pd_.pop_available_worker();
+  if (choose_by_policy != nullptr) {
     int client_sockfd = socket(AF_INET, SOCK_STREAM, 0);
     assert(client_sockfd != -1);
     char choose_client_ip[INET_ADDRSTRLEN];
@@ -245,8 +236,8 @@ TCPNode *RemoteFlushJobPD::choose_flush_job_executor() {
         inet_ntop(AF_INET, &it.first->connection_info_.sin_addr.sin_addr,
                   client_ip, INET_ADDRSTRLEN);
         int client_port = ntohs(it.first->connection_info_.sin_addr.sin_port);
-        LOG_CERR("MemNode send package to worker: ", client_ip, ':',
-                 client_port);
+        DM_LOG_DEBUG("MemNode send package to worker: ", client_ip, ':',
+                     client_port);
       }
       it.second = false;
       it.first->connection_info_.client_sockfd = client_sockfd;
@@ -267,11 +258,13 @@ RDMANode::RDMANode() {
                       100, 1, 1};
   res = new resources();
   conns_mtx = std::make_unique<std::mutex>();
+  transport_.reset(NewDMTransport(&config));
 }
 
 RDMANode::~RDMANode() {
   resources_destroy();
   conns_mtx.reset(nullptr);
+  transport_.reset();
   delete res;
 }
 
@@ -353,79 +346,8 @@ sock_connect_exit:
   }
 }
 
-int RDMANode::sock_sync_data(int sock, int xfer_size, const char *local_data,
-                             char *remote_data) {
-  int rc = 0;
-  int read_bytes = 0;
-  int total_read_bytes = 0;
-  rc = write(sock, local_data, xfer_size);
-  if (rc < xfer_size)
-    fprintf(stderr, "Failed writing data during sock_sync_data\n");
-  else
-    rc = 0;
-  while (!rc && total_read_bytes < xfer_size) {
-    read_bytes = read(sock, remote_data + total_read_bytes,
-                      xfer_size - total_read_bytes);
-
-    if (read_bytes > 0)
-      total_read_bytes += read_bytes;
-    else
-      rc = read_bytes;
-  }
-  return rc;
-}
-
-int RDMAServer::rr_block_poll_completion(struct rdma_connection *conn,
-                                         std::vector<ibv_wc *> *rr_wc_buf,
-                                         uint64_t wr_id, bool *should_close) {
-  // auto *wc = new struct ibv_wc;
-  int poll_result = 0;
-  auto wr_idx = (wr_id - 1) % (config.max_send_wr + config.max_recv_wr);
-  auto *wc = new struct ibv_wc;
-  for (;;) {
-    if ((*rr_wc_buf)[wr_idx] != nullptr) {
-      auto ret = (*rr_wc_buf)[wr_idx];
-      assert(ret->wr_id == wr_id);
-      delete ret;
-      (*rr_wc_buf)[wr_idx] = nullptr;
-      break;
-    } else {
-      poll_result = ibv_poll_cq(conn->cq, 1, wc);
-      if (*should_close) {
-        if (poll_result > 0 && wc->status == IBV_WC_SUCCESS) {
-          return true;
-        } else {
-          return false;
-        }
-      } else if (poll_result == 0)
-        continue;
-      else if (poll_result < 0) {
-        fprintf(stderr, "poll CQ failed\n");
-        assert(false);
-      } else if (wc->status != IBV_WC_SUCCESS) {
-        fprintf(stderr,
-                "got bad completion with status: 0x%x, vendor syndrome: "
-                "0x%x\n",
-                wc->status, wc->vendor_err);
-        assert(false);
-      } else {
-        if (wc->wr_id != wr_id) {
-          (*rr_wc_buf)[(wc->wr_id - 1) %
-                       (config.max_send_wr + config.max_recv_wr)] = wc;
-          wc = new struct ibv_wc;
-          continue;
-        } else {
-          break;
-        }
-      }
-    }
-  }
-  // find wc
-  delete wc;
-  return true;
-}
 int RDMANode::poll_completion(struct rdma_connection *conn) {
-  struct ibv_wc wc;
+  dm_completion wc;
   unsigned long start_time_msec;
   unsigned long cur_time_msec;
   struct timeval cur_time;
@@ -435,7 +357,7 @@ int RDMANode::poll_completion(struct rdma_connection *conn) {
   gettimeofday(&cur_time, NULL);
   start_time_msec = (cur_time.tv_sec * 1000) + (cur_time.tv_usec / 1000);
   do {
-    poll_result = ibv_poll_cq(conn->cq, 1, &wc);
+    poll_result = transport_->PollCompletion(conn->ep, &wc);
     gettimeofday(&cur_time, NULL);
     cur_time_msec = (cur_time.tv_sec * 1000) + (cur_time.tv_usec / 1000);
   } while ((poll_result == 0) &&
@@ -446,14 +368,12 @@ int RDMANode::poll_completion(struct rdma_connection *conn) {
     rc = 1;
   } else if (poll_result == 0) {  // the CQ is empty
     fprintf(stderr, "completion wasn't found in the CQ after timeout\n");
-    // std::this_thread::sleep_for(std::chrono::milliseconds(100));
     rc = 1;
   } else {
     // CQE found
-    // LOG("completion was found in CQ with status 0x%x\n", wc.status);
     // check the completion status (here we don't care about the completion
     // opcode
-    if (wc.status != IBV_WC_SUCCESS) {
+    if (wc.status != 0) {
       fprintf(stderr,
               "got bad completion with status: 0x%x, vendor syndrome: 0x%x\n",
               wc.status, wc.vendor_err);
@@ -463,417 +383,69 @@ int RDMANode::poll_completion(struct rdma_connection *conn) {
   return rc;
 }
 int RDMANode::post_send(struct rdma_connection *conn, size_t msg_size,
-                        ibv_wr_opcode opcode, long long local_offset,
+                        dm_opcode opcode, long long local_offset,
                         long long remote_offset, uint64_t wr_id) {
-  struct ibv_send_wr sr;
-  struct ibv_sge sge;
-  struct ibv_send_wr *bad_wr = nullptr;
-  int rc = 0;
-  // prepare the scatter/gather entry
-  memset(&sge, 0, sizeof(sge));
-  sge.addr = (uintptr_t)res->buf + local_offset;
-  sge.length = msg_size;
-  sge.lkey = res->mr->lkey;
-  // prepare the send work request
-  memset(&sr, 0, sizeof(sr));
-  sr.next = nullptr;
-  sr.wr_id = wr_id;
-  sr.sg_list = &sge;
-  sr.num_sge = 1;
-  sr.opcode = opcode;
-  sr.send_flags = IBV_SEND_SIGNALED;
-  if (opcode != IBV_WR_SEND) {
-    sr.wr.rdma.remote_addr = res->remote_props.addr + remote_offset;
-    sr.wr.rdma.rkey = res->remote_props.rkey;
-  }
-  // there is a Receive Request in the responder side, so we won't get any into
-  // RNR flow
-  rc = ibv_post_send(conn->qp, &sr, &bad_wr);
-  if (rc)
-    fprintf(stderr, "failed to post SR\n");
-  else {
-    switch (opcode) {
-      case IBV_WR_SEND:
-        // LOG("Send Request was posted\n");
-        break;
-      case IBV_WR_RDMA_READ:
-        // LOG("RDMA Read Request was posted\n");
-        break;
-      case IBV_WR_RDMA_WRITE:
-        // LOG("RDMA Write Request was posted\n");
-        break;
-      default:
-        // LOG("Unknown Request was posted\n");
-        break;
-    }
-  }
-  return rc;
+  return transport_->PostSend(conn->ep, opcode, msg_size, local_offset,
+                              remote_offset, wr_id);
 }
 
 int RDMANode::post_receive(struct rdma_connection *conn, size_t msg_size,
                            long long local_offset, uint64_t wr_id) {
-  struct ibv_recv_wr rr;
-  struct ibv_sge sge;
-  struct ibv_recv_wr *bad_wr;
-  int rc = 0;
-  // prepare the scatter/gather entry
-  memset(&sge, 0, sizeof(sge));
-  sge.addr = (uintptr_t)res->buf + local_offset;
-  sge.length = msg_size;
-  sge.lkey = res->mr->lkey;
-  // prepare the receive work request
-  memset(&rr, 0, sizeof(rr));
-  rr.next = nullptr;
-  rr.wr_id = wr_id;
-  rr.sg_list = &sge;
-  rr.num_sge = 1;
-  // post the Receive Request to the RQ
-  rc = ibv_post_recv(conn->qp, &rr, &bad_wr);
-  if (rc) fprintf(stderr, "failed to post RR\n");
-  // else
-  // 	LOG("Receive Request was posted\n");
-  return rc;
+  return transport_->PostRecv(conn->ep, msg_size, local_offset, wr_id);
 }
 
 int RDMANode::resources_create(uint64_t size) {
-  struct ibv_device **dev_list = nullptr;
-  struct ibv_device *ib_dev = nullptr;
-  int i;
-  int mr_flags = 0;
-  int num_devices;
-  int rc = 0;
-  // LOG("TCP connection was established\n");
-  // LOG("searching for IB devices in host\n");
-  // get device names in the system
-  dev_list = ibv_get_device_list(&num_devices);
-  if (!dev_list) {
-    fprintf(stderr, "failed to get IB devices list\n");
-    rc = 1;
-    goto resources_create_exit;
-  }
-  // if there isn't any IB device in host
-  if (!num_devices) {
-    fprintf(stderr, "found %d device(s)\n", num_devices);
-    rc = 1;
-    goto resources_create_exit;
-  }
-  // LOG("found %d device(s)\n", num_devices);
-  // search for the specific device we want to work with
-  for (i = 0; i < num_devices; i++) {
-    if (config.dev_name == "") {
-      config.dev_name = std::string(strdup(ibv_get_device_name(dev_list[i])));
-      // LOG("device not specified, using first one found: %s\n",
-      // config.dev_name.c_str());
-    }
-    if (config.dev_name == ibv_get_device_name(dev_list[i])) {
-      ib_dev = dev_list[i];
-      break;
-    }
-  }
-  // if the device wasn't found in host
-  if (!ib_dev) {
-    fprintf(stderr, "IB device %s wasn't found\n", config.dev_name.c_str());
-    rc = 1;
-    goto resources_create_exit;
-  }
-  // get device handle
-  res->ib_ctx = ibv_open_device(ib_dev);
-  if (!res->ib_ctx) {
-    fprintf(stderr, "failed to open device %s\n", config.dev_name.c_str());
-    rc = 1;
-    goto resources_create_exit;
-  }
-  // We are now done with device list, free it
-  ibv_free_device_list(dev_list);
-  dev_list = nullptr;
-  ib_dev = nullptr;
-  // query port properties
-  if (ibv_query_port(res->ib_ctx, config.ib_port, &res->port_attr)) {
-    fprintf(stderr, "ibv_query_port on port %u failed\n", config.ib_port);
-    rc = 1;
-    goto resources_create_exit;
-  }
-  // allocate Protection Domain
-  res->pd = ibv_alloc_pd(res->ib_ctx);
-  if (!res->pd) {
-    fprintf(stderr, "ibv_alloc_pd failed\n");
-    rc = 1;
-    goto resources_create_exit;
-  }
-  // allocate the memory buffer that will hold the data
+  // allocate and register the memory buffer that will hold the data
   buf_size = size;
-  res->buf = new char[buf_size]();
-  // register the memory buffer
-  mr_flags =
-      IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
-  res->mr = ibv_reg_mr(res->pd, res->buf, size, mr_flags);
-  if (!res->mr) {
-    fprintf(stderr, "ibv_reg_mr failed with mr_flags=0x%x\n", mr_flags);
-    rc = 1;
-    goto resources_create_exit;
-  }
-  // LOG("MR was registered with addr=%p, lkey=0x%x, rkey=0x%x, flags=0x%x\n",
-  // 		res->buf, res->mr->lkey, res->mr->rkey, mr_flags);
-resources_create_exit:
-  if (rc) {
-    // Error encountered, cleanup
-    if (res->mr) {
-      ibv_dereg_mr(res->mr);
-      res->mr = nullptr;
-    }
-    if (res->buf) {
-      delete[] res->buf;
-      res->buf = nullptr;
-    }
-    if (res->pd) {
-      ibv_dealloc_pd(res->pd);
-      res->pd = nullptr;
-    }
-    if (res->ib_ctx) {
-      ibv_close_device(res->ib_ctx);
-      res->ib_ctx = nullptr;
-    }
-    if (dev_list) {
-      ibv_free_device_list(dev_list);
-      dev_list = nullptr;
-    }
+  res->buf = transport_->RegisterMemory(size);
+  if (res->buf == nullptr) {
+    fprintf(stderr, "failed to register %lu bytes over %s transport\n", size,
+            transport_->Name());
+    return 1;
   }
-  return rc;
+  return 0;
 }
 
 struct RDMANode::rdma_connection *RDMANode::connect_qp(int sock) {
-  int rc = 0;
   auto conn = new struct rdma_connection();
-  conn->cq = nullptr;
-  conn->qp = nullptr;
   conn->sock = sock;
-  struct ibv_qp_init_attr qp_init_attr;
-  // each side will send only one WR, so Completion Queue with 1 entry is enough
-  conn->cq = ibv_create_cq(res->ib_ctx, config.max_cqe, nullptr, nullptr, 0);
-  if (!conn->cq) {
-    fprintf(stderr, "failed to create CQ with %u entries\n", config.max_cqe);
-    rc = 1;
-    goto connect_qp_exit;
-  }
-  // create the Queue Pair
-  memset(&qp_init_attr, 0, sizeof(qp_init_attr));
-  qp_init_attr.qp_type = IBV_QPT_RC;
-  qp_init_attr.sq_sig_all = 1;
-  qp_init_attr.send_cq = conn->cq;
-  qp_init_attr.recv_cq = conn->cq;
-  qp_init_attr.cap.max_send_wr = config.max_send_wr;
-  qp_init_attr.cap.max_recv_wr = config.max_recv_wr;
-  qp_init_attr.cap.max_send_sge = 1;
-  qp_init_attr.cap.max_recv_sge = 1;
-  conn->qp = ibv_create_qp(res->pd, &qp_init_attr);
-  if (!conn->qp) {
-    fprintf(stderr, "failed to create QP\n");
-    rc = 1;
-    goto connect_qp_exit;
-  }
-  // LOG("QP was created, QP number=0x%x\n", res->qp->qp_num);
-
-  struct cm_con_data_t local_con_data;
-  struct cm_con_data_t remote_con_data;
-  struct cm_con_data_t tmp_con_data;
-  char temp_char;
-  union ibv_gid my_gid;
-  if (config.gid_idx >= 0) {
-    rc = ibv_query_gid(res->ib_ctx, config.ib_port, config.gid_idx, &my_gid);
-    if (rc) {
-      fprintf(stderr, "could not get gid for port %d, index %d\n",
-              config.ib_port, config.gid_idx);
-      goto connect_qp_exit;
-    }
-  } else
-    memset(&my_gid, 0, sizeof my_gid);
-  // exchange using TCP sockets info required to connect QPs
-  local_con_data.addr = htonll((uintptr_t)res->buf);
-  local_con_data.rkey = htonl(res->mr->rkey);
-  local_con_data.qp_num = htonl(conn->qp->qp_num);
-  local_con_data.lid = htons(res->port_attr.lid);
-  memcpy(local_con_data.gid, &my_gid, 16);
-  // LOG("\nLocal LID = 0x%x\n", res->port_attr.lid);
-  if (sock_sync_data(conn->sock, sizeof(struct cm_con_data_t),
-                     (char *)&local_con_data, (char *)&tmp_con_data) < 0) {
-    fprintf(stderr, "failed to exchange connection data between sides\n");
-    rc = 1;
-    goto connect_qp_exit;
-  }
-  remote_con_data.addr = ntohll(tmp_con_data.addr);
-  remote_con_data.rkey = ntohl(tmp_con_data.rkey);
-  remote_con_data.qp_num = ntohl(tmp_con_data.qp_num);
-  remote_con_data.lid = ntohs(tmp_con_data.lid);
-  memcpy(remote_con_data.gid, tmp_con_data.gid, 16);
-  // save the remote side attributes, we will need it for the post SR
-  res->remote_props = remote_con_data;
-  // LOG("Remote address = ", static_cast<unsigned long
-  // long>(remote_con_data.addr), "\n"); LOG("Remote rkey = ",
-  // static_cast<unsigned long long>(remote_con_data.rkey), "\n"); LOG("Remote
-  // QP number = ", static_cast<unsigned long long>(remote_con_data.qp_num),
-  // "\n"); LOG("Remote LID = ", static_cast<unsigned long
-  // long>(remote_con_data.lid), "\n");
-  if (config.gid_idx >= 0) {
-    uint8_t *p = remote_con_data.gid;
-    // LOG("Remote GID =", p[0], ":", p[1], ":", p[2], ":", p[3], ":", p[4],
-    // ":", p[5], ":", p[6], ":", p[7], ":", p[8],
-    // 	":", p[9], ":", p[10], ":", p[11], ":", p[12], ":", p[13], ":",
-    // p[14],
-    // ":", p[15], "\n");
-  }
-  // modify the QP to init
-  rc = modify_qp_to_init(conn->qp);
-  if (rc) {
-    fprintf(stderr, "change QP state to INIT failed\n");
-    goto connect_qp_exit;
-  }
-  // modify the QP to RTR
-  rc = modify_qp_to_rtr(conn->qp, remote_con_data.qp_num, remote_con_data.lid,
-                        remote_con_data.gid);
-  if (rc) {
-    fprintf(stderr, "failed to modify QP state to RTR\n");
-    goto connect_qp_exit;
-  }
-  rc = modify_qp_to_rts(conn->qp);
-  if (rc) {
-    fprintf(stderr, "failed to modify QP state to RTR\n");
-    goto connect_qp_exit;
-  }
-  // LOG("QP state was change to RTS\n");
-  // sync to make sure that both sides are in states that they can connect to
-  // prevent packet loose
-  if (sock_sync_data(conn->sock, 1, "Q",
-                     &temp_char)) {  // just send a dummy char back and forth
-    fprintf(stderr, "sync error after QPs are were moved to RTS\n");
-    rc = 1;
-  }
-connect_qp_exit:
-  if (rc) {
-    if (conn->qp) ibv_destroy_qp(conn->qp);
-    if (conn->cq) ibv_destroy_cq(conn->cq);
+  conn->ep = transport_->Connect(sock);
+  if (conn->ep == nullptr) {
     if (conn->sock >= 0) {
       if (close(conn->sock)) fprintf(stderr, "failed to close socket\n");
     }
     delete conn;
     return nullptr;
-  } else {
-    {
-      std::lock_guard<std::mutex> lk(*conns_mtx);
-      res->conns.push_back(conn);
-    }
-    after_connect_qp(conn);
   }
+  {
+    std::lock_guard<std::mutex> lk(*conns_mtx);
+    res->conns.push_back(conn);
+  }
+  after_connect_qp(conn);
   return conn;
 }
 
+void RDMANode::destroy_connection(struct rdma_connection *conn) {
+  if (conn->ep) transport_->Disconnect(conn->ep);
+  conn->ep = nullptr;
+  if (conn->sock >= 0) {
+    if (close(conn->sock)) fprintf(stderr, "failed to close socket\n");
+    conn->sock = -1;
+  }
+  delete conn;
+}
+
 int RDMANode::resources_destroy() {
-  int rc = 0;
   {
     std::lock_guard<std::mutex> lk(*conns_mtx);
-    for (auto &conn : res->conns) {
-      if (conn->qp)
-        if (ibv_destroy_qp(conn->qp)) {
-          fprintf(stderr, "failed to destroy QP\n");
-          rc = 1;
-        }
-      if (conn->cq)
-        if (ibv_destroy_cq(conn->cq)) {
-          fprintf(stderr, "failed to destroy CQ\n");
-          rc = 1;
-        }
-      if (conn->sock >= 0)
-        if (close(conn->sock)) {
-          fprintf(stderr, "failed to close socket\n");
-          rc = 1;
-        }
-      delete conn;
-    }
+    for (auto &conn : res->conns) destroy_connection(conn);
     res->conns.clear();
   }
-  if (res->mr)
-    if (ibv_dereg_mr(res->mr)) {
-      fprintf(stderr, "failed to deregister MR\n");
-      rc = 1;
-    }
+  int rc = 0;
   if (res->buf) {
-    delete[] res->buf;
+    rc = transport_->DeregisterMemory();
     res->buf = nullptr;
   }
-  if (res->pd)
-    if (ibv_dealloc_pd(res->pd)) {
-      fprintf(stderr, "failed to deallocate PD\n");
-      rc = 1;
-    }
-  if (res->ib_ctx)
-    if (ibv_close_device(res->ib_ctx)) {
-      fprintf(stderr, "failed to close device context\n");
-      rc = 1;
-    }
-  return rc;
-}
-
-int RDMANode::modify_qp_to_init(struct ibv_qp *qp) {
-  struct ibv_qp_attr attr;
-  int flags;
-  int rc = 0;
-  memset(&attr, 0, sizeof(attr));
-  attr.qp_state = IBV_QPS_INIT;
-  attr.port_num = config.ib_port;
-  attr.pkey_index = 0;
-  attr.qp_access_flags =
-      IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
-  flags = IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS;
-  rc = ibv_modify_qp(qp, &attr, flags);
-  if (rc) fprintf(stderr, "failed to modify QP state to INIT\n");
-  return rc;
-}
-int RDMANode::modify_qp_to_rtr(struct ibv_qp *qp, uint32_t remote_qpn,
-                               uint16_t dlid, uint8_t *dgid) {
-  struct ibv_qp_attr attr;
-  int flags;
-  int rc = 0;
-  memset(&attr, 0, sizeof(attr));
-  attr.qp_state = IBV_QPS_RTR;
-  attr.path_mtu = IBV_MTU_256;
-  attr.dest_qp_num = remote_qpn;
-  attr.rq_psn = 0;
-  attr.max_dest_rd_atomic = 1;
-  attr.min_rnr_timer = 0x12;
-  attr.ah_attr.is_global = 0;
-  attr.ah_attr.dlid = dlid;
-  attr.ah_attr.sl = 0;
-  attr.ah_attr.src_path_bits = 0;
-  attr.ah_attr.port_num = config.ib_port;
-  if (config.gid_idx >= 0) {
-    attr.ah_attr.is_global = 1;
-    attr.ah_attr.port_num = 1;
-    memcpy(&attr.ah_attr.grh.dgid, dgid, 16);
-    attr.ah_attr.grh.flow_label = 0;
-    attr.ah_attr.grh.hop_limit = 1;
-    attr.ah_attr.grh.sgid_index = config.gid_idx;
-    attr.ah_attr.grh.traffic_class = 0;
-  }
-  flags = IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN |
-          IBV_QP_RQ_PSN | IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER;
-  rc = ibv_modify_qp(qp, &attr, flags);
-  if (rc) fprintf(stderr, "failed to modify QP state to RTR\n");
-  return rc;
-}
-int RDMANode::modify_qp_to_rts(struct ibv_qp *qp) {
-  struct ibv_qp_attr attr;
-  int flags;
-  int rc = 0;
-  memset(&attr, 0, sizeof(attr));
-  attr.qp_state = IBV_QPS_RTS;
-  attr.timeout = 0x12;
-  attr.retry_cnt = 6;
-  attr.rnr_retry = 0;
-  attr.sq_psn = 0;
-  attr.max_rd_atomic = 1;
-  flags = IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY |
-          IBV_QP_SQ_PSN | IBV_QP_MAX_QP_RD_ATOMIC;
-  rc = ibv_modify_qp(qp, &attr, flags);
-  if (rc) fprintf(stderr, "failed to modify QP state to RTS\n");
   return rc;
 }
 
@@ -897,7 +469,7 @@ int RDMAReadClient::rr_block_poll_completion(struct rdma_connection *conn,
                                              uint64_t wr_id) {
   int poll_result = 0;
   auto wr_idx = (wr_id - 1) % 2;
-  auto *wc = new struct ibv_wc;
+  auto *wc = new dm_completion;
   int pending_count = 0;
   for (;;) {
     if (rr_wc_buf[wr_idx] != nullptr) {
@@ -907,11 +479,11 @@ int RDMAReadClient::rr_block_poll_completion(struct rdma_connection *conn,
       rr_wc_buf[wr_idx] = nullptr;
       break;
     } else {
-      poll_result = ibv_poll_cq(conn->cq, 1, wc);
-      if (poll_result > 0 && wc->status == IBV_WC_SUCCESS) {
+      poll_result = transport_->PollCompletion(conn->ep, wc);
+      if (poll_result > 0 && wc->status == 0) {
         if ((wc->wr_id - 1) % 2 != wr_idx) {
           rr_wc_buf[(wc->wr_id - 1) % 2] = wc;
-          wc = new struct ibv_wc;
+          wc = new dm_completion;
           continue;
         } else {
           break;
@@ -922,7 +494,7 @@ int RDMAReadClient::rr_block_poll_completion(struct rdma_connection *conn,
       } else if (poll_result < 0) {
         fprintf(stderr, "poll CQ failed\n");
         assert(false);
-      } else if (wc->status != IBV_WC_SUCCESS) {
+      } else if (wc->status != 0) {
         fprintf(stderr,
                 "got bad completion with status: 0x%x, vendor syndrome: "
                 "0x%x\n",
@@ -931,7 +503,7 @@ int RDMAReadClient::rr_block_poll_completion(struct rdma_connection *conn,
         return 0;
       } else if (wc->wr_id != wr_id) {
         rr_wc_buf[(wc->wr_id - 1) % 2] = wc;
-        wc = new struct ibv_wc;
+        wc = new dm_completion;
         continue;
       } else {
         break;
@@ -944,11 +516,26 @@ int RDMAReadClient::rr_block_poll_completion(struct rdma_connection *conn,
 }
 
 RDMAServer::RDMAServer() : RDMANode() {
-  mempool_mtx = std::make_unique<std::mutex>();
-  remote_memtable_pool_ = new RemoteMemTablePool();
+  pinned_mem_ = std::make_unique<RegisteredBufferAllocator>();
+  remote_memtable_pool_ =
+      new RemoteMemTablePool([this](uint64_t offset, uint64_t size) {
+        if (size == 0) return;
+        if (!unpin_mem(offset, size)) {
+          DM_LOG_WARN("unpin rmem failed :: ", offset, " ", size);
+        }
+      });
+  read_pool_ = std::make_unique<DelegatedReadPool>(
+      this, DelegatedReadPool::DefaultPollers(),
+      DelegatedReadPool::DefaultWorkers());
+  FlushPlacementPolicy placement = DefaultFlushPlacementPolicy();
+  DM_LOG_INFO("memnode flush placement: ",
+              FlushPlacementPolicyName(placement));
+  flush_scheduler_ = std::make_unique<RemoteFlushScheduler>(
+      placement, RemoteFlushScheduler::kDefaultMaxRunning);
 }
 
 RDMAServer::~RDMAServer() {
+  read_pool_.reset();
   delete remote_memtable_pool_;
   remote_memtable_pool_ = nullptr;
 }
@@ -964,6 +551,63 @@ void RDMAServer::free_mem_service(struct rdma_connection *conn) {
   }
 }
 
+void RDMAServer::capacity_service(struct rdma_connection *conn) {
+  pinned_mem_->Init(buf_size);
+  auto stats = pinned_mem_->GetStats();
+  memnode_capacity cap{stats.capacity, stats.free, stats.largest_free};
+  ASSERT_RW(writen(conn->sock, reinterpret_cast<char *>(&cap), sizeof(cap)) ==
+            sizeof(cap));
+}
+
+memnode_capacity RDMAClient::capacity_request(struct rdma_connection *conn) {
+  char req_type = 13;
+  ASSERT_RW(writen(conn->sock, &req_type, sizeof(char)) == sizeof(char));
+  memnode_capacity cap{0, 0, 0};
+  ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&cap), sizeof(cap)) ==
+            sizeof(cap));
+  return cap;
+}
+
+void RDMAServer::list_memtables_service(struct rdma_connection *conn) {
+  uint64_t db_tag = 0;
+  uint32_t cf_id = 0;
+  ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&db_tag),
+                  sizeof(db_tag)) == sizeof(db_tag));
+  ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&cf_id),
+                  sizeof(cf_id)) == sizeof(cf_id));
+  std::vector<memtable_recovery_entry> entries =
+      remote_memtable_pool_->list(db_tag, cf_id);
+  uint64_t count = entries.size();
+  ASSERT_RW(writen(conn->sock, reinterpret_cast<char *>(&count),
+                   sizeof(count)) == sizeof(count));
+  if (count > 0) {
+    size_t bytes = sizeof(memtable_recovery_entry) * count;
+    ASSERT_RW(writen(conn->sock, reinterpret_cast<char *>(entries.data()),
+                     bytes) == static_cast<ssize_t>(bytes));
+  }
+  DM_LOG_INFO("listed ", count, " memtables of cf ", cf_id);
+}
+
+std::vector<memtable_recovery_entry> RDMAClient::list_memtables_request(
+    struct rdma_connection *conn, uint64_t db_tag, uint32_t cf_id) {
+  char req_type = 14;
+  ASSERT_RW(writen(conn->sock, &req_type, sizeof(char)) == sizeof(char));
+  ASSERT_RW(writen(conn->sock, reinterpret_cast<char *>(&db_tag),
+                   sizeof(db_tag)) == sizeof(db_tag));
+  ASSERT_RW(writen(conn->sock, reinterpret_cast<char *>(&cf_id),
+                   sizeof(cf_id)) == sizeof(cf_id));
+  uint64_t count = 0;
+  ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&count),
+                  sizeof(count)) == sizeof(count));
+  std::vector<memtable_recovery_entry> entries(count);
+  if (count > 0) {
+    size_t bytes = sizeof(memtable_recovery_entry) * count;
+    ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(entries.data()),
+                    bytes) == static_cast<ssize_t>(bytes));
+  }
+  return entries;
+}
+
 void RDMAClient::free_mem_request(struct rdma_connection *conn, int64_t addr,
                                   int64_t size) {
   int64_t val[2] = {addr, size};
@@ -972,45 +616,81 @@ void RDMAClient::free_mem_request(struct rdma_connection *conn, int64_t addr,
 
 void RDMAServer::create_rmem_service(struct rdma_connection *conn) {
   fprintf(stderr, "Received request for rmemtable store\n");
-  // allocate_mem_service(conn, meta_offset, meta_size);
-  // LOG_CERR("create_rmem_service:: index creaated");
-  int64_t mem_meta_offset = 0, mem_meta_size = 0;
-  allocate_mem_service(conn, mem_meta_offset, mem_meta_size);
-  if (mem_meta_size == 0) {
-    fprintf(stderr, "Failed to allocate meta memory\n");
-    assert(false);
+  int32_t shard_num = 0;
+  ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&shard_num),
+                  sizeof(int32_t)) == sizeof(int32_t));
+  int64_t block_size = 0;
+  ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&block_size),
+                  sizeof(int64_t)) == sizeof(int64_t));
+  if (shard_num <= 0 || shard_num > kMaxMemTableShards || block_size <= 0) {
+    DM_LOG_WARN("memtable of ", shard_num, " shards of ", block_size,
+                " bytes refused, malformed request");
+    char admitted = 0;
+    ASSERT_RW(writen(conn->sock, &admitted, sizeof(char)) == sizeof(char));
+    return;
   }
-  LOG_CERR("create_rmem_service:: meta creaated");
-  for (int i = 0; i < 4 /*sep*/; i++) {
-    std::pair<int64_t, int64_t> shard{0, 0};
-    allocate_mem_service(conn, shard.first, shard.second);
-    if (shard.second == 0) {
-      fprintf(stderr, "Failed to allocate shard memory\n");
-      assert(false);
+  // pin the meta block and every shard before admitting the memtable, one
+  // this memnode cannot hold stays on the compute node instead of waiting
+  // here for other memtables to be freed
+  std::vector<int64_t> blocks;
+  for (int i = 0; i <= shard_num; i++) {
+    int64_t offset = try_pin_mem(block_size, kAdmitWait);
+    if (offset == -1) {
+      break;
+    }
+    blocks.push_back(offset);
+  }
+  char admitted = blocks.size() == static_cast<size_t>(shard_num) + 1;
+  if (!admitted) {
+    DM_LOG_WARN("memtable of ", shard_num, " shards refused: ",
+                pinned_mem_->GetStats().ToString());
+    for (int64_t offset : blocks) {
+      unpin_mem(offset, block_size);
     }
   }
-  LOG_CERR("create_rmem_service:: data creaated");
+  ASSERT_RW(writen(conn->sock, &admitted, sizeof(char)) == sizeof(char));
+  if (!admitted) {
+    return;
+  }
+  // the client asks for the meta block first, then for each shard
+  for (int64_t offset : blocks) {
+    hand_out_mem_service(conn, offset, block_size);
+  }
+  DM_LOG_DEBUG("create_rmem_service:: data creaated");
 }
 
 void RDMAServer::receive_rmem_service(struct rdma_connection *conn) {
   std::chrono::high_resolution_clock::time_point t1 =
       std::chrono::high_resolution_clock::now();
-  uint64_t info[12] = {0};
-  ASSERT_RW(readn(conn->sock, info, sizeof(uint64_t) * 12) ==
-            sizeof(uint64_t) * 12);
+  uint64_t info[RMEM_INFO_WORDS] = {0};
+  ASSERT_RW(readn(conn->sock, info, sizeof(uint64_t) * RMEM_INFO_WORDS) ==
+            sizeof(uint64_t) * RMEM_INFO_WORDS);
   std::chrono::high_resolution_clock::time_point t2 =
       std::chrono::high_resolution_clock::now();
-  int64_t index_offset = pin_mem(93);
-  std::memcpy(get_buf() + index_offset, get_buf() + info[0], info[1]);
-  Status s = remote_memtable_pool_->rebuild_remote_memtable(
-      get_buf(), index_offset /*need to reuse index*/, info[1], info[2],
-      info[3], info + 4);
+  // the client keeps the memtable queued and sends it again when refused
+  int64_t index_offset = try_pin_mem(MEMTABLE_INDEX_SIZE, kAdmitWait);
+  Status s;
+  if (index_offset == -1) {
+    s = Status::MemoryLimit("no room for the memtable index",
+                            pinned_mem_->GetStats().ToString());
+  } else {
+    std::memcpy(get_buf() + index_offset, get_buf() + info[0], info[1]);
+    s = remote_memtable_pool_->rebuild_remote_memtable(
+        get_buf(), index_offset /*need to reuse index*/, info[1], info[2],
+        info[3], info + 4);
+  }
   char ret = 1;
+  if (!s.ok() && !s.IsExpired()) {
+    // an Expired duplicate keeps the memtable already here
+    DM_LOG_WARN("memtable refused: ", s.ToString());
+    if (index_offset != -1) unpin_mem(index_offset, MEMTABLE_INDEX_SIZE);
+    ret = 0;
+  }
   ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret), sizeof(char)) ==
             sizeof(char));
   std::chrono::high_resolution_clock::time_point t3 =
       std::chrono::high_resolution_clock::now();
-  LOG_CERR(
+  DM_LOG_DEBUG(
       "store rmem:: ",
       std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count(),
       ' ',
@@ -1020,28 +700,25 @@ void RDMAServer::receive_rmem_service(struct rdma_connection *conn) {
 void RDMAServer::receive_remote_flush_service(struct rdma_connection *conn,
                                               int64_t &meta_offset,
                                               int64_t &meta_size) {
-  int64_t meta_buf_offset = -1;
-  int failed_try = 0;
-  while (true) {
-    LOG_CERR("try PinMem Receive Remote Flush Service::0");
-    meta_buf_offset = pin_mem(meta_size);
-    if (meta_buf_offset == -1) {
-      std::this_thread::sleep_for(
-          std::chrono::milliseconds(100 * (failed_try++)));
-      fprintf(stderr, "Failed to pin MR memory, retrying\n");
-    } else {
-      LOG_CERR("try PinMem Receive Remote Flush Service::1");
-      break;
-    }
+  DM_LOG_DEBUG("try PinMem Receive Remote Flush Service::0");
+  int64_t meta_buf_offset = try_pin_mem(meta_size, kAdmitWait);
+  DM_LOG_DEBUG("try PinMem Receive Remote Flush Service::1");
+  char ret_op = meta_buf_offset == -1 ? 0 : 1;
+  if (meta_buf_offset == -1) {
+    // the compute node keeps the memtables and flushes them again
+    DM_LOG_WARN("remote flush refused, no room for its package of ",
+                meta_size, " bytes: ", pinned_mem_->GetStats().ToString());
+    ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret_op),
+                     sizeof(char)) == sizeof(char));
+    return;
   }
   std::memcpy(get_buf() + meta_buf_offset, get_buf() + meta_offset, meta_size);
-  char ret_op = 1;
   ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret_op),
                    sizeof(char)) == sizeof(char));
-  LOG_CERR("try PinMem Receive Remote Flush Service::2");
+  DM_LOG_DEBUG("try PinMem Receive Remote Flush Service::2");
   std::pair<int64_t, int64_t> job_mem_tobe_registered{
       meta_buf_offset, meta_size + meta_buf_offset};
-  ASSERT_RW(choose_flush_job_executor(job_mem_tobe_registered) != nullptr);
+  choose_flush_job_executor(job_mem_tobe_registered);
 }
 
 // return remote_offset , remote_end
@@ -1067,60 +744,72 @@ void RDMAServer::allocate_mem_service(struct rdma_connection *conn,
   ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&size),
                   sizeof(int64_t)) == sizeof(int64_t));
 
-  int failed_try = 1;
-  while (true) {
-    int64_t pin_begin = pin_mem(size);
-    if (pin_begin == -1) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(100 * failed_try));
-      fprintf(stderr, "Failed to pin MR memory, retrying\n");
-    } else {
-      ret[0] = pin_begin;
-      ret[1] = pin_begin + size;
-      ret_size = size;
-      ret_offset = pin_begin;
-      break;
+  // a full memnode answers -1 rather than keeping the client waiting
+  int64_t pin_begin = try_pin_mem(size, kAdmitWait);
+  ret[0] = pin_begin;
+  ret[1] = pin_begin == -1 ? -1 : pin_begin + size;
+  ret_size = pin_begin == -1 ? 0 : size;
+  ret_offset = pin_begin;
+  if (pin_begin == -1) {
+    DM_LOG_WARN("Failed to pin ", size, " bytes of MR memory: ",
+                pinned_mem_->GetStats().ToString());
+  }
+  DM_LOG_DEBUG("allocate remote mem: ", ret[0], ret[1], ", size = ", size);
+  ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(ret),
+                   sizeof(int64_t) * 2) == sizeof(int64_t) * 2);
+}
+
+void RDMAServer::hand_out_mem_service(struct rdma_connection *conn,
+                                      int64_t offset, int64_t pinned) {
+  int64_t size = 0;
+  ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&size),
+                  sizeof(int64_t)) == sizeof(int64_t));
+  if (size > pinned) {
+    // the client asked for more than it announced
+    unpin_mem(offset, pinned);
+    offset = try_pin_mem(size, kAdmitWait);
+    if (offset == -1) {
+      DM_LOG_WARN("Failed to pin ", size, " bytes of MR memory: ",
+                  pinned_mem_->GetStats().ToString());
     }
   }
-  LOG_CERR("allocate remote mem: ", ret[0], ret[1], ", size = ", size);
+  int64_t ret[2] = {offset, offset == -1 ? -1 : offset + size};
   ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(ret),
                    sizeof(int64_t) * 2) == sizeof(int64_t) * 2);
 }
 
 struct RDMANode::rdma_connection *RDMAServer::choose_flush_job_executor(
     const std::pair<int64_t, int64_t> &job_mem_tobe_registered) {
-  bool ret = true;
-  if (!pd_.available_workers_.empty()) {
-    // choose by scheduler
-    TCPNode *choose_by_policy = pd_.available_workers_.front();
-    pd_.available_workers_.pop();
-    char choose_client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &choose_by_policy->connection_info_.sin_addr.sin_addr,
-              choose_client_ip, INET_ADDRSTRLEN);
-    // find executor by ip
-    for (auto &it : executors_) {
-      char client_ip[INET_ADDRSTRLEN];
-      inet_ntop(AF_INET, &it.first->addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-      if (strcmp(client_ip, choose_client_ip) == 0) {
-        LOG_CERR("choose executor by scheduler: ", client_ip, ' ',
-                 job_mem_tobe_registered.first, ' ',
-                 job_mem_tobe_registered.second);
-        it.second.status++;
-        it.second.flush_job_queue.enqueue(job_mem_tobe_registered);
-        return it.first;
-      }
+  RemoteFlushScheduler::Job job;
+  job.begin = job_mem_tobe_registered.first;
+  job.end = job_mem_tobe_registered.second;
+  // the package starts with the address of the generator and the mixed ids
+  // of the memtables to flush, size the job by their shards when they live
+  // on this memnode
+  PackageReadService package(get_buf() + job.begin, job.end - job.begin);
+  int generator_port = 0;
+  package.receive(&generator_port, sizeof(int));
+  size_t ip_size = 0;
+  package.receive(&ip_size, sizeof(size_t));
+  std::string generator_ip(ip_size, '\0');
+  if (ip_size > 0) package.receive(&generator_ip[0], ip_size);
+  auto guard = remote_memtable_pool_->Pin();
+  size_t mem_size = 0;
+  package.receive(&mem_size, sizeof(size_t));
+  for (size_t i = 0; i < mem_size; i++) {
+    uint64_t mixed_id = 0;
+    package.receive(&mixed_id, sizeof(uint64_t));
+    uint64_t bytes = 0;
+    RemoteMemTable *rmem = remote_memtable_pool_->get(mixed_id);
+    if (rmem != nullptr) {
+      for (auto &shard : rmem->data) bytes += shard.second;
     }
-  } else {
-    // choose randomly
-    int rd = rand() % executors_.size();
-    auto it = executors_.begin();
-    for (int cnt = 0; cnt < rd; cnt++) it++;
-    LOG_CERR("choose executor randomly: ", job_mem_tobe_registered.first, ' ',
-             job_mem_tobe_registered.second);
-    it->second.status++;
-    it->second.flush_job_queue.enqueue(job_mem_tobe_registered);
-    return it->first;
+    job.memtables.emplace_back(mixed_id, bytes);
+    job.bytes += bytes;
   }
-  return nullptr;
+  if (job.bytes == 0) job.bytes = job.end - job.begin;
+  // with no executor yet the job waits for the first one to register
+  return flush_scheduler_->Submit(std::move(job));
 }
 
 bool RDMAClient::disconnect_request(struct rdma_connection *conn) {
@@ -1132,21 +821,13 @@ bool RDMAClient::disconnect_request(struct rdma_connection *conn) {
   ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&ret), sizeof(bool)) ==
             sizeof(bool));
   if (ret) {
-    if (conn->qp) ibv_destroy_qp(conn->qp);
-    conn->qp = nullptr;
-    if (conn->cq) ibv_destroy_cq(conn->cq);
-    conn->cq = nullptr;
-    if (conn->sock >= 0) {
-      if (close(conn->sock)) fprintf(stderr, "failed to close socket\n");
-      conn->sock = -1;
-    }
     std::lock_guard<std::mutex> lk(*conns_mtx);
     for (auto iter = res->conns.begin(); iter != res->conns.end(); iter++)
       if (*iter == conn) {
         res->conns.erase(iter);
         break;
       }
-    delete conn;
+    destroy_connection(conn);
   }
   return ret;
 }
@@ -1154,21 +835,13 @@ void RDMAServer::disconnect_service(struct rdma_connection *conn) {
   bool ret = true;
   int local_size = sizeof(bool);
   ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret), local_size));
-  if (conn->qp) ibv_destroy_qp(conn->qp);
-  conn->qp = nullptr;
-  if (conn->cq) ibv_destroy_cq(conn->cq);
-  conn->cq = nullptr;
-  if (conn->sock >= 0) {
-    if (close(conn->sock)) fprintf(stderr, "failed to close socket\n");
-    conn->sock = -1;
-  }
   std::lock_guard<std::mutex> lk(*conns_mtx);
   for (auto iter = res->conns.begin(); iter != res->conns.end(); iter++)
     if (*iter == conn) {
       res->conns.erase(iter);
       break;
     }
-  delete conn;
+  destroy_connection(conn);
 }
 bool RDMAClient::register_executor_request(struct rdma_connection *conn) {
   char req_type = 3;
@@ -1180,76 +853,114 @@ bool RDMAClient::register_executor_request(struct rdma_connection *conn) {
   return ret;
 }
 
-void RDMAClient::fetch_memtable_request(struct rdma_connection *conn,
-                                        uint64_t mixed_id, void *&index,
-                                        uint64_t &index_size, void *&mem_meta,
-                                        uint64_t &meta_size,
-                                        std::pair<void *, uint64_t> *mem_data) {
+Status RDMAClient::locate_memtable_request(
+    struct rdma_connection *conn, uint64_t mixed_id, void *&index,
+    uint64_t &index_size, void *&mem_meta, uint64_t &meta_size,
+    std::pair<int64_t, uint64_t> *remote_data) {
   bool found = false;
-  int64_t ret[12];
+  int64_t ret[RMEM_INFO_WORDS];
   while (!found) {
     ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&mixed_id),
                      sizeof(uint64_t)) == sizeof(uint64_t));
     ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(ret),
-                    sizeof(int64_t) * 12) == sizeof(int64_t) * 12);
+                    sizeof(int64_t) * RMEM_INFO_WORDS) ==
+              sizeof(int64_t) * RMEM_INFO_WORDS);
     if (ret[0] == -1) {
       std::this_thread::sleep_for(std::chrono::milliseconds(100));
-      LOG_CERR("refetch rmem: ", mixed_id);
+      DM_LOG_WARN("refetch rmem: ", mixed_id);
     } else {
       break;
     }
   }
   index_size = ret[2];
   meta_size = ret[3];
-  int64_t local_index_offset = rdma_mem_.allocate(index_size);
+  // the memnode expects nothing more for this request, it is fine to give
+  // up here
+  int64_t local_index_offset = -1, local_meta_offset = -1;
+  Status s = rdma_mem_.allocate_wait(index_size, &local_index_offset);
+  if (!s.ok()) return s;
+  s = rdma_mem_.allocate_wait(meta_size, &local_meta_offset);
+  if (!s.ok()) {
+    rdma_mem_.free(local_index_offset);
+    return s;
+  }
   index = get_buf() + local_index_offset;
-  int64_t local_meta_offset = rdma_mem_.allocate(meta_size);
   mem_meta = get_buf() + local_meta_offset;
-  std::vector<int64_t> local_mem_offset(4 /*sep*/);
-  for (int i = 0; i < 4 /*sep*/; i++) {
-    mem_data[i].second = ret[5 + i * 2];
-    local_mem_offset[i] = rdma_mem_.allocate(mem_data[i].second);
-    mem_data[i].first = get_buf() + local_mem_offset[i];
-    rdma_read(conn, mem_data[i].second, local_mem_offset[i], ret[4 + i * 2]);
-    ASSERT_RW(poll_completion(conn) == 0);
+  // shards past the shard count of the memtable come back empty
+  for (int i = 0; i < kMaxMemTableShards; i++) {
+    remote_data[i].first = ret[4 + i * 2];
+    remote_data[i].second = ret[5 + i * 2] > 0 ? ret[5 + i * 2] : 0;
   }
 
   rdma_read(conn, index_size, local_index_offset, ret[0]);
   ASSERT_RW(poll_completion(conn) == 0);
   rdma_read(conn, meta_size, local_meta_offset, ret[1]);
   ASSERT_RW(poll_completion(conn) == 0);
+  return Status::OK();
+}
+
+Status RDMAClient::fetch_memtable_request(
+    struct rdma_connection *conn, uint64_t mixed_id, void *&index,
+    uint64_t &index_size, void *&mem_meta, uint64_t &meta_size,
+    std::pair<void *, uint64_t> *mem_data) {
+  std::pair<int64_t, uint64_t> remote_data[kMaxMemTableShards];
+  Status s = locate_memtable_request(conn, mixed_id, index, index_size,
+                                     mem_meta, meta_size, remote_data);
+  for (int i = 0;
+       s.ok() && i < kMaxMemTableShards && remote_data[i].second > 0; i++) {
+    int64_t local_offset = -1;
+    s = rdma_mem_.allocate_wait(remote_data[i].second, &local_offset);
+    if (!s.ok()) {
+      // hand back what this memtable took so far
+      for (int j = 0; j < i; j++) {
+        rdma_mem_.free(reinterpret_cast<char *>(mem_data[j].first) -
+                       get_buf());
+      }
+      rdma_mem_.free(reinterpret_cast<char *>(index) - get_buf());
+      rdma_mem_.free(reinterpret_cast<char *>(mem_meta) - get_buf());
+      break;
+    }
+    mem_data[i].second = remote_data[i].second;
+    mem_data[i].first = get_buf() + local_offset;
+    rdma_read(conn, mem_data[i].second, local_offset, remote_data[i].first);
+    ASSERT_RW(poll_completion(conn) == 0);
+  }
+  return s;
 }
 
 void RDMAServer::fetch_memtable_service(struct rdma_connection *conn) {
   bool found = false;
-  int64_t ret[12] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
-  RemoteMemTable *rmem = nullptr;
+  int64_t ret[RMEM_INFO_WORDS];
   uint64_t mixed_id = 0;
   while (!found) {
+    std::fill(ret, ret + RMEM_INFO_WORDS, -1);
     ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&mixed_id),
                     sizeof(uint64_t)) == sizeof(uint64_t));
-    rmem = remote_memtable_pool_->get(mixed_id);
+    // not held across the socket reads, a waiting client stalls no reclaim
+    auto guard = remote_memtable_pool_->Pin();
+    RemoteMemTable *rmem = remote_memtable_pool_->get(mixed_id);
     if (rmem == nullptr) {
       fprintf(stderr, "Failed to find remote memtable:%lu\n", mixed_id);
       ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(ret),
-                       sizeof(int64_t) * 12) == sizeof(int64_t) * 12);
+                       sizeof(int64_t) * RMEM_INFO_WORDS) ==
+                sizeof(int64_t) * RMEM_INFO_WORDS);
       continue;
-    } else {
-      break;
     }
-  }
-
-  ret[0] = rmem->index;
-  ret[1] = rmem->meta;
-  ret[2] = rmem->index_size;
-  ret[3] = rmem->meta_size;
-  for (int i = 0; i < 4; i++) {
-    ret[4 + i * 2] = rmem->data[i].first;
-    ret[5 + i * 2] = rmem->data[i].second;
+    found = true;
+    ret[0] = rmem->index;
+    ret[1] = rmem->meta;
+    ret[2] = rmem->index_size;
+    ret[3] = rmem->meta_size;
+    for (int i = 0; i < kMaxMemTableShards; i++) {
+      bool used = i < static_cast<int>(rmem->data.size());
+      ret[4 + i * 2] = used ? rmem->data[i].first : 0;
+      ret[5 + i * 2] = used ? rmem->data[i].second : 0;
+    }
   }
 
   ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(ret),
-                   sizeof(int64_t) * 12) == sizeof(int64_t) * 12);
+                   sizeof(int64_t) * RMEM_INFO_WORDS) ==
+            sizeof(int64_t) * RMEM_INFO_WORDS);
 }
 
 void RDMAServer::register_memtable_read_service(struct rdma_connection *conn,
@@ -1268,7 +979,15 @@ void RDMAServer::register_memtable_read_service(struct rdma_connection *conn,
 
 void RDMAServer::register_executor_service(struct rdma_connection *conn) {
   bool ret = true;
-  executors_[conn].status = true;
+  // a worker on this host reaches the memnode through its own address
+  sockaddr_in local;
+  socklen_t local_len = sizeof(local);
+  bool colocated =
+      conn->addr.sin_addr.s_addr == htonl(INADDR_LOOPBACK) ||
+      (getsockname(conn->sock, reinterpret_cast<sockaddr *>(&local),
+                   &local_len) == 0 &&
+       local.sin_addr.s_addr == conn->addr.sin_addr.s_addr);
+  flush_scheduler_->AddExecutor(conn, colocated);
   ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret), sizeof(bool)) ==
             sizeof(bool));
 }
@@ -1288,57 +1007,176 @@ std::pair<int64_t, int64_t> RDMAClient::wait_for_job_request(
 
 void RDMAServer::wait_for_job_service(struct rdma_connection *conn) {
   int64_t ret[2];
-  std::pair<int64_t, int64_t> pr;
-  executors_[conn].flush_job_queue.wait_dequeue(pr);
-  ret[0] = pr.first;
-  ret[1] = pr.second;
-  executors_[conn].current_job = pr;
-  LOG_CERR("wait for job service found task::0 ", ret[0], ' ', ret[1]);
+  RemoteFlushScheduler::Job job = flush_scheduler_->Next(conn);
+  ret[0] = job.begin;
+  ret[1] = job.end;
+  DM_LOG_DEBUG("wait for job service found task::0 ", ret[0], ' ', ret[1]);
   ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret),
                    sizeof(int64_t) * 2) == sizeof(int64_t) * 2);
 }
 
-bool RDMAReadClient::client_send_request_for_memtable_read_v2(
-    struct rdma_connection *conn, imm_read_req_v2 *req_packet,
-    std::string *value, std::string *timestamp) {
-  // auto *reqv2 = reinterpret_cast<imm_read_req_v2 *>(req_v2_);
-  // auto *req_packet = reinterpret_cast<imm_read_req_v2 *>(get_buf() +
-  // rr_offset);
-  size_t rr_offset = reinterpret_cast<char *>(req_packet) - get_buf();
-  auto *ret_packet = reinterpret_cast<imm_read_ret *>(get_buf() + rr_offset +
-                                                      sizeof(imm_read_req_v2));
-  // std::memcpy(req_packet, req_v2_, sizeof(imm_read_req_v2));
-  receive(conn, sizeof(imm_read_ret), rr_offset + sizeof(imm_read_req_v2), 1);
-  send(conn, sizeof(imm_read_req_v2), rr_offset, 0);
+MemnodeReadMode DefaultMemnodeReadMode() {
+  const char *env = getenv("ROCKSDB_DM_READ_MODE");
+  std::string name = env == nullptr ? "adaptive" : env;
+  if (name == "delegate") return MemnodeReadMode::kDelegate;
+  if (name == "one_sided") return MemnodeReadMode::kOneSided;
+  if (name != "adaptive") {
+    DM_LOG_WARN("unknown memnode read mode ", name, ", use adaptive");
+  }
+  return MemnodeReadMode::kAdaptive;
+}
+
+const char *MemnodeReadModeName(MemnodeReadMode mode) {
+  switch (mode) {
+    case MemnodeReadMode::kDelegate:
+      return "delegate";
+    case MemnodeReadMode::kOneSided:
+      return "one_sided";
+    case MemnodeReadMode::kAdaptive:
+      return "adaptive";
+  }
+  return "adaptive";
+}
+
+namespace {
+int64_t NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+}  // namespace
+
+void RDMAReadClient::note_memnode_load(const imm_read_load &load) {
+  memnode_queued_.store(load.queued, std::memory_order_relaxed);
+  memnode_workers_.store(std::max<uint32_t>(1, load.workers),
+                         std::memory_order_relaxed);
+  load_time_us_.store(NowMicros(), std::memory_order_relaxed);
+}
+
+bool RDMAReadClient::prefer_one_sided() const {
+  switch (read_mode_) {
+    case MemnodeReadMode::kDelegate:
+      return false;
+    case MemnodeReadMode::kOneSided:
+      return true;
+    case MemnodeReadMode::kAdaptive:
+    default:
+      break;
+  }
+  if (NowMicros() - load_time_us_.load(std::memory_order_relaxed) >
+      kLoadProbeIntervalUs) {
+    return false;
+  }
+  // every worker has a request of its own waiting, a new one waits at
+  // least one lookup before it starts
+  return memnode_queued_.load(std::memory_order_relaxed) >=
+         memnode_workers_.load(std::memory_order_relaxed);
+}
+
+bool RDMAReadClient::client_send_batch_request_for_memtable_read(
+    struct rdma_connection *conn, imm_read_batch *batch) {
+  client_post_batch_request(conn, batch);
+  return client_wait_batch_request(conn, batch);
+}
+
+void RDMAReadClient::client_post_batch_request(struct rdma_connection *conn,
+                                               imm_read_batch *batch) {
+  assert(batch->op != kDelegatedGet ||
+         (batch->num_keys > 0 && batch->num_keys <= MAX_DELEGATED_READ_BATCH));
+  assert(batch->req_len <= imm_read_batch::kReqAreaSize);
+  size_t rr_offset = reinterpret_cast<char *>(batch) - get_buf();
+  // replies of the memnode workers may come back in any order, this
+  // receive only holds the right one while it is the only one posted
+  receive(conn, imm_read_batch::kRetAreaSize,
+          rr_offset + imm_read_batch::kReqAreaSize, 1);
+  send(conn, batch->req_len, rr_offset, 0);
+}
+
+bool RDMAReadClient::client_wait_batch_request(struct rdma_connection *conn,
+                                               imm_read_batch *batch) {
   int ret_send = -2;
   while (ret_send == -2) {
     ret_send = rr_block_poll_completion(conn, 0);
   }
 
   int ret_receive = -2;
-  std::chrono::high_resolution_clock::time_point
-      start = std::chrono::high_resolution_clock::now(),
-      end;
   while (ret_receive == -2) {
     ret_receive = rr_block_poll_completion(conn, 1);
   }
   if (ret_send != 1 || ret_receive != 1) {
-    LOG_CERR("ret_send: ", ret_send, " ret_receive: ", ret_receive);
+    DM_LOG_WARN("ret_send: ", ret_send, " ret_receive: ", ret_receive);
     return false;
   }
+  note_memnode_load(*batch->load());
+  return true;
+}
 
-  // local_unpack_func(ret_packet, saver);
-  req_packet->found_final_value = ret_packet->found_final_value;
-  req_packet->seq = ret_packet->seq;
-  req_packet->status_code = ret_packet->status_code;
-  if (ret_packet->value_size > 0) {
-    value->assign(ret_packet->value, ret_packet->value_size);
-  }
-  if (ret_packet->timestamp_size > 0) {
-    timestamp->assign(ret_packet->timestamp, ret_packet->timestamp_size);
+bool RDMAReadClient::client_fetch_scattered_value(
+    struct rdma_connection *conn, imm_read_batch *batch,
+    const imm_read_frag *frags, uint32_t num_frags, uint64_t value_size,
+    std::string *value) {
+  size_t fetch_offset = batch->fetch_area() - get_buf();
+  value->clear();
+  value->reserve(value_size);
+  // cut the fragments into rounds that fit the fetch area, all reads of a
+  // round are in flight together
+  uint32_t f = 0;
+  uint64_t f_done = 0;
+  while (f < num_frags) {
+    size_t used = 0;
+    size_t reads = 0;
+    while (f < num_frags && used < imm_read_batch::kFetchAreaSize) {
+      imm_read_frag frag;
+      memcpy(&frag, &frags[f], sizeof(imm_read_frag));
+      size_t len = std::min<uint64_t>(frag.len - f_done,
+                                      imm_read_batch::kFetchAreaSize - used);
+      rdma_read(conn, len, fetch_offset + used, frag.offset + f_done);
+      reads++;
+      used += len;
+      f_done += len;
+      if (f_done == frag.len) {
+        f++;
+        f_done = 0;
+      }
+    }
+    for (size_t i = 0; i < reads; i++) {
+      int ret_read = -2;
+      while (ret_read == -2) {
+        ret_read = rr_block_poll_completion(conn, 0);
+      }
+      if (ret_read != 1) {
+        DM_LOG_ERROR("fetch scattered value failed: ", ret_read);
+        return false;
+      }
+    }
+    value->append(batch->fetch_area(), used);
   }
+  assert(value->size() == value_size);
+  return true;
+}
 
-  return req_packet->found_final_value;
+bool RDMAReadClient::client_read_remote(struct rdma_connection *conn,
+                                        imm_read_batch *batch,
+                                        uint64_t offset, size_t len,
+                                        char *dst) {
+  size_t fetch_offset = batch->fetch_area() - get_buf();
+  while (len > 0) {
+    size_t n = std::min(len, imm_read_batch::kFetchAreaSize);
+    rdma_read(conn, n, fetch_offset, offset);
+    int ret_read = -2;
+    while (ret_read == -2) {
+      ret_read = rr_block_poll_completion(conn, 0);
+    }
+    if (ret_read != 1) {
+      DM_LOG_WARN("one-sided read failed: ", ret_read);
+      return false;
+    }
+    memcpy(dst, batch->fetch_area(), n);
+    dst += n;
+    offset += n;
+    len -= n;
+  }
+  return true;
 }
 
 bool RDMAReadClient::disconnect_request(struct rdma_connection *conn) {
@@ -1352,23 +1190,14 @@ bool RDMAReadClient::disconnect_request(struct rdma_connection *conn) {
   if (ret) {
     while (true) {
       size_t deq = 0;
-      available_read_reqs_.wait_dequeue_timed(deq,
-                                              std::chrono::milliseconds(1));
-      if (deq == 0)
+      if (!available_read_reqs_.wait_dequeue_timed(
+              deq, std::chrono::milliseconds(1))) {
         break;
-      else
-        rdma_mem_.free(deq);
+      }
+      rdma_mem_.free(deq);
     }
 
-    if (conn->qp) ibv_destroy_qp(conn->qp);
-    conn->qp = nullptr;
-    if (conn->cq) ibv_destroy_cq(conn->cq);
-    conn->cq = nullptr;
-    if (conn->sock >= 0) {
-      if (close(conn->sock)) fprintf(stderr, "failed to close socket\n");
-      conn->sock = -1;
-    }
-    LOG_CERR("read client disconnect, clear ibv_wc buf::0");
+    DM_LOG_DEBUG("read client disconnect, clear completion buf::0");
     for (auto atomic_ptr : rr_wc_buf) {
       if (atomic_ptr != nullptr) {
         auto *to_delete = atomic_ptr;
@@ -1376,39 +1205,63 @@ bool RDMAReadClient::disconnect_request(struct rdma_connection *conn) {
         atomic_ptr = nullptr;
       }
     }
-    LOG_CERR("read client disconnect, clear ibv_wc buf::1");
+    DM_LOG_DEBUG("read client disconnect, clear completion buf::1");
     std::lock_guard<std::mutex> lk(*conns_mtx);
     for (auto iter = res->conns.begin(); iter != res->conns.end(); iter++)
       if (*iter == conn) {
         res->conns.erase(iter);
         break;
       }
-    delete conn;
+    destroy_connection(conn);
   }
   return ret;
 }
 
-bool RDMAReadClient::register_client_in_get_service_request(
+Status RDMAReadClient::register_client_in_get_service_request(
     struct rdma_connection *conn, bool v2) {
+  int64_t offset = -1;
+  Status s = rdma_mem_.allocate_wait(
+      v2 ? imm_read_batch::slot_size()
+         : sizeof(imm_read_req) + sizeof(imm_read_ret),
+      &offset);
+  if (!s.ok()) return s;
   char req_type = v2 ? 12 : 11;
   bool ret = false;
   ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&req_type),
                    sizeof(char)) == sizeof(char));
   ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&ret), sizeof(bool)) ==
             sizeof(bool));
-  auto offset =
-      v2 ? rdma_mem_.allocate(sizeof(imm_read_req_v2) + sizeof(imm_read_ret))
-         : rdma_mem_.allocate(sizeof(imm_read_req) + sizeof(imm_read_ret));
+  if (!ret) {
+    rdma_mem_.free(offset);
+    return Status::IOError("memnode refused the delegated read client");
+  }
   available_read_reqs_.enqueue(offset);
-  return ret;
+  return Status::OK();
+}
+
+bool RDMAServer::pin_read_slots(std::vector<size_t> *slots,
+                                size_t slot_size) {
+  assert(config.max_recv_wr == config.max_send_wr);
+  assert(slots->empty());
+  for (int i = 0; i < config.max_send_wr; i++) {
+    int64_t offset = try_pin_mem(static_cast<int64_t>(slot_size), kAdmitWait);
+    if (offset == -1) {
+      DM_LOG_WARN("delegated read client refused, no room for its slots: ",
+                  pinned_mem_->GetStats().ToString());
+      for (size_t v : *slots) {
+        unpin_mem(static_cast<int64_t>(v), static_cast<int64_t>(slot_size));
+      }
+      slots->clear();
+      return false;
+    }
+    slots->push_back(static_cast<size_t>(offset));
+  }
+  return true;
 }
 
 void RDMAServer::register_client_in_get_service_service(
-    struct rdma_connection *conn, std::vector<size_t> *delegated_read_buffer_,
-    std::vector<std::thread> *delegated_read_threads_,
-    moodycamel::BlockingConcurrentQueue<uint64_t> *wr_info_,
-    std::vector<ibv_wc *> *rr_wc_buf, bool *should_close) {
-  if (!delegated_read_threads_->empty()) {
+    struct rdma_connection *conn, std::vector<size_t> *delegated_read_buffer_) {
+  if (!delegated_read_buffer_->empty()) {
     fprintf(stderr, "alredy setup for previous column family level client\n");
     bool ret = true;
     ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret),
@@ -1416,58 +1269,225 @@ void RDMAServer::register_client_in_get_service_service(
     return;
   }
 
-  assert(config.max_recv_wr == config.max_send_wr);
-  delegated_read_buffer_->resize(config.max_send_wr);
-  rr_wc_buf->resize(config.max_send_wr + config.max_recv_wr);
-  for (size_t i = 0; i < rr_wc_buf->size(); i++) (*rr_wc_buf)[i] = nullptr;
-  for (size_t i = 0; i < delegated_read_buffer_->size(); i++) {
-    int64_t req_ofs = -1;
-    int failed_retry = 0;
-    while (req_ofs == -1) {
-      req_ofs = pin_mem(sizeof(imm_read_req) + sizeof(imm_read_ret));
-      std::this_thread::sleep_for(
-          std::chrono::milliseconds(100 * (failed_retry++)));
-    }
-    // size_t ret_ofs = req_ofs + sizeof(imm_read_req);
-    (*delegated_read_buffer_)[i] = req_ofs;
-    // wr_id += 2 * delegated_read_buffer_.size()
-    // idx == (wr_id -1) / 2 % delegated_read_buffer_.size()
-  }
-
-  for (size_t i = 0; i < delegated_read_buffer_->size(); i++) {
-    auto func = [this, conn, should_close, wr_info_, delegated_read_buffer_,
-                 delegated_read_threads_, rr_wc_buf, i] {
-      // each buffer slot has two wr_id, handled by one thread
-      receive(conn, sizeof(imm_read_req), (*delegated_read_buffer_)[i], 0);
-      auto req_offset = (*delegated_read_buffer_)[i];
-      auto res_offset = req_offset + sizeof(imm_read_req);
-      auto req = (imm_read_req *)(get_buf() + req_offset);
-      auto res = (imm_read_ret *)(get_buf() + res_offset);
-      while ((*should_close) == false) {
-        if (!rr_block_poll_completion(conn, rr_wc_buf, 0, should_close)) break;
-        uint64_t req_mem_id = req->mixed_id;
-        RemoteMemTable *rmem = remote_memtable_pool_->get(req_mem_id);
-        assert(rmem != nullptr);
-        // rmem->remote_get(req, res);
-        receive(conn, sizeof(imm_read_req), req_offset, 0);
-        send(conn, sizeof(imm_read_ret), res_offset, 1);
-        if (!rr_block_poll_completion(conn, rr_wc_buf, 1, should_close)) break;
-      }
-    };
-    delegated_read_threads_->emplace_back(std::thread(func));
+  if (!pin_read_slots(delegated_read_buffer_,
+                      sizeof(imm_read_req) + sizeof(imm_read_ret))) {
+    bool ret = false;
+    ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret),
+                     sizeof(bool)) == sizeof(bool));
+    return;
   }
 
+  DelegatedReadPool::Service service;
+  service.req_size = sizeof(imm_read_req);
+  service.ret_offset = sizeof(imm_read_req);
+  service.handle = [this](char *slot) {
+    auto req = reinterpret_cast<imm_read_req *>(slot);
+    auto guard = remote_memtable_pool_->Pin();
+    RemoteMemTable *rmem = remote_memtable_pool_->get(req->mixed_id);
+    assert(rmem != nullptr);
+    (void)rmem;
+    // rmem->remote_get(req, res);
+    return sizeof(imm_read_ret);
+  };
+  read_pool_->AddConnection(conn, *delegated_read_buffer_, std::move(service));
+
   bool ret = true;
   ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret), sizeof(bool)) ==
             sizeof(bool));
 }
 
+void RDMAServer::scan_service(imm_read_batch *batch, imm_scan_ret *ret) {
+  auto *req = reinterpret_cast<imm_scan_req *>(batch->first_req());
+  ret->num_entries = 0;
+  ret->len = 0;
+  ret->exhausted = true;
+  if (batch->req_len > imm_read_batch::kReqAreaSize ||
+      reinterpret_cast<char *>(req) + sizeof(imm_scan_req) >
+          reinterpret_cast<char *>(batch) + batch->req_len ||
+      reinterpret_cast<char *>(req) + imm_scan_req::record_size(req->key_len) >
+          reinterpret_cast<char *>(batch) + batch->req_len) {
+    DM_LOG_WARN("malformed delegated scan request");
+    ret->status_code = Status::Code::kInvalidArgument;
+    return;
+  }
+  auto guard = remote_memtable_pool_->Pin();
+  RemoteMemTable *rmem = remote_memtable_pool_->get(req->mem_id);
+  if (rmem == nullptr) {
+    ret->status_code = Status::Code::kNotFound;
+    return;
+  }
+  rmem->remote_scan(req, ret, batch->ret_end(), get_buf());
+}
+
+char *RDMAServer::encode_delegated_read_ret(const imm_read_result &res,
+                                            char *cursor, char *end) {
+  auto *ret = reinterpret_cast<imm_read_ret_v2 *>(cursor);
+  size_t ts_len = res.timestamp_size > 0 ? res.timestamp_size : 0;
+  ret->status_code = res.status_code;
+  ret->timestamp_size = res.timestamp_size;
+  ret->seq = res.seq;
+  ret->base_seq = res.base_seq;
+  ret->found_final_value = res.found_final_value;
+  ret->value_size = res.value_size;
+  ret->num_frags = 0;
+  ret->num_operands = static_cast<uint32_t>(res.operands.size());
+  // small operands are copied unless that overflows the reply area
+  bool inline_operands = true;
+  auto operand_remote = [&](const imm_read_operand_ref &op) {
+    return !inline_operands || op.size > imm_read_batch::kInlineValueLimit;
+  };
+  auto operands_size = [&]() {
+    size_t size = 0;
+    for (const auto &op : res.operands) {
+      size += imm_read_operand::record_size(op.size, operand_remote(op));
+    }
+    return static_cast<uint32_t>(size);
+  };
+  ret->operands_size = operands_size();
+  if (res.value_size > imm_read_batch::kInlineValueLimit ||
+      cursor + dm_align8(sizeof(imm_read_ret_v2) + res.value_size + ts_len) +
+              ret->operands_size >
+          end) {
+    // the memtable entry is contiguous in the arena, one fragment is enough
+    ret->num_frags = res.value_size ? 1 : 0;
+  }
+  if (cursor + ret->record_size() > end && !res.operands.empty()) {
+    inline_operands = false;
+    ret->operands_size = operands_size();
+  }
+  if (cursor + ret->record_size() > end) {
+    assert(cursor + sizeof(imm_read_ret_v2) <= end);
+    ret->status_code = Status::Code::kIncomplete;
+    ret->found_final_value = false;
+    ret->value_size = 0;
+    ret->num_frags = 0;
+    ret->timestamp_size = -1;
+    ret->num_operands = 0;
+    ret->operands_size = 0;
+    return cursor + sizeof(imm_read_ret_v2);
+  }
+  if (ret->num_frags) {
+    ret->frags()[0].offset = res.value - get_buf();
+    ret->frags()[0].len = res.value_size;
+  } else if (res.value_size) {
+    memcpy(ret->value(), res.value, res.value_size);
+  }
+  if (ts_len) {
+    memcpy(ret->timestamp(), res.timestamp.data(), ts_len);
+  }
+  auto *op = ret->operands();
+  for (const auto &o : res.operands) {
+    op->seq = o.seq;
+    op->size = static_cast<uint32_t>(o.size);
+    op->remote = operand_remote(o) ? 1 : 0;
+    if (op->remote) {
+      op->frag()->offset = o.data - get_buf();
+      op->frag()->len = o.size;
+    } else {
+      memcpy(op->data(), o.data, o.size);
+    }
+    op = reinterpret_cast<imm_read_operand *>(reinterpret_cast<char *>(op) +
+                                              op->record_size());
+  }
+  return cursor + ret->record_size();
+}
+
+size_t RDMAServer::delegated_read_service(imm_read_batch *batch) {
+  // lets the client walk the memtables itself while the pool is saturated
+  *batch->load() = read_pool_->Load();
+  const size_t load_size = dm_align8(sizeof(imm_read_load));
+  if (batch->op == kDelegatedScan) {
+    auto *ret = reinterpret_cast<imm_scan_ret *>(batch->first_ret());
+    scan_service(batch, ret);
+    return load_size + sizeof(imm_scan_ret) + ret->len;
+  }
+
+  // res.value points into a memtable until its reply is encoded, the pin
+  // covers the whole batch
+  auto guard = remote_memtable_pool_->Pin();
+  imm_read_result res;
+  size_t num_keys = std::min(batch->num_keys,
+                             uint32_t{MAX_DELEGATED_READ_BATCH});
+  char *req_end = reinterpret_cast<char *>(batch) +
+                  std::min<size_t>(batch->req_len,
+                                   imm_read_batch::kReqAreaSize);
+  auto *req = batch->first_req();
+  char *res_cursor = reinterpret_cast<char *>(batch->first_ret());
+  // keys of one batch are independent, each walks its own mixed_ids
+  for (size_t k = 0; k < num_keys; k++) {
+    if (reinterpret_cast<char *>(req) + sizeof(imm_read_req_v2) >
+            req_end ||
+        reinterpret_cast<char *>(req) + req->record_size() > req_end) {
+      DM_LOG_WARN("malformed delegated read batch, key ", k);
+      num_keys = k;
+      break;
+    }
+    res.status_code = -1;
+    res.found_final_value = false;
+    res.seq = kMaxSequenceNumber;
+    res.value = nullptr;
+    res.value_size = 0;
+    res.timestamp_size = -1;
+    res.base_seq = kMaxSequenceNumber;
+    res.operands.clear();
+    bool done = false;
+    // the memtables the index skips hold no version of the key
+    bool indexed = remote_memtable_pool_->get_indexed(req, &res);
+    if (indexed) {
+      done = res.found_final_value;
+      if (req->seq == kMaxSequenceNumber) {
+        req->seq = res.seq;
+      }
+    }
+    for (size_t i = 0; !indexed && i < req->mixed_ids_size; i++) {
+      size_t covered = 0;
+      RemoteMemTable *rmem =
+          remote_memtable_pool_->get_merged(req, i, &covered);
+      if (rmem != nullptr) {
+        // one search for the memtables it merged
+        i += covered - 1;
+      } else {
+        rmem = remote_memtable_pool_->get(req->mixed_ids()[i]);
+      }
+      assert(rmem != nullptr);
+      rmem->remote_get_v2(req, &res);
+      done = res.found_final_value;
+      if (req->seq == kMaxSequenceNumber) {
+        req->seq = res.seq;
+      }
+      if (done) {
+        assert(req->seq != kMaxSequenceNumber ||
+               res.status_code == Status::Code::kNotFound);
+        break;
+      } else if (!done && res.status_code != -1 &&
+                 res.status_code != Status::Code::kOk &&
+                 res.status_code != Status::Code::kNotFound &&
+                 res.status_code != Status::Code::kMergeInProgress) {
+        done = false;
+        break;
+      }
+    }
+    if (!done && !res.operands.empty() &&
+        (res.status_code == -1 ||
+         res.status_code == Status::Code::kMergeInProgress)) {
+      // a later memtable without the key must not hide the operands
+      res.status_code = Status::Code::kMergeInProgress;
+    }
+    res.seq = req->seq;
+    res.found_final_value = done;
+    // keep room for a bare header of every key still to be answered
+    size_t reserve = (num_keys - k - 1) * sizeof(imm_read_ret_v2);
+    res_cursor = encode_delegated_read_ret(
+        res, res_cursor, batch->ret_end() - reserve);
+    req = reinterpret_cast<imm_read_req_v2 *>(
+        reinterpret_cast<char *>(req) + req->record_size());
+  }
+  return res_cursor - batch->req_end();
+}
+
 void RDMAServer::register_client_in_get_service_service_v2(
-    struct rdma_connection *conn, std::vector<size_t> *delegated_read_buffer_,
-    std::vector<std::thread> *delegated_read_threads_,
-    moodycamel::BlockingConcurrentQueue<uint64_t> *wr_info_,
-    std::vector<ibv_wc *> *rr_wc_buf, bool *should_close) {
-  if (!delegated_read_threads_->empty()) {
+    struct rdma_connection *conn, std::vector<size_t> *delegated_read_buffer_) {
+  if (!delegated_read_buffer_->empty()) {
     fprintf(stderr, "alredy setup for previous column family level client\n");
     bool ret = true;
     ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret),
@@ -1475,79 +1495,32 @@ void RDMAServer::register_client_in_get_service_service_v2(
     return;
   }
 
-  assert(config.max_recv_wr == config.max_send_wr);
-  delegated_read_buffer_->resize(config.max_send_wr);
-  rr_wc_buf->resize(config.max_send_wr + config.max_recv_wr);
-  for (size_t i = 0; i < rr_wc_buf->size(); i++) (*rr_wc_buf)[i] = nullptr;
-  for (size_t i = 0; i < delegated_read_buffer_->size(); i++) {
-    int64_t req_ofs = -1;
-    int failed_retry = 0;
-    while (req_ofs == -1) {
-      req_ofs = pin_mem(sizeof(imm_read_req_v2) + sizeof(imm_read_ret));
-      std::this_thread::sleep_for(
-          std::chrono::milliseconds(100 * (failed_retry++)));
-    }
-    // size_t ret_ofs = req_ofs + sizeof(imm_read_req);
-    (*delegated_read_buffer_)[i] = req_ofs;
-    // wr_id += 2 * delegated_read_buffer_.size()
-    // idx == (wr_id -1) / 2 % delegated_read_buffer_.size()
-  }
-
-  for (size_t i = 0; i < delegated_read_buffer_->size(); i++) {
-    auto func = [this, conn, should_close, wr_info_, delegated_read_buffer_,
-                 delegated_read_threads_, rr_wc_buf, i] {
-      // each buffer slot has two wr_id, handled by one thread
-      receive(conn, sizeof(imm_read_req_v2), (*delegated_read_buffer_)[i], 0);
-      auto req_offset = (*delegated_read_buffer_)[i];
-      auto res_offset = req_offset + sizeof(imm_read_req_v2);
-      auto req = (imm_read_req_v2 *)(get_buf() + req_offset);
-      auto res = (imm_read_ret *)(get_buf() + res_offset);
-      bool ret = true;
-      ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret),
-                       sizeof(bool)) == sizeof(bool));
-      while ((*should_close) == false) {
-        if (!rr_block_poll_completion(conn, rr_wc_buf, 0, should_close)) break;
-
-        bool done = false;
-        for (size_t i = 0; i < req->mixed_ids_size; i++) {
-          uint64_t req_mem_id = req->mixed_ids[i];
-          RemoteMemTable *rmem = remote_memtable_pool_->get(req_mem_id);
-          assert(rmem != nullptr);
-          rmem->remote_get_v2(req, res);
-          done = res->found_final_value;
-          if (req->seq == kMaxSequenceNumber) {
-            req->seq = res->seq;
-          }
-          if (done) {
-            assert(req->seq != kMaxSequenceNumber ||
-                   res->status_code == Status::Code::kNotFound);
-            break;
-          } else if (!done && res->status_code != Status::Code::kOk &&
-                     res->status_code != Status::Code::kNotFound) {
-            done = false;
-            break;
-          }
-        }
-        res->seq = req->seq;
-        res->found_final_value = done;
-        receive(conn, sizeof(imm_read_req_v2), req_offset, 0);
-        send(conn, sizeof(imm_read_ret), res_offset, 1);
-        if (!rr_block_poll_completion(conn, rr_wc_buf, 1, should_close)) break;
-      }
-    };
-    delegated_read_threads_->emplace_back(std::thread(func));
+  if (!pin_read_slots(delegated_read_buffer_,
+                      imm_read_batch::server_slot_size())) {
+    bool ret = false;
+    ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret),
+                     sizeof(bool)) == sizeof(bool));
+    return;
   }
+
+  DelegatedReadPool::Service service;
+  service.req_size = imm_read_batch::kReqAreaSize;
+  service.ret_offset = imm_read_batch::kReqAreaSize;
+  service.handle = [this](char *slot) {
+    return delegated_read_service(reinterpret_cast<imm_read_batch *>(slot));
+  };
+  read_pool_->AddConnection(conn, *delegated_read_buffer_, std::move(service));
+
+  bool ret = true;
+  ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&ret), sizeof(bool)) ==
+            sizeof(bool));
 }
 
 bool RDMAServer::service(struct rdma_connection *conn) {
   bool should_close = false;
-  // queue to store read requests from gen_thread, pop them to consumer thread
-  moodycamel::BlockingConcurrentQueue<uint64_t> wr_info_;
+  // delegated read slots of this connection, served by read_pool_
   std::vector<size_t> delegated_read_buffer_;
-  std::vector<std::thread>
-      delegated_read_threads_;  // 1thread listen and nthreads handle utill
-                                // should_close
-  std::vector<ibv_wc *> rr_wc_buf;
+  size_t delegated_read_slot_size = 0;  // depends on the registered version
   int64_t meta_offset = 0, meta_size = 0;
   while (!should_close) {
     char req_type;
@@ -1555,47 +1528,41 @@ bool RDMAServer::service(struct rdma_connection *conn) {
                     sizeof(char)) == sizeof(char));
     switch (req_type) {
       case 0:
-        LOG_CERR("SERVICE:disconnect service");
+        DM_LOG_DEBUG("SERVICE:disconnect service");
         should_close = true;
-        if (!delegated_read_threads_.empty()) {
-          for (auto &t : delegated_read_threads_) {
-            t.join();
-          }
-          delegated_read_threads_.clear();
+        flush_scheduler_->RemoveExecutor(conn);
+        if (!delegated_read_buffer_.empty()) {
+          read_pool_->RemoveConnection(conn);
           for (auto v : delegated_read_buffer_) {
-            unpin_mem(v, sizeof(imm_read_req) + sizeof(imm_read_ret));
+            unpin_mem(v, delegated_read_slot_size);
           }
           delegated_read_buffer_.clear();
-          for (size_t i = 0; i < rr_wc_buf.size(); i++) {
-            delete rr_wc_buf[i];
-          }
-          rr_wc_buf.clear();
         }
         disconnect_service(conn);
         break;
       case 1:
-        LOG_CERR("SERVICE:allocate mem service");
+        DM_LOG_DEBUG("SERVICE:allocate mem service");
         int64_t ret_offset, ret_size;
         allocate_mem_service(conn, ret_offset, ret_size);
         break;
       case 2:
-        LOG_CERR("SERVICE:free mem service");
+        DM_LOG_DEBUG("SERVICE:free mem service");
         free_mem_service(conn);
         break;
       case 3:
-        LOG_CERR("SERVICE:register executor service");
+        DM_LOG_DEBUG("SERVICE:register executor service");
         register_executor_service(conn);
         break;
       case 4:
-        LOG_CERR("SERVICE:wait for job service");
+        DM_LOG_DEBUG("SERVICE:wait for job service");
         wait_for_job_service(conn);
         break;
       case 5:
-        LOG_CERR("SERVICE:create rmem connection");
+        DM_LOG_DEBUG("SERVICE:create rmem connection");
         create_rmem_service(conn);
         break;
       case 6:
-        LOG_CERR("SERVICE:receive rmem connected");
+        DM_LOG_DEBUG("SERVICE:receive rmem connected");
         receive_rmem_service(conn);
         break;
       case 7: {
@@ -1603,9 +1570,9 @@ bool RDMAServer::service(struct rdma_connection *conn) {
         uint64_t id;
         ASSERT_RW(readn(conn->sock, reinterpret_cast<char *>(&id),
                         sizeof(id)) == sizeof(id));
-        LOG_CERR("SERVICE:free rmem ", id);
-        uint64_t to_unpin[12];
-        Status s = remote_memtable_pool_->delete_remote_memtable(id, to_unpin);
+        DM_LOG_DEBUG("SERVICE:free rmem ", id);
+        // the memtable is unpinned once the delegated reads on it drain
+        Status s = remote_memtable_pool_->delete_remote_memtable(id);
         if (!s.ok()) {
           fprintf(stderr,
                   "Failed to delete remote memtable %lu, might cause memory "
@@ -1616,46 +1583,55 @@ bool RDMAServer::service(struct rdma_connection *conn) {
                            sizeof(char)) == sizeof(char));
         } else {
           char ret = 1;
-          for (int i = 0; i < 6; i++) {
-            bool ret = unpin_mem(to_unpin[i * 2], to_unpin[i * 2 + 1]);
-            if (ret == false) {
-              LOG_CERR("unpin rmem ", id, "failed :: ", to_unpin[i * 2], " ",
-                       to_unpin[i * 2 + 1]);
-            }
-          }
+          flush_scheduler_->Complete(id);
           ASSERT_RW(writen(conn->sock, reinterpret_cast<char *>(&ret),
                            sizeof(char)) == sizeof(char));
         }
         break;
       }
       case 8: {
-        LOG_CERR("SERVICE:receive remote flush service");
+        DM_LOG_DEBUG("SERVICE:receive remote flush service");
         receive_remote_flush_service(conn, meta_offset, meta_size);
         break;
       }
       case 9: {
-        LOG_CERR("SERVICE:create remote flush service");
+        DM_LOG_DEBUG("SERVICE:create remote flush service");
         // create remote flush service
         allocate_mem_service(conn, meta_offset, meta_size);
         break;
       }
       case 10: {
-        LOG_CERR("SERVICE:fetch memtable service");
+        DM_LOG_DEBUG("SERVICE:fetch memtable service");
         fetch_memtable_service(conn);
         break;
       }
       case 11: {
-        LOG_CERR("SERVICE:register client in get service");
-        register_client_in_get_service_service(
-            conn, &delegated_read_buffer_, &delegated_read_threads_, &wr_info_,
-            &rr_wc_buf, &should_close);
+        DM_LOG_DEBUG("SERVICE:register client in get service");
+        if (delegated_read_buffer_.empty()) {
+          delegated_read_slot_size =
+              sizeof(imm_read_req) + sizeof(imm_read_ret);
+        }
+        register_client_in_get_service_service(conn,
+                                                 &delegated_read_buffer_);
         break;
       }
       case 12: {
-        LOG_CERR("SERVICE:register client in get service v2");
-        register_client_in_get_service_service_v2(
-            conn, &delegated_read_buffer_, &delegated_read_threads_, &wr_info_,
-            &rr_wc_buf, &should_close);
+        DM_LOG_DEBUG("SERVICE:register client in get service v2");
+        if (delegated_read_buffer_.empty()) {
+          delegated_read_slot_size = imm_read_batch::server_slot_size();
+        }
+        register_client_in_get_service_service_v2(conn,
+                                                 &delegated_read_buffer_);
+        break;
+      }
+      case 13: {
+        DM_LOG_DEBUG("SERVICE:memnode capacity service");
+        capacity_service(conn);
+        break;
+      }
+      case 14: {
+        DM_LOG_DEBUG("SERVICE:list memtables service");
+        list_memtables_service(conn);
         break;
       }
       default:
@@ -1670,13 +1646,13 @@ TCPNode *PlacementDriver::choose_worker(const placement_info &info) {
   double base =
       1.0 * info.current_background_job_num_ / max_background_job_num_ +
       1.0 * info.current_hdfs_io_ / max_hdfs_io_;
-  LOG_CERR("generator: ", info.current_background_job_num_, " ",
-           info.current_hdfs_io_);
+  DM_LOG_DEBUG("generator: ", info.current_background_job_num_, " ",
+               info.current_hdfs_io_);
   TCPNode *choose = nullptr;
   for (auto &worker : workers_) {
     auto val = peers_.at(worker);
-    LOG_CERR("worker: ", val.current_background_job_num_, " ",
-             val.current_hdfs_io_);
+    DM_LOG_DEBUG("worker: ", val.current_background_job_num_, " ",
+                 val.current_hdfs_io_);
     double cal =
         1.0 * val.current_background_job_num_ / max_background_job_num_ +
         1.0 * val.current_hdfs_io_ / max_hdfs_io_;
@@ -1690,6 +1666,7 @@ TCPNode *PlacementDriver::choose_worker(const placement_info &info) {
 
 void PlacementDriver::step(bool from_generator, size_t id,
                            placement_info info) {
+  std::lock_guard<std::mutex> lck(mu_);
   if (from_generator) {
     // handle MsgFlushRequest
     assert(peers_.find(generators_[id - 1]) != peers_.end());
@@ -1759,24 +1736,24 @@ void PlacementDriver::poll_events(int port) {
       return;
     }
     assert(pollfds.size() == workers_.size() + generators_.size() + 1);
-    std::vector<std::thread> all_threads;
+    // a step only updates the peer table and answers a generator, run them
+    // in order on this thread
     for (int i = 1; i < (int)pollfds.size(); i++) {
       if (pollfds[i].revents & POLLIN) {
         if (i <= (int)workers_.size()) {
           placement_info val;
           workers_[i - 1]->receive(&val, sizeof(val));
-          LOG_CERR("workerid:", i, " info:", val.current_background_job_num_,
-                   " ", val.current_hdfs_io_);
-          all_threads.emplace_back([this, i, val]() { step(false, i, val); });
+          DM_LOG_DEBUG("workerid:", i,
+                       " info:", val.current_background_job_num_, " ",
+                       val.current_hdfs_io_);
+          step(false, i, val);
         } else {
           placement_info val;
           generators_[i - 1 - workers_.size()]->receive(&val, sizeof(val));
-          all_threads.emplace_back(
-              [this, i, val]() { step(true, i - workers_.size(), val); });
+          step(true, i - workers_.size(), val);
         }
       }
     }
-    for (auto &all_thread : all_threads) all_thread.join();
     if (pollfds[0].revents & POLLIN) {
       sockaddr_in client_addr;
       socklen_t client_addr_len = sizeof(client_addr);
@@ -1,19 +1,108 @@
 #include "memory/remote_memtable_service.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <queue>
 
 #include "db/dbformat.h"
 #include "db/memtable.h"
+#include "memory/arena.h"
 #include "memory/sep_concurrent_arena.h"
 #include "rocksdb/comparator.h"
 #include "rocksdb/iterator.h"
 #include "rocksdb/memtablerep.h"
 #include "rocksdb/remote_flush_service.h"
 #include "rocksdb/slice_transform.h"
+#include "test_util/sync_point.h"
+#include "util/coding.h"
 
 namespace ROCKSDB_NAMESPACE {
+namespace {
+// Sorted entries of the memtables a merge took, the entries stay in their
+// shards. Read only, a search is a binary search.
+class MergedMemTableRep : public MemTableRep {
+ public:
+  MergedMemTableRep(const MemTableRep::KeyComparator& cmp,
+                    std::vector<const char*>&& entries)
+      : MemTableRep(nullptr), cmp_(cmp), entries_(std::move(entries)) {}
+
+  void Insert(KeyHandle /*handle*/) override { assert(false); }
+
+  bool Contains(const char* key) const override {
+    auto it = std::lower_bound(
+        entries_.begin(), entries_.end(), key,
+        [this](const char* a, const char* b) { return cmp_(a, b) < 0; });
+    return it != entries_.end() && cmp_(*it, key) == 0;
+  }
+
+  size_t ApproximateMemoryUsage() override {
+    return entries_.capacity() * sizeof(const char*);
+  }
+
+  class Iterator : public MemTableRep::Iterator {
+   public:
+    explicit Iterator(const MergedMemTableRep* rep)
+        : rep_(rep), pos_(rep->entries_.size()) {}
+    bool Valid() const override { return pos_ < rep_->entries_.size(); }
+    const char* key() const override {
+      assert(Valid());
+      return rep_->entries_[pos_];
+    }
+    void Next() override {
+      assert(Valid());
+      pos_++;
+    }
+    void Prev() override {
+      assert(Valid());
+      pos_ = pos_ == 0 ? rep_->entries_.size() : pos_ - 1;
+    }
+    void Seek(const Slice& internal_key,
+              const char* /*memtable_key*/) override {
+      pos_ = LowerBound(internal_key);
+    }
+    void SeekForPrev(const Slice& internal_key,
+                     const char* /*memtable_key*/) override {
+      pos_ = LowerBound(internal_key);
+      if (pos_ < rep_->entries_.size() &&
+          rep_->cmp_(rep_->entries_[pos_], internal_key) == 0) {
+        return;
+      }
+      pos_ = pos_ == 0 ? rep_->entries_.size() : pos_ - 1;
+    }
+    void SeekToFirst() override { pos_ = 0; }
+    void SeekToLast() override {
+      pos_ = rep_->entries_.empty() ? 0 : rep_->entries_.size() - 1;
+    }
+
+   private:
+    size_t LowerBound(const Slice& internal_key) const {
+      auto it = std::lower_bound(
+          rep_->entries_.begin(), rep_->entries_.end(), internal_key,
+          [this](const char* a, const Slice& b) {
+            return rep_->cmp_(a, b) < 0;
+          });
+      return static_cast<size_t>(it - rep_->entries_.begin());
+    }
+
+    const MergedMemTableRep* rep_;
+    size_t pos_;
+  };
+
+  MemTableRep::Iterator* GetIterator(Arena* arena) override {
+    void* mem = arena ? arena->AllocateAligned(sizeof(Iterator))
+                      : operator new(sizeof(Iterator));
+    return new (mem) Iterator(this);
+  }
+
+ private:
+  const MemTableRep::KeyComparator& cmp_;
+  const std::vector<const char*> entries_;
+};
+}  // anonymous namespace
+
 void RemoteMemTable::register_remote_memTable(
     RemoteMemTable*& rmt, void* rdma_buf, void* index, uint64_t index_size,
     void* mem_meta, uint64_t mem_meta_size,
@@ -25,8 +114,10 @@ void RemoteMemTable::register_remote_memTable(
   rmt->index =
       reinterpret_cast<char*>(index) - reinterpret_cast<char*>(rdma_buf);
   rmt->index_size = index_size;
-  rmt->data.resize(4);
-  for (int i = 0; i < 4; i++) {
+  rmt->data.resize(index_shard_num(index));
+  // shards still to be fetched are attached once they arrive
+  for (size_t i = 0; i < rmt->data.size(); i++) {
+    if (mem_data[i].first == nullptr) continue;
     rmt->data[i].first = reinterpret_cast<char*>(mem_data[i].first) -
                          reinterpret_cast<char*>(rdma_buf);
     rmt->data[i].second = mem_data[i].second;
@@ -38,19 +129,20 @@ void RemoteMemTable::rebuild_remote_memTable(
     void* mem_meta, uint64_t mem_meta_size,
     std::pair<void*, uint64_t>* mem_data) {
   if (rmt == nullptr) {
-    LOG_CERR("rebuild_remote_memTable rmt is nullptr");
+    DM_LOG_ERROR("rebuild_remote_memTable rmt is nullptr");
     return;
   }
   uint64_t id_ = 0;
   int64_t head_offset_ = 0;
   int32_t max_height = 1;
+  int32_t shard_num = 0;
   bool cmp_id = false;
+  uint8_t flags = kMemTableIndexShardsOrdered;
   std::pair<int64_t, int64_t> transform_id = {0, 0};
   size_t lookahead_ = 0;
   void* skip_list_ptr_ = nullptr;
   void* meta_begin_ptr_ = nullptr;
   std::vector<void*> data_begin_ptr_;
-  data_begin_ptr_.resize(4 /*sep*/);
 
   //   parse index
   char* idx_ptr = reinterpret_cast<char*>(index);
@@ -60,8 +152,12 @@ void RemoteMemTable::rebuild_remote_memTable(
   idx_ptr += sizeof(int64_t);
   max_height = *reinterpret_cast<int32_t*>(idx_ptr);
   idx_ptr += sizeof(int32_t);
+  shard_num = *reinterpret_cast<int32_t*>(idx_ptr);
+  idx_ptr += sizeof(int32_t);
   cmp_id = *reinterpret_cast<bool*>(idx_ptr);
   idx_ptr += sizeof(bool);
+  flags = *reinterpret_cast<uint8_t*>(idx_ptr);
+  idx_ptr += sizeof(uint8_t);
   transform_id.first = *reinterpret_cast<int64_t*>(idx_ptr);
   idx_ptr += sizeof(int64_t);
   if (transform_id.first == 0) {
@@ -74,7 +170,8 @@ void RemoteMemTable::rebuild_remote_memTable(
   idx_ptr += sizeof(void*);
   meta_begin_ptr_ = *reinterpret_cast<void**>(idx_ptr);
   idx_ptr += sizeof(void*);
-  for (int i = 0; i < 4 /*sep*/; i++) {
+  data_begin_ptr_.resize(shard_num);
+  for (int i = 0; i < shard_num; i++) {
     data_begin_ptr_[i] = *reinterpret_cast<void**>(idx_ptr);
     idx_ptr += sizeof(void*);
   }
@@ -82,9 +179,10 @@ void RemoteMemTable::rebuild_remote_memTable(
   // rebuild
   rmt->id = id_;
 
-  LOG_CERR("rebuild rmem id:", id_, ' ', "head_offset:", head_offset_, ' ',
-           "cmp_id:", cmp_id, ' ', "transform_id:", transform_id.first, ' ',
-           "lookahead:", lookahead_, ' ', "skip_list_ptr:", skip_list_ptr_);
+  DM_LOG_DEBUG("rebuild rmem id:", id_, ' ', "head_offset:", head_offset_, ' ',
+               "cmp_id:", cmp_id, ' ', "transform_id:", transform_id.first, ' ',
+               "lookahead:", lookahead_, ' ', "skip_list_ptr:", skip_list_ptr_,
+               ' ', "shards:", shard_num);
 
   auto* key_cmp = new MemTable::KeyComparator(
       (!cmp_id) ? (InternalKeyComparator(BytewiseComparator()))
@@ -115,55 +213,516 @@ void RemoteMemTable::rebuild_remote_memTable(
   }
   rmt->prefix_extractor = const_cast<SliceTransform*>(prefix_extractor);
 
+  memtable_bloom_info bloom_info;
+  memcpy(&bloom_info, reinterpret_cast<char*>(index) + MEMTABLE_INDEX_BLOOM,
+         sizeof(bloom_info));
+  const SliceTransform* bloom_prefix =
+      transform_id.first == 0 && prefix_extractor != nullptr
+          ? static_cast<const InternalKeySliceTransform*>(prefix_extractor)
+                ->user_prefix_extractor()
+          : prefix_extractor;
+  if (index_size >= MEMTABLE_INDEX_SIZE &&
+      bloom_info.mode != kMemTableBloomNone && bloom_info.len > 0 &&
+      bloom_info.num_double_probes > 0 &&
+      bloom_info.offset + uint64_t{bloom_info.len} * sizeof(uint64_t) <=
+          mem_meta_size &&
+      (bloom_info.mode == kMemTableBloomWholeKey || bloom_prefix != nullptr)) {
+    rmt->bloom = new DynamicBloom(
+        reinterpret_cast<const uint64_t*>(reinterpret_cast<char*>(mem_meta) +
+                                          bloom_info.offset),
+        bloom_info.len, bloom_info.num_double_probes);
+    rmt->bloom_whole_key = bloom_info.mode == kMemTableBloomWholeKey;
+    rmt->bloom_ts_sz = bloom_info.ts_sz;
+    rmt->bloom_prefix_extractor = bloom_prefix;
+  }
+  if (index_size >= MEMTABLE_INDEX_SIZE) {
+    memcpy(&rmt->recovery,
+           reinterpret_cast<char*>(index) + MEMTABLE_INDEX_RECOVERY,
+           sizeof(rmt->recovery));
+  }
+
   MemTableRep* rmt_rep =
-      SkipListFactory(lookahead_)
-          .CreateMemTableRep(*key_cmp, arena, prefix_extractor, nullptr);
+      (flags & kMemTableIndexOffsetLinks)
+          ? OffsetSkipListFactory(lookahead_)
+                .CreateMemTableRep(*key_cmp, arena, prefix_extractor, nullptr)
+          : SkipListFactory(lookahead_)
+                .CreateMemTableRep(*key_cmp, arena, prefix_extractor, nullptr);
   //   rmt_rep->MemnodeRebuild(skip_list_ptr_);
   rmt_rep->set_local_begin(meta_begin_ptr_);
   rmt_rep->set_remote_begin(mem_meta);
   rmt_rep->set_head_offset(head_offset_);
-  for (int i = 0; i < 4 /*sep*/; i++) {
+  rmt_rep->set_shard_layout(shard_num,
+                            (flags & kMemTableIndexShardsOrdered) != 0);
+  for (int i = 0; i < shard_num; i++) {
     rmt_rep->set_shard_local_begin(i, data_begin_ptr_[i]);
-    rmt_rep->set_shard_remote_begin(i, mem_data[i].first);
+    if (mem_data[i].first != nullptr) {
+      rmt_rep->set_shard_remote_begin(i, mem_data[i].first);
+    }
   }
   rmt_rep->set_max_height(max_height);
   rmt->memtable = rmt_rep;
 }
 
+RemoteMemTable* RemoteMemTable::merge_remote_memTables(
+    const std::vector<RemoteMemTable*>& members, SequenceNumber* max_seq) {
+  assert(!members.empty());
+  auto* key_cmp = new MemTable::KeyComparator(members[0]->key_cmp->comparator);
+  std::vector<std::unique_ptr<MemTableRep::Iterator>> iters;
+  for (RemoteMemTable* member : members) {
+    iters.emplace_back(member->memtable->GetIterator());
+    iters.back()->SeekToFirst();
+  }
+  auto after = [&](size_t a, size_t b) {
+    return (*key_cmp)(iters[a]->key(), iters[b]->key()) > 0;
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(after)> heap(
+      after);
+  for (size_t i = 0; i < iters.size(); i++) {
+    if (iters[i]->Valid()) heap.push(i);
+  }
+
+  std::vector<const char*> entries;
+  *max_seq = 0;
+  Slice prev;
+  bool has_prev = false;
+  bool shadowed = false;
+  while (!heap.empty()) {
+    size_t i = heap.top();
+    heap.pop();
+    const char* entry = iters[i]->key();
+    iters[i]->Next();
+    if (iters[i]->Valid()) heap.push(i);
+
+    Slice ikey = GetLengthPrefixedSlice(entry);
+    SequenceNumber seq = 0;
+    ValueType type = kTypeValue;
+    UnPackSequenceAndType(ExtractInternalKeyFooter(ikey), &seq, &type);
+    *max_seq = std::max(*max_seq, seq);
+    Slice user_key = ExtractUserKey(ikey);
+    if (!has_prev || user_key != prev) {
+      prev = user_key;
+      has_prev = true;
+      shadowed = false;
+    }
+    if (shadowed) continue;
+    entries.push_back(entry);
+    // a read stops at the first version that is no merge operand
+    shadowed = type != kTypeMerge;
+  }
+
+  auto* rmt = new RemoteMemTable();
+  rmt->id = members[0]->id;
+  rmt->key_cmp = key_cmp;
+  rmt->memtable = new MergedMemTableRep(*key_cmp, std::move(entries));
+  return rmt;
+}
+
+RemoteMemTablePool::RemoteMemTablePool(UnpinFunc unpin)
+    : unpin_(std::move(unpin)),
+      table_(new Table()),
+      merged_(new MergedTable()) {
+  merge_thread_ = std::thread([this]() { merge_loop(); });
+}
+
+RemoteMemTablePool::~RemoteMemTablePool() {
+  {
+    std::lock_guard<std::mutex> lck(merge_mtx_);
+    merge_stop_ = true;
+  }
+  merge_cv_.notify_one();
+  merge_thread_.join();
+  // no reader is left, the memtables still in the table go with it and
+  // epoch_ runs what is still retired
+  MergedTable* merged = merged_.load();
+  for (auto& entry : *merged) {
+    const MergedGroup* group = entry.second;
+    // a group is listed under each of its memtables, freed by the newest
+    if (entry.first != group->ids.front()) continue;
+    free_remote_memtable(group->rmem);
+    delete group;
+  }
+  delete merged;
+  Table* table = table_.load();
+  for (auto& entry : *table) free_remote_memtable(entry.second);
+  delete table;
+}
+
+void RemoteMemTablePool::free_remote_memtable(RemoteMemTable* rmem) {
+  delete rmem->memtable;
+  delete rmem->arena;
+  delete rmem->key_cmp;
+  delete rmem->prefix_extractor;
+  delete rmem->bloom;
+  delete rmem;
+}
+
+void RemoteMemTablePool::publish(Table* table) {
+  Table* old = table_.exchange(table);
+  epoch_.Retire([old]() { delete old; });
+}
+
+void RemoteMemTablePool::publish_merged(MergedTable* merged) {
+  MergedTable* old = merged_.exchange(merged);
+  epoch_.Retire([old]() { delete old; });
+}
+
+void RemoteMemTablePool::dissolve_merged(uint64_t id) {
+  const MergedTable* cur = merged_.load();
+  auto it = cur->find(id);
+  if (it == cur->end()) return;
+  const MergedGroup* group = it->second;
+  auto* next = new MergedTable(*cur);
+  for (uint64_t member : group->ids) next->erase(member);
+  publish_merged(next);
+  epoch_.Retire([group]() {
+    free_remote_memtable(group->rmem);
+    delete group;
+  });
+}
+
+void RemoteMemTablePool::merge_loop() {
+  std::unique_lock<std::mutex> lck(merge_mtx_);
+  while (!merge_stop_) {
+    if (merge_pending_.empty()) {
+      merge_cv_.wait(lck);
+      continue;
+    }
+    uint32_t cf_id = *merge_pending_.begin();
+    merge_pending_.erase(merge_pending_.begin());
+    lck.unlock();
+    merge_column_family(cf_id);
+    lck.lock();
+  }
+}
+
+void RemoteMemTablePool::merge_column_family(uint32_t cf_id) {
+  // keeps the memtables picked alive until the merged one is published
+  // or dropped, no reclaim runs meanwhile
+  auto guard = Pin();
+  std::vector<RemoteMemTable*> members;
+  {
+    std::lock_guard<std::mutex> lck(writer_mtx_);
+    const Table* cur = table_.load();
+    const MergedTable* merged = merged_.load();
+    std::vector<uint64_t> ids;
+    for (const auto& entry : *cur) {
+      if ((entry.first >> 32) == cf_id && merged->count(entry.first) == 0) {
+        ids.push_back(entry.first);
+      }
+    }
+    std::sort(ids.begin(), ids.end(), std::greater<uint64_t>());
+    // the newest run of consecutive ids, a read names all of it or none
+    size_t run = ids.empty() ? 0 : 1;
+    while (run < ids.size() && run < kMergeMaxMemTables &&
+           ids[run] + 1 == ids[run - 1]) {
+      run++;
+    }
+    if (run < kMergeMinMemTables) return;
+    for (size_t i = 0; i < run; i++) members.push_back(cur->at(ids[i]));
+  }
+
+  SequenceNumber max_seq = 0;
+  RemoteMemTable* rmem =
+      RemoteMemTable::merge_remote_memTables(members, &max_seq);
+  auto* group = new MergedGroup{rmem, {}, max_seq};
+  for (RemoteMemTable* member : members) group->ids.push_back(member->id);
+
+  std::lock_guard<std::mutex> lck(writer_mtx_);
+  const Table* cur = table_.load();
+  const MergedTable* merged = merged_.load();
+  for (RemoteMemTable* member : members) {
+    auto it = cur->find(member->id);
+    if (it == cur->end() || it->second != member ||
+        merged->count(member->id) != 0) {
+      // one was deleted meanwhile, the run is flushed anyway
+      free_remote_memtable(rmem);
+      delete group;
+      return;
+    }
+  }
+  auto* next = new MergedTable(*merged);
+  for (uint64_t id : group->ids) (*next)[id] = group;
+  publish_merged(next);
+  DM_LOG_DEBUG("merged rmem ", group->ids.back(), " to ", group->ids.front(),
+               ", max seq ", max_seq);
+  TEST_SYNC_POINT_CALLBACK("RemoteMemTablePool::merge_column_family:Merged",
+                           &group->ids);
+}
+
 Status RemoteMemTablePool::rebuild_remote_memtable(
     void* rdma_buf, uint64_t index, uint64_t index_size, uint64_t mem_meta,
     uint64_t mem_meta_size, uint64_t* mem_data) {
-  Status s = Status::OK();
   void* index_ = reinterpret_cast<char*>(rdma_buf) + index;
   uint64_t id_ = *reinterpret_cast<uint64_t*>(index_);
-  std::pair<void*, uint64_t> mem_data_[4];
-  for (int i = 0; i < 4 /*sep*/; i++) {
+  int shard_num = RemoteMemTable::index_shard_num(index_);
+  if (shard_num == 0) {
+    DM_LOG_WARN("rebuild_remote_memtable id ", id_,
+                " refused, bad shard count in its index");
+    return Status::Corruption("bad shard count in memtable index");
+  }
+  std::pair<void*, uint64_t> mem_data_[kMaxMemTableShards];
+  for (int i = 0; i < shard_num; i++) {
     mem_data_[i].first = reinterpret_cast<char*>(rdma_buf) + mem_data[i * 2];
     mem_data_[i].second = mem_data[i * 2 + 1];
   }
-  RemoteMemTable* rmt = nullptr;
-  RemoteMemTable::register_remote_memTable(
-      rmt, rdma_buf, reinterpret_cast<char*>(rdma_buf) + index, index_size,
-      reinterpret_cast<char*>(rdma_buf) + mem_meta, mem_meta_size, mem_data_);
   {
-    std::lock_guard<std::mutex> lck(mtx_);
-    if (id2ptr_.find(id_) != id2ptr_.end()) {
-      fprintf(stderr, "rebuild_remote_memtable id %lu already exists\n", id_);
-      delete rmt;
+    // cheap check before the rebuild, the insert below decides
+    auto guard = Pin();
+    if (get(id_) != nullptr) {
+      DM_LOG_WARN("rebuild_remote_memtable id ", id_, " already exists");
       return Status::Expired();
-    } else {
-      id2ptr_[id_] = rmt;
     }
   }
+  RemoteMemTable* rmt = nullptr;
+  RemoteMemTable::register_remote_memTable(
+      rmt, rdma_buf, reinterpret_cast<char*>(rdma_buf) + index, index_size,
+      reinterpret_cast<char*>(rdma_buf) + mem_meta, mem_meta_size, mem_data_);
+  // readers reach the memtable only once it is fully rebuilt
   RemoteMemTable::rebuild_remote_memTable(
       rmt, rdma_buf, reinterpret_cast<char*>(rdma_buf) + index, index_size,
       reinterpret_cast<char*>(rdma_buf) + mem_meta, mem_meta_size, mem_data_);
-  return s;
+  std::lock_guard<std::mutex> lck(writer_mtx_);
+  const Table* cur = table_.load();
+  if (cur->count(id_) != 0) {
+    DM_LOG_WARN("rebuild_remote_memtable id ", id_, " already exists");
+    // never published, no reader can hold it
+    free_remote_memtable(rmt);
+    return Status::Expired();
+  }
+  bool newest = true;
+  for (const auto& entry : *cur) {
+    if ((entry.first >> 32) == (id_ >> 32) && entry.first > id_) {
+      newest = false;
+      break;
+    }
+  }
+  // indexed before it is published, a probe that meets one of its entries
+  // early falls back to the walk as no request names it yet
+  point_index_.Add(rmt, newest);
+  Table* next = new Table(*cur);
+  (*next)[id_] = rmt;
+  publish(next);
+  {
+    std::lock_guard<std::mutex> merge_lck(merge_mtx_);
+    merge_pending_.insert(static_cast<uint32_t>(id_ >> 32));
+  }
+  merge_cv_.notify_one();
+  return Status::OK();
+}
+
+Status RemoteMemTablePool::delete_remote_memtable(uint64_t id) {
+  std::lock_guard<std::mutex> lck(writer_mtx_);
+  const Table* cur = table_.load();
+  auto it = cur->find(id);
+  if (it == cur->end()) {
+    return Status::NotFound("id not found");
+  }
+  RemoteMemTable* rmem = it->second;
+  Table* next = new Table(*cur);
+  next->erase(id);
+  publish(next);
+  point_index_.Remove(rmem);
+  dissolve_merged(id);
+  // a delegated read that looked the memtable up before the swap may still
+  // walk its skiplist or copy a value out of its shards
+  epoch_.Retire([this, rmem]() {
+    DM_LOG_DEBUG("unpin rmem: ", rmem->id);
+    unpin_(rmem->index, rmem->index_size);
+    unpin_(rmem->meta, rmem->meta_size);
+    for (auto& shard : rmem->data) unpin_(shard.first, shard.second);
+    free_remote_memtable(rmem);
+  });
+  return Status::OK();
+}
+
+std::vector<memtable_recovery_entry> RemoteMemTablePool::list(
+    uint64_t db_tag, uint32_t cf_id) {
+  std::vector<memtable_recovery_entry> entries;
+  auto guard = Pin();
+  for (const auto& entry : *table_.load()) {
+    const RemoteMemTable* rmem = entry.second;
+    if ((entry.first >> 32) != cf_id || rmem->recovery.db_tag != db_tag) {
+      continue;
+    }
+    entries.push_back({entry.first, rmem->recovery});
+  }
+  return entries;
+}
+
+bool RemoteMemTablePool::get_indexed(imm_read_req_v2* req,
+                                     imm_read_result* res) const {
+  if (req->mixed_ids_size == 0) return false;
+  const char* limit = req->key() + req->memtable_key_len;
+  uint32_t ikey_len = 0;
+  const char* p = GetVarint32Ptr(req->key(), limit, &ikey_len);
+  if (p == nullptr || p + ikey_len > limit || ikey_len < kNumInternalBytes) {
+    return false;
+  }
+  Slice user_key(p, ikey_len - kNumInternalBytes);
+  uint64_t mixed_id = 0;
+  const char* entry = nullptr;
+  bool final = false;
+  if (!point_index_.Lookup(static_cast<uint32_t>(req->mixed_ids()[0] >> 32),
+                     user_key, &mixed_id, &entry, &final) ||
+      !final) {
+    return false;
+  }
+  // a memtable the reader does not see yet, or no longer, holds the newest
+  // version; the ones it names may still hold an older one
+  bool named = false;
+  for (size_t i = 0; i < req->mixed_ids_size && !named; i++) {
+    named = req->mixed_ids()[i] == mixed_id;
+  }
+  if (!named) return false;
+  RemoteMemTable* rmem = get(mixed_id);
+  if (rmem == nullptr) return false;
+  return rmem->memtable->RGetEntry_v2(&rmem->key_cmp->comparator, req, res,
+                                      entry);
+}
+
+RemoteMemTable* RemoteMemTablePool::get_merged(imm_read_req_v2* req, size_t i,
+                                               size_t* covered) const {
+  const MergedTable* merged = merged_.load();
+  if (merged->empty()) return nullptr;
+  auto it = merged->find(req->mixed_ids()[i]);
+  if (it == merged->end()) return nullptr;
+  const MergedGroup* group = it->second;
+  if (i + group->ids.size() > req->mixed_ids_size) return nullptr;
+  for (size_t j = 0; j < group->ids.size(); j++) {
+    if (req->mixed_ids()[i + j] != group->ids[j]) return nullptr;
+  }
+  const char* limit = req->key() + req->memtable_key_len;
+  uint32_t ikey_len = 0;
+  const char* p = GetVarint32Ptr(req->key(), limit, &ikey_len);
+  if (p == nullptr || p + ikey_len > limit || ikey_len < kNumInternalBytes) {
+    return nullptr;
+  }
+  // the versions left out may be what an older snapshot reads
+  if (GetInternalKeySeqno(Slice(p, ikey_len)) < group->max_seq) {
+    return nullptr;
+  }
+  TEST_SYNC_POINT("RemoteMemTablePool::get_merged:Hit");
+  *covered = group->ids.size();
+  return group->rmem;
+}
+
+bool RemoteMemTable::may_contain(imm_read_req_v2* req) const {
+  const char* limit = req->key() + req->memtable_key_len;
+  uint32_t ikey_len = 0;
+  const char* p = GetVarint32Ptr(req->key(), limit, &ikey_len);
+  if (p == nullptr || p + ikey_len > limit ||
+      ikey_len < kNumInternalBytes + bloom_ts_sz) {
+    return true;
+  }
+  Slice user_key(p, ikey_len - kNumInternalBytes - bloom_ts_sz);
+  if (bloom_whole_key) {
+    return bloom->MayContain(user_key);
+  }
+  if (!bloom_prefix_extractor->InDomain(user_key)) {
+    return true;
+  }
+  return bloom->MayContain(bloom_prefix_extractor->Transform(user_key));
 }
 
 void RemoteMemTable::remote_get_v2(void* req_data_v2, void* ret_data) {
   assert(memtable != nullptr);
+  auto* req = reinterpret_cast<imm_read_req_v2*>(req_data_v2);
+  if (bloom != nullptr && !may_contain(req)) {
+    // the reply of a skiplist walk that finds nothing
+    auto* res = reinterpret_cast<imm_read_result*>(ret_data);
+    res->status_code = -1;
+    res->found_final_value = req->found_final_value;
+    res->seq = kMaxSequenceNumber;
+    res->value = nullptr;
+    res->value_size = 0;
+    res->timestamp_size = req->timestamp_size_;
+    if (req->timestamp_size_ >= 0) {
+      res->timestamp.assign(req->timestamp(), req->timestamp_size_);
+    }
+    return;
+  }
   memtable->RGet_v2(&(key_cmp->comparator), req_data_v2, ret_data);
 }
 
+void RemoteMemTable::remote_scan(imm_scan_req* req, imm_scan_ret* ret,
+                                 char* end, const char* rdma_buf) {
+  assert(memtable != nullptr);
+  std::unique_ptr<MemTableRep::Iterator> iter(memtable->GetIterator());
+  Slice target(req->key(), req->key_len);
+  auto at_target = [&]() {
+    return iter->Valid() && GetLengthPrefixedSlice(iter->key()) == target;
+  };
+  bool backward = false;
+  switch (req->mode) {
+    case kScanFirst:
+      iter->SeekToFirst();
+      break;
+    case kScanLast:
+      iter->SeekToLast();
+      backward = true;
+      break;
+    case kScanSeek:
+      iter->Seek(target, nullptr);
+      break;
+    case kScanSeekForPrev:
+      iter->SeekForPrev(target, nullptr);
+      backward = true;
+      break;
+    case kScanAfter:
+      iter->Seek(target, nullptr);
+      if (at_target()) iter->Next();
+      break;
+    case kScanBefore:
+      iter->SeekForPrev(target, nullptr);
+      if (at_target()) iter->Prev();
+      backward = true;
+      break;
+    default:
+      ret->status_code = Status::Code::kInvalidArgument;
+      return;
+  }
+
+  ret->status_code = Status::Code::kOk;
+  char* cursor = ret->entries();
+  while (iter->Valid() && ret->num_entries < req->max_entries) {
+    Slice ikey = GetLengthPrefixedSlice(iter->key());
+    Slice value = GetLengthPrefixedSlice(ikey.data() + ikey.size());
+    size_t head = VarintLength(ikey.size()) + ikey.size() +
+                  VarintLength(value.size()) + 1;
+    bool remote = false;
+    if (cursor + head + value.size() > end) {
+      if (ret->num_entries > 0) {
+        break;  // the next request resumes from the last entry sent
+      }
+      remote = true;
+      if (cursor + head + sizeof(imm_read_frag) > end) {
+        ret->status_code = Status::Code::kIncomplete;
+        break;
+      }
+    }
+    cursor = EncodeVarint32(cursor, static_cast<uint32_t>(ikey.size()));
+    memcpy(cursor, ikey.data(), ikey.size());
+    cursor += ikey.size();
+    cursor = EncodeVarint32(cursor, static_cast<uint32_t>(value.size()));
+    *cursor++ = remote ? 1 : 0;
+    if (remote) {
+      imm_read_frag frag{static_cast<uint64_t>(value.data() - rdma_buf),
+                         value.size()};
+      memcpy(cursor, &frag, sizeof(frag));
+      cursor += sizeof(frag);
+    } else {
+      memcpy(cursor, value.data(), value.size());
+      cursor += value.size();
+    }
+    ret->num_entries++;
+    if (backward) {
+      iter->Prev();
+    } else {
+      iter->Next();
+    }
+  }
+  ret->exhausted = !iter->Valid();
+  ret->len = cursor - ret->entries();
+}
+
 }  // namespace ROCKSDB_NAMESPACE
\ No newline at end of file
@@ -1,14 +1,23 @@
 #pragma once
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
+#include <set>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "db/db_impl/db_impl.h"
 #include "db/memtable.h"
+#include "memory/epoch_manager.h"
+#include "memory/memtable_point_index.h"
 #include "memory/sep_concurrent_arena.h"
 #include "rocksdb/memtablerep.h"
 #include "rocksdb/remote_flush_service.h"
 #include "rocksdb/slice_transform.h"
 #include "rocksdb/status.h"
+#include "util/dynamic_bloom.h"
 namespace ROCKSDB_NAMESPACE {
 struct RemoteMemTable {
   uint64_t index{0};
@@ -22,6 +31,27 @@ struct RemoteMemTable {
   SepConcurrentArena* arena{nullptr};
   MemTable::KeyComparator* key_cmp{nullptr};
   SliceTransform* prefix_extractor{nullptr};
+  // view over the bloom filter bits shipped in the meta arena, nullptr if
+  // the memtable came without one
+  DynamicBloom* bloom{nullptr};
+  bool bloom_whole_key{true};
+  uint16_t bloom_ts_sz{0};
+  // user key prefix extractor the filter was built with, not owned
+  const SliceTransform* bloom_prefix_extractor{nullptr};
+  // as shipped in the index block, zeroed for an older compute node
+  memtable_recovery_info recovery{};
+  // number of kv shards recorded in a skiplist index block, 0 if the block
+  // records none or more than kMaxMemTableShards
+  static inline int index_shard_num(const void* index) {
+    int32_t shard_num = 0;
+    memcpy(&shard_num,
+           reinterpret_cast<const char*>(index) + MEMTABLE_INDEX_SHARDS,
+           sizeof(int32_t));
+    if (shard_num <= 0 || shard_num > kMaxMemTableShards) {
+      return 0;
+    }
+    return shard_num;
+  }
   static void rebuild_remote_memTable(RemoteMemTable* rmt, void* rdma_buf,
                                       void* index, uint64_t index_size,
                                       void* mem_meta, uint64_t mem_meta_size,
@@ -30,57 +60,110 @@ struct RemoteMemTable {
                                        void* index, uint64_t index_size,
                                        void* mem_meta, uint64_t mem_meta_size,
                                        std::pair<void*, uint64_t>* mem_data);
+  // read only memtable over the entries of members, newest first, that a
+  // read at a sequence number of at least *max_seq reaches; shadowed
+  // versions are left out and the entries stay in the shards of members
+  static RemoteMemTable* merge_remote_memTables(
+      const std::vector<RemoteMemTable*>& members, SequenceNumber* max_seq);
+  // false if the bloom filter rules out the key of req
+  bool may_contain(imm_read_req_v2* req) const;
   void remote_get_v2(void* req_data_v2, void* ret_data);
+  // fill the entries of a delegated scan reply, stops before end; rdma_buf
+  // is the base the offsets of values sent back as imm_read_frag refer to
+  void remote_scan(imm_scan_req* req, imm_scan_ret* ret, char* end,
+                   const char* rdma_buf);
 };
 class DBImpl;
+// Memtables rebuilt on this memnode by mixed id. Lookups run on the
+// delegated read path and never block: readers load an immutable snapshot
+// of the map and writers publish a modified copy. A deleted memtable is
+// freed and its memory unpinned once every reader that may still walk it
+// has left.
+//
+// A background job merges runs of adjacent memtables of a column family
+// into one read only memtable, a delegated read naming the whole run
+// searches that one instead. The memtables of the run stay registered for
+// flushes and scans, the merged one goes with the first of them deleted.
 class RemoteMemTablePool {
  public:
+  // memtables a merge takes at least and at most
+  static constexpr size_t kMergeMinMemTables = 4;
+  static constexpr size_t kMergeMaxMemTables = 16;
+
+  // releases a pinned range of the rdma buffer of a reclaimed memtable
+  using UnpinFunc = std::function<void(uint64_t offset, uint64_t size)>;
+
+  explicit RemoteMemTablePool(UnpinFunc unpin);
+  ~RemoteMemTablePool();
+
   Status rebuild_remote_memtable(void* rdma_buf, uint64_t index,
                                  uint64_t index_size, uint64_t mem_meta,
                                  uint64_t mem_meta_size, uint64_t* mem_data);
 
-  inline Status delete_remote_memtable(uint64_t id, uint64_t* to_unpin) {
-    Status s = Status::OK();
-    std::lock_guard<std::mutex> lock(mtx_);
-    if (id2ptr_.find(id) == id2ptr_.end()) {
-      s = Status::NotFound("id not found");
-    } else {
-      RemoteMemTable* rmem = id2ptr_[id];
-      delete rmem->memtable;
-      delete rmem->arena;
-      delete rmem->key_cmp;
-      delete rmem->prefix_extractor;
-      LOG_CERR("unpin rmem: ", rmem->id, ' ', id);
-      to_unpin[0] = rmem->index;
-      to_unpin[1] = rmem->index_size;
-      to_unpin[2] = rmem->meta;
-      to_unpin[3] = rmem->meta_size;
-      for (int i = 0; i < rmem->data.size(); i++) {
-        to_unpin[4 + i * 2] = rmem->data[i].first;
-        to_unpin[5 + i * 2] = rmem->data[i].second;
-      }
-      id2ptr_.erase(id);
-      delete rmem;
-    }
-    return s;
-  }
+  // unlinks the memtable, it is reclaimed after the readers pinned now
+  Status delete_remote_memtable(uint64_t id);
 
-  RemoteMemTable* get(uint64_t id) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    auto it = id2ptr_.find(id);
-    if (it == id2ptr_.end()) {
-      return nullptr;
-    }
-    return it->second;
-  }
+  // held while a reader uses what get() returned
+  EpochManager::Guard Pin() { return epoch_.Enter(); }
+
+  // memtables of column family cf_id shipped by the DB tagged db_tag, for a
+  // compute node taking them back after a restart
+  std::vector<memtable_recovery_entry> list(uint64_t db_tag,
+                                            uint32_t cf_id);
 
-  void erase(uint64_t id) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    id2ptr_.erase(id);
+  // lock free, the caller holds a Pin()
+  RemoteMemTable* get(uint64_t id) const {
+    const Table* table = table_.load();
+    auto it = table->find(id);
+    return it == table->end() ? nullptr : it->second;
   }
 
+  // answers req from the point index if the newest version of its key is
+  // in one of the memtables req names, false if the caller has to walk
+  // them; the caller holds a Pin()
+  bool get_indexed(imm_read_req_v2* req, imm_read_result* res) const;
+
+  // the merged memtable standing in for the memtables req names from
+  // mixed_ids()[i] on, nullptr if req cannot use one; *covered gets how
+  // many it stands in for. The caller holds a Pin()
+  RemoteMemTable* get_merged(imm_read_req_v2* req, size_t i,
+                             size_t* covered) const;
+
  private:
-  std::mutex mtx_;
-  std::unordered_map<uint64_t, RemoteMemTable*> id2ptr_;
+  using Table = std::unordered_map<uint64_t, RemoteMemTable*>;
+  struct MergedGroup {
+    RemoteMemTable* rmem;
+    // of the memtables merged, newest first
+    std::vector<uint64_t> ids;
+    // reads at an older snapshot may need a version the merge left out
+    SequenceNumber max_seq;
+  };
+  // every memtable of a group maps to it
+  using MergedTable = std::unordered_map<uint64_t, const MergedGroup*>;
+
+  static void free_remote_memtable(RemoteMemTable* rmem);
+  // swaps in table and retires the previous one, writer_mtx_ held
+  void publish(Table* table);
+  void publish_merged(MergedTable* merged);
+  // unlinks the group of memtable id if any, writer_mtx_ held
+  void dissolve_merged(uint64_t id);
+  void merge_loop();
+  // merges the newest run of adjacent unmerged memtables of cf_id
+  void merge_column_family(uint32_t cf_id);
+
+  UnpinFunc unpin_;
+  EpochManager epoch_;
+  std::mutex writer_mtx_;
+  std::atomic<Table*> table_;
+  // covers the memtables in table_ and, while one is being added, that one
+  MemTablePointIndex point_index_;
+  std::atomic<MergedTable*> merged_;
+
+  // column families with a memtable registered since their last merge
+  std::mutex merge_mtx_;
+  std::condition_variable merge_cv_;
+  std::set<uint32_t> merge_pending_;
+  bool merge_stop_{false};
+  std::thread merge_thread_;
 };
 }  // namespace ROCKSDB_NAMESPACE
\ No newline at end of file
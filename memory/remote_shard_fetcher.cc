@@ -0,0 +1,146 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#include "memory/remote_shard_fetcher.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "db/tcprw.h"
+#include "memory/remote_memtable_service.h"
+#include "rocksdb/logger.hpp"
+#include "rocksdb/memtablerep.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+RemoteShardFetcher::RemoteShardFetcher(RDMAClient *client,
+                                       RDMANode::rdma_connection *conn,
+                                       std::function<void()> done)
+    : client_(client), conn_(conn), done_(std::move(done)) {}
+
+RemoteShardFetcher::~RemoteShardFetcher() {
+  if (thread_.joinable()) thread_.join();
+  for (auto &src : sources_) {
+    for (int64_t local : src.local) {
+      if (local != -1) client_->rdma_mem_.free(local);
+    }
+  }
+}
+
+void RemoteShardFetcher::Add(RemoteMemTable *rmem,
+                             const std::pair<int64_t, uint64_t> *remote) {
+  Source src;
+  src.rmem = rmem;
+  src.remote.assign(remote, remote + rmem->data.size());
+  src.local.assign(rmem->data.size(), -1);
+  sources_.push_back(std::move(src));
+}
+
+void RemoteShardFetcher::Start() {
+  assert(!thread_.joinable());
+  for (const auto &src : sources_) {
+    shard_num_ = std::max(shard_num_, static_cast<int>(src.remote.size()));
+  }
+  released_.assign(shard_num_, false);
+  thread_ = std::thread([this]() { Run(); });
+}
+
+Status RemoteShardFetcher::WaitShard(int s) {
+  std::unique_lock<std::mutex> lck(mu_);
+  cv_.wait(lck, [&]() {
+    return fetched_ > s || fetched_ == shard_num_ || !status_.ok();
+  });
+  return fetched_ > s || fetched_ == shard_num_ ? Status::OK() : status_;
+}
+
+void RemoteShardFetcher::ReleaseShard(int s) {
+  std::lock_guard<std::mutex> lck(mu_);
+  // none of the memtables has a shard s
+  if (s >= shard_num_) return;
+  if (fetched_ <= s) {
+    // never attached, the fetch failed before it
+    assert(!status_.ok());
+    return;
+  }
+  assert(!released_[s]);
+  for (auto &src : sources_) {
+    if (s < static_cast<int>(src.local.size()) && src.local[s] != -1) {
+      client_->rdma_mem_.free(src.local[s]);
+      src.local[s] = -1;
+    }
+  }
+  released_[s] = true;
+  resident_--;
+  cv_.notify_all();
+}
+
+void RemoteShardFetcher::Run() {
+  for (int s = 0; s < shard_num_; s++) {
+    {
+      std::unique_lock<std::mutex> lck(mu_);
+      cv_.wait(lck, [&]() { return resident_ < kResidentShards; });
+    }
+    Status st = FetchShard(s);
+    if (!st.ok()) {
+      DM_LOG_ERROR("fetch shard ", s, " failed: ", st.ToString());
+      std::lock_guard<std::mutex> lck(mu_);
+      status_ = st;
+      cv_.notify_all();
+      break;
+    }
+    std::lock_guard<std::mutex> lck(mu_);
+    resident_++;
+    fetched_ = s + 1;
+    cv_.notify_all();
+  }
+  DM_LOG_DEBUG("fetched ", shard_num_, " shards of ", sources_.size(),
+               " memtables");
+  if (done_) done_();
+}
+
+Status RemoteShardFetcher::FetchShard(int s) {
+  int inflight = 0;
+  std::vector<int64_t> local(sources_.size(), -1);
+  Status st;
+  for (size_t i = 0; st.ok() && i < sources_.size(); i++) {
+    const Source &src = sources_[i];
+    if (s >= static_cast<int>(src.remote.size())) continue;
+    int64_t remote = src.remote[s].first;
+    uint64_t size = src.remote[s].second;
+    if (size == 0) continue;
+    st = client_->rdma_mem_.allocate_wait(size, &local[i]);
+    if (!st.ok()) break;
+    for (uint64_t off = 0; off < size; off += kChunkSize) {
+      if (inflight == kMaxReads) {
+        ASSERT_RW(client_->poll_completion(conn_) == 0);
+        inflight--;
+      }
+      client_->rdma_read(conn_, std::min(kChunkSize, size - off),
+                         local[i] + off, remote + off);
+      inflight++;
+    }
+  }
+  for (; inflight > 0; inflight--) {
+    ASSERT_RW(client_->poll_completion(conn_) == 0);
+  }
+  if (!st.ok()) {
+    for (int64_t offset : local) {
+      if (offset != -1) client_->rdma_mem_.free(offset);
+    }
+    return st;
+  }
+  // the builders of this shard walk the rep only after WaitShard()
+  std::lock_guard<std::mutex> lck(mu_);
+  for (size_t i = 0; i < sources_.size(); i++) {
+    if (local[i] == -1) continue;
+    Source &src = sources_[i];
+    src.local[s] = local[i];
+    src.rmem->memtable->set_shard_remote_begin(s,
+                                               client_->get_buf() + local[i]);
+    src.rmem->data[s] = {static_cast<uint64_t>(local[i]), src.remote[s].second};
+  }
+  return st;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,90 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rocksdb/remote_flush_service.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+struct RemoteMemTable;
+
+// Reads the kv shards of the memtables of a remote flush into the
+// registered buffer while the worker already builds the SSTs of the shards
+// that arrived. The output file of shard s is built from shard s of every
+// memtable, so shards arrive by that column: shard 0 of all memtables
+// first, then shard 1, and so on. Each shard is split into chunks with a
+// few reads in flight at once.
+//
+// At most kResidentShards columns are staged at a time, the next one is
+// read once the build of an earlier one released it, so the buffer a flush
+// holds no longer grows with the memtables it covers.
+//
+// If the registered buffer has no room for a shard the fetch stops, the
+// shards not attached yet are reported failed by WaitShard().
+class RemoteShardFetcher {
+ public:
+  static constexpr uint64_t kChunkSize = 1 << 20;
+  static constexpr int kMaxReads = 8;
+  static constexpr int kResidentShards = 2;
+
+  // conn is used for the reads only, done runs on the fetch thread once
+  // the last one completed
+  RemoteShardFetcher(RDMAClient *client, RDMANode::rdma_connection *conn,
+                     std::function<void()> done);
+  // waits for the fetch thread, frees the shards not released
+  ~RemoteShardFetcher();
+  RemoteShardFetcher(const RemoteShardFetcher &) = delete;
+  void operator=(const RemoteShardFetcher &) = delete;
+
+  // remote: memnode offset and size of each shard of rmem, as returned by
+  // RDMAClient::locate_memtable_request
+  void Add(RemoteMemTable *rmem, const std::pair<int64_t, uint64_t> *remote);
+  // starts reading the shards of the memtables added
+  void Start();
+  // blocks until shard s of every memtable is attached to its rep, or the
+  // fetch failed before it did
+  Status WaitShard(int s);
+  // frees the buffers of shard s, its SST is built or given up
+  void ReleaseShard(int s);
+
+ private:
+  struct Source {
+    RemoteMemTable *rmem;
+    std::vector<std::pair<int64_t, uint64_t>> remote;
+    // registered buffer offset of each shard, -1 if not resident
+    std::vector<int64_t> local;
+  };
+
+  void Run();
+  // reads shard s of every source, up to kMaxReads chunks in flight
+  Status FetchShard(int s);
+
+  RDMAClient *client_;
+  RDMANode::rdma_connection *conn_;
+  std::function<void()> done_;
+  std::vector<Source> sources_;
+  int shard_num_ = 0;
+  std::thread thread_;
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  // shards attached so far, all below fetched_
+  int fetched_ = 0;
+  int resident_ = 0;
+  std::vector<bool> released_;
+  // why the shards past fetched_ never arrive
+  Status status_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,250 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memory/remote_shard_fetcher.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "memory/remote_memtable_service.h"
+#include "port/port.h"
+#include "test_util/testharness.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+// the memnode end of a shm connection, keeps the connection it accepted
+class ShardServer : public RDMANode {
+ public:
+  RDMANode::rdma_connection *WaitConnection() {
+    std::unique_lock<std::mutex> lck(mu_);
+    cv_.wait(lck, [this]() { return conn_ != nullptr; });
+    return conn_;
+  }
+
+ private:
+  void after_connect_qp(RDMANode::rdma_connection *conn) override {
+    std::lock_guard<std::mutex> lck(mu_);
+    conn_ = conn;
+    cv_.notify_all();
+  }
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  RDMANode::rdma_connection *conn_ = nullptr;
+};
+
+// records where the fetcher attached every shard
+class ShardRecordingRep : public MemTableRep {
+ public:
+  ShardRecordingRep() : MemTableRep(nullptr), begin_(kMaxMemTableShards) {}
+
+  void set_shard_remote_begin(int sep, void *remote) override {
+    begin_[sep].store(remote);
+  }
+  char *shard_begin(int sep) const {
+    return static_cast<char *>(begin_[sep].load());
+  }
+
+  void Insert(KeyHandle) override { assert(false); }
+  bool Contains(const char *) const override { return false; }
+  size_t ApproximateMemoryUsage() override { return 0; }
+  MemTableRep::Iterator *GetIterator(Arena *) override { return nullptr; }
+
+ private:
+  std::vector<std::atomic<void *>> begin_;
+};
+}  // namespace
+
+class RemoteShardFetcherTest : public testing::Test {
+ protected:
+  static constexpr size_t kBufSize = 32 << 20;
+
+  void SetUp() override {
+    setenv("ROCKSDB_DM_TRANSPORT", "shm", 1);
+    // a port nothing holds, the server binds it without SO_REUSEADDR
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(0, bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len));
+    close(fd);
+    int port = ntohs(addr.sin_port);
+
+    // never freed, it accepts connections until the process exits
+    server_ = new ShardServer();
+    ASSERT_EQ(0, server_->resources_create(kBufSize));
+    std::thread([server = server_, port]() { server->sock_connect("", port); })
+        .detach();
+    client_.reset(new RDMAClient());
+    ASSERT_EQ(0, client_->resources_create(kBufSize));
+    client_->rdma_mem_.init(client_->buf_size);
+    for (int i = 0; i < 500 && conn_ == nullptr; i++) {
+      conn_ = client_->sock_connect("127.0.0.1", port);
+      if (conn_ == nullptr) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    ASSERT_NE(nullptr, conn_);
+    server_->WaitConnection();
+  }
+
+  // a memtable whose shards are laid out back to back on the memnode from
+  // *remote_end on, every byte tells the memtable, shard and offset apart
+  void AddMemTable(const std::vector<uint64_t> &sizes, uint64_t *remote_end) {
+    auto rep = std::make_shared<ShardRecordingRep>();
+    auto rmem = std::make_shared<RemoteMemTable>();
+    rmem->memtable = rep.get();
+    rmem->data.resize(sizes.size());
+    std::vector<std::pair<int64_t, uint64_t>> remote;
+    for (size_t s = 0; s < sizes.size(); s++) {
+      remote.emplace_back(*remote_end, sizes[s]);
+      for (uint64_t off = 0; off < sizes[s]; off++) {
+        server_->get_buf()[*remote_end + off] = Pattern(reps_.size(), s, off);
+      }
+      *remote_end += sizes[s];
+    }
+    reps_.push_back(rep);
+    rmems_.push_back(rmem);
+    remote_.push_back(remote);
+  }
+
+  static char Pattern(size_t mem, size_t shard, uint64_t off) {
+    return static_cast<char>(mem * 31 + shard * 7 + off % 251);
+  }
+
+  // shard s of memtable mem is attached and holds what the memnode has
+  void CheckShard(size_t mem, int s) {
+    const RemoteMemTable &rmem = *rmems_[mem];
+    uint64_t size = remote_[mem][s].second;
+    char *begin = reps_[mem]->shard_begin(s);
+    ASSERT_NE(nullptr, begin);
+    ASSERT_EQ(client_->get_buf() + rmem.data[s].first, begin);
+    ASSERT_EQ(size, rmem.data[s].second);
+    for (uint64_t off = 0; off < size; off++) {
+      ASSERT_EQ(Pattern(mem, s, off), begin[off]);
+    }
+  }
+
+  void AddAll(RemoteShardFetcher *fetcher) {
+    for (size_t i = 0; i < rmems_.size(); i++) {
+      fetcher->Add(rmems_[i].get(), remote_[i].data());
+    }
+  }
+
+  ShardServer *server_ = nullptr;
+  std::unique_ptr<RDMAClient> client_;
+  RDMANode::rdma_connection *conn_ = nullptr;
+  std::vector<std::shared_ptr<ShardRecordingRep>> reps_;
+  std::vector<std::shared_ptr<RemoteMemTable>> rmems_;
+  std::vector<std::vector<std::pair<int64_t, uint64_t>>> remote_;
+};
+
+TEST_F(RemoteShardFetcherTest, AttachesEveryShard) {
+  uint64_t remote_end = 0;
+  // larger than a read and than all reads in flight, and memtables with
+  // fewer or empty shards
+  AddMemTable({RemoteShardFetcher::kChunkSize * 5 / 2, 4096, 100}, &remote_end);
+  AddMemTable({RemoteShardFetcher::kChunkSize * 9, 0}, &remote_end);
+  AddMemTable({1, 2, 3, 4}, &remote_end);
+
+  std::atomic<int> done{0};
+  RemoteShardFetcher fetcher(client_.get(), conn_, [&]() { done++; });
+  AddAll(&fetcher);
+  fetcher.Start();
+  for (int s = 0; s < 4; s++) {
+    ASSERT_OK(fetcher.WaitShard(s));
+    for (size_t mem = 0; mem < rmems_.size(); mem++) {
+      if (s < static_cast<int>(remote_[mem].size()) &&
+          remote_[mem][s].second > 0) {
+        CheckShard(mem, s);
+      } else if (s < static_cast<int>(remote_[mem].size())) {
+        ASSERT_EQ(nullptr, reps_[mem]->shard_begin(s));
+      }
+    }
+    fetcher.ReleaseShard(s);
+  }
+  // no memtable has more shards
+  ASSERT_OK(fetcher.WaitShard(4));
+  fetcher.ReleaseShard(4);
+  while (done.load() == 0) {
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(0u, client_->rdma_mem_.stats().allocated);
+}
+
+TEST_F(RemoteShardFetcherTest, KeepsFewShardsResident) {
+  uint64_t remote_end = 0;
+  constexpr int kShards = RemoteShardFetcher::kResidentShards + 2;
+  AddMemTable(std::vector<uint64_t>(kShards, 4096), &remote_end);
+  AddMemTable(std::vector<uint64_t>(kShards, 8192), &remote_end);
+
+  RemoteShardFetcher fetcher(client_.get(), conn_, nullptr);
+  AddAll(&fetcher);
+  fetcher.Start();
+  ASSERT_OK(fetcher.WaitShard(RemoteShardFetcher::kResidentShards - 1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // the next shard waits for a builder to release one
+  for (size_t mem = 0; mem < rmems_.size(); mem++) {
+    ASSERT_EQ(nullptr,
+              reps_[mem]->shard_begin(RemoteShardFetcher::kResidentShards));
+  }
+  for (int s = 0; s < kShards; s++) {
+    ASSERT_OK(fetcher.WaitShard(s));
+    CheckShard(0, s);
+    CheckShard(1, s);
+    fetcher.ReleaseShard(s);
+  }
+}
+
+TEST_F(RemoteShardFetcherTest, DestructorFreesUnreleasedShards) {
+  uint64_t remote_end = 0;
+  AddMemTable({4096, 4096, 4096}, &remote_end);
+  {
+    RemoteShardFetcher fetcher(client_.get(), conn_, nullptr);
+    AddAll(&fetcher);
+    fetcher.Start();
+    ASSERT_OK(fetcher.WaitShard(0));
+    fetcher.ReleaseShard(0);
+    ASSERT_OK(fetcher.WaitShard(2));
+    // shards 1 and 2 are given up with the job
+  }
+  ASSERT_EQ(0u, client_->rdma_mem_.stats().allocated);
+}
+
+TEST_F(RemoteShardFetcherTest, NothingToFetch) {
+  uint64_t remote_end = 0;
+  AddMemTable({0}, &remote_end);
+  bool done = false;
+  {
+    RemoteShardFetcher fetcher(client_.get(), conn_, [&]() { done = true; });
+    AddAll(&fetcher);
+    fetcher.Start();
+    ASSERT_OK(fetcher.WaitShard(0));
+    fetcher.ReleaseShard(0);
+  }
+  ASSERT_TRUE(done);
+  ASSERT_EQ(nullptr, reps_[0]->shard_begin(0));
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
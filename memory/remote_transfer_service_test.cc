@@ -0,0 +1,245 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "rocksdb/remote_transfer_service.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "port/port.h"
+#include "test_util/testharness.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+class RemoteTransferServiceTest : public testing::Test {
+ protected:
+  RemoteTransferServiceTest() : buf_(1 << 16, '\0') {}
+
+  PackageWriteService Writer() {
+    return PackageWriteService(&buf_[0], buf_.size());
+  }
+  remote_package_header Header() const {
+    remote_package_header header;
+    memcpy(&header, buf_.data(), sizeof(header));
+    return header;
+  }
+  void SetHeader(const remote_package_header& header) {
+    memcpy(&buf_[0], &header, sizeof(header));
+  }
+
+  template <typename T>
+  static void Send(PackageWriteService* w, const T& v) {
+    ASSERT_TRUE(w->send(&v, sizeof(v)));
+  }
+  template <typename T>
+  static T Receive(PackageReadService* r) {
+    T v;
+    memset(&v, 0xab, sizeof(v));
+    EXPECT_TRUE(r->receive(&v, sizeof(v)));
+    return v;
+  }
+
+  std::string buf_;
+};
+
+TEST_F(RemoteTransferServiceTest, RoundTripEveryFieldKind) {
+  Random rnd(301);
+  const std::string short_blob = rnd.RandomString(9);
+  const std::string longest_short = rnd.RandomString(
+      static_cast<int>(PackageWriteService::kSharedMin) - 1);
+  const std::string shortest_long =
+      rnd.RandomString(static_cast<int>(PackageWriteService::kSharedMin));
+  const std::string options_blob = rnd.RandomString(1000);
+
+  auto w = Writer();
+  Send(&w, uint8_t{0xfe});
+  Send(&w, uint16_t{0xbeef});
+  Send(&w, std::numeric_limits<uint32_t>::max());
+  Send(&w, std::numeric_limits<uint64_t>::max());
+  Send(&w, int64_t{-5});
+  Send(&w, int32_t{-7});
+  Send(&w, true);
+  Send(&w, 3.25);
+  Send(&w, uint64_t{0});
+  ASSERT_TRUE(w.send(short_blob.data(), 0));
+  ASSERT_TRUE(w.send(short_blob.data(), short_blob.size()));
+  ASSERT_TRUE(w.send(longest_short.data(), longest_short.size()));
+  ASSERT_TRUE(w.send(shortest_long.data(), shortest_long.size()));
+  ASSERT_TRUE(w.send(options_blob.data(), options_blob.size()));
+  // repeated by every memtable of the job
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(w.send(options_blob.data(), options_blob.size()));
+    ASSERT_TRUE(w.send(shortest_long.data(), shortest_long.size()));
+  }
+  size_t size = w.Finish();
+  ASSERT_EQ(w.get_size(), size);
+  // the repeated long fields take a byte each
+  ASSERT_LT(size, sizeof(remote_package_header) + 64 + short_blob.size() +
+                      longest_short.size() + shortest_long.size() +
+                      options_blob.size() + 20);
+  remote_package_header header = Header();
+  ASSERT_EQ(PackageWriteService::kMagic, header.magic);
+  ASSERT_EQ(PackageWriteService::kVersion, header.version);
+  ASSERT_EQ(size - sizeof(header), header.body_size);
+
+  PackageReadService r(buf_.data(), size);
+  ASSERT_TRUE(r.Valid());
+  ASSERT_EQ(0xfe, Receive<uint8_t>(&r));
+  ASSERT_EQ(0xbeef, Receive<uint16_t>(&r));
+  ASSERT_EQ(std::numeric_limits<uint32_t>::max(), Receive<uint32_t>(&r));
+  ASSERT_EQ(std::numeric_limits<uint64_t>::max(), Receive<uint64_t>(&r));
+  ASSERT_EQ(-5, Receive<int64_t>(&r));
+  ASSERT_EQ(-7, Receive<int32_t>(&r));
+  ASSERT_TRUE(Receive<bool>(&r));
+  ASSERT_EQ(3.25, Receive<double>(&r));
+  ASSERT_EQ(0U, Receive<uint64_t>(&r));
+  ASSERT_TRUE(r.receive(nullptr, 0));
+  std::string got(short_blob.size(), '\0');
+  ASSERT_TRUE(r.receive(&got[0], got.size()));
+  ASSERT_EQ(short_blob, got);
+  // short fields are viewed in place too
+  const char* field = r.view(longest_short.size());
+  ASSERT_NE(nullptr, field);
+  ASSERT_EQ(longest_short, std::string(field, longest_short.size()));
+  got.assign(shortest_long.size(), '\0');
+  ASSERT_TRUE(r.receive(&got[0], got.size()));
+  ASSERT_EQ(shortest_long, got);
+  const char* options = r.view(options_blob.size());
+  ASSERT_NE(nullptr, options);
+  ASSERT_EQ(options_blob, std::string(options, options_blob.size()));
+  for (int i = 0; i < 10; i++) {
+    // a back-reference views the first copy
+    ASSERT_EQ(options, r.view(options_blob.size()));
+    got.assign(shortest_long.size(), '\0');
+    ASSERT_TRUE(r.receive(&got[0], got.size()));
+    ASSERT_EQ(shortest_long, got);
+  }
+  ASSERT_TRUE(r.Valid());
+  // nothing is left
+  ASSERT_FALSE(r.receive(&got[0], 1));
+  ASSERT_FALSE(r.Valid());
+}
+
+TEST_F(RemoteTransferServiceTest, SharedByContent) {
+  std::string blob(100, 'a');
+  auto w = Writer();
+  ASSERT_TRUE(w.send(blob.data(), blob.size()));
+  // the same buffer with other bytes is a new field
+  blob[50] = 'b';
+  ASSERT_TRUE(w.send(blob.data(), blob.size()));
+  // a copy elsewhere with the first bytes refers back
+  std::string first(100, 'a');
+  ASSERT_TRUE(w.send(first.data(), first.size()));
+  // a prefix of a long field is not the same field
+  ASSERT_TRUE(w.send(first.data(), 64));
+  size_t size = w.Finish();
+  ASSERT_GT(size, 0U);
+
+  PackageReadService r(buf_.data(), size);
+  const char* a = r.view(100);
+  const char* b = r.view(100);
+  const char* c = r.view(100);
+  const char* d = r.view(64);
+  ASSERT_TRUE(r.Valid());
+  ASSERT_EQ(std::string(100, 'a'), std::string(a, 100));
+  ASSERT_EQ(blob, std::string(b, 100));
+  ASSERT_NE(a, b);
+  ASSERT_EQ(a, c);
+  ASSERT_NE(a, d);
+  ASSERT_EQ(std::string(64, 'a'), std::string(d, 64));
+}
+
+TEST_F(RemoteTransferServiceTest, RejectsUnknownHeader) {
+  auto w = Writer();
+  Send(&w, uint64_t{42});
+  size_t size = w.Finish();
+  ASSERT_GT(size, 0U);
+  remote_package_header header = Header();
+  {
+    PackageReadService r(buf_.data(), size);
+    ASSERT_TRUE(r.Valid());
+    ASSERT_EQ(42U, Receive<uint64_t>(&r));
+  }
+  for (uint32_t version : {0U, PackageWriteService::kVersion - 1,
+                           PackageWriteService::kVersion + 1}) {
+    remote_package_header bad = header;
+    bad.version = version;
+    SetHeader(bad);
+    PackageReadService r(buf_.data(), size);
+    ASSERT_FALSE(r.Valid());
+    uint64_t v = 0;
+    ASSERT_FALSE(r.receive(&v, sizeof(v)));
+    ASSERT_EQ(nullptr, r.view(100));
+  }
+  {
+    remote_package_header bad = header;
+    bad.magic = 0;
+    SetHeader(bad);
+    PackageReadService r(buf_.data(), size);
+    ASSERT_FALSE(r.Valid());
+  }
+  {
+    SetHeader(header);
+    PackageReadService r(buf_.data(), size - 1);
+    ASSERT_FALSE(r.Valid());
+  }
+  {
+    PackageReadService r(buf_.data(), sizeof(header) - 1);
+    ASSERT_FALSE(r.Valid());
+  }
+}
+
+TEST_F(RemoteTransferServiceTest, RejectsBadFields) {
+  auto w = Writer();
+  Send(&w, uint64_t{300});
+  std::string blob(100, 'x');
+  ASSERT_TRUE(w.send(blob.data(), blob.size()));
+  ASSERT_TRUE(w.send(blob.data(), blob.size()));
+  size_t size = w.Finish();
+  {
+    // 300 does not fit the byte the reader expects
+    PackageReadService r(buf_.data(), size);
+    uint8_t v = 0;
+    ASSERT_FALSE(r.receive(&v, sizeof(v)));
+    ASSERT_FALSE(r.Valid());
+  }
+  {
+    // a back-reference to a field of another size
+    PackageReadService r(buf_.data(), size);
+    ASSERT_EQ(300U, Receive<uint64_t>(&r));
+    ASSERT_NE(nullptr, r.view(100));
+    ASSERT_EQ(nullptr, r.view(99));
+    ASSERT_FALSE(r.Valid());
+  }
+  {
+    // a field past the end of the body
+    PackageReadService r(buf_.data(), size);
+    ASSERT_EQ(300U, Receive<uint64_t>(&r));
+    ASSERT_EQ(nullptr, r.view(1000));
+    ASSERT_FALSE(r.Valid());
+  }
+}
+
+TEST_F(RemoteTransferServiceTest, WriterOverflow) {
+  std::string small(sizeof(remote_package_header) + 70, '\0');
+  PackageWriteService w(&small[0], small.size());
+  std::string blob(64, 'x');
+  ASSERT_TRUE(w.send(blob.data(), blob.size()));
+  ASSERT_FALSE(w.send(blob.data() + 1, 9));
+  // stays failed
+  ASSERT_FALSE(w.send(blob.data(), 1));
+  ASSERT_EQ(0U, w.Finish());
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
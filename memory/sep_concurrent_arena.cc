@@ -2,43 +2,198 @@
 #pragma once
 #include "memory/sep_concurrent_arena.h"
 
+#include <chrono>
 #include <thread>
 
 #include "db/tcprw.h"
 #include "port/port.h"
 #include "rocksdb/remote_flush_service.h"
+#include "test_util/sync_point.h"
 #include "util/random.h"
 
 namespace ROCKSDB_NAMESPACE {
-SepConcurrentArena::SepConcurrentArena(size_t max_memtable_size, int sep,
-                                       RDMAClient *client,
-                                       RDMANode::rdma_connection *conn)
-    : sep_(sep), blocksize_(max_memtable_size) {
-  int temp_compensate_size = 10240;  // exactly 2112 for now, others reserved
+namespace {
+// room left in every block past the memtable size, exactly 2112 bytes are
+// used for now, the rest is reserved
+constexpr size_t kCompensateSize = 10240;
+}  // namespace
+
+size_t SepConcurrentArena::RemoteBytes(size_t max_memtable_size,
+                                       int shard_num) {
+  // the meta block and one block per shard
+  return (static_cast<size_t>(shard_num) + 1) *
+         Arena::OptimizeBlockSize(max_memtable_size + kCompensateSize);
+}
+
+SepConcurrentArena::SepConcurrentArena(
+    size_t max_memtable_size, int shard_num,
+    std::shared_ptr<MemTableShardPartitioner> partitioner, bool shards_ordered,
+    RDMAClient *client, RDMANode::rdma_connection *conn, bool stream_kv)
+    : sep_(shard_num),
+      shards_ordered_(shards_ordered),
+      partitioner_(partitioner != nullptr ? std::move(partitioner)
+                                          : NewFixedPrefixShardPartitioner()),
+      blocksize_(max_memtable_size),
+      client_(client),
+      conn_(conn) {
+  assert(sep_ >= 0 && sep_ <= kMaxMemTableShards);
+  size_t block_size =
+      Arena::OptimizeBlockSize(max_memtable_size + kCompensateSize);
+  DM_LOG_DEBUG("SepConcurrentArena::SepConcurrentArena:: ", max_memtable_size,
+               ' ', block_size);
+  // the meta block first, then one block per shard
+  std::vector<int64_t> local(sep_ + 1, -1);
   if (client != nullptr && conn != nullptr) {
-    char req_type = 5;
-    ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&req_type),
-                     sizeof(char)) == sizeof(char));
+    // the blocks are carved from the registered buffer before they are
+    // sent, reserve them before the memnode pins its copy
+    bool admitted = true;
+    for (auto &offset : local) {
+      offset = client->rdma_mem_.try_allocate(block_size);
+      if (offset == -1) {
+        admitted = false;
+        break;
+      }
+    }
+    if (admitted) {
+      char req_type = 5;
+      ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&req_type),
+                       sizeof(char)) == sizeof(char));
+      int32_t shard_num_ = sep_;
+      ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&shard_num_),
+                       sizeof(int32_t)) == sizeof(int32_t));
+      int64_t block_size_ = static_cast<int64_t>(block_size);
+      ASSERT_RW(writen(conn->sock, reinterpret_cast<void *>(&block_size_),
+                       sizeof(int64_t)) == sizeof(int64_t));
+      char reply = 0;
+      ASSERT_RW(readn(conn->sock, &reply, sizeof(char)) == sizeof(char));
+      admitted = reply == 1;
+    }
+    if (!admitted) {
+      DM_LOG_WARN("memtable kept local, memnode or registered buffer full");
+      for (int64_t offset : local) {
+        if (offset != -1) client->rdma_mem_.free(offset);
+      }
+      local.assign(local.size(), -1);
+      client_ = nullptr;
+      conn_ = nullptr;
+    }
   }
-  size_t block_size =
-      Arena::OptimizeBlockSize(max_memtable_size + temp_compensate_size);
-  LOG_CERR("SepConcurrentArena::SepConcurrentArena:: ", max_memtable_size, ' ',
-           Arena::OptimizeBlockSize(max_memtable_size + temp_compensate_size));
-  meta_arena_ = new ConcurrentArena(block_size, nullptr, 0, client, conn);
+  meta_arena_ =
+      new ConcurrentArena(block_size, nullptr, 0, client_, conn_, local[0]);
   if (sep_ > 0) kv_arena_.resize(sep_);
   for (int i = 0; i < sep_; i++)
-    kv_arena_[i] = new ConcurrentArena(block_size, nullptr, 0, client, conn);
+    kv_arena_[i] = new ConcurrentArena(block_size, nullptr, 0, client_, conn_,
+                                       local[i + 1]);
+  kv_block_size_ = block_size;
+
+  if (stream_kv && sep_ > 0 && offloaded()) {
+    size_t regions = (block_size + kStreamRegionSize - 1) / kStreamRegionSize;
+    for (int i = 0; i < sep_; i++) {
+      // take the whole registered block, AllocateKV() carves it from here on
+      char *begin = kv_arena_[i]->AllocateAligned(block_size);
+      assert(begin == kv_begin(i));
+      (void)begin;
+      kv_stream_.emplace_back(new KVStream());
+      kv_stream_[i]->committed.reset(new std::atomic<uint32_t>[regions]);
+      for (size_t r = 0; r < regions; r++) kv_stream_[i]->committed[r] = 0;
+    }
+    stream_thread_ = new std::thread([this]() { StreamLoop(); });
+  }
+}
+
+void SepConcurrentArena::CommitKV(int shard, const char *buf, size_t bytes) {
+  if (kv_stream_.empty()) return;
+  const char *begin = reinterpret_cast<const char *>(kv_begin(shard));
+  if (buf < begin || buf + bytes > begin + kv_block_size_) return;  // spilled
+  KVStream &st = *kv_stream_[shard];
+  size_t off = buf - begin;
+  bool complete = false;
+  while (bytes > 0) {
+    size_t r = off / kStreamRegionSize;
+    size_t n = std::min(bytes, (r + 1) * kStreamRegionSize - off);
+    complete |= st.committed[r].fetch_add(static_cast<uint32_t>(n),
+                                          std::memory_order_release) +
+                    n ==
+                kStreamRegionSize;
+    off += n;
+    bytes -= n;
+  }
+  if (complete) stream_cv_.notify_one();
+}
+
+void SepConcurrentArena::StreamLoop() {
+  std::unique_lock<std::mutex> lck(stream_mtx_);
+  while (!stream_stop_.load()) {
+    // a notify racing with the wait is picked up by the timeout
+    stream_cv_.wait_for(lck, std::chrono::milliseconds(10));
+    lck.unlock();
+    StreamCommittedRegions();
+    lck.lock();
+  }
+}
+
+void SepConcurrentArena::StreamCommittedRegions() {
+  for (int i = 0; i < sep_; i++) {
+    KVStream &st = *kv_stream_[i];
+    size_t end = st.streamed;
+    while (end + kStreamRegionSize <= kv_block_size_ &&
+           st.committed[end / kStreamRegionSize].load(
+               std::memory_order_acquire) == kStreamRegionSize) {
+      end += kStreamRegionSize;
+    }
+    if (end > st.streamed) {
+      TEST_SYNC_POINT("SepConcurrentArena::StreamCommittedRegions:Write");
+      WriteKVRange(i, st.streamed, end);
+      st.streamed = end;
+    }
+  }
+}
+
+void SepConcurrentArena::WriteKVRange(int shard, size_t begin,
+                                      size_t end) const {
+  uint64_t remote[2] = {0, 0};
+  kv_arena_[shard]->get_remote_page_info(remote);
+  const char *local = reinterpret_cast<const char *>(kv_begin(shard)) + begin;
+  client_->rdma_write(conn_, end - begin, local - client_->get_buf(),
+                      remote[0] + begin);
+  ASSERT_RW(client_->poll_completion(conn_) == 0);
+}
+
+void SepConcurrentArena::StopStreaming() const {
+  if (stream_thread_ == nullptr) return;
+  {
+    std::lock_guard<std::mutex> lck(stream_mtx_);
+    stream_stop_.store(true);
+  }
+  stream_cv_.notify_one();
+  stream_thread_->join();
+  delete stream_thread_;
+  stream_thread_ = nullptr;
 }
 
 Status SepConcurrentArena::SendToRemote() const {
-  LOG_CERR("SepConcurrentArena::SendToRemote");
+  DM_LOG_DEBUG("SepConcurrentArena::SendToRemote");
+  // the stream thread shares the connection, and no entry is added any more
+  StopStreaming();
   Status s = meta_arena_->SendToRemote();
   if (!s.ok()) return s;
+  size_t streamed = 0, tail = 0;
   for (int i = 0; i < sep_; i++) {
-    s = kv_arena_[i]->SendToRemote();
-    if (!s.ok()) return s;
+    if (kv_stream_.empty()) {
+      s = kv_arena_[i]->SendToRemote();
+      if (!s.ok()) return s;
+      continue;
+    }
+    size_t end = std::min(kv_stream_[i]->used.load(), kv_block_size_);
+    if (end > kv_stream_[i]->streamed) {
+      WriteKVRange(i, kv_stream_[i]->streamed, end);
+    }
+    streamed += kv_stream_[i]->streamed;
+    tail += end - std::min(end, kv_stream_[i]->streamed);
   }
-  LOG_CERR("SepConcurrentArena::SendToRemote Finish");
+  DM_LOG_DEBUG(
+      "SepConcurrentArena::SendToRemote Finish, streamed before seal: ",
+      streamed, " tail: ", tail);
   return s;
 }
 
@@ -1,20 +1,24 @@
 
 #pragma once
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "memory/allocator.h"
 #include "memory/arena.h"
 #include "memory/concurrent_arena.h"
-#include "memory/prefix_sep.h"
 #include "port/lang.h"
 #include "port/likely.h"
+#include "rocksdb/memtable_shard_partitioner.h"
 #include "rocksdb/remote_flush_service.h"
 #include "rocksdb/remote_transfer_service.h"
 #include "util/core_local.h"
@@ -53,10 +57,20 @@ class SepConcurrentArena : public BasicArena {
         kv_arena_[sep]->BlockSize());
   }
 
-  explicit SepConcurrentArena(size_t max_memtable_size, int sep = 4,
-                              RDMAClient *client = nullptr,
-                              RDMANode::rdma_connection *conn = nullptr);
+  // kv entries are shipped by stream_kv in regions of this size
+  static constexpr size_t kStreamRegionSize = size_t{1} << 20;
+
+  // shard_num == 0 builds an arena without kv shards, as used by memtables
+  // rebuilt on the memnode where the shards already exist.
+  // stream_kv bump allocates the kv shards and lets a background thread ship
+  // every region whose entries are all committed, see CommitKV().
+  explicit SepConcurrentArena(
+      size_t max_memtable_size, int shard_num = 0,
+      std::shared_ptr<MemTableShardPartitioner> partitioner = nullptr,
+      bool shards_ordered = true, RDMAClient *client = nullptr,
+      RDMANode::rdma_connection *conn = nullptr, bool stream_kv = false);
   ~SepConcurrentArena() override {
+    StopStreaming();
     delete meta_arena_;
     for (int i = 0; i < kv_arena_.size(); i++) {
       delete kv_arena_[i];
@@ -64,6 +78,11 @@ class SepConcurrentArena : public BasicArena {
   }
   Status SendToRemote() const override;
   void get_remote_page_info(uint64_t *info) const override;
+  // bytes of the memnode buffer a memtable of this size and shard count pins
+  static size_t RemoteBytes(size_t max_memtable_size, int shard_num);
+  // false when built without a memnode or refused by it, the memtable is
+  // then kept on the compute node
+  bool offloaded() const { return conn_ != nullptr; }
 
   char *Allocate(size_t bytes) override { return meta_arena_->Allocate(bytes); }
   char *AllocateAligned(size_t bytes,
@@ -71,14 +90,42 @@ class SepConcurrentArena : public BasicArena {
                         [[maybe_unused]] Logger *logger = nullptr) override {
     return meta_arena_->AllocateAligned(bytes);
   }
-  char *AllocateKV(size_t bytes, const char *prefix) {
-    return kv_arena_[SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(
-                         prefix)]
-        ->Allocate(bytes);
+  inline int shard_num() const { return sep_; }
+  inline bool shards_ordered() const { return shards_ordered_; }
+  inline int Shard(const Slice &user_key) const {
+    int shard = partitioner_->Shard(user_key, sep_);
+    assert(shard >= 0 && shard < sep_);
+    return shard;
+  }
+  char *AllocateKV(size_t bytes, int shard) {
+    if (!kv_stream_.empty()) {
+      size_t off = kv_stream_[shard]->used.fetch_add(bytes);
+      if (off + bytes <= kv_block_size_) {
+        return const_cast<char *>(
+                   reinterpret_cast<const char *>(kv_begin(shard))) +
+               off;
+      }
+      // the shard block is used up, spill to a local block as the plain
+      // arena does
+    }
+    return kv_arena_[shard]->Allocate(bytes);
   }
+  // Marks the entry returned by AllocateKV() as completely written. No-op
+  // unless the kv shards are streamed.
+  void CommitKV(int shard, const char *buf, size_t bytes);
   size_t ApproximateMemoryUsage() const override {
-    return meta_arena_->ApproximateMemoryUsage() +
-           (kv_arena_[0]->ApproximateMemoryUsage() << 2);
+    // every shard block can take the whole memtable, so the sum is what
+    // bounds them
+    size_t ret = meta_arena_->ApproximateMemoryUsage();
+    for (int i = 0; i < sep_; i++) {
+      ret += kv_arena_[i]->ApproximateMemoryUsage();
+      if (!kv_stream_.empty()) {
+        // the reserved block is counted by what was bump allocated from it
+        ret -= kv_block_size_;
+        ret += std::min(kv_stream_[i]->used.load(), kv_block_size_);
+      }
+    }
+    return ret;
   }
   size_t MemoryAllocatedBytes() const override {
     return meta_arena_->BlockSize();
@@ -92,17 +139,46 @@ class SepConcurrentArena : public BasicArena {
   bool IsInInlineBlock() const override { assert(false); }
   size_t RawDataUsage() const override {
     size_t ret = 0;
-    for (auto &arena : kv_arena_) {
-      ret += arena->RawDataUsage();
+    for (int i = 0; i < sep_; i++) {
+      ret += kv_stream_.empty()
+                 ? kv_arena_[i]->RawDataUsage()
+                 : std::min(kv_stream_[i]->used.load(), kv_block_size_);
     }
     return meta_arena_->RawDataUsage() + ret;
   }
 
  private:
-  const int sep_ = 4;
+  struct KVStream {
+    // bump offset into the shard block
+    std::atomic<size_t> used{0};
+    // bytes committed per region, a region is complete at kStreamRegionSize
+    std::unique_ptr<std::atomic<uint32_t>[]> committed;
+    // prefix of the block already on the memnode, owned by the stream thread
+    // until it is stopped
+    size_t streamed = 0;
+  };
+
+  void StreamLoop();
+  // ships every complete region following the streamed prefix
+  void StreamCommittedRegions();
+  void WriteKVRange(int shard, size_t begin, size_t end) const;
+  void StopStreaming() const;
+
+  const int sep_ = 0;
+  const bool shards_ordered_ = true;
+  std::shared_ptr<MemTableShardPartitioner> partitioner_;
   ConcurrentArena *meta_arena_{nullptr};
   std::vector<ConcurrentArena *> kv_arena_;
   const size_t blocksize_ = 0;
+  size_t kv_block_size_ = 0;
+
+  RDMAClient *client_ = nullptr;
+  RDMANode::rdma_connection *conn_ = nullptr;
+  std::vector<std::unique_ptr<KVStream>> kv_stream_;
+  mutable std::thread *stream_thread_{nullptr};
+  mutable std::mutex stream_mtx_;
+  mutable std::condition_variable stream_cv_;
+  mutable std::atomic<bool> stream_stop_{false};
 
   SepConcurrentArena(const SepConcurrentArena &) = delete;
   SepConcurrentArena &operator=(const SepConcurrentArena &) = delete;
@@ -41,12 +41,12 @@ class TransConcurrentArena : public BasicArena {
   inline void *begin() const { return const_cast<void *>(begin_address); }
   inline void *end() const { return now_ptr; }
   inline void TESTContinuous() const override {
-    LOG_CERR("begin address: ", begin_address, ' ',
-             "now_addr: ", reinterpret_cast<void *>(now_ptr), ' ',
-             "memory_allocated_bytes_: ", memory_allocated_bytes_, ' ',
-             "max_allocated_bytes_: ", max_allocated_bytes_, ' ',
-             "arena_allocated_and_unused_: ",
-             arena_allocated_and_unused_.load(std::memory_order_relaxed));
+    DM_LOG_DEBUG("begin address: ", begin_address, ' ',
+                 "now_addr: ", reinterpret_cast<void *>(now_ptr), ' ',
+                 "memory_allocated_bytes_: ", memory_allocated_bytes_, ' ',
+                 "max_allocated_bytes_: ", max_allocated_bytes_, ' ',
+                 "arena_allocated_and_unused_: ",
+                 arena_allocated_and_unused_.load(std::memory_order_relaxed));
   }
   explicit TransConcurrentArena(size_t max_memtable_size);
   ~TransConcurrentArena() override { free(const_cast<void *>(begin_address)); }
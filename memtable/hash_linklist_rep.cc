@@ -166,7 +166,7 @@ class HashLinkListRep : public MemTableRep {
                   bool if_log_bucket_dist_when_flash);
 
   KeyHandle Allocate(const size_t len, char** buf, char** kv_buf = nullptr,
-                     const char* prefix = nullptr) override;
+                     int shard = -1) override;
 
   void Insert(KeyHandle handle) override;
 
@@ -529,7 +529,7 @@ HashLinkListRep::HashLinkListRep(
 HashLinkListRep::~HashLinkListRep() {}
 
 KeyHandle HashLinkListRep::Allocate(const size_t len, char** buf, char** kv_buf,
-                                    const char* prefix) {
+                                    int shard) {
   char* mem = allocator_->AllocateAligned(sizeof(Node) + len);
   Node* x = new (mem) Node();
   *buf = x->key;
@@ -66,16 +66,16 @@ class InlineSkipList {
  public:
   inline void TESTContinuous() const {
     if (offset == 0) {
-      LOG_CERR("TESTContinue:: seems to be local version.");
+      DM_LOG_DEBUG("TESTContinue:: seems to be local version.");
     }
-    LOG_CERR("Allocator name: ", allocator_->name(), ' ', offset, ' ',
-             int64_t(local_mem_begin_), ' ', int64_t(remote_mem_begin_));
-    for (int i = 0; i < 4; i++) {
-      LOG_CERR("shard:", i, ' ', int64_t(local_shard_[i]), ' ',
-               int64_t(remote_shard_[i]), ' ', shard_offset_[i]);
+    DM_LOG_DEBUG("Allocator name: ", allocator_->name(), ' ', offset, ' ',
+                 int64_t(local_mem_begin_), ' ', int64_t(remote_mem_begin_));
+    for (int i = 0; i < shard_num_; i++) {
+      DM_LOG_DEBUG("shard:", i, ' ', int64_t(local_shard_[i]), ' ',
+                   int64_t(remote_shard_[i]), ' ', shard_offset_[i]);
     }
     Node* node = head_->Next(0, offset);
-    LOG_CERR("Head:: ", int64_t(head_), ' ', int64_t(node));
+    DM_LOG_DEBUG("Head:: ", int64_t(head_), ' ', int64_t(node));
     std::function<std::string(const char*, const char*)> parse =
         [&](const char* raw_key, const char* meta_node) {
           // parse the key:[key_size(int64_t)|key|value_size(int64_t)|value]
@@ -85,16 +85,15 @@ class InlineSkipList {
           uint32_t ikey_size = 0;
           auto p = GetVarint32Ptr(buf_, buf_ + 5, &ikey_size);
           if (p == nullptr) {
-            LOG_CERR("ikey parse error");
+            DM_LOG_ERROR("ikey parse error");
           }
-          int sep =
-              SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(p);
+          int sep = reinterpret_cast<const Node*>(meta_node)->Shard();
           std::string ikey = Slice(p, ikey_size - 8).ToString(true);
           buf_ += VarintLength(ikey_size) + ikey_size;
           uint32_t ivalue_size = 0;
           p = GetVarint32Ptr(buf_, buf_ + 5, &ivalue_size);
           if (p == nullptr) {
-            LOG_CERR("ivalue parse error");
+            DM_LOG_ERROR("ivalue parse error");
           }
           std::string ivalue = Slice(p, ivalue_size).ToString();
           int64_t blocksize_ = Arena::OptimizeBlockSize((64 << 20) + 10240);
@@ -106,15 +105,16 @@ class InlineSkipList {
                              std::to_string(ivalue_size) + "+" + "--" +
                              std::to_string(sep));
         };
-    LOG_CERR("Test Iteration");
+    DM_LOG_DEBUG("Test Iteration");
     int cnt = 0;
     while (node != nullptr) {
-      LOG_CERR(parse(shard_offset_[0] ? node->RKey(shard_offset_) : node->Key(),
-                     const_cast<const char*>(reinterpret_cast<char*>(node))));
+      DM_LOG_DEBUG(
+          parse(shard_offset_[0] ? node->RKey(shard_offset_) : node->Key(),
+                const_cast<const char*>(reinterpret_cast<char*>(node))));
       cnt++;
       node = node->Next(0, offset);
     }
-    LOG_CERR("InlineSkipList TESTContinuous Iteation finish:: ", cnt);
+    DM_LOG_DEBUG("InlineSkipList TESTContinuous Iteation finish:: ", cnt);
     // for (int i = 0; i < 4; i++) {
     //   LOG_CERR("Test SepIterator ", i);
     //   SepIterator sep_iter(this, i);
@@ -157,10 +157,18 @@ class InlineSkipList {
     shard_offset_[sep] =
         reinterpret_cast<const char*>(remote) - local_shard_[sep];
   }
+  // shard count and order of a list rebuilt from a shipped index block
+  inline void set_shard_layout(int shard_num, bool ordered) {
+    assert(shard_num >= 0 && shard_num <= kMaxMemTableShards);
+    shard_num_ = shard_num;
+    shards_ordered_ = ordered;
+  }
+  inline int get_shard_num() const { return shard_num_; }
+  inline bool get_shards_ordered() const { return shards_ordered_; }
   inline void set_shard_local_begin(int sep, void* local) {
     local_shard_[sep] = const_cast<const char*>(reinterpret_cast<char*>(local));
   }
-  inline void* get_shard_local_begin(int sep) {
+  inline void* get_shard_local_begin(int sep) const {
     return const_cast<void*>(reinterpret_cast<const void*>(local_shard_[sep]));
   }
   inline void* get_shard_remote_begin(int sep) {
@@ -200,6 +208,8 @@ class InlineSkipList {
   using DecodedKey =
       typename std::remove_reference<Comparator>::type::DecodedType;
 
+  // links are compute node addresses, see OffsetSkipList for offsets
+  static constexpr bool kPointerLinks = true;
   static const uint16_t kMaxPossibleHeight = 32;
 
   // Create a new InlineSkipList object that will use "cmp" for comparing
@@ -216,8 +226,7 @@ class InlineSkipList {
   // Allocates a key and a skip-list node, returning a pointer to the key
   // portion of the node.  This method is thread-safe if the allocator
   // is thread-safe.
-  void AllocateKey(size_t key_size, char** ptr_buf, char** kv_buf,
-                   const char* prefix);
+  void AllocateKey(size_t key_size, char** ptr_buf, char** kv_buf, int shard);
 
   // Allocate a splice using allocator.
   Splice* AllocateSplice();
@@ -277,6 +286,10 @@ class InlineSkipList {
   // Return estimated number of entries smaller than `key`.
   uint64_t EstimateCount(const char* key) const;
 
+  // Appends about n keys evenly spread over the list, in order, read from the
+  // lowest level that still holds n nodes. Only valid on the local list.
+  void SampleKeys(size_t n, std::vector<const char*>* keys) const;
+
   // Validate correctness of the skip-list.
   void TEST_Validate() const;
 
@@ -330,6 +343,9 @@ class InlineSkipList {
     // Intentionally copyable
   };
 
+  // Iterator over the nodes of one kv shard. Nodes of a shard are
+  // consecutive in an ordered layout, otherwise the walk skips the nodes of
+  // other shards.
   class SepIterator {
    public:
     // Initialize an iterator over the specified list.
@@ -361,9 +377,11 @@ class InlineSkipList {
     void SeekToLast();
 
    private:
+    // move forward from node_ to the next node of the shard
+    void SkipToShard();
+
     const InlineSkipList* list_;
-    const Node* front_;
-    const Node* last_;
+    int sep_;
     Node* node_;
     // Intentionally copyable
   };
@@ -391,9 +409,12 @@ class InlineSkipList {
   char* remote_mem_begin_{nullptr};
   int64_t offset{0};
   // std::vector<std::<const char*, char*, int32_t>> remote_kv_;
-  const char* local_shard_[4]{nullptr};
-  char* remote_shard_[4]{nullptr};
-  int64_t shard_offset_[4]{0};
+  const char* local_shard_[kMaxMemTableShards]{nullptr};
+  char* remote_shard_[kMaxMemTableShards]{nullptr};
+  int64_t shard_offset_[kMaxMemTableShards]{0};
+  int shard_num_{0};
+  // shard i only holds keys before the keys of shard i + 1
+  bool shards_ordered_{true};
 
   inline int GetMaxHeight() const {
     return max_height_.load(std::memory_order_relaxed);
@@ -401,7 +422,7 @@ class InlineSkipList {
 
   int RandomHeight();
 
-  Node* AllocateNode(size_t key_size, int height, const char* prefix);
+  Node* AllocateNode(size_t key_size, int height, int shard);
 
   bool Equal(const char* a, const char* b) const {
     return (compare_(a, b) == 0);
@@ -499,6 +520,11 @@ struct InlineSkipList<Comparator>::Node {
     return *reinterpret_cast<char**>(
         const_cast<char*>(reinterpret_cast<const char*>(&next_[1])));
   }
+  // kv shard of the key, kMaxMemTableShards for the head
+  int Shard() const {
+    return *reinterpret_cast<const uint8_t*>(
+        reinterpret_cast<const char*>(&next_[1]) + sizeof(char*));
+  }
   const char* RKey(const int64_t* remote_offset) const {
     return (*reinterpret_cast<char**>(
                const_cast<char*>(reinterpret_cast<const char*>(&next_[1])))) +
@@ -647,30 +673,15 @@ inline InlineSkipList<Comparator>::SepIterator::SepIterator(
 template <class Comparator>
 inline void InlineSkipList<Comparator>::SepIterator::SetList(
     const InlineSkipList* list, int sep) {
+  assert(sep >= 0 && sep < list->shard_num_);
   list_ = list;
+  sep_ = sep;
   node_ = nullptr;
-  // Todo: check corner case
-  front_ = list_->FindSepGreaterOrEqual(sep);
-  last_ = list_->FindSepLessThan(sep + 1);
-  if (front_ != list_->head_ && front_ != nullptr) {
-    const DecodedKey pkey =
-        list_->compare_.decode_key(front_->RKey(list_->shard_offset_));
-    LOG_CERR("FindLess::Front:: ", sep, ' ', pkey.ToString(true), ' ',
-             SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(
-                 pkey.data()));
-  }
-  if (last_ != list_->head_ && last_ != nullptr) {
-    const DecodedKey pkey =
-        list_->compare_.decode_key(last_->RKey(list_->shard_offset_));
-    LOG_CERR("FindLess::Last:: ", sep, ' ', pkey.ToString(true), ' ',
-             SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(
-                 pkey.data()));
-  }
 }
 
 template <class Comparator>
 inline bool InlineSkipList<Comparator>::SepIterator::Valid() const {
-  return node_ != nullptr && node_ != last_;
+  return node_ != nullptr;
 }
 template <class Comparator>
 inline const char* InlineSkipList<Comparator>::SepIterator::key() const {
@@ -682,20 +693,42 @@ inline const char* InlineSkipList<Comparator>::SepIterator::key() const {
 template <class Comparator>
 inline void InlineSkipList<Comparator>::SepIterator::Next() {
   assert(Valid());
-  if (node_ == last_)
-    node_ = nullptr;
-  else
+  node_ = node_->Next(0, list_->offset);
+  SkipToShard();
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::SepIterator::SkipToShard() {
+  if (list_->shards_ordered_) {
+    // the first node of another shard ends this one
+    if (node_ != nullptr && node_->Shard() != sep_) node_ = nullptr;
+    return;
+  }
+  while (node_ != nullptr && node_->Shard() != sep_) {
     node_ = node_->Next(0, list_->offset);
+  }
 }
 
 template <class Comparator>
 inline void InlineSkipList<Comparator>::SepIterator::SeekToFirst() {
-  node_ = const_cast<Node*>(front_);
+  node_ = list_->shards_ordered_ ? list_->FindSepGreaterOrEqual(sep_)
+                                 : list_->head_->Next(0, list_->offset);
+  SkipToShard();
 }
 
 template <class Comparator>
 inline void InlineSkipList<Comparator>::SepIterator::SeekToLast() {
-  node_ = const_cast<Node*>(last_);
+  if (list_->shards_ordered_) {
+    node_ = list_->FindSepLessThan(sep_ + 1);
+    SkipToShard();
+    return;
+  }
+  Node* last = nullptr;
+  for (Node* x = list_->head_->Next(0, list_->offset); x != nullptr;
+       x = x->Next(0, list_->offset)) {
+    if (x->Shard() == sep_) last = x;
+  }
+  node_ = last;
 }
 
 template <class Comparator>
@@ -819,6 +852,7 @@ InlineSkipList<Comparator>::FindLessThan(const char* key, Node** prev,
 template <class Comparator>
 typename InlineSkipList<Comparator>::Node*
 InlineSkipList<Comparator>::FindSepGreaterOrEqual(int sep) const {
+  assert(shards_ordered_);
   Node* x = head_;
   int level = GetMaxHeight() - 1;
   while (true) {
@@ -831,13 +865,7 @@ InlineSkipList<Comparator>::FindSepGreaterOrEqual(int sep) const {
         level--;
       }
     } else {
-      const char* ikey = compare_
-                             .decode_key(remote_shard_[0] == nullptr
-                                             ? next->Key()
-                                             : next->RKey(shard_offset_))
-                             .data();
-      int next_sep =
-          SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(ikey);
+      int next_sep = next->Shard();
       if (next_sep >= sep && level == 0) {
         return next;
       } else if (next_sep < sep) {
@@ -854,41 +882,22 @@ InlineSkipList<Comparator>::FindSepGreaterOrEqual(int sep) const {
 template <class Comparator>
 typename InlineSkipList<Comparator>::Node*
 InlineSkipList<Comparator>::FindSepLessThan(int sep) const {
+  assert(shards_ordered_);
   Node* x = head_;
   int level = GetMaxHeight() - 1;
   while (true) {
     Node* next = x->Next(level, offset);
     if (next == nullptr) {
       if (level == 0) {
-        // const DecodedKey ikey = compare_.decode_key(x->RKey(shard_offset_));
-        // LOG_CERR("Return::FindSep:: ", sep, ' ', ikey.ToString(true), ' ',
-        //          SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(
-        //              ikey.data()),
-        //          ' ', x == head_ ? "true" : "false");
         return x == head_ ? nullptr : x;
       } else {
         // Switch to next list
         level--;
       }
     } else {
-      const char* ikey = compare_
-                             .decode_key(remote_shard_[0] == nullptr
-                                             ? next->Key()
-                                             : next->RKey(shard_offset_))
-                             .data();
-      int next_sep =
-          SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(ikey);
-      // const DecodedKey pkey = compare_.decode_key(next->RKey(shard_offset_));
-      // LOG_CERR("FindLess:: ", sep, ' ', next_sep, ' ', level, ' ',
-      //          pkey.ToString(true), ' ',
-      //          SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(
-      //              pkey.data()));
+      int next_sep = next->Shard();
       if (level == 0 && next_sep >= sep) {
-        // const DecodedKey ikey = compare_.decode_key(x->RKey(shard_offset_));
-        // LOG_CERR("Return::FindSep::1 ", sep, ' ', ikey.ToString(true), ' ',
-        //          SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(
-        //              ikey.data()));
-        return x;
+        return x == head_ ? nullptr : x;
       } else if (next_sep < sep) {
         // Keep searching in this list
         x = next;
@@ -990,6 +999,29 @@ uint64_t InlineSkipList<Comparator>::EstimateCount(const char* key) const {
   }
 }
 
+template <class Comparator>
+void InlineSkipList<Comparator>::SampleKeys(
+    size_t n, std::vector<const char*>* keys) const {
+  if (n == 0) return;
+  int level = GetMaxHeight() - 1;
+  size_t count = 0;
+  for (; level >= 0; level--) {
+    count = 0;
+    for (Node* x = head_->Next(level, offset); x != nullptr;
+         x = x->Next(level, offset)) {
+      count++;
+    }
+    if (count >= n) break;
+  }
+  if (level < 0) level = 0;
+  size_t stride = std::max<size_t>(count / n, 1);
+  size_t i = 0;
+  for (Node* x = head_->Next(level, offset); x != nullptr;
+       x = x->Next(level, offset), i++) {
+    if (i % stride == 0) keys->push_back(x->Key());
+  }
+}
+
 template <class Comparator>
 InlineSkipList<Comparator>::InlineSkipList(const Comparator cmp,
                                            Allocator* allocator,
@@ -1000,7 +1032,7 @@ InlineSkipList<Comparator>::InlineSkipList(const Comparator cmp,
       kScaledInverseBranching_((Random::kMaxNext + 1) / kBranching_),
       allocator_(allocator),
       compare_(cmp),
-      head_(AllocateNode(0, max_height, nullptr)),
+      head_(AllocateNode(0, max_height, kMaxMemTableShards)),
       max_height_(1),
       seq_splice_(AllocateSplice()),
       local_mem_begin_(nullptr) {
@@ -1014,9 +1046,11 @@ InlineSkipList<Comparator>::InlineSkipList(const Comparator cmp,
   }
   local_mem_begin_ = reinterpret_cast<const char*>(
       reinterpret_cast<SepConcurrentArena*>(allocator)->meta_begin());
-  for (int i = 0; i < 4 /*sep*/; i++) {
-    auto kv_begin_ =
-        reinterpret_cast<SepConcurrentArena*>(allocator)->kv_begin(i);
+  auto* arena = reinterpret_cast<SepConcurrentArena*>(allocator);
+  shard_num_ = arena->shard_num();
+  shards_ordered_ = arena->shards_ordered();
+  for (int i = 0; i < shard_num_; i++) {
+    auto kv_begin_ = arena->kv_begin(i);
     local_shard_[i] = reinterpret_cast<const char*>(kv_begin_);
     remote_shard_[i] = nullptr;
     shard_offset_[i] = 0;
@@ -1025,9 +1059,8 @@ InlineSkipList<Comparator>::InlineSkipList(const Comparator cmp,
 
 template <class Comparator>
 void InlineSkipList<Comparator>::AllocateKey(size_t key_size, char** ptr_buf,
-                                             char** kv_buf,
-                                             const char* prefix) {
-  Node* node_buf_ = AllocateNode(key_size, RandomHeight(), prefix);
+                                             char** kv_buf, int shard) {
+  Node* node_buf_ = AllocateNode(key_size, RandomHeight(), shard);
   const char* kv_buf_ = node_buf_->Key();
   char* ptr_buf_ =
       reinterpret_cast<char*>(node_buf_) + sizeof(std::atomic<Node*>);
@@ -1038,7 +1071,7 @@ void InlineSkipList<Comparator>::AllocateKey(size_t key_size, char** ptr_buf,
 template <class Comparator>
 typename InlineSkipList<Comparator>::Node*
 InlineSkipList<Comparator>::AllocateNode(size_t key_size, int height,
-                                         const char* prefix_) {
+                                         int shard) {
   auto prefix = sizeof(std::atomic<Node*>) * (height - 1);
 
   // prefix is space for the height - 1 pointers that we store before
@@ -1050,8 +1083,9 @@ InlineSkipList<Comparator>::AllocateNode(size_t key_size, int height,
   // interface ; replace char* with Offset
   char* raw = allocator_->AllocateAligned(prefix + sizeof(std::atomic<Node*>) +
                                           sizeof(uint8_t) + sizeof(char**));
+  assert(key_size == 0 || (shard >= 0 && shard < shard_num_));
   char* raw_kv = key_size ? reinterpret_cast<SepConcurrentArena*>(allocator_)
-                                ->AllocateKV(key_size, prefix_)
+                                ->AllocateKV(key_size, shard)
                           : nullptr;
   Node* x = reinterpret_cast<Node*>(raw + prefix);
 
@@ -1068,9 +1102,7 @@ InlineSkipList<Comparator>::AllocateNode(size_t key_size, int height,
   // Todo: check reinterpret
   *reinterpret_cast<uint8_t*>(
       raw + prefix + sizeof(std::atomic<Node*>) /*Node*/ + sizeof(char*)) =
-      key_size
-          ? SingletonV2::SingletonV2<PrefixSep<4>>::Instance().get_sep(prefix_)
-          : 4;
+      key_size ? shard : kMaxMemTableShards;
   return x;
 }
 
@@ -0,0 +1,96 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+
+#include "rocksdb/memtable_shard_partitioner.h"
+
+#include <algorithm>
+
+#include "util/hash.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+int FixedPrefixShard(const Slice& user_key, int num_shards) {
+  if (user_key.empty()) return 0;
+  return (static_cast<uint8_t>(user_key[0]) * num_shards) >> 8;
+}
+
+class FixedPrefixShardPartitioner : public MemTableShardPartitioner {
+ public:
+  const char* Name() const override { return "FixedPrefixShardPartitioner"; }
+  int Shard(const Slice& user_key, int num_shards) const override {
+    return FixedPrefixShard(user_key, num_shards);
+  }
+  bool IsOrdered() const override { return true; }
+};
+
+class PrefixHashShardPartitioner : public MemTableShardPartitioner {
+ public:
+  explicit PrefixHashShardPartitioner(size_t prefix_len)
+      : prefix_len_(prefix_len) {}
+  const char* Name() const override { return "PrefixHashShardPartitioner"; }
+  int Shard(const Slice& user_key, int num_shards) const override {
+    size_t len = std::min(user_key.size(), prefix_len_);
+    return static_cast<int>(Hash64(user_key.data(), len) %
+                            static_cast<uint64_t>(num_shards));
+  }
+  bool IsOrdered() const override { return false; }
+
+ private:
+  const size_t prefix_len_;
+};
+
+class SampledShardPartitioner : public MemTableShardPartitioner {
+ public:
+  SampledShardPartitioner() = default;
+  explicit SampledShardPartitioner(std::vector<std::string>&& splits)
+      : splits_(std::move(splits)) {}
+  const char* Name() const override { return "SampledShardPartitioner"; }
+  int Shard(const Slice& user_key, int num_shards) const override {
+    if (splits_.empty()) return FixedPrefixShard(user_key, num_shards);
+    // splits_[i] is the first key of shard i + 1
+    auto it = std::upper_bound(
+        splits_.begin(), splits_.end(), user_key,
+        [](const Slice& k, const std::string& split) {
+          return k.compare(split) < 0;
+        });
+    return std::min(static_cast<int>(it - splits_.begin()), num_shards - 1);
+  }
+  bool IsOrdered() const override { return true; }
+  std::shared_ptr<MemTableShardPartitioner> Learn(
+      const std::vector<std::string>& sorted_sample,
+      int num_shards) const override {
+    if (num_shards <= 1 ||
+        sorted_sample.size() < static_cast<size_t>(num_shards)) {
+      return nullptr;
+    }
+    std::vector<std::string> splits;
+    splits.reserve(num_shards - 1);
+    for (int i = 1; i < num_shards; i++) {
+      splits.push_back(sorted_sample[sorted_sample.size() * i / num_shards]);
+    }
+    return std::make_shared<SampledShardPartitioner>(std::move(splits));
+  }
+
+ private:
+  const std::vector<std::string> splits_;
+};
+}  // namespace
+
+std::shared_ptr<MemTableShardPartitioner> NewFixedPrefixShardPartitioner() {
+  return std::make_shared<FixedPrefixShardPartitioner>();
+}
+
+std::shared_ptr<MemTableShardPartitioner> NewPrefixHashShardPartitioner(
+    size_t prefix_len) {
+  return std::make_shared<PrefixHashShardPartitioner>(prefix_len);
+}
+
+std::shared_ptr<MemTableShardPartitioner> NewSampledShardPartitioner() {
+  return std::make_shared<SampledShardPartitioner>();
+}
+
+}  // namespace ROCKSDB_NAMESPACE
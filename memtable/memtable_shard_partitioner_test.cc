@@ -0,0 +1,165 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+
+#include "rocksdb/memtable_shard_partitioner.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "test_util/testharness.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+class MemTableShardPartitionerTest : public testing::Test {
+ protected:
+  static std::vector<std::string> RandomKeys(int n, int len, uint32_t seed) {
+    Random rnd(seed);
+    std::vector<std::string> keys;
+    for (int i = 0; i < n; i++) {
+      std::string key;
+      for (int j = 0; j < len; j++) {
+        key.push_back(static_cast<char>(rnd.Uniform(256)));
+      }
+      keys.push_back(key);
+    }
+    return keys;
+  }
+
+  // every key lands in [0, num_shards) and on the same shard each time
+  static void CheckBoundsAndStable(const MemTableShardPartitioner& p,
+                                   const std::vector<std::string>& keys) {
+    for (int num_shards = 1; num_shards <= kMaxMemTableShards; num_shards++) {
+      for (const auto& key : keys) {
+        int shard = p.Shard(key, num_shards);
+        ASSERT_GE(shard, 0);
+        ASSERT_LT(shard, num_shards);
+        ASSERT_EQ(shard, p.Shard(key, num_shards));
+        ASSERT_EQ(shard, p.Shard(Slice(std::string(key)), num_shards));
+      }
+    }
+  }
+
+  // shards of keys in bytewise order never go down
+  static void CheckOrdered(const MemTableShardPartitioner& p,
+                           std::vector<std::string> keys, int num_shards) {
+    std::sort(keys.begin(), keys.end());
+    int last = 0;
+    for (const auto& key : keys) {
+      int shard = p.Shard(key, num_shards);
+      ASSERT_GE(shard, last) << key;
+      last = shard;
+    }
+  }
+};
+
+TEST_F(MemTableShardPartitionerTest, FixedPrefix) {
+  auto p = NewFixedPrefixShardPartitioner();
+  ASSERT_TRUE(p->IsOrdered());
+  std::vector<std::string> keys = RandomKeys(1000, 16, 301);
+  keys.push_back("");
+  keys.push_back(std::string(1, '\0'));
+  keys.push_back(std::string(4, '\xff'));
+  CheckBoundsAndStable(*p, keys);
+  for (int num_shards = 1; num_shards <= kMaxMemTableShards; num_shards++) {
+    CheckOrdered(*p, keys, num_shards);
+  }
+  // the split used before the shard count was configurable
+  for (int c = 0; c < 256; c++) {
+    std::string key(1, static_cast<char>(c));
+    key += "suffix";
+    ASSERT_EQ(c >> 6, p->Shard(key, 4));
+  }
+  ASSERT_EQ(0, p->Shard("", 4));
+  ASSERT_EQ(kMaxMemTableShards - 1,
+            p->Shard(std::string(1, '\xff'), kMaxMemTableShards));
+  ASSERT_EQ(nullptr, p->Learn(keys, 4));
+}
+
+TEST_F(MemTableShardPartitionerTest, PrefixHash) {
+  auto p = NewPrefixHashShardPartitioner(8);
+  ASSERT_FALSE(p->IsOrdered());
+  std::vector<std::string> keys = RandomKeys(1000, 16, 302);
+  keys.push_back("");
+  keys.push_back("short");
+  CheckBoundsAndStable(*p, keys);
+  // only the prefix counts
+  ASSERT_EQ(p->Shard("prefix00-a", 16), p->Shard("prefix00-b", 16));
+  // the same partitioner built again agrees, memtables of a column family
+  // built before and after a reopen shard alike
+  auto again = NewPrefixHashShardPartitioner(8);
+  for (const auto& key : keys) {
+    ASSERT_EQ(p->Shard(key, 7), again->Shard(key, 7));
+  }
+  // ASCII keys with a shared first byte still spread over every shard
+  std::vector<int> counts(4, 0);
+  for (int i = 0; i < 4000; i++) {
+    counts[p->Shard("user" + std::to_string(i), 4)]++;
+  }
+  for (int count : counts) {
+    ASSERT_GT(count, 500);
+  }
+}
+
+TEST_F(MemTableShardPartitionerTest, SampledBeforeLearn) {
+  auto p = NewSampledShardPartitioner();
+  auto fixed = NewFixedPrefixShardPartitioner();
+  ASSERT_TRUE(p->IsOrdered());
+  std::vector<std::string> keys = RandomKeys(500, 12, 303);
+  CheckBoundsAndStable(*p, keys);
+  for (const auto& key : keys) {
+    ASSERT_EQ(fixed->Shard(key, 4), p->Shard(key, 4));
+  }
+}
+
+TEST_F(MemTableShardPartitionerTest, SampledLearn) {
+  auto p = NewSampledShardPartitioner();
+  // too few samples, or nothing to split, keeps the partitioner
+  ASSERT_EQ(nullptr, p->Learn({"a", "b", "c"}, 4));
+  ASSERT_EQ(nullptr, p->Learn({"a", "b", "c", "d"}, 1));
+
+  // keys sharing their first byte all go to one fixed prefix shard
+  std::vector<std::string> sample;
+  for (int i = 0; i < 1000; i++) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "user%06d", i);
+    sample.push_back(buf);
+  }
+  auto learned = p->Learn(sample, 4);
+  ASSERT_NE(nullptr, learned);
+  ASSERT_TRUE(learned->IsOrdered());
+  CheckBoundsAndStable(*learned, sample);
+  CheckOrdered(*learned, sample, 4);
+  std::vector<int> counts(4, 0);
+  for (const auto& key : sample) {
+    counts[learned->Shard(key, 4)]++;
+  }
+  for (int count : counts) {
+    ASSERT_EQ(250, count);
+  }
+  // keys outside the sample go to the end shards
+  ASSERT_EQ(0, learned->Shard("a", 4));
+  ASSERT_EQ(3, learned->Shard("z", 4));
+  // a smaller shard count than learned for still stays in bounds
+  for (const auto& key : sample) {
+    ASSERT_LT(learned->Shard(key, 2), 2);
+  }
+  // learning again starts from the new sample
+  std::vector<std::string> next = RandomKeys(100, 8, 304);
+  std::sort(next.begin(), next.end());
+  auto relearned = learned->Learn(next, 4);
+  ASSERT_NE(nullptr, relearned);
+  CheckOrdered(*relearned, next, 4);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
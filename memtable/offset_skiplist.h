@@ -0,0 +1,904 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+// OffsetSkipList is InlineSkipList laid out to be read in place on any
+// node. Nodes live in the meta arena of a SepConcurrentArena and keys in
+// its kv shard blocks, as with InlineSkipList, but a link is a 32-bit
+// offset into the meta arena and a node refers to its key by a 32-bit
+// offset into the block of its shard. A copy of the arenas on a memnode or
+// a flush worker only needs the base address of each arena, nothing in the
+// list is relocated, and a node takes 12 bytes plus 4 per extra level
+// instead of 17 plus 8.
+//
+// Thread safety and invariants are those of InlineSkipList. Nodes and keys
+// must stay in the first block of their arena, SepConcurrentArena sizes it
+// for the whole memtable; Fits() tells whether the blocks of an allocator
+// can be addressed at all.
+
+#pragma once
+#include <assert.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "memory/allocator.h"
+#include "memory/sep_concurrent_arena.h"
+#include "port/likely.h"
+#include "port/port.h"
+#include "rocksdb/macro.hpp"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+template <class Comparator>
+class OffsetSkipList {
+ private:
+  struct Node;
+  struct Splice;
+
+ public:
+  using DecodedKey =
+      typename std::remove_reference<Comparator>::type::DecodedType;
+  // position of a node in the meta arena plus one, 0 for none
+  using Offset = uint32_t;
+
+  // links are no compute node addresses, one-sided readers cannot follow
+  // them with a RemoteSkipListLayout
+  static constexpr bool kPointerLinks = false;
+  static const uint16_t kMaxPossibleHeight = 32;
+
+  // true if allocator is a SepConcurrentArena whose blocks an Offset
+  // addresses
+  static bool Fits(const Allocator* allocator) {
+    if (strcmp(allocator->name(), "SepConcurrentArena") != 0) return false;
+    auto* arena = static_cast<const SepConcurrentArena*>(
+        static_cast<const BasicArena*>(allocator));
+    return arena->RawBlockSize() < std::numeric_limits<Offset>::max();
+  }
+
+  // REQUIRES: Fits(allocator)
+  explicit OffsetSkipList(Comparator cmp, Allocator* allocator,
+                          int32_t max_height = 12,
+                          int32_t branching_factor = 4);
+  // No copying allowed
+  OffsetSkipList(const OffsetSkipList&) = delete;
+  OffsetSkipList& operator=(const OffsetSkipList&) = delete;
+
+  // Allocates a node and its key, *ptr_buf gets the handle the inserts
+  // take and *kv_buf the key.
+  void AllocateKey(size_t key_size, char** ptr_buf, char** kv_buf, int shard);
+
+  // The inserts of InlineSkipList, see there.
+  bool Insert(const char* key);
+  bool InsertWithHint(const char* key, void** hint);
+  bool InsertWithHintConcurrently(const char* key, void** hint);
+  bool InsertConcurrently(const char* key);
+
+  // Returns true iff an entry that compares equal to key is in the list.
+  bool Contains(const char* key) const;
+
+  // Return estimated number of entries smaller than `key`.
+  uint64_t EstimateCount(const char* key) const;
+
+  // Appends about n keys evenly spread over the list, in order.
+  void SampleKeys(size_t n, std::vector<const char*>* keys) const;
+
+  void TESTContinuous() const;
+
+  // Where the arenas are. The local ones are where the compute node
+  // allocated them, the remote ones a copy the list is read from instead.
+  inline void set_local_begin(void* local) {
+    local_meta_ = reinterpret_cast<const char*>(local);
+  }
+  inline std::pair<const char*, size_t> get_local_begin() const {
+    return std::make_pair(local_meta_, RawBlockSize());
+  }
+  inline std::pair<void*, size_t> get_remote_begin() const {
+    return std::make_pair(remote_meta_, RawBlockSize());
+  }
+  inline void set_remote_begin(void* remote) {
+    assert(remote != nullptr);
+    remote_meta_ = reinterpret_cast<char*>(remote);
+    meta_ = remote_meta_;
+  }
+  inline void set_shard_remote_begin(int sep, void* remote) {
+    assert(remote != nullptr);
+    remote_shard_[sep] = reinterpret_cast<char*>(remote);
+    shard_[sep] = remote_shard_[sep];
+  }
+  inline void set_shard_layout(int shard_num, bool ordered) {
+    assert(shard_num >= 0 && shard_num <= kMaxMemTableShards);
+    shard_num_ = shard_num;
+    shards_ordered_ = ordered;
+  }
+  inline int get_shard_num() const { return shard_num_; }
+  inline bool get_shards_ordered() const { return shards_ordered_; }
+  inline void set_shard_local_begin(int sep, void* local) {
+    local_shard_[sep] = reinterpret_cast<const char*>(local);
+  }
+  inline void* get_shard_local_begin(int sep) const {
+    return const_cast<char*>(local_shard_[sep]);
+  }
+  inline void* get_shard_remote_begin(int sep) { return remote_shard_[sep]; }
+
+  inline int64_t get_head_offset() const { return head_; }
+  inline void set_head_offset(int64_t offset) { head_ = offset; }
+  inline void set_max_height(int height) {
+    max_height_.store(height, std::memory_order_release);
+  }
+  inline void get_max_height(int& height) const {
+    height = max_height_.load(std::memory_order_acquire);
+  }
+  inline Status SendToRemote() const {
+    return reinterpret_cast<BasicArena*>(allocator_)->SendToRemote();
+  }
+  inline void get_remote_page_info(uint64_t* info) const {
+    return reinterpret_cast<BasicArena*>(allocator_)
+        ->get_remote_page_info(info);
+  }
+
+  // Iteration over the contents of a skip list
+  class Iterator {
+   public:
+    // Initialize an iterator over the specified list.
+    // The returned iterator is not valid.
+    explicit Iterator(const OffsetSkipList* list) { SetList(list); }
+
+    void SetList(const OffsetSkipList* list) {
+      list_ = list;
+      node_ = nullptr;
+    }
+    bool Valid() const { return node_ != nullptr; }
+    const char* key() const {
+      assert(Valid());
+      return list_->Key(node_);
+    }
+    void Next() {
+      assert(Valid());
+      node_ = list_->Next(node_, 0);
+    }
+    void Prev() {
+      // Instead of using explicit "prev" links, we just search for the
+      // last node that falls before key.
+      assert(Valid());
+      node_ = list_->FindLessThan(key());
+      if (node_ == list_->Head()) node_ = nullptr;
+    }
+    void Seek(const char* target) { node_ = list_->FindGreaterOrEqual(target); }
+    void SeekForPrev(const char* target) {
+      Seek(target);
+      if (!Valid()) SeekToLast();
+      while (Valid() && list_->LessThan(target, key())) Prev();
+    }
+    void RandomSeek() { node_ = list_->FindRandomEntry(); }
+    void SeekToFirst() { node_ = list_->Next(list_->Head(), 0); }
+    void SeekToLast() {
+      node_ = list_->FindLast();
+      if (node_ == list_->Head()) node_ = nullptr;
+    }
+
+   private:
+    const OffsetSkipList* list_;
+    Node* node_;
+    // Intentionally copyable
+  };
+
+  // Iterator over the nodes of one kv shard, see InlineSkipList.
+  class SepIterator {
+   public:
+    explicit SepIterator(const OffsetSkipList* list, int sep) {
+      SetList(list, sep);
+    }
+
+    void SetList(const OffsetSkipList* list, int sep) {
+      assert(sep >= 0 && sep < list->shard_num_);
+      list_ = list;
+      sep_ = sep;
+      node_ = nullptr;
+    }
+    bool Valid() const { return node_ != nullptr; }
+    const char* key() const {
+      assert(Valid());
+      return list_->Key(node_);
+    }
+    void Next() {
+      assert(Valid());
+      node_ = list_->Next(node_, 0);
+      SkipToShard();
+    }
+    void SeekToFirst() {
+      node_ = list_->shards_ordered_ ? list_->FindSepGreaterOrEqual(sep_)
+                                     : list_->Next(list_->Head(), 0);
+      SkipToShard();
+    }
+    void SeekToLast() {
+      if (list_->shards_ordered_) {
+        node_ = list_->FindSepLessThan(sep_ + 1);
+        SkipToShard();
+        return;
+      }
+      Node* last = nullptr;
+      for (Node* x = list_->Next(list_->Head(), 0); x != nullptr;
+           x = list_->Next(x, 0)) {
+        if (x->Shard() == sep_) last = x;
+      }
+      node_ = last;
+    }
+
+   private:
+    // move forward from node_ to the next node of the shard
+    void SkipToShard() {
+      if (list_->shards_ordered_) {
+        // the first node of another shard ends this one
+        if (node_ != nullptr && node_->Shard() != sep_) node_ = nullptr;
+        return;
+      }
+      while (node_ != nullptr && node_->Shard() != sep_) {
+        node_ = list_->Next(node_, 0);
+      }
+    }
+
+    const OffsetSkipList* list_;
+    int sep_;
+    Node* node_;
+    // Intentionally copyable
+  };
+
+ private:
+  const uint16_t kMaxHeight_;
+  const uint16_t kBranching_;
+  const uint32_t kScaledInverseBranching_;
+
+  Allocator* const allocator_;  // Allocator used for allocations of nodes
+  // Immutable after construction
+  Comparator const compare_;
+
+  // Modified only by Insert().  Read racily by readers, but stale
+  // values are ok.
+  std::atomic<int> max_height_;  // Height of the entire list
+
+  // seq_splice_ is a Splice used for insertions in the non-concurrent
+  // case.
+  Splice* seq_splice_;
+
+  const char* local_meta_{nullptr};
+  char* remote_meta_{nullptr};
+  const char* local_shard_[kMaxMemTableShards]{nullptr};
+  char* remote_shard_[kMaxMemTableShards]{nullptr};
+  // the arenas the list is read from, the local ones until a copy is
+  // attached
+  const char* meta_{nullptr};
+  const char* shard_[kMaxMemTableShards]{nullptr};
+  // of the head node from the start of the meta arena
+  int64_t head_{0};
+  int shard_num_{0};
+  // shard i only holds keys before the keys of shard i + 1
+  bool shards_ordered_{true};
+
+  inline int GetMaxHeight() const {
+    return max_height_.load(std::memory_order_relaxed);
+  }
+  size_t RawBlockSize() const {
+    return reinterpret_cast<SepConcurrentArena*>(allocator_)->RawBlockSize();
+  }
+
+  Node* Head() const {
+    return reinterpret_cast<Node*>(const_cast<char*>(meta_) + head_);
+  }
+  Node* At(Offset x) const {
+    return x == 0 ? nullptr
+                  : reinterpret_cast<Node*>(const_cast<char*>(meta_) + x - 1);
+  }
+  Offset OffsetOf(const Node* n) const {
+    return n == nullptr ? 0
+                        : static_cast<Offset>(
+                              reinterpret_cast<const char*>(n) - meta_ + 1);
+  }
+  Node* Next(Node* n, int level) const { return At(n->Link(level)); }
+  const char* Key(const Node* n) const { return shard_[n->Shard()] + n->key_; }
+
+  int RandomHeight();
+
+  Node* AllocateNode(int height, int shard);
+  Splice* AllocateSplice();
+  Splice* AllocateSpliceOnHeap();
+
+  bool LessThan(const char* a, const char* b) const {
+    return (compare_(a, b) < 0);
+  }
+
+  // Return true if key is greater than the data stored in "n".  Null n
+  // is considered infinite.  n should not be the head.
+  bool KeyIsAfterNode(const DecodedKey& key, Node* n) const {
+    return (n != nullptr) && (compare_(Key(n), key) < 0);
+  }
+
+  // Returns the earliest node with a key >= key.
+  // Return nullptr if there is no such node.
+  Node* FindGreaterOrEqual(const char* key) const;
+  Node* FindSepGreaterOrEqual(int sep) const;
+
+  // Return the latest node with a key < key.
+  // Return the head if there is no such node.
+  Node* FindLessThan(const char* key) const;
+  Node* FindSepLessThan(int sep) const;
+
+  // Return the last node in the list.
+  // Return the head if list is empty.
+  Node* FindLast() const;
+
+  // Returns a random entry.
+  Node* FindRandomEntry() const;
+
+  // See InlineSkipList::FindSpliceForLevel().
+  void FindSpliceForLevel(const DecodedKey& key, Node* before, Node* after,
+                          int level, Node** out_prev, Node** out_next);
+  void RecomputeSpliceLevels(const DecodedKey& key, Splice* splice,
+                             int recompute_level);
+
+  template <bool UseCAS>
+  bool Insert(const char* key, Splice* splice, bool allow_partial_splice_fix);
+};
+
+// Implementation details follow
+
+template <class Comparator>
+struct OffsetSkipList<Comparator>::Splice {
+  // see InlineSkipList::Splice
+  int height_ = 0;
+  Node** prev_;
+  Node** next_;
+};
+
+// Links of the levels above 0 are stored immediately _before_ the struct,
+// the key lives in the block of its shard.
+template <class Comparator>
+struct OffsetSkipList<Comparator>::Node {
+  // Stores the height of the node in the link of level 0 until Insert().
+  void StashHeight(const int height) {
+    next_[0].store(static_cast<Offset>(height), std::memory_order_relaxed);
+  }
+  int UnstashHeight() const {
+    return static_cast<int>(next_[0].load(std::memory_order_relaxed));
+  }
+
+  // kv shard of the key, kMaxMemTableShards for the head
+  int Shard() const { return shard_; }
+
+  Offset Link(int n) const {
+    assert(n >= 0);
+    return (&next_[0] - n)->load(std::memory_order_acquire);
+  }
+  void SetLink(int n, Offset x) {
+    assert(n >= 0);
+    (&next_[0] - n)->store(x, std::memory_order_release);
+  }
+  bool CASLink(int n, Offset expected, Offset x) {
+    assert(n >= 0);
+    return (&next_[0] - n)->compare_exchange_strong(expected, x);
+  }
+  Offset NoBarrier_Link(int n) const {
+    assert(n >= 0);
+    return (&next_[0] - n)->load(std::memory_order_relaxed);
+  }
+  void NoBarrier_SetLink(int n, Offset x) {
+    assert(n >= 0);
+    (&next_[0] - n)->store(x, std::memory_order_relaxed);
+  }
+
+  // next_[0] is the lowest level link (level 0).  Higher levels are
+  // stored _earlier_, so level 1 is at next_[-1].
+  std::atomic<Offset> next_[1];
+  // of the key from the start of its shard block
+  Offset key_;
+  uint8_t shard_;
+};
+
+template <class Comparator>
+OffsetSkipList<Comparator>::OffsetSkipList(const Comparator cmp,
+                                           Allocator* allocator,
+                                           int32_t max_height,
+                                           int32_t branching_factor)
+    : kMaxHeight_(static_cast<uint16_t>(max_height)),
+      kBranching_(static_cast<uint16_t>(branching_factor)),
+      kScaledInverseBranching_((Random::kMaxNext + 1) / kBranching_),
+      allocator_(allocator),
+      compare_(cmp),
+      max_height_(1) {
+  assert(max_height > 0 && kMaxHeight_ == static_cast<uint32_t>(max_height));
+  assert(branching_factor > 1 &&
+         kBranching_ == static_cast<uint32_t>(branching_factor));
+  assert(kScaledInverseBranching_ > 0);
+  assert(Fits(allocator));
+
+  auto* arena = reinterpret_cast<SepConcurrentArena*>(allocator);
+  local_meta_ = reinterpret_cast<const char*>(arena->meta_begin());
+  meta_ = local_meta_;
+  shard_num_ = arena->shard_num();
+  shards_ordered_ = arena->shards_ordered();
+  for (int i = 0; i < shard_num_; i++) {
+    local_shard_[i] = reinterpret_cast<const char*>(arena->kv_begin(i));
+    shard_[i] = local_shard_[i];
+  }
+  Node* head = AllocateNode(max_height, kMaxMemTableShards);
+  head_ = reinterpret_cast<char*>(head) - meta_;
+  for (int i = 0; i < kMaxHeight_; ++i) {
+    head->SetLink(i, 0);
+  }
+  seq_splice_ = AllocateSplice();
+}
+
+template <class Comparator>
+int OffsetSkipList<Comparator>::RandomHeight() {
+  auto rnd = Random::GetTLSInstance();
+
+  // Increase height with probability 1 in kBranching
+  int height = 1;
+  while (height < kMaxHeight_ && height < kMaxPossibleHeight &&
+         rnd->Next() < kScaledInverseBranching_) {
+    height++;
+  }
+  assert(height > 0);
+  assert(height <= kMaxHeight_);
+  assert(height <= kMaxPossibleHeight);
+  return height;
+}
+
+template <class Comparator>
+typename OffsetSkipList<Comparator>::Node*
+OffsetSkipList<Comparator>::AllocateNode(int height, int shard) {
+  auto prefix = sizeof(std::atomic<Offset>) * (height - 1);
+  char* raw = allocator_->AllocateAligned(prefix + sizeof(Node));
+  // a node past the block has no offset
+  assert(raw >= local_meta_ &&
+         raw + prefix + sizeof(Node) <= local_meta_ + RawBlockSize());
+  Node* x = reinterpret_cast<Node*>(raw + prefix);
+  x->StashHeight(height);
+  x->key_ = 0;
+  x->shard_ = static_cast<uint8_t>(shard);
+  return x;
+}
+
+template <class Comparator>
+void OffsetSkipList<Comparator>::AllocateKey(size_t key_size, char** ptr_buf,
+                                             char** kv_buf, int shard) {
+  assert(shard >= 0 && shard < shard_num_);
+  Node* x = AllocateNode(RandomHeight(), shard);
+  char* kv = reinterpret_cast<SepConcurrentArena*>(allocator_)
+                 ->AllocateKV(key_size, shard);
+  assert(kv >= local_shard_[shard] &&
+         kv + key_size <= local_shard_[shard] + RawBlockSize());
+  x->key_ = static_cast<Offset>(kv - local_shard_[shard]);
+  *ptr_buf = reinterpret_cast<char*>(x);
+  *kv_buf = kv;
+}
+
+template <class Comparator>
+typename OffsetSkipList<Comparator>::Splice*
+OffsetSkipList<Comparator>::AllocateSplice() {
+  // size of prev_ and next_
+  size_t array_size = sizeof(Node*) * (kMaxHeight_ + 1);
+  char* raw = allocator_->AllocateAligned(sizeof(Splice) + array_size * 2);
+  Splice* splice = reinterpret_cast<Splice*>(raw);
+  splice->height_ = 0;
+  splice->prev_ = reinterpret_cast<Node**>(raw + sizeof(Splice));
+  splice->next_ = reinterpret_cast<Node**>(raw + sizeof(Splice) + array_size);
+  return splice;
+}
+
+template <class Comparator>
+typename OffsetSkipList<Comparator>::Splice*
+OffsetSkipList<Comparator>::AllocateSpliceOnHeap() {
+  size_t array_size = sizeof(Node*) * (kMaxHeight_ + 1);
+  char* raw = new char[sizeof(Splice) + array_size * 2];
+  Splice* splice = reinterpret_cast<Splice*>(raw);
+  splice->height_ = 0;
+  splice->prev_ = reinterpret_cast<Node**>(raw + sizeof(Splice));
+  splice->next_ = reinterpret_cast<Node**>(raw + sizeof(Splice) + array_size);
+  return splice;
+}
+
+template <class Comparator>
+typename OffsetSkipList<Comparator>::Node*
+OffsetSkipList<Comparator>::FindGreaterOrEqual(const char* key) const {
+  Node* x = Head();
+  int level = GetMaxHeight() - 1;
+  Node* last_bigger = nullptr;
+  const DecodedKey key_decoded = compare_.decode_key(key);
+  while (true) {
+    Node* next = Next(x, level);
+    if (next != nullptr) {
+      PREFETCH(At(next->Link(level)), 0, 1);
+    }
+    int cmp = (next == nullptr || next == last_bigger)
+                  ? 1
+                  : compare_(Key(next), key_decoded);
+    if (cmp == 0 || (cmp > 0 && level == 0)) {
+      return next;
+    } else if (cmp < 0) {
+      // Keep searching in this list
+      x = next;
+    } else {
+      // Switch to next list, reuse compare_() result
+      last_bigger = next;
+      level--;
+    }
+  }
+}
+
+template <class Comparator>
+typename OffsetSkipList<Comparator>::Node*
+OffsetSkipList<Comparator>::FindLessThan(const char* key) const {
+  int level = GetMaxHeight() - 1;
+  Node* x = Head();
+  // KeyIsAfterNode(key, last_not_after) is definitely false
+  Node* last_not_after = nullptr;
+  const DecodedKey key_decoded = compare_.decode_key(key);
+  while (true) {
+    Node* next = Next(x, level);
+    if (next != nullptr) {
+      PREFETCH(At(next->Link(level)), 0, 1);
+    }
+    if (next != last_not_after && KeyIsAfterNode(key_decoded, next)) {
+      // Keep searching in this list
+      x = next;
+    } else if (level == 0) {
+      return x;
+    } else {
+      // Switch to next list, reuse KeyIsAfterNode() result
+      last_not_after = next;
+      level--;
+    }
+  }
+}
+
+template <class Comparator>
+typename OffsetSkipList<Comparator>::Node*
+OffsetSkipList<Comparator>::FindSepGreaterOrEqual(int sep) const {
+  assert(shards_ordered_);
+  Node* x = Head();
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    Node* next = Next(x, level);
+    if (next == nullptr || next->Shard() >= sep) {
+      if (level == 0) return next;
+      // Switch to next list
+      level--;
+    } else {
+      // Keep searching in this list
+      x = next;
+    }
+  }
+}
+
+template <class Comparator>
+typename OffsetSkipList<Comparator>::Node*
+OffsetSkipList<Comparator>::FindSepLessThan(int sep) const {
+  assert(shards_ordered_);
+  Node* x = Head();
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    Node* next = Next(x, level);
+    if (next == nullptr || next->Shard() >= sep) {
+      if (level == 0) return x == Head() ? nullptr : x;
+      // Switch to next list
+      level--;
+    } else {
+      // Keep searching in this list
+      x = next;
+    }
+  }
+}
+
+template <class Comparator>
+typename OffsetSkipList<Comparator>::Node*
+OffsetSkipList<Comparator>::FindLast() const {
+  Node* x = Head();
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    Node* next = Next(x, level);
+    if (next != nullptr) {
+      x = next;
+    } else if (level == 0) {
+      return x;
+    } else {
+      // Switch to next list
+      level--;
+    }
+  }
+}
+
+template <class Comparator>
+typename OffsetSkipList<Comparator>::Node*
+OffsetSkipList<Comparator>::FindRandomEntry() const {
+  // see InlineSkipList::FindRandomEntry()
+  Node *x = Head(), *scan_node = nullptr, *limit_node = nullptr;
+  std::vector<Node*> lvl_nodes;
+  Random* rnd = Random::GetTLSInstance();
+  int level = GetMaxHeight() - 1;
+
+  while (level >= 0) {
+    lvl_nodes.clear();
+    scan_node = x;
+    while (scan_node != limit_node) {
+      lvl_nodes.push_back(scan_node);
+      scan_node = Next(scan_node, level);
+    }
+    uint32_t rnd_idx = rnd->Next() % lvl_nodes.size();
+    x = lvl_nodes[rnd_idx];
+    if (rnd_idx + 1 < lvl_nodes.size()) {
+      limit_node = lvl_nodes[rnd_idx + 1];
+    }
+    level--;
+  }
+  // x could still be the head, which holds no key
+  return x == Head() ? Next(x, 0) : x;
+}
+
+template <class Comparator>
+uint64_t OffsetSkipList<Comparator>::EstimateCount(const char* key) const {
+  uint64_t count = 0;
+
+  Node* x = Head();
+  int level = GetMaxHeight() - 1;
+  const DecodedKey key_decoded = compare_.decode_key(key);
+  while (true) {
+    Node* next = Next(x, level);
+    if (next != nullptr) {
+      PREFETCH(At(next->Link(level)), 0, 1);
+    }
+    if (next == nullptr || compare_(Key(next), key_decoded) >= 0) {
+      if (level == 0) {
+        return count;
+      } else {
+        // Switch to next list
+        count *= kBranching_;
+        level--;
+      }
+    } else {
+      x = next;
+      count++;
+    }
+  }
+}
+
+template <class Comparator>
+void OffsetSkipList<Comparator>::SampleKeys(
+    size_t n, std::vector<const char*>* keys) const {
+  if (n == 0) return;
+  int level = GetMaxHeight() - 1;
+  size_t count = 0;
+  for (; level >= 0; level--) {
+    count = 0;
+    for (Node* x = Next(Head(), level); x != nullptr; x = Next(x, level)) {
+      count++;
+    }
+    if (count >= n) break;
+  }
+  if (level < 0) level = 0;
+  size_t stride = std::max<size_t>(count / n, 1);
+  size_t i = 0;
+  for (Node* x = Next(Head(), level); x != nullptr; x = Next(x, level), i++) {
+    if (i % stride == 0) keys->push_back(Key(x));
+  }
+}
+
+template <class Comparator>
+void OffsetSkipList<Comparator>::TESTContinuous() const {
+  int cnt = 0;
+  const char* end = meta_ + RawBlockSize();
+  for (Node* x = Next(Head(), 0); x != nullptr; x = Next(x, 0)) {
+    assert(reinterpret_cast<const char*>(x) < end && x->Shard() < shard_num_);
+    (void)end;
+    cnt++;
+  }
+  DM_LOG_DEBUG("OffsetSkipList TESTContinuous Iteation finish:: ", cnt);
+}
+
+template <class Comparator>
+bool OffsetSkipList<Comparator>::Insert(const char* key) {
+  return Insert<false>(key, seq_splice_, false);
+}
+
+template <class Comparator>
+bool OffsetSkipList<Comparator>::InsertConcurrently(const char* key) {
+  Node* prev[kMaxPossibleHeight];
+  Node* next[kMaxPossibleHeight];
+  Splice splice;
+  splice.prev_ = prev;
+  splice.next_ = next;
+  return Insert<true>(key, &splice, false);
+}
+
+template <class Comparator>
+bool OffsetSkipList<Comparator>::InsertWithHint(const char* key, void** hint) {
+  assert(hint != nullptr);
+  Splice* splice = reinterpret_cast<Splice*>(*hint);
+  if (splice == nullptr) {
+    splice = AllocateSplice();
+    *hint = reinterpret_cast<void*>(splice);
+  }
+  return Insert<false>(key, splice, true);
+}
+
+template <class Comparator>
+bool OffsetSkipList<Comparator>::InsertWithHintConcurrently(const char* key,
+                                                            void** hint) {
+  assert(hint != nullptr);
+  Splice* splice = reinterpret_cast<Splice*>(*hint);
+  if (splice == nullptr) {
+    splice = AllocateSpliceOnHeap();
+    *hint = reinterpret_cast<void*>(splice);
+  }
+  return Insert<true>(key, splice, true);
+}
+
+template <class Comparator>
+void OffsetSkipList<Comparator>::FindSpliceForLevel(const DecodedKey& key,
+                                                    Node* before, Node* after,
+                                                    int level, Node** out_prev,
+                                                    Node** out_next) {
+  while (true) {
+    Node* next = Next(before, level);
+    if (next != nullptr) {
+      PREFETCH(At(next->Link(level)), 0, 1);
+    }
+    if (next == after || !KeyIsAfterNode(key, next)) {
+      // found it
+      *out_prev = before;
+      *out_next = next;
+      return;
+    }
+    before = next;
+  }
+}
+
+template <class Comparator>
+void OffsetSkipList<Comparator>::RecomputeSpliceLevels(const DecodedKey& key,
+                                                       Splice* splice,
+                                                       int recompute_level) {
+  assert(recompute_level > 0);
+  assert(recompute_level <= splice->height_);
+  for (int i = recompute_level - 1; i >= 0; --i) {
+    FindSpliceForLevel(key, splice->prev_[i + 1], splice->next_[i + 1], i,
+                       &splice->prev_[i], &splice->next_[i]);
+  }
+}
+
+template <class Comparator>
+template <bool UseCAS>
+bool OffsetSkipList<Comparator>::Insert(const char* handle, Splice* splice,
+                                        bool allow_partial_splice_fix) {
+  Node* x = reinterpret_cast<Node*>(const_cast<char*>(handle));
+  const char* key = Key(x);
+  const DecodedKey key_decoded = compare_.decode_key(key);
+  int height = x->UnstashHeight();
+  assert(height >= 1 && height <= kMaxHeight_);
+  Node* head = Head();
+
+  int max_height = max_height_.load(std::memory_order_relaxed);
+  while (height > max_height) {
+    if (max_height_.compare_exchange_weak(max_height, height)) {
+      // successfully updated it
+      max_height = height;
+      break;
+    }
+    // else retry, possibly exiting the loop because somebody else
+    // increased it
+  }
+  assert(max_height <= kMaxPossibleHeight);
+
+  // validates the splice as InlineSkipList::Insert() does
+  int recompute_height = 0;
+  if (splice->height_ < max_height) {
+    splice->prev_[max_height] = head;
+    splice->next_[max_height] = nullptr;
+    splice->height_ = max_height;
+    recompute_height = max_height;
+  } else {
+    while (recompute_height < max_height) {
+      if (Next(splice->prev_[recompute_height], recompute_height) !=
+          splice->next_[recompute_height]) {
+        // splice isn't tight at this level
+        ++recompute_height;
+      } else if (splice->prev_[recompute_height] != head &&
+                 !KeyIsAfterNode(key_decoded,
+                                 splice->prev_[recompute_height])) {
+        // key is from before splice
+        if (allow_partial_splice_fix) {
+          Node* bad = splice->prev_[recompute_height];
+          while (splice->prev_[recompute_height] == bad) {
+            ++recompute_height;
+          }
+        } else {
+          recompute_height = max_height;
+        }
+      } else if (KeyIsAfterNode(key_decoded, splice->next_[recompute_height])) {
+        // key is from after splice
+        if (allow_partial_splice_fix) {
+          Node* bad = splice->next_[recompute_height];
+          while (splice->next_[recompute_height] == bad) {
+            ++recompute_height;
+          }
+        } else {
+          recompute_height = max_height;
+        }
+      } else {
+        // this level brackets the key, we won!
+        break;
+      }
+    }
+  }
+  assert(recompute_height <= max_height);
+  if (recompute_height > 0) {
+    RecomputeSpliceLevels(key_decoded, splice, recompute_height);
+  }
+
+  const Offset x_off = OffsetOf(x);
+  bool splice_is_valid = true;
+  for (int i = 0; i < height; ++i) {
+    while (true) {
+      if (!UseCAS && i >= recompute_height &&
+          Next(splice->prev_[i], i) != splice->next_[i]) {
+        FindSpliceForLevel(key_decoded, splice->prev_[i], nullptr, i,
+                           &splice->prev_[i], &splice->next_[i]);
+      }
+      // Checking for duplicate keys on the level 0 is sufficient
+      if (UNLIKELY(i == 0 && splice->next_[i] != nullptr &&
+                   compare_(key, Key(splice->next_[i])) >= 0)) {
+        // duplicate key
+        return false;
+      }
+      if (UNLIKELY(i == 0 && splice->prev_[i] != head &&
+                   compare_(Key(splice->prev_[i]), key) >= 0)) {
+        // duplicate key
+        return false;
+      }
+      Offset next_off = OffsetOf(splice->next_[i]);
+      x->NoBarrier_SetLink(i, next_off);
+      if (!UseCAS) {
+        assert(Next(splice->prev_[i], i) == splice->next_[i]);
+        splice->prev_[i]->SetLink(i, x_off);
+        break;
+      }
+      if (splice->prev_[i]->CASLink(i, next_off, x_off)) {
+        // success
+        break;
+      }
+      // CAS failed, we need to recompute prev and next, see
+      // InlineSkipList::Insert()
+      FindSpliceForLevel(key_decoded, splice->prev_[i], nullptr, i,
+                         &splice->prev_[i], &splice->next_[i]);
+      if (i > 0) {
+        splice_is_valid = false;
+      }
+    }
+  }
+  if (splice_is_valid) {
+    for (int i = 0; i < height; ++i) {
+      splice->prev_[i] = x;
+    }
+    assert(splice->prev_[splice->height_] == head);
+    assert(splice->next_[splice->height_] == nullptr);
+  } else {
+    splice->height_ = 0;
+  }
+  return true;
+}
+
+template <class Comparator>
+bool OffsetSkipList<Comparator>::Contains(const char* key) const {
+  Node* x = FindGreaterOrEqual(key);
+  return x != nullptr && compare_(key, Key(x)) == 0;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,765 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memtable/offset_skiplist.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "memory/arena.h"
+#include "memory/concurrent_arena.h"
+#include "memory/sep_concurrent_arena.h"
+#include "rocksdb/env.h"
+#include "rocksdb/memtablerep.h"
+#include "test_util/testharness.h"
+#include "util/coding.h"
+#include "util/hash.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Our test skip list stores 8-byte unsigned integers
+using Key = uint64_t;
+
+static const char* Encode(const uint64_t* key) {
+  return reinterpret_cast<const char*>(key);
+}
+
+static Key Decode(const char* key) {
+  Key rv;
+  memcpy(&rv, key, sizeof(Key));
+  return rv;
+}
+
+struct TestComparator {
+  using DecodedType = Key;
+
+  static DecodedType decode_key(const char* b) { return Decode(b); }
+
+  int operator()(const char* a, const char* b) const {
+    if (Decode(a) < Decode(b)) {
+      return -1;
+    } else if (Decode(a) > Decode(b)) {
+      return +1;
+    } else {
+      return 0;
+    }
+  }
+
+  int operator()(const char* a, const DecodedType b) const {
+    if (Decode(a) < b) {
+      return -1;
+    } else if (Decode(a) > b) {
+      return +1;
+    } else {
+      return 0;
+    }
+  }
+};
+
+using TestOffsetSkipList = OffsetSkipList<TestComparator>;
+
+static const size_t kMemTableSize = 4 << 20;
+
+class OffsetSkipTest : public testing::Test {
+ public:
+  // keys go to shard key % shard_num, shards are not ordered
+  static int ShardOf(const TestOffsetSkipList* list, Key key) {
+    return static_cast<int>(key % list->get_shard_num());
+  }
+
+  void Insert(TestOffsetSkipList* list, Key key) {
+    char* ptr;
+    char* kv;
+    list->AllocateKey(sizeof(Key), &ptr, &kv, ShardOf(list, key));
+    memcpy(kv, &key, sizeof(Key));
+    ASSERT_TRUE(list->Insert(ptr));
+    keys_.insert(key);
+  }
+
+  bool InsertWithHint(TestOffsetSkipList* list, Key key, void** hint) {
+    char* ptr;
+    char* kv;
+    list->AllocateKey(sizeof(Key), &ptr, &kv, ShardOf(list, key));
+    memcpy(kv, &key, sizeof(Key));
+    bool res = list->InsertWithHint(ptr, hint);
+    keys_.insert(key);
+    return res;
+  }
+
+  // the list holds exactly keys_, in order both ways
+  void Validate(TestOffsetSkipList* list) {
+    TestOffsetSkipList::Iterator iter(list);
+    iter.SeekToFirst();
+    for (Key key : keys_) {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(key, Decode(iter.key()));
+      iter.Next();
+    }
+    ASSERT_FALSE(iter.Valid());
+    iter.SeekToLast();
+    for (auto it = keys_.rbegin(); it != keys_.rend(); ++it) {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*it, Decode(iter.key()));
+      iter.Prev();
+    }
+    ASSERT_FALSE(iter.Valid());
+  }
+
+  // Seek, SeekForPrev and Contains agree with keys_ for every target
+  // up to max
+  void ValidateSeeks(TestOffsetSkipList* list, Key max) {
+    TestOffsetSkipList::Iterator iter(list);
+    for (Key target = 0; target <= max; target++) {
+      ASSERT_EQ(keys_.count(target) > 0, list->Contains(Encode(&target)));
+      iter.Seek(Encode(&target));
+      auto it = keys_.lower_bound(target);
+      if (it == keys_.end()) {
+        ASSERT_FALSE(iter.Valid());
+      } else {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(*it, Decode(iter.key()));
+      }
+      iter.SeekForPrev(Encode(&target));
+      it = keys_.upper_bound(target);
+      if (it == keys_.begin()) {
+        ASSERT_FALSE(iter.Valid());
+      } else {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(*--it, Decode(iter.key()));
+      }
+    }
+  }
+
+  // the shard iterator of every shard returns its keys in order
+  void ValidateShards(TestOffsetSkipList* list) {
+    for (int sep = 0; sep < list->get_shard_num(); sep++) {
+      std::vector<Key> expected;
+      for (Key key : keys_) {
+        if (ShardOf(list, key) == sep) expected.push_back(key);
+      }
+      TestOffsetSkipList::SepIterator iter(list, sep);
+      iter.SeekToFirst();
+      for (Key key : expected) {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(key, Decode(iter.key()));
+        iter.Next();
+      }
+      ASSERT_FALSE(iter.Valid());
+      iter.SeekToLast();
+      if (expected.empty()) {
+        ASSERT_FALSE(iter.Valid());
+      } else {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(expected.back(), Decode(iter.key()));
+      }
+    }
+  }
+
+ private:
+  std::set<Key> keys_;
+};
+
+TEST_F(OffsetSkipTest, Empty) {
+  SepConcurrentArena arena(kMemTableSize, 1, nullptr, false);
+  ASSERT_TRUE(TestOffsetSkipList::Fits(&arena));
+  TestComparator cmp;
+  TestOffsetSkipList list(cmp, &arena);
+  Key key = 10;
+  ASSERT_TRUE(!list.Contains(Encode(&key)));
+
+  TestOffsetSkipList::Iterator iter(&list);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToFirst();
+  ASSERT_TRUE(!iter.Valid());
+  key = 100;
+  iter.Seek(Encode(&key));
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekForPrev(Encode(&key));
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToLast();
+  ASSERT_TRUE(!iter.Valid());
+}
+
+TEST_F(OffsetSkipTest, InsertAndLookup) {
+  const int N = 2000;
+  const int R = 5000;
+  Random rnd(1000);
+  SepConcurrentArena arena(kMemTableSize, 3, nullptr, false);
+  TestComparator cmp;
+  TestOffsetSkipList list(cmp, &arena);
+  std::set<Key> inserted;
+  for (int i = 0; i < N; i++) {
+    Key key = rnd.Next() % R;
+    if (inserted.insert(key).second) {
+      Insert(&list, key);
+    }
+  }
+  // an equal key is not inserted twice
+  Key dup = *inserted.begin();
+  char* ptr;
+  char* kv;
+  list.AllocateKey(sizeof(Key), &ptr, &kv, ShardOf(&list, dup));
+  memcpy(kv, &dup, sizeof(Key));
+  ASSERT_FALSE(list.Insert(ptr));
+
+  Validate(&list);
+  ValidateSeeks(&list, R);
+  ValidateShards(&list);
+
+  // Forward iteration test
+  for (Key i = 0; i < R; i++) {
+    TestOffsetSkipList::Iterator iter(&list);
+    iter.Seek(Encode(&i));
+    // Compare against model iterator
+    auto model_iter = inserted.lower_bound(i);
+    for (int j = 0; j < 3; j++) {
+      if (model_iter == inserted.end()) {
+        ASSERT_TRUE(!iter.Valid());
+        break;
+      } else {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(*model_iter, Decode(iter.key()));
+        ++model_iter;
+        iter.Next();
+      }
+    }
+  }
+
+  // Backward iteration test
+  for (Key i = 0; i < R; i++) {
+    TestOffsetSkipList::Iterator iter(&list);
+    iter.SeekForPrev(Encode(&i));
+    // Compare against model iterator
+    auto model_iter = inserted.upper_bound(i);
+    for (int j = 0; j < 3; j++) {
+      if (model_iter == inserted.begin()) {
+        ASSERT_TRUE(!iter.Valid());
+        break;
+      } else {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(*--model_iter, Decode(iter.key()));
+        iter.Prev();
+      }
+    }
+  }
+}
+
+TEST_F(OffsetSkipTest, InsertWithHint) {
+  SepConcurrentArena arena(kMemTableSize, 2, nullptr, false);
+  TestComparator cmp;
+  TestOffsetSkipList list(cmp, &arena);
+  void* hint1 = nullptr;
+  void* hint2 = nullptr;
+  void* hint3 = nullptr;
+  for (Key i = 0; i < 100; i++) {
+    ASSERT_TRUE(InsertWithHint(&list, 1000 + i, &hint1));
+    ASSERT_TRUE(InsertWithHint(&list, 2000 + i, &hint2));
+    ASSERT_TRUE(InsertWithHint(&list, 3000 + i, &hint3));
+  }
+  // keys between the runs, and a repeated one
+  for (Key i = 0; i < 50; i++) {
+    ASSERT_TRUE(InsertWithHint(&list, 1500 + i, &hint1));
+  }
+  ASSERT_FALSE(InsertWithHint(&list, 1500, &hint1));
+  Validate(&list);
+  ValidateSeeks(&list, 3200);
+}
+
+TEST_F(OffsetSkipTest, ShardsOrdered) {
+  // shard i holds the keys before those of shard i + 1
+  SepConcurrentArena arena(kMemTableSize, 4, nullptr, true);
+  TestComparator cmp;
+  TestOffsetSkipList list(cmp, &arena);
+  ASSERT_TRUE(list.get_shards_ordered());
+  Random rnd(301);
+  std::vector<std::set<Key>> shards(4);
+  for (int i = 0; i < 1000; i++) {
+    int sep = static_cast<int>(rnd.Uniform(3));
+    Key key = sep * 10000 + rnd.Uniform(10000);
+    if (!shards[sep].insert(key).second) continue;
+    char* ptr;
+    char* kv;
+    list.AllocateKey(sizeof(Key), &ptr, &kv, sep);
+    memcpy(kv, &key, sizeof(Key));
+    ASSERT_TRUE(list.Insert(ptr));
+  }
+  // shard 3 stays empty
+  for (int sep = 0; sep < 4; sep++) {
+    TestOffsetSkipList::SepIterator iter(&list, sep);
+    iter.SeekToFirst();
+    for (Key key : shards[sep]) {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(key, Decode(iter.key()));
+      iter.Next();
+    }
+    ASSERT_FALSE(iter.Valid());
+    iter.SeekToLast();
+    if (shards[sep].empty()) {
+      ASSERT_FALSE(iter.Valid());
+    } else {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*shards[sep].rbegin(), Decode(iter.key()));
+    }
+  }
+}
+
+TEST_F(OffsetSkipTest, RelocatedArenas) {
+  // A copy of the arenas at other addresses reads the same list, as the
+  // memnode and the flush workers read a shipped memtable.
+  const int kShards = 3;
+  SepConcurrentArena arena(kMemTableSize, kShards, nullptr, false);
+  TestComparator cmp;
+  TestOffsetSkipList list(cmp, &arena);
+  Random rnd(302);
+  for (int i = 0; i < 3000; i++) {
+    Key key = rnd.Uniform(100000);
+    if (!list.Contains(Encode(&key))) Insert(&list, key);
+  }
+  Validate(&list);
+
+  auto meta = list.get_local_begin();
+  ASSERT_EQ(static_cast<const void*>(meta.first), arena.meta_begin());
+  ASSERT_EQ(arena.RawBlockSize(), meta.second);
+  // the copies do not share the alignment of the originals beyond a link
+  std::unique_ptr<char[]> meta_copy(new char[meta.second + 64]);
+  memcpy(meta_copy.get() + 40, meta.first, meta.second);
+  std::vector<std::unique_ptr<char[]>> kv_copy;
+  for (int sep = 0; sep < kShards; sep++) {
+    ASSERT_EQ(arena.kv_begin(sep), list.get_shard_local_begin(sep));
+    kv_copy.emplace_back(new char[meta.second + 64]);
+    memcpy(kv_copy.back().get() + 8 * (sep + 1),
+           list.get_shard_local_begin(sep), meta.second);
+  }
+  list.set_remote_begin(meta_copy.get() + 40);
+  for (int sep = 0; sep < kShards; sep++) {
+    list.set_shard_remote_begin(sep, kv_copy[sep].get() + 8 * (sep + 1));
+  }
+  ASSERT_EQ(static_cast<void*>(meta_copy.get() + 40),
+            list.get_remote_begin().first);
+  // nothing is read from the originals any more
+  memset(const_cast<char*>(meta.first), 0xdd, meta.second);
+  for (int sep = 0; sep < kShards; sep++) {
+    memset(list.get_shard_local_begin(sep), 0xdd, meta.second);
+  }
+  Validate(&list);
+  ValidateSeeks(&list, 100000);
+  ValidateShards(&list);
+}
+
+TEST_F(OffsetSkipTest, Fits) {
+  SepConcurrentArena sep_arena(kMemTableSize, 1);
+  ASSERT_TRUE(TestOffsetSkipList::Fits(&sep_arena));
+  // other arenas hand out blocks an offset does not address
+  Arena arena;
+  ASSERT_FALSE(TestOffsetSkipList::Fits(&arena));
+  ConcurrentArena concurrent_arena;
+  ASSERT_FALSE(TestOffsetSkipList::Fits(&concurrent_arena));
+}
+
+namespace {
+
+// bytewise order of the length prefixed keys
+class LengthPrefixedComparator : public MemTableRep::KeyComparator {
+ public:
+  int operator()(const char* a, const char* b) const override {
+    return GetLengthPrefixedSlice(a).compare(GetLengthPrefixedSlice(b));
+  }
+  int operator()(const char* a, const Slice& b) const override {
+    return GetLengthPrefixedSlice(a).compare(b);
+  }
+};
+
+// an arena with the layout of SepConcurrentArena that OffsetSkipList does
+// not take
+class OtherSepArena : public SepConcurrentArena {
+ public:
+  using SepConcurrentArena::SepConcurrentArena;
+  const char* name() const override { return "OtherSepArena"; }
+};
+
+}  // namespace
+
+TEST_F(OffsetSkipTest, FactoryFallsBackToPointerLinks) {
+  const int kKeys = 20000;
+  LengthPrefixedComparator cmp;
+  OffsetSkipListFactory factory;
+  SepConcurrentArena offset_arena(kMemTableSize, 1, nullptr, false);
+  OtherSepArena pointer_arena(kMemTableSize, 1, nullptr, false);
+  ASSERT_FALSE(TestOffsetSkipList::Fits(&pointer_arena));
+  std::unique_ptr<MemTableRep> offset_rep(
+      factory.CreateMemTableRep(cmp, &offset_arena, nullptr, nullptr));
+  std::unique_ptr<MemTableRep> pointer_rep(
+      factory.CreateMemTableRep(cmp, &pointer_arena, nullptr, nullptr));
+  ASSERT_NE(nullptr, offset_rep);
+  ASSERT_NE(nullptr, pointer_rep);
+
+  std::vector<std::string> keys;
+  for (int i = 0; i < kKeys; i++) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "key%08d", i);
+    keys.emplace_back(buf);
+  }
+  Random rnd(303);
+  RandomShuffle(keys.begin(), keys.end(), rnd.Next());
+  for (MemTableRep* rep : {offset_rep.get(), pointer_rep.get()}) {
+    for (const auto& key : keys) {
+      std::string entry;
+      PutLengthPrefixedSlice(&entry, key);
+      char* ptr;
+      char* kv;
+      KeyHandle handle = rep->Allocate(entry.size(), &ptr, &kv, 0);
+      memcpy(kv, entry.data(), entry.size());
+      rep->Insert(handle);
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  for (MemTableRep* rep : {offset_rep.get(), pointer_rep.get()}) {
+    std::unique_ptr<MemTableRep::Iterator> iter(rep->GetIterator());
+    iter->SeekToFirst();
+    for (const auto& key : keys) {
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(key, GetLengthPrefixedSlice(iter->key()).ToString());
+      iter->Next();
+    }
+    ASSERT_FALSE(iter->Valid());
+  }
+  // the same entries take more meta arena bytes with pointer links
+  ASSERT_LT(offset_arena.ApproximateMemoryUsage() + kKeys * 4,
+            pointer_arena.ApproximateMemoryUsage());
+}
+
+// We want to make sure that with a single writer and multiple
+// concurrent readers (with no synchronization other than when a
+// reader's iterator is created), the reader always observes all the
+// data that was present in the skip list when the iterator was
+// constructor.  The scheme and the helpers are those of
+// inlineskiplist_test, see there.
+class ConcurrentTest {
+ public:
+  static const uint32_t K = 8;
+
+ private:
+  static uint64_t key(Key key) { return (key >> 40); }
+  static uint64_t gen(Key key) { return (key >> 8) & 0xffffffffu; }
+  static uint64_t hash(Key key) { return key & 0xff; }
+
+  static uint64_t HashNumbers(uint64_t k, uint64_t g) {
+    uint64_t data[2] = {k, g};
+    return Hash(reinterpret_cast<char*>(data), sizeof(data), 0);
+  }
+
+  static Key MakeKey(uint64_t k, uint64_t g) {
+    assert(sizeof(Key) == sizeof(uint64_t));
+    assert(k <= K);  // We sometimes pass K to seek to the end of the skiplist
+    assert(g <= 0xffffffffu);
+    return ((k << 40) | (g << 8) | (HashNumbers(k, g) & 0xff));
+  }
+
+  static bool IsValidKey(Key k) {
+    return hash(k) == (HashNumbers(key(k), gen(k)) & 0xff);
+  }
+
+  static Key RandomTarget(Random* rnd) {
+    switch (rnd->Next() % 10) {
+      case 0:
+        // Seek to beginning
+        return MakeKey(0, 0);
+      case 1:
+        // Seek to end
+        return MakeKey(K, 0);
+      default:
+        // Seek to middle
+        return MakeKey(rnd->Next() % K, 0);
+    }
+  }
+
+  // Per-key generation
+  struct State {
+    std::atomic<int> generation[K];
+    void Set(int k, int v) {
+      generation[k].store(v, std::memory_order_release);
+    }
+    int Get(int k) { return generation[k].load(std::memory_order_acquire); }
+
+    State() {
+      for (unsigned int k = 0; k < K; k++) {
+        Set(k, 0);
+      }
+    }
+  };
+
+  // Current state of the test
+  State current_;
+
+  // one kv shard per key
+  SepConcurrentArena arena_;
+
+  // OffsetSkipList is not protected by mu_.  We just use a single writer
+  // thread to modify it.
+  TestOffsetSkipList list_;
+
+  // The key goes to the shard of k, so concurrent writers allocate from
+  // different kv shards as well as from the meta arena.
+  char* AllocateKey(Key new_key) {
+    char* ptr;
+    char* kv;
+    list_.AllocateKey(sizeof(Key), &ptr, &kv, static_cast<int>(key(new_key)));
+    memcpy(kv, &new_key, sizeof(Key));
+    return ptr;
+  }
+
+ public:
+  ConcurrentTest()
+      : arena_(kMemTableSize, K, nullptr, false),
+        list_(TestComparator(), &arena_) {}
+
+  // REQUIRES: No concurrent calls to WriteStep or ConcurrentWriteStep
+  void WriteStep(Random* rnd) {
+    const uint32_t k = rnd->Next() % K;
+    const int g = current_.Get(k) + 1;
+    list_.Insert(AllocateKey(MakeKey(k, g)));
+    current_.Set(k, g);
+  }
+
+  // REQUIRES: No concurrent calls for the same k
+  void ConcurrentWriteStep(uint32_t k, bool use_hint = false) {
+    const int g = current_.Get(k) + 1;
+    char* buf = AllocateKey(MakeKey(k, g));
+    if (use_hint) {
+      void* hint = nullptr;
+      list_.InsertWithHintConcurrently(buf, &hint);
+      delete[] reinterpret_cast<char*>(hint);
+    } else {
+      list_.InsertConcurrently(buf);
+    }
+    ASSERT_EQ(g, current_.Get(k) + 1);
+    current_.Set(k, g);
+  }
+
+  void ReadStep(Random* rnd) {
+    // Remember the initial committed state of the skiplist.
+    State initial_state;
+    for (unsigned int k = 0; k < K; k++) {
+      initial_state.Set(k, current_.Get(k));
+    }
+
+    Key pos = RandomTarget(rnd);
+    TestOffsetSkipList::Iterator iter(&list_);
+    iter.Seek(Encode(&pos));
+    while (true) {
+      Key current;
+      if (!iter.Valid()) {
+        current = MakeKey(K, 0);
+      } else {
+        current = Decode(iter.key());
+        ASSERT_TRUE(IsValidKey(current)) << current;
+      }
+      ASSERT_LE(pos, current) << "should not go backwards";
+
+      // Verify that everything in [pos,current) was not present in
+      // initial_state.
+      while (pos < current) {
+        ASSERT_LT(key(pos), K) << pos;
+
+        // Note that generation 0 is never inserted, so it is ok if
+        // <*,0,*> is missing.
+        ASSERT_TRUE((gen(pos) == 0U) ||
+                    (gen(pos) > static_cast<uint64_t>(initial_state.Get(
+                                    static_cast<int>(key(pos))))))
+            << "key: " << key(pos) << "; gen: " << gen(pos)
+            << "; initgen: " << initial_state.Get(static_cast<int>(key(pos)));
+
+        // Advance to next key in the valid key space
+        if (key(pos) < key(current)) {
+          pos = MakeKey(key(pos) + 1, 0);
+        } else {
+          pos = MakeKey(key(pos), gen(pos) + 1);
+        }
+      }
+
+      if (!iter.Valid()) {
+        break;
+      }
+
+      if (rnd->Next() % 2) {
+        iter.Next();
+        pos = MakeKey(key(pos), gen(pos) + 1);
+      } else {
+        Key new_target = RandomTarget(rnd);
+        if (new_target > pos) {
+          pos = new_target;
+          iter.Seek(Encode(&new_target));
+        }
+      }
+    }
+  }
+};
+const uint32_t ConcurrentTest::K;
+
+// Simple test that does single-threaded testing of the ConcurrentTest
+// scaffolding.
+TEST_F(OffsetSkipTest, ConcurrentReadWithoutThreads) {
+  ConcurrentTest test;
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < 10000; i++) {
+    test.ReadStep(&rnd);
+    test.WriteStep(&rnd);
+  }
+}
+
+TEST_F(OffsetSkipTest, ConcurrentInsertWithoutThreads) {
+  ConcurrentTest test;
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < 10000; i++) {
+    test.ReadStep(&rnd);
+    uint32_t base = rnd.Next();
+    for (int j = 0; j < 4; ++j) {
+      test.ConcurrentWriteStep((base + j) % ConcurrentTest::K);
+    }
+  }
+}
+
+class TestState {
+ public:
+  ConcurrentTest t_;
+  bool use_hint_;
+  int seed_;
+  std::atomic<bool> quit_flag_;
+  std::atomic<uint32_t> next_writer_;
+
+  enum ReaderState { STARTING, RUNNING, DONE };
+
+  explicit TestState(int s)
+      : seed_(s),
+        quit_flag_(false),
+        state_(STARTING),
+        pending_writers_(0),
+        state_cv_(&mu_) {}
+
+  void Wait(ReaderState s) {
+    mu_.Lock();
+    while (state_ != s) {
+      state_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+  void Change(ReaderState s) {
+    mu_.Lock();
+    state_ = s;
+    state_cv_.Signal();
+    mu_.Unlock();
+  }
+
+  void AdjustPendingWriters(int delta) {
+    mu_.Lock();
+    pending_writers_ += delta;
+    if (pending_writers_ == 0) {
+      state_cv_.Signal();
+    }
+    mu_.Unlock();
+  }
+
+  void WaitForPendingWriters() {
+    mu_.Lock();
+    while (pending_writers_ != 0) {
+      state_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+ private:
+  port::Mutex mu_;
+  ReaderState state_;
+  int pending_writers_;
+  port::CondVar state_cv_;
+};
+
+static void ConcurrentReader(void* arg) {
+  TestState* state = reinterpret_cast<TestState*>(arg);
+  Random rnd(state->seed_);
+  state->Change(TestState::RUNNING);
+  while (!state->quit_flag_.load(std::memory_order_acquire)) {
+    state->t_.ReadStep(&rnd);
+  }
+  state->Change(TestState::DONE);
+}
+
+static void ConcurrentWriter(void* arg) {
+  TestState* state = reinterpret_cast<TestState*>(arg);
+  uint32_t k = state->next_writer_++ % ConcurrentTest::K;
+  state->t_.ConcurrentWriteStep(k, state->use_hint_);
+  state->AdjustPendingWriters(-1);
+}
+
+// fewer rounds than inlineskiplist_test, every round takes a memtable sized
+// arena per shard
+static void RunConcurrentRead(int run) {
+  const int seed = test::RandomSeed() + (run * 100);
+  Random rnd(seed);
+  const int N = 100;
+  const int kSize = 1000;
+  for (int i = 0; i < N; i++) {
+    TestState state(seed + 1);
+    Env::Default()->SetBackgroundThreads(1);
+    Env::Default()->Schedule(ConcurrentReader, &state);
+    state.Wait(TestState::RUNNING);
+    for (int k = 0; k < kSize; ++k) {
+      state.t_.WriteStep(&rnd);
+    }
+    state.quit_flag_.store(true, std::memory_order_release);
+    state.Wait(TestState::DONE);
+  }
+}
+
+static void RunConcurrentInsert(int run, bool use_hint = false,
+                                int write_parallelism = 4) {
+  Env::Default()->SetBackgroundThreads(1 + write_parallelism,
+                                       Env::Priority::LOW);
+  const int seed = test::RandomSeed() + (run * 100);
+  Random rnd(seed);
+  const int N = 100;
+  const int kSize = 1000;
+  for (int i = 0; i < N; i++) {
+    TestState state(seed + 1);
+    state.use_hint_ = use_hint;
+    Env::Default()->Schedule(ConcurrentReader, &state);
+    state.Wait(TestState::RUNNING);
+    for (int k = 0; k < kSize; k += write_parallelism) {
+      state.next_writer_ = rnd.Next();
+      state.AdjustPendingWriters(write_parallelism);
+      for (int p = 0; p < write_parallelism; ++p) {
+        Env::Default()->Schedule(ConcurrentWriter, &state);
+      }
+      state.WaitForPendingWriters();
+    }
+    state.quit_flag_.store(true, std::memory_order_release);
+    state.Wait(TestState::DONE);
+  }
+}
+
+TEST_F(OffsetSkipTest, ConcurrentRead1) { RunConcurrentRead(1); }
+TEST_F(OffsetSkipTest, ConcurrentRead2) { RunConcurrentRead(2); }
+TEST_F(OffsetSkipTest, ConcurrentInsert1) { RunConcurrentInsert(1); }
+TEST_F(OffsetSkipTest, ConcurrentInsert2) { RunConcurrentInsert(2); }
+TEST_F(OffsetSkipTest, ConcurrentInsertWithHint1) {
+  RunConcurrentInsert(1, true);
+}
+TEST_F(OffsetSkipTest, ConcurrentInsertWithHint2) {
+  RunConcurrentInsert(2, true);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,225 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#include "memtable/remote_skiplist_reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "rocksdb/logger.hpp"
+#include "util/coding.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+// bytes read at a key first, most keys and their length fit
+constexpr size_t kKeyProbe = 64;
+// the tallest list InlineSkipList builds
+constexpr int kMaxLevels = 32;
+}  // namespace
+
+RemoteSkipListReader::RemoteSkipListReader(
+    const RemoteSkipListLayout& layout, const MemTableRep::KeyComparator& cmp)
+    : layout_(layout), cmp_(cmp) {}
+
+bool RemoteSkipListReader::ToRemote(uintptr_t addr, size_t len, int shard,
+                                    uint64_t* offset) const {
+  uintptr_t base = layout_.meta_local;
+  uint64_t remote = layout_.meta_remote;
+  uint64_t size = layout_.meta_size;
+  if (shard >= 0) {
+    if (shard >= layout_.shard_num) return false;
+    base = layout_.kv_local[shard];
+    remote = layout_.kv_remote[shard];
+    size = layout_.kv_size[shard];
+  }
+  if (addr < base || addr - base + len > size) return false;
+  *offset = remote + (addr - base);
+  return true;
+}
+
+size_t RemoteSkipListReader::ShardTail(uintptr_t addr, int shard) const {
+  if (shard < 0 || shard >= layout_.shard_num) return 0;
+  uintptr_t base = layout_.kv_local[shard];
+  if (addr < base || addr - base >= layout_.kv_size[shard]) return 0;
+  return static_cast<size_t>(layout_.kv_size[shard] - (addr - base));
+}
+
+Status RemoteSkipListReader::ReadNode(const Fetch& fetch, uintptr_t addr,
+                                      int level, Node* node) {
+  constexpr size_t kLink = RemoteSkipListLayout::kLinkSize;
+  char buf[kMaxLevels * kLink + RemoteSkipListLayout::kNodeSize];
+  size_t below = static_cast<size_t>(level) * kLink;
+  size_t len = below + RemoteSkipListLayout::kNodeSize;
+  uint64_t offset = 0;
+  if (addr < below || !ToRemote(addr - below, len, -1, &offset)) {
+    return Status::NotSupported("skiplist node outside the shipped arena");
+  }
+  if (!fetch(offset, len, buf)) {
+    return Status::IOError("one-sided read of a skiplist node failed");
+  }
+  node->addr = addr;
+  node->links.resize(level + 1);
+  for (int i = 0; i <= level; i++) {
+    memcpy(&node->links[i], buf + below - i * kLink, kLink);
+  }
+  memcpy(&node->key, buf + below + RemoteSkipListLayout::kKeyOffset,
+         sizeof(char*));
+  node->shard = static_cast<uint8_t>(
+      buf[below + RemoteSkipListLayout::kShardOffset]);
+  return Status::OK();
+}
+
+Status RemoteSkipListReader::ReadEntry(const Fetch& fetch, uintptr_t key,
+                                       int shard, bool with_value,
+                                       size_t protection_bytes,
+                                       std::string* out) {
+  size_t tail = ShardTail(key, shard);
+  if (tail == 0) {
+    return Status::NotSupported("skiplist entry outside the shipped arena");
+  }
+  out->clear();
+  // reads up to want bytes of the entry, never past its shard block
+  auto grow = [&](size_t want) {
+    want = std::min(want, tail);
+    size_t have = out->size();
+    if (want <= have) return true;
+    uint64_t offset = 0;
+    if (!ToRemote(key + have, want - have, shard, &offset)) return false;
+    out->resize(want);
+    return fetch(offset, want - have, &(*out)[have]);
+  };
+  if (!grow(kKeyProbe)) {
+    return Status::IOError("one-sided read of a skiplist entry failed");
+  }
+  uint32_t key_len = 0;
+  const char* p =
+      GetVarint32Ptr(out->data(), out->data() + out->size(), &key_len);
+  if (p == nullptr) {
+    return Status::Corruption("bad key length in a remote memtable entry");
+  }
+  size_t key_end = static_cast<size_t>(p - out->data()) + key_len;
+  if (!grow(key_end + (with_value ? 5 : 0))) {
+    return Status::IOError("one-sided read of a skiplist entry failed");
+  }
+  if (out->size() < key_end) {
+    return Status::Corruption("remote memtable key runs off its shard");
+  }
+  if (!with_value) {
+    out->resize(key_end);
+    return Status::OK();
+  }
+  uint32_t value_len = 0;
+  p = GetVarint32Ptr(out->data() + key_end, out->data() + out->size(),
+                     &value_len);
+  if (p == nullptr) {
+    return Status::Corruption("bad value length in a remote memtable entry");
+  }
+  size_t end = static_cast<size_t>(p - out->data()) + value_len +
+               protection_bytes;
+  if (!grow(end)) {
+    return Status::IOError("one-sided read of a skiplist entry failed");
+  }
+  if (out->size() < end) {
+    return Status::Corruption("remote memtable value runs off its shard");
+  }
+  out->resize(end);
+  return Status::OK();
+}
+
+void RemoteSkipListReader::BuildCache(const Fetch& fetch) {
+  // a level has about a quarter of the nodes of the one below, walk down
+  // from the top until a level no longer fits
+  for (int level = layout_.max_height - 1; level >= 0; level--) {
+    std::vector<CachedNode> nodes;
+    Node cur;
+    if (!ReadNode(fetch, layout_.head, level, &cur).ok()) break;
+    bool fits = true;
+    while (cur.links[level] != 0) {
+      if (nodes.size() == kMaxCachedNodes) {
+        fits = false;
+        break;
+      }
+      Node next;
+      CachedNode c;
+      if (!ReadNode(fetch, cur.links[level], level, &next).ok() ||
+          !ReadEntry(fetch, next.key, next.shard, false, 0, &c.key).ok()) {
+        fits = false;
+        break;
+      }
+      c.node = next.addr;
+      c.entry = next.key;
+      c.shard = next.shard;
+      nodes.push_back(std::move(c));
+      cur = std::move(next);
+    }
+    if (!fits) break;
+    cache_ = std::move(nodes);
+    cache_level_ = level;
+  }
+  DM_LOG_DEBUG("remote skiplist cache: level ", cache_level_, " nodes ",
+               cache_.size());
+  cache_ready_.store(true, std::memory_order_release);
+}
+
+Status RemoteSkipListReader::Seek(const Fetch& fetch, const char* target,
+                                  size_t protection_bytes,
+                                  std::string* entry) {
+  entry->clear();
+  if (layout_.max_height < 1 || layout_.max_height > kMaxLevels) {
+    return Status::NotSupported("unexpected remote skiplist height");
+  }
+  if (!cache_ready_.load(std::memory_order_acquire) && cache_mu_.try_lock()) {
+    // lookups racing with the build walk the whole list meanwhile
+    if (!cache_ready_.load()) BuildCache(fetch);
+    cache_mu_.unlock();
+  }
+
+  uintptr_t start = layout_.head;
+  int level = layout_.max_height - 1;
+  if (cache_ready_.load(std::memory_order_acquire) && cache_level_ >= 0) {
+    auto it = std::partition_point(
+        cache_.begin(), cache_.end(), [&](const CachedNode& c) {
+          return cmp_(c.key.data(), target) < 0;
+        });
+    if (cache_level_ == 0) {
+      // the cache holds every node
+      if (it == cache_.end()) return Status::OK();
+      return ReadEntry(fetch, it->entry, it->shard, true, protection_bytes,
+                       entry);
+    }
+    if (it != cache_.begin()) start = std::prev(it)->node;
+    level = cache_level_ - 1;
+  }
+
+  Node cur;
+  Status s = ReadNode(fetch, start, level, &cur);
+  // the last node found at or after target, usually the next one below
+  Node next;
+  std::string next_key;
+  while (s.ok()) {
+    uintptr_t addr = cur.links[level];
+    if (addr != 0 && addr != next.addr) {
+      s = ReadNode(fetch, addr, level, &next);
+      if (s.ok()) {
+        s = ReadEntry(fetch, next.key, next.shard, false, 0, &next_key);
+      }
+      if (!s.ok()) break;
+    }
+    if (addr != 0 && cmp_(next_key.data(), target) < 0) {
+      cur = std::move(next);
+      next = Node();
+      continue;
+    }
+    if (level == 0) {
+      if (addr == 0) return Status::OK();
+      return ReadEntry(fetch, next.key, next.shard, true, protection_bytes,
+                       entry);
+    }
+    level--;
+  }
+  return s;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
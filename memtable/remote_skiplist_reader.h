@@ -0,0 +1,78 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rocksdb/memtablerep.h"
+#include "rocksdb/status.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Walks the memnode copy of an offloaded skiplist with one-sided reads, so
+// a compute node can look a key up without memnode CPU. Every node visited
+// costs a read of its links and one of its key. The deepest level with at
+// most kMaxCachedNodes nodes is read once and kept locally, a lookup binary
+// searches it and only walks the levels below.
+//
+// The memnode frees the skiplist once its memtable is no longer referenced
+// on the compute node, a lookup runs under such a reference.
+class RemoteSkipListReader {
+ public:
+  // reads len bytes at offset of the memnode buffer into dst
+  using Fetch = std::function<bool(uint64_t offset, size_t len, char* dst)>;
+
+  static constexpr size_t kMaxCachedNodes = 1024;
+
+  RemoteSkipListReader(const RemoteSkipListLayout& layout,
+                       const MemTableRep::KeyComparator& cmp);
+  RemoteSkipListReader(const RemoteSkipListReader&) = delete;
+  void operator=(const RemoteSkipListReader&) = delete;
+
+  // *entry gets the first entry at or after the memtable key target, with
+  // its value and protection_bytes of checksum, empty if there is none.
+  // NotSupported if the list points outside what was shipped.
+  Status Seek(const Fetch& fetch, const char* target, size_t protection_bytes,
+              std::string* entry);
+
+ private:
+  struct CachedNode {
+    std::string key;  // length prefixed internal key
+    uintptr_t node;
+    uintptr_t entry;
+    int shard;
+  };
+  struct Node {
+    uintptr_t addr{0};
+    std::vector<uintptr_t> links;  // levels 0 up to the one it was read at
+    uintptr_t key{0};
+    int shard{0};
+  };
+
+  // memnode offset of len bytes at addr, shard < 0 for the node arena
+  bool ToRemote(uintptr_t addr, size_t len, int shard, uint64_t* offset) const;
+  // bytes of the shard block left from addr
+  size_t ShardTail(uintptr_t addr, int shard) const;
+  Status ReadNode(const Fetch& fetch, uintptr_t addr, int level, Node* node);
+  // reads the entry at key, the internal key only unless with_value
+  Status ReadEntry(const Fetch& fetch, uintptr_t key, int shard,
+                   bool with_value, size_t protection_bytes, std::string* out);
+  void BuildCache(const Fetch& fetch);
+
+  const RemoteSkipListLayout layout_;
+  const MemTableRep::KeyComparator& cmp_;
+  std::mutex cache_mu_;
+  std::atomic<bool> cache_ready_{false};
+  // level whose nodes cache_ holds in order, -1 if nothing is cached
+  int cache_level_{-1};
+  std::vector<CachedNode> cache_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,270 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memtable/remote_skiplist_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "memory/sep_concurrent_arena.h"
+#include "memtable/inlineskiplist.h"
+#include "port/port.h"
+#include "test_util/testharness.h"
+#include "util/coding.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+
+// bytewise order of the length prefixed keys
+class TestComparator : public MemTableRep::KeyComparator {
+ public:
+  int operator()(const char* a, const char* b) const override {
+    return GetLengthPrefixedSlice(a).compare(GetLengthPrefixedSlice(b));
+  }
+  int operator()(const char* a, const Slice& b) const override {
+    return GetLengthPrefixedSlice(a).compare(b);
+  }
+};
+
+}  // namespace
+
+// Builds an InlineSkipList in a SepConcurrentArena, as a memtable does,
+// then copies its node block and shard blocks into a local stand-in for
+// the memnode buffer that the reader fetches from.
+class RemoteSkipListReaderTest : public testing::Test {
+ protected:
+  using List = InlineSkipList<const MemTableRep::KeyComparator&>;
+  static constexpr size_t kArenaSize = 4 << 20;
+  static constexpr size_t kProtection = 2;
+
+  void Build(const std::vector<std::string>& keys, int shards,
+             uint32_t seed) {
+    keys_ = keys;
+    std::sort(keys_.begin(), keys_.end());
+    keys_.erase(std::unique(keys_.begin(), keys_.end()), keys_.end());
+    const size_t n = keys_.size();
+    entry_offsets_.assign(n, 0);
+    list_.reset();
+    arena_.reset(new SepConcurrentArena(kArenaSize, shards));
+    list_.reset(new List(cmp_, arena_.get()));
+    ASSERT_EQ(shards, list_->get_shard_num());
+
+    // inserted out of order, the shard of a key is its rank mod shards
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) order[i] = i;
+    RandomShuffle(order.begin(), order.end(), seed);
+    std::vector<uint64_t> kv_used(shards, 0);
+    for (size_t i : order) {
+      int shard = static_cast<int>(i % shards);
+      std::string buf;
+      PutLengthPrefixedSlice(&buf, keys_[i]);
+      PutLengthPrefixedSlice(&buf, Value(i));
+      buf.append(kProtection, static_cast<char>('a' + i % 26));
+      char* ptr_buf = nullptr;
+      char* kv_buf = nullptr;
+      list_->AllocateKey(buf.size(), &ptr_buf, &kv_buf, shard);
+      memcpy(kv_buf, buf.data(), buf.size());
+      ASSERT_TRUE(list_->Insert(ptr_buf));
+      const char* kv_begin =
+          static_cast<const char*>(arena_->kv_begin(shard));
+      entry_offsets_[i] = kv_buf - kv_begin;
+      kv_used[shard] = std::max<uint64_t>(kv_used[shard],
+                                          entry_offsets_[i] + buf.size());
+    }
+
+    // as SkipListRep::GetRemoteLayout() reports it once shipped
+    layout_ = RemoteSkipListLayout();
+    auto meta = list_->get_local_begin();
+    layout_.meta_local = reinterpret_cast<uintptr_t>(meta.first);
+    layout_.meta_size = meta.second;
+    layout_.shard_num = shards;
+    layout_.head = layout_.meta_local + list_->get_head_offset();
+    list_->get_max_height(layout_.max_height);
+    // the memnode buffer holds the blocks at unrelated offsets
+    remote_.assign(4096, '\xee');
+    layout_.meta_remote = remote_.size();
+    remote_.append(meta.first, meta.second);
+    for (int s = 0; s < shards; s++) {
+      remote_.append(100 + s, '\xee');
+      const char* kv = static_cast<const char*>(arena_->kv_begin(s));
+      layout_.kv_local[s] = reinterpret_cast<uintptr_t>(kv);
+      ASSERT_EQ(kv, list_->get_shard_local_begin(s));
+      layout_.kv_remote[s] = remote_.size();
+      layout_.kv_size[s] = kv_used[s];
+      remote_.append(kv, kv_used[s]);
+    }
+    // the local blocks are gone, every read has to go to the copy
+    memset(const_cast<char*>(meta.first), 0xdd, meta.second);
+    for (int s = 0; s < shards; s++) {
+      memset(const_cast<void*>(arena_->kv_begin(s)), 0xdd, kv_used[s]);
+    }
+  }
+
+  static std::string Value(size_t i) { return "value" + std::to_string(i); }
+
+  RemoteSkipListReader::Fetch MakeFetch() {
+    return [this](uint64_t offset, size_t len, char* dst) {
+      fetches_++;
+      EXPECT_LE(offset + len, remote_.size());
+      if (fail_ || offset + len > remote_.size()) return false;
+      memcpy(dst, remote_.data() + offset, len);
+      return true;
+    };
+  }
+
+  // the entry the reader returns for the first key at or after target
+  std::string Expected(const std::string& target) const {
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), target);
+    if (it == keys_.end()) return "";
+    size_t i = static_cast<size_t>(it - keys_.begin());
+    std::string entry;
+    PutLengthPrefixedSlice(&entry, keys_[i]);
+    PutLengthPrefixedSlice(&entry, Value(i));
+    entry.append(kProtection, static_cast<char>('a' + i % 26));
+    return entry;
+  }
+
+  Status Seek(RemoteSkipListReader* reader, const std::string& target,
+              std::string* entry) {
+    std::string key;
+    PutLengthPrefixedSlice(&key, target);
+    return reader->Seek(MakeFetch(), key.data(), kProtection, entry);
+  }
+
+  static std::vector<std::string> Keys(size_t n, size_t len, uint32_t seed) {
+    Random rnd(seed);
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < n; i++) {
+      int key_len = 1 + rnd.Uniform(static_cast<int>(len));
+      keys.push_back(rnd.RandomString(key_len));
+    }
+    return keys;
+  }
+
+  TestComparator cmp_;
+  std::unique_ptr<SepConcurrentArena> arena_;
+  std::unique_ptr<List> list_;
+  std::vector<std::string> keys_;
+  // of each entry in its shard arena
+  std::vector<size_t> entry_offsets_;
+  std::string remote_;
+  RemoteSkipListLayout layout_;
+  size_t fetches_ = 0;
+  bool fail_ = false;
+};
+
+TEST_F(RemoteSkipListReaderTest, EmptyList) {
+  Build({}, 1, 301);
+  RemoteSkipListReader reader(layout_, cmp_);
+  std::string entry = "junk";
+  ASSERT_OK(Seek(&reader, "a", &entry));
+  ASSERT_TRUE(entry.empty());
+}
+
+TEST_F(RemoteSkipListReaderTest, SeekSmallList) {
+  // every node fits the cache, lookups only read the entry they return
+  Build(Keys(500, 12, 302), 1, 302);
+  ASSERT_LE(keys_.size(), RemoteSkipListReader::kMaxCachedNodes);
+  RemoteSkipListReader reader(layout_, cmp_);
+  std::string entry;
+  ASSERT_OK(Seek(&reader, keys_[0], &entry));
+  ASSERT_EQ(Expected(keys_[0]), entry);
+  for (const auto& key : keys_) {
+    fetches_ = 0;
+    ASSERT_OK(Seek(&reader, key, &entry));
+    ASSERT_EQ(Expected(key), entry);
+    ASSERT_LE(fetches_, 2U);
+  }
+  fetches_ = 0;
+  ASSERT_OK(Seek(&reader, std::string(20, '\xff'), &entry));
+  ASSERT_TRUE(entry.empty());
+  ASSERT_EQ(0U, fetches_);
+}
+
+TEST_F(RemoteSkipListReaderTest, SeekLargeShardedList) {
+  // the bottom levels exceed the cache and are walked
+  Build(Keys(8000, 16, 303), 4, 303);
+  ASSERT_GT(keys_.size(), RemoteSkipListReader::kMaxCachedNodes);
+  RemoteSkipListReader reader(layout_, cmp_);
+  std::string entry;
+  for (size_t i = 0; i < keys_.size(); i += 7) {
+    ASSERT_OK(Seek(&reader, keys_[i], &entry));
+    ASSERT_EQ(Expected(keys_[i]), entry);
+  }
+  // targets between and around the keys
+  for (const auto& target : Keys(2000, 16, 304)) {
+    ASSERT_OK(Seek(&reader, target, &entry));
+    ASSERT_EQ(Expected(target), entry);
+  }
+  ASSERT_OK(Seek(&reader, "", &entry));
+  ASSERT_EQ(Expected(""), entry);
+  ASSERT_OK(Seek(&reader, std::string(20, '\xff'), &entry));
+  ASSERT_TRUE(entry.empty());
+}
+
+TEST_F(RemoteSkipListReaderTest, LongEntries) {
+  // keys and values longer than the first read of an entry
+  std::vector<std::string> keys;
+  for (int i = 0; i < 50; i++) {
+    keys.push_back(std::string(100 + i, static_cast<char>('a' + i % 26)) +
+                   std::to_string(i));
+  }
+  Build(keys, 2, 305);
+  RemoteSkipListReader reader(layout_, cmp_);
+  std::string entry;
+  for (const auto& key : keys_) {
+    ASSERT_OK(Seek(&reader, key, &entry));
+    ASSERT_EQ(Expected(key), entry);
+  }
+}
+
+TEST_F(RemoteSkipListReaderTest, Errors) {
+  Build(Keys(100, 8, 306), 1, 306);
+  {
+    RemoteSkipListLayout bad = layout_;
+    bad.max_height = 0;
+    RemoteSkipListReader reader(bad, cmp_);
+    std::string entry;
+    ASSERT_TRUE(Seek(&reader, "a", &entry).IsNotSupported());
+  }
+  {
+    // the list points past what was shipped
+    RemoteSkipListLayout bad = layout_;
+    bad.kv_size[0] = entry_offsets_[50];
+    RemoteSkipListReader reader(bad, cmp_);
+    std::string entry;
+    ASSERT_TRUE(Seek(&reader, keys_[50], &entry).IsNotSupported());
+  }
+  {
+    RemoteSkipListLayout bad = layout_;
+    bad.head = bad.meta_local + bad.meta_size;
+    RemoteSkipListReader reader(bad, cmp_);
+    std::string entry;
+    ASSERT_TRUE(Seek(&reader, keys_[50], &entry).IsNotSupported());
+  }
+  {
+    // a failed read fails the lookup, a later one still works
+    RemoteSkipListReader reader(layout_, cmp_);
+    std::string entry;
+    fail_ = true;
+    ASSERT_TRUE(Seek(&reader, keys_[50], &entry).IsIOError());
+    fail_ = false;
+    ASSERT_OK(Seek(&reader, keys_[50], &entry));
+    ASSERT_EQ(Expected(keys_[50]), entry);
+  }
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
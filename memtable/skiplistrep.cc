@@ -18,6 +18,7 @@
 #include "memory/allocator.h"
 #include "memory/arena.h"
 #include "memtable/inlineskiplist.h"
+#include "memtable/offset_skiplist.h"
 #include "rocksdb/comparator.h"
 #include "rocksdb/logger.hpp"
 #include "rocksdb/memtablerep.h"
@@ -31,6 +32,8 @@
 
 namespace ROCKSDB_NAMESPACE {
 namespace {
+// List is InlineSkipList or OffsetSkipList over the rep comparator
+template <class List>
 class SkipListRep : public MemTableRep {
   friend SkipListFactory;
   // friend ReadOnlySkipListRep;
@@ -79,6 +82,50 @@ class SkipListRep : public MemTableRep {
     return {skip_list_.get_shard_local_begin(sep),
             reinterpret_cast<SepConcurrentArena*>(allocator_)->RawBlockSize()};
   }
+  inline void set_shard_layout(int shard_num, bool ordered) override {
+    skip_list_.set_shard_layout(shard_num, ordered);
+  }
+  inline void get_shard_layout(int& shard_num, bool& ordered) const override {
+    shard_num = skip_list_.get_shard_num();
+    ordered = skip_list_.get_shards_ordered();
+  }
+  void SampleUserKeys(size_t n,
+                      std::vector<std::string>* keys) const override {
+    std::vector<const char*> entries;
+    skip_list_.SampleKeys(n, &entries);
+    for (const char* entry : entries) {
+      Slice internal_key = GetLengthPrefixedSlice(entry);
+      keys->emplace_back(ExtractUserKey(internal_key).ToString());
+    }
+  }
+  bool GetRemoteLayout(RemoteSkipListLayout* layout) const override {
+    // only the compute node side of a shipped list, the memnode side
+    // already points into the memnode buffer. Offset links are followed by
+    // delegated reads only.
+    if (!List::kPointerLinks || !trans_called_.load() ||
+        skip_list_.get_remote_begin().first) {
+      return false;
+    }
+    static_assert(sizeof(std::atomic<void*>) == RemoteSkipListLayout::kLinkSize,
+                  "skiplist links are plain pointers");
+    uint64_t info[2 + 2 * kMaxMemTableShards] = {0};
+    skip_list_.get_remote_page_info(info);
+    if (info[1] == 0) return false;
+    auto local = skip_list_.get_local_begin();
+    layout->meta_local = reinterpret_cast<uintptr_t>(local.first);
+    layout->meta_remote = info[0];
+    layout->meta_size = std::min<uint64_t>(local.second, info[1]);
+    layout->shard_num = skip_list_.get_shard_num();
+    for (int i = 0; i < layout->shard_num; i++) {
+      layout->kv_local[i] =
+          reinterpret_cast<uintptr_t>(skip_list_.get_shard_local_begin(i));
+      layout->kv_remote[i] = info[2 + 2 * i];
+      layout->kv_size[i] = info[3 + 2 * i];
+    }
+    layout->head = layout->meta_local + skip_list_.get_head_offset();
+    skip_list_.get_max_height(layout->max_height);
+    return true;
+  }
   inline void set_max_height(int height) { skip_list_.set_max_height(height); }
   inline void get_max_height(int& height) const {
     skip_list_.get_max_height(height);
@@ -107,7 +154,7 @@ class SkipListRep : public MemTableRep {
                  size_t protection_bytes_per_key) const override;
 
  private:
-  InlineSkipList<const MemTableRep::KeyComparator&> skip_list_;
+  List skip_list_;
   const MemTableRep::KeyComparator& cmp_;
   const SliceTransform* transform_;
   const size_t lookahead_;
@@ -127,9 +174,9 @@ class SkipListRep : public MemTableRep {
         lookahead_(lookahead) {}
 
   KeyHandle Allocate(const size_t len, char** ptr_buf, char** kv_buf,
-                     const char* prefix) override {
+                     int shard) override {
     // *ptr_buf = skip_list_.AllocateKey(len);
-    skip_list_.AllocateKey(len, ptr_buf, kv_buf, prefix);
+    skip_list_.AllocateKey(len, ptr_buf, kv_buf, shard);
     return static_cast<KeyHandle>(*ptr_buf);
   }
 
@@ -259,6 +306,10 @@ class SkipListRep : public MemTableRep {
 
   void MarkReadOnly() override;
   void MarkTransAsFinished() override { trans_finished_.store(true); }
+  void MarkReattached() override {
+    trans_called_.store(true);
+    trans_finished_.store(true);
+  }
 
   ~SkipListRep() override {}
 
@@ -266,13 +317,13 @@ class SkipListRep : public MemTableRep {
   // back here.
   // Iteration over the contents of a skip list
   class Iterator : public MemTableRep::Iterator {
-    InlineSkipList<const MemTableRep::KeyComparator&>::Iterator iter_;
+    typename List::Iterator iter_;
 
    public:
     // Initialize an iterator over the specified list.
     // The returned iterator is not valid.
     explicit Iterator(
-        const InlineSkipList<const MemTableRep::KeyComparator&>* list)
+        const List* list)
         : iter_(list) {}
 
     ~Iterator() override {}
@@ -325,13 +376,13 @@ class SkipListRep : public MemTableRep {
   };
 
   class SepIterator : public MemTableRep::Iterator {
-    InlineSkipList<const MemTableRep::KeyComparator&>::SepIterator iter_;
+    typename List::SepIterator iter_;
 
    public:
     // Initialize an iterator over the specified list.
     // The returned iterator is not valid.
     explicit SepIterator(
-        const InlineSkipList<const MemTableRep::KeyComparator&>* list, int sep)
+        const List* list, int sep)
         : iter_(list, sep) {}
 
     ~SepIterator() override {}
@@ -354,18 +405,18 @@ class SkipListRep : public MemTableRep {
     // Advance to the first entry with a key >= target
     void Seek(const Slice& user_key, const char* memtable_key) override {
       // assert(false);
-      LOG_CERR("SepIter Not Support Seek()");
+      DM_LOG_WARN("SepIter Not Support Seek()");
     }
 
     // Retreat to the last entry with a key <= target
     void SeekForPrev(const Slice& user_key, const char* memtable_key) override {
       // assert(false);
-      LOG_CERR("SepIter Not Support SeekForPrev()");
+      DM_LOG_WARN("SepIter Not Support SeekForPrev()");
     }
 
     void RandomSeek() override {
       // assert(false);
-      LOG_CERR("SepIter Not Support RandomSeek()");
+      DM_LOG_WARN("SepIter Not Support RandomSeek()");
     }
 
     // Position at the first entry in list.
@@ -476,8 +527,8 @@ class SkipListRep : public MemTableRep {
 
    private:
     const SkipListRep& rep_;
-    InlineSkipList<const MemTableRep::KeyComparator&>::Iterator iter_;
-    InlineSkipList<const MemTableRep::KeyComparator&>::Iterator prev_;
+    typename List::Iterator iter_;
+    typename List::Iterator prev_;
   };
 
   MemTableRep::Iterator* GetIterator(Arena* arena = nullptr) override {
@@ -498,7 +549,7 @@ class SkipListRep : public MemTableRep {
   MemTableRep::Iterator* GetSepIterator(Arena* arena = nullptr,
                                         int sep = 0) override {
     if (lookahead_ > 0) {
-      LOG_CERR("SkipListRep::GetSepIterator not supported lookahead");
+      DM_LOG_WARN("SkipListRep::GetSepIterator not supported lookahead");
       void* mem =
           arena ? arena->AllocateAligned(sizeof(SkipListRep::LookaheadIterator))
                 :
@@ -513,7 +564,8 @@ class SkipListRep : public MemTableRep {
   }
 };
 
-Status SkipListRep::SendToRemote(
+template <class List>
+Status SkipListRep<List>::SendToRemote(
     RDMAClient* client, RDMANode::rdma_connection* conn,
     const std::pair<size_t, size_t>& remote_index_seg,
     size_t local_index_offset, uint64_t memtable_id, int type) {
@@ -522,12 +574,12 @@ Status SkipListRep::SendToRemote(
 
   std::chrono::high_resolution_clock::time_point s1 =
       std::chrono::high_resolution_clock::now();
-  void* meta_begin = const_cast<void*>(
-      reinterpret_cast<SepConcurrentArena*>(allocator_)->meta_begin());
+  auto* arena = reinterpret_cast<SepConcurrentArena*>(allocator_);
+  void* meta_begin = const_cast<void*>(arena->meta_begin());
+  const int32_t shard_num = arena->shard_num();
   std::vector<void*> data_begin;
-  for (int i = 0; i < 4 /*sep*/; i++) {
-    data_begin.push_back(const_cast<void*>(
-        reinterpret_cast<SepConcurrentArena*>(allocator_)->kv_begin(i)));
+  for (int i = 0; i < shard_num; i++) {
+    data_begin.push_back(const_cast<void*>(arena->kv_begin(i)));
   }
   // send meta
   char* metadata_ = client->get_buf() + local_index_offset;
@@ -540,6 +592,9 @@ Status SkipListRep::SendToRemote(
   skip_list_.get_max_height(height);
   *reinterpret_cast<int32_t*>(ptr) = height;
   ptr += sizeof(int32_t);
+  assert(ptr - metadata_ == MEMTABLE_INDEX_SHARDS);
+  *reinterpret_cast<int32_t*>(ptr) = shard_num;
+  ptr += sizeof(int32_t);
   // comparator
   auto cmp_id = reinterpret_cast<const MemTable::KeyComparator*>(&cmp_)
                     ->comparator.user_comparator()
@@ -554,6 +609,10 @@ Status SkipListRep::SendToRemote(
     return Status::NotSupported("cmp_ type not supported");
   }
   ptr += sizeof(bool);
+  uint8_t flags = List::kPointerLinks ? 0 : kMemTableIndexOffsetLinks;
+  if (arena->shards_ordered()) flags |= kMemTableIndexShardsOrdered;
+  *reinterpret_cast<uint8_t*>(ptr) = flags;
+  ptr += sizeof(uint8_t);
   // slicetransform
   std::function<bool(SliceTransform*&, char*&)> parser =
       [](SliceTransform*& now, char*& offset) -> bool {
@@ -583,23 +642,27 @@ Status SkipListRep::SendToRemote(
   ptr += sizeof(void*);
   *reinterpret_cast<void**>(ptr) = meta_begin;
   ptr += sizeof(void*);
-  for (int i = 0; i < 4 /*sep*/; i++) {
+  for (int i = 0; i < shard_num; i++) {
     *reinterpret_cast<void**>(ptr) = data_begin[i];
     ptr += sizeof(void*);
   }
-  // 8+8+8+16+1+4+8+8+4*8 = 61+4*8 = 93
+  // the memtable fills in its bloom filter at MEMTABLE_INDEX_BLOOM
+  assert(ptr - metadata_ <= MEMTABLE_INDEX_BLOOM);
   std::chrono::high_resolution_clock::time_point s2 =
       std::chrono::high_resolution_clock::now();
-  LOG_CERR(
+  DM_LOG_DEBUG(
       "Trans Imm:: ", memtable_id, " CHECK Start:: packTime::",
       std::chrono::duration_cast<std::chrono::microseconds>(s2 - s1).count(),
       "us");
 
-  if (93 != remote_index_seg.second - remote_index_seg.first) {
-    LOG_CERR("SkipListRep::SendToRemote indexblock size not match:: ", 93, ' ',
-             remote_index_seg.second - remote_index_seg.first);
+  if (MEMTABLE_INDEX_SIZE !=
+      remote_index_seg.second - remote_index_seg.first) {
+    DM_LOG_ERROR("SkipListRep::SendToRemote indexblock size not match:: ",
+                 MEMTABLE_INDEX_SIZE, ' ',
+                 remote_index_seg.second - remote_index_seg.first);
   }
-  client->rdma_write(conn, 93, local_index_offset, remote_index_seg.first);
+  client->rdma_write(conn, MEMTABLE_INDEX_SIZE, local_index_offset,
+                     remote_index_seg.first);
   ASSERT_RW(client->poll_completion(conn) == 0);
   std::chrono::high_resolution_clock::time_point s3 =
       std::chrono::high_resolution_clock::now();
@@ -611,26 +674,31 @@ Status SkipListRep::SendToRemote(
   if (s.ok()) {
     char req_type = 6;
     ASSERT_RW(writen(conn->sock, &req_type, sizeof(char)) == sizeof(char));
-    uint64_t info_seg[12] = {remote_index_seg.first,
-                             remote_index_seg.second - remote_index_seg.first};
+    uint64_t info_seg[RMEM_INFO_WORDS] = {
+        remote_index_seg.first,
+        remote_index_seg.second - remote_index_seg.first};
     skip_list_.get_remote_page_info(info_seg + 2);
-    ASSERT_RW(writen(conn->sock, info_seg, sizeof(uint64_t) * 12) ==
-              sizeof(uint64_t) * 12);
+    ASSERT_RW(writen(conn->sock, info_seg,
+                     sizeof(uint64_t) * RMEM_INFO_WORDS) ==
+              sizeof(uint64_t) * RMEM_INFO_WORDS);
     ASSERT_RW(readn(conn->sock, &req_type, sizeof(char)) == sizeof(char));
-    assert(req_type == 1);
+    if (req_type != 1) {
+      s = Status::Aborted("memnode refused the memtable");
+    }
   }
   // send raw data block allocated by trans_concurrent_arena
   std::chrono::high_resolution_clock::time_point s5 =
       std::chrono::high_resolution_clock::now();
-  LOG_CERR(
+  DM_LOG_DEBUG(
       "Trans Imm:: ", memtable_id, " CHECK Finished:: notifyTime:: ",
       std::chrono::duration_cast<std::chrono::microseconds>(s5 - s4).count(),
       "us");
   return s;
 }
 
-void SkipListRep::PackLocal(TransferService* node,
-                            size_t protection_bytes_per_key) const {
+template <class List>
+void SkipListRep<List>::PackLocal(TransferService* node,
+                                  size_t protection_bytes_per_key) const {
   LOG("SkipListRep::PackLocal");
   int64_t msg = 0x1;
   node->send(&msg, sizeof(msg));
@@ -642,7 +710,13 @@ void SkipListRep::PackLocal(TransferService* node,
   LOG("SkipListRep::PackLocal finish");
 }
 
-void SkipListRep::MarkReadOnly() {}
+template <class List>
+void SkipListRep<List>::MarkReadOnly() {}
+
+using InlineSkipListRep =
+    SkipListRep<InlineSkipList<const MemTableRep::KeyComparator&>>;
+using OffsetSkipListRep =
+    SkipListRep<OffsetSkipList<const MemTableRep::KeyComparator&>>;
 
 }  // namespace
 
@@ -668,8 +742,22 @@ std::string SkipListFactory::GetId() const {
 MemTableRep* SkipListFactory::CreateMemTableRep(
     const MemTableRep::KeyComparator& compare, Allocator* allocator,
     const SliceTransform* transform, Logger* /*logger*/) {
-  auto* ret = new SkipListRep(compare, allocator, transform, lookahead_);
+  auto* ret = new InlineSkipListRep(compare, allocator, transform, lookahead_);
   return ret;
 }
 
+MemTableRep* OffsetSkipListFactory::CreateMemTableRep(
+    const MemTableRep::KeyComparator& compare, Allocator* allocator,
+    const SliceTransform* transform, Logger* logger) {
+  using List = OffsetSkipList<const MemTableRep::KeyComparator&>;
+  if (!List::Fits(allocator)) {
+    // arenas an offset cannot address keep pointer links
+    DM_LOG_WARN("OffsetSkipListFactory:: ", allocator->name(),
+                " arena, using pointer links");
+    return SkipListFactory::CreateMemTableRep(compare, allocator, transform,
+                                              logger);
+  }
+  return new OffsetSkipListRep(compare, allocator, transform, lookahead_);
+}
+
 }  // namespace ROCKSDB_NAMESPACE
@@ -918,7 +918,10 @@ ImmutableCFOptions::ImmutableCFOptions(const ColumnFamilyOptions& cf_options)
       cf_paths(cf_options.cf_paths),
       compaction_thread_limiter(cf_options.compaction_thread_limiter),
       sst_partitioner_factory(cf_options.sst_partitioner_factory),
-      blob_cache(cf_options.blob_cache) {}
+      blob_cache(cf_options.blob_cache),
+      memtable_shard_num(cf_options.memtable_shard_num),
+      memtable_shard_partitioner(cf_options.memtable_shard_partitioner),
+      memtable_stream_to_remote(cf_options.memtable_stream_to_remote) {}
 
 ImmutableOptions::ImmutableOptions() : ImmutableOptions(Options()) {}
 
@@ -93,6 +93,12 @@ struct ImmutableCFOptions {
   std::shared_ptr<SstPartitionerFactory> sst_partitioner_factory;
 
   std::shared_ptr<Cache> blob_cache;
+
+  int memtable_shard_num;
+
+  std::shared_ptr<MemTableShardPartitioner> memtable_shard_partitioner;
+
+  bool memtable_stream_to_remote;
 };
 
 struct ImmutableOptions : public ImmutableDBOptions, public ImmutableCFOptions {
@@ -770,7 +770,10 @@ ImmutableDBOptions::ImmutableDBOptions(const DBOptions& options)
       compaction_service(options.compaction_service),
       enforce_single_del_contracts(options.enforce_single_del_contracts),
       worker_use_remote_flush(options.worker_use_remote_flush),
-      server_remote_flush(options.server_remote_flush) {
+      server_remote_flush(options.server_remote_flush),
+      memnode_warm_restart(options.memnode_warm_restart),
+      delegated_read_cache(options.delegated_read_cache),
+      memnodes(options.memnodes) {
   fs = env->GetFileSystem();
   clock = env->GetSystemClock().get();
   logger = info_log.get();
@@ -795,16 +798,19 @@ void ImmutableDBOptions::PackLocal(TransferService* node) const {
 void* ImmutableDBOptions::UnPackLocal(TransferService* node) {
   size_t len = 0;
   node->receive(&len, sizeof(size_t));
-  std::string mem;
-  mem.resize(len);
-  node->receive(mem.data(), len);
+  std::string copy;
+  const char* blob = node->view(len);
+  if (blob == nullptr) {
+    copy.resize(len);
+    node->receive(copy.data(), len);
+    blob = copy.data();
+  }
   DBOptions db_options = DBOptions();
-  ConfigOptions config_options;
   std::vector<ColumnFamilyDescriptor> loaded_cf_descs;
   Status ret = Status::Busy();
   while (!ret.ok()) {
-    ret =
-        LoadOptionsFromMem(config_options, mem, &db_options, &loaded_cf_descs);
+    ret = LoadOptionsFromMemCached(Slice(blob, len), &db_options,
+                                   &loaded_cf_descs);
   }
   auto* immutable_dboptions = new ImmutableDBOptions();
   *immutable_dboptions = BuildImmutableDBOptions(db_options);
@@ -115,6 +115,9 @@ struct ImmutableDBOptions {
 
   size_t worker_use_remote_flush = 0;
   size_t server_remote_flush = 0;
+  bool memnode_warm_restart = false;
+  std::shared_ptr<Cache> delegated_read_cache;
+  std::vector<std::string> memnodes;
 
   void* option_file_path = nullptr;
   bool is_pacakged = false;
@@ -173,17 +173,20 @@ void ColumnFamilyOptions::PackLocal(TransferService* node) const {
 void* ColumnFamilyOptions::UnPackLocal(TransferService* node) {
   size_t len = 0;
   node->receive(&len, sizeof(size_t));
-  std::string mem;
-  mem.resize(len);
-  node->receive(mem.data(), len);
+  std::string copy;
+  const char* blob = node->view(len);
+  if (blob == nullptr) {
+    copy.resize(len);
+    node->receive(copy.data(), len);
+    blob = copy.data();
+  }
   DBOptions db_options = DBOptions();
-  ConfigOptions config_options;
   std::vector<ColumnFamilyDescriptor> loaded_cf_descs;
 
   Status ret = Status::Busy();
   while (!ret.ok()) {
-    ret =
-        LoadOptionsFromMem(config_options, mem, &db_options, &loaded_cf_descs);
+    ret = LoadOptionsFromMemCached(Slice(blob, len), &db_options,
+                                   &loaded_cf_descs);
   }
   auto* options = new ColumnFamilyOptions();
   LOG("Unpackaging ColumnFamilyOptions");
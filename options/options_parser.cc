@@ -7,7 +7,9 @@
 
 #include <cmath>
 #include <map>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -20,6 +22,7 @@
 #include "rocksdb/convenience.h"
 #include "rocksdb/db.h"
 #include "rocksdb/utilities/options_type.h"
+#include "rocksdb/utilities/options_util.h"
 #include "test_util/sync_point.h"
 #include "util/cast_util.h"
 #include "util/string_util.h"
@@ -214,6 +217,39 @@ Status MemPersistRocksDBOptions(const ConfigOptions& config_options_in,
   return s;
 }
 
+Status LoadOptionsFromMemCached(const Slice& mem, DBOptions* db_options,
+                                std::vector<ColumnFamilyDescriptor>* cf_descs) {
+  struct Parsed {
+    DBOptions db_options;
+    std::vector<ColumnFamilyDescriptor> cf_descs;
+  };
+  // a worker sees the blobs of a few column families and the DB
+  static constexpr size_t kMaxCached = 16;
+  static std::mutex mu;
+  static std::unordered_map<std::string, Parsed> cache;
+  std::string key = mem.ToString();
+  {
+    std::lock_guard<std::mutex> lck(mu);
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+      *db_options = it->second.db_options;
+      *cf_descs = it->second.cf_descs;
+      return Status::OK();
+    }
+  }
+  ConfigOptions config_options;
+  Parsed parsed;
+  Status s = LoadOptionsFromMem(config_options, key, &parsed.db_options,
+                                &parsed.cf_descs);
+  if (!s.ok()) return s;
+  *db_options = parsed.db_options;
+  *cf_descs = parsed.cf_descs;
+  std::lock_guard<std::mutex> lck(mu);
+  if (cache.size() >= kMaxCached) cache.clear();
+  cache.emplace(std::move(key), std::move(parsed));
+  return s;
+}
+
 RocksDBOptionsParser::RocksDBOptionsParser() { Reset(); }
 
 void RocksDBOptionsParser::Reset() {
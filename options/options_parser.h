@@ -14,6 +14,7 @@
 
 namespace ROCKSDB_NAMESPACE {
 
+struct ColumnFamilyDescriptor;
 struct ConfigOptions;
 class OptionTypeInfo;
 class TableFactory;
@@ -41,6 +42,10 @@ Status MemPersistRocksDBOptions(const ConfigOptions& config_options_in,
                                 const std::vector<std::string>& cf_names,
                                 const std::vector<ColumnFamilyOptions>& cf_opts,
                                 std::string& writer);
+// LoadOptionsFromMem() for the option blobs of remote flush packages, which
+// repeat from flush to flush. The last blobs parsed are kept and copied out.
+Status LoadOptionsFromMemCached(const Slice& mem, DBOptions* db_options,
+                                std::vector<ColumnFamilyDescriptor>* cf_descs);
 Status PersistRocksDBOptions(const DBOptions& db_opt,
                              const std::vector<std::string>& cf_names,
                              const std::vector<ColumnFamilyOptions>& cf_opts,
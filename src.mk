@@ -56,6 +56,7 @@ LIB_SOURCES =                                                   \
   db/db_impl/db_impl_write.cc                                   \
   db/db_info_dumper.cc                                          \
   db/db_iter.cc                                                 \
+  db/delegated_memtable_iterator.cc                             \
   db/dbformat.cc                                                \
   db/error_handler.cc                                           \
   db/event_helpers.cc                                           \
@@ -122,6 +123,7 @@ LIB_SOURCES =                                                   \
   file/sequence_file_reader.cc                                  \
   file/sst_file_manager_impl.cc                                 \
   file/writable_file_writer.cc                                  \
+  logging/async_logger.cc                                       \
   logging/auto_roll_logger.cc                                   \
   logging/event_logger.cc                                       \
   logging/log_buffer.cc                                         \
@@ -133,6 +135,8 @@ LIB_SOURCES =                                                   \
   memtable/alloc_tracker.cc                                     \
   memtable/hash_linklist_rep.cc                                 \
   memtable/hash_skiplist_rep.cc                                 \
+  memtable/memtable_shard_partitioner.cc                        \
+  memtable/remote_skiplist_reader.cc                            \
   memtable/skiplistrep.cc                                       \
   memtable/vectorrep.cc                                         \
   memtable/write_buffer_manager.cc                              \
@@ -459,6 +463,7 @@ TEST_MAIN_SOURCES =                                                     \
   db/db_bloom_filter_test.cc                                            \
   db/db_compaction_filter_test.cc                                       \
   db/db_compaction_test.cc                                              \
+  db/db_delegated_read_cache_test.cc                                    \
   db/db_dynamic_level_test.cc                                           \
   db/db_encryption_test.cc                                              \
   db/db_flush_test.cc                                                   \
@@ -472,9 +477,11 @@ TEST_MAIN_SOURCES =                                                     \
   db/db_iterator_test.cc                                                \
   db/db_kv_checksum_test.cc                                             \
   db/db_log_iter_test.cc                                                \
+  db/db_memnode_warm_restart_test.cc                                    \
   db/db_memtable_test.cc                                                \
   db/db_merge_operator_test.cc                                          \
   db/db_merge_operand_test.cc                                           \
+  db/db_offloaded_memtable_test.cc                                      \
   db/db_options_test.cc                                                 \
   db/db_properties_test.cc                                              \
   db/db_range_del_test.cc                                               \
@@ -534,12 +541,16 @@ TEST_MAIN_SOURCES =                                                     \
   file/delete_scheduler_test.cc                                         \
   file/prefetch_test.cc                                                 \
   file/random_access_file_reader_test.cc                                \
+  logging/async_logger_test.cc                                          \
   logging/auto_roll_logger_test.cc                                      \
   logging/env_logger_test.cc                                            \
   logging/event_logger_test.cc                                          \
   memory/arena_test.cc                                                  \
   memory/memory_allocator_test.cc                                       \
   memtable/inlineskiplist_test.cc                                       \
+  memtable/memtable_shard_partitioner_test.cc                           \
+  memtable/offset_skiplist_test.cc                                      \
+  memtable/remote_skiplist_reader_test.cc                               \
   memtable/skiplist_test.cc                                             \
   memtable/write_buffer_manager_test.cc                                 \
   monitoring/histogram_test.cc                                          \
@@ -574,6 +585,7 @@ TEST_MAIN_SOURCES =                                                     \
   util/autovector_test.cc                                               \
   util/bloom_test.cc                                                    \
   util/coding_test.cc                                                   \
+  util/core_pinned_queue_test.cc                                        \
   util/crc32c_test.cc                                                   \
   util/defer_test.cc                                                    \
   util/dynamic_bloom_test.cc                                            \
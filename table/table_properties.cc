@@ -43,108 +43,108 @@ void AppendProperty(std::string& props, const std::string& key,
 }  // namespace
 
 void TableProperties::DoubleCheck(TransferService* node) const {
-  LOG_CERR("TableProperties::DoubleCheck::orig_file_number");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::orig_file_number");
   node->send(&orig_file_number, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::data_size");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::data_size");
   node->send(&data_size, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::index_size");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::index_size");
   node->send(&index_size, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::index_key_is_user_key");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::index_key_is_user_key");
   node->send(&index_key_is_user_key, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::index_value_is_delta_encoded");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::index_value_is_delta_encoded");
   node->send(&index_value_is_delta_encoded, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::filter_size");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::filter_size");
   node->send(&filter_size, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::raw_key_size");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::raw_key_size");
   node->send(&raw_key_size, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::raw_value_size");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::raw_value_size");
   node->send(&raw_value_size, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::num_data_blocks");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::num_data_blocks");
   node->send(&num_data_blocks, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::num_entries");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::num_entries");
   node->send(&num_entries, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::num_filter_entries");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::num_filter_entries");
   node->send(&num_filter_entries, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::num_deletions");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::num_deletions");
   node->send(&num_deletions, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::num_merge_operands");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::num_merge_operands");
   node->send(&num_merge_operands, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::num_range_deletions");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::num_range_deletions");
   node->send(&num_range_deletions, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::format_version");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::format_version");
   node->send(&format_version, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::fixed_key_len");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::fixed_key_len");
   node->send(&fixed_key_len, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::column_family_id");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::column_family_id");
   node->send(&column_family_id, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::creation_time");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::creation_time");
   node->send(&creation_time, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::oldest_key_time");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::oldest_key_time");
   node->send(&oldest_key_time, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::file_creation_time");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::file_creation_time");
   node->send(&file_creation_time, sizeof(uint64_t));
-  LOG_CERR(
+  DM_LOG_DEBUG(
       "TableProperties::DoubleCheck::slow_compression_estimated_data_size");
   node->send(&slow_compression_estimated_data_size, sizeof(uint64_t));
-  LOG_CERR(
+  DM_LOG_DEBUG(
       "TableProperties::DoubleCheck::fast_compression_estimated_data_size");
   node->send(&fast_compression_estimated_data_size, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::seqno_to_time_mapping");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::seqno_to_time_mapping");
   node->send(&external_sst_file_global_seqno_offset, sizeof(uint64_t));
-  LOG_CERR("TableProperties::DoubleCheck::db_id");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::db_id");
   size_t db_id_len = db_id.size();
   node->send(&db_id_len, sizeof(size_t));
   if (db_id_len) node->send(db_id.c_str(), db_id_len);
-  LOG_CERR("TableProperties::DoubleCheck::db_session_id");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::db_session_id");
   size_t db_session_id_len = db_session_id.size();
   node->send(&db_session_id_len, sizeof(size_t));
   if (db_session_id_len) node->send(db_session_id.c_str(), db_session_id_len);
-  LOG_CERR("TableProperties::DoubleCheck::db_host_id");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::db_host_id");
   size_t db_host_id_len = db_host_id.size();
   node->send(&db_host_id_len, sizeof(size_t));
   if (db_host_id_len) node->send(db_host_id.c_str(), db_host_id_len);
-  LOG_CERR("TableProperties::DoubleCheck::column_family_name");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::column_family_name");
   size_t column_family_name_len = column_family_name.size();
   node->send(&column_family_name_len, sizeof(size_t));
   if (column_family_name_len)
     node->send(column_family_name.c_str(), column_family_name_len);
-  LOG_CERR("TableProperties::DoubleCheck::filter_policy_name");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::filter_policy_name");
   size_t filter_policy_name_len = filter_policy_name.size();
   node->send(&filter_policy_name_len, sizeof(size_t));
   if (filter_policy_name_len)
     node->send(filter_policy_name.c_str(), filter_policy_name_len);
-  LOG_CERR("TableProperties::DoubleCheck::comparator_name");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::comparator_name");
   size_t comparator_name_len = comparator_name.size();
   node->send(&comparator_name_len, sizeof(size_t));
   if (comparator_name_len)
     node->send(comparator_name.c_str(), comparator_name_len);
-  LOG_CERR("TableProperties::DoubleCheck::merge_operator_name");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::merge_operator_name");
   size_t merge_operator_name_len = merge_operator_name.size();
   node->send(&merge_operator_name_len, sizeof(size_t));
   if (merge_operator_name_len)
     node->send(merge_operator_name.c_str(), merge_operator_name_len);
-  LOG_CERR("TableProperties::DoubleCheck::prefix_extractor_name");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::prefix_extractor_name");
   size_t prefix_extractor_name_len = prefix_extractor_name.size();
   node->send(&prefix_extractor_name_len, sizeof(size_t));
   if (prefix_extractor_name_len)
     node->send(prefix_extractor_name.c_str(), prefix_extractor_name_len);
-  LOG_CERR("TableProperties::DoubleCheck::property_collectors_names");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::property_collectors_names");
   size_t property_collectors_names_len = property_collectors_names.size();
   node->send(&property_collectors_names_len, sizeof(size_t));
   if (property_collectors_names_len)
     node->send(property_collectors_names.c_str(),
                property_collectors_names_len);
-  LOG_CERR("TableProperties::DoubleCheck::compression_name");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::compression_name");
   size_t compression_name_len = compression_name.size();
   node->send(&compression_name_len, sizeof(size_t));
   if (compression_name_len)
     node->send(compression_name.c_str(), compression_name_len);
-  LOG_CERR("TableProperties::DoubleCheck::compression_options");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::compression_options");
   size_t compression_options_len = compression_options.size();
   node->send(&compression_options_len, sizeof(size_t));
   if (compression_options_len)
     node->send(compression_options.c_str(), compression_options_len);
-  LOG_CERR("TableProperties::DoubleCheck::seqno_to_time_mapping");
+  DM_LOG_DEBUG("TableProperties::DoubleCheck::seqno_to_time_mapping");
   size_t seqno_to_time_mapping_len = seqno_to_time_mapping.size();
   node->send(&seqno_to_time_mapping_len, sizeof(size_t));
   if (seqno_to_time_mapping_len)
@@ -574,8 +574,8 @@ class SpecialMemTableRep : public MemTableRep {
 
   virtual KeyHandle Allocate(const size_t len, char** buf,
                              char** kv_buf = nullptr,
-                             const char* = nullptr) override {
-    return memtable_->Allocate(len, buf);
+                             int shard = -1) override {
+    return memtable_->Allocate(len, buf, kv_buf, shard);
   }
 
   // Insert key into the list.
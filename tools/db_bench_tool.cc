@@ -1260,6 +1260,9 @@ DEFINE_string(memnode_ip, "", "memnode ip");
 DEFINE_uint32(memnode_port, 0, "memnode port");
 DEFINE_string(local_ip, "", "local ip");
 DEFINE_int32(memnode_heartbeat_port, 10086, "memnode heartbeat port");
+DEFINE_string(memnodes, "",
+              "Comma separated ip:port of the memnodes immutable memtables "
+              "are offloaded to, see DBOptions::memnodes");
 DEFINE_bool(report_fillrandom_latency_and_load, false, "");
 
 static enum ROCKSDB_NAMESPACE::CompressionType StringToCompressionType(
@@ -4269,6 +4272,9 @@ class Benchmark {
         FLAGS_max_bytes_for_level_multiplier;
     options.server_remote_flush = FLAGS_use_remote_flush;
     options.max_local_write_buffer_number = FLAGS_max_local_write_buffer_number;
+    if (!FLAGS_memnodes.empty()) {
+      options.memnodes = StringSplit(FLAGS_memnodes, ',');
+    }
 
     Status s =
         CreateMemTableRepFactory(config_options, &options.memtable_factory);
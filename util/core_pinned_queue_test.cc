@@ -0,0 +1,113 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "rocksdb/core_pinned_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "port/port.h"
+#include "test_util/testharness.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+class CorePinnedQueueTest : public testing::Test {};
+
+TEST_F(CorePinnedQueueTest, Empty) {
+  CorePinnedQueue<int> queue;
+  int item = 0;
+  ASSERT_FALSE(queue.try_dequeue(item));
+  ASSERT_FALSE(queue.wait_dequeue_timed(item, std::chrono::milliseconds(1)));
+  ASSERT_EQ(0, item);
+}
+
+TEST_F(CorePinnedQueueTest, EveryItemComesBack) {
+  CorePinnedQueue<size_t> queue;
+  std::set<size_t> put;
+  for (size_t i = 1; i <= 100; i++) {
+    queue.enqueue(i);
+    put.insert(i);
+  }
+  std::set<size_t> got;
+  size_t item;
+  while (queue.wait_dequeue_timed(item, std::chrono::milliseconds(1))) {
+    ASSERT_TRUE(got.insert(item).second);
+  }
+  ASSERT_EQ(put, got);
+}
+
+TEST_F(CorePinnedQueueTest, CustomEmptyMarker) {
+  // offset 0 is a valid request slot, -1 marks a free core slot
+  CorePinnedQueue<long long, -1> queue;
+  queue.enqueue(0);
+  long long item = -1;
+  ASSERT_TRUE(queue.try_dequeue(item));
+  ASSERT_EQ(0, item);
+  ASSERT_FALSE(queue.try_dequeue(item));
+}
+
+TEST_F(CorePinnedQueueTest, WaiterGetsItemPutBackLater) {
+  CorePinnedQueue<int> queue;
+  std::atomic<int> got{0};
+  std::thread waiter([&]() {
+    int item = 0;
+    queue.wait_dequeue(item);
+    got.store(item);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_EQ(0, got.load());
+  queue.enqueue(7);
+  waiter.join();
+  ASSERT_EQ(7, got.load());
+}
+
+TEST_F(CorePinnedQueueTest, ConcurrentTakeAndPutBack) {
+  // a few items shared by more threads than items, as connections are
+  constexpr int kItems = 4;
+  constexpr int kThreads = 8;
+  constexpr int kRounds = 20000;
+  CorePinnedQueue<int> queue;
+  for (int i = 1; i <= kItems; i++) {
+    queue.enqueue(i);
+  }
+  std::vector<std::atomic<int>> owners(kItems + 1);
+  std::atomic<bool> clash{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&]() {
+      for (int r = 0; r < kRounds; r++) {
+        int item = 0;
+        queue.wait_dequeue(item);
+        if (owners[item].fetch_add(1) != 0) {
+          clash.store(true);
+        }
+        owners[item].fetch_sub(1);
+        queue.enqueue(item);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_FALSE(clash.load());
+  std::set<int> left;
+  int item;
+  while (queue.try_dequeue(item) ||
+         queue.wait_dequeue_timed(item, std::chrono::milliseconds(1))) {
+    ASSERT_TRUE(left.insert(item).second);
+  }
+  ASSERT_EQ(static_cast<size_t>(kItems), left.size());
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ROCKSDB_NAMESPACE::port::InstallStackTraceHandler();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -67,4 +67,14 @@ DynamicBloom::DynamicBloom(Allocator* allocator, uint32_t total_bits,
   data_ = reinterpret_cast<std::atomic<uint64_t>*>(raw);
 }
 
+DynamicBloom::DynamicBloom(const uint64_t* data, uint32_t len,
+                           uint32_t num_double_probes)
+    : kLen(len),
+      kNumDoubleProbes(num_double_probes),
+      data_(reinterpret_cast<std::atomic<uint64_t>*>(
+          const_cast<uint64_t*>(data))) {
+  assert(kLen > 0);
+  assert(kNumDoubleProbes > 0);
+}
+
 }  // namespace ROCKSDB_NAMESPACE
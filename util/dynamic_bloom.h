@@ -48,8 +48,18 @@ class DynamicBloom {
                         uint32_t num_probes = 6, size_t huge_page_tlb_size = 0,
                         Logger* logger = nullptr);
 
+  // Read-only view over the len 64-bit words of a filter built elsewhere,
+  // such as the filter of a memtable shipped to the memnode. Add* must not
+  // be called on a view.
+  DynamicBloom(const uint64_t* data, uint32_t len, uint32_t num_double_probes);
+
   ~DynamicBloom() {}
 
+  // where a view of this filter is built from
+  const char* data() const { return reinterpret_cast<const char*>(data_); }
+  uint32_t len() const { return kLen; }
+  uint32_t num_double_probes() const { return kNumDoubleProbes; }
+
   // Assuming single threaded access to this function.
   void Add(const Slice& key);
 
@@ -107,6 +107,25 @@ TEST_F(DynamicBloomTest, SmallConcurrentAdd) {
   ASSERT_TRUE(!bloom2.MayContain("foo"));
 }
 
+TEST_F(DynamicBloomTest, View) {
+  KeyMaker km;
+  Arena arena;
+  DynamicBloom bloom(&arena, 10000, 6);
+  for (uint64_t i = 0; i < 1000; i += 2) {
+    bloom.Add(km.Seq(i));
+  }
+  // a copy of the bits answers like the filter it was taken from
+  std::vector<uint64_t> bits(bloom.len());
+  memcpy(bits.data(), bloom.data(), bits.size() * sizeof(uint64_t));
+  DynamicBloom view(bits.data(), bloom.len(), bloom.num_double_probes());
+  for (uint64_t i = 0; i < 1000; i++) {
+    ASSERT_EQ(bloom.MayContain(km.Seq(i)), view.MayContain(km.Seq(i)));
+  }
+  for (uint64_t i = 0; i < 1000; i += 2) {
+    ASSERT_TRUE(view.MayContain(km.Seq(i)));
+  }
+}
+
 static uint32_t NextNum(uint32_t num) {
   if (num < 10) {
     num += 1;